@@ -0,0 +1,212 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "buffer_arena.hpp"
+
+// usage: buffer_arena_bench [operations]
+// Random allocate/free traffic of mesh sized blocks through TlsfAllocator, against a first
+// fit free list for speed. Checks that live allocations never overlap, that the statistics
+// add up and that compacting moves every allocation's contents along (replayed on a plain
+// byte array standing in for the GL buffer).
+namespace
+{
+    // reference: sorted free ranges, first one that fits
+    class FirstFit
+    {
+    public:
+        explicit FirstFit(uint32_t capacity) : m_free{{0, capacity}} {};
+
+        uint32_t allocate(uint32_t size)
+        {
+            for (size_t i = 0; i < m_free.size(); i++)
+            {
+                if (m_free[i].second >= size)
+                {
+                    uint32_t offset = m_free[i].first;
+                    m_free[i].first += size;
+                    m_free[i].second -= size;
+                    if (m_free[i].second == 0)
+                    {
+                        m_free.erase(m_free.begin() + static_cast<std::ptrdiff_t>(i));
+                    }
+                    return offset;
+                }
+            }
+            return TlsfAllocator::INVALID;
+        }
+
+        void free(uint32_t offset, uint32_t size)
+        {
+            auto it = std::lower_bound(m_free.begin(), m_free.end(), std::make_pair(offset, 0u));
+            it = m_free.insert(it, {offset, size});
+            if (it + 1 != m_free.end() && it->first + it->second == (it + 1)->first)
+            {
+                it->second += (it + 1)->second;
+                m_free.erase(it + 1);
+            }
+            if (it != m_free.begin() && (it - 1)->first + (it - 1)->second == it->first)
+            {
+                (it - 1)->second += it->second;
+                m_free.erase(it);
+            }
+        }
+
+    private:
+        std::vector<std::pair<uint32_t, uint32_t>> m_free;
+    };
+
+    // mostly small meshes, a few large ones
+    uint32_t randomSize(std::mt19937 &rng)
+    {
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        float u = unit(rng);
+        return 16 + static_cast<uint32_t>(u * u * u * 20000.0f);
+    }
+
+    template <typename F>
+    double milliseconds(F fn)
+    {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+} // namespace
+
+int main(int argc, char **argv)
+{
+    int operations = argc > 1 ? std::atoi(argv[1]) : 200000;
+    const uint32_t CAPACITY = 24u << 20;
+    const size_t LIVE = 4000;
+
+    // the same traffic for both: keep about LIVE blocks alive, replace a random one each step
+    std::mt19937 rng(11);
+    std::vector<uint32_t> sizes(static_cast<size_t>(operations));
+    std::vector<size_t> victims(static_cast<size_t>(operations));
+    for (int i = 0; i < operations; i++)
+    {
+        sizes[static_cast<size_t>(i)] = randomSize(rng);
+        victims[static_cast<size_t>(i)] = rng() % LIVE;
+    }
+
+    bool valid = true;
+    TlsfAllocator tlsf(CAPACITY);
+    std::vector<uint32_t> handles;
+    size_t failed = 0;
+    double tlsfTime = milliseconds([&]
+                                   {
+        for (int i = 0; i < operations; i++)
+        {
+            if (handles.size() >= LIVE)
+            {
+                size_t v = victims[static_cast<size_t>(i)];
+                tlsf.free(handles[v]);
+                handles[v] = handles.back();
+                handles.pop_back();
+            }
+            uint32_t h = tlsf.allocate(sizes[static_cast<size_t>(i)]);
+            if (h == TlsfAllocator::INVALID)
+            {
+                failed++;
+                continue;
+            }
+            handles.push_back(h);
+        } });
+
+    FirstFit firstFit(CAPACITY);
+    std::vector<std::pair<uint32_t, uint32_t>> ranges;
+    double firstFitTime = milliseconds([&]
+                                       {
+        for (int i = 0; i < operations; i++)
+        {
+            if (ranges.size() >= LIVE)
+            {
+                size_t v = victims[static_cast<size_t>(i)];
+                firstFit.free(ranges[v].first, ranges[v].second);
+                ranges[v] = ranges.back();
+                ranges.pop_back();
+            }
+            uint32_t offset = firstFit.allocate(sizes[static_cast<size_t>(i)]);
+            if (offset != TlsfAllocator::INVALID)
+            {
+                ranges.push_back({offset, sizes[static_cast<size_t>(i)]});
+            }
+        } });
+
+    // live allocations are disjoint, inside the capacity, and the stats agree
+    auto checkLayout = [&]()
+    {
+        std::vector<std::pair<uint32_t, uint32_t>> live;
+        uint64_t used = 0;
+        for (uint32_t h : handles)
+        {
+            live.push_back({tlsf.offset(h), tlsf.size(h)});
+            used += tlsf.size(h);
+        }
+        std::sort(live.begin(), live.end());
+        bool ok = true;
+        for (size_t i = 0; i < live.size(); i++)
+        {
+            ok = ok && live[i].first + live[i].second <= tlsf.capacity();
+            ok = ok && (i == 0 || live[i - 1].first + live[i - 1].second <= live[i].first);
+        }
+        TlsfAllocator::Stats stats = tlsf.stats();
+        return ok && stats.used == used && stats.allocations == handles.size();
+    };
+    valid = valid && checkLayout();
+
+    TlsfAllocator::Stats before = tlsf.stats();
+    std::cout << "TLSF: " << operations << " allocate + free in " << tlsfTime << " ms ("
+              << 1e6 * tlsfTime / operations << " ns each), first fit " << firstFitTime << " ms, " << failed
+              << " failed" << std::endl;
+    std::cout << "  " << before.allocations << " live, " << 100.0 * before.used / before.capacity << "% used, "
+              << before.freeBlocks << " free blocks, largest " << before.largestFree << ", fragmentation "
+              << before.fragmentation << std::endl;
+
+    // stamp every allocation, compact, replay the moves on the bytes and check the stamps
+    std::vector<uint8_t> memory(CAPACITY, 0);
+    for (uint32_t h : handles)
+    {
+        std::memset(&memory[tlsf.offset(h)], static_cast<int>(h % 251 + 1), tlsf.size(h));
+    }
+    std::vector<TlsfAllocator::Move> moves;
+    double compactTime = milliseconds([&]
+                                      { moves = tlsf.compact(); });
+    size_t moved = 0;
+    for (const TlsfAllocator::Move &move : moves)
+    {
+        std::memmove(&memory[move.to], &memory[move.from], move.size);
+        moved += move.from != move.to ? move.size : 0;
+    }
+    for (uint32_t h : handles)
+    {
+        const uint8_t *p = &memory[tlsf.offset(h)];
+        valid = valid && std::all_of(p, p + tlsf.size(h), [h](uint8_t v)
+                                     { return v == h % 251 + 1; });
+    }
+    valid = valid && checkLayout() && moves.size() == handles.size();
+    TlsfAllocator::Stats after = tlsf.stats();
+    valid = valid && after.freeBlocks <= 1 && after.fragmentation == 0.0f && after.largestFree == CAPACITY - after.used;
+    std::cout << "compact: " << moved << " units moved in " << moves.size() << " moves (" << compactTime
+              << " ms), now " << after.freeBlocks << " free block of " << after.largestFree << std::endl;
+
+    // keeps working after compaction and growth
+    for (int i = 0; i < 1000 && valid; i++)
+    {
+        uint32_t h = tlsf.allocate(sizes[static_cast<size_t>(i)]);
+        if (h == TlsfAllocator::INVALID)
+        {
+            tlsf.grow(tlsf.capacity() * 2);
+            h = tlsf.allocate(sizes[static_cast<size_t>(i)]);
+        }
+        valid = h != TlsfAllocator::INVALID;
+        handles.push_back(h);
+    }
+    valid = valid && checkLayout();
+    std::cout << (valid ? "checks passed" : "CHECKS FAILED") << std::endl;
+    return valid ? 0 : 1;
+}
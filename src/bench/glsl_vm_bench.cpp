@@ -0,0 +1,617 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "glsl_vm.hpp"
+#include "primitives.hpp"
+#include "soft_raster.hpp"
+#include "thread_pool.hpp"
+
+// usage: glsl_vm_bench [file or directory ...]   (defaults to $SHADERS_DIR)
+// Compiles every .vs, .fs and .glsl shader found with the CPU GLSL compiler, checks the
+// bytecode's vector and matrix maths against C++ over random inputs and, when ex5's
+// 02_instanced.vs is among the files, its instance transform against the model matrix
+// AnimatedInstances documents. Then draws ex5's cubes through its shaders and through
+// the rasterizer's built in shading, which must agree, and times both.
+
+namespace
+{
+    // the ex5 shader pair, 01_shader.vs / 01_shader.fs
+    const char *CUBE_VERTEX = R"(#version 330 core
+layout(location = 0) in vec3 aPos;
+layout(location = 2) in vec2 aTexCoord;
+
+out vec2 TexCoord;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+void main() {
+    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    TexCoord = vec2(aTexCoord.x, aTexCoord.y);
+}
+)";
+
+    const char *CUBE_FRAGMENT = R"(#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoord;
+
+uniform sampler2D texture1;
+uniform sampler2D texture2;
+
+void main() {
+    FragColor = mix(texture(texture1, TexCoord), texture(texture2, TexCoord), 0.2);
+}
+)";
+
+    // exercises the compiler: matrix products, swizzles on both sides, functions
+    const char *MATHS_VERTEX = R"(#version 330 core
+layout(location = 0) in vec4 a;
+layout(location = 1) in vec3 b;
+
+out vec3 o1;
+out vec4 o2;
+out vec4 o3;
+
+uniform mat4 m;
+uniform mat3 n;
+
+float square(float x) { return x * x; }
+
+vec3 twist(vec3 v, float s) {
+    v.xy = v.yx;
+    return v * s;
+}
+
+void main() {
+    gl_Position = m * a;
+    o1 = n * b + cross(b, a.xyz) - twist(b, 0.5);
+    vec4 s = a.wzyx * 2.0 - vec4(1.0);
+    s.zw += vec2(a.x, 3);
+    o2 = s;
+    o3 = vec4(mix(a.x, b.y, 0.25), clamp(b.z, -0.5, 0.5), length(normalize(b)) + dot(a.xy, b.xy),
+              square(fract(a.z)) + pow(abs(b.x) + 1.0, 1.5) + float(7 / 2));
+}
+)";
+
+    const char *PASS_FRAGMENT = R"(#version 330 core
+out vec4 color;
+void main() { color = vec4(1.0); }
+)";
+
+    // what shadeVertices writes, laid out like the rasterizer's clip space vertices
+    struct Vertex
+    {
+        float position[4];
+        float varyings[soft::MAX_VARYINGS];
+    };
+
+    // time fn() for roughly a quarter of a second, returns seconds per call
+    template <typename F>
+    double timeIt(F fn)
+    {
+        fn();
+        int iterations = 0;
+        auto start = std::chrono::steady_clock::now();
+        std::chrono::duration<double> elapsed{};
+        do
+        {
+            fn();
+            iterations++;
+            elapsed = std::chrono::steady_clock::now() - start;
+        } while (elapsed.count() < 0.25);
+        return elapsed.count() / iterations;
+    }
+
+    std::vector<std::filesystem::path> collect(int argc, char **argv)
+    {
+        std::vector<std::filesystem::path> roots;
+        for (int i = 1; i < argc; i++)
+        {
+            roots.emplace_back(argv[i]);
+        }
+        if (roots.empty() && std::getenv("SHADERS_DIR") != nullptr)
+        {
+            roots.emplace_back(std::getenv("SHADERS_DIR"));
+        }
+
+        std::vector<std::filesystem::path> files;
+        for (const std::filesystem::path &root : roots)
+        {
+            if (std::filesystem::is_directory(root))
+            {
+                for (const auto &entry : std::filesystem::recursive_directory_iterator(root))
+                {
+                    std::string ext = entry.path().extension().string();
+                    if (entry.is_regular_file() && (ext == ".vs" || ext == ".fs" || ext == ".glsl"))
+                    {
+                        files.push_back(entry.path());
+                    }
+                }
+            }
+            else
+            {
+                files.push_back(root);
+            }
+        }
+        std::sort(files.begin(), files.end());
+        return files;
+    }
+
+    std::string readFile(const std::filesystem::path &path)
+    {
+        std::ifstream file(path);
+        std::stringstream stream;
+        stream << file.rdbuf();
+        return stream.str();
+    }
+
+    // .vs and *vertex*.glsl are vertex shaders, the rest fragment shaders
+    soft::GlslShader::Stage stageOf(const std::filesystem::path &path)
+    {
+        std::string name = path.filename().string();
+        bool vertex = path.extension() == ".vs" || name.find("vertex") != std::string::npos;
+        return vertex ? soft::GlslShader::VERTEX : soft::GlslShader::FRAGMENT;
+    }
+
+    float random(uint32_t &state)
+    {
+        state = state * 1664525u + 1013904223u;
+        return (state >> 8) / 16777216.0f * 4.0f - 2.0f;
+    }
+
+    bool close(float value, float expected, float tolerance)
+    {
+        return std::fabs(value - expected) <= tolerance * std::max(1.0f, std::fabs(expected));
+    }
+
+    // runs a vertex shader over eight random vertices (inputs at locations 0 and 1, four
+    // floats each) and hands each lane's outputs to check(lane, inputs, position, varyings)
+    template <typename F>
+    bool checkVertices(soft::GlslProgram &program, uint32_t seed, F check)
+    {
+        float inputs[8][8];
+        for (auto &vertex : inputs)
+        {
+            for (float &value : vertex)
+            {
+                value = random(seed);
+            }
+        }
+        soft::AttributeStream attributes[soft::MAX_ATTRIBUTES];
+        attributes[0] = soft::AttributeStream{&inputs[0][0], sizeof(inputs[0]), 4};
+        attributes[1] = soft::AttributeStream{&inputs[0][4], sizeof(inputs[0]), 4};
+        Vertex out[8];
+        soft::ShaderRegisters registers;
+        program.prepare(registers);
+        program.shadeVertices(registers, attributes, 0, 8, 0, out[0].position, out[0].varyings, sizeof(Vertex));
+        bool ok = true;
+        for (int lane = 0; lane < 8; lane++)
+        {
+            ok = check(lane, inputs[lane], out[lane].position, out[lane].varyings) && ok;
+        }
+        return ok;
+    }
+
+    bool checkMaths()
+    {
+        uint32_t seed = 12345u;
+        float m[16], n[9];
+        for (float &value : m)
+        {
+            value = random(seed);
+        }
+        for (float &value : n)
+        {
+            value = random(seed);
+        }
+        // only outputs a fragment shader reads are varyings, this one reads them all
+        soft::GlslProgram program;
+        const char *takeAll = R"(#version 330 core
+in vec3 o1;
+in vec4 o2;
+in vec4 o3;
+out vec4 color;
+void main() { color = vec4(o1, 1.0) + o2 + o3; }
+)";
+        if (!program.build(MATHS_VERTEX, takeAll))
+        {
+            return false;
+        }
+        program.setUniform("m", m, 16);
+        program.setUniform("n", n, 9);
+        bool ok = checkVertices(
+            program, 777u,
+            [&](int lane, const float *in, const float *position, const float *varyings)
+            {
+                const float *a = in, *b = in + 4;
+                float expected[15];
+                for (int row = 0; row < 4; row++)
+                {
+                    float sum = 0.0f;
+                    for (int k = 0; k < 4; k++)
+                    {
+                        sum += m[k * 4 + row] * a[k];
+                    }
+                    if (!close(position[row], sum, 1e-4f))
+                    {
+                        std::cerr << "lane " << lane << ": gl_Position[" << row << "] " << position[row] << " != "
+                                  << sum << std::endl;
+                        return false;
+                    }
+                }
+                float crossed[3] = {b[1] * a[2] - b[2] * a[1], b[2] * a[0] - b[0] * a[2], b[0] * a[1] - b[1] * a[0]};
+                float twisted[3] = {b[1] * 0.5f, b[0] * 0.5f, b[2] * 0.5f};
+                for (int row = 0; row < 3; row++)
+                {
+                    expected[row] = n[row] * b[0] + n[3 + row] * b[1] + n[6 + row] * b[2] + crossed[row] - twisted[row];
+                }
+                float s[4] = {a[3] * 2.0f - 1.0f, a[2] * 2.0f - 1.0f, a[1] * 2.0f - 1.0f, a[0] * 2.0f - 1.0f};
+                s[2] += a[0];
+                s[3] += 3.0f;
+                std::copy(s, s + 4, expected + 3);
+                float length = std::sqrt(b[0] * b[0] + b[1] * b[1] + b[2] * b[2]);
+                float fraction = a[2] - std::floor(a[2]);
+                expected[7] = a[0] + (b[1] - a[0]) * 0.25f;
+                expected[8] = std::min(std::max(b[2], -0.5f), 0.5f);
+                expected[9] = length / length + a[0] * b[0] + a[1] * b[1];
+                expected[10] = fraction * fraction + std::pow(std::fabs(b[0]) + 1.0f, 1.5f) + 3.0f;
+                for (int i = 0; i < 11; i++)
+                {
+                    if (!close(varyings[i], expected[i], 1e-4f))
+                    {
+                        std::cerr << "lane " << lane << ": varying " << i << " " << varyings[i] << " != " << expected[i]
+                                  << std::endl;
+                        return false;
+                    }
+                }
+                return true;
+            });
+        return ok && program.varyingCount() == 11;
+    }
+
+    // shaders that must be refused, each with its reason on std::cerr
+    bool checkErrors()
+    {
+        const char *broken[] = {
+            "void main() { if (true) { } }",
+            "void main() { float x = 1.0; x++; }",
+            "void main() { gl_Position = vec3(1.0); }",
+            "void main() { gl_Position = undefinedName; }",
+            "float f() { return f(); } void main() { gl_Position = vec4(f()); }",
+            "#define X 1\nvoid main() { }",
+        };
+        bool ok = true;
+        for (const char *source : broken)
+        {
+            soft::GlslShader shader;
+            std::streambuf *previous = std::cerr.rdbuf(nullptr);
+            bool compiled = shader.compile(source, soft::GlslShader::VERTEX, "broken");
+            std::cerr.rdbuf(previous);
+            if (compiled)
+            {
+                std::cerr << "accepted: " << source << std::endl;
+                ok = false;
+            }
+        }
+        return ok;
+    }
+
+    // ex5's instanced vertex shader against translate(position) * rotate(phase + time * speed, axis)
+    bool checkInstanced(const std::string &source)
+    {
+        soft::GlslProgram program;
+        if (!program.build(source, PASS_FRAGMENT))
+        {
+            return false;
+        }
+        uint32_t seed = 4242u;
+        const int instanceCount = 5, firstInstance = 2;
+        std::vector<float> texels;
+        for (int i = 0; i < instanceCount + firstInstance; i++)
+        {
+            float axis[3] = {random(seed), random(seed), random(seed)};
+            float length = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+            texels.insert(texels.end(), {random(seed) * 5.0f, random(seed) * 5.0f, random(seed) * 5.0f, random(seed)});
+            texels.insert(texels.end(), {axis[0] / length, axis[1] / length, axis[2] / length, random(seed)});
+        }
+        const float identity[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+        const float time = 1.75f;
+        program.setBuffer("instances", texels.data(), texels.size() / 4);
+        program.setUniform("firstInstance", static_cast<float>(firstInstance));
+        program.setUniform("time", time);
+        program.setUniform("view", identity, 16);
+        program.setUniform("projection", identity, 16);
+
+        float positions[8][3];
+        for (auto &position : positions)
+        {
+            for (float &value : position)
+            {
+                value = random(seed);
+            }
+        }
+        soft::AttributeStream attributes[soft::MAX_ATTRIBUTES];
+        attributes[0] = soft::AttributeStream{&positions[0][0], sizeof(positions[0]), 3};
+        soft::ShaderRegisters registers;
+        program.prepare(registers);
+        for (int instance = 0; instance < instanceCount; instance++)
+        {
+            Vertex out[8];
+            program.shadeVertices(registers, attributes, 0, 8, instance, out[0].position, out[0].varyings,
+                                  sizeof(Vertex));
+            const float *placement = &texels[(firstInstance + instance) * 8], *spin = placement + 4;
+            float angle = placement[3] + time * spin[3];
+            float c = std::cos(angle), s = std::sin(angle), t = 1.0f - c;
+            float x = spin[0], y = spin[1], z = spin[2];
+            const float rotation[9] = {t * x * x + c,     t * x * y + s * z, t * x * z - s * y,
+                                       t * x * y - s * z, t * y * y + c,     t * y * z + s * x,
+                                       t * x * z + s * y, t * y * z - s * x, t * z * z + c};
+            for (int lane = 0; lane < 8; lane++)
+            {
+                const float *p = positions[lane];
+                for (int row = 0; row < 3; row++)
+                {
+                    float expected = rotation[row] * p[0] + rotation[3 + row] * p[1] + rotation[6 + row] * p[2] +
+                                     placement[row];
+                    if (!close(out[lane].position[row], expected, 1e-4f))
+                    {
+                        std::cerr << "02_instanced.vs: instance " << instance << " vertex " << lane << " "
+                                  << out[lane].position[row] << " != " << expected << std::endl;
+                        return false;
+                    }
+                }
+            }
+        }
+        return true;
+    }
+
+    struct Matrix
+    {
+        float m[16];
+    };
+
+    Matrix multiply(const Matrix &a, const Matrix &b)
+    {
+        Matrix result;
+        for (int column = 0; column < 4; column++)
+        {
+            for (int row = 0; row < 4; row++)
+            {
+                float sum = 0.0f;
+                for (int k = 0; k < 4; k++)
+                {
+                    sum += a.m[k * 4 + row] * b.m[column * 4 + k];
+                }
+                result.m[column * 4 + row] = sum;
+            }
+        }
+        return result;
+    }
+
+    // glm::perspective with a vertical field of view in radians
+    Matrix perspective(float fov, float aspect, float nearPlane, float farPlane)
+    {
+        float f = 1.0f / std::tan(fov * 0.5f);
+        Matrix result{};
+        result.m[0] = f / aspect;
+        result.m[5] = f;
+        result.m[10] = -(farPlane + nearPlane) / (farPlane - nearPlane);
+        result.m[11] = -1.0f;
+        result.m[14] = -2.0f * farPlane * nearPlane / (farPlane - nearPlane);
+        return result;
+    }
+
+    // translation times a rotation by angle around the normalised axis
+    Matrix placement(float x, float y, float z, float angle, float ax, float ay, float az)
+    {
+        float length = std::sqrt(ax * ax + ay * ay + az * az);
+        ax /= length, ay /= length, az /= length;
+        float c = std::cos(angle), s = std::sin(angle), t = 1.0f - c;
+        return Matrix{{t * ax * ax + c, t * ax * ay + s * az, t * ax * az - s * ay, 0.0f, t * ax * ay - s * az,
+                       t * ay * ay + c, t * ay * az + s * ax, 0.0f, t * ax * az + s * ay, t * ay * az - s * ax,
+                       t * az * az + c, 0.0f, x, y, z, 1.0f}};
+    }
+
+    soft::Texture checker(int size, int cells, const unsigned char a[3], const unsigned char b[3])
+    {
+        std::vector<unsigned char> rgba(static_cast<size_t>(size) * size * 4);
+        for (int y = 0; y < size; y++)
+        {
+            for (int x = 0; x < size; x++)
+            {
+                const unsigned char *color = ((x * cells / size + y * cells / size) & 1) ? a : b;
+                unsigned char *p = &rgba[(static_cast<size_t>(y) * size + x) * 4];
+                p[0] = color[0], p[1] = color[1], p[2] = color[2], p[3] = 255;
+            }
+        }
+        soft::Texture texture;
+        texture.load(rgba.data(), size, size);
+        return texture;
+    }
+
+    struct Cube
+    {
+        std::vector<float> positions;
+        std::vector<float> uvs;
+        std::vector<uint32_t> indices;
+    };
+
+    // cubes spread through the view frustum as in soft_raster_bench, shaded by program
+    // when given, by the rasterizer's ex5 shading otherwise
+    void drawCubes(soft::Rasterizer &rasterizer, soft::Framebuffer &target, const Cube &cube,
+                   const soft::Texture &texture1, const soft::Texture &texture2, soft::GlslProgram *program, int count)
+    {
+        const float clearColor[4] = {0.2f, 0.3f, 0.3f, 1.0f};
+        target.clear(clearColor);
+        Matrix projection =
+            perspective(0.785398f, static_cast<float>(target.width()) / target.height(), 0.1f, 100.0f);
+        const Matrix view{{1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1}};
+        soft::DrawCall call;
+        call.vertexCount = cube.positions.size() / 3;
+        call.indices = cube.indices.data();
+        call.indexCount = cube.indices.size();
+        if (program != nullptr)
+        {
+            program->setUniform("projection", projection.m, 16);
+            program->setUniform("view", view.m, 16);
+            program->setTexture("texture1", &texture1);
+            program->setTexture("texture2", &texture2);
+            call.program = program;
+            call.attributes[0] = soft::AttributeStream{cube.positions.data(), 3 * sizeof(float), 3};
+            call.attributes[2] = soft::AttributeStream{cube.uvs.data(), 2 * sizeof(float), 2};
+        }
+        else
+        {
+            call.positions = cube.positions.data();
+            call.uvs = cube.uvs.data();
+            call.texture1 = &texture1;
+            call.texture2 = &texture2;
+        }
+        for (int i = 0; i < count; i++)
+        {
+            float x = static_cast<float>(i % 20) - 9.5f, y = static_cast<float>(i / 20 % 12) - 5.5f;
+            float z = -12.0f - 4.0f * (i / 240);
+            Matrix model = placement(x, y * 0.6f, z, 0.35f * i, 1.0f, 0.3f, 0.5f);
+            if (program != nullptr)
+            {
+                program->setUniform("model", model.m, 16);
+            }
+            else
+            {
+                std::memcpy(call.mvp, multiply(projection, multiply(view, model)).m, sizeof(call.mvp));
+            }
+            rasterizer.draw(target, call);
+        }
+    }
+} // namespace
+
+int main(int argc, char **argv)
+{
+    auto milliseconds = [](auto fn)
+    {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    bool valid = true;
+    int compiled = 0;
+    for (const std::filesystem::path &path : collect(argc, argv))
+    {
+        std::string source = readFile(path);
+        soft::GlslShader shader;
+        double time = milliseconds([&] { valid = shader.compile(source, stageOf(path), path.string()) && valid; });
+        if (shader.code().empty() && shader.registerCount() == 0)
+        {
+            continue;
+        }
+        compiled++;
+        std::cout << path.string() << ": " << shader.code().size() << " instructions, " << shader.registerCount()
+                  << " registers, compiled in " << time << " ms" << std::endl;
+        if (path.filename() == "02_instanced.vs")
+        {
+            valid = checkInstanced(source) && valid;
+        }
+    }
+    if (compiled == 0)
+    {
+        std::cout << "no shader files given (pass files or directories, or set SHADERS_DIR)" << std::endl;
+    }
+
+    valid = checkMaths() && valid;
+    valid = checkErrors() && valid;
+
+    soft::GlslProgram program;
+    if (!program.build(CUBE_VERTEX, CUBE_FRAGMENT))
+    {
+        std::cout << "CHECKS FAILED" << std::endl;
+        return 1;
+    }
+    const soft::GlslShader &fragment = program.fragmentShader();
+    std::cout << "ex5 fragment shader: " << fragment.code().size() << " instructions, " << fragment.registerCount()
+              << " registers" << std::endl;
+
+    Cube cube;
+    const mesh::PrimitiveCounts counts = mesh::cubeCounts(1);
+    cube.positions.resize(counts.vertexCount * 3);
+    cube.uvs.resize(counts.vertexCount * 2);
+    cube.indices.resize(counts.indexCount);
+    mesh::GeometryStreams streams;
+    streams.positions = cube.positions.data();
+    streams.uvs = cube.uvs.data();
+    streams.indices = cube.indices.data();
+    mesh::generateCube(streams);
+    const unsigned char wood[3] = {150, 100, 50}, dark[3] = {60, 40, 20};
+    const unsigned char white[3] = {240, 240, 240}, red[3] = {200, 30, 30};
+    soft::Texture texture1 = checker(512, 8, wood, dark);
+    soft::Texture texture2 = checker(256, 4, white, red);
+
+    // the shaders and the built in shading draw the same image: identical coverage and
+    // depth, colours within what the derivative estimate changes in the mip level
+    ThreadPool &pool = ThreadPool::shared();
+    soft::Rasterizer rasterizer(pool);
+    const int width = 1920, height = 1080, cubes = 480;
+    soft::Framebuffer builtIn(width, height), shaded(width, height);
+    drawCubes(rasterizer, builtIn, cube, texture1, texture2, nullptr, cubes);
+    drawCubes(rasterizer, shaded, cube, texture1, texture2, &program, cubes);
+    size_t pixels = static_cast<size_t>(width) * height;
+    double total = 0.0;
+    int worst = 0;
+    for (size_t i = 0; i < pixels * 4; i++)
+    {
+        int difference = std::abs(builtIn.color()[i] - shaded.color()[i]);
+        worst = std::max(worst, difference);
+        total += difference;
+    }
+    double mean = total / (pixels * 4);
+    bool sameDepth = std::memcmp(builtIn.depth(), shaded.depth(), pixels * sizeof(float)) == 0;
+    std::cout << "shaders vs built in: mean difference " << mean << " / 255, worst " << worst
+              << (sameDepth ? ", same depth" : ", DEPTH DIFFERS") << std::endl;
+    valid = valid && sameDepth && mean < 0.5;
+
+    rasterizer.resetStats();
+    double builtInTime = milliseconds([&] { drawCubes(rasterizer, builtIn, cube, texture1, texture2, nullptr, cubes); });
+    uint64_t fragments = rasterizer.stats().fragments;
+    rasterizer.resetStats();
+    double shadedTime = milliseconds([&] { drawCubes(rasterizer, shaded, cube, texture1, texture2, &program, cubes); });
+    std::cout << cubes << " cubes at " << width << "x" << height << ": built in " << builtInTime << " ms ("
+              << fragments / builtInTime / 1e3 << " Mpixels/s), shaders " << shadedTime << " ms ("
+              << rasterizer.stats().fragments / shadedTime / 1e3 << " Mpixels/s)" << std::endl;
+
+    // the interpreter alone: the fragment shader over 4x2 blocks of a magnified texture
+    soft::ShaderRegisters registers;
+    program.prepare(registers);
+    soft::Lanes varyings[2], fragCoord[4] = {}, color[4];
+    for (int lane = 0; lane < 8; lane++)
+    {
+        varyings[0].v[lane] = 0.25f + (lane & 3) * 1e-4f;
+        varyings[1].v[lane] = 0.5f + (lane >> 2) * 1e-4f;
+    }
+    const int blocks = 10000;
+    double seconds = timeIt(
+        [&]
+        {
+            for (int i = 0; i < blocks; i++)
+            {
+                program.shadeFragments(registers, varyings, fragCoord, color);
+            }
+        });
+    std::cout << "ex5 fragment shader alone: " << blocks * 8 / seconds / 1e6 << " M fragments/s on one thread"
+              << std::endl;
+    std::cout << "on " << pool.threadCount() << " threads" << std::endl;
+
+    std::cout << (valid ? "checks passed" : "CHECKS FAILED") << std::endl;
+    return valid ? 0 : 1;
+}
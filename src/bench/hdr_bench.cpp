@@ -0,0 +1,157 @@
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "hdr_pack.hpp"
+
+// usage: hdr_bench [megapixels]
+// Checks the F16C/AVX2 packers against hdr::scalar (random values, the special
+// cases and every tail length), then reports throughput and the memory each
+// format needs compared with 32 bit float RGBA.
+namespace
+{
+    double secondsPerCall(const std::function<void()> &fn)
+    {
+        fn();
+        int iterations = 0;
+        auto start = std::chrono::steady_clock::now();
+        std::chrono::duration<double> elapsed{};
+        do
+        {
+            fn();
+            iterations++;
+            elapsed = std::chrono::steady_clock::now() - start;
+        } while (elapsed.count() < 0.2);
+        return elapsed.count() / iterations;
+    }
+
+    void report(const std::string &name, double megapixels, double simd, double scalar, int bytesPerTexel)
+    {
+        std::cout << name << ": " << megapixels / simd << " MP/s (scalar " << megapixels / scalar << " MP/s, "
+                  << scalar / simd << "x), " << bytesPerTexel << " bytes/texel, " << 16.0 / bytesPerTexel
+                  << "x smaller than rgba32f" << std::endl;
+    }
+} // namespace
+
+int main(int argc, char **argv)
+{
+    double megapixels = argc > 1 ? std::atof(argv[1]) : 4.0;
+    size_t count = static_cast<size_t>(megapixels * 1e6);
+
+    // log-uniform magnitudes over the whole half range and beyond, a few negatives
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> exponent(-30.0f, 20.0f);
+    std::vector<float> source(count * 4 + 64);
+    for (float &v : source)
+    {
+        v = std::exp2(exponent(rng)) * (rng() % 16 == 0 ? -1.0f : 1.0f);
+    }
+    const float specials[] = {0.0f,
+                              -0.0f,
+                              1.0f,
+                              65504.0f,
+                              65519.0f,
+                              65520.0f,
+                              65408.0f,
+                              65024.0f,
+                              64512.0f,
+                              1e9f,
+                              5.96e-8f,
+                              2.98e-8f,
+                              6.1e-5f,
+                              std::numeric_limits<float>::denorm_min(),
+                              std::numeric_limits<float>::infinity(),
+                              -std::numeric_limits<float>::infinity(),
+                              std::numeric_limits<float>::quiet_NaN(),
+                              -std::numeric_limits<float>::quiet_NaN()};
+    const size_t specialCount = sizeof(specials) / sizeof(specials[0]);
+    for (size_t i = 0; i < 4096; i++)
+    {
+        source[i] = specials[(i * 7 + i / 13) % specialCount];
+    }
+
+    int failures = 0;
+    std::vector<size_t> lengths;
+    for (size_t n = 0; n < 40; n++)
+    {
+        lengths.push_back(n);
+    }
+    lengths.push_back(1000);
+    for (int i = 0; i < 10; i++)
+    {
+        lengths.push_back(rng() % 100000);
+    }
+    for (size_t n : lengths)
+    {
+        std::vector<uint16_t> ha(n * 4 + 4, 0xABCD), hb(n * 4 + 4, 0xABCD);
+        hdr::floatToHalf(source.data(), ha.data(), n * 4);
+        hdr::scalar::floatToHalf(source.data(), hb.data(), n * 4);
+        failures += ha != hb;
+
+        std::vector<float> fa(n * 4), fb(n * 4);
+        hdr::halfToFloat(hb.data(), fa.data(), n * 4);
+        for (size_t i = 0; i < n * 4; i++)
+        {
+            fb[i] = hdr::scalar::halfToFloat(hb[i]);
+        }
+        failures += n > 0 && std::memcmp(fa.data(), fb.data(), fa.size() * sizeof(float)) != 0;
+
+        for (int channels : {3, 4})
+        {
+            std::vector<uint32_t> pa(n + 4, 0xDEADBEEF), pb(n + 4, 0xDEADBEEF);
+            hdr::packRgb9e5(source.data(), channels, pa.data(), n);
+            hdr::scalar::packRgb9e5(source.data(), channels, pb.data(), n);
+            failures += pa != pb;
+
+            hdr::packR11G11B10(source.data(), channels, pa.data(), n);
+            hdr::scalar::packR11G11B10(source.data(), channels, pb.data(), n);
+            failures += pa != pb;
+        }
+    }
+    // every half value survives half -> float -> half, except that signalling NaNs come back quiet
+    for (uint32_t h = 0; h < 0x10000; h++)
+    {
+        uint16_t back = hdr::scalar::floatToHalf(hdr::scalar::halfToFloat(static_cast<uint16_t>(h)));
+        bool nan = (h & 0x7C00) == 0x7C00 && (h & 0x3FF) != 0;
+        failures += back != (nan ? h | 0x200 : h);
+    }
+    // a few known encodings
+    failures += hdr::scalar::floatToHalf(65520.0f) != 0x7C00 || hdr::scalar::floatToHalf(1.0f + 1.0f / 2048) != 0x3C00;
+    failures += hdr::scalar::packRgb9e5(1.0f, 1.0f, 1.0f) != (256u | 256u << 9 | 256u << 18 | 16u << 27);
+    failures += hdr::scalar::packR11G11B10(1.0f, 1.0f, 1.0f) != (0x3C0u | 0x3C0u << 11 | 0x1E0u << 22);
+    std::cout << (failures == 0 ? "all kernels match the scalar reference" : "MISMATCHES: " + std::to_string(failures))
+              << std::endl;
+
+    std::vector<uint16_t> half(count * 4);
+    std::vector<uint32_t> packed(count);
+    report("rgba32f -> rgba16f", megapixels, secondsPerCall([&]
+                                                            { hdr::floatToHalf(source.data(), half.data(), count * 4); }),
+           secondsPerCall([&]
+                          { hdr::scalar::floatToHalf(source.data(), half.data(), count * 4); }),
+           8);
+    report("rgb32f -> rgb9e5", megapixels, secondsPerCall([&]
+                                                          { hdr::packRgb9e5(source.data(), 3, packed.data(), count); }),
+           secondsPerCall([&]
+                          { hdr::scalar::packRgb9e5(source.data(), 3, packed.data(), count); }),
+           4);
+    report("rgba32f -> rgb9e5", megapixels, secondsPerCall([&]
+                                                           { hdr::packRgb9e5(source.data(), 4, packed.data(), count); }),
+           secondsPerCall([&]
+                          { hdr::scalar::packRgb9e5(source.data(), 4, packed.data(), count); }),
+           4);
+    report("rgb32f -> r11g11b10f", megapixels,
+           secondsPerCall([&]
+                          { hdr::packR11G11B10(source.data(), 3, packed.data(), count); }),
+           secondsPerCall([&]
+                          { hdr::scalar::packR11G11B10(source.data(), 3, packed.data(), count); }),
+           4);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,127 @@
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "image_compare.hpp"
+#include "thread_pool.hpp"
+
+// usage: image_compare_bench
+// Checks the SIMD frame comparison against diff::scalar on random, identical and slightly
+// perturbed images of awkward sizes, then times one 1080p comparison and a sequence of
+// them spread over the thread pool, as the golden image checks run.
+
+namespace
+{
+    std::vector<unsigned char> randomImage(int width, int height, uint32_t seed)
+    {
+        std::vector<unsigned char> rgba(static_cast<size_t>(width) * height * 4);
+        for (unsigned char &c : rgba)
+        {
+            seed = seed * 1664525u + 1013904223u;
+            c = static_cast<unsigned char>(seed >> 24);
+        }
+        return rgba;
+    }
+
+    // a copy with every few pixels nudged by up to +-amount, alpha scrambled
+    std::vector<unsigned char> perturbed(const std::vector<unsigned char> &rgba, int amount, uint32_t seed)
+    {
+        std::vector<unsigned char> result(rgba);
+        for (size_t i = 0; i < result.size(); i++)
+        {
+            seed = seed * 1664525u + 1013904223u;
+            if (i % 4 == 3)
+            {
+                result[i] = static_cast<unsigned char>(seed >> 24);
+            }
+            else if ((seed >> 28) == 0)
+            {
+                int value = result[i] + static_cast<int>((seed >> 8) % (2 * amount + 1)) - amount;
+                result[i] = static_cast<unsigned char>(value < 0 ? 0 : value > 255 ? 255 : value);
+            }
+        }
+        return result;
+    }
+
+    bool same(const diff::Result &a, const diff::Result &b)
+    {
+        return a.pixelsOver == b.pixelsOver && a.maxDifference == b.maxDifference &&
+               a.meanDifference == b.meanDifference && a.ssim == b.ssim;
+    }
+} // namespace
+
+int main()
+{
+    auto milliseconds = [](auto fn)
+    {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    bool valid = true;
+    // sizes that leave SIMD tails and partial SSIM windows
+    const int sizes[][2] = {{1, 1}, {7, 3}, {17, 9}, {257, 129}, {640, 360}};
+    for (const auto &size : sizes)
+    {
+        std::vector<unsigned char> a = randomImage(size[0], size[1], 1);
+        std::vector<unsigned char> b = randomImage(size[0], size[1], 2);
+        std::vector<unsigned char> c = perturbed(a, 3, 3);
+        for (int tolerance : {0, 2, 40, 255})
+        {
+            for (const std::vector<unsigned char> *other : {&a, &b, &c})
+            {
+                diff::Result fast = diff::compare(a.data(), other->data(), size[0], size[1], tolerance);
+                diff::Result reference = diff::scalar::compare(a.data(), other->data(), size[0], size[1], tolerance);
+                if (!same(fast, reference))
+                {
+                    std::cerr << size[0] << "x" << size[1] << " tolerance " << tolerance
+                              << ": SIMD result differs from scalar" << std::endl;
+                    valid = false;
+                }
+            }
+        }
+        diff::Result identical = diff::compare(a.data(), a.data(), size[0], size[1], 0);
+        if (identical.pixelsOver != 0 || identical.maxDifference != 0 || identical.ssim != 1.0)
+        {
+            std::cerr << size[0] << "x" << size[1] << ": identical images compare as different" << std::endl;
+            valid = false;
+        }
+        diff::Result nudged = diff::compare(a.data(), c.data(), size[0], size[1], 3);
+        if (nudged.pixelsOver != 0 || nudged.maxDifference > 3)
+        {
+            std::cerr << size[0] << "x" << size[1] << ": differences within tolerance were counted" << std::endl;
+            valid = false;
+        }
+    }
+
+    const int width = 1920, height = 1080, frames = 16;
+    std::vector<unsigned char> golden = randomImage(width, height, 4);
+    std::vector<unsigned char> frame = perturbed(golden, 2, 5);
+    double pixels = static_cast<double>(width) * height;
+    double scalar = milliseconds([&] { diff::scalar::compare(frame.data(), golden.data(), width, height, 2); });
+    double simd = milliseconds([&] { diff::compare(frame.data(), golden.data(), width, height, 2); });
+    std::cout << width << "x" << height << " compare: scalar " << scalar << " ms (" << pixels / scalar / 1e3
+              << " Mpixels/s), SIMD " << simd << " ms (" << pixels / simd / 1e3 << " Mpixels/s)" << std::endl;
+
+    std::vector<unsigned char> map;
+    double heatmap = milliseconds([&] { diff::heatmap(map, frame.data(), golden.data(), width, height, 2); });
+    std::cout << "heatmap: " << heatmap << " ms" << std::endl;
+
+    ThreadPool &pool = ThreadPool::shared();
+    std::vector<diff::Result> results(frames);
+    double parallel = milliseconds([&] {
+        pool.parallelFor(frames, 1, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++)
+            {
+                results[i] = diff::compare(frame.data(), golden.data(), width, height, 2);
+            }
+        });
+    });
+    std::cout << frames << " comparisons on " << pool.threadCount() << " threads: " << parallel << " ms, "
+              << frames * 1000.0 / parallel << " frames/s" << std::endl;
+
+    std::cout << (valid ? "checks passed" : "CHECKS FAILED") << std::endl;
+    return valid ? 0 : 1;
+}
@@ -0,0 +1,136 @@
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "image_arena.hpp"
+#include "image_encode.hpp"
+#include "stb_image.h"
+#include "thread_pool.hpp"
+
+// usage: image_encode_bench
+// Round trips a synthetic rendered frame (flat background, shaded and textured shapes)
+// through the PNG encoder and stb_image, then times single frame encoding and a frame
+// sequence spread over the thread pool, as the offline renderer does.
+
+namespace
+{
+    // something like a rendered frame: smooth gradients, hard edges and a noisy texture
+    std::vector<unsigned char> syntheticFrame(int width, int height, int seed)
+    {
+        std::vector<unsigned char> rgba(static_cast<size_t>(width) * height * 4);
+        uint32_t noise = 12345u + static_cast<uint32_t>(seed);
+        for (int y = 0; y < height; y++)
+        {
+            for (int x = 0; x < width; x++)
+            {
+                unsigned char *p = &rgba[(static_cast<size_t>(y) * width + x) * 4];
+                p[0] = 51, p[1] = 77, p[2] = 77, p[3] = 255;
+                float dx = x - width * (0.3f + 0.01f * seed), dy = y - height * 0.5f;
+                float r = std::sqrt(dx * dx + dy * dy);
+                if (r < height * 0.3f)
+                {
+                    float shade = 1.0f - r / (height * 0.3f);
+                    p[0] = static_cast<unsigned char>(60 + 190 * shade);
+                    p[1] = static_cast<unsigned char>(40 + 120 * shade);
+                    p[2] = static_cast<unsigned char>(20 + 40 * shade);
+                }
+                else if (x > width * 0.6f && y > height * 0.2f && y < height * 0.8f)
+                {
+                    noise = noise * 1664525u + 1013904223u;
+                    unsigned char grain = static_cast<unsigned char>(noise >> 27);
+                    p[0] = static_cast<unsigned char>(150 + grain);
+                    p[1] = static_cast<unsigned char>(110 + grain);
+                    p[2] = static_cast<unsigned char>(70 + grain);
+                }
+            }
+        }
+        return rgba;
+    }
+
+    bool roundTrips(const std::vector<unsigned char> &rgba, int width, int height, bool bottomUp)
+    {
+        std::vector<unsigned char> png;
+        encodePng(png, rgba.data(), width, height, bottomUp);
+        int w = 0, h = 0, channels = 0;
+        unsigned char *decoded = stbi_load_from_memory(png.data(), static_cast<int>(png.size()), &w, &h, &channels, 3);
+        bool same = decoded != nullptr && w == width && h == height && channels == 3;
+        for (int y = 0; same && y < height; y++)
+        {
+            int sourceRow = bottomUp ? height - 1 - y : y;
+            for (int x = 0; same && x < width; x++)
+            {
+                const unsigned char *expected = &rgba[(static_cast<size_t>(sourceRow) * width + x) * 4];
+                const unsigned char *actual = &decoded[(static_cast<size_t>(y) * width + x) * 3];
+                same = std::memcmp(expected, actual, 3) == 0;
+            }
+        }
+        ImageArena::local().reset();
+        return same;
+    }
+} // namespace
+
+int main()
+{
+    auto milliseconds = [](auto fn)
+    {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    bool valid = true;
+    // odd sizes catch row and match edge cases, 1x1 the smallest stream
+    const int sizes[][2] = {{1, 1}, {7, 3}, {257, 129}, {640, 360}};
+    for (const auto &size : sizes)
+    {
+        std::vector<unsigned char> frame = syntheticFrame(size[0], size[1], 0);
+        for (bool bottomUp : {false, true})
+        {
+            if (!roundTrips(frame, size[0], size[1], bottomUp))
+            {
+                std::cerr << size[0] << "x" << size[1] << (bottomUp ? " bottom up" : "") << " did not round trip"
+                          << std::endl;
+                valid = false;
+            }
+        }
+    }
+    // long runs of one colour exercise the longest matches
+    std::vector<unsigned char> flat(1024 * 64 * 4, 200);
+    if (!roundTrips(flat, 1024, 64, false))
+    {
+        std::cerr << "flat image did not round trip" << std::endl;
+        valid = false;
+    }
+
+    const int width = 1920, height = 1080, frames = 16;
+    std::vector<std::vector<unsigned char>> sequence;
+    for (int i = 0; i < frames; i++)
+    {
+        sequence.push_back(syntheticFrame(width, height, i));
+    }
+    std::vector<unsigned char> png;
+    encodePng(png, sequence[0].data(), width, height, true);
+    double single = milliseconds([&] { encodePng(png, sequence[0].data(), width, height, true); });
+    double raw = static_cast<double>(width) * height * 3;
+    std::cout << width << "x" << height << " frame: " << single << " ms, " << raw / single / 1e3 << " MB/s, "
+              << png.size() * 100.0 / raw << "% of raw RGB" << std::endl;
+
+    ThreadPool &pool = ThreadPool::shared();
+    std::vector<std::vector<unsigned char>> encoded(frames);
+    double parallel = milliseconds([&] {
+        pool.parallelFor(frames, 1, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++)
+            {
+                encodePng(encoded[i], sequence[i].data(), width, height, true);
+            }
+        });
+    });
+    std::cout << frames << " frames on " << pool.threadCount() << " threads: " << parallel << " ms, "
+              << frames * 1000.0 / parallel << " frames/s" << std::endl;
+
+    std::cout << (valid ? "checks passed" : "CHECKS FAILED") << std::endl;
+    return valid ? 0 : 1;
+}
@@ -0,0 +1,593 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "image_arena.hpp"
+#include "jpeg_decoder.hpp"
+#include "mapped_file.hpp"
+#include "stb_image.h"
+
+// usage: jpeg_bench [file or directory ...]   (also $ASSETS_DIR)
+// Checks the fast JPEG path against stb_image, then times stb_image, the scalar
+// fast path and the SIMD fast path. The bench always encodes its own corpus: one
+// image at several resolutions, grey and with 4:4:4, 4:2:2 and 4:2:0 chroma, plus
+// restart intervals. JPEGs given on the command line or found under ASSETS_DIR are
+// checked as well; a file that cannot be read counts as a failure.
+
+namespace
+{
+    // time fn() for roughly a quarter of a second, returns seconds per call
+    template <typename F>
+    double timeIt(F fn)
+    {
+        fn();
+        int iterations = 0;
+        auto start = std::chrono::steady_clock::now();
+        std::chrono::duration<double> elapsed{};
+        do
+        {
+            fn();
+            iterations++;
+            elapsed = std::chrono::steady_clock::now() - start;
+        } while (elapsed.count() < 0.25);
+        return elapsed.count() / iterations;
+    }
+
+    std::vector<std::filesystem::path> collect(int argc, char **argv)
+    {
+        std::vector<std::filesystem::path> roots;
+        for (int i = 1; i < argc; i++)
+        {
+            roots.emplace_back(argv[i]);
+        }
+        if (roots.empty() && std::getenv("ASSETS_DIR") != nullptr)
+        {
+            roots.emplace_back(std::getenv("ASSETS_DIR"));
+        }
+
+        std::vector<std::filesystem::path> files;
+        for (const std::filesystem::path &root : roots)
+        {
+            if (std::filesystem::is_directory(root))
+            {
+                for (const auto &entry : std::filesystem::recursive_directory_iterator(root))
+                {
+                    std::string ext = entry.path().extension().string();
+                    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+                    if (entry.is_regular_file() && (ext == ".jpg" || ext == ".jpeg"))
+                    {
+                        files.push_back(entry.path());
+                    }
+                }
+            }
+            else
+            {
+                files.push_back(root);
+            }
+        }
+        std::sort(files.begin(), files.end());
+        return files;
+    }
+
+    // ---------------------------------------------------------------------------
+    // Baseline encoder for the synthetic corpus: float DCT, the example quantisation
+    // and Huffman tables of ITU T.81 annex K. Slow and simple, only the output matters.
+
+    const int ZIGZAG[64] = {0,  1,  8,  16, 9,  2,  3,  10, 17, 24, 32, 25, 18, 11, 4,  5,
+                            12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6,  7,  14, 21, 28,
+                            35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+                            58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63};
+
+    const int LUMA_QUANT[64] = {16, 11, 10, 16, 24,  40,  51,  61,  12, 12, 14, 19, 26,  58,  60,  55,
+                                14, 13, 16, 24, 40,  57,  69,  56,  14, 17, 22, 29, 51,  87,  80,  62,
+                                18, 22, 37, 56, 68,  109, 103, 77,  24, 35, 55, 64, 81,  104, 113, 92,
+                                49, 64, 78, 87, 103, 121, 120, 101, 72, 92, 95, 98, 112, 100, 103, 99};
+
+    const int CHROMA_QUANT[64] = {17, 18, 24, 47, 99, 99, 99, 99, 18, 21, 26, 66, 99, 99, 99, 99,
+                                  24, 26, 56, 99, 99, 99, 99, 99, 47, 66, 99, 99, 99, 99, 99, 99,
+                                  99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+                                  99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99};
+
+    struct HuffmanSpec
+    {
+        uint8_t bits[16]; // code count per length
+        std::vector<uint8_t> values;
+    };
+
+    const HuffmanSpec DC_LUMA = {{0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0},
+                                 {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11}};
+    const HuffmanSpec DC_CHROMA = {{0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0},
+                                   {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11}};
+    const HuffmanSpec AC_LUMA = {
+        {0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d},
+        {0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07, 0x22, 0x71,
+         0x14, 0x32, 0x81, 0x91, 0xa1, 0x08, 0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0, 0x24, 0x33, 0x62, 0x72,
+         0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28, 0x29, 0x2a, 0x34, 0x35, 0x36, 0x37,
+         0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59,
+         0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x83,
+         0x84, 0x85, 0x86, 0x87, 0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3,
+         0xa4, 0xa5, 0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3,
+         0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+         0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa}};
+    const HuffmanSpec AC_CHROMA = {
+        {0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77},
+        {0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71, 0x13, 0x22,
+         0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0, 0x15, 0x62, 0x72, 0xd1,
+         0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26, 0x27, 0x28, 0x29, 0x2a, 0x35, 0x36,
+         0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58,
+         0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a,
+         0x82, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a,
+         0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba,
+         0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda,
+         0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa}};
+
+    // canonical codes by symbol
+    struct HuffmanCode
+    {
+        uint16_t code[256] = {};
+        uint8_t length[256] = {};
+
+        explicit HuffmanCode(const HuffmanSpec &spec)
+        {
+            uint32_t code = 0;
+            size_t k = 0;
+            for (int len = 1; len <= 16; len++)
+            {
+                for (int i = 0; i < spec.bits[len - 1]; i++, k++)
+                {
+                    this->code[spec.values[k]] = static_cast<uint16_t>(code++);
+                    length[spec.values[k]] = static_cast<uint8_t>(len);
+                }
+                code <<= 1;
+            }
+        }
+    };
+
+    class BitWriter
+    {
+    public:
+        explicit BitWriter(std::vector<unsigned char> &out) : m_out(out) {};
+
+        void put(uint32_t bits, int count)
+        {
+            m_buffer = (m_buffer << count) | (bits & ((1u << count) - 1));
+            m_count += count;
+            while (m_count >= 8)
+            {
+                unsigned char byte = static_cast<unsigned char>(m_buffer >> (m_count - 8));
+                m_out.push_back(byte);
+                if (byte == 0xFF)
+                {
+                    m_out.push_back(0); // stuffing
+                }
+                m_count -= 8;
+            }
+            m_buffer &= (1u << m_count) - 1;
+        }
+
+        // pads the last byte with 1 bits
+        void flush()
+        {
+            if (m_count > 0)
+            {
+                put(0x7F, 8 - m_count);
+            }
+        }
+
+    private:
+        // vars
+        std::vector<unsigned char> &m_out;
+        uint32_t m_buffer = 0;
+        int m_count = 0;
+    };
+
+    void putU16(std::vector<unsigned char> &out, int v)
+    {
+        out.push_back(static_cast<unsigned char>(v >> 8));
+        out.push_back(static_cast<unsigned char>(v));
+    }
+
+    // magnitude category and its value bits, as DC differences and AC values are coded
+    int category(int v)
+    {
+        int bits = 0;
+        for (int a = std::abs(v); a != 0; a >>= 1)
+        {
+            bits++;
+        }
+        return bits;
+    }
+
+    // rgb is width * height * 3; components 1 encodes luma only. hSampling / vSampling are
+    // the luma factors, chroma is always 1x1. restartInterval in MCUs, 0 for none.
+    std::vector<unsigned char> encodeJpeg(const unsigned char *rgb, int width, int height, int components,
+                                          int hSampling, int vSampling, int quality, int restartInterval)
+    {
+        int scale = quality < 50 ? 5000 / quality : 200 - quality * 2;
+        int quant[2][64];
+        for (int i = 0; i < 64; i++)
+        {
+            quant[0][i] = std::clamp((LUMA_QUANT[i] * scale + 50) / 100, 1, 255);
+            quant[1][i] = std::clamp((CHROMA_QUANT[i] * scale + 50) / 100, 1, 255);
+        }
+        const HuffmanSpec *specs[4] = {&DC_LUMA, &AC_LUMA, &DC_CHROMA, &AC_CHROMA};
+        const HuffmanCode codes[4] = {HuffmanCode(DC_LUMA), HuffmanCode(AC_LUMA), HuffmanCode(DC_CHROMA),
+                                      HuffmanCode(AC_CHROMA)};
+        if (components == 1)
+        {
+            hSampling = vSampling = 1;
+        }
+
+        // full resolution YCbCr with a level shift of 128
+        size_t count = static_cast<size_t>(width) * height;
+        std::vector<float> planes[3];
+        for (int c = 0; c < components; c++)
+        {
+            planes[c].resize(count);
+        }
+        for (size_t i = 0; i < count; i++)
+        {
+            float r = rgb[i * 3], g = rgb[i * 3 + 1], b = rgb[i * 3 + 2];
+            planes[0][i] = 0.299f * r + 0.587f * g + 0.114f * b - 128.0f;
+            if (components == 3)
+            {
+                planes[1][i] = -0.168736f * r - 0.331264f * g + 0.5f * b;
+                planes[2][i] = 0.5f * r - 0.418688f * g - 0.081312f * b;
+            }
+        }
+
+        std::vector<unsigned char> out = {0xFF, 0xD8};
+        out.insert(out.end(), {0xFF, 0xDB});
+        putU16(out, 2 + 65 * 2);
+        for (int t = 0; t < 2; t++)
+        {
+            out.push_back(static_cast<unsigned char>(t));
+            for (int k = 0; k < 64; k++)
+            {
+                out.push_back(static_cast<unsigned char>(quant[t][ZIGZAG[k]]));
+            }
+        }
+        out.insert(out.end(), {0xFF, 0xC0});
+        putU16(out, 8 + 3 * components);
+        out.push_back(8);
+        putU16(out, height);
+        putU16(out, width);
+        out.push_back(static_cast<unsigned char>(components));
+        for (int c = 0; c < components; c++)
+        {
+            out.push_back(static_cast<unsigned char>(c + 1));
+            out.push_back(static_cast<unsigned char>(c == 0 ? hSampling << 4 | vSampling : 0x11));
+            out.push_back(static_cast<unsigned char>(c == 0 ? 0 : 1));
+        }
+        out.insert(out.end(), {0xFF, 0xC4});
+        putU16(out, 2 + 4 * 17 + 12 + 12 + 162 + 162);
+        const unsigned char tableIds[4] = {0x00, 0x10, 0x01, 0x11};
+        for (int t = 0; t < 4; t++)
+        {
+            out.push_back(tableIds[t]);
+            out.insert(out.end(), specs[t]->bits, specs[t]->bits + 16);
+            out.insert(out.end(), specs[t]->values.begin(), specs[t]->values.end());
+        }
+        if (restartInterval > 0)
+        {
+            out.insert(out.end(), {0xFF, 0xDD});
+            putU16(out, 4);
+            putU16(out, restartInterval);
+        }
+        out.insert(out.end(), {0xFF, 0xDA});
+        putU16(out, 6 + 2 * components);
+        out.push_back(static_cast<unsigned char>(components));
+        for (int c = 0; c < components; c++)
+        {
+            out.push_back(static_cast<unsigned char>(c + 1));
+            out.push_back(static_cast<unsigned char>(c == 0 ? 0x00 : 0x11));
+        }
+        out.insert(out.end(), {0, 63, 0});
+
+        float basis[8][8]; // basis[u][x], with the DCT normalisation folded in
+        for (int u = 0; u < 8; u++)
+        {
+            for (int x = 0; x < 8; x++)
+            {
+                basis[u][x] = (u == 0 ? std::sqrt(0.125f) : 0.5f) *
+                              static_cast<float>(std::cos((2 * x + 1) * u * 3.14159265358979323846 / 16.0));
+            }
+        }
+
+        BitWriter bits(out);
+        int previousDc[3] = {};
+        // one 8x8 block of component c at block (bx, by) of its own, possibly subsampled, grid
+        auto encodeBlock = [&](int c, int bx, int by)
+        {
+            int sx = c == 0 ? 1 : hSampling, sy = c == 0 ? 1 : vSampling;
+            float block[8][8];
+            for (int y = 0; y < 8; y++)
+            {
+                for (int x = 0; x < 8; x++)
+                {
+                    // average of the covered source pixels, edge pixels repeat past the image
+                    float sum = 0.0f;
+                    for (int j = 0; j < sy; j++)
+                    {
+                        for (int i = 0; i < sx; i++)
+                        {
+                            int px = std::min(((bx * 8 + x) * sx + i), width - 1);
+                            int py = std::min(((by * 8 + y) * sy + j), height - 1);
+                            sum += planes[c][static_cast<size_t>(py) * width + px];
+                        }
+                    }
+                    block[y][x] = sum / static_cast<float>(sx * sy);
+                }
+            }
+            int coefficients[64];
+            for (int v = 0; v < 8; v++)
+            {
+                for (int u = 0; u < 8; u++)
+                {
+                    float sum = 0.0f;
+                    for (int y = 0; y < 8; y++)
+                    {
+                        for (int x = 0; x < 8; x++)
+                        {
+                            sum += block[y][x] * basis[u][x] * basis[v][y];
+                        }
+                    }
+                    coefficients[v * 8 + u] = static_cast<int>(std::lround(sum / quant[c == 0 ? 0 : 1][v * 8 + u]));
+                }
+            }
+
+            const HuffmanCode &dc = codes[c == 0 ? 0 : 2];
+            const HuffmanCode &ac = codes[c == 0 ? 1 : 3];
+            int diff = coefficients[0] - previousDc[c];
+            previousDc[c] = coefficients[0];
+            int size = category(diff);
+            bits.put(dc.code[size], dc.length[size]);
+            bits.put(static_cast<uint32_t>(diff < 0 ? diff - 1 : diff), size);
+            int run = 0;
+            for (int k = 1; k < 64; k++)
+            {
+                int value = coefficients[ZIGZAG[k]];
+                if (value == 0)
+                {
+                    run++;
+                    continue;
+                }
+                for (; run >= 16; run -= 16)
+                {
+                    bits.put(ac.code[0xF0], ac.length[0xF0]);
+                }
+                size = category(value);
+                int symbol = run << 4 | size;
+                bits.put(ac.code[symbol], ac.length[symbol]);
+                bits.put(static_cast<uint32_t>(value < 0 ? value - 1 : value), size);
+                run = 0;
+            }
+            if (run > 0)
+            {
+                bits.put(ac.code[0], ac.length[0]);
+            }
+        };
+
+        int mcusX = (width + 8 * hSampling - 1) / (8 * hSampling);
+        int mcusY = (height + 8 * vSampling - 1) / (8 * vSampling);
+        int mcu = 0, marker = 0;
+        for (int my = 0; my < mcusY; my++)
+        {
+            for (int mx = 0; mx < mcusX; mx++, mcu++)
+            {
+                if (restartInterval > 0 && mcu > 0 && mcu % restartInterval == 0)
+                {
+                    bits.flush();
+                    out.insert(out.end(), {0xFF, static_cast<unsigned char>(0xD0 + (marker++ & 7))});
+                    std::fill(previousDc, previousDc + 3, 0);
+                }
+                for (int y = 0; y < vSampling; y++)
+                {
+                    for (int x = 0; x < hSampling; x++)
+                    {
+                        encodeBlock(0, mx * hSampling + x, my * vSampling + y);
+                    }
+                }
+                for (int c = 1; c < components; c++)
+                {
+                    encodeBlock(c, mx, my);
+                }
+            }
+        }
+        bits.flush();
+        out.insert(out.end(), {0xFF, 0xD9});
+        return out;
+    }
+
+    // smooth gradients, a sharp checker and some noise: photo-like coefficient statistics
+    std::vector<unsigned char> syntheticImage(int width, int height)
+    {
+        std::vector<unsigned char> rgb(static_cast<size_t>(width) * height * 3);
+        uint32_t seed = 7;
+        for (int y = 0; y < height; y++)
+        {
+            for (int x = 0; x < width; x++)
+            {
+                float u = static_cast<float>(x) / width, v = static_cast<float>(y) / height;
+                int checker = ((x / 24) ^ (y / 24)) & 1 ? 40 : -40;
+                unsigned char *p = &rgb[(static_cast<size_t>(y) * width + x) * 3];
+                for (int c = 0; c < 3; c++)
+                {
+                    seed = seed * 1664525u + 1013904223u;
+                    float wave = 60.0f * std::sin(6.0f * u + 4.0f * v + 2.0f * c);
+                    int value = static_cast<int>(128.0f + wave + 50.0f * (c == 0 ? u : v)) + checker +
+                                static_cast<int>(seed >> 28) - 8;
+                    p[c] = static_cast<unsigned char>(std::clamp(value, 0, 255));
+                }
+            }
+        }
+        return rgb;
+    }
+
+    struct Input
+    {
+        std::string name;
+        std::vector<unsigned char> data;
+    };
+
+    std::vector<Input> syntheticCorpus()
+    {
+        struct Layout
+        {
+            const char *name;
+            int components, h, v, restart;
+        };
+        const Layout layouts[] = {{"grey", 1, 1, 1, 0},   {"444", 3, 1, 1, 0}, {"422", 3, 2, 1, 0},
+                                  {"420", 3, 2, 2, 0},    {"420-rst", 3, 2, 2, 7}};
+        const int sizes[][2] = {{1, 1}, {17, 9}, {333, 217}, {512, 512}, {1920, 1080}};
+        std::vector<Input> corpus;
+        for (const auto &size : sizes)
+        {
+            std::vector<unsigned char> rgb = syntheticImage(size[0], size[1]);
+            for (const Layout &layout : layouts)
+            {
+                corpus.push_back(Input{std::string("synthetic-") + layout.name + "-" + std::to_string(size[0]) + "x" +
+                                           std::to_string(size[1]),
+                                       encodeJpeg(rgb.data(), size[0], size[1], layout.components, layout.h,
+                                                  layout.v, 90, layout.restart)});
+            }
+        }
+        return corpus;
+    }
+
+    // A 512x512 frame header with luma at 3x1 and chroma at 2x1 sampling: 3 is not a
+    // multiple of 2, so the chroma planes cannot be upsampled to the luma grid. Both
+    // the header parser and loading as a whole have to refuse it.
+    bool rejectsBadSampling()
+    {
+        const unsigned char header[] = {0xFF, 0xD8, 0xFF, 0xC0, 0x00, 0x11, 0x08, 0x02, 0x00, 0x02, 0x00, 0x03,
+                                        0x01, 0x31, 0x00, 0x02, 0x21, 0x01, 0x03, 0x11, 0x01, 0xFF, 0xD9};
+        JpegDecoder decoder;
+        int w, h, c;
+        bool rejected = !decoder.readHeader(header, sizeof(header)) &&
+                        jpegLoadFromMemory(header, sizeof(header), &w, &h, &c, 3) == nullptr;
+        ImageArena::local().reset();
+        return rejected;
+    }
+} // namespace
+
+int main(int argc, char **argv)
+{
+    int failures = 0;
+    if (!rejectsBadSampling())
+    {
+        std::cout << "MISMATCH: accepted a jpeg whose sampling factors do not divide the largest" << std::endl;
+        failures++;
+    }
+
+    std::vector<Input> inputs = syntheticCorpus();
+    for (const std::filesystem::path &path : collect(argc, argv))
+    {
+        MappedFile file(path);
+        if (!file.isOpen())
+        {
+            std::cout << path.string() << ": FAILED (unreadable)" << std::endl;
+            failures++;
+            continue;
+        }
+        inputs.push_back(
+            Input{path.filename().string(), std::vector<unsigned char>(file.data(), file.data() + file.size())});
+    }
+
+    struct Totals
+    {
+        double pixels = 0, stb = 0, scalar = 0, simd = 0;
+    };
+    std::map<std::string, Totals> byResolution;
+
+    int compared = 0;
+    for (const Input &input : inputs)
+    {
+        const unsigned char *data = input.data.data();
+        int size = static_cast<int>(input.data.size());
+        JpegDecoder decoder;
+        if (!decoder.readHeader(data, input.data.size()))
+        {
+            std::cout << input.name << ": FAILED (" << (decoder.error() ? decoder.error() : "unreadable") << ")"
+                      << std::endl;
+            failures++;
+            continue;
+        }
+        int w = decoder.width(), h = decoder.height();
+        int channels = decoder.components() >= 3 ? 3 : 1;
+        size_t stride = static_cast<size_t>(w) * channels;
+        // stands in for a mapped PBO: the decoder writes straight into it
+        std::vector<unsigned char> scalarOut(stride * h), simdOut(stride * h);
+
+        decoder.setSimd(false);
+        bool ok = decoder.decode(scalarOut.data(), stride, channels);
+        decoder.setSimd(true);
+        ok = ok && decoder.decode(simdOut.data(), stride, channels);
+
+        int sw, sh, sc;
+        unsigned char *reference = stbi_load_from_memory(data, size, &sw, &sh, &sc, channels);
+        int maxDiff = 0;
+        size_t exact = 0;
+        bool sameSize = reference != nullptr && sw == w && sh == h;
+        if (ok && sameSize)
+        {
+            for (size_t i = 0; i < simdOut.size(); i++)
+            {
+                int diff = std::abs(simdOut[i] - reference[i]);
+                maxDiff = std::max(maxDiff, diff);
+                exact += diff == 0;
+            }
+        }
+        ImageArena::local().reset();
+        bool consistent = ok && sameSize && scalarOut == simdOut && maxDiff <= 2;
+        failures += consistent ? 0 : 1;
+        compared++;
+
+        double stbTime = timeIt([&]
+                                {
+            stbi_load_from_memory(data, size, &sw, &sh, &sc, channels);
+            ImageArena::local().reset(); });
+        decoder.setSimd(false);
+        double scalarTime = timeIt([&]
+                                   { decoder.decode(scalarOut.data(), stride, channels); });
+        decoder.setSimd(true);
+        double simdTime = timeIt([&]
+                                 { decoder.decode(simdOut.data(), stride, channels); });
+
+        double mp = static_cast<double>(w) * h / 1e6;
+        std::cout << input.name << " " << w << "x" << h << "x" << channels << (consistent ? " ok" : " MISMATCH")
+                  << " (max diff " << maxDiff << ", " << 100.0 * exact / std::max<size_t>(1, simdOut.size())
+                  << "% exact)"
+                  << "  stb " << mp / stbTime << " MP/s"
+                  << "  scalar " << mp / scalarTime << " MP/s"
+                  << "  simd " << mp / simdTime << " MP/s" << std::endl;
+
+        Totals &t = byResolution[std::to_string(w) + "x" + std::to_string(h)];
+        t.pixels += mp;
+        t.stb += stbTime;
+        t.scalar += scalarTime;
+        t.simd += simdTime;
+    }
+
+    std::cout << std::endl
+              << "resolution     stb MP/s   scalar MP/s   simd MP/s   speedup" << std::endl;
+    for (const auto &[resolution, t] : byResolution)
+    {
+        std::cout << resolution << "\t" << t.pixels / t.stb << "\t" << t.pixels / t.scalar << "\t"
+                  << t.pixels / t.simd << "\t" << t.stb / t.simd << "x" << std::endl;
+    }
+    if (compared == 0)
+    {
+        std::cout << "no jpeg was compared" << std::endl;
+        failures++;
+    }
+    std::cout << compared << " jpegs compared, " << (failures == 0 ? "checks passed" : "CHECKS FAILED") << std::endl;
+    return failures == 0 ? 0 : 1;
+}
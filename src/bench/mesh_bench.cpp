@@ -0,0 +1,163 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "mesh_optimizer.hpp"
+
+// usage: mesh_bench [segments]
+// Builds a bumpy sphere (concave enough to overdraw) with its triangles shuffled, as
+// exported meshes often are, runs the optimisers over it and prints ACMR/ATVR and
+// overdraw before and after. Also checks every pass keeps the same set of triangles.
+namespace
+{
+    struct Vertex
+    {
+        float position[3];
+        float normal[3];
+        float uv[2];
+    };
+
+    void bumpySphere(int segments, std::vector<Vertex> &vertices, std::vector<uint32_t> &indices)
+    {
+        const float PI = 3.14159265f;
+        int rings = segments / 2;
+        for (int r = 0; r <= rings; r++)
+        {
+            float theta = PI * r / rings;
+            for (int s = 0; s <= segments; s++)
+            {
+                float phi = 2.0f * PI * s / segments;
+                float radius = 1.0f + 0.3f * std::sin(6.0f * theta) * std::sin(6.0f * phi);
+                float n[3] = {std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi)};
+                vertices.push_back(Vertex{{n[0] * radius, n[1] * radius, n[2] * radius},
+                                          {n[0], n[1], n[2]},
+                                          {static_cast<float>(s) / segments, static_cast<float>(r) / rings}});
+            }
+        }
+        for (int r = 0; r < rings; r++)
+        {
+            for (int s = 0; s < segments; s++)
+            {
+                uint32_t a = r * (segments + 1) + s, b = a + segments + 1;
+                // counter-clockwise seen from outside
+                indices.insert(indices.end(), {a, a + 1, b, a + 1, b + 1, b});
+            }
+        }
+    }
+
+    // triangles as sorted, rotation independent keys, to compare index buffers as sets
+    std::vector<std::string> triangleSet(const std::vector<uint32_t> &indices, const std::vector<Vertex> &vertices)
+    {
+        std::vector<std::string> set;
+        for (size_t t = 0; t + 2 < indices.size(); t += 3)
+        {
+            std::string key[3];
+            for (int k = 0; k < 3; k++)
+            {
+                key[k].assign(reinterpret_cast<const char *>(&vertices[indices[t + k]]), sizeof(Vertex));
+            }
+            // keep the winding: rotate so the smallest key is first
+            int first = static_cast<int>(std::min_element(key, key + 3) - key);
+            set.push_back(key[first] + key[(first + 1) % 3] + key[(first + 2) % 3]);
+        }
+        std::sort(set.begin(), set.end());
+        return set;
+    }
+
+    void report(const std::string &name, const std::vector<uint32_t> &indices, const std::vector<Vertex> &vertices,
+                double milliseconds)
+    {
+        mesh::CacheStats cache = mesh::analyzeVertexCache(indices.data(), indices.size(), vertices.size());
+        mesh::OverdrawStats overdraw = mesh::analyzeOverdraw(indices.data(), indices.size(), vertices[0].position,
+                                                             vertices.size(), sizeof(Vertex));
+        std::cout << name << ": ACMR " << cache.acmr << ", ATVR " << cache.atvr << ", overdraw " << overdraw.overdraw;
+        if (milliseconds > 0.0)
+        {
+            std::cout << " (" << milliseconds << " ms)";
+        }
+        std::cout << std::endl;
+    }
+
+    template <typename F>
+    double milliseconds(F fn)
+    {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+} // namespace
+
+int main(int argc, char **argv)
+{
+    int segments = argc > 1 ? std::atoi(argv[1]) : 512;
+
+    std::vector<Vertex> grid;
+    std::vector<uint32_t> gridIndices;
+    bumpySphere(segments, grid, gridIndices);
+
+    // unindexed and shuffled, then indexed again
+    std::vector<Vertex> soup;
+    std::vector<size_t> order(gridIndices.size() / 3);
+    for (size_t t = 0; t < order.size(); t++)
+    {
+        order[t] = t;
+    }
+    std::shuffle(order.begin(), order.end(), std::mt19937(3));
+    for (size_t t : order)
+    {
+        for (int k = 0; k < 3; k++)
+        {
+            soup.push_back(grid[gridIndices[t * 3 + k]]);
+        }
+    }
+    std::vector<unsigned char> uniqueBytes;
+    std::vector<uint32_t> indices;
+    size_t unique = 0;
+    double dedupTime = milliseconds([&]
+                                    { unique = mesh::deduplicateVertices(soup.data(), soup.size(), sizeof(Vertex),
+                                                                         uniqueBytes, indices); });
+    std::vector<Vertex> vertices(unique);
+    std::copy(uniqueBytes.begin(), uniqueBytes.end(), reinterpret_cast<unsigned char *>(vertices.data()));
+    std::cout << indices.size() / 3 << " triangles, " << soup.size() << " -> " << unique << " vertices after dedup ("
+              << dedupTime << " ms)" << std::endl;
+
+    int failures = unique != grid.size();
+    std::vector<std::string> reference = triangleSet(indices, vertices);
+    report("shuffled", indices, vertices, 0.0);
+
+    std::vector<uint32_t> forsyth(indices.size()), tipsify(indices.size()), overdraw(indices.size());
+    double forsythTime = milliseconds([&]
+                                      { mesh::optimizeVertexCache(forsyth.data(), indices.data(), indices.size(),
+                                                                  vertices.size()); });
+    report("forsyth", forsyth, vertices, forsythTime);
+    failures += triangleSet(forsyth, vertices) != reference;
+
+    double tipsifyTime = milliseconds([&]
+                                      { mesh::optimizeVertexCacheFifo(tipsify.data(), indices.data(), indices.size(),
+                                                                      vertices.size()); });
+    report("tipsify", tipsify, vertices, tipsifyTime);
+    failures += triangleSet(tipsify, vertices) != reference;
+
+    double overdrawTime = milliseconds([&]
+                                       { mesh::optimizeOverdraw(overdraw.data(), forsyth.data(), forsyth.size(),
+                                                                vertices[0].position, vertices.size(), sizeof(Vertex)); });
+    report("forsyth + overdraw", overdraw, vertices, overdrawTime);
+    failures += triangleSet(overdraw, vertices) != reference;
+
+    std::vector<Vertex> fetched(vertices.size());
+    size_t fetchedCount = 0;
+    double fetchTime = milliseconds([&]
+                                    { fetchedCount = mesh::optimizeVertexFetch(fetched.data(), overdraw.data(),
+                                                                               overdraw.size(), vertices.data(),
+                                                                               vertices.size(), sizeof(Vertex)); });
+    report("+ vertex fetch", overdraw, fetched, fetchTime);
+    failures += fetchedCount != vertices.size() || triangleSet(overdraw, fetched) != reference;
+
+    std::cout << (failures == 0 ? "all passes keep the triangle set" : "MISMATCHES") << std::endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,164 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "mesh_cache.hpp"
+
+// usage: mesh_cache_bench [segments]
+// Writes a grid OBJ to the temp directory and compares importing it with opening the
+// binary cache. Checks the cache round trips the mesh, is rebuilt when the source
+// changes (and not when it is only touched), and that truncated files are rejected.
+namespace
+{
+    void writeObj(const std::filesystem::path &path, int segments, float height)
+    {
+        std::ofstream out(path, std::ios::binary);
+        char line[128];
+        for (int y = 0; y <= segments; y++)
+        {
+            for (int x = 0; x <= segments; x++)
+            {
+                out.write(line, std::snprintf(line, sizeof(line), "v %d %.4f %d\nvt %.5f %.5f\n", x,
+                                              height * ((x ^ y) & 7), y, static_cast<float>(x) / segments,
+                                              static_cast<float>(y) / segments));
+            }
+        }
+        out << "usemtl ground\n";
+        for (int y = 0; y < segments; y++)
+        {
+            for (int x = 0; x < segments; x++)
+            {
+                int a = y * (segments + 1) + x + 1, b = a + segments + 1;
+                out.write(line, std::snprintf(line, sizeof(line), "f %d/%d %d/%d %d/%d %d/%d\n", a, a, b, b, b + 1,
+                                              b + 1, a + 1, a + 1));
+            }
+        }
+    }
+
+    template <typename F>
+    double milliseconds(F fn)
+    {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    uint32_t indexAt(const mesh::MeshBlobs &blobs, size_t i)
+    {
+        if (blobs.indexType == GL_UNSIGNED_SHORT)
+        {
+            return static_cast<const uint16_t *>(blobs.indices)[i];
+        }
+        return static_cast<const uint32_t *>(blobs.indices)[i];
+    }
+
+    // same set of triangles (as vertex contents) in the import and the cache
+    bool sameMesh(const mesh::MeshData &data, const mesh::MeshBlobs &blobs)
+    {
+        if (blobs.indexCount != data.indices.size() || blobs.submeshes.size() != data.submeshes.size() ||
+            blobs.layout.stride != 32 || blobs.lods.size() != 1)
+        {
+            return false;
+        }
+        // the cache reorders triangles and vertices, compare sorted triangle contents
+        auto triangles = [](const float *vertices, size_t count, auto index)
+        {
+            std::vector<std::vector<float>> list;
+            for (size_t t = 0; t < count; t += 3)
+            {
+                std::vector<float> corners;
+                for (int k = 0; k < 3; k++)
+                {
+                    const float *v = vertices + static_cast<size_t>(index(t + k)) * 8;
+                    corners.insert(corners.end(), v, v + 8);
+                }
+                list.push_back(corners);
+            }
+            std::sort(list.begin(), list.end());
+            return list;
+        };
+        auto fromData = triangles(data.vertices.data(), data.indices.size(), [&data](size_t i)
+                                  { return data.indices[i]; });
+        auto fromCache = triangles(reinterpret_cast<const float *>(blobs.vertices), blobs.indexCount,
+                                   [&blobs](size_t i)
+                                   { return indexAt(blobs, i); });
+        return fromData == fromCache && blobs.submeshes[0].material == data.submeshes[0].material;
+    }
+} // namespace
+
+int main(int argc, char **argv)
+{
+    int segments = argc > 1 ? std::atoi(argv[1]) : 400;
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "mesh_cache_bench";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+    std::filesystem::path source = directory / "grid.obj";
+    writeObj(source, segments, 0.25f);
+    int failures = 0;
+
+    mesh::MeshData imported;
+    double importTime = milliseconds([&]
+                                     { mesh::loadMesh(source, imported); });
+
+    mesh::MeshCache::Settings settings;
+    settings.optimize = true;
+    mesh::MeshCache cache(directory / "cache", settings);
+    mesh::MeshCacheFile file;
+    double buildTime = milliseconds([&]
+                                    { failures += !cache.load(source, file); });
+    failures += !cache.rebuilt();
+    file.close();
+    double openTime = milliseconds([&]
+                                   { failures += !cache.load(source, file); });
+    failures += cache.rebuilt();
+
+    std::cout << imported.indices.size() / 3 << " triangles, " << std::filesystem::file_size(source) / 1024 << " KB OBJ, "
+              << std::filesystem::file_size(cache.cachePath(source)) / 1024 << " KB cache ("
+              << (file.blobs().indexType == GL_UNSIGNED_SHORT ? "16" : "32") << " bit indices)" << std::endl;
+    std::cout << "import " << importTime << " ms, first load + write " << buildTime << " ms, cached open " << openTime
+              << " ms" << std::endl;
+    bool same = sameMesh(imported, file.blobs());
+    std::cout << "round trip " << (same ? "matches" : "DIFFERS") << std::endl;
+    failures += !same;
+
+    // a touch keeps the cache, an edit rebuilds it
+    file.close();
+    std::filesystem::last_write_time(source, std::filesystem::last_write_time(source) + std::chrono::seconds(5));
+    failures += !cache.load(source, file) || cache.rebuilt();
+    file.close();
+    failures += !cache.load(source, file) || cache.rebuilt();
+    file.close();
+    writeObj(source, segments, 0.5f);
+    failures += !cache.load(source, file) || !cache.rebuilt();
+    std::cout << "touch keeps, edit rebuilds: " << (failures == 0 ? "yes" : "NO") << std::endl;
+    file.close();
+
+    // quantized vertices through the same path
+    mesh::MeshCache::Settings quantized = settings;
+    quantized.quantize = true;
+    mesh::MeshCache small(directory / "cache", quantized);
+    failures += small.cachePath(source) == cache.cachePath(source);
+    failures += !small.load(source, file) || !small.rebuilt() || file.blobs().layout.stride >= 32;
+    std::cout << "quantized stride " << file.blobs().layout.stride << ", "
+              << std::filesystem::file_size(small.cachePath(source)) / 1024 << " KB" << std::endl;
+    file.close();
+
+    // truncation must be caught by the size checks
+    std::filesystem::path broken = directory / "broken.mesh";
+    std::filesystem::copy_file(cache.cachePath(source), broken);
+    std::filesystem::resize_file(broken, std::filesystem::file_size(broken) - 100);
+    bool rejected = !file.open(broken);
+    std::cout << "truncated file " << (rejected ? "rejected" : "ACCEPTED") << std::endl;
+    failures += !rejected;
+
+    std::filesystem::remove_all(directory);
+    std::cout << (failures == 0 ? "all checks passed" : "FAILED") << std::endl;
+    return failures == 0 ? 0 : 1;
+}
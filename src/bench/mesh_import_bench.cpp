@@ -0,0 +1,273 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "mesh_import.hpp"
+
+// usage: mesh_import_bench [segments]
+// Writes a bumpy sphere as OBJ (quads, two materials, a relative-index tail) and as
+// glb into the temp directory, loads both single and multithreaded and checks counts,
+// submeshes and positions. Also compares mesh::parseFloat against strtof.
+// 2048 segments makes a ~300 MB OBJ.
+namespace
+{
+    const float PI = 3.14159265f;
+
+    void spherePoint(int segments, int r, int s, float *position, float *normal, float *uv)
+    {
+        int rings = segments / 2;
+        float theta = PI * r / rings, phi = 2.0f * PI * s / segments;
+        float radius = 1.0f + 0.3f * std::sin(6.0f * theta) * std::sin(6.0f * phi);
+        float n[3] = {std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi)};
+        for (int k = 0; k < 3; k++)
+        {
+            position[k] = n[k] * radius;
+            normal[k] = n[k];
+        }
+        uv[0] = static_cast<float>(s) / segments;
+        uv[1] = static_cast<float>(r) / rings;
+    }
+
+    // returns the expected triangle count
+    size_t writeObj(const std::filesystem::path &path, int segments)
+    {
+        int rings = segments / 2;
+        std::ofstream out(path, std::ios::binary);
+        std::vector<char> buffer(1 << 20);
+        out.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+        char line[160];
+        for (int r = 0; r <= rings; r++)
+        {
+            for (int s = 0; s <= segments; s++)
+            {
+                float p[3], n[3], uv[2];
+                spherePoint(segments, r, s, p, n, uv);
+                out.write(line, std::snprintf(line, sizeof(line), "v %.6f %.6f %.6f\nvn %.5f %.5f %.5f\nvt %.5f %.5f\n",
+                                              p[0], p[1], p[2], n[0], n[1], n[2], uv[0], uv[1]));
+            }
+        }
+        size_t triangles = 0;
+        for (int r = 0; r < rings; r++)
+        {
+            if (r == 0 || r == rings / 2)
+            {
+                out << "usemtl " << (r == 0 ? "north" : "south") << "\n";
+            }
+            for (int s = 0; s < segments; s++)
+            {
+                int a = r * (segments + 1) + s + 1, b = a + segments + 1;
+                out.write(line, std::snprintf(line, sizeof(line), "f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d\n", a, a, a,
+                                              a + 1, a + 1, a + 1, b + 1, b + 1, b + 1, b, b, b));
+                triangles += 2;
+            }
+        }
+        // a lone triangle with relative indices and positions only
+        out << "usemtl tail\nv 0 0 0\nv 1 0 0\nv 0 1 0\nf -3 -2 -1\n";
+        return triangles + 1;
+    }
+
+    template <typename T>
+    void append(std::vector<unsigned char> &bytes, const T *data, size_t count)
+    {
+        const unsigned char *p = reinterpret_cast<const unsigned char *>(data);
+        bytes.insert(bytes.end(), p, p + count * sizeof(T));
+    }
+
+    // one primitive, positions + normals + uvs + u32 indices, under a translated node
+    size_t writeGlb(const std::filesystem::path &path, int segments, const float *translation)
+    {
+        int rings = segments / 2;
+        std::vector<float> positions, normals, uvs;
+        std::vector<uint32_t> indices;
+        for (int r = 0; r <= rings; r++)
+        {
+            for (int s = 0; s <= segments; s++)
+            {
+                float p[3], n[3], uv[2];
+                spherePoint(segments, r, s, p, n, uv);
+                positions.insert(positions.end(), p, p + 3);
+                normals.insert(normals.end(), n, n + 3);
+                uvs.insert(uvs.end(), uv, uv + 2);
+            }
+        }
+        for (int r = 0; r < rings; r++)
+        {
+            for (int s = 0; s < segments; s++)
+            {
+                uint32_t a = r * (segments + 1) + s, b = a + segments + 1;
+                indices.insert(indices.end(), {a, a + 1, b + 1, a, b + 1, b});
+            }
+        }
+        size_t vertexCount = positions.size() / 3;
+        std::vector<unsigned char> bin;
+        append(bin, positions.data(), positions.size());
+        append(bin, normals.data(), normals.size());
+        append(bin, uvs.data(), uvs.size());
+        append(bin, indices.data(), indices.size());
+        size_t p = 0, n = vertexCount * 12, t = n * 2, i = t + vertexCount * 8;
+
+        std::string json =
+            "{\"asset\":{\"version\":\"2.0\"},\"scene\":0,\"scenes\":[{\"nodes\":[0]}],"
+            "\"nodes\":[{\"mesh\":0,\"translation\":[" +
+            std::to_string(translation[0]) + "," + std::to_string(translation[1]) + "," + std::to_string(translation[2]) +
+            "]}],\"materials\":[{\"name\":\"bumpy\"}],"
+            "\"meshes\":[{\"primitives\":[{\"attributes\":{\"POSITION\":0,\"NORMAL\":1,\"TEXCOORD_0\":2},"
+            "\"indices\":3,\"material\":0}]}],"
+            "\"buffers\":[{\"byteLength\":" +
+            std::to_string(bin.size()) + "}],\"bufferViews\":[" + "{\"buffer\":0,\"byteOffset\":" + std::to_string(p) +
+            ",\"byteLength\":" + std::to_string(n - p) + "},{\"buffer\":0,\"byteOffset\":" + std::to_string(n) +
+            ",\"byteLength\":" + std::to_string(t - n) + "},{\"buffer\":0,\"byteOffset\":" + std::to_string(t) +
+            ",\"byteLength\":" + std::to_string(i - t) + "},{\"buffer\":0,\"byteOffset\":" + std::to_string(i) +
+            ",\"byteLength\":" + std::to_string(bin.size() - i) + "}],\"accessors\":[" +
+            "{\"bufferView\":0,\"componentType\":5126,\"count\":" + std::to_string(vertexCount) +
+            ",\"type\":\"VEC3\"},{\"bufferView\":1,\"componentType\":5126,\"count\":" + std::to_string(vertexCount) +
+            ",\"type\":\"VEC3\"},{\"bufferView\":2,\"componentType\":5126,\"count\":" + std::to_string(vertexCount) +
+            ",\"type\":\"VEC2\"},{\"bufferView\":3,\"componentType\":5125,\"count\":" + std::to_string(indices.size()) +
+            ",\"type\":\"SCALAR\"}]}";
+        while (json.size() % 4)
+        {
+            json += ' ';
+        }
+        uint32_t header[5] = {0x46546C67, 2, static_cast<uint32_t>(12 + 8 + json.size() + 8 + bin.size()),
+                              static_cast<uint32_t>(json.size()), 0x4E4F534A};
+        uint32_t binHeader[2] = {static_cast<uint32_t>(bin.size()), 0x004E4942};
+        std::ofstream out(path, std::ios::binary);
+        out.write(reinterpret_cast<const char *>(header), sizeof(header));
+        out.write(json.data(), json.size());
+        out.write(reinterpret_cast<const char *>(binHeader), sizeof(binHeader));
+        out.write(reinterpret_cast<const char *>(bin.data()), bin.size());
+        return indices.size() / 3;
+    }
+
+    template <typename F>
+    double milliseconds(F fn)
+    {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // every vertex must lie on the sphere surface (up to the printed precision)
+    int checkSurface(const mesh::MeshData &data, size_t skipLast, const float *translation)
+    {
+        const int F = mesh::MeshData::FLOATS_PER_VERTEX;
+        int bad = 0;
+        for (size_t v = 0; v + skipLast < data.vertexCount(); v++)
+        {
+            const float *p = &data.vertices[v * F];
+            float q[3] = {p[0] - translation[0], p[1] - translation[1], p[2] - translation[2]};
+            float length = std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2]);
+            float dot = (q[0] * p[3] + q[1] * p[4] + q[2] * p[5]) / std::max(length, 1e-6f);
+            // normals of the file point along the radius
+            bad += length < 0.69f || length > 1.31f || (length > 1e-3f && dot < 0.999f);
+        }
+        return bad;
+    }
+
+    int compareFloats()
+    {
+        std::mt19937 rng(11);
+        std::uniform_real_distribution<float> mantissa(-1.0f, 1.0f);
+        std::uniform_int_distribution<int> exponent(-30, 30);
+        int bad = 0;
+        char text[64];
+        for (int i = 0; i < 200000; i++)
+        {
+            int length = 0;
+            switch (i % 4)
+            {
+            case 0:
+                length = std::snprintf(text, sizeof(text), "%.6f", mantissa(rng) * 1000.0f);
+                break;
+            case 1:
+                length = std::snprintf(text, sizeof(text), "%.9g", std::ldexp(mantissa(rng), exponent(rng)));
+                break;
+            case 2:
+                length = std::snprintf(text, sizeof(text), "%.3e", mantissa(rng) * std::pow(10.0f, exponent(rng)));
+                break;
+            default:
+                length = std::snprintf(text, sizeof(text), "%d", static_cast<int>(rng() % 100000));
+                break;
+            }
+            float parsed = -1.0f, reference = std::strtof(text, nullptr);
+            const char *end = mesh::parseFloat(text, text + length, parsed);
+            float ulp = std::nextafter(std::fabs(reference), INFINITY) - std::fabs(reference);
+            bad += end != text + length || std::fabs(parsed - reference) > ulp;
+        }
+        for (const char *special : {"inf", "-nan", "1e40", "0x1p-2", "1.00000000000000000000001"})
+        {
+            float parsed = 0.0f, reference = std::strtof(special, nullptr);
+            mesh::parseFloat(special, special + std::strlen(special), parsed);
+            bad += !(parsed == reference || (std::isnan(parsed) && std::isnan(reference)));
+        }
+        return bad;
+    }
+} // namespace
+
+int main(int argc, char **argv)
+{
+    int segments = argc > 1 ? std::atoi(argv[1]) : 1024;
+    int failures = 0;
+
+    int floatErrors = compareFloats();
+    std::cout << "parseFloat vs strtof: " << floatErrors << " mismatches" << std::endl;
+    failures += floatErrors != 0;
+
+    std::filesystem::path directory = std::filesystem::temp_directory_path();
+    std::filesystem::path objPath = directory / "mesh_import_bench.obj", glbPath = directory / "mesh_import_bench.glb";
+    size_t objTriangles = writeObj(objPath, segments);
+    const float translation[3] = {2.0f, -1.0f, 0.5f};
+    size_t glbTriangles = writeGlb(glbPath, segments, translation);
+    const float origin[3] = {0.0f, 0.0f, 0.0f};
+
+    for (const std::filesystem::path &path : {objPath, glbPath})
+    {
+        double megabytes = std::filesystem::file_size(path) / (1024.0 * 1024.0);
+        mesh::MeshData single, multi;
+        mesh::ImportSettings settings;
+        settings.multithreaded = false;
+        bool ok = true;
+        double singleTime = milliseconds([&]
+                                         { ok = mesh::loadMesh(path, single, settings) && ok; });
+        settings.multithreaded = true;
+        double multiTime = milliseconds([&]
+                                        { ok = mesh::loadMesh(path, multi, settings) && ok; });
+        std::cout << path.filename().string() << " (" << megabytes << " MB): " << multi.indices.size() / 3
+                  << " triangles, " << multi.vertexCount() << " vertices, " << multi.submeshes.size() << " submeshes"
+                  << std::endl;
+        std::cout << "  1 thread  " << singleTime << " ms (" << megabytes * 1000.0 / singleTime << " MB/s)" << std::endl;
+        std::cout << "  threaded  " << multiTime << " ms (" << megabytes * 1000.0 / multiTime << " MB/s)" << std::endl;
+
+        bool obj = path == objPath;
+        size_t rings = segments / 2;
+        size_t expectedVertices = (rings + 1) * (segments + 1) + (obj ? 3 : 0);
+        ok = ok && multi.indices.size() == (obj ? objTriangles : glbTriangles) * 3 &&
+             multi.vertexCount() == expectedVertices && multi.vertices.size() == single.vertices.size() &&
+             multi.indices.size() == single.indices.size() && multi.hasNormals && multi.hasUvs &&
+             multi.submeshes.size() == (obj ? 3u : 1u) && multi.submeshes[0].material == (obj ? "north" : "bumpy");
+        // single and multithreaded number vertices differently, compare what the indices point at
+        for (size_t i = 0; ok && i < multi.indices.size(); i++)
+        {
+            ok = std::memcmp(&multi.vertices[multi.indices[i] * mesh::MeshData::FLOATS_PER_VERTEX],
+                             &single.vertices[single.indices[i] * mesh::MeshData::FLOATS_PER_VERTEX],
+                             mesh::MeshData::FLOATS_PER_VERTEX * sizeof(float)) == 0;
+        }
+        int offSurface = checkSurface(multi, obj ? 3 : 0, obj ? origin : translation);
+        std::cout << "  bounds " << multi.boundsMin[0] << " " << multi.boundsMin[1] << " " << multi.boundsMin[2]
+                  << " .. " << multi.boundsMax[0] << " " << multi.boundsMax[1] << " " << multi.boundsMax[2] << ", "
+                  << offSurface << " vertices off the surface" << std::endl;
+        failures += !ok || offSurface != 0;
+        std::filesystem::remove(path);
+    }
+
+    std::cout << (failures == 0 ? "all checks passed" : "FAILED") << std::endl;
+    return failures == 0 ? 0 : 1;
+}
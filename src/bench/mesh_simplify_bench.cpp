@@ -0,0 +1,161 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "mesh_optimizer.hpp"
+#include "mesh_simplify.hpp"
+
+// usage: mesh_simplify_bench [segments]
+// Builds a level of detail chain for a bumpy sphere whose vertices carry a uv seam, checks
+// every level is a valid, smaller triangle list that leaves the seam in place, and walks a
+// camera out and back to show where the selector switches levels.
+namespace
+{
+    // 5 floats per vertex: position, uv. The s = segments column repeats s = 0 with u = 1.
+    void bumpySphere(int segments, std::vector<float> &vertices, std::vector<uint32_t> &indices)
+    {
+        const float PI = 3.14159265f;
+        int rings = segments / 2;
+        for (int r = 0; r <= rings; r++)
+        {
+            float theta = PI * r / rings;
+            for (int s = 0; s <= segments; s++)
+            {
+                float phi = 2.0f * PI * (s % segments) / segments;
+                float radius = 1.0f + 0.1f * std::sin(6.0f * theta) * std::sin(6.0f * phi);
+                vertices.insert(vertices.end(), {std::sin(theta) * std::cos(phi) * radius, std::cos(theta) * radius,
+                                                 std::sin(theta) * std::sin(phi) * radius,
+                                                 static_cast<float>(s) / segments, static_cast<float>(r) / rings});
+            }
+        }
+        for (int r = 0; r < rings; r++)
+        {
+            for (int s = 0; s < segments; s++)
+            {
+                uint32_t a = r * (segments + 1) + s, b = a + segments + 1;
+                // the pole rows would be degenerate
+                if (r > 0)
+                {
+                    indices.insert(indices.end(), {a, a + 1, b});
+                }
+                if (r < rings - 1)
+                {
+                    indices.insert(indices.end(), {a + 1, b + 1, b});
+                }
+            }
+        }
+    }
+
+    template <typename F>
+    double milliseconds(F fn)
+    {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+} // namespace
+
+int main(int argc, char **argv)
+{
+    int segments = argc > 1 ? std::atoi(argv[1]) : 256;
+    std::vector<float> vertices;
+    std::vector<uint32_t> indices;
+    bumpySphere(segments, vertices, indices);
+    size_t vertexCount = vertices.size() / 5;
+    const size_t stride = 5 * sizeof(float);
+
+    mesh::SimplifySettings settings;
+    settings.targetError = 0.05f;
+    settings.attributes = vertices.data() + 3;
+    settings.attributeStride = stride;
+    settings.attributeCount = 2;
+    std::vector<uint32_t> lodIndices;
+    std::vector<mesh::MeshLod> lods;
+    double time = milliseconds([&]
+                               { mesh::generateLods(lodIndices, lods, indices.data(), indices.size(), vertices.data(),
+                                                    vertexCount, stride, {0.5f, 0.25f, 0.1f, 0.02f}, settings); });
+
+    // seam vertices are the s = 0 and s = segments columns away from the poles
+    std::vector<uint8_t> seam(vertexCount, 0);
+    for (int r = 1; r < segments / 2; r++)
+    {
+        seam[r * (segments + 1)] = seam[r * (segments + 1) + segments] = 1;
+    }
+
+    bool valid = lods.size() > 1 && lods[0].indexCount == indices.size();
+    for (size_t l = 0; l < lods.size(); l++)
+    {
+        const mesh::MeshLod &lod = lods[l];
+        valid = valid && lod.indexCount % 3 == 0 && lod.firstIndex + lod.indexCount <= lodIndices.size();
+        valid = valid && (l == 0 || (lod.indexCount < lods[l - 1].indexCount && lod.error >= lods[l - 1].error));
+        std::vector<uint8_t> used(vertexCount, 0);
+        for (uint32_t i = 0; valid && i < lod.indexCount; i += 3)
+        {
+            const uint32_t *tri = &lodIndices[lod.firstIndex + i];
+            valid = tri[0] < vertexCount && tri[1] < vertexCount && tri[2] < vertexCount && tri[0] != tri[1] &&
+                    tri[1] != tri[2] && tri[0] != tri[2];
+            used[tri[0]] = used[tri[1]] = used[tri[2]] = 1;
+        }
+        for (size_t v = 0; valid && v < vertexCount; v++)
+        {
+            valid = !seam[v] || used[v];
+        }
+
+        mesh::CacheStats stats = mesh::analyzeVertexCache(&lodIndices[lod.firstIndex], lod.indexCount, vertexCount);
+        std::cout << "level " << l << ": " << lod.indexCount / 3 << " triangles, error " << lod.error << ", ACMR "
+                  << stats.acmr << std::endl;
+    }
+    std::cout << "generated " << lods.size() << " levels (" << time << " ms)" << std::endl;
+
+    // camera moving away and back: levels only coarsen going out and refine coming back,
+    // and the switch back happens closer than the switch out. With the default one pixel
+    // threshold the walk starts where level 1's error still covers two pixels and ends where
+    // the coarsest covers half a pixel, in 1% steps, so every level has to be entered and left.
+    mesh::LodSelector selector(lods);
+    const float FOV = 0.785f, HEIGHT = 1080.0f;
+    std::vector<float> distances;
+    if (lods.size() > 1)
+    {
+        float nearest = std::max(0.01f, 0.5f * mesh::LodSelector::projectedSize(lods[1].error, 1.0f, FOV, HEIGHT));
+        float farthest = 2.0f * mesh::LodSelector::projectedSize(lods.back().error, 1.0f, FOV, HEIGHT);
+        for (float distance = nearest; distance <= farthest; distance *= 1.01f)
+        {
+            distances.push_back(distance);
+        }
+    }
+    size_t current = 0;
+    std::vector<float> outwards(lods.size(), 0.0f), inwards(lods.size(), 0.0f);
+    for (float distance : distances)
+    {
+        size_t next = selector.select(current, distance, FOV, HEIGHT);
+        valid = valid && next >= current && next <= current + 1;
+        if (next > current)
+        {
+            outwards[next] = distance;
+        }
+        current = next;
+    }
+    valid = valid && current + 1 == lods.size();
+    for (auto it = distances.rbegin(); it != distances.rend(); ++it)
+    {
+        size_t next = selector.select(current, *it, FOV, HEIGHT);
+        valid = valid && next <= current && next + 1 >= current;
+        if (next < current)
+        {
+            inwards[current] = *it;
+        }
+        current = next;
+    }
+    valid = valid && current == 0;
+    for (size_t l = 1; l < lods.size(); l++)
+    {
+        std::cout << "level " << l << " from " << outwards[l] << " going out, until " << inwards[l] << " coming back"
+                  << std::endl;
+        valid = valid && outwards[l] > 0.0f && inwards[l] > 0.0f && inwards[l] < outwards[l];
+    }
+    std::cout << (valid ? "checks passed" : "CHECKS FAILED") << std::endl;
+    return valid ? 0 : 1;
+}
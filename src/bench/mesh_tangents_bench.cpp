@@ -0,0 +1,400 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "mesh_tangents.hpp"
+#include "primitives.hpp"
+
+// usage: mesh_tangents_bench [segments]
+// Compares the tangents of a few generated shapes corner by corner with a direct serial
+// transcription of mikktspace.c's grouping (recursive flood fill over face neighbours),
+// checks the vertices split on a uv mirror line, then times shapes of over a million
+// triangles on one thread and on the pool.
+namespace
+{
+    // MeshData layout: position, normal, uv
+    struct Shape
+    {
+        std::string name;
+        std::vector<float> vertices;
+        std::vector<uint32_t> indices;
+
+        size_t vertexCount() const
+        {
+            return vertices.size() / 8;
+        }
+
+        mesh::TangentInput input() const
+        {
+            mesh::TangentInput in;
+            in.positions = vertices.data();
+            in.normals = vertices.data() + 3;
+            in.uvs = vertices.data() + 6;
+            in.positionStride = in.normalStride = in.uvStride = 8 * sizeof(float);
+            in.vertexCount = vertexCount();
+            in.indices = indices.data();
+            in.indexCount = indices.size();
+            return in;
+        }
+    };
+
+    Shape generate(const std::string &name, mesh::PrimitiveCounts counts,
+                   const std::function<void(const mesh::GeometryStreams &)> &fn)
+    {
+        Shape shape{name, std::vector<float>(counts.vertexCount * 8), std::vector<uint32_t>(counts.indexCount)};
+        mesh::GeometryStreams out;
+        out.positions = shape.vertices.data();
+        out.normals = shape.vertices.data() + 3;
+        out.uvs = shape.vertices.data() + 6;
+        out.positionStride = out.normalStride = out.uvStride = 8 * sizeof(float);
+        out.indices = shape.indices.data();
+        fn(out);
+        return shape;
+    }
+
+    // xz grid whose u runs 1 -> 0 -> 1 across it: the middle column of vertices is shared
+    // by triangles of both orientations
+    Shape mirroredPlane(int segments)
+    {
+        Shape shape{"mirrored plane", {}, {}};
+        for (int z = 0; z <= segments; z++)
+        {
+            for (int x = 0; x <= 2 * segments; x++)
+            {
+                float u = std::fabs(static_cast<float>(x - segments)) / segments;
+                shape.vertices.insert(shape.vertices.end(), {static_cast<float>(x) / segments - 1.0f, 0.0f,
+                                                             1.0f - static_cast<float>(z) / segments, 0.0f, 1.0f, 0.0f,
+                                                             u, static_cast<float>(z) / segments});
+            }
+        }
+        uint32_t width = 2 * segments + 1;
+        for (int z = 0; z < segments; z++)
+        {
+            for (int x = 0; x < 2 * segments; x++)
+            {
+                uint32_t a = z * width + x, b = a + width;
+                shape.indices.insert(shape.indices.end(), {a, b, a + 1, a + 1, b, b + 1});
+            }
+        }
+        return shape;
+    }
+
+    // Straight from mikktspace.c (basic output, 180 degree threshold), without its
+    // sorting and hashing: welding by value, face neighbours by directed edge, groups
+    // by recursive assignment in triangle order.
+    std::vector<float> referenceTangents(const Shape &shape)
+    {
+        const float *v = shape.vertices.data();
+        const std::vector<uint32_t> &ind = shape.indices;
+        size_t triangleCount = ind.size() / 3;
+        auto pos = [v](uint32_t i)
+        { return v + i * 8; };
+        auto dot = [](const float *a, const float *b)
+        { return a[0] * b[0] + a[1] * b[1] + a[2] * b[2]; };
+        auto normalize = [&dot](float *a)
+        {
+            float l = std::sqrt(dot(a, a));
+            if (l > 1e-30f)
+            {
+                a[0] *= 1.0f / l;
+                a[1] *= 1.0f / l;
+                a[2] *= 1.0f / l;
+            }
+        };
+
+        std::map<std::array<float, 8>, uint32_t> unique;
+        std::vector<uint32_t> w(ind.size());
+        for (size_t c = 0; c < ind.size(); c++)
+        {
+            std::array<float, 8> key;
+            std::copy(pos(ind[c]), pos(ind[c]) + 8, key.begin());
+            w[c] = unique.emplace(key, ind[c]).first->second;
+        }
+
+        std::vector<std::array<float, 3>> os(triangleCount);
+        std::vector<int> orient(triangleCount), any(triangleCount), degenerate(triangleCount);
+        std::map<std::pair<uint32_t, uint32_t>, size_t> edges;
+        for (size_t t = 0; t < triangleCount; t++)
+        {
+            const float *p1 = pos(ind[t * 3]), *p2 = pos(ind[t * 3 + 1]), *p3 = pos(ind[t * 3 + 2]);
+            float t21x = p2[6] - p1[6], t21y = p2[7] - p1[7], t31x = p3[6] - p1[6], t31y = p3[7] - p1[7];
+            float area = t21x * t31y - t21y * t31x, ot[3];
+            for (int k = 0; k < 3; k++)
+            {
+                os[t][k] = t31y * (p2[k] - p1[k]) - t21y * (p3[k] - p1[k]);
+                ot[k] = -t31x * (p2[k] - p1[k]) + t21x * (p3[k] - p1[k]);
+            }
+            orient[t] = area > 0.0f;
+            any[t] = 1;
+            if (std::fabs(area) > 1.17549435e-38f)
+            {
+                float ls = std::sqrt(dot(os[t].data(), os[t].data())), lt = std::sqrt(dot(ot, ot));
+                if (ls > 1.17549435e-38f)
+                {
+                    for (float &x : os[t])
+                    {
+                        x *= (orient[t] ? 1.0f : -1.0f) / ls;
+                    }
+                }
+                any[t] = !(ls / std::fabs(area) > 1.17549435e-38f && lt / std::fabs(area) > 1.17549435e-38f);
+            }
+            degenerate[t] = w[t * 3] == w[t * 3 + 1] || w[t * 3 + 1] == w[t * 3 + 2] || w[t * 3] == w[t * 3 + 2];
+            if (!degenerate[t])
+            {
+                for (int e = 0; e < 3; e++)
+                {
+                    edges.emplace(std::make_pair(w[t * 3 + e], w[t * 3 + (e + 1) % 3]), t);
+                }
+            }
+        }
+        // neighbour across the edge from corner e to e + 1
+        auto neighbour = [&](size_t t, int e) -> long
+        {
+            auto it = edges.find({w[t * 3 + (e + 1) % 3], w[t * 3 + e]});
+            return it == edges.end() ? -1 : static_cast<long>(it->second);
+        };
+
+        struct Group
+        {
+            uint32_t vertex;
+            int orient;
+            std::vector<size_t> faces;
+        };
+        std::vector<Group> groups;
+        std::vector<long> assigned(ind.size(), -1);
+        std::function<bool(size_t, size_t)> assign = [&](size_t t, size_t g) -> bool
+        {
+            int i = w[t * 3] == groups[g].vertex ? 0 : w[t * 3 + 1] == groups[g].vertex ? 1 : 2;
+            if (assigned[t * 3 + i] == static_cast<long>(g))
+            {
+                return true;
+            }
+            if (assigned[t * 3 + i] != -1)
+            {
+                return false;
+            }
+            if (any[t] && assigned[t * 3] == -1 && assigned[t * 3 + 1] == -1 && assigned[t * 3 + 2] == -1)
+            {
+                orient[t] = groups[g].orient;
+            }
+            if (orient[t] != groups[g].orient)
+            {
+                return false;
+            }
+            assigned[t * 3 + i] = static_cast<long>(g);
+            groups[g].faces.push_back(t);
+            long left = neighbour(t, (i + 2) % 3), right = neighbour(t, i);
+            if (left >= 0)
+            {
+                assign(static_cast<size_t>(left), g);
+            }
+            if (right >= 0)
+            {
+                assign(static_cast<size_t>(right), g);
+            }
+            return true;
+        };
+        for (size_t t = 0; t < triangleCount; t++)
+        {
+            for (int i = 0; i < 3 && !degenerate[t]; i++)
+            {
+                if (assigned[t * 3 + i] == -1)
+                {
+                    groups.push_back(Group{w[t * 3 + i], orient[t], {}});
+                    assign(t, groups.size() - 1);
+                }
+            }
+        }
+
+        std::vector<std::array<float, 3>> groupTangents(groups.size());
+        for (size_t g = 0; g < groups.size(); g++)
+        {
+            float sum[3] = {0.0f, 0.0f, 0.0f};
+            for (size_t t : groups[g].faces)
+            {
+                if (any[t])
+                {
+                    continue;
+                }
+                int i = w[t * 3] == groups[g].vertex ? 0 : w[t * 3 + 1] == groups[g].vertex ? 1 : 2;
+                const float *n = pos(ind[t * 3 + i]) + 3;
+                const float *p0 = pos(ind[t * 3 + (i + 2) % 3]), *p1 = pos(ind[t * 3 + i]),
+                            *p2 = pos(ind[t * 3 + (i + 1) % 3]);
+                float o[3] = {os[t][0], os[t][1], os[t][2]};
+                float v1[3] = {p0[0] - p1[0], p0[1] - p1[1], p0[2] - p1[2]};
+                float v2[3] = {p2[0] - p1[0], p2[1] - p1[1], p2[2] - p1[2]};
+                for (float *a : {o, v1, v2})
+                {
+                    float d = dot(n, a);
+                    for (int k = 0; k < 3; k++)
+                    {
+                        a[k] -= d * n[k];
+                    }
+                    normalize(a);
+                }
+                float angle = std::acos(std::max(-1.0f, std::min(1.0f, dot(v1, v2))));
+                for (int k = 0; k < 3; k++)
+                {
+                    sum[k] += angle * o[k];
+                }
+            }
+            normalize(sum);
+            groupTangents[g] = {sum[0], sum[1], sum[2]};
+        }
+
+        std::vector<float> result(ind.size() * 4, 0.0f);
+        for (size_t c = 0; c < ind.size(); c++)
+        {
+            long g = assigned[c];
+            if (g < 0)
+            {
+                // degenerate: the first usable corner of the vertex
+                for (size_t o = 0; o < ind.size() && g < 0; o++)
+                {
+                    if (w[o] == w[c] && assigned[o] >= 0)
+                    {
+                        g = assigned[o];
+                    }
+                }
+            }
+            if (g >= 0)
+            {
+                std::copy(groupTangents[g].begin(), groupTangents[g].end(), &result[c * 4]);
+                result[c * 4 + 3] = groups[g].orient ? 1.0f : -1.0f;
+            }
+        }
+        return result;
+    }
+
+    // largest difference to the reference, and whether the frames are unit and orthogonal
+    float compare(const Shape &shape, const std::vector<float> &tangents, bool &valid)
+    {
+        std::vector<float> reference = referenceTangents(shape);
+        float worst = 0.0f;
+        for (size_t c = 0; c < shape.indices.size(); c++)
+        {
+            const float *t = &tangents[c * 4], *r = &reference[c * 4];
+            const float *n = &shape.vertices[shape.indices[c] * 8 + 3];
+            if (t[3] != r[3])
+            {
+                worst = 2.0f;
+            }
+            for (int k = 0; k < 3; k++)
+            {
+                worst = std::max(worst, std::fabs(t[k] - r[k]));
+            }
+            float length = std::sqrt(t[0] * t[0] + t[1] * t[1] + t[2] * t[2]);
+            valid = valid && std::fabs(length - 1.0f) < 1e-4f && std::fabs(t[0] * n[0] + t[1] * n[1] + t[2] * n[2]) < 1e-4f;
+        }
+        return worst;
+    }
+
+    template <typename F>
+    double milliseconds(F fn)
+    {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+} // namespace
+
+int main(int argc, char **argv)
+{
+    int segments = argc > 1 ? std::max(8, std::atoi(argv[1])) : 1024;
+    bool valid = true;
+
+    std::vector<Shape> shapes;
+    shapes.push_back(generate("uv sphere", mesh::uvSphereCounts(48, 24), [](const mesh::GeometryStreams &o)
+                              { mesh::generateUvSphere(o, 1.0f, 48, 24); }));
+    // the unsplit seam wraps uvs backwards: a strip of mirrored triangles
+    shapes.push_back(generate("ico sphere", mesh::icoSphereCounts(3), [](const mesh::GeometryStreams &o)
+                              { mesh::generateIcoSphere(o, 1.0f, 3); }));
+    shapes.push_back(generate("torus", mesh::torusCounts(40, 20), [](const mesh::GeometryStreams &o)
+                              { mesh::generateTorus(o, 1.0f, 0.3f, 40, 20); }));
+    shapes.push_back(generate("cube", mesh::cubeCounts(3), [](const mesh::GeometryStreams &o)
+                              { mesh::generateCube(o, 1.0f, 3); }));
+    shapes.push_back(mirroredPlane(8));
+    for (Shape &shape : shapes)
+    {
+        // wobble the uvs so gradients differ from triangle to triangle
+        for (size_t v = 0; v < shape.vertexCount(); v++)
+        {
+            float *p = &shape.vertices[v * 8];
+            p[6] += 0.002f * std::sin(13.0f * p[0] + 7.0f * p[2]);
+            p[7] += 0.002f * std::cos(11.0f * p[1] + 5.0f * p[0]);
+        }
+        std::vector<float> tangents(shape.indices.size() * 4);
+        mesh::generateCornerTangents(tangents.data(), shape.input());
+        bool frames = true;
+        float difference = compare(shape, tangents, frames);
+        bool ok = frames && difference < 1e-4f;
+        std::cout << shape.name << ": " << shape.indices.size() / 3 << " triangles, largest difference to reference "
+                  << difference << (ok ? " ok" : " FAILED") << std::endl;
+        valid = valid && ok;
+    }
+
+    // indexed output: all 9 middle column vertices of the mirrored plane are used by both
+    // orientations, so each gets a copy
+    {
+        Shape plane = mirroredPlane(8);
+        std::vector<float> tangents;
+        std::vector<uint32_t> split;
+        std::vector<uint32_t> indices = plane.indices;
+        size_t count = mesh::generateTangents(tangents, split, indices.data(), plane.input());
+        bool ok = count == plane.vertexCount() + split.size() && split.size() == 9 && tangents.size() == count * 4;
+        std::vector<float> corners(plane.indices.size() * 4);
+        mesh::generateCornerTangents(corners.data(), plane.input());
+        for (size_t c = 0; c < indices.size(); c++)
+        {
+            ok = ok && (indices[c] < plane.vertexCount() ? indices[c] == plane.indices[c]
+                                                         : split[indices[c] - plane.vertexCount()] == plane.indices[c]);
+            ok = ok && std::equal(&corners[c * 4], &corners[c * 4] + 4, &tangents[indices[c] * 4]);
+        }
+        std::cout << "mirror seam: " << split.size() << " vertices split" << (ok ? " ok" : " FAILED") << std::endl;
+        valid = valid && ok;
+    }
+
+    // a mesh straight from import
+    {
+        Shape torus = generate("torus", mesh::torusCounts(64, 32), [](const mesh::GeometryStreams &o)
+                               { mesh::generateTorus(o, 1.0f, 0.3f, 64, 32); });
+        mesh::MeshData data;
+        data.vertices = torus.vertices;
+        data.indices = torus.indices;
+        data.hasNormals = data.hasUvs = true;
+        bool ok = mesh::generateTangents(data) && data.tangents.size() == data.vertexCount() * 4 &&
+                  data.vertexCount() == torus.vertexCount();
+        std::cout << "MeshData: " << data.vertexCount() << " vertices" << (ok ? " ok" : " FAILED") << std::endl;
+        valid = valid && ok;
+    }
+
+    std::vector<Shape> large;
+    large.push_back(generate("uv sphere", mesh::uvSphereCounts(segments, segments / 2),
+                             [segments](const mesh::GeometryStreams &o)
+                             { mesh::generateUvSphere(o, 1.0f, segments, segments / 2); }));
+    large.push_back(generate("torus", mesh::torusCounts(segments, segments / 2), [segments](const mesh::GeometryStreams &o)
+                             { mesh::generateTorus(o, 1.0f, 0.3f, segments, segments / 2); }));
+    for (const Shape &shape : large)
+    {
+        std::vector<float> tangents;
+        std::vector<uint32_t> split, indices = shape.indices;
+        double single = milliseconds([&]
+                                     { mesh::generateTangents(tangents, split, indices.data(), shape.input(), false); });
+        double pooled = milliseconds([&]
+                                     { mesh::generateTangents(tangents, split, indices.data(), shape.input(), true); });
+        double triangles = static_cast<double>(shape.indices.size() / 3);
+        std::cout << shape.name << " " << triangles / 1e6 << "M triangles: " << single << " ms on one thread, "
+                  << pooled << " ms on the pool (" << triangles / pooled / 1e3 << "M triangles/s), " << split.size()
+                  << " split" << std::endl;
+    }
+
+    std::cout << (valid ? "checks passed" : "CHECKS FAILED") << std::endl;
+    return valid ? 0 : 1;
+}
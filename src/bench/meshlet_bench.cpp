@@ -0,0 +1,215 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "mesh_optimizer.hpp"
+#include "meshlet.hpp"
+
+// usage: meshlet_bench [segments]
+// Splits a bumpy sphere into meshlets and checks the limits, that every triangle ends up
+// in exactly one meshlet and that the bounds hold their vertices. Then culls from random
+// cameras and checks every rejected meshlet really is off screen or back facing.
+namespace
+{
+    void bumpySphere(int segments, std::vector<float> &positions, std::vector<uint32_t> &indices)
+    {
+        const float PI = 3.14159265f;
+        int rings = segments / 2;
+        for (int r = 0; r <= rings; r++)
+        {
+            float theta = PI * r / rings;
+            for (int s = 0; s <= segments; s++)
+            {
+                float phi = 2.0f * PI * s / segments;
+                float radius = 1.0f + 0.1f * std::sin(6.0f * theta) * std::sin(6.0f * phi);
+                positions.insert(positions.end(), {std::sin(theta) * std::cos(phi) * radius, std::cos(theta) * radius,
+                                                   std::sin(theta) * std::sin(phi) * radius});
+            }
+        }
+        for (int r = 0; r < rings; r++)
+        {
+            for (int s = 0; s < segments; s++)
+            {
+                uint32_t a = r * (segments + 1) + s, b = a + segments + 1;
+                // counter-clockwise seen from outside
+                indices.insert(indices.end(), {a, a + 1, b, a + 1, b + 1, b});
+            }
+        }
+    }
+
+    // column major perspective * lookAt(eye, origin, +y)
+    void viewProjection(const float *eye, float fovY, float aspect, float *out)
+    {
+        float f[3] = {-eye[0], -eye[1], -eye[2]};
+        float length = std::sqrt(f[0] * f[0] + f[1] * f[1] + f[2] * f[2]);
+        for (float &v : f)
+        {
+            v /= length;
+        }
+        float up[3] = {0.0f, 1.0f, 0.0f};
+        float s[3] = {f[1] * up[2] - f[2] * up[1], f[2] * up[0] - f[0] * up[2], f[0] * up[1] - f[1] * up[0]};
+        length = std::sqrt(s[0] * s[0] + s[1] * s[1] + s[2] * s[2]);
+        for (float &v : s)
+        {
+            v /= length;
+        }
+        float u[3] = {s[1] * f[2] - s[2] * f[1], s[2] * f[0] - s[0] * f[2], s[0] * f[1] - s[1] * f[0]};
+        float view[16] = {s[0], u[0], -f[0], 0, s[1], u[1], -f[1], 0, s[2], u[2], -f[2], 0, 0, 0, 0, 1};
+        for (int k = 0; k < 3; k++)
+        {
+            view[12 + k] = -(view[k] * eye[0] + view[4 + k] * eye[1] + view[8 + k] * eye[2]);
+        }
+        float n = 0.1f, fa = 100.0f, t = 1.0f / std::tan(fovY / 2.0f);
+        float projection[16] = {t / aspect, 0, 0, 0, 0, t, 0, 0, 0, 0, (fa + n) / (n - fa), -1, 0, 0, 2 * fa * n / (n - fa), 0};
+        for (int c = 0; c < 4; c++)
+        {
+            for (int r = 0; r < 4; r++)
+            {
+                out[c * 4 + r] = 0.0f;
+                for (int k = 0; k < 4; k++)
+                {
+                    out[c * 4 + r] += projection[k * 4 + r] * view[c * 4 + k];
+                }
+            }
+        }
+    }
+
+    bool insideClip(const float *m, const float *p)
+    {
+        float clip[4];
+        for (int r = 0; r < 4; r++)
+        {
+            clip[r] = m[r] * p[0] + m[4 + r] * p[1] + m[8 + r] * p[2] + m[12 + r];
+        }
+        return std::fabs(clip[0]) <= clip[3] && std::fabs(clip[1]) <= clip[3] && std::fabs(clip[2]) <= clip[3];
+    }
+
+    template <typename F>
+    double milliseconds(F fn)
+    {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+} // namespace
+
+int main(int argc, char **argv)
+{
+    int segments = argc > 1 ? std::atoi(argv[1]) : 512;
+    std::vector<float> positions;
+    std::vector<uint32_t> indices;
+    bumpySphere(segments, positions, indices);
+    size_t vertexCount = positions.size() / 3;
+    mesh::optimizeVertexCache(indices.data(), indices.data(), indices.size(), vertexCount);
+
+    int failures = 0;
+    for (float coneWeight : {0.0f, 0.25f, 0.75f})
+    {
+        mesh::Meshlets meshlets;
+        double buildTime = milliseconds([&]
+                                        { mesh::buildMeshlets(meshlets, indices.data(), indices.size(), positions.data(),
+                                                              vertexCount, 3 * sizeof(float), 64, 124, coneWeight); });
+
+        // limits, and the same triangles as the input
+        bool valid = meshlets.indices.size() == indices.size();
+        float cutoffSum = 0.0f;
+        for (size_t i = 0; i < meshlets.meshlets.size(); i++)
+        {
+            const mesh::Meshlet &m = meshlets.meshlets[i];
+            const mesh::MeshletBounds &b = meshlets.bounds[i];
+            valid = valid && m.vertexCount <= 64 && m.triangleCount <= 124 && m.triangleCount > 0;
+            for (uint32_t t = 0; valid && t < m.triangleCount * 3; t++)
+            {
+                uint32_t v = meshlets.vertices[m.vertexOffset + meshlets.triangles[m.triangleOffset * 3 + t]];
+                const float *p = &positions[v * 3];
+                float d[3] = {p[0] - b.center[0], p[1] - b.center[1], p[2] - b.center[2]};
+                valid = meshlets.indices[m.triangleOffset * 3 + t] == v &&
+                        std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]) <= b.radius * 1.0001f;
+            }
+            cutoffSum += b.coneCutoff;
+        }
+        auto sortedTriangles = [](const std::vector<uint32_t> &list)
+        {
+            std::vector<std::array<uint32_t, 3>> triangles;
+            for (size_t t = 0; t < list.size(); t += 3)
+            {
+                std::array<uint32_t, 3> tri = {list[t], list[t + 1], list[t + 2]};
+                std::rotate(tri.begin(), std::min_element(tri.begin(), tri.end()), tri.end());
+                triangles.push_back(tri);
+            }
+            std::sort(triangles.begin(), triangles.end());
+            return triangles;
+        };
+        valid = valid && sortedTriangles(meshlets.indices) == sortedTriangles(indices);
+
+        // random cameras around the sphere: rejected meshlets must be invisible
+        std::mt19937 rng(5);
+        std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+        size_t culledTriangles = 0, totalTriangles = 0, backface = 0, frustum = 0, ranges = 0;
+        double cullTime = 0.0;
+        const int CAMERAS = 64;
+        for (int c = 0; c < CAMERAS; c++)
+        {
+            float eye[3] = {unit(rng), unit(rng), unit(rng)};
+            float length = std::sqrt(eye[0] * eye[0] + eye[1] * eye[1] + eye[2] * eye[2]);
+            float distance = 1.3f + 2.0f * (unit(rng) + 1.0f);
+            for (float &v : eye)
+            {
+                v *= distance / length;
+            }
+            float m[16];
+            viewProjection(eye, 0.9f, 16.0f / 9.0f, m);
+            std::vector<mesh::DrawRange> visible;
+            mesh::CullStats stats;
+            cullTime += milliseconds([&]
+                                     { mesh::cullMeshlets(meshlets, m, eye, visible, &stats); });
+            ranges += visible.size();
+            backface += stats.backfaceCulled;
+            frustum += stats.frustumCulled;
+            totalTriangles += indices.size() / 3;
+            culledTriangles += indices.size() / 3 - stats.triangles;
+
+            float planes[6][4];
+            mesh::extractFrustum(m, planes);
+            for (size_t i = 0; i < meshlets.meshlets.size(); i++)
+            {
+                const mesh::Meshlet &ml = meshlets.meshlets[i];
+                bool offScreen = mesh::cullFrustum(meshlets.bounds[i], planes);
+                bool backFacing = !offScreen && mesh::cullBackface(meshlets.bounds[i], eye);
+                for (uint32_t t = 0; (offScreen || backFacing) && t < ml.triangleCount; t++)
+                {
+                    const uint32_t *tri = &meshlets.indices[(ml.triangleOffset + t) * 3];
+                    const float *a = &positions[tri[0] * 3], *b = &positions[tri[1] * 3], *cc = &positions[tri[2] * 3];
+                    if (offScreen)
+                    {
+                        valid = valid && !insideClip(m, a) && !insideClip(m, b) && !insideClip(m, cc);
+                        continue;
+                    }
+                    float e1[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]}, e2[3] = {cc[0] - a[0], cc[1] - a[1], cc[2] - a[2]};
+                    float n[3] = {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2],
+                                  e1[0] * e2[1] - e1[1] * e2[0]};
+                    float toTriangle = n[0] * (a[0] - eye[0]) + n[1] * (a[1] - eye[1]) + n[2] * (a[2] - eye[2]);
+                    valid = valid && toTriangle >= -1e-6f;
+                }
+            }
+        }
+
+        size_t count = meshlets.meshlets.size();
+        std::cout << "cone weight " << coneWeight << ": " << count << " meshlets, "
+                  << static_cast<double>(meshlets.vertices.size()) / count << " vertices and "
+                  << static_cast<double>(indices.size() / 3) / count << " triangles each, mean cone cutoff "
+                  << cutoffSum / count << " (" << buildTime << " ms)" << std::endl;
+        std::cout << "  per camera: " << 100.0 * culledTriangles / totalTriangles << "% triangles culled, "
+                  << static_cast<double>(backface) / CAMERAS << " back facing + " << static_cast<double>(frustum) / CAMERAS
+                  << " off screen meshlets, " << static_cast<double>(ranges) / CAMERAS << " draw ranges, "
+                  << cullTime / CAMERAS << " ms" << std::endl;
+        std::cout << "  " << (valid ? "checks passed" : "CHECKS FAILED") << std::endl;
+        failures += !valid;
+    }
+    return failures == 0 ? 0 : 1;
+}
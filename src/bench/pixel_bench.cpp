@@ -0,0 +1,141 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "pixel_convert.hpp"
+
+// usage: pixel_bench [megapixels]
+// Checks every SIMD conversion against pixel::scalar (odd sizes included, to cover
+// the tails) and reports the throughput of both.
+namespace
+{
+    double secondsPerCall(const std::function<void()> &fn)
+    {
+        fn();
+        int iterations = 0;
+        auto start = std::chrono::steady_clock::now();
+        std::chrono::duration<double> elapsed{};
+        do
+        {
+            fn();
+            iterations++;
+            elapsed = std::chrono::steady_clock::now() - start;
+        } while (elapsed.count() < 0.2);
+        return elapsed.count() / iterations;
+    }
+
+    void report(const std::string &name, double megapixels, double simd, double scalar)
+    {
+        std::cout << name << ": " << megapixels / simd << " MP/s (scalar " << megapixels / scalar << " MP/s, "
+                  << scalar / simd << "x)" << std::endl;
+    }
+} // namespace
+
+int main(int argc, char **argv)
+{
+    double megapixels = argc > 1 ? std::atof(argv[1]) : 4.0;
+    size_t count = static_cast<size_t>(megapixels * 1e6);
+
+    std::mt19937 rng(99);
+    std::vector<uint8_t> source(count * 4 + 64);
+    for (uint8_t &v : source)
+    {
+        v = static_cast<uint8_t>(rng());
+    }
+
+    // correctness first, on every length up to a few SIMD blocks plus some random ones
+    int failures = 0;
+    std::vector<size_t> lengths;
+    for (size_t n = 0; n < 80; n++)
+    {
+        lengths.push_back(n);
+    }
+    for (int i = 0; i < 20; i++)
+    {
+        lengths.push_back(rng() % 100000);
+    }
+    for (size_t n : lengths)
+    {
+        std::vector<uint8_t> a(n * 4 + 8, 0xCD), b(n * 4 + 8, 0xCD);
+        pixel::rgbToRgba(source.data(), a.data(), n, 200);
+        pixel::scalar::rgbToRgba(source.data(), b.data(), n, 200);
+        failures += a != b;
+
+        for (int channels : {3, 4})
+        {
+            std::memcpy(a.data(), source.data(), n * channels);
+            std::memcpy(b.data(), source.data(), n * channels);
+            pixel::swapRedBlue(a.data(), n, channels);
+            pixel::scalar::swapRedBlue(b.data(), n, channels);
+            failures += a != b;
+        }
+
+        std::memcpy(a.data(), source.data(), n * 4);
+        std::memcpy(b.data(), source.data(), n * 4);
+        pixel::premultiplyAlpha(a.data(), n);
+        pixel::scalar::premultiplyAlpha(b.data(), n);
+        failures += a != b;
+
+        std::vector<uint16_t> wa(n * 4 + 4, 0xABCD), wb(n * 4 + 4, 0xABCD);
+        pixel::widen8To16(source.data(), wa.data(), n * 4);
+        pixel::scalar::widen8To16(source.data(), wb.data(), n * 4);
+        failures += wa != wb;
+    }
+    // exhaustive check of the premultiply rounding
+    for (int c = 0; c < 256; c++)
+    {
+        for (int alpha = 0; alpha < 256; alpha++)
+        {
+            uint8_t px[32];
+            for (int i = 0; i < 8; i++)
+            {
+                px[i * 4 + 0] = px[i * 4 + 1] = px[i * 4 + 2] = static_cast<uint8_t>(c);
+                px[i * 4 + 3] = static_cast<uint8_t>(alpha);
+            }
+            pixel::premultiplyAlpha(px, 8);
+            int expected = (c * alpha + 127) / 255;
+            failures += px[0] != expected || px[31] != alpha;
+        }
+    }
+    std::vector<uint8_t> image(source.begin(), source.begin() + 7 * 5 * 3), flipped = image;
+    pixel::flipVertical(flipped.data(), 7 * 3, 5);
+    for (int row = 0; row < 5; row++)
+    {
+        failures += std::memcmp(&image[row * 21], &flipped[(4 - row) * 21], 21) != 0;
+    }
+    std::cout << (failures == 0 ? "all kernels match the scalar reference" : "MISMATCHES: " + std::to_string(failures))
+              << std::endl;
+
+    std::vector<uint8_t> rgba(count * 4);
+    std::vector<uint16_t> wide(count * 4);
+    report("rgb -> rgba", megapixels, secondsPerCall([&]
+                                                     { pixel::rgbToRgba(source.data(), rgba.data(), count); }),
+           secondsPerCall([&]
+                          { pixel::scalar::rgbToRgba(source.data(), rgba.data(), count); }));
+    report("swap red/blue, rgb", megapixels, secondsPerCall([&]
+                                                            { pixel::swapRedBlue(rgba.data(), count, 3); }),
+           secondsPerCall([&]
+                          { pixel::scalar::swapRedBlue(rgba.data(), count, 3); }));
+    report("swap red/blue, rgba", megapixels, secondsPerCall([&]
+                                                             { pixel::swapRedBlue(rgba.data(), count, 4); }),
+           secondsPerCall([&]
+                          { pixel::scalar::swapRedBlue(rgba.data(), count, 4); }));
+    report("premultiply alpha", megapixels, secondsPerCall([&]
+                                                           { pixel::premultiplyAlpha(rgba.data(), count); }),
+           secondsPerCall([&]
+                          { pixel::scalar::premultiplyAlpha(rgba.data(), count); }));
+    report("widen rgba8 -> rgba16", megapixels, secondsPerCall([&]
+                                                               { pixel::widen8To16(rgba.data(), wide.data(), count * 4); }),
+           secondsPerCall([&]
+                          { pixel::scalar::widen8To16(rgba.data(), wide.data(), count * 4); }));
+    double flip = secondsPerCall([&]
+                                 { pixel::flipVertical(rgba.data(), 2048 * 4, count / 2048); });
+    std::cout << "flip rgba: " << megapixels / flip << " MP/s" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,222 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "primitives.hpp"
+
+// usage: primitives_bench [scale]
+// Generates every shape into interleaved and separate arrays, checks both agree, that
+// indices are in range, triangles face the way of their normals, normals and tangents
+// are unit length and orthogonal and the tangent handedness matches the uv winding.
+// Then times tessellations of a few million triangles.
+namespace
+{
+    // position, normal, uv, tangent
+    struct Vertex
+    {
+        float position[3];
+        float normal[3];
+        float uv[2];
+        float tangent[4];
+    };
+
+    struct Shape
+    {
+        std::string name;
+        mesh::PrimitiveCounts counts;
+        std::function<void(const mesh::GeometryStreams &)> generate;
+        bool seamlessUvs;
+    };
+
+    mesh::GeometryStreams interleaved(std::vector<Vertex> &vertices, std::vector<uint32_t> &indices)
+    {
+        mesh::GeometryStreams out;
+        out.positions = vertices[0].position;
+        out.normals = vertices[0].normal;
+        out.uvs = vertices[0].uv;
+        out.tangents = vertices[0].tangent;
+        out.positionStride = out.normalStride = out.uvStride = out.tangentStride = sizeof(Vertex);
+        out.indices = indices.data();
+        return out;
+    }
+
+    float dot(const float *a, const float *b)
+    {
+        return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+    }
+
+    bool check(const Shape &shape, std::string &problem)
+    {
+        std::vector<Vertex> vertices(shape.counts.vertexCount);
+        std::vector<uint32_t> indices(shape.counts.indexCount);
+        shape.generate(interleaved(vertices, indices));
+
+        // the same through separate arrays
+        std::vector<float> positions(shape.counts.vertexCount * 3), normals(shape.counts.vertexCount * 3),
+            uvs(shape.counts.vertexCount * 2), tangents(shape.counts.vertexCount * 4);
+        std::vector<uint32_t> soaIndices(shape.counts.indexCount);
+        mesh::GeometryStreams soa;
+        soa.positions = positions.data();
+        soa.normals = normals.data();
+        soa.uvs = uvs.data();
+        soa.tangents = tangents.data();
+        soa.indices = soaIndices.data();
+        shape.generate(soa);
+        if (soaIndices != indices)
+        {
+            problem = "separate arrays give other indices";
+            return false;
+        }
+
+        for (size_t v = 0; v < vertices.size(); v++)
+        {
+            const Vertex &x = vertices[v];
+            for (int k = 0; k < 3; k++)
+            {
+                if (x.position[k] != positions[v * 3 + k] || x.normal[k] != normals[v * 3 + k] ||
+                    x.tangent[k] != tangents[v * 4 + k] || (k < 2 && x.uv[k] != uvs[v * 2 + k]))
+                {
+                    problem = "separate arrays give other vertices";
+                    return false;
+                }
+            }
+            if (std::fabs(dot(x.normal, x.normal) - 1.0f) > 1e-4f || std::fabs(dot(x.tangent, x.tangent) - 1.0f) > 1e-4f ||
+                std::fabs(dot(x.normal, x.tangent)) > 1e-4f || std::fabs(x.tangent[3]) != 1.0f)
+            {
+                problem = "normal / tangent frame of vertex " + std::to_string(v);
+                return false;
+            }
+            if (x.uv[0] < 0.0f || x.uv[0] > 1.0f || x.uv[1] < 0.0f || x.uv[1] > 1.0f)
+            {
+                problem = "uv out of range";
+                return false;
+            }
+        }
+
+        for (size_t i = 0; i < indices.size(); i += 3)
+        {
+            if (indices[i] >= vertices.size() || indices[i + 1] >= vertices.size() || indices[i + 2] >= vertices.size())
+            {
+                problem = "index out of range";
+                return false;
+            }
+            const Vertex &a = vertices[indices[i]], &b = vertices[indices[i + 1]], &c = vertices[indices[i + 2]];
+            float e1[3], e2[3];
+            for (int k = 0; k < 3; k++)
+            {
+                e1[k] = b.position[k] - a.position[k];
+                e2[k] = c.position[k] - a.position[k];
+            }
+            float n[3] = {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0]};
+            float area = std::sqrt(dot(n, n));
+            if (area < 1e-12f)
+            {
+                problem = "degenerate triangle " + std::to_string(i / 3);
+                return false;
+            }
+            float average[3] = {a.normal[0] + b.normal[0] + c.normal[0], a.normal[1] + b.normal[1] + c.normal[1],
+                                a.normal[2] + b.normal[2] + c.normal[2]};
+            if (dot(n, average) <= 0.0f)
+            {
+                problem = "triangle " + std::to_string(i / 3) + " faces inwards";
+                return false;
+            }
+            // counter-clockwise in uv space when the tangent frame is right handed
+            float uvArea = (b.uv[0] - a.uv[0]) * (c.uv[1] - a.uv[1]) - (c.uv[0] - a.uv[0]) * (b.uv[1] - a.uv[1]);
+            if (shape.seamlessUvs && uvArea * a.tangent[3] <= 0.0f)
+            {
+                problem = "uv winding of triangle " + std::to_string(i / 3) + " disagrees with the handedness";
+                return false;
+            }
+        }
+        return true;
+    }
+
+    template <typename F>
+    double milliseconds(F fn)
+    {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+} // namespace
+
+int main(int argc, char **argv)
+{
+    int scale = argc > 1 ? std::max(1, std::atoi(argv[1])) : 1;
+    std::vector<Shape> shapes = {
+        {"plane", mesh::planeCounts(7, 5), [](const mesh::GeometryStreams &o)
+         { mesh::generatePlane(o, 2.0f, 1.0f, 7, 5); },
+         true},
+        {"cube", mesh::cubeCounts(3), [](const mesh::GeometryStreams &o)
+         { mesh::generateCube(o, 1.0f, 3); },
+         true},
+        {"uv sphere", mesh::uvSphereCounts(37, 18), [](const mesh::GeometryStreams &o)
+         { mesh::generateUvSphere(o, 0.5f, 37, 18); },
+         true},
+        {"ico sphere", mesh::icoSphereCounts(3), [](const mesh::GeometryStreams &o)
+         { mesh::generateIcoSphere(o, 0.5f, 3); },
+         false},
+        {"cylinder", mesh::cylinderCounts(29, 3), [](const mesh::GeometryStreams &o)
+         { mesh::generateCylinder(o, 0.5f, 1.0f, 29, 3); },
+         true},
+        {"torus", mesh::torusCounts(41, 19), [](const mesh::GeometryStreams &o)
+         { mesh::generateTorus(o, 0.5f, 0.2f, 41, 19); },
+         true},
+        {"capsule", mesh::capsuleCounts(31, 7), [](const mesh::GeometryStreams &o)
+         { mesh::generateCapsule(o, 0.25f, 0.5f, 31, 7); },
+         true},
+    };
+    bool valid = true;
+    for (const Shape &shape : shapes)
+    {
+        std::string problem;
+        bool ok = check(shape, problem);
+        std::cout << shape.name << ": " << shape.counts.vertexCount << " vertices, " << shape.counts.indexCount / 3
+                  << " triangles " << (ok ? "ok" : "FAILED: " + problem) << std::endl;
+        valid = valid && ok;
+    }
+
+    // stress scene sized shapes
+    int segments = 2048 * scale;
+    std::vector<Shape> large = {
+        {"uv sphere", mesh::uvSphereCounts(segments, segments / 2), [&](const mesh::GeometryStreams &o)
+         { mesh::generateUvSphere(o, 1.0f, segments, segments / 2); },
+         true},
+        {"plane", mesh::planeCounts(segments, segments / 2), [&](const mesh::GeometryStreams &o)
+         { mesh::generatePlane(o, 1.0f, 1.0f, segments, segments / 2); },
+         true},
+        {"torus", mesh::torusCounts(segments, segments / 2), [&](const mesh::GeometryStreams &o)
+         { mesh::generateTorus(o, 1.0f, 0.3f, segments, segments / 2); },
+         true},
+        {"ico sphere", mesh::icoSphereCounts(9), [](const mesh::GeometryStreams &o)
+         { mesh::generateIcoSphere(o, 1.0f, 9); },
+         false},
+    };
+    for (const Shape &shape : large)
+    {
+        std::vector<Vertex> vertices(shape.counts.vertexCount);
+        std::vector<uint32_t> indices(shape.counts.indexCount);
+        mesh::GeometryStreams out = interleaved(vertices, indices);
+        shape.generate(out);
+        double time = milliseconds([&]
+                                   { shape.generate(out); });
+        // positions and indices only, as a depth pre-pass or shadow mesh would use
+        std::vector<float> positions(shape.counts.vertexCount * 3);
+        mesh::GeometryStreams positionsOnly;
+        positionsOnly.positions = positions.data();
+        positionsOnly.indices = indices.data();
+        double positionTime = milliseconds([&]
+                                           { shape.generate(positionsOnly); });
+        double triangles = static_cast<double>(shape.counts.indexCount / 3);
+        std::cout << shape.name << " " << triangles / 1e6 << "M triangles: " << time << " ms interleaved ("
+                  << triangles / time / 1e3 << "M/s), " << positionTime << " ms positions only" << std::endl;
+    }
+    std::cout << (valid ? "checks passed" : "CHECKS FAILED") << std::endl;
+    return valid ? 0 : 1;
+}
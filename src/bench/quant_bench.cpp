@@ -0,0 +1,181 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "vertex_quantize.hpp"
+
+// usage: quant_bench [segments]
+// Quantises a sphere with normals, tangents and tiled uvs in every format combination,
+// decodes the result through the generated attribute descriptors and reports size and
+// worst case error against the float source.
+namespace
+{
+    struct Vertex
+    {
+        float position[3];
+        float normal[3];
+        float tangent[4];
+        float uv[2];
+    };
+
+    std::vector<Vertex> sphere(int segments)
+    {
+        const float PI = 3.14159265f;
+        std::vector<Vertex> vertices;
+        int rings = segments / 2;
+        for (int r = 0; r <= rings; r++)
+        {
+            float theta = PI * r / rings;
+            for (int s = 0; s <= segments; s++)
+            {
+                float phi = 2.0f * PI * s / segments;
+                float n[3] = {std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi)};
+                Vertex v;
+                for (int k = 0; k < 3; k++)
+                {
+                    v.position[k] = n[k] * 25.0f + (k == 0 ? 100.0f : 0.0f);
+                    v.normal[k] = n[k];
+                }
+                v.tangent[0] = -std::sin(phi);
+                v.tangent[1] = 0.0f;
+                v.tangent[2] = std::cos(phi);
+                v.tangent[3] = s % 2 ? 1.0f : -1.0f;
+                v.uv[0] = 4.0f * s / segments; // tiles four times around
+                v.uv[1] = static_cast<float>(r) / rings;
+                vertices.push_back(v);
+            }
+        }
+        return vertices;
+    }
+
+    float angleDegrees(const float a[3], const float b[3])
+    {
+        float la = std::sqrt(a[0] * a[0] + a[1] * a[1] + a[2] * a[2]);
+        float lb = std::sqrt(b[0] * b[0] + b[1] * b[1] + b[2] * b[2]);
+        float d = (a[0] * b[0] + a[1] * b[1] + a[2] * b[2]) / (la * lb);
+        return std::acos(std::clamp(d, -1.0f, 1.0f)) * 57.2957795f;
+    }
+
+    const mesh::VertexAttribute *find(const mesh::VertexLayout &layout, GLuint location)
+    {
+        for (const mesh::VertexAttribute &attribute : layout.attributes)
+        {
+            if (attribute.location == location)
+            {
+                return &attribute;
+            }
+        }
+        return nullptr;
+    }
+} // namespace
+
+int main(int argc, char **argv)
+{
+    int segments = argc > 1 ? std::atoi(argv[1]) : 1024;
+    std::vector<Vertex> vertices = sphere(segments);
+
+    mesh::VertexStreams streams;
+    streams.count = vertices.size();
+    streams.positions = vertices[0].position;
+    streams.positionStride = sizeof(Vertex);
+    streams.normals = vertices[0].normal;
+    streams.normalStride = sizeof(Vertex);
+    streams.tangents = vertices[0].tangent;
+    streams.tangentStride = sizeof(Vertex);
+    streams.uvs = vertices[0].uv;
+    streams.uvStride = sizeof(Vertex);
+
+    struct Case
+    {
+        const char *name;
+        mesh::QuantizeSettings::PositionFormat position;
+        mesh::QuantizeSettings::DirectionFormat direction;
+        mesh::QuantizeSettings::UvFormat uv;
+        // limits: position error relative to the extent, degrees, uv units (tiled range of 4)
+        float positionLimit;
+        float angleLimit;
+        float uvLimit;
+    };
+    const Case cases[] = {
+        {"float", mesh::QuantizeSettings::POSITION_FLOAT, mesh::QuantizeSettings::DIRECTION_FLOAT,
+         mesh::QuantizeSettings::UV_FLOAT, 1e-7f, 0.01f, 1e-7f},
+        {"unorm16 / 10_10_10_2 / unorm16", mesh::QuantizeSettings::POSITION_UNORM16,
+         mesh::QuantizeSettings::DIRECTION_10_10_10_2, mesh::QuantizeSettings::UV_UNORM16, 1e-5f, 0.2f, 1e-4f},
+        {"unorm16 / oct16 / unorm16", mesh::QuantizeSettings::POSITION_UNORM16, mesh::QuantizeSettings::DIRECTION_OCT16,
+         mesh::QuantizeSettings::UV_UNORM16, 1e-5f, 0.05f, 1e-4f},
+        {"half / 10_10_10_2 / half", mesh::QuantizeSettings::POSITION_HALF, mesh::QuantizeSettings::DIRECTION_10_10_10_2,
+         mesh::QuantizeSettings::UV_HALF, 1e-3f, 0.2f, 2e-3f},
+    };
+
+    int failures = 0;
+    size_t floatBytes = vertices.size() * (3 + 3 + 4 + 2) * sizeof(float);
+    for (const Case &c : cases)
+    {
+        mesh::QuantizeSettings settings;
+        settings.position = c.position;
+        settings.normal = c.direction;
+        settings.tangent = c.direction;
+        settings.uv = c.uv;
+
+        auto start = std::chrono::steady_clock::now();
+        mesh::QuantizedVertices packed = mesh::quantizeVertices(streams, settings);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        const mesh::VertexAttribute *position = find(packed.layout, settings.positionLocation);
+        const mesh::VertexAttribute *normal = find(packed.layout, settings.normalLocation);
+        const mesh::VertexAttribute *tangent = find(packed.layout, settings.tangentLocation);
+        const mesh::VertexAttribute *uv = find(packed.layout, settings.uvLocation);
+        if (!position || !normal || !tangent || !uv)
+        {
+            std::cout << c.name << ": missing attribute" << std::endl;
+            failures++;
+            continue;
+        }
+
+        float positionError = 0.0f, angleError = 0.0f, uvError = 0.0f;
+        int signErrors = 0;
+        for (size_t i = 0; i < vertices.size(); i++)
+        {
+            const unsigned char *v = packed.data.data() + i * packed.layout.stride;
+            const Vertex &src = vertices[i];
+            float p[4], n[4], t[4], st[4];
+            mesh::decodeAttribute(v, *position, p);
+            mesh::decodeAttribute(v, *normal, n);
+            mesh::decodeAttribute(v, *tangent, t);
+            mesh::decodeAttribute(v, *uv, st);
+            for (int k = 0; k < 3; k++)
+            {
+                float decoded = p[k] * packed.positionScale[k] + packed.positionOffset[k];
+                positionError = std::max(positionError, std::fabs(decoded - src.position[k]) / 50.0f);
+            }
+            if (c.direction == mesh::QuantizeSettings::DIRECTION_OCT16)
+            {
+                float sign = t[2];
+                mesh::octDecode(n, n);
+                mesh::octDecode(t, t);
+                t[3] = sign;
+            }
+            angleError = std::max({angleError, angleDegrees(n, src.normal), angleDegrees(t, src.tangent)});
+            signErrors += (t[3] < 0.0f) != (src.tangent[3] < 0.0f);
+            for (int k = 0; k < 2; k++)
+            {
+                float decoded = st[k] * packed.uvScale[k] + packed.uvOffset[k];
+                uvError = std::max(uvError, std::fabs(decoded - src.uv[k]));
+            }
+        }
+        bool ok = positionError <= c.positionLimit && angleError <= c.angleLimit && uvError <= c.uvLimit &&
+                  signErrors == 0;
+        failures += !ok;
+        std::cout << c.name << ": " << packed.layout.stride << " bytes/vertex, "
+                  << static_cast<double>(floatBytes) / packed.data.size() << "x smaller, " << vertices.size() / ms / 1000.0
+                  << " Mverts/s, max error: position " << positionError << " of extent, direction " << angleError
+                  << " deg, uv " << uvError << (ok ? "" : "  FAILED") << std::endl;
+    }
+    std::cout << (failures == 0 ? "all formats within their error bounds" : "FAILURES: " + std::to_string(failures))
+              << std::endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,333 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "primitives.hpp"
+#include "soft_raster.hpp"
+#include "thread_pool.hpp"
+
+// usage: soft_raster_bench
+// Checks the software rasterizer: a jittered mesh covering the screen must touch every
+// pixel exactly once, texture coordinates across a receding floor must match the ray
+// traced values, and images must not depend on the thread count. Then measures fill
+// rate (megapixels per second) on a scene of textured cubes like ex5's and triangle
+// throughput on a finely tessellated sphere.
+
+namespace
+{
+    struct Matrix
+    {
+        float m[16];
+    };
+
+    Matrix multiply(const Matrix &a, const Matrix &b)
+    {
+        Matrix result;
+        for (int column = 0; column < 4; column++)
+        {
+            for (int row = 0; row < 4; row++)
+            {
+                float sum = 0.0f;
+                for (int k = 0; k < 4; k++)
+                {
+                    sum += a.m[k * 4 + row] * b.m[column * 4 + k];
+                }
+                result.m[column * 4 + row] = sum;
+            }
+        }
+        return result;
+    }
+
+    // glm::perspective with a vertical field of view in radians
+    Matrix perspective(float fov, float aspect, float nearPlane, float farPlane)
+    {
+        float f = 1.0f / std::tan(fov * 0.5f);
+        Matrix result{};
+        result.m[0] = f / aspect;
+        result.m[5] = f;
+        result.m[10] = -(farPlane + nearPlane) / (farPlane - nearPlane);
+        result.m[11] = -1.0f;
+        result.m[14] = -2.0f * farPlane * nearPlane / (farPlane - nearPlane);
+        return result;
+    }
+
+    // translation times a rotation by angle around the normalised axis
+    Matrix placement(float x, float y, float z, float angle, float ax, float ay, float az)
+    {
+        float length = std::sqrt(ax * ax + ay * ay + az * az);
+        ax /= length, ay /= length, az /= length;
+        float c = std::cos(angle), s = std::sin(angle), t = 1.0f - c;
+        return Matrix{{t * ax * ax + c, t * ax * ay + s * az, t * ax * az - s * ay, 0.0f, t * ax * ay - s * az,
+                       t * ay * ay + c, t * ay * az + s * ax, 0.0f, t * ax * az + s * ay, t * ay * az - s * ax,
+                       t * az * az + c, 0.0f, x, y, z, 1.0f}};
+    }
+
+    struct Mesh
+    {
+        std::vector<float> positions;
+        std::vector<float> uvs;
+        std::vector<uint32_t> indices;
+    };
+
+    Mesh build(const mesh::PrimitiveCounts &counts, void (*generate)(const mesh::GeometryStreams &, Mesh &))
+    {
+        Mesh result;
+        result.positions.resize(counts.vertexCount * 3);
+        result.uvs.resize(counts.vertexCount * 2);
+        result.indices.resize(counts.indexCount);
+        mesh::GeometryStreams out;
+        out.positions = result.positions.data();
+        out.uvs = result.uvs.data();
+        out.indices = result.indices.data();
+        generate(out, result);
+        return result;
+    }
+
+    soft::DrawCall drawCall(const Mesh &shape, const Matrix &mvp)
+    {
+        soft::DrawCall call;
+        call.positions = shape.positions.data();
+        call.uvs = shape.uvs.data();
+        call.vertexCount = shape.positions.size() / 3;
+        call.indices = shape.indices.data();
+        call.indexCount = shape.indices.size();
+        std::memcpy(call.mvp, mvp.m, sizeof(call.mvp));
+        return call;
+    }
+
+    soft::Texture checker(int size, int cells, const unsigned char a[3], const unsigned char b[3])
+    {
+        std::vector<unsigned char> rgba(static_cast<size_t>(size) * size * 4);
+        for (int y = 0; y < size; y++)
+        {
+            for (int x = 0; x < size; x++)
+            {
+                const unsigned char *color = ((x * cells / size + y * cells / size) & 1) ? a : b;
+                unsigned char *p = &rgba[(static_cast<size_t>(y) * size + x) * 4];
+                p[0] = color[0], p[1] = color[1], p[2] = color[2], p[3] = 255;
+            }
+        }
+        soft::Texture texture;
+        texture.load(rgba.data(), size, size);
+        return texture;
+    }
+
+    // a grid of triangles over the whole viewport with jittered interior vertices; the
+    // fill rule must give every pixel to exactly one of them
+    bool watertight(soft::Rasterizer &rasterizer, int width, int height)
+    {
+        const int n = 37;
+        std::vector<float> positions;
+        uint32_t noise = 987654321u;
+        for (int j = 0; j <= n; j++)
+        {
+            for (int i = 0; i <= n; i++)
+            {
+                float x = -1.0f + 2.0f * i / n, y = -1.0f + 2.0f * j / n;
+                if (i > 0 && i < n && j > 0 && j < n)
+                {
+                    noise = noise * 1664525u + 1013904223u;
+                    x += ((noise >> 8) / 16777216.0f - 0.5f) * 0.8f / n;
+                    noise = noise * 1664525u + 1013904223u;
+                    y += ((noise >> 8) / 16777216.0f - 0.5f) * 0.8f / n;
+                }
+                positions.insert(positions.end(), {x, y, 0.0f});
+            }
+        }
+        std::vector<uint32_t> indices;
+        for (int j = 0; j < n; j++)
+        {
+            for (int i = 0; i < n; i++)
+            {
+                uint32_t v = static_cast<uint32_t>(j * (n + 1) + i);
+                // alternate the diagonal and the winding, clockwise triangles are not culled
+                if ((i + j) & 1)
+                {
+                    indices.insert(indices.end(), {v, v + 1, v + n + 2, v, v + n + 2, v + n + 1});
+                }
+                else
+                {
+                    indices.insert(indices.end(), {v, v + n + 1, v + 1, v + 1, v + n + 1, v + n + 2});
+                }
+            }
+        }
+        soft::Framebuffer target(width, height);
+        const float clearColor[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+        target.clear(clearColor);
+        soft::DrawCall call;
+        call.positions = positions.data();
+        call.vertexCount = positions.size() / 3;
+        call.indices = indices.data();
+        call.indexCount = indices.size();
+        call.depthTest = false;
+        rasterizer.resetStats();
+        rasterizer.draw(target, call);
+        bool covered = true;
+        for (size_t i = 0; i < static_cast<size_t>(width) * height; i++)
+        {
+            covered = covered && target.color()[i * 4 + 3] == 255;
+        }
+        uint64_t expected = static_cast<uint64_t>(width) * height;
+        if (!covered || rasterizer.stats().fragments != expected)
+        {
+            std::cerr << width << "x" << height << ": " << rasterizer.stats().fragments << " fragments for " << expected
+                      << " pixels" << (covered ? "" : ", some uncovered") << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // A floor at y = -1 from z = -1 (u = 0) to z = -5 (u = 1), wider than the view so it
+    // gets clipped, under a 90 degree camera. The texture is one black and one white
+    // texel, so between their centres the bilinear result is 2 * (u - 0.25).
+    bool perspectiveCorrect(soft::Rasterizer &rasterizer, int size)
+    {
+        const float positions[] = {-8.0f, -1.0f, -1.0f, 8.0f, -1.0f, -1.0f, 8.0f, -1.0f, -5.0f, -8.0f, -1.0f, -5.0f};
+        const float uvs[] = {0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f};
+        const uint32_t indices[] = {0, 1, 2, 0, 2, 3};
+        const unsigned char texels[] = {0, 0, 0, 255, 255, 255, 255, 255};
+        soft::Texture ramp;
+        ramp.load(texels, 2, 1);
+
+        soft::Framebuffer target(size, size);
+        const float clearColor[4] = {1.0f, 0.0f, 0.0f, 1.0f};
+        target.clear(clearColor);
+        Matrix projection = perspective(3.14159265f * 0.5f, 1.0f, 0.1f, 100.0f);
+        soft::DrawCall call;
+        call.positions = positions;
+        call.uvs = uvs;
+        call.vertexCount = 4;
+        call.indices = indices;
+        call.indexCount = 6;
+        std::memcpy(call.mvp, projection.m, sizeof(call.mvp));
+        call.texture1 = call.texture2 = &ramp;
+        rasterizer.draw(target, call);
+
+        int checked = 0;
+        float worst = 0.0f;
+        for (int y = 0; y < size; y++)
+        {
+            // the view ray through the row's centres meets the floor at z = 1 / ndc y
+            float ndcY = (y + 0.5f) / size * 2.0f - 1.0f;
+            float u = ndcY < 0.0f ? (-1.0f / ndcY - 1.0f) / 4.0f : -1.0f;
+            if (u < 0.3f || u > 0.7f)
+            {
+                continue;
+            }
+            const unsigned char *pixel = target.color() + (static_cast<size_t>(y) * size + size / 2) * 4;
+            float expected = 2.0f * (u - 0.25f) * 255.0f;
+            worst = std::max(worst, std::fabs(pixel[0] - expected));
+            checked++;
+        }
+        if (checked == 0 || worst > 1.5f)
+        {
+            std::cerr << "perspective: " << checked << " rows, worst error " << worst << " / 255" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    void cubeGenerator(const mesh::GeometryStreams &out, Mesh &)
+    {
+        mesh::generateCube(out);
+    }
+
+    void sphereGenerator(const mesh::GeometryStreams &out, Mesh &)
+    {
+        mesh::generateUvSphere(out, 0.5f, 512, 256);
+    }
+
+    // cubes spread through the view frustum, each turned differently, as in ex5
+    void drawCubes(soft::Rasterizer &rasterizer, soft::Framebuffer &target, const Mesh &cube,
+                   const soft::Texture &texture1, const soft::Texture &texture2, int count)
+    {
+        const float clearColor[4] = {0.2f, 0.3f, 0.3f, 1.0f};
+        target.clear(clearColor);
+        Matrix projection =
+            perspective(0.785398f, static_cast<float>(target.width()) / target.height(), 0.1f, 100.0f);
+        for (int i = 0; i < count; i++)
+        {
+            float x = static_cast<float>(i % 20) - 9.5f, y = static_cast<float>(i / 20 % 12) - 5.5f;
+            float z = -12.0f - 4.0f * (i / 240);
+            Matrix model = placement(x, y * 0.6f, z, 0.35f * i, 1.0f, 0.3f, 0.5f);
+            soft::DrawCall call = drawCall(cube, multiply(projection, model));
+            call.texture1 = &texture1;
+            call.texture2 = &texture2;
+            rasterizer.draw(target, call);
+        }
+    }
+} // namespace
+
+int main()
+{
+    auto milliseconds = [](auto fn)
+    {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    ThreadPool &pool = ThreadPool::shared();
+    soft::Rasterizer rasterizer(pool);
+    bool valid = true;
+    // odd sizes leave partial tiles and partial groups of four
+    const int sizes[][2] = {{1, 1}, {333, 257}, {640, 480}};
+    for (const auto &size : sizes)
+    {
+        valid = watertight(rasterizer, size[0], size[1]) && valid;
+    }
+    valid = perspectiveCorrect(rasterizer, 256) && valid;
+
+    Mesh cube = build(mesh::cubeCounts(1), cubeGenerator);
+    const unsigned char wood[3] = {150, 100, 50}, dark[3] = {60, 40, 20};
+    const unsigned char white[3] = {240, 240, 240}, red[3] = {200, 30, 30};
+    soft::Texture texture1 = checker(512, 8, wood, dark);
+    soft::Texture texture2 = checker(256, 4, white, red);
+
+    // tiles are independent, so the result cannot depend on the number of threads
+    {
+        ThreadPool single(1), several(4);
+        soft::Rasterizer serial(single), parallel(several, 32);
+        soft::Framebuffer a(400, 300), b(400, 300);
+        drawCubes(serial, a, cube, texture1, texture2, 480);
+        drawCubes(parallel, b, cube, texture1, texture2, 480);
+        if (std::memcmp(a.color(), b.color(), 400 * 300 * 4) != 0 ||
+            std::memcmp(a.depth(), b.depth(), 400 * 300 * sizeof(float)) != 0)
+        {
+            std::cerr << "images differ between 1 and 4 threads or tile sizes" << std::endl;
+            valid = false;
+        }
+    }
+
+    const int width = 1920, height = 1080, cubes = 480;
+    soft::Framebuffer target(width, height);
+    drawCubes(rasterizer, target, cube, texture1, texture2, cubes);
+    rasterizer.resetStats();
+    double cubeTime = milliseconds([&] { drawCubes(rasterizer, target, cube, texture1, texture2, cubes); });
+    std::cout << cubes << " cubes at " << width << "x" << height << ": " << cubeTime << " ms, "
+              << rasterizer.stats().fragments / cubeTime / 1e3 << " Mpixels/s shaded, "
+              << width * height / cubeTime / 1e3 << " Mpixels/s of frame" << std::endl;
+
+    Mesh sphere = build(mesh::uvSphereCounts(512, 256), sphereGenerator);
+    Matrix projection = perspective(0.785398f, static_cast<float>(width) / height, 0.1f, 100.0f);
+    soft::DrawCall call = drawCall(sphere, multiply(projection, placement(0.0f, 0.0f, -3.0f, 0.5f, 0.0f, 1.0f, 0.0f)));
+    call.texture1 = &texture1;
+    call.texture2 = &texture2;
+    call.cullBackFaces = true;
+    const float clearColor[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+    target.clear(clearColor);
+    rasterizer.resetStats();
+    double sphereTime = milliseconds([&] { rasterizer.draw(target, call); });
+    size_t submitted = sphere.indices.size() / 3;
+    std::cout << submitted << " triangle sphere: " << sphereTime << " ms, " << submitted / sphereTime / 1e3
+              << " M triangles/s submitted, " << rasterizer.stats().triangles << " front facing, "
+              << rasterizer.stats().fragments / sphereTime / 1e3 << " Mpixels/s shaded" << std::endl;
+    std::cout << "on " << pool.threadCount() << " threads" << std::endl;
+
+    std::cout << (valid ? "checks passed" : "CHECKS FAILED") << std::endl;
+    return valid ? 0 : 1;
+}
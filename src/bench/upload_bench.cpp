@@ -0,0 +1,174 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "upload_scheduler.hpp"
+
+// usage: upload_bench [textures] [size] [budget MB per frame]
+// Streams a batch of RGBA8 textures with full mip chains through UploadScheduler.
+// The upload callback copies into CPU "textures" (standing in for glTexSubImage2D,
+// which also copies the client data), and every texture is compared with its
+// source afterwards. Reports the per-frame cost against uploading everything in
+// one go, and checks that textures finish in priority order.
+namespace
+{
+    std::vector<UploadScheduler::Level> makeLevels(int size, std::mt19937 &rng)
+    {
+        std::vector<UploadScheduler::Level> levels;
+        for (int s = size; s >= 1; s >>= 1)
+        {
+            UploadScheduler::Level level{s, s, std::vector<unsigned char>(static_cast<size_t>(s) * s * 4)};
+            for (unsigned char &v : level.pixels)
+            {
+                v = static_cast<unsigned char>(rng());
+            }
+            levels.push_back(std::move(level));
+        }
+        return levels;
+    }
+
+    // cancel before the submit, during the upload and after it: nothing of a cancelled
+    // texture goes out afterwards, and cancelling a finished one changes nothing
+    bool cancelsCleanly(std::mt19937 &rng)
+    {
+        UploadScheduler::Settings settings;
+        settings.bytesPerFrame = 4096;
+        settings.chunkBytes = 4096;
+        UploadScheduler scheduler(settings);
+        std::vector<uint32_t> uploaded;
+        auto record = [&](const UploadScheduler::Chunk &chunk) { uploaded.push_back(chunk.handle); };
+
+        uint32_t early = scheduler.createHandle();
+        scheduler.cancel(early);
+        scheduler.submit(early, 4, makeLevels(64, rng), 1.0f);
+        uint32_t midway = scheduler.createHandle();
+        scheduler.submit(midway, 4, makeLevels(64, rng), 2.0f);
+        scheduler.process(record);
+        scheduler.cancel(midway);
+        size_t beforeCancel = uploaded.size();
+        uint32_t finished = scheduler.createHandle();
+        scheduler.submit(finished, 4, makeLevels(8, rng), 0.0f);
+        while (scheduler.stats().queuedTextures > 0 || scheduler.stats().frameChunks > 0)
+        {
+            scheduler.process(record);
+        }
+        scheduler.cancel(finished);
+        scheduler.setPriority(finished, 5.0f);
+
+        // the first frame ran out of budget inside midway's chain, only finished comes after it
+        bool valid = beforeCancel > 0 && scheduler.stats().completedTextures == 1;
+        for (size_t i = 0; i < uploaded.size(); i++)
+        {
+            valid = valid && uploaded[i] == (i < beforeCancel ? midway : finished);
+        }
+        return valid;
+    }
+} // namespace
+
+int main(int argc, char **argv)
+{
+    int textureCount = argc > 1 ? std::atoi(argv[1]) : 8;
+    int size = argc > 2 ? std::atoi(argv[2]) : 2048;
+    double budgetMb = argc > 3 ? std::atof(argv[3]) : 8.0;
+
+    std::mt19937 rng(5);
+    std::vector<std::vector<UploadScheduler::Level>> sources;
+    for (int i = 0; i < textureCount; i++)
+    {
+        sources.push_back(makeLevels(size, rng));
+    }
+    // destinations, indexed by handle
+    std::vector<std::vector<std::vector<unsigned char>>> textures(textureCount + 1);
+    auto allocate = [&]
+    {
+        for (int i = 0; i < textureCount; i++)
+        {
+            textures[i + 1].clear();
+            for (const UploadScheduler::Level &level : sources[i])
+            {
+                textures[i + 1].emplace_back(level.pixels.size());
+            }
+        }
+    };
+    auto copyChunk = [&](const UploadScheduler::Chunk &chunk)
+    {
+        size_t rowBytes = static_cast<size_t>(chunk.width) * 4;
+        std::memcpy(textures[chunk.handle][chunk.level].data() + rowBytes * chunk.y, chunk.pixels, chunk.bytes);
+    };
+
+    // everything in one frame, what a load in the render loop would cost
+    allocate();
+    UploadScheduler::Settings unlimited;
+    unlimited.bytesPerFrame = static_cast<size_t>(-1);
+    unlimited.millisecondsPerFrame = 1e9;
+    unlimited.chunkBytes = static_cast<size_t>(-1);
+    UploadScheduler all(unlimited);
+    for (int i = 0; i < textureCount; i++)
+    {
+        all.submit(all.createHandle(), 4, sources[i], 0.0f);
+    }
+    all.process(copyChunk);
+    std::cout << "unbudgeted: " << all.stats().frameMilliseconds << " ms in one frame, "
+              << all.stats().frameBytes / 1048576.0 << " MB" << std::endl;
+
+    // the same batch under a budget, with priorities from a row of objects at growing distances
+    allocate();
+    UploadScheduler::Settings settings;
+    settings.bytesPerFrame = static_cast<size_t>(budgetMb * 1048576.0);
+    UploadScheduler scheduler(settings);
+    std::vector<uint32_t> completionOrder;
+    for (int i = 0; i < textureCount; i++)
+    {
+        float distance = 2.0f + static_cast<float>((i * 5) % textureCount) * 3.0f;
+        scheduler.submit(scheduler.createHandle(), 4, sources[i],
+                         UploadScheduler::screenPriority(1.0f, distance, 0.785f, 1080));
+    }
+    int frames = 0;
+    double worst = 0.0, total = 0.0;
+    size_t worstQueue = 0;
+    do
+    {
+        worstQueue = std::max(worstQueue, scheduler.stats().queuedBytes);
+        scheduler.process(
+            [&](const UploadScheduler::Chunk &chunk)
+            {
+                copyChunk(chunk);
+                if (chunk.textureComplete)
+                {
+                    completionOrder.push_back(chunk.handle);
+                }
+            });
+        frames++;
+        worst = std::max(worst, scheduler.stats().frameMilliseconds);
+        total += scheduler.stats().frameMilliseconds;
+    } while (scheduler.stats().queuedTextures > 0);
+
+    int failures = 0;
+    for (int i = 0; i < textureCount; i++)
+    {
+        for (size_t level = 0; level < sources[i].size(); level++)
+        {
+            failures += textures[i + 1][level] != sources[i][level].pixels;
+        }
+    }
+    // nearer objects (lower distance) must finish first
+    for (size_t i = 1; i < completionOrder.size(); i++)
+    {
+        int a = static_cast<int>(completionOrder[i - 1]) - 1, b = static_cast<int>(completionOrder[i]) - 1;
+        failures += (a * 5) % textureCount > (b * 5) % textureCount;
+    }
+    failures += static_cast<int>(completionOrder.size()) != textureCount;
+    bool cancelled = cancelsCleanly(rng);
+    failures += !cancelled;
+
+    std::cout << "budget " << budgetMb << " MB/frame: " << frames << " frames, worst " << worst << " ms, mean "
+              << total / frames << " ms per frame, " << scheduler.stats().totalChunks << " chunks, peak queue "
+              << worstQueue / 1048576.0 << " MB" << std::endl;
+    std::cout << (cancelled ? "cancelled textures dropped" : "CANCELLED TEXTURES UPLOADED") << std::endl;
+    std::cout << (failures == 0 ? "all textures complete, in priority order" : "MISMATCHES") << std::endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,243 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "virtual_texture.hpp"
+
+// usage: vt_bench [size] [frames] [atlas slots per side]
+// Bakes a size x size virtual texture, then flies a simulated camera over it for
+// the given number of frames, feeding synthetic feedback buffers to VirtualTexture
+// and mirroring its uploads into a CPU copy of the atlas. Every frame the page table
+// is checked against that copy, so the whole CPU path is exercised without a GPU.
+namespace
+{
+    const int FEEDBACK_WIDTH = 160;
+    const int FEEDBACK_HEIGHT = 120;
+
+    // a tilted plane seen in perspective: near rows want fine levels, far rows coarse ones
+    void renderFeedback(std::vector<uint32_t> &feedback, const VirtualTextureFile &file, float time)
+    {
+        float centerU = 0.5f + 0.35f * std::sin(time * 0.21f);
+        float centerV = 0.5f + 0.35f * std::cos(time * 0.13f);
+        float zoom = 0.05f + 0.04f * std::sin(time * 0.5f); // texture fraction covered by the nearest row
+        float texels = static_cast<float>(file.width());
+        for (int y = 0; y < FEEDBACK_HEIGHT; y++)
+        {
+            float depth = 1.0f + 6.0f * y / FEEDBACK_HEIGHT;
+            float span = zoom * depth;
+            // texels per feedback texel, times 8 for the 1/8 size feedback buffer
+            float footprint = span * texels / FEEDBACK_WIDTH / 8.0f;
+            int level = std::clamp(static_cast<int>(std::floor(std::log2(std::max(footprint, 1.0f)))), 0,
+                                   file.levels() - 1);
+            float v = std::clamp(centerV + 0.02f * depth, 0.0f, 0.99999f);
+            for (int x = 0; x < FEEDBACK_WIDTH; x++)
+            {
+                uint32_t &texel = feedback[static_cast<size_t>(y) * FEEDBACK_WIDTH + x];
+                float u = centerU + span * (static_cast<float>(x) / FEEDBACK_WIDTH - 0.5f);
+                if (u < 0.0f || u >= 1.0f)
+                {
+                    texel = 0xFFFFFFFFu; // sky
+                    continue;
+                }
+                int pageX = static_cast<int>(u * file.pagesX(level));
+                int pageY = static_cast<int>(v * file.pagesY(level));
+                texel = FeedbackAnalyzer::encode(vt::pageKey(level, pageX, pageY));
+            }
+        }
+    }
+
+    // Headers bake() would never write must not open, even when the file is long enough
+    // for them: oversized borders and tiles used to overflow paddedTileSize() and the
+    // tile offsets. A well formed single tile file is checked first so the others fail
+    // for the right reason.
+    bool rejectsCorruptHeaders()
+    {
+        std::filesystem::path path = std::filesystem::temp_directory_path() / "vt_bench_header.vtex";
+        struct Case
+        {
+            uint32_t size, tileSize, border;
+            size_t tileBytes; // written after the header, 0 for just the header
+            bool opens;
+        };
+        const Case cases[] = {
+            {128, 128, 4, 136 * 136 * 4, true},
+            {128, 128, 64, 256 * 256 * 4, false}, // border * 2 == tileSize
+            {128, 128, 0x7FFFFFFFu, 0, false},    // border * 2 overflows
+            {0x40000000u, 0x40000000u, 0, 0, false}, // one tile far past the size limit
+        };
+        bool valid = true;
+        for (const Case &c : cases)
+        {
+            std::vector<unsigned char> bytes(32 + c.tileBytes, 0);
+            const uint32_t fields[] = {1, c.size, c.size, c.tileSize, c.border, 1}; // version .. levels
+            std::memcpy(bytes.data(), "VTEX", 4);
+            for (int f = 0; f < 6; f++)
+            {
+                for (int i = 0; i < 4; i++)
+                {
+                    bytes[4 + f * 4 + i] = static_cast<unsigned char>(fields[f] >> (8 * i));
+                }
+            }
+            std::ofstream(path, std::ios::binary | std::ios::trunc)
+                .write(reinterpret_cast<const char *>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+            VirtualTextureFile file;
+            if (file.open(path) != c.opens)
+            {
+                std::cerr << "header with tile size " << c.tileSize << ", border " << c.border
+                          << (c.opens ? " did not open" : " opened") << std::endl;
+                valid = false;
+            }
+        }
+        std::filesystem::remove(path);
+        return valid;
+    }
+} // namespace
+
+int main(int argc, char **argv)
+{
+    int size = argc > 1 ? std::atoi(argv[1]) : 8192;
+    int frames = argc > 2 ? std::atoi(argv[2]) : 600;
+    int slots = argc > 3 ? std::atoi(argv[3]) : 12;
+    const int tileSize = 128;
+    const int border = 4;
+
+    std::filesystem::path path = std::filesystem::temp_directory_path() / "vt_bench.vtex";
+    {
+        std::vector<unsigned char> image(static_cast<size_t>(size) * size * 4);
+        for (int y = 0; y < size; y++)
+        {
+            for (int x = 0; x < size; x++)
+            {
+                unsigned char *p = &image[(static_cast<size_t>(y) * size + x) * 4];
+                p[0] = static_cast<unsigned char>(x * 255 / size);
+                p[1] = static_cast<unsigned char>(y * 255 / size);
+                p[2] = static_cast<unsigned char>(((x >> 5) ^ (y >> 5)) & 1 ? 255 : 0);
+                p[3] = 255;
+            }
+        }
+        auto start = std::chrono::steady_clock::now();
+        if (!VirtualTextureFile::bake(image.data(), size, size, tileSize, border, path))
+        {
+            return 1;
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << "baked " << size << "x" << size << " in " << elapsed.count() << " s, "
+                  << std::filesystem::file_size(path) / (1 << 20) << " MiB on disk" << std::endl;
+    }
+
+    bool headersRejected = rejectsCorruptHeaders();
+    std::cout << (headersRejected ? "corrupt headers rejected" : "CORRUPT HEADERS OPENED") << std::endl;
+
+    VirtualTexture::Settings settings;
+    settings.atlasSlotsX = slots;
+    settings.atlasSlotsY = slots;
+    VirtualTexture texture(path, settings);
+    if (!texture.isOpen())
+    {
+        return 1;
+    }
+    const VirtualTextureFile &file = texture.file();
+    size_t tileBytes = file.tileBytes();
+    std::cout << file.levels() << " levels, " << file.pagesX(0) * file.pagesY(0) << " pages at level 0, atlas of "
+              << slots * slots << " pages (" << slots * slots * tileBytes / (1 << 20) << " MiB)" << std::endl;
+
+    // CPU stand-in for the atlas texture
+    std::vector<unsigned char> atlas(static_cast<size_t>(slots) * slots * tileBytes);
+    std::vector<unsigned char> expected(tileBytes);
+    auto applyUploads = [&]
+    {
+        for (const VirtualTexture::TileUpload &upload : texture.uploads())
+        {
+            std::memcpy(&atlas[(static_cast<size_t>(upload.slotY) * slots + upload.slotX) * tileBytes], upload.pixels,
+                        tileBytes);
+        }
+    };
+    applyUploads();
+
+    std::vector<uint32_t> feedback(static_cast<size_t>(FEEDBACK_WIDTH) * FEEDBACK_HEIGHT);
+    double updateSeconds = 0.0, worstUpdate = 0.0;
+    size_t wanted = 0, exact = 0;
+    int errors = 0;
+    for (int frame = 0; frame < frames; frame++)
+    {
+        renderFeedback(feedback, file, frame / 60.0f);
+        auto start = std::chrono::steady_clock::now();
+        texture.update(feedback.data(), feedback.size());
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        updateSeconds += elapsed.count();
+        worstUpdate = std::max(worstUpdate, elapsed.count());
+        applyUploads();
+
+        // every entry must point at a slot that really holds a page covering it
+        for (int level = 0; level < file.levels(); level++)
+        {
+            const std::vector<uint32_t> &table = texture.pageTable(level);
+            for (int y = 0; y < file.pagesY(level); y++)
+            {
+                for (int x = 0; x < file.pagesX(level); x++)
+                {
+                    uint32_t entry = table[static_cast<size_t>(y) * file.pagesX(level) + x];
+                    int slotX = entry & 0xFF, slotY = (entry >> 8) & 0xFF, resident = (entry >> 16) & 0xFF;
+                    int shift = resident - level;
+                    if ((entry >> 24) != 0xFF || shift < 0 || slotX >= slots || slotY >= slots)
+                    {
+                        errors++;
+                        continue;
+                    }
+                    if ((x + y) % 7 != frame % 7) // spot check the contents, comparing everything is slow
+                    {
+                        continue;
+                    }
+                    file.readTile(vt::pageKey(resident, std::min(x >> shift, file.pagesX(resident) - 1),
+                                              std::min(y >> shift, file.pagesY(resident) - 1)),
+                                  expected.data());
+                    if (std::memcmp(&atlas[(static_cast<size_t>(slotY) * slots + slotX) * tileBytes], expected.data(),
+                                    tileBytes) != 0)
+                    {
+                        errors++;
+                    }
+                }
+            }
+        }
+
+        // how much of the frame could be drawn at the requested level
+        for (uint32_t texel : feedback)
+        {
+            uint32_t page = FeedbackAnalyzer::decode(texel);
+            if (page == vt::INVALID_PAGE)
+            {
+                continue;
+            }
+            wanted++;
+            uint32_t entry = texture.pageTable(vt::pageMip(page))[static_cast<size_t>(vt::pageY(page)) *
+                                                                      file.pagesX(vt::pageMip(page)) +
+                                                                  vt::pageX(page)];
+            exact += static_cast<int>((entry >> 16) & 0xFF) == vt::pageMip(page);
+        }
+        // leave the loader threads a frame's worth of time, like a real frame would
+        std::this_thread::sleep_for(std::chrono::milliseconds(4));
+    }
+
+    const VirtualTexture::Stats &stats = texture.stats();
+    std::cout << "frames " << stats.frames << ", update " << 1000.0 * updateSeconds / frames << " ms avg, "
+              << 1000.0 * worstUpdate << " ms worst" << std::endl;
+    std::cout << "page requests " << stats.requested << ", hits " << stats.hits << ", misses " << stats.misses
+              << " (" << 100.0 * stats.hits / std::max<uint64_t>(1, stats.hits + stats.misses) << "% hit rate)"
+              << std::endl;
+    std::cout << "reads " << stats.reads << ", uploads " << stats.uploads << ", evictions " << stats.evictions
+              << ", dropped " << stats.dropped << std::endl;
+    std::cout << 100.0 * exact / std::max<size_t>(1, wanted) << "% of texels drawn at their requested level"
+              << std::endl;
+    std::cout << (errors == 0 ? "page table consistent with atlas" : "PAGE TABLE ERRORS: ")
+              << (errors == 0 ? "" : std::to_string(errors)) << std::endl;
+
+    std::filesystem::remove(path);
+    return errors == 0 && headersRejected ? 0 : 1;
+}
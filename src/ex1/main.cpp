@@ -45,7 +45,8 @@ int main(void)
     glGenVertexArrays(1, &vao);
     glBindVertexArray(vao);
 
-    // tell OpenGL how to interpret the vertex data
+    // tell OpenGL how to interpret the vertex data. This example spells the calls out; the later ones
+    // declare the layout on a vertex struct and let mesh::VertexArrayCache (vertex_format.hpp) make them
     // The function glVertexAttribPointer has quite a few parameters so let's carefully walk through them:
 
     // The first parameter specifies which vertex attribute we want to configure. Remember that we specified the location of the position vertex
@@ -86,12 +87,10 @@ int main(void)
     // render loop
     while (!glfwWindowShouldClose(gWindow))
     {
-        glfwPollEvents();
-
         glClearColor(0.2f, 0.3f, 0.3f, 1.0f); // https://registry.khronos.org/OpenGL-Refpages/gl4/html/glClearColor.xhtml
         glClear(GL_COLOR_BUFFER_BIT);         // https://registry.khronos.org/OpenGL-Refpages/gl4/html/glClear.xhtml
 
-        double time = glfwGetTime();
+        double time = frameTime();
         // float green_val = ((float)sin(time) / 2.0f) + 0.5f;
         int vertex_col_location = glGetUniformLocation(s.getProgram(), "ourColor");
         // int vertex_offset_location = glGetUniformLocation(s.getProgram(), "offset");
@@ -103,7 +102,8 @@ int main(void)
         glBindVertexArray(vao);
         glDrawArrays(GL_TRIANGLES, 0, 6);
         glBindVertexArray(0);
-        glfwSwapBuffers(gWindow);
+        // swaps and polls events, or counts the frame when running headless
+        endFrame(gWindow);
     }
     // optional: de-allocate all resources once they've outlived their purpose:
     glDeleteVertexArrays(1, &vao);
@@ -1,5 +1,7 @@
 #include "glad/glad.h"
 #include <GLFW/glfw3.h>
+#include <array>
+#include <cstddef>
 #include <iostream>
 #include <fstream>
 #include <sstream>
@@ -8,9 +10,25 @@
 #include <filesystem>
 
 #include "utility.h"
-#include "stb_image.h"
+#include "vertex_format.hpp"
+#include "texture.hpp"
 #include "shader_program.hpp"
 
+// position, color and texture coordinates at the vertex shader's locations 0, 1 and 2
+struct Vertex
+{
+    float position[3];
+    float color[3];
+    float uv[2];
+
+    static constexpr std::array<mesh::VertexAttribute, 3> attributes()
+    {
+        return {mesh::attribute<decltype(position)>(0, offsetof(Vertex, position)),
+                mesh::attribute<decltype(color)>(1, offsetof(Vertex, color)),
+                mesh::attribute<decltype(uv)>(2, offsetof(Vertex, uv))};
+    }
+};
+
 const char *APP_TITLE = "Introduction to Modern OpenGL - Hello Colored Triangle";
 const int gWindowWidth = 800;
 const int gWindowHeight = 600;
@@ -51,89 +69,50 @@ int main()
         return 1;
     }
 
-    float vertices[] = {
+    Vertex vertices[] = {
         // positions          // colors           // texture coords
-        0.5f, 0.5f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f,   // top right
-        0.5f, -0.5f, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f,  // bottom right
-        -0.5f, -0.5f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, // bottom left
-        -0.5f, 0.5f, 0.0f, 1.0f, 1.0f, 0.0f, 0.0f, 1.0f   // top left
+        {{0.5f, 0.5f, 0.0f}, {1.0f, 0.0f, 0.0f}, {1.0f, 1.0f}},   // top right
+        {{0.5f, -0.5f, 0.0f}, {0.0f, 1.0f, 0.0f}, {1.0f, 0.0f}},  // bottom right
+        {{-0.5f, -0.5f, 0.0f}, {0.0f, 0.0f, 1.0f}, {0.0f, 0.0f}}, // bottom left
+        {{-0.5f, 0.5f, 0.0f}, {1.0f, 1.0f, 0.0f}, {0.0f, 1.0f}}   // top left
     };
     unsigned int indices[] = {
         // note that we start from 0!
         0, 1, 3, // first triangle
         1, 2, 3  // second triangle
     };
-    GLuint vao, vbo, ebo;
-    glGenVertexArrays(1, &vao);
+    GLuint vbo, ebo;
     glGenBuffers(1, &vbo);
     glGenBuffers(1, &ebo);
 
-    glBindVertexArray(vao);
-
     glBindBuffer(GL_ARRAY_BUFFER, vbo);
     glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+    // the VAO comes from the vertex struct's layout, with ebo as its element array
+    mesh::VertexArrayCache vertexArrays;
+    vertexArrays.bind<Vertex>(vbo, ebo);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
 
-    // postion attribute
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (GLvoid *)0);
-    glEnableVertexAttribArray(0);
-    // color attribute
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (GLvoid *)(sizeof(GLfloat) * 3));
-    glEnableVertexAttribArray(1);
-    // texture attribute
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (GLvoid *)(sizeof(GLfloat) * 6));
-    glEnableVertexAttribArray(2);
-
     // glBindTexture(GL_TEXTURE_2D, texture);
 
-    int w, h, nrChannels;
-    unsigned char *data;
-    std::string t;
-    unsigned int texture1, texture2;
-    glGenTextures(1, &texture1);
-    glBindTexture(GL_TEXTURE_2D, texture1);
-    // glActiveTexture(GL_TEXTURE1);
-    // set the texture wrapping parameters
-
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT); // set texture wrapping to GL_REPEAT (default wrapping method)
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    // set texture filtering parameters
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    t = assetsDir / "container.jpg";
-    data = stbi_load(t.c_str(), &w, &h, &nrChannels, 0);
-    if (data == NULL)
+    // the tutorial's bilinear min filter, the mip chain is built but not sampled
+    SamplerDesc sampler;
+    sampler.minFilter = GL_LINEAR;
+
+    Texture2D texture1, texture2;
+    if (!texture1.load(assetsDir / "container.jpg", sampler))
     {
         std::cout << "Failed to load texture" << std::endl;
         return 1;
     }
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, w, h, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-    glGenerateMipmap(GL_TEXTURE_2D);
-    stbi_image_free(data);
-
-    glGenTextures(1, &texture2);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, texture2);
-    // set the texture wrapping parameters
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT); // set texture wrapping to GL_REPEAT (default wrapping method)
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    // set texture filtering parameters
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    t = assetsDir / "awesomeface.png";
-    data = stbi_load(t.c_str(), &w, &h, &nrChannels, 0);
-    if (data == NULL)
+    if (!texture2.load(assetsDir / "awesomeface.png", sampler))
     {
         std::cout << "Failed to load texture face" << std::endl;
         return 1;
     }
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-    glGenerateMipmap(GL_TEXTURE_2D);
-    stbi_image_free(data);
+    // texture and sampler go to the units the shader's samplers point at
+    texture1.bind(0);
+    texture2.bind(1);
 
     s.use();
     glUniform1i(glGetUniformLocation(s.getProgram(), "texture1"), 0);
@@ -146,10 +125,9 @@ int main()
         glClear(GL_COLOR_BUFFER_BIT);
         s.use();
         glUniform1f(glGetUniformLocation(s.getProgram(), "interpolate_val"), interpolate_val);
-        glBindVertexArray(vao);
+        vertexArrays.bind<Vertex>(vbo, ebo);
         glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-        glfwSwapBuffers(gWindow);
-        glfwPollEvents();
+        endFrame(gWindow);
     }
 
     return 0;
@@ -1,4 +1,7 @@
+#include <array>
+#include <cstddef>
 #include <iostream>
+#include <vector>
 
 #include "glm/glm.hpp"
 #include "glm/vec4.hpp"
@@ -8,9 +11,28 @@
 #include "glm/gtc/type_ptr.hpp"
 
 #include "utility.h"
-#include "stb_image.h"
+#include "animated_instances.hpp"
+#include "frame_readback.hpp"
+#include "image_encode.hpp"
+#include "vertex_format.hpp"
+#include "buffer_arena.hpp"
+#include "primitives.hpp"
+#include "texture.hpp"
 #include "shader_program.hpp"
 
+// position and texture coordinates at the vertex shader's locations 0 and 2
+struct Vertex
+{
+    float position[3];
+    float uv[2];
+
+    static constexpr std::array<mesh::VertexAttribute, 2> attributes()
+    {
+        return {mesh::attribute<decltype(position)>(0, offsetof(Vertex, position)),
+                mesh::attribute<decltype(uv)>(2, offsetof(Vertex, uv))};
+    }
+};
+
 const char *APP_TITLE = "Introduction to Modern OpenGL - Hello Colored Triangle";
 const int gWindowWidth = 800;
 const int gWindowHeight = 600;
@@ -34,132 +56,71 @@ int main()
     {
         return 1;
     }
+    // builds every cube's model matrix itself from static instance data and the time
+    ShaderProgram instanced(shaderDir);
+    if (!instanced.loadShaders("02_instanced.vs", "01_shader.fs"))
+    {
+        return 1;
+    }
+
+    // a 3-d cube from the primitive generator, written straight into the vertex structs
+    const size_t vertexSize = sizeof(Vertex);
+    mesh::PrimitiveCounts cubeCounts = mesh::cubeCounts(1);
+    std::vector<Vertex> cubeVertices(cubeCounts.vertexCount);
+    std::vector<uint32_t> indices(cubeCounts.indexCount);
+    mesh::GeometryStreams streams;
+    streams.positions = cubeVertices[0].position;
+    streams.positionStride = vertexSize;
+    streams.uvs = cubeVertices[0].uv;
+    streams.uvStride = vertexSize;
+    streams.indices = indices.data();
+    mesh::generateCube(streams, 1.0f, 1);
+    // the tutorial's texture layout rather than the generator's: the sides and caps show
+    // the image with v running against z, front and back as seen from +z
+    for (size_t i = 0; i < cubeVertices.size(); i++)
+    {
+        Vertex &vertex = cubeVertices[i];
+        size_t face = i / 4; // +x, -x, +y, -y, +z, -z
+        vertex.uv[0] = (face < 2 ? vertex.position[1] : vertex.position[0]) + 0.5f;
+        vertex.uv[1] = face < 4 ? 0.5f - vertex.position[2] : vertex.position[1] + 0.5f;
+    }
+    size_t vertexCount = cubeVertices.size();
 
-    float vertices[] = {
-        // a 3-d cube
-        -0.5f, -0.5f, -0.5f, 0.0f, 0.0f,
-        0.5f, -0.5f, -0.5f, 1.0f, 0.0f,
-        0.5f, 0.5f, -0.5f, 1.0f, 1.0f,
-        0.5f, 0.5f, -0.5f, 1.0f, 1.0f,
-        -0.5f, 0.5f, -0.5f, 0.0f, 1.0f,
-        -0.5f, -0.5f, -0.5f, 0.0f, 0.0f,
-
-        -0.5f, -0.5f, 0.5f, 0.0f, 0.0f,
-        0.5f, -0.5f, 0.5f, 1.0f, 0.0f,
-        0.5f, 0.5f, 0.5f, 1.0f, 1.0f,
-        0.5f, 0.5f, 0.5f, 1.0f, 1.0f,
-        -0.5f, 0.5f, 0.5f, 0.0f, 1.0f,
-        -0.5f, -0.5f, 0.5f, 0.0f, 0.0f,
-
-        -0.5f, 0.5f, 0.5f, 1.0f, 0.0f,
-        -0.5f, 0.5f, -0.5f, 1.0f, 1.0f,
-        -0.5f, -0.5f, -0.5f, 0.0f, 1.0f,
-        -0.5f, -0.5f, -0.5f, 0.0f, 1.0f,
-        -0.5f, -0.5f, 0.5f, 0.0f, 0.0f,
-        -0.5f, 0.5f, 0.5f, 1.0f, 0.0f,
-
-        0.5f, 0.5f, 0.5f, 1.0f, 0.0f,
-        0.5f, 0.5f, -0.5f, 1.0f, 1.0f,
-        0.5f, -0.5f, -0.5f, 0.0f, 1.0f,
-        0.5f, -0.5f, -0.5f, 0.0f, 1.0f,
-        0.5f, -0.5f, 0.5f, 0.0f, 0.0f,
-        0.5f, 0.5f, 0.5f, 1.0f, 0.0f,
-
-        -0.5f, -0.5f, -0.5f, 0.0f, 1.0f,
-        0.5f, -0.5f, -0.5f, 1.0f, 1.0f,
-        0.5f, -0.5f, 0.5f, 1.0f, 0.0f,
-        0.5f, -0.5f, 0.5f, 1.0f, 0.0f,
-        -0.5f, -0.5f, 0.5f, 0.0f, 0.0f,
-        -0.5f, -0.5f, -0.5f, 0.0f, 1.0f,
-
-        -0.5f, 0.5f, -0.5f, 0.0f, 1.0f,
-        0.5f, 0.5f, -0.5f, 1.0f, 1.0f,
-        0.5f, 0.5f, 0.5f, 1.0f, 0.0f,
-        0.5f, 0.5f, 0.5f, 1.0f, 0.0f,
-        -0.5f, 0.5f, 0.5f, 0.0f, 0.0f,
-        -0.5f, 0.5f, -0.5f, 0.0f, 1.0f};
-
-    // unsigned int indices[] = {
-    //     // note that we start from 0!
-    //     0, 1, 3, // first triangle
-    //     1, 2, 3  // second triangle
-    // };
-    // GLuint vao, vbo, ebo;
-    GLuint vao, vbo;
-    glGenVertexArrays(1, &vao);
-    glGenBuffers(1, &vbo);
-    // glGenBuffers(1, &ebo);
-
-    glBindVertexArray(vao);
-
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-    // glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-    // glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-
-    // postion attribute
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(GLfloat), (GLvoid *)0);
-    glEnableVertexAttribArray(0);
-    // color attribute
-    // glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (GLvoid *)(sizeof(GLfloat) * 3));
-    // glEnableVertexAttribArray(1);
-    // texture attribute
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(GLfloat), (GLvoid *)(sizeof(GLfloat) * 3));
-    glEnableVertexAttribArray(2);
+    // the cube lives in shared vertex and index arenas, drawn through its base vertex and
+    // first index; the VAO comes from the vertex struct's layout
+    mesh::VertexArrayCache vertexArrays;
+    MeshArena arena(mesh::VertexFormat<Vertex>::layout());
+    ArenaMesh cube = arena.add(cubeVertices.data(), static_cast<uint32_t>(vertexCount), indices.data(),
+                               static_cast<uint32_t>(indices.size()));
 
     // glBindTexture(GL_TEXTURE_2D, texture);
 
-    int w, h, nrChannels;
-    unsigned char *data;
-    std::string t;
-    unsigned int texture1, texture2;
-    glGenTextures(1, &texture1);
-    glBindTexture(GL_TEXTURE_2D, texture1);
-    // glActiveTexture(GL_TEXTURE1);
-    // set the texture wrapping parameters
-
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT); // set texture wrapping to GL_REPEAT (default wrapping method)
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    // set texture filtering parameters
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    t = assetsDir / "container.jpg";
-    data = stbi_load(t.c_str(), &w, &h, &nrChannels, 0);
-    if (data == NULL)
+    // trilinear on purpose: the cubes recede and minify, and the mips are filtered in linear light
+    SamplerDesc sampler;
+    sampler.minFilter = GL_LINEAR_MIPMAP_LINEAR;
+
+    Texture2D texture1, texture2;
+    if (!texture1.load(assetsDir / "container.jpg", sampler))
     {
         std::cout << "Failed to load texture" << std::endl;
         return 1;
     }
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, w, h, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-    glGenerateMipmap(GL_TEXTURE_2D);
-    stbi_image_free(data);
-
-    glGenTextures(1, &texture2);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, texture2);
-    // set the texture wrapping parameters
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT); // set texture wrapping to GL_REPEAT (default wrapping method)
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    // set texture filtering parameters
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    t = assetsDir / "awesomeface.png";
-    data = stbi_load(t.c_str(), &w, &h, &nrChannels, 0);
-    if (data == NULL)
+    if (!texture2.load(assetsDir / "awesomeface.png", sampler))
     {
         std::cout << "Failed to load texture face" << std::endl;
         return 1;
     }
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-    glGenerateMipmap(GL_TEXTURE_2D);
-    stbi_image_free(data);
+    // texture and sampler go to the units the shader's samplers point at
+    texture1.bind(0);
+    texture2.bind(1);
 
     s.use();
     glUniform1i(glGetUniformLocation(s.getProgram(), "texture1"), 0);
     glUniform1i(glGetUniformLocation(s.getProgram(), "texture2"), 1);
+    instanced.use();
+    glUniform1i(glGetUniformLocation(instanced.getProgram(), "texture1"), 0);
+    glUniform1i(glGetUniformLocation(instanced.getProgram(), "texture2"), 1);
+    glUniform1i(glGetUniformLocation(instanced.getProgram(), "instances"), 2);
 
     glEnable(GL_DEPTH_TEST);
 
@@ -189,34 +150,103 @@ int main()
         glm::vec3(1.5f, 0.2f, -1.5f),
         glm::vec3(-1.3f, 1.0f, -1.5f)};
 
-    int viewLoc = glGetUniformLocation(s.getProgram(), "view");
-    glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
+    // every cube spins about (0.5, 1, 0) at its own speed; the parameters never change, so
+    // they go to the GPU once
+    std::vector<AnimatedInstance> cubeInstances;
+    for (unsigned int i = 0; i < 10; i++)
+    {
+        float angle = (5.0f + i + 1) * (i + 1);
+        cubeInstances.push_back(AnimatedInstance{{cubePositions[i].x, cubePositions[i].y, cubePositions[i].z},
+                                                 0.0f,
+                                                 {0.5f, 1.0f, 0.0f},
+                                                 glm::radians(angle)});
+    }
+
+    AnimatedInstances gpuInstances;
+    gpuInstances.upload(cubeInstances);
+    gpuInstances.bind(2);
+
+    for (ShaderProgram *program : {&s, &instanced})
+    {
+        program->use();
+        int viewLoc = glGetUniformLocation(program->getProgram(), "view");
+        glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
 
-    int projectionLoc = glGetUniformLocation(s.getProgram(), "projection");
-    glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, glm::value_ptr(projection));
+        int projectionLoc = glGetUniformLocation(program->getProgram(), "projection");
+        glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, glm::value_ptr(projection));
+    }
+    int timeLoc = glGetUniformLocation(instanced.getProgram(), "time");
+
+    // P records every frame to captures/, written out on a worker thread
+    std::filesystem::path captureDir = "captures";
+    FrameReadback readback([&captureDir](const ReadbackFrame &frame) {
+        writePpm(captureDir / ("frame_" + std::to_string(frame.index) + ".ppm"), frame.pixels, frame.width,
+                 frame.height, true);
+    });
+    bool recording = false;
+    bool recordHeld = false;
+
+    // G switches between animating on the GPU and the CPU
+    bool animateOnGpu = true;
+    bool toggleHeld = false;
     while (!glfwWindowShouldClose(gWindow))
     {
+        bool togglePressed = glfwGetKey(gWindow, GLFW_KEY_G) == GLFW_PRESS;
+        if (togglePressed && !toggleHeld)
+        {
+            animateOnGpu = !animateOnGpu;
+        }
+        toggleHeld = togglePressed;
+        bool recordPressed = glfwGetKey(gWindow, GLFW_KEY_P) == GLFW_PRESS;
+        if (recordPressed && !recordHeld)
+        {
+            recording = !recording;
+            std::filesystem::create_directories(captureDir);
+        }
+        recordHeld = recordPressed;
 
         // send the model, view and projection matrices to the shaders
         glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
 
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        s.use();
+        float time = static_cast<float>(frameTime());
 
-        glBindVertexArray(vao);
-        for (unsigned int i = 0; i < 10; i++)
+        arena.bind(vertexArrays);
+        if (animateOnGpu)
+        {
+            // one uniform per frame, however many cubes there are
+            instanced.use();
+            glUniform1f(timeLoc, time);
+            arena.drawInstanced(cube, 0, static_cast<uint32_t>(indices.size()),
+                                static_cast<uint32_t>(cubeInstances.size()));
+        }
+        else
         {
-            glm::mat4 model = glm::mat3(1.0f);
-            model = glm::translate(model, cubePositions[i]);
-            float angle = (5.0f + i + 1) * (i + 1);
-            model = glm::rotate(model, (float)glfwGetTime() * glm::radians(angle), glm::vec3(0.5f, 1.0f, 0.0f));
+            s.use();
             int modelLoc = glGetUniformLocation(s.getProgram(), "model");
-            glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-            glDrawArrays(GL_TRIANGLES, 0, 36);
+            for (unsigned int i = 0; i < 10; i++)
+            {
+                glm::mat4 model;
+                AnimatedInstances::modelMatrix(cubeInstances[i], time, glm::value_ptr(model));
+                glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
+                arena.draw(cube);
+            }
         }
 
-        glfwSwapBuffers(gWindow);
-        glfwPollEvents();
+        if (recording)
+        {
+            int width, height;
+            glfwGetFramebufferSize(gWindow, &width, &height);
+            readback.capture(width, height);
+        }
+        readback.update();
+        endFrame(gWindow);
+    }
+    readback.finish();
+    if (readback.stats().captured > 0)
+    {
+        std::cout << readback.stats().captured << " frames captured, " << readback.stats().stalls
+                  << " waited for a free buffer" << std::endl;
     }
     return 0;
 }
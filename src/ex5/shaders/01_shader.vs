@@ -1,9 +1,7 @@
 #version 330 core
 layout(location = 0) in vec3 aPos;
-layout(location = 1) in vec3 aColor;
 layout(location = 2) in vec2 aTexCoord;
 
-out vec3 ourColor;
 out vec2 TexCoord;
 
 uniform mat4 model;
@@ -12,6 +10,5 @@ uniform mat4 projection;
 
 void main() {
     gl_Position = projection * view * model * vec4(aPos, 1.0);
-    ourColor = aColor;
     TexCoord = vec2(aTexCoord.x, aTexCoord.y);
 }
@@ -0,0 +1,31 @@
+#version 330 core
+layout(location = 0) in vec3 aPos;
+layout(location = 2) in vec2 aTexCoord;
+
+out vec2 TexCoord;
+
+// two texels per instance: position + phase, rotation axis + angular speed (see AnimatedInstances)
+uniform samplerBuffer instances;
+uniform int firstInstance;
+uniform float time;
+uniform mat4 view;
+uniform mat4 projection;
+
+// the rotation glm::rotate builds, axis of unit length
+mat3 rotation(vec3 axis, float angle) {
+    float c = cos(angle);
+    float s = sin(angle);
+    vec3 k = (1.0 - c) * axis;
+    return mat3(c + k.x * axis.x, k.x * axis.y + s * axis.z, k.x * axis.z - s * axis.y,
+                k.y * axis.x - s * axis.z, c + k.y * axis.y, k.y * axis.z + s * axis.x,
+                k.z * axis.x + s * axis.y, k.z * axis.y - s * axis.x, c + k.z * axis.z);
+}
+
+void main() {
+    int i = (firstInstance + gl_InstanceID) * 2;
+    vec4 placement = texelFetch(instances, i);
+    vec4 spin = texelFetch(instances, i + 1);
+    vec3 world = rotation(spin.xyz, placement.w + time * spin.w) * aPos + placement.xyz;
+    gl_Position = projection * view * vec4(world, 1.0);
+    TexCoord = vec2(aTexCoord.x, aTexCoord.y);
+}
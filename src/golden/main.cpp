@@ -0,0 +1,398 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "image_compare.hpp"
+#include "image_decode.hpp"
+#include "image_encode.hpp"
+#include "thread_pool.hpp"
+
+// usage: golden [--update] [--build DIR] [--source DIR] [--golden DIR] [--output DIR]
+//               [--assets DIR] [--context egl|osmesa] [--tolerance N] [--max-pixels F]
+//               [--min-ssim S] [CASE...]
+// Regression check for rendering changes. Runs every example (or the named cases)
+// headlessly from the build directory at fixed timestamps, capturing frames through
+// LEARNOPENGL_CAPTURE and LEARNOPENGL_FPS, plus the offline renderer on GL and in
+// software. The frames are then compared with the golden images on ThreadPool::shared():
+// a frame fails when more than --max-pixels of its pixels are off by more than
+// --tolerance in a channel, or when its SSIM falls below --min-ssim. Failures leave a
+// frame_NNNNN_diff.png heatmap next to the frame in the output directory. --update
+// replaces the golden images with this run's frames instead of comparing.
+
+struct Options
+{
+    bool update = false;
+    std::filesystem::path build = "build";
+    std::filesystem::path source = "src";
+    std::filesystem::path golden = "src/golden/images";
+    std::filesystem::path output = "golden_output";
+    std::string assets;
+    std::string context = "egl";
+    int tolerance = 2;
+    double maxPixels = 0.001;
+    double minSsim = 0.99;
+    std::vector<std::string> only;
+};
+
+// one program run, its frames compared as a set
+struct Case
+{
+    std::string name;
+    std::string program;
+    std::filesystem::path shaders;
+    long frames = 1;
+    double fps = 0.0; // 0: the program's clock does not matter
+    std::vector<std::string> arguments;
+};
+
+struct FrameCheck
+{
+    std::string name;
+    std::filesystem::path frame;
+    std::filesystem::path golden;
+    bool passed = false;
+    std::string message;
+};
+
+bool parseArguments(int argc, char **argv, Options &options)
+{
+    if (const char *assets = std::getenv("ASSETS_DIR"))
+    {
+        options.assets = assets;
+    }
+    for (int i = 1; i < argc; i++)
+    {
+        std::string flag = argv[i];
+        if (flag == "--update")
+        {
+            options.update = true;
+            continue;
+        }
+        if (flag.compare(0, 2, "--") != 0)
+        {
+            options.only.push_back(flag);
+            continue;
+        }
+        if (i + 1 >= argc)
+        {
+            std::cerr << flag << " needs a value" << std::endl;
+            return false;
+        }
+        std::string value = argv[++i];
+        if (flag == "--build")
+        {
+            options.build = value;
+        }
+        else if (flag == "--source")
+        {
+            options.source = value;
+        }
+        else if (flag == "--golden")
+        {
+            options.golden = value;
+        }
+        else if (flag == "--output")
+        {
+            options.output = value;
+        }
+        else if (flag == "--assets")
+        {
+            options.assets = value;
+        }
+        else if (flag == "--context" && (value == "egl" || value == "osmesa"))
+        {
+            options.context = value;
+        }
+        else if (flag == "--tolerance")
+        {
+            options.tolerance = std::atoi(value.c_str());
+        }
+        else if (flag == "--max-pixels")
+        {
+            options.maxPixels = std::atof(value.c_str());
+        }
+        else if (flag == "--min-ssim")
+        {
+            options.minSsim = std::atof(value.c_str());
+        }
+        else
+        {
+            std::cerr << "unknown option " << flag << " " << value << std::endl;
+            return false;
+        }
+    }
+    if (options.assets.empty())
+    {
+        std::cerr << "the examples need their textures: set ASSETS_DIR or pass --assets" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Static scenes need a single frame. Animated ones get a few at half a second apart,
+// far enough that a wrong clock shows.
+std::vector<Case> allCases(const Options &options)
+{
+    const std::filesystem::path &src = options.source;
+    std::vector<Case> cases = {
+        {"ex1", "ex1", src / "shaders", 1, 0.0, {}},
+        {"ex2", "ex2", src / "ex2" / "shaders", 1, 0.0, {}},
+        {"ex3", "ex3", src / "ex3" / "shaders", 3, 2.0, {}},
+        {"ex4", "ex4", src / "ex4" / "shaders", 1, 0.0, {}},
+        {"ex5", "ex5", src / "ex5" / "shaders", 3, 2.0, {}},
+        {"render", "render", src / "ex5" / "shaders", 3, 2.0,
+         {"--width", "640", "--height", "360", "--context", options.context}},
+        {"render_software", "render", src / "ex5" / "shaders", 3, 2.0,
+         {"--width", "640", "--height", "360", "--context", "software"}},
+    };
+    if (options.only.empty())
+    {
+        return cases;
+    }
+    std::vector<Case> selected;
+    for (const Case &c : cases)
+    {
+        if (std::find(options.only.begin(), options.only.end(), c.name) != options.only.end())
+        {
+            selected.push_back(c);
+        }
+    }
+    return selected;
+}
+
+// an empty value removes the variable
+void setVariable(const char *key, const std::string &value)
+{
+#ifdef _WIN32
+    _putenv_s(key, value.c_str());
+#else
+    if (value.empty())
+    {
+        unsetenv(key);
+    }
+    else
+    {
+        setenv(key, value.c_str(), 1);
+    }
+#endif
+}
+
+std::string quoted(const std::string &text)
+{
+    return "\"" + text + "\"";
+}
+
+// Runs the case's program with its frames going to directory, its output to a log next
+// to them. The examples capture through the environment, the renderer takes flags.
+bool renderCase(const Options &options, const Case &c, const std::filesystem::path &directory)
+{
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+    std::filesystem::path program = options.build / c.program / c.program;
+#ifdef _WIN32
+    program += ".exe";
+#endif
+    std::ostringstream command;
+    command << quoted(program.string());
+    for (const std::string &argument : c.arguments)
+    {
+        command << " " << argument;
+    }
+
+    bool examples = c.program != "render";
+    setVariable("SHADERS_DIR", c.shaders.string());
+    setVariable("ASSETS_DIR", options.assets);
+    setVariable("LEARNOPENGL_CONTEXT", examples ? options.context : "");
+    setVariable("LEARNOPENGL_FRAMES", examples ? std::to_string(c.frames) : "");
+    setVariable("LEARNOPENGL_FPS", examples && c.fps > 0.0 ? std::to_string(c.fps) : "");
+    setVariable("LEARNOPENGL_CAPTURE", examples ? directory.string() : "");
+    if (!examples)
+    {
+        command << " --frames " << c.frames << " --fps " << c.fps << " --output " << quoted(directory.string());
+    }
+    command << " > " << quoted((directory / "log.txt").string()) << " 2>&1";
+
+    int status = std::system(command.str().c_str());
+    if (status != 0)
+    {
+        std::cerr << c.name << ": " << program.string() << " failed (" << status << "), see "
+                  << (directory / "log.txt").string() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// the frame_NNNNN.png files in a directory, in frame order
+std::vector<std::filesystem::path> framesIn(const std::filesystem::path &directory)
+{
+    std::vector<std::filesystem::path> frames;
+    if (!std::filesystem::is_directory(directory))
+    {
+        return frames;
+    }
+    for (const std::filesystem::directory_entry &entry : std::filesystem::directory_iterator(directory))
+    {
+        std::string name = entry.path().filename().string();
+        if (name.compare(0, 6, "frame_") == 0 && entry.path().extension() == ".png" &&
+            name.find("_diff") == std::string::npos)
+        {
+            frames.push_back(entry.path());
+        }
+    }
+    std::sort(frames.begin(), frames.end());
+    return frames;
+}
+
+void checkFrame(const Options &options, FrameCheck &check)
+{
+    int width = 0, height = 0, channels = 0, goldenWidth = 0, goldenHeight = 0;
+    const unsigned char *rgba = loadImage(check.frame, width, height, channels, 4);
+    const unsigned char *reference = loadImage(check.golden, goldenWidth, goldenHeight, channels, 4);
+    if (rgba == nullptr || reference == nullptr)
+    {
+        check.message = "could not be read";
+    }
+    else if (width != goldenWidth || height != goldenHeight)
+    {
+        std::ostringstream message;
+        message << "is " << width << "x" << height << ", golden " << goldenWidth << "x" << goldenHeight;
+        check.message = message.str();
+    }
+    else
+    {
+        diff::Result result = diff::compare(rgba, reference, width, height, options.tolerance);
+        double pixels = static_cast<double>(width) * height;
+        check.passed = result.pixelsOver <= options.maxPixels * pixels && result.ssim >= options.minSsim;
+        std::ostringstream message;
+        message << result.pixelsOver << " pixels over tolerance (" << result.pixelsOver * 100.0 / pixels
+                << "%), max difference " << result.maxDifference << ", mean " << result.meanDifference << ", SSIM "
+                << result.ssim;
+        check.message = message.str();
+        if (!check.passed)
+        {
+            std::vector<unsigned char> map;
+            diff::heatmap(map, rgba, reference, width, height, options.tolerance);
+            std::filesystem::path path = check.frame;
+            path.replace_filename(check.frame.stem().string() + "_diff.png");
+            writePng(path, map.data(), width, height);
+        }
+    }
+    ImageArena::local().reset();
+}
+
+// the case's golden directory becomes a copy of this run's frames
+bool updateGolden(const std::filesystem::path &frames, const std::filesystem::path &golden)
+{
+    std::vector<std::filesystem::path> rendered = framesIn(frames);
+    if (rendered.empty())
+    {
+        std::cerr << frames.string() << " has no frames" << std::endl;
+        return false;
+    }
+    std::filesystem::remove_all(golden);
+    std::filesystem::create_directories(golden);
+    for (const std::filesystem::path &frame : rendered)
+    {
+        std::filesystem::copy_file(frame, golden / frame.filename());
+    }
+    std::cout << golden.string() << ": " << rendered.size() << " frames" << std::endl;
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    Options options;
+    if (!parseArguments(argc, argv, options))
+    {
+        return 2;
+    }
+    std::vector<Case> cases = allCases(options);
+    if (cases.empty())
+    {
+        std::cerr << "no such cases" << std::endl;
+        return 2;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    bool passed = true;
+    std::vector<FrameCheck> checks;
+    for (const Case &c : cases)
+    {
+        std::filesystem::path frames = options.output / c.name;
+        if (!renderCase(options, c, frames))
+        {
+            passed = false;
+            continue;
+        }
+        std::filesystem::path golden = options.golden / c.name;
+        if (options.update)
+        {
+            passed = updateGolden(frames, golden) && passed;
+            continue;
+        }
+        std::vector<std::filesystem::path> rendered = framesIn(frames), expected = framesIn(golden);
+        if (expected.empty())
+        {
+            std::cerr << c.name << ": no golden images in " << golden.string() << ", run with --update" << std::endl;
+            passed = false;
+        }
+        for (const std::filesystem::path &frame : expected)
+        {
+            if (std::find_if(rendered.begin(), rendered.end(), [&](const std::filesystem::path &p)
+                             { return p.filename() == frame.filename(); }) == rendered.end())
+            {
+                std::cerr << c.name << ": " << frame.filename().string() << " was not rendered" << std::endl;
+                passed = false;
+            }
+        }
+        for (const std::filesystem::path &frame : rendered)
+        {
+            if (std::filesystem::exists(golden / frame.filename()))
+            {
+                FrameCheck check;
+                check.name = c.name;
+                check.frame = frame;
+                check.golden = golden / frame.filename();
+                checks.push_back(check);
+            }
+            else
+            {
+                std::cerr << c.name << ": " << frame.filename().string() << " has no golden image" << std::endl;
+                passed = false;
+            }
+        }
+    }
+    auto rendered = std::chrono::steady_clock::now();
+
+    ThreadPool::shared().parallelFor(checks.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++)
+        {
+            checkFrame(options, checks[i]);
+        }
+    });
+    for (const FrameCheck &check : checks)
+    {
+        std::cout << (check.passed ? "ok   " : "FAIL ") << check.name << "/" << check.frame.filename().string()
+                  << " " << check.message << std::endl;
+        passed = passed && check.passed;
+    }
+    auto compared = std::chrono::steady_clock::now();
+
+    auto seconds = [](auto from, auto to) { return std::chrono::duration<double>(to - from).count(); };
+    std::cout << cases.size() << " cases rendered in " << seconds(start, rendered) << " s, " << checks.size()
+              << " frames compared in " << seconds(rendered, compared) << " s" << std::endl;
+    if (options.update)
+    {
+        std::cout << (passed ? "golden images updated" : "UPDATE FAILED") << std::endl;
+    }
+    else
+    {
+        std::cout << (passed ? "all frames match" : "FRAMES DIFFER") << std::endl;
+    }
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,126 @@
+#include "image_arena.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    // match malloc so stb_image's SIMD paths can rely on it
+    const size_t ALIGNMENT = 16;
+
+    size_t alignUp(size_t size)
+    {
+        return (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+    }
+} // namespace
+
+ImageArena::ImageArena(size_t blockSize) : m_current{0}, m_blockSize(blockSize), m_last{nullptr} {};
+
+ImageArena &ImageArena::local()
+{
+    thread_local ImageArena arena;
+    return arena;
+}
+
+void *ImageArena::allocate(size_t size)
+{
+    size = alignUp(std::max<size_t>(size, 1));
+    // try the current block, then any later block left over from a previous decode
+    for (; m_current < m_blocks.size(); m_current++)
+    {
+        Block &block = m_blocks[m_current];
+        if (block.size - block.used >= size)
+        {
+            m_last = block.memory.get() + block.used;
+            block.used += size;
+            return m_last;
+        }
+    }
+
+    // new[] on unsigned char is only guaranteed fundamental alignment, pad to be safe
+    size_t blockSize = std::max(m_blockSize, size + ALIGNMENT);
+    Block block{std::unique_ptr<unsigned char[]>(new (std::nothrow) unsigned char[blockSize]), blockSize, 0};
+    if (!block.memory)
+    {
+        return nullptr;
+    }
+    size_t misalignment = reinterpret_cast<size_t>(block.memory.get()) & (ALIGNMENT - 1);
+    block.used = misalignment ? ALIGNMENT - misalignment : 0;
+    m_last = block.memory.get() + block.used;
+    block.used += size;
+    m_blocks.push_back(std::move(block));
+    m_current = m_blocks.size() - 1;
+    return m_last;
+}
+
+void *ImageArena::reallocate(void *p, size_t oldSize, size_t newSize)
+{
+    if (p == nullptr)
+    {
+        return allocate(newSize);
+    }
+    // growing the most recent allocation in place is the common case (zlib output)
+    if (p == m_last && m_current < m_blocks.size())
+    {
+        Block &block = m_blocks[m_current];
+        size_t offset = static_cast<size_t>(m_last - block.memory.get());
+        if (offset + alignUp(newSize) <= block.size)
+        {
+            block.used = offset + alignUp(newSize);
+            return p;
+        }
+    }
+    void *q = allocate(newSize);
+    if (q != nullptr)
+    {
+        std::memcpy(q, p, std::min(oldSize, newSize));
+    }
+    return q;
+}
+
+void ImageArena::release(void *p)
+{
+    if (p != nullptr && p == m_last && m_current < m_blocks.size())
+    {
+        Block &block = m_blocks[m_current];
+        block.used = static_cast<size_t>(m_last - block.memory.get());
+        m_last = nullptr;
+    }
+}
+
+void ImageArena::reset()
+{
+    for (Block &block : m_blocks)
+    {
+        size_t misalignment = reinterpret_cast<size_t>(block.memory.get()) & (ALIGNMENT - 1);
+        block.used = misalignment ? ALIGNMENT - misalignment : 0;
+    }
+    m_current = 0;
+    m_last = nullptr;
+}
+
+void ImageArena::trim()
+{
+    m_blocks.clear();
+    m_current = 0;
+    m_last = nullptr;
+}
+
+size_t ImageArena::bytesUsed() const
+{
+    size_t used = 0;
+    for (const Block &block : m_blocks)
+    {
+        used += block.used;
+    }
+    return used;
+}
+
+size_t ImageArena::bytesReserved() const
+{
+    size_t reserved = 0;
+    for (const Block &block : m_blocks)
+    {
+        reserved += block.size;
+    }
+    return reserved;
+}
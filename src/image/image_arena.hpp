@@ -0,0 +1,50 @@
+#ifndef IMAGE_ARENA_HPP
+#define IMAGE_ARENA_HPP
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// Per-thread bump allocator behind STBI_MALLOC/STBI_REALLOC_SIZED/STBI_FREE.
+// Decoding allocates a handful of large buffers and frees them in roughly reverse
+// order, so a bump pointer that is rewound once the pixels are uploaded replaces
+// a malloc/free pair per buffer and keeps the blocks warm across a bulk load.
+// Pixels returned by the decoder stay valid until reset() on the decoding thread.
+class ImageArena
+{
+public:
+    ImageArena(size_t blockSize = 8 << 20);
+
+    ImageArena(const ImageArena &) = delete;
+    ImageArena &operator=(const ImageArena &) = delete;
+
+    // the arena owned by the calling thread
+    static ImageArena &local();
+
+    void *allocate(size_t size);
+    void *reallocate(void *p, size_t oldSize, size_t newSize);
+    // only the most recent allocation is actually given back, the rest waits for reset()
+    void release(void *p);
+    // forget every allocation, the blocks are kept for the next decode
+    void reset();
+    // give the blocks back to the system as well
+    void trim();
+
+    size_t bytesUsed() const;
+    size_t bytesReserved() const;
+
+private:
+    struct Block
+    {
+        std::unique_ptr<unsigned char[]> memory;
+        size_t size;
+        size_t used;
+    };
+    // vars
+    std::vector<Block> m_blocks;
+    size_t m_current;
+    size_t m_blockSize;
+    unsigned char *m_last;
+};
+
+#endif // IMAGE_ARENA_HPP
@@ -0,0 +1,320 @@
+#include "image_compare.hpp"
+#include "cpu_features.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef LEARNOPENGL_X86
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    // SSIM windows are WINDOW x WINDOW pixels, partial ones along the right and top edges
+    const int WINDOW = 8;
+    // the usual stabilising constants for 8 bit data, (0.01 * 255)^2 and (0.03 * 255)^2
+    const double C1 = 6.5025;
+    const double C2 = 58.5225;
+
+    struct PixelSums
+    {
+        uint64_t over = 0;
+        uint64_t sum = 0;
+        int max = 0;
+    };
+
+    // luma sums over a window, exact in integers so every kernel agrees
+    struct WindowSums
+    {
+        int64_t x = 0, y = 0, xx = 0, yy = 0, xy = 0;
+        int count = 0;
+    };
+
+    double windowSsim(const WindowSums &s)
+    {
+        double n = s.count;
+        double mx = s.x / n, my = s.y / n;
+        double vx = s.xx / n - mx * mx, vy = s.yy / n - my * my, cxy = s.xy / n - mx * my;
+        return ((2.0 * mx * my + C1) * (2.0 * cxy + C2)) / ((mx * mx + my * my + C1) * (vx + vy + C2));
+    }
+
+    // ---------------------------------------------------------------------------
+    // scalar kernels, also used for the tails of the SIMD loops
+
+    void pixelsScalar(const unsigned char *a, const unsigned char *b, size_t count, int tolerance, PixelSums &sums)
+    {
+        for (size_t i = 0; i < count; i++, a += 4, b += 4)
+        {
+            int largest = 0;
+            for (int c = 0; c < 3; c++)
+            {
+                int difference = a[c] > b[c] ? a[c] - b[c] : b[c] - a[c];
+                largest = std::max(largest, difference);
+                sums.sum += difference;
+            }
+            sums.max = std::max(sums.max, largest);
+            sums.over += largest > tolerance ? 1 : 0;
+        }
+    }
+
+    unsigned char luma(const unsigned char *p)
+    {
+        // BT.601 weights in 8 bit fixed point, 255 stays 255
+        return static_cast<unsigned char>((77 * p[0] + 150 * p[1] + 29 * p[2] + 128) >> 8);
+    }
+
+    void lumaScalar(const unsigned char *rgba, unsigned char *out, size_t count)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            out[i] = luma(rgba + i * 4);
+        }
+    }
+
+    WindowSums windowScalar(const unsigned char *a, const unsigned char *b, size_t stride, int width, int height)
+    {
+        WindowSums s;
+        for (int y = 0; y < height; y++)
+        {
+            for (int x = 0; x < width; x++)
+            {
+                int64_t p = a[y * stride + x], q = b[y * stride + x];
+                s.x += p, s.y += q, s.xx += p * p, s.yy += q * q, s.xy += p * q;
+            }
+        }
+        s.count = width * height;
+        return s;
+    }
+
+#ifdef LEARNOPENGL_X86
+    const uint32_t RGB_MASK = 0x00FFFFFFu;
+
+    size_t pixelsSse2(const unsigned char *a, const unsigned char *b, size_t count, int tolerance, PixelSums &sums)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i rgb = _mm_set1_epi32(static_cast<int>(RGB_MASK));
+        const __m128i limit = _mm_set1_epi8(static_cast<char>(tolerance));
+        __m128i total = zero, largest = zero, within = zero;
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i * 4));
+            __m128i q = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i * 4));
+            __m128i difference = _mm_and_si128(_mm_or_si128(_mm_subs_epu8(p, q), _mm_subs_epu8(q, p)), rgb);
+            total = _mm_add_epi64(total, _mm_sad_epu8(difference, zero));
+            largest = _mm_max_epu8(largest, difference);
+            // a pixel is within tolerance when none of its channels exceeds it; -1 per such pixel
+            within = _mm_sub_epi32(within, _mm_cmpeq_epi32(_mm_subs_epu8(difference, limit), zero));
+        }
+        alignas(16) unsigned char bytes[16];
+        alignas(16) uint64_t sum[2];
+        alignas(16) int32_t inside[4];
+        _mm_store_si128(reinterpret_cast<__m128i *>(bytes), largest);
+        _mm_store_si128(reinterpret_cast<__m128i *>(sum), total);
+        _mm_store_si128(reinterpret_cast<__m128i *>(inside), within);
+        sums.max = std::max(sums.max, static_cast<int>(*std::max_element(bytes, bytes + 16)));
+        sums.sum += sum[0] + sum[1];
+        sums.over += i - (static_cast<uint64_t>(inside[0]) + inside[1] + inside[2] + inside[3]);
+        return i;
+    }
+
+    LEARNOPENGL_TARGET("avx2")
+    size_t pixelsAvx2(const unsigned char *a, const unsigned char *b, size_t count, int tolerance, PixelSums &sums)
+    {
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i rgb = _mm256_set1_epi32(static_cast<int>(RGB_MASK));
+        const __m256i limit = _mm256_set1_epi8(static_cast<char>(tolerance));
+        __m256i total = zero, largest = zero, within = zero;
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m256i p = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i * 4));
+            __m256i q = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + i * 4));
+            __m256i difference =
+                _mm256_and_si256(_mm256_or_si256(_mm256_subs_epu8(p, q), _mm256_subs_epu8(q, p)), rgb);
+            total = _mm256_add_epi64(total, _mm256_sad_epu8(difference, zero));
+            largest = _mm256_max_epu8(largest, difference);
+            within = _mm256_sub_epi32(within, _mm256_cmpeq_epi32(_mm256_subs_epu8(difference, limit), zero));
+        }
+        alignas(32) unsigned char bytes[32];
+        alignas(32) uint64_t sum[4];
+        alignas(32) int32_t inside[8];
+        _mm256_store_si256(reinterpret_cast<__m256i *>(bytes), largest);
+        _mm256_store_si256(reinterpret_cast<__m256i *>(sum), total);
+        _mm256_store_si256(reinterpret_cast<__m256i *>(inside), within);
+        sums.max = std::max(sums.max, static_cast<int>(*std::max_element(bytes, bytes + 32)));
+        sums.sum += sum[0] + sum[1] + sum[2] + sum[3];
+        uint64_t pixelsWithin = 0;
+        for (int32_t lane : inside)
+        {
+            pixelsWithin += static_cast<uint64_t>(lane);
+        }
+        sums.over += i - pixelsWithin;
+        return i;
+    }
+
+    size_t lumaSse2(const unsigned char *rgba, unsigned char *out, size_t count)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i weights = _mm_setr_epi16(77, 150, 29, 0, 77, 150, 29, 0);
+        const __m128i half = _mm_set1_epi32(128);
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rgba + i * 4));
+            // per pixel 77 r + 150 g and 29 b + 0 a, then the two halves added
+            __m128i low = _mm_madd_epi16(_mm_unpacklo_epi8(v, zero), weights);
+            __m128i high = _mm_madd_epi16(_mm_unpackhi_epi8(v, zero), weights);
+            low = _mm_add_epi32(low, _mm_shuffle_epi32(low, _MM_SHUFFLE(2, 3, 0, 1)));
+            high = _mm_add_epi32(high, _mm_shuffle_epi32(high, _MM_SHUFFLE(2, 3, 0, 1)));
+            __m128i sums = _mm_unpacklo_epi64(_mm_shuffle_epi32(low, _MM_SHUFFLE(3, 1, 2, 0)),
+                                              _mm_shuffle_epi32(high, _MM_SHUFFLE(3, 1, 2, 0)));
+            sums = _mm_srli_epi32(_mm_add_epi32(sums, half), 8);
+            __m128i bytes = _mm_packus_epi16(_mm_packs_epi32(sums, zero), zero);
+            int32_t packed = _mm_cvtsi128_si32(bytes);
+            std::memcpy(out + i, &packed, sizeof(packed));
+        }
+        return i;
+    }
+
+    int32_t horizontalSum(__m128i v)
+    {
+        v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+        v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+        return _mm_cvtsi128_si32(v);
+    }
+
+    // a whole 8x8 window; the sums of squares stay below 2^23
+    WindowSums windowSse2(const unsigned char *a, const unsigned char *b, size_t stride)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i ones = _mm_set1_epi16(1);
+        __m128i x = zero, y = zero, xx = zero, yy = zero, xy = zero;
+        for (int row = 0; row < WINDOW; row++)
+        {
+            __m128i p = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(a + row * stride)), zero);
+            __m128i q = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(b + row * stride)), zero);
+            x = _mm_add_epi32(x, _mm_madd_epi16(p, ones));
+            y = _mm_add_epi32(y, _mm_madd_epi16(q, ones));
+            xx = _mm_add_epi32(xx, _mm_madd_epi16(p, p));
+            yy = _mm_add_epi32(yy, _mm_madd_epi16(q, q));
+            xy = _mm_add_epi32(xy, _mm_madd_epi16(p, q));
+        }
+        WindowSums s;
+        s.x = horizontalSum(x);
+        s.y = horizontalSum(y);
+        s.xx = horizontalSum(xx);
+        s.yy = horizontalSum(yy);
+        s.xy = horizontalSum(xy);
+        s.count = WINDOW * WINDOW;
+        return s;
+    }
+#endif
+
+    diff::Result run(const unsigned char *rgba, const unsigned char *reference, int width, int height, int tolerance,
+                     [[maybe_unused]] bool simd)
+    {
+        diff::Result result;
+        if (width <= 0 || height <= 0)
+        {
+            return result;
+        }
+        tolerance = std::min(std::max(tolerance, 0), 255);
+        size_t count = static_cast<size_t>(width) * height;
+
+        PixelSums sums;
+        size_t done = 0;
+#ifdef LEARNOPENGL_X86
+        if (simd)
+        {
+            done = cpu::hasAvx2() ? pixelsAvx2(rgba, reference, count, tolerance, sums)
+                                  : pixelsSse2(rgba, reference, count, tolerance, sums);
+        }
+#endif
+        pixelsScalar(rgba + done * 4, reference + done * 4, count - done, tolerance, sums);
+        result.pixelsOver = sums.over;
+        result.maxDifference = sums.max;
+        result.meanDifference = static_cast<double>(sums.sum) / (count * 3);
+
+        std::vector<unsigned char> lumas[2] = {std::vector<unsigned char>(count), std::vector<unsigned char>(count)};
+        const unsigned char *images[2] = {rgba, reference};
+        for (int k = 0; k < 2; k++)
+        {
+            done = 0;
+#ifdef LEARNOPENGL_X86
+            done = simd ? lumaSse2(images[k], lumas[k].data(), count) : 0;
+#endif
+            lumaScalar(images[k] + done * 4, lumas[k].data() + done, count - done);
+        }
+
+        double ssim = 0.0;
+        for (int y = 0; y < height; y += WINDOW)
+        {
+            for (int x = 0; x < width; x += WINDOW)
+            {
+                int w = std::min(WINDOW, width - x), h = std::min(WINDOW, height - y);
+                size_t offset = static_cast<size_t>(y) * width + x;
+                WindowSums s;
+#ifdef LEARNOPENGL_X86
+                if (simd && w == WINDOW && h == WINDOW)
+                {
+                    s = windowSse2(lumas[0].data() + offset, lumas[1].data() + offset, width);
+                }
+                else
+#endif
+                {
+                    s = windowScalar(lumas[0].data() + offset, lumas[1].data() + offset, width, w, h);
+                }
+                // weighted by area, so partial windows count for what they cover
+                ssim += windowSsim(s) * s.count;
+            }
+        }
+        result.ssim = ssim / count;
+        return result;
+    }
+} // namespace
+
+// ---------------------------------------------------------------------------
+// entry points
+
+diff::Result diff::scalar::compare(const unsigned char *rgba, const unsigned char *reference, int width, int height,
+                                   int tolerance)
+{
+    return run(rgba, reference, width, height, tolerance, false);
+}
+
+diff::Result diff::compare(const unsigned char *rgba, const unsigned char *reference, int width, int height,
+                           int tolerance)
+{
+    return run(rgba, reference, width, height, tolerance, true);
+}
+
+void diff::heatmap(std::vector<unsigned char> &out, const unsigned char *rgba, const unsigned char *reference,
+                   int width, int height, int tolerance)
+{
+    size_t count = static_cast<size_t>(std::max(width, 0)) * std::max(height, 0);
+    tolerance = std::min(std::max(tolerance, 0), 255);
+    out.resize(count * 4);
+    for (size_t i = 0; i < count; i++)
+    {
+        const unsigned char *p = rgba + i * 4, *q = reference + i * 4;
+        unsigned char *o = out.data() + i * 4;
+        int largest = 0;
+        for (int c = 0; c < 3; c++)
+        {
+            largest = std::max(largest, p[c] > q[c] ? p[c] - q[c] : q[c] - p[c]);
+        }
+        if (largest <= tolerance)
+        {
+            o[0] = o[1] = o[2] = static_cast<unsigned char>(luma(q) / 3);
+        }
+        else
+        {
+            // yellow fading to red as the difference grows
+            o[0] = 255;
+            o[1] = static_cast<unsigned char>(255 - (largest - tolerance - 1) * 255 / std::max(254 - tolerance, 1));
+            o[2] = 0;
+        }
+        o[3] = 255;
+    }
+}
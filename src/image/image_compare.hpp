@@ -0,0 +1,38 @@
+#ifndef IMAGE_COMPARE_HPP
+#define IMAGE_COMPARE_HPP
+
+#include <cstdint>
+#include <vector>
+
+// Compares rendered frames with reference images of the same size, both width * height
+// RGBA8 in tightly packed rows; alpha is ignored, like the encoders drop it. Two
+// measures: the pixels with a channel off by more than a tolerance, which catches a
+// handful of wrong pixels, and the mean SSIM of the luma over 8x8 windows, which catches
+// changes in structure (blur, shifted edges, banding) made of individually small errors.
+// Every function picks an SSE2 or AVX2 kernel at run time; diff::scalar holds the plain
+// versions the SIMD ones are checked against. Safe to call from any number of threads.
+namespace diff
+{
+    struct Result
+    {
+        uint64_t pixelsOver = 0;     // pixels with a channel differing by more than the tolerance
+        int maxDifference = 0;       // largest channel difference, 0-255
+        double meanDifference = 0.0; // mean absolute channel difference
+        double ssim = 1.0;           // 1 for identical luma, lower as structure departs
+    };
+
+    Result compare(const unsigned char *rgba, const unsigned char *reference, int width, int height, int tolerance);
+
+    // Where two images differ, as RGBA8: the reference in dim grey, pixels over the
+    // tolerance from yellow (just over) to red (255 off).
+    void heatmap(std::vector<unsigned char> &out, const unsigned char *rgba, const unsigned char *reference, int width,
+                 int height, int tolerance);
+
+    namespace scalar
+    {
+        Result compare(const unsigned char *rgba, const unsigned char *reference, int width, int height,
+                       int tolerance);
+    } // namespace scalar
+} // namespace diff
+
+#endif // IMAGE_COMPARE_HPP
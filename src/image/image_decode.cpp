@@ -0,0 +1,64 @@
+#include "image_decode.hpp"
+#include "jpeg_decoder.hpp"
+#include "mapped_file.hpp"
+#include "stb_image.h"
+#include <climits>
+#include <iostream>
+
+unsigned char *loadImage(const std::filesystem::path &path, int &width, int &height, int &channels,
+                         int desiredChannels)
+{
+    MappedFile file(path);
+    if (!file.isOpen() || file.size() > INT_MAX)
+    {
+        std::cerr << "Error: unable to read image " << path.string() << std::endl;
+        return nullptr;
+    }
+
+    // baseline JPEGs take the AVX2 path, jpegLoadFromMemory hands everything else to stb_image
+    bool jpeg = file.size() >= 2 && file.data()[0] == 0xFF && file.data()[1] == 0xD8;
+    int size = static_cast<int>(file.size());
+    unsigned char *pixels = jpeg ? jpegLoadFromMemory(file.data(), size, &width, &height, &channels, desiredChannels)
+                                 : stbi_load_from_memory(file.data(), size, &width, &height, &channels, desiredChannels);
+    if (pixels == nullptr)
+    {
+        std::cerr << "Error: unable to decode image " << path.string() << ": " << stbi_failure_reason() << std::endl;
+    }
+    return pixels;
+}
+
+float *loadImageHdr(const std::filesystem::path &path, int &width, int &height, int &channels, int desiredChannels)
+{
+    MappedFile file(path);
+    if (!file.isOpen() || file.size() > INT_MAX)
+    {
+        std::cerr << "Error: unable to read image " << path.string() << std::endl;
+        return nullptr;
+    }
+
+    int size = static_cast<int>(file.size());
+    float *pixels = nullptr;
+    if (!stbi_is_hdr_from_memory(file.data(), size) && stbi_is_16_bit_from_memory(file.data(), size))
+    {
+        // stbi_loadf would squeeze these through 8 bits first
+        stbi_us *wide = stbi_load_16_from_memory(file.data(), size, &width, &height, &channels, desiredChannels);
+        if (wide != nullptr)
+        {
+            size_t count = static_cast<size_t>(width) * height * (desiredChannels ? desiredChannels : channels);
+            pixels = static_cast<float *>(ImageArena::local().allocate(count * sizeof(float)));
+            for (size_t i = 0; i < count; i++)
+            {
+                pixels[i] = wide[i] * (1.0f / 65535.0f);
+            }
+        }
+    }
+    else
+    {
+        pixels = stbi_loadf_from_memory(file.data(), size, &width, &height, &channels, desiredChannels);
+    }
+    if (pixels == nullptr)
+    {
+        std::cerr << "Error: unable to decode image " << path.string() << ": " << stbi_failure_reason() << std::endl;
+    }
+    return pixels;
+}
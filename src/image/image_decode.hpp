@@ -0,0 +1,22 @@
+#ifndef IMAGE_DECODE_HPP
+#define IMAGE_DECODE_HPP
+
+#include <filesystem>
+
+#include "image_arena.hpp"
+
+// Decodes a JPEG or PNG file through a memory mapping.
+// The pixels live in the calling thread's ImageArena: upload them, then call
+// ImageArena::local().reset() (never stbi_image_free/free on them).
+// desiredChannels works like stbi_load's req_comp, 0 keeps the file's layout.
+// Returns nullptr and prints the reason on failure.
+unsigned char *loadImage(const std::filesystem::path &path, int &width, int &height, int &channels,
+                         int desiredChannels = 0);
+
+// Decodes to linear floats for lighting data. Radiance .hdr files come through as is,
+// 16 bit PNGs are scaled to [0, 1] without a transfer curve, 8 bit images are
+// linearised with stb_image's 2.2 gamma. Same arena and error rules as loadImage.
+float *loadImageHdr(const std::filesystem::path &path, int &width, int &height, int &channels,
+                    int desiredChannels = 0);
+
+#endif // IMAGE_DECODE_HPP
@@ -0,0 +1,480 @@
+#include "image_encode.hpp"
+#include "cpu_features.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#ifdef LEARNOPENGL_X86
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    // ---------------------------------------------------------------------------
+    // checksums
+
+    struct CrcTable
+    {
+        uint32_t entries[256];
+
+        CrcTable()
+        {
+            for (uint32_t n = 0; n < 256; n++)
+            {
+                uint32_t c = n;
+                for (int k = 0; k < 8; k++)
+                {
+                    c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                }
+                entries[n] = c;
+            }
+        }
+    };
+
+    uint32_t crc32(uint32_t crc, const unsigned char *data, size_t size)
+    {
+        static const CrcTable table;
+        crc = ~crc;
+        for (size_t i = 0; i < size; i++)
+        {
+            crc = table.entries[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+        }
+        return ~crc;
+    }
+
+    uint32_t adler32(const unsigned char *data, size_t size)
+    {
+        // largest run of bytes before the sums can overflow 32 bits
+        const size_t NMAX = 5552;
+        uint32_t a = 1, b = 0;
+        while (size > 0)
+        {
+            size_t run = size < NMAX ? size : NMAX;
+            size -= run;
+            for (size_t i = 0; i < run; i++)
+            {
+                a += data[i];
+                b += a;
+            }
+            data += run;
+            a %= 65521;
+            b %= 65521;
+        }
+        return (b << 16) | a;
+    }
+
+    // ---------------------------------------------------------------------------
+    // deflate, fixed Huffman code (RFC 1951 3.2.6)
+
+    const uint16_t LENGTH_BASE[29] = {3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+                                      31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+    const uint8_t LENGTH_EXTRA[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                                      2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+    const uint16_t DISTANCE_BASE[30] = {1,   2,   3,   4,   5,   7,    9,    13,   17,   25,   33,   49,   65,    97,    129,
+                                        193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+    const uint8_t DISTANCE_EXTRA[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+    const int WINDOW = 32768;
+    const int MIN_MATCH = 4; // what the hash covers; deflate itself allows 3
+    const int MAX_MATCH = 258;
+    const int HASH_BITS = 15;
+
+    // codes bit reversed, deflate sends Huffman codes most significant bit first
+    struct FixedCode
+    {
+        uint16_t literal[288];
+        uint8_t literalLength[288];
+        uint8_t distance[30];
+        uint8_t lengthSymbol[MAX_MATCH + 1];
+        uint8_t distanceSymbol[WINDOW + 1];
+
+        static uint16_t reverse(uint16_t code, int length)
+        {
+            uint16_t reversed = 0;
+            for (int i = 0; i < length; i++)
+            {
+                reversed = static_cast<uint16_t>((reversed << 1) | ((code >> i) & 1));
+            }
+            return reversed;
+        }
+
+        FixedCode()
+        {
+            for (int symbol = 0; symbol < 288; symbol++)
+            {
+                int code, length;
+                if (symbol < 144)
+                {
+                    code = 0x30 + symbol, length = 8;
+                }
+                else if (symbol < 256)
+                {
+                    code = 0x190 + symbol - 144, length = 9;
+                }
+                else if (symbol < 280)
+                {
+                    code = symbol - 256, length = 7;
+                }
+                else
+                {
+                    code = 0xC0 + symbol - 280, length = 8;
+                }
+                literal[symbol] = reverse(static_cast<uint16_t>(code), length);
+                literalLength[symbol] = static_cast<uint8_t>(length);
+            }
+            for (int symbol = 0; symbol < 30; symbol++)
+            {
+                distance[symbol] = static_cast<uint8_t>(reverse(static_cast<uint16_t>(symbol), 5));
+            }
+            // 258 has a code of its own, 284 only reaches 257
+            for (int symbol = 0; symbol < 28; symbol++)
+            {
+                for (int j = 0; j < (1 << LENGTH_EXTRA[symbol]) && LENGTH_BASE[symbol] + j < MAX_MATCH; j++)
+                {
+                    lengthSymbol[LENGTH_BASE[symbol] + j] = static_cast<uint8_t>(symbol);
+                }
+            }
+            lengthSymbol[MAX_MATCH] = 28;
+            for (int symbol = 0; symbol < 30; symbol++)
+            {
+                for (int j = 0; j < (1 << DISTANCE_EXTRA[symbol]) && DISTANCE_BASE[symbol] + j <= WINDOW; j++)
+                {
+                    distanceSymbol[DISTANCE_BASE[symbol] + j] = static_cast<uint8_t>(symbol);
+                }
+            }
+        }
+    };
+
+    // least significant bit first, as deflate packs everything but the Huffman codes.
+    // Writes through a pointer into room the caller has reserved.
+    class BitWriter
+    {
+    public:
+        explicit BitWriter(unsigned char *out) : m_out{out}, m_bits{0}, m_count{0} {}
+
+        void put(uint32_t value, int count)
+        {
+            m_bits |= static_cast<uint64_t>(value) << m_count;
+            m_count += count;
+            if (m_count >= 32)
+            {
+                for (int i = 0; i < 4; i++)
+                {
+                    *m_out++ = static_cast<unsigned char>(m_bits >> (i * 8));
+                }
+                m_bits >>= 32;
+                m_count -= 32;
+            }
+        }
+
+        // pads to a whole byte, returns the end of the output
+        unsigned char *flush()
+        {
+            for (; m_count > 0; m_count -= 8)
+            {
+                *m_out++ = static_cast<unsigned char>(m_bits);
+                m_bits >>= 8;
+            }
+            m_count = 0;
+            return m_out;
+        }
+
+    private:
+        // vars
+        unsigned char *m_out;
+        uint64_t m_bits;
+        int m_count;
+    };
+
+    uint32_t load32(const unsigned char *p)
+    {
+        uint32_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    // how many of the first limit bytes of a and b agree, eight at a time
+    size_t matchLength(const unsigned char *a, const unsigned char *b, size_t limit)
+    {
+        size_t length = 0;
+        while (length + 8 <= limit)
+        {
+            uint64_t x, y;
+            std::memcpy(&x, a + length, 8);
+            std::memcpy(&y, b + length, 8);
+            if (x != y)
+            {
+#if defined(__GNUC__) || defined(__clang__)
+                // little endian: the lowest differing bit is in the first differing byte
+                return length + static_cast<size_t>(__builtin_ctzll(x ^ y) >> 3);
+#else
+                break;
+#endif
+            }
+            length += 8;
+        }
+        while (length < limit && a[length] == b[length])
+        {
+            length++;
+        }
+        return length;
+    }
+
+    // Greedy LZ77 with one candidate per hash bucket, one fixed Huffman block.
+    void deflate(std::vector<unsigned char> &out, const unsigned char *data, size_t size)
+    {
+        static const FixedCode fixed;
+        std::vector<uint32_t> head(size_t(1) << HASH_BITS, 0); // position + 1, 0 is empty
+        // a literal takes at most 9 bits, a match fewer than its bytes would
+        size_t start = out.size();
+        out.resize(start + size + size / 8 + 16);
+        BitWriter bits(out.data() + start);
+        bits.put(1, 1); // final block
+        bits.put(1, 2); // fixed Huffman code
+
+        auto literal = [&](unsigned char byte) { bits.put(fixed.literal[byte], fixed.literalLength[byte]); };
+        size_t i = 0;
+        while (i + MIN_MATCH <= size)
+        {
+            uint32_t hash = (load32(data + i) * 2654435761u) >> (32 - HASH_BITS);
+            size_t candidate = head[hash];
+            head[hash] = static_cast<uint32_t>(i + 1);
+            if (candidate == 0 || i + 1 - candidate > WINDOW || load32(data + candidate - 1) != load32(data + i))
+            {
+                literal(data[i++]);
+                continue;
+            }
+            const unsigned char *match = data + candidate - 1;
+            size_t limit = std::min(size - i, static_cast<size_t>(MAX_MATCH));
+            size_t length = MIN_MATCH + matchLength(match + MIN_MATCH, data + i + MIN_MATCH, limit - MIN_MATCH);
+            size_t distance = data + i - match;
+
+            int lengthSymbol = fixed.lengthSymbol[length];
+            int code = 257 + lengthSymbol;
+            bits.put(fixed.literal[code], fixed.literalLength[code]);
+            bits.put(static_cast<uint32_t>(length - LENGTH_BASE[lengthSymbol]), LENGTH_EXTRA[lengthSymbol]);
+            int distanceSymbol = fixed.distanceSymbol[distance];
+            bits.put(fixed.distance[distanceSymbol], 5);
+            bits.put(static_cast<uint32_t>(distance - DISTANCE_BASE[distanceSymbol]), DISTANCE_EXTRA[distanceSymbol]);
+            i += length;
+        }
+        while (i < size)
+        {
+            literal(data[i++]);
+        }
+        bits.put(fixed.literal[256], fixed.literalLength[256]);
+        out.resize(static_cast<size_t>(bits.flush() - out.data()));
+    }
+
+    // ---------------------------------------------------------------------------
+    // PNG
+
+    void put32(std::vector<unsigned char> &out, uint32_t value)
+    {
+        unsigned char bytes[4] = {static_cast<unsigned char>(value >> 24), static_cast<unsigned char>(value >> 16),
+                                  static_cast<unsigned char>(value >> 8), static_cast<unsigned char>(value)};
+        out.insert(out.end(), bytes, bytes + 4);
+    }
+
+    void chunk(std::vector<unsigned char> &out, const char *type, const unsigned char *data, size_t size)
+    {
+        put32(out, static_cast<uint32_t>(size));
+        size_t start = out.size();
+        out.insert(out.end(), type, type + 4);
+        out.insert(out.end(), data, data + size);
+        put32(out, crc32(0, out.data() + start, out.size() - start));
+    }
+
+    // p = a + b - c, whichever neighbour is closest to p
+    int paeth(int a, int b, int c)
+    {
+        int pa = std::abs(b - c), pb = std::abs(a - c), pc = std::abs(a + b - 2 * c);
+        return (pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c);
+    }
+
+#ifdef LEARNOPENGL_X86
+    // |x| of 16 bit lanes, SSE2 has no pabsw
+    inline __m128i abs16(__m128i x)
+    {
+        return _mm_max_epi16(x, _mm_sub_epi16(_mm_setzero_si128(), x));
+    }
+
+    // Paeth predictor of eight pixels' bytes widened to 16 bits
+    inline __m128i paeth16(__m128i a, __m128i b, __m128i c)
+    {
+        __m128i pa = abs16(_mm_sub_epi16(b, c));
+        __m128i pb = abs16(_mm_sub_epi16(a, c));
+        __m128i pc = abs16(_mm_sub_epi16(_mm_add_epi16(a, b), _mm_add_epi16(c, c)));
+        __m128i notA = _mm_or_si128(_mm_cmpgt_epi16(pa, pb), _mm_cmpgt_epi16(pa, pc));
+        __m128i notB = _mm_cmpgt_epi16(pb, pc);
+        __m128i bOrC = _mm_or_si128(_mm_andnot_si128(notB, b), _mm_and_si128(notB, c));
+        return _mm_or_si128(_mm_andnot_si128(notA, a), _mm_and_si128(notA, bOrC));
+    }
+
+    // sum of |signed byte| of 16 filtered bytes in the two 64 bit halves
+    inline __m128i cost16(__m128i filtered)
+    {
+        __m128i magnitude = _mm_min_epu8(filtered, _mm_sub_epi8(_mm_setzero_si128(), filtered));
+        return _mm_sad_epu8(magnitude, _mm_setzero_si128());
+    }
+#endif
+
+    // The None, Sub, Up and Paeth filters of one RGB row and their costs: the sum of the
+    // filtered bytes as signed values, the usual guess at what compresses best. current
+    // and previous have a zero pixel before their first. Average rarely wins on rendered
+    // images and is not tried.
+    void filterRow(const unsigned char *current, const unsigned char *previous, size_t size,
+                   unsigned char *const candidates[4], int costs[4])
+    {
+        size_t i = 0;
+        for (int k = 0; k < 4; k++)
+        {
+            costs[k] = 0;
+        }
+#ifdef LEARNOPENGL_X86
+        __m128i sums[4] = {_mm_setzero_si128(), _mm_setzero_si128(), _mm_setzero_si128(), _mm_setzero_si128()};
+        const __m128i zero = _mm_setzero_si128();
+        for (; i + 16 <= size; i += 16)
+        {
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(current + i));
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(current + i - 3));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(previous + i));
+            __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i *>(previous + i - 3));
+            __m128i low = paeth16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero), _mm_unpacklo_epi8(c, zero));
+            __m128i high = paeth16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero), _mm_unpackhi_epi8(c, zero));
+            __m128i filtered[4] = {x, _mm_sub_epi8(x, a), _mm_sub_epi8(x, b),
+                                   _mm_sub_epi8(x, _mm_packus_epi16(low, high))};
+            for (int k = 0; k < 4; k++)
+            {
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(candidates[k] + i), filtered[k]);
+                sums[k] = _mm_add_epi64(sums[k], cost16(filtered[k]));
+            }
+        }
+        for (int k = 0; k < 4; k++)
+        {
+            costs[k] = _mm_cvtsi128_si32(sums[k]) + _mm_cvtsi128_si32(_mm_unpackhi_epi64(sums[k], sums[k]));
+        }
+#endif
+        for (; i < size; i++)
+        {
+            unsigned char filtered[4] = {current[i], static_cast<unsigned char>(current[i] - current[i - 3]),
+                                         static_cast<unsigned char>(current[i] - previous[i]),
+                                         static_cast<unsigned char>(
+                                             current[i] - paeth(current[i - 3], previous[i], previous[i - 3]))};
+            for (int k = 0; k < 4; k++)
+            {
+                candidates[k][i] = filtered[k];
+                costs[k] += std::abs(static_cast<signed char>(filtered[k]));
+            }
+        }
+    }
+
+    // one filter byte and the filtered RGB row per image row
+    void filterRows(std::vector<unsigned char> &filtered, const unsigned char *rgba, int width, int height,
+                    bool bottomUp)
+    {
+        const size_t rowSize = static_cast<size_t>(width) * 3;
+        filtered.resize((rowSize + 1) * static_cast<size_t>(height));
+        // rows start after one zero pixel, the left neighbour of the first
+        std::vector<unsigned char> previousRow(rowSize + 3, 0), currentRow(rowSize + 3, 0);
+        std::vector<unsigned char> candidates[4];
+        for (std::vector<unsigned char> &candidate : candidates)
+        {
+            candidate.resize(rowSize);
+        }
+        const unsigned char filterTypes[4] = {0, 1, 2, 4};
+
+        for (int y = 0; y < height; y++)
+        {
+            int sourceRow = bottomUp ? height - 1 - y : y;
+            const unsigned char *src = rgba + static_cast<size_t>(sourceRow) * static_cast<size_t>(width) * 4;
+            unsigned char *current = currentRow.data() + 3;
+            const unsigned char *previous = previousRow.data() + 3;
+            for (int x = 0; x < width; x++)
+            {
+                current[x * 3 + 0] = src[x * 4 + 0];
+                current[x * 3 + 1] = src[x * 4 + 1];
+                current[x * 3 + 2] = src[x * 4 + 2];
+            }
+            unsigned char *const rows[4] = {candidates[0].data(), candidates[1].data(), candidates[2].data(),
+                                            candidates[3].data()};
+            int costs[4];
+            filterRow(current, previous, rowSize, rows, costs);
+            int best = static_cast<int>(std::min_element(costs, costs + 4) - costs);
+            unsigned char *dst = filtered.data() + (rowSize + 1) * static_cast<size_t>(y);
+            dst[0] = filterTypes[best];
+            std::memcpy(dst + 1, candidates[best].data(), rowSize);
+            previousRow.swap(currentRow);
+        }
+    }
+
+    bool writeFile(const std::filesystem::path &path, const unsigned char *data, size_t size)
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char *>(data), static_cast<std::streamsize>(size));
+        if (!out)
+        {
+            std::cerr << "Error: unable to write image " << path.string() << std::endl;
+            return false;
+        }
+        return true;
+    }
+} // namespace
+
+void encodePng(std::vector<unsigned char> &out, const unsigned char *rgba, int width, int height, bool bottomUp)
+{
+    std::vector<unsigned char> filtered;
+    filterRows(filtered, rgba, width, height, bottomUp);
+
+    out.clear();
+    // fixed Huffman output stays close to the input size on noisy images
+    out.reserve(filtered.size() + filtered.size() / 8 + 128);
+    const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    out.insert(out.end(), signature, signature + 8);
+
+    std::vector<unsigned char> header;
+    put32(header, static_cast<uint32_t>(width));
+    put32(header, static_cast<uint32_t>(height));
+    const unsigned char format[5] = {8, 2, 0, 0, 0}; // 8 bit RGB, deflate, adaptive filters, not interlaced
+    header.insert(header.end(), format, format + 5);
+    chunk(out, "IHDR", header.data(), header.size());
+
+    std::vector<unsigned char> stream = {0x78, 0x01}; // zlib, 32K window, fastest
+    stream.reserve(out.capacity());
+    deflate(stream, filtered.data(), filtered.size());
+    put32(stream, adler32(filtered.data(), filtered.size()));
+    chunk(out, "IDAT", stream.data(), stream.size());
+    chunk(out, "IEND", nullptr, 0);
+}
+
+bool writePng(const std::filesystem::path &path, const unsigned char *rgba, int width, int height, bool bottomUp)
+{
+    std::vector<unsigned char> png;
+    encodePng(png, rgba, width, height, bottomUp);
+    return writeFile(path, png.data(), png.size());
+}
+
+bool writePpm(const std::filesystem::path &path, const unsigned char *rgba, int width, int height, bool bottomUp)
+{
+    std::string header = "P6\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+    std::vector<unsigned char> ppm(header.begin(), header.end());
+    ppm.resize(header.size() + static_cast<size_t>(width) * static_cast<size_t>(height) * 3);
+    unsigned char *dst = ppm.data() + header.size();
+    for (int y = 0; y < height; y++)
+    {
+        int sourceRow = bottomUp ? height - 1 - y : y;
+        const unsigned char *src = rgba + static_cast<size_t>(sourceRow) * static_cast<size_t>(width) * 4;
+        for (int x = 0; x < width; x++, dst += 3)
+        {
+            dst[0] = src[x * 4 + 0];
+            dst[1] = src[x * 4 + 1];
+            dst[2] = src[x * 4 + 2];
+        }
+    }
+    return writeFile(path, ppm.data(), ppm.size());
+}
@@ -0,0 +1,22 @@
+#ifndef IMAGE_ENCODE_HPP
+#define IMAGE_ENCODE_HPP
+
+#include <filesystem>
+#include <vector>
+
+// Encoders for rendered frames. Input is width * height RGBA8 pixels in tightly packed
+// rows; bottomUp takes the rows in glReadPixels order and writes them top first. Alpha
+// is dropped, the files are 8 bit RGB. Safe to call from any number of threads.
+
+// PNG with adaptive per row filters and a single pass LZ77 deflate with the fixed
+// Huffman code: much faster than zlib's default level at a somewhat larger size,
+// meant for frame dumps rather than distribution.
+void encodePng(std::vector<unsigned char> &out, const unsigned char *rgba, int width, int height,
+               bool bottomUp = false);
+bool writePng(const std::filesystem::path &path, const unsigned char *rgba, int width, int height,
+              bool bottomUp = false);
+// binary PPM (P6), no compression at all
+bool writePpm(const std::filesystem::path &path, const unsigned char *rgba, int width, int height,
+              bool bottomUp = false);
+
+#endif // IMAGE_ENCODE_HPP
@@ -0,0 +1,1202 @@
+#include "jpeg_decoder.hpp"
+#include "cpu_features.hpp"
+#include "image_arena.hpp"
+#include "stb_image.h"
+#include <algorithm>
+#include <cstring>
+
+#ifdef LEARNOPENGL_X86
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    const uint8_t DEZIGZAG[64] = {
+        0, 1, 8, 16, 9, 2, 3, 10,
+        17, 24, 32, 25, 18, 11, 4, 5,
+        12, 19, 26, 33, 40, 48, 41, 34,
+        27, 20, 13, 6, 7, 14, 21, 28,
+        35, 42, 49, 56, 57, 50, 43, 36,
+        29, 22, 15, 23, 30, 37, 44, 51,
+        58, 59, 52, 45, 38, 31, 39, 46,
+        53, 60, 61, 54, 47, 55, 62, 63};
+
+    uint8_t clampByte(int x)
+    {
+        return static_cast<uint8_t>(x < 0 ? 0 : (x > 255 ? 255 : x));
+    }
+
+    // ---- IDCT ----------------------------------------------------------------
+    // Integer IDCT from stb_image (itself the IJG jidctint scheme): constants are
+    // scaled by 1 << 12, the first pass keeps 2 extra bits, the second removes 17.
+
+    constexpr int f2f(double x)
+    {
+        return static_cast<int>(x * 4096 + 0.5);
+    }
+
+    struct Idct1D
+    {
+        int t0, t1, t2, t3, x0, x1, x2, x3;
+    };
+
+    Idct1D idct1D(int s0, int s1, int s2, int s3, int s4, int s5, int s6, int s7)
+    {
+        Idct1D r;
+        int p2 = s2, p3 = s6;
+        int p1 = (p2 + p3) * f2f(0.5411961);
+        int t2 = p1 + p3 * f2f(-1.847759065);
+        int t3 = p1 + p2 * f2f(0.765366865);
+        p2 = s0;
+        p3 = s4;
+        int t0 = (p2 + p3) * 4096;
+        int t1 = (p2 - p3) * 4096;
+        r.x0 = t0 + t3;
+        r.x3 = t0 - t3;
+        r.x1 = t1 + t2;
+        r.x2 = t1 - t2;
+        t0 = s7;
+        t1 = s5;
+        t2 = s3;
+        t3 = s1;
+        p3 = t0 + t2;
+        int p4 = t1 + t3;
+        p1 = t0 + t3;
+        p2 = t1 + t2;
+        int p5 = (p3 + p4) * f2f(1.175875602);
+        t0 = t0 * f2f(0.298631336);
+        t1 = t1 * f2f(2.053119869);
+        t2 = t2 * f2f(3.072711026);
+        t3 = t3 * f2f(1.501321110);
+        p1 = p5 + p1 * f2f(-0.899976223);
+        p2 = p5 + p2 * f2f(-2.562915447);
+        p3 = p3 * f2f(-1.961570560);
+        p4 = p4 * f2f(-0.390180644);
+        r.t3 = t3 + p1 + p4;
+        r.t2 = t2 + p2 + p3;
+        r.t1 = t1 + p2 + p4;
+        r.t0 = t0 + p1 + p3;
+        return r;
+    }
+
+    void idctScalar(uint8_t *out, size_t stride, const int16_t *d)
+    {
+        int v[64];
+        for (int i = 0; i < 8; i++)
+        {
+            Idct1D r = idct1D(d[i], d[i + 8], d[i + 16], d[i + 24], d[i + 32], d[i + 40], d[i + 48], d[i + 56]);
+            r.x0 += 512;
+            r.x1 += 512;
+            r.x2 += 512;
+            r.x3 += 512;
+            v[i + 0] = (r.x0 + r.t3) >> 10;
+            v[i + 56] = (r.x0 - r.t3) >> 10;
+            v[i + 8] = (r.x1 + r.t2) >> 10;
+            v[i + 48] = (r.x1 - r.t2) >> 10;
+            v[i + 16] = (r.x2 + r.t1) >> 10;
+            v[i + 40] = (r.x2 - r.t1) >> 10;
+            v[i + 24] = (r.x3 + r.t0) >> 10;
+            v[i + 32] = (r.x3 - r.t0) >> 10;
+        }
+        for (int i = 0; i < 8; i++, out += stride)
+        {
+            const int *s = v + i * 8;
+            Idct1D r = idct1D(s[0], s[1], s[2], s[3], s[4], s[5], s[6], s[7]);
+            // rounding and the +128 level shift folded into one bias
+            const int bias = 65536 + (128 << 17);
+            r.x0 += bias;
+            r.x1 += bias;
+            r.x2 += bias;
+            r.x3 += bias;
+            out[0] = clampByte((r.x0 + r.t3) >> 17);
+            out[7] = clampByte((r.x0 - r.t3) >> 17);
+            out[1] = clampByte((r.x1 + r.t2) >> 17);
+            out[6] = clampByte((r.x1 - r.t2) >> 17);
+            out[2] = clampByte((r.x2 + r.t1) >> 17);
+            out[5] = clampByte((r.x2 - r.t1) >> 17);
+            out[3] = clampByte((r.x3 + r.t0) >> 17);
+            out[4] = clampByte((r.x3 - r.t0) >> 17);
+        }
+    }
+
+    // What both IDCTs make of a block without AC coefficients: the first pass leaves
+    // only column 0 non-zero, the second spreads it over each row.
+    void idctDc(uint8_t *out, size_t stride, int dc)
+    {
+        int column = (dc * 4096 + 512) >> 10;
+        uint8_t value = clampByte((column * 4096 + 65536 + (128 << 17)) >> 17);
+        for (int i = 0; i < 8; i++, out += stride)
+        {
+            std::memset(out, value, 8);
+        }
+    }
+
+#ifdef LEARNOPENGL_X86
+    LEARNOPENGL_TARGET("avx2")
+    inline __m256i mul(__m256i a, int c)
+    {
+        return _mm256_mullo_epi32(a, _mm256_set1_epi32(c));
+    }
+
+    // idct1D on eight columns at once, same operation order as the scalar version
+    LEARNOPENGL_TARGET("avx2")
+    void idct1DAvx2(__m256i s[8], __m256i &t0, __m256i &t1, __m256i &t2, __m256i &t3,
+                    __m256i &x0, __m256i &x1, __m256i &x2, __m256i &x3)
+    {
+        __m256i p2 = s[2], p3 = s[6];
+        __m256i p1 = mul(_mm256_add_epi32(p2, p3), f2f(0.5411961));
+        t2 = _mm256_add_epi32(p1, mul(p3, f2f(-1.847759065)));
+        t3 = _mm256_add_epi32(p1, mul(p2, f2f(0.765366865)));
+        p2 = s[0];
+        p3 = s[4];
+        t0 = _mm256_slli_epi32(_mm256_add_epi32(p2, p3), 12);
+        t1 = _mm256_slli_epi32(_mm256_sub_epi32(p2, p3), 12);
+        x0 = _mm256_add_epi32(t0, t3);
+        x3 = _mm256_sub_epi32(t0, t3);
+        x1 = _mm256_add_epi32(t1, t2);
+        x2 = _mm256_sub_epi32(t1, t2);
+        t0 = s[7];
+        t1 = s[5];
+        t2 = s[3];
+        t3 = s[1];
+        p3 = _mm256_add_epi32(t0, t2);
+        __m256i p4 = _mm256_add_epi32(t1, t3);
+        p1 = _mm256_add_epi32(t0, t3);
+        p2 = _mm256_add_epi32(t1, t2);
+        __m256i p5 = mul(_mm256_add_epi32(p3, p4), f2f(1.175875602));
+        t0 = mul(t0, f2f(0.298631336));
+        t1 = mul(t1, f2f(2.053119869));
+        t2 = mul(t2, f2f(3.072711026));
+        t3 = mul(t3, f2f(1.501321110));
+        p1 = _mm256_add_epi32(p5, mul(p1, f2f(-0.899976223)));
+        p2 = _mm256_add_epi32(p5, mul(p2, f2f(-2.562915447)));
+        p3 = mul(p3, f2f(-1.961570560));
+        p4 = mul(p4, f2f(-0.390180644));
+        t3 = _mm256_add_epi32(t3, _mm256_add_epi32(p1, p4));
+        t2 = _mm256_add_epi32(t2, _mm256_add_epi32(p2, p3));
+        t1 = _mm256_add_epi32(t1, _mm256_add_epi32(p2, p4));
+        t0 = _mm256_add_epi32(t0, _mm256_add_epi32(p1, p3));
+    }
+
+    // rows = 8 outputs of one pass: (x +/- t + bias) >> shift in the butterfly order
+    LEARNOPENGL_TARGET("avx2")
+    void idctPassAvx2(__m256i row[8], int bias, int shift)
+    {
+        __m256i t0, t1, t2, t3, x0, x1, x2, x3;
+        idct1DAvx2(row, t0, t1, t2, t3, x0, x1, x2, x3);
+        const __m256i b = _mm256_set1_epi32(bias);
+        const __m128i n = _mm_cvtsi32_si128(shift);
+        x0 = _mm256_add_epi32(x0, b);
+        x1 = _mm256_add_epi32(x1, b);
+        x2 = _mm256_add_epi32(x2, b);
+        x3 = _mm256_add_epi32(x3, b);
+        row[0] = _mm256_sra_epi32(_mm256_add_epi32(x0, t3), n);
+        row[7] = _mm256_sra_epi32(_mm256_sub_epi32(x0, t3), n);
+        row[1] = _mm256_sra_epi32(_mm256_add_epi32(x1, t2), n);
+        row[6] = _mm256_sra_epi32(_mm256_sub_epi32(x1, t2), n);
+        row[2] = _mm256_sra_epi32(_mm256_add_epi32(x2, t1), n);
+        row[5] = _mm256_sra_epi32(_mm256_sub_epi32(x2, t1), n);
+        row[3] = _mm256_sra_epi32(_mm256_add_epi32(x3, t0), n);
+        row[4] = _mm256_sra_epi32(_mm256_sub_epi32(x3, t0), n);
+    }
+
+    LEARNOPENGL_TARGET("avx2")
+    void transpose8x8(__m256i r[8])
+    {
+        __m256i a0 = _mm256_unpacklo_epi32(r[0], r[1]);
+        __m256i a1 = _mm256_unpackhi_epi32(r[0], r[1]);
+        __m256i a2 = _mm256_unpacklo_epi32(r[2], r[3]);
+        __m256i a3 = _mm256_unpackhi_epi32(r[2], r[3]);
+        __m256i a4 = _mm256_unpacklo_epi32(r[4], r[5]);
+        __m256i a5 = _mm256_unpackhi_epi32(r[4], r[5]);
+        __m256i a6 = _mm256_unpacklo_epi32(r[6], r[7]);
+        __m256i a7 = _mm256_unpackhi_epi32(r[6], r[7]);
+        __m256i b0 = _mm256_unpacklo_epi64(a0, a2);
+        __m256i b1 = _mm256_unpackhi_epi64(a0, a2);
+        __m256i b2 = _mm256_unpacklo_epi64(a1, a3);
+        __m256i b3 = _mm256_unpackhi_epi64(a1, a3);
+        __m256i b4 = _mm256_unpacklo_epi64(a4, a6);
+        __m256i b5 = _mm256_unpackhi_epi64(a4, a6);
+        __m256i b6 = _mm256_unpacklo_epi64(a5, a7);
+        __m256i b7 = _mm256_unpackhi_epi64(a5, a7);
+        r[0] = _mm256_permute2x128_si256(b0, b4, 0x20);
+        r[1] = _mm256_permute2x128_si256(b1, b5, 0x20);
+        r[2] = _mm256_permute2x128_si256(b2, b6, 0x20);
+        r[3] = _mm256_permute2x128_si256(b3, b7, 0x20);
+        r[4] = _mm256_permute2x128_si256(b0, b4, 0x31);
+        r[5] = _mm256_permute2x128_si256(b1, b5, 0x31);
+        r[6] = _mm256_permute2x128_si256(b2, b6, 0x31);
+        r[7] = _mm256_permute2x128_si256(b3, b7, 0x31);
+    }
+
+    // One register per row of eight 32-bit lanes: the column pass works on all
+    // eight columns at once, a transpose turns rows into columns for the second.
+    LEARNOPENGL_TARGET("avx2")
+    void idctAvx2(uint8_t *out, size_t stride, const int16_t *d)
+    {
+        __m256i row[8];
+        for (int k = 0; k < 8; k++)
+        {
+            row[k] = _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(d + k * 8)));
+        }
+
+        idctPassAvx2(row, 512, 10);
+        transpose8x8(row);
+        idctPassAvx2(row, 65536 + (128 << 17), 17);
+        transpose8x8(row);
+
+        // saturating packs clamp to 0..255 exactly like clampByte
+        for (int k = 0; k < 8; k += 2)
+        {
+            __m256i words = _mm256_packs_epi32(row[k], row[k + 1]); // [k0-3 k1 0-3 | k0 4-7 k1 4-7]
+            words = _mm256_permute4x64_epi64(words, 0xD8);
+            __m128i bytes = _mm_packus_epi16(_mm256_castsi256_si128(words), _mm256_extracti128_si256(words, 1));
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(out + k * stride), bytes);
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(out + (k + 1) * stride), _mm_srli_si128(bytes, 8));
+        }
+    }
+#endif
+
+    // ---- chroma upsampling (stb_image's "fancy" triangle filter) ------------
+
+    using ResampleFn = const uint8_t *(*)(uint8_t *out, const uint8_t *nearRow, const uint8_t *farRow, int w, int hs);
+
+    const uint8_t *resampleRow1(uint8_t *, const uint8_t *nearRow, const uint8_t *, int, int)
+    {
+        return nearRow;
+    }
+
+    const uint8_t *resampleRowV2(uint8_t *out, const uint8_t *nearRow, const uint8_t *farRow, int w, int)
+    {
+        int i = 0;
+#ifdef LEARNOPENGL_X86
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i two = _mm_set1_epi16(2);
+        for (; i + 8 <= w; i += 8)
+        {
+            __m128i n = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(nearRow + i)), zero);
+            __m128i f = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(farRow + i)), zero);
+            __m128i sum = _mm_add_epi16(_mm_add_epi16(_mm_add_epi16(n, n), n), _mm_add_epi16(f, two));
+            __m128i bytes = _mm_packus_epi16(_mm_srli_epi16(sum, 2), zero);
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(out + i), bytes);
+        }
+#endif
+        for (; i < w; i++)
+        {
+            out[i] = static_cast<uint8_t>((3 * nearRow[i] + farRow[i] + 2) >> 2);
+        }
+        return out;
+    }
+
+    const uint8_t *resampleRowH2(uint8_t *out, const uint8_t *in, const uint8_t *, int w, int)
+    {
+        if (w == 1)
+        {
+            out[0] = out[1] = in[0];
+            return out;
+        }
+        out[0] = in[0];
+        out[1] = static_cast<uint8_t>((in[0] * 3 + in[1] + 2) >> 2);
+        int i = 1;
+#ifdef LEARNOPENGL_X86
+        // even/odd outputs are built as 16-bit lanes (even | odd << 8), which is
+        // already the interleaved byte order in memory
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i two = _mm_set1_epi16(2);
+        for (; i + 9 <= w; i += 8)
+        {
+            __m128i c = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(in + i)), zero);
+            __m128i l = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(in + i - 1)), zero);
+            __m128i r = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(in + i + 1)), zero);
+            __m128i c3 = _mm_add_epi16(_mm_add_epi16(_mm_add_epi16(c, c), c), two);
+            __m128i even = _mm_srli_epi16(_mm_add_epi16(c3, l), 2);
+            __m128i odd = _mm_srli_epi16(_mm_add_epi16(c3, r), 2);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i * 2), _mm_or_si128(even, _mm_slli_epi16(odd, 8)));
+        }
+#endif
+        for (; i < w - 1; i++)
+        {
+            int n = 3 * in[i] + 2;
+            out[i * 2 + 0] = static_cast<uint8_t>((n + in[i - 1]) >> 2);
+            out[i * 2 + 1] = static_cast<uint8_t>((n + in[i + 1]) >> 2);
+        }
+        out[i * 2 + 0] = static_cast<uint8_t>((in[w - 2] * 3 + in[w - 1] + 2) >> 2);
+        out[i * 2 + 1] = in[w - 1];
+        return out;
+    }
+
+    const uint8_t *resampleRowHV2(uint8_t *out, const uint8_t *nearRow, const uint8_t *farRow, int w, int)
+    {
+        if (w == 1)
+        {
+            out[0] = out[1] = static_cast<uint8_t>((3 * nearRow[0] + farRow[0] + 2) >> 2);
+            return out;
+        }
+        int t1 = 3 * nearRow[0] + farRow[0];
+        out[0] = static_cast<uint8_t>((t1 + 2) >> 2);
+        int i = 1;
+#ifdef LEARNOPENGL_X86
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i eight = _mm_set1_epi16(8);
+        auto column = [&](int at)
+        {
+            __m128i n = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(nearRow + at)), zero);
+            __m128i f = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(farRow + at)), zero);
+            return _mm_add_epi16(_mm_add_epi16(_mm_add_epi16(n, n), n), f);
+        };
+        // outputs 2i-1 and 2i for i in [i, i+8) need t[i-1 .. i+7]
+        for (; i + 8 <= w; i += 8)
+        {
+            __m128i prev = column(i - 1);
+            __m128i curr = column(i);
+            __m128i curr3 = _mm_add_epi16(_mm_add_epi16(curr, curr), curr);
+            __m128i prev3 = _mm_add_epi16(_mm_add_epi16(prev, prev), prev);
+            __m128i odd = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(prev3, curr), eight), 4);  // out[2i-1]
+            __m128i even = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(curr3, prev), eight), 4); // out[2i]
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i * 2 - 1), _mm_or_si128(odd, _mm_slli_epi16(even, 8)));
+        }
+        t1 = 3 * nearRow[i - 1] + farRow[i - 1];
+#endif
+        for (; i < w; i++)
+        {
+            int t0 = t1;
+            t1 = 3 * nearRow[i] + farRow[i];
+            out[i * 2 - 1] = static_cast<uint8_t>((3 * t0 + t1 + 8) >> 4);
+            out[i * 2] = static_cast<uint8_t>((3 * t1 + t0 + 8) >> 4);
+        }
+        out[w * 2 - 1] = static_cast<uint8_t>((t1 + 2) >> 2);
+        return out;
+    }
+
+    const uint8_t *resampleRowGeneric(uint8_t *out, const uint8_t *nearRow, const uint8_t *, int w, int hs)
+    {
+        for (int i = 0; i < w; i++)
+        {
+            for (int j = 0; j < hs; j++)
+            {
+                out[i * hs + j] = nearRow[i];
+            }
+        }
+        return out;
+    }
+
+    // ---- colour conversion ----------------------------------------------------
+
+    constexpr int float2fixed(double x)
+    {
+        return static_cast<int>(x * 4096.0 + 0.5) * 256;
+    }
+
+    void ycbcrToRgbScalar(uint8_t *out, const uint8_t *y, const uint8_t *pcb, const uint8_t *pcr, int count, int step)
+    {
+        for (int i = 0; i < count; i++, out += step)
+        {
+            int yFixed = (y[i] << 20) + (1 << 19);
+            int cr = pcr[i] - 128;
+            int cb = pcb[i] - 128;
+            int r = yFixed + cr * float2fixed(1.40200);
+            int g = yFixed + (cr * -float2fixed(0.71414)) + ((cb * -float2fixed(0.34414)) & 0xffff0000);
+            int b = yFixed + cb * float2fixed(1.77200);
+            out[0] = clampByte(r >> 20);
+            out[1] = clampByte(g >> 20);
+            out[2] = clampByte(b >> 20);
+            if (step == 4)
+            {
+                out[3] = 255;
+            }
+        }
+    }
+
+#ifdef LEARNOPENGL_X86
+    LEARNOPENGL_TARGET("avx2")
+    void ycbcrToRgbAvx2(uint8_t *out, const uint8_t *y, const uint8_t *pcb, const uint8_t *pcr, int count, int step)
+    {
+        const __m256i bias = _mm256_set1_epi32(128);
+        const __m256i round = _mm256_set1_epi32(1 << 19);
+        const __m256i crR = _mm256_set1_epi32(float2fixed(1.40200));
+        const __m256i crG = _mm256_set1_epi32(-float2fixed(0.71414));
+        const __m256i cbG = _mm256_set1_epi32(-float2fixed(0.34414));
+        const __m256i cbB = _mm256_set1_epi32(float2fixed(1.77200));
+        const __m256i highMask = _mm256_set1_epi32(static_cast<int>(0xffff0000u));
+        const __m256i alpha = _mm256_set1_epi32(255);
+        const __m128i dropAlpha = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+        int i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m256i yv = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(y + i)));
+            __m256i cb = _mm256_sub_epi32(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(pcb + i))), bias);
+            __m256i cr = _mm256_sub_epi32(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(pcr + i))), bias);
+            __m256i yFixed = _mm256_add_epi32(_mm256_slli_epi32(yv, 20), round);
+
+            __m256i r = _mm256_add_epi32(yFixed, _mm256_mullo_epi32(cr, crR));
+            __m256i g = _mm256_add_epi32(_mm256_add_epi32(yFixed, _mm256_mullo_epi32(cr, crG)),
+                                         _mm256_and_si256(_mm256_mullo_epi32(cb, cbG), highMask));
+            __m256i b = _mm256_add_epi32(yFixed, _mm256_mullo_epi32(cb, cbB));
+            r = _mm256_srai_epi32(r, 20);
+            g = _mm256_srai_epi32(g, 20);
+            b = _mm256_srai_epi32(b, 20);
+
+            // saturate to bytes: [r0-7 b0-7 | g0-7 a0-7]
+            __m256i rg = _mm256_permute4x64_epi64(_mm256_packus_epi32(r, g), 0xD8);
+            __m256i ba = _mm256_permute4x64_epi64(_mm256_packus_epi32(b, alpha), 0xD8);
+            __m256i bytes = _mm256_packus_epi16(rg, ba);
+            __m128i rb = _mm256_castsi256_si128(bytes);
+            __m128i ga = _mm256_extracti128_si256(bytes, 1);
+            __m128i rg8 = _mm_unpacklo_epi8(rb, ga);
+            __m128i ba8 = _mm_unpackhi_epi8(rb, ga);
+            __m128i lo = _mm_unpacklo_epi16(rg8, ba8);
+            __m128i hi = _mm_unpackhi_epi16(rg8, ba8);
+            if (step == 4)
+            {
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(out), lo);
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 16), hi);
+            }
+            else
+            {
+                alignas(16) uint8_t packed[32];
+                _mm_store_si128(reinterpret_cast<__m128i *>(packed), _mm_shuffle_epi8(lo, dropAlpha));
+                _mm_store_si128(reinterpret_cast<__m128i *>(packed + 16), _mm_shuffle_epi8(hi, dropAlpha));
+                std::memcpy(out, packed, 12);
+                std::memcpy(out + 12, packed + 16, 12);
+            }
+            out += 8 * step;
+        }
+        // GCC leaves this out before a tail call, the SSE code after would stall on it
+        _mm256_zeroupper();
+        ycbcrToRgbScalar(out, y + i, pcb + i, pcr + i, count - i, step);
+    }
+#endif
+
+    uint16_t readBe16(const unsigned char *p)
+    {
+        return static_cast<uint16_t>((p[0] << 8) | p[1]);
+    }
+} // namespace
+
+// ---- entropy decoding ---------------------------------------------------------
+
+struct JpegDecoder::BitReader
+{
+    const uint8_t *p;
+    const uint8_t *end;
+    uint64_t buffer; // next bits, most significant first
+    int count;
+    bool marker; // reached a marker, the rest of the scan reads as zeros
+
+    void fill()
+    {
+        // eight bytes at once while there is no 0xFF among them to unstuff or stop at
+        if (count <= 56 && !marker && end - p >= 8)
+        {
+            uint64_t word = 0;
+            for (int i = 0; i < 8; i++)
+            {
+                word = word << 8 | p[i];
+            }
+            if (((~word - 0x0101010101010101ull) & word & 0x8080808080808080ull) == 0)
+            {
+                int bytes = (64 - count) >> 3;
+                int shift = 64 - 8 * bytes;
+                buffer |= (shift == 0 ? word : word >> shift) << (shift - count);
+                p += bytes;
+                count += 8 * bytes;
+                return;
+            }
+        }
+        while (count <= 56)
+        {
+            unsigned int byte = 0;
+            if (!marker && p < end)
+            {
+                byte = *p;
+                if (byte == 0xFF)
+                {
+                    if (p + 1 < end && p[1] == 0x00)
+                    {
+                        p += 2; // stuffed zero
+                    }
+                    else
+                    {
+                        marker = true; // stay on the 0xFF so restart handling can find it
+                        byte = 0;
+                    }
+                }
+                else
+                {
+                    p++;
+                }
+            }
+            buffer |= static_cast<uint64_t>(byte) << (56 - count);
+            count += 8;
+        }
+    }
+
+    unsigned int getBits(int n)
+    {
+        if (count < n)
+        {
+            fill();
+        }
+        unsigned int v = static_cast<unsigned int>(buffer >> (64 - n));
+        buffer <<= n;
+        count -= n;
+        return v;
+    }
+
+    int receiveExtend(int n)
+    {
+        int v = static_cast<int>(getBits(n));
+        // a clear top bit means negative: subtract 2^n - 1 without a branch
+        int negative = (v >> (n - 1)) - 1;
+        return v + (negative & (1 - (1 << n)));
+    }
+
+    int decode(const Huffman &h)
+    {
+        if (count < 16)
+        {
+            fill();
+        }
+        unsigned int code = static_cast<unsigned int>(buffer >> 48);
+        unsigned int fast = code >> 7;
+        int length = h.fastLength[fast];
+        if (length == 0)
+        {
+            for (length = 10; length <= 16; length++)
+            {
+                if (code < h.maxCode[length])
+                {
+                    break;
+                }
+            }
+            if (length > 16)
+            {
+                return -1;
+            }
+            int index = static_cast<int>(code >> (16 - length)) + h.valueOffset[length];
+            if (index < 0 || index > 255)
+            {
+                return -1;
+            }
+            buffer <<= length;
+            count -= length;
+            return h.symbols[index];
+        }
+        buffer <<= length;
+        count -= length;
+        return h.fastSymbol[fast];
+    }
+
+    // skip to just past the next RSTn marker and start a fresh bit stream
+    bool restart()
+    {
+        buffer = 0;
+        count = 0;
+        marker = false;
+        while (p + 1 < end && !(p[0] == 0xFF && p[1] >= 0xD0 && p[1] <= 0xD7))
+        {
+            p++;
+        }
+        if (p + 1 >= end)
+        {
+            return false;
+        }
+        p += 2;
+        return true;
+    }
+};
+
+JpegDecoder::JpegDecoder() : m_data{nullptr}, m_size{0}, m_scanStart{0}, m_width{0}, m_height{0}, m_hMax{1},
+                             m_vMax{1}, m_restartInterval{0}, m_quant{}, m_dc{}, m_ac{}, m_error{nullptr},
+                             m_simd{true} {};
+
+int JpegDecoder::width() const
+{
+    return m_width;
+}
+
+int JpegDecoder::height() const
+{
+    return m_height;
+}
+
+int JpegDecoder::components() const
+{
+    return static_cast<int>(m_components.size());
+}
+
+const char *JpegDecoder::error() const
+{
+    return m_error;
+}
+
+void JpegDecoder::setSimd(bool enabled)
+{
+    m_simd = enabled;
+}
+
+bool JpegDecoder::fail(const char *message)
+{
+    m_error = message;
+    return false;
+}
+
+bool JpegDecoder::buildHuffman(Huffman &table, const uint8_t *counts, const uint8_t *symbols)
+{
+    std::memset(table.fastLength, 0, sizeof(table.fastLength));
+    unsigned int code = 0;
+    int k = 0;
+    for (int length = 1; length <= 16; length++)
+    {
+        table.valueOffset[length] = k - static_cast<int>(code);
+        for (int i = 0; i < counts[length - 1]; i++, k++, code++)
+        {
+            table.symbols[k] = symbols[k];
+            if (length <= 9)
+            {
+                unsigned int first = code << (9 - length);
+                for (unsigned int s = 0; s < (1u << (9 - length)); s++)
+                {
+                    table.fastLength[first + s] = static_cast<uint8_t>(length);
+                    table.fastSymbol[first + s] = symbols[k];
+                }
+            }
+        }
+        if (code > (1u << length))
+        {
+            return fail("bad huffman table");
+        }
+        table.maxCode[length] = code << (16 - length);
+        code <<= 1;
+    }
+    table.maxCode[17] = 0xffffffffu;
+
+    // stb_image's fast AC lookup: short codes with few value bits decode in one step
+    for (unsigned int i = 0; i < (1u << 9); i++)
+    {
+        table.fastAc[i] = 0;
+        int length = table.fastLength[i];
+        int run = table.fastSymbol[i] >> 4, bits = table.fastSymbol[i] & 15;
+        if (length == 0 || bits == 0 || length + bits > 9)
+        {
+            continue;
+        }
+        int value = static_cast<int>((i << length) & 511) >> (9 - bits);
+        if (value < (1 << (bits - 1)))
+        {
+            value -= (1 << bits) - 1;
+        }
+        if (value >= -128 && value <= 127)
+        {
+            table.fastAc[i] = static_cast<int16_t>(value * 256 + run * 16 + length + bits);
+        }
+    }
+    table.defined = true;
+    return true;
+}
+
+bool JpegDecoder::readHeader(const unsigned char *data, size_t size)
+{
+    m_data = data;
+    m_size = size;
+    m_error = nullptr;
+    m_width = m_height = 0;
+    m_restartInterval = 0;
+    m_components.clear();
+    m_scanOrder.clear();
+    for (int i = 0; i < 4; i++)
+    {
+        m_dc[i].defined = m_ac[i].defined = false;
+    }
+
+    if (size < 4 || data[0] != 0xFF || data[1] != 0xD8)
+    {
+        return fail("not a jpeg");
+    }
+    bool jfif = false;
+    int adobeTransform = -1;
+    size_t pos = 2;
+    while (pos + 4 <= size)
+    {
+        if (data[pos] != 0xFF)
+        {
+            return fail("expected marker");
+        }
+        while (pos < size && data[pos] == 0xFF)
+        {
+            pos++; // fill bytes
+        }
+        if (pos >= size)
+        {
+            break;
+        }
+        int marker = data[pos++];
+        if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7))
+        {
+            continue;
+        }
+        if (pos + 2 > size)
+        {
+            break;
+        }
+        size_t length = readBe16(data + pos);
+        if (length < 2 || pos + length > size)
+        {
+            return fail("bad marker length");
+        }
+        const unsigned char *seg = data + pos + 2;
+        size_t segLength = length - 2;
+        pos += length;
+
+        switch (marker)
+        {
+        case 0xC0: // baseline
+        case 0xC1: // extended sequential, huffman
+        {
+            if (segLength < 6 || seg[0] != 8)
+            {
+                return fail("only 8-bit jpegs are supported");
+            }
+            m_height = readBe16(seg + 1);
+            m_width = readBe16(seg + 3);
+            int count = seg[5];
+            if (m_width == 0 || m_height == 0)
+            {
+                return fail("zero size or DNL jpeg");
+            }
+            if ((count != 1 && count != 3) || segLength < 6 + 3u * count)
+            {
+                return fail("unsupported component count");
+            }
+            m_hMax = m_vMax = 1;
+            for (int i = 0; i < count; i++)
+            {
+                Component c{};
+                c.id = seg[6 + i * 3];
+                c.h = seg[7 + i * 3] >> 4;
+                c.v = seg[7 + i * 3] & 15;
+                c.quantTable = seg[8 + i * 3];
+                if (c.h < 1 || c.h > 4 || c.v < 1 || c.v > 4 || c.quantTable > 3)
+                {
+                    return fail("bad component");
+                }
+                m_hMax = std::max(m_hMax, c.h);
+                m_vMax = std::max(m_vMax, c.v);
+                m_components.push_back(std::move(c));
+            }
+            // the upsamplers and plane sizes assume every factor divides the largest one
+            for (const Component &c : m_components)
+            {
+                if (m_hMax % c.h != 0 || m_vMax % c.v != 0)
+                {
+                    return fail("bad sampling factors");
+                }
+            }
+            if (count == 3 && m_components[0].id == 'R' && m_components[1].id == 'G' && m_components[2].id == 'B')
+            {
+                return fail("rgb jpeg");
+            }
+            break;
+        }
+        case 0xC4: // huffman tables
+        {
+            size_t at = 0;
+            while (at + 17 <= segLength)
+            {
+                int tableClass = seg[at] >> 4;
+                int id = seg[at] & 15;
+                const uint8_t *counts = seg + at + 1;
+                size_t total = 0;
+                for (int i = 0; i < 16; i++)
+                {
+                    total += counts[i];
+                }
+                if (tableClass > 1 || id > 3 || total > 256 || at + 17 + total > segLength)
+                {
+                    return fail("bad huffman table");
+                }
+                if (!buildHuffman(tableClass == 0 ? m_dc[id] : m_ac[id], counts, seg + at + 17))
+                {
+                    return false;
+                }
+                at += 17 + total;
+            }
+            break;
+        }
+        case 0xDB: // quantisation tables
+        {
+            size_t at = 0;
+            while (at < segLength)
+            {
+                int precision = seg[at] >> 4;
+                int id = seg[at] & 15;
+                size_t bytes = precision ? 128 : 64;
+                if (precision > 1 || id > 3 || at + 1 + bytes > segLength)
+                {
+                    return fail("bad quantisation table");
+                }
+                for (int i = 0; i < 64; i++)
+                {
+                    m_quant[id][DEZIGZAG[i]] =
+                        precision ? readBe16(seg + at + 1 + i * 2) : seg[at + 1 + i];
+                }
+                at += 1 + bytes;
+            }
+            break;
+        }
+        case 0xDD: // restart interval
+            if (segLength < 2)
+            {
+                return fail("bad DRI");
+            }
+            m_restartInterval = readBe16(seg);
+            break;
+        case 0xE0:
+            jfif = jfif || (segLength >= 5 && std::memcmp(seg, "JFIF\0", 5) == 0);
+            break;
+        case 0xEE:
+            if (segLength >= 12 && std::memcmp(seg, "Adobe", 5) == 0)
+            {
+                adobeTransform = seg[11];
+            }
+            break;
+        case 0xDA: // start of scan
+        {
+            if (m_components.empty())
+            {
+                return fail("scan before frame header");
+            }
+            int count = segLength > 0 ? seg[0] : 0;
+            if (count != static_cast<int>(m_components.size()) || segLength < 4 + 2u * count)
+            {
+                return fail("non-interleaved multi-scan jpeg");
+            }
+            for (int i = 0; i < count; i++)
+            {
+                int id = seg[1 + i * 2];
+                int tables = seg[2 + i * 2];
+                auto it = std::find_if(m_components.begin(), m_components.end(), [id](const Component &c)
+                                       { return c.id == id; });
+                if (it == m_components.end() || !m_dc[tables >> 4 & 3].defined || !m_ac[tables & 3].defined ||
+                    (tables >> 4) > 3 || (tables & 15) > 3)
+                {
+                    return fail("bad scan header");
+                }
+                it->dcTable = tables >> 4;
+                it->acTable = tables & 15;
+                m_scanOrder.push_back(static_cast<int>(it - m_components.begin()));
+            }
+            if (m_components.size() == 3 && adobeTransform == 0 && !jfif)
+            {
+                return fail("rgb jpeg");
+            }
+            m_scanStart = pos;
+            return true;
+        }
+        case 0xD9:
+            return fail("no image data");
+        default:
+            if ((marker >= 0xC2 && marker <= 0xCB && marker != 0xC4 && marker != 0xC8) ||
+                (marker >= 0xCD && marker <= 0xCF))
+            {
+                return fail("progressive, lossless or arithmetic coded jpeg");
+            }
+            break; // APPn, COM and friends
+        }
+    }
+    return fail("truncated jpeg");
+}
+
+bool JpegDecoder::decodeBlock(BitReader &bits, Component &component, int16_t *coefficients, bool &dcOnly)
+{
+    dcOnly = true;
+    std::memset(coefficients, 0, 64 * sizeof(int16_t));
+    const uint16_t *quant = m_quant[component.quantTable];
+
+    int t = bits.decode(m_dc[component.dcTable]);
+    if (t < 0 || t > 15)
+    {
+        return fail("bad huffman code");
+    }
+    component.dcPred += t ? bits.receiveExtend(t) : 0;
+    coefficients[0] = static_cast<int16_t>(component.dcPred * quant[0]);
+
+    const Huffman &ac = m_ac[component.acTable];
+    for (int k = 1; k < 64;)
+    {
+        if (bits.count < 16)
+        {
+            bits.fill();
+        }
+        int fast = ac.fastAc[bits.buffer >> 55];
+        if (fast != 0)
+        {
+            k += (fast >> 4) & 15;
+            if (k > 63)
+            {
+                return fail("bad coefficient index");
+            }
+            bits.buffer <<= fast & 15;
+            bits.count -= fast & 15;
+            int zig = DEZIGZAG[k++];
+            coefficients[zig] = static_cast<int16_t>((fast >> 8) * quant[zig]);
+            dcOnly = false;
+            continue;
+        }
+        int rs = bits.decode(ac);
+        if (rs < 0)
+        {
+            return fail("bad huffman code");
+        }
+        int s = rs & 15;
+        int r = rs >> 4;
+        if (s == 0)
+        {
+            if (rs != 0xF0)
+            {
+                break; // end of block
+            }
+            k += 16;
+            continue;
+        }
+        k += r;
+        if (k > 63)
+        {
+            return fail("bad coefficient index");
+        }
+        int zig = DEZIGZAG[k++];
+        coefficients[zig] = static_cast<int16_t>(bits.receiveExtend(s) * quant[zig]);
+        dcOnly = false;
+    }
+    return true;
+}
+
+bool JpegDecoder::decodeScan()
+{
+    using IdctFn = void (*)(uint8_t *, size_t, const int16_t *);
+    IdctFn idct = idctScalar;
+#ifdef LEARNOPENGL_X86
+    if (m_simd && cpu::hasAvx2())
+    {
+        idct = idctAvx2;
+    }
+#endif
+
+    BitReader bits{m_data + m_scanStart, m_data + m_size, 0, 0, false};
+    alignas(32) int16_t coefficients[64];
+    for (Component &c : m_components)
+    {
+        c.dcPred = 0;
+    }
+
+    // a single component scan is not interleaved: one block per MCU, no padding to the MCU grid
+    bool single = m_scanOrder.size() == 1;
+    int mcusX = single ? (m_components[0].width + 7) / 8 : (m_width + 8 * m_hMax - 1) / (8 * m_hMax);
+    int mcusY = single ? (m_components[0].height + 7) / 8 : (m_height + 8 * m_vMax - 1) / (8 * m_vMax);
+    int todo = m_restartInterval ? m_restartInterval : 0x7fffffff;
+
+    for (int my = 0; my < mcusY; my++)
+    {
+        for (int mx = 0; mx < mcusX; mx++)
+        {
+            for (int index : m_scanOrder)
+            {
+                Component &c = m_components[index];
+                int h = single ? 1 : c.h;
+                int v = single ? 1 : c.v;
+                for (int by = 0; by < v; by++)
+                {
+                    for (int bx = 0; bx < h; bx++)
+                    {
+                        bool dcOnly = false;
+                        if (!decodeBlock(bits, c, coefficients, dcOnly))
+                        {
+                            return false;
+                        }
+                        size_t x = static_cast<size_t>(mx * h + bx) * 8;
+                        size_t y = static_cast<size_t>(my * v + by) * 8;
+                        if (dcOnly)
+                        {
+                            idctDc(&c.plane[y * c.stride + x], c.stride, coefficients[0]);
+                        }
+                        else
+                        {
+                            idct(&c.plane[y * c.stride + x], c.stride, coefficients);
+                        }
+                    }
+                }
+            }
+            if (--todo == 0 && !(my == mcusY - 1 && mx == mcusX - 1))
+            {
+                if (!bits.restart())
+                {
+                    return fail("missing restart marker");
+                }
+                for (Component &c : m_components)
+                {
+                    c.dcPred = 0;
+                }
+                todo = m_restartInterval;
+            }
+        }
+    }
+    return true;
+}
+
+bool JpegDecoder::decode(unsigned char *dst, size_t rowStride, int channels)
+{
+    if (m_components.empty() || m_scanStart == 0)
+    {
+        return fail("no header");
+    }
+    if (channels < 1 || channels > 4)
+    {
+        return fail("bad channel count");
+    }
+
+    bool single = m_components.size() == 1;
+    int mcusX = (m_width + 8 * m_hMax - 1) / (8 * m_hMax);
+    int mcusY = (m_height + 8 * m_vMax - 1) / (8 * m_vMax);
+    for (Component &c : m_components)
+    {
+        c.width = (m_width * c.h + m_hMax - 1) / m_hMax;
+        c.height = (m_height * c.v + m_vMax - 1) / m_vMax;
+        c.blocksWide = single ? (c.width + 7) / 8 : mcusX * c.h;
+        c.blocksHigh = single ? (c.height + 7) / 8 : mcusY * c.v;
+        c.stride = static_cast<size_t>(c.blocksWide) * 8;
+        c.plane.resize(c.stride * c.blocksHigh * 8);
+    }
+    if (!decodeScan())
+    {
+        return false;
+    }
+
+    // grey output from a colour file only needs luma
+    int decodeCount = (m_components.size() == 3 && channels < 3) ? 1 : static_cast<int>(m_components.size());
+
+    struct Resampler
+    {
+        ResampleFn fn;
+        int hs, vs, ystep, ypos, wLores;
+        const uint8_t *line0;
+        const uint8_t *line1;
+        uint8_t *buffer;
+    } res[3];
+    size_t lineSize = static_cast<size_t>(m_width) + 32;
+    m_lines.resize(lineSize * decodeCount);
+    for (int k = 0; k < decodeCount; k++)
+    {
+        Resampler &r = res[k];
+        const Component &c = m_components[k];
+        r.hs = m_hMax / c.h;
+        r.vs = m_vMax / c.v;
+        r.ystep = r.vs >> 1;
+        r.ypos = 0;
+        r.wLores = (m_width + r.hs - 1) / r.hs;
+        r.line0 = r.line1 = c.plane.data();
+        r.buffer = &m_lines[lineSize * k];
+        if (r.hs == 1 && r.vs == 1)
+            r.fn = resampleRow1;
+        else if (r.hs == 1 && r.vs == 2)
+            r.fn = resampleRowV2;
+        else if (r.hs == 2 && r.vs == 1)
+            r.fn = resampleRowH2;
+        else if (r.hs == 2 && r.vs == 2)
+            r.fn = resampleRowHV2;
+        else
+            r.fn = resampleRowGeneric;
+    }
+
+    using ColorFn = void (*)(uint8_t *, const uint8_t *, const uint8_t *, const uint8_t *, int, int);
+    ColorFn toRgb = ycbcrToRgbScalar;
+#ifdef LEARNOPENGL_X86
+    if (m_simd && cpu::hasAvx2())
+    {
+        toRgb = ycbcrToRgbAvx2;
+    }
+#endif
+
+    // upsample and convert one output row at a time so the line buffers stay in L1
+    const uint8_t *rows[3] = {};
+    for (int j = 0; j < m_height; j++)
+    {
+        uint8_t *out = dst + rowStride * j;
+        for (int k = 0; k < decodeCount; k++)
+        {
+            Resampler &r = res[k];
+            bool bottom = r.ystep >= (r.vs >> 1);
+            rows[k] = r.fn(r.buffer, bottom ? r.line1 : r.line0, bottom ? r.line0 : r.line1, r.wLores, r.hs);
+            if (++r.ystep >= r.vs)
+            {
+                r.ystep = 0;
+                r.line0 = r.line1;
+                if (++r.ypos < m_components[k].height)
+                {
+                    r.line1 += m_components[k].stride;
+                }
+            }
+        }
+
+        const uint8_t *y = rows[0];
+        if (channels >= 3)
+        {
+            if (decodeCount == 3)
+            {
+                toRgb(out, y, rows[1], rows[2], m_width, channels);
+            }
+            else
+            {
+                for (int i = 0; i < m_width; i++, out += channels)
+                {
+                    out[0] = out[1] = out[2] = y[i];
+                    if (channels == 4)
+                    {
+                        out[3] = 255;
+                    }
+                }
+            }
+        }
+        else if (channels == 1)
+        {
+            std::memcpy(out, y, m_width);
+        }
+        else
+        {
+            for (int i = 0; i < m_width; i++)
+            {
+                *out++ = y[i];
+                *out++ = 255;
+            }
+        }
+    }
+    return true;
+}
+
+unsigned char *jpegLoadFromMemory(const unsigned char *buffer, int len, int *x, int *y, int *comp, int req_comp)
+{
+    // keeps its plane and line buffers between images decoded on this thread
+    thread_local JpegDecoder decoder;
+    if (buffer == nullptr || len <= 0 || req_comp < 0 || req_comp > 4 ||
+        !decoder.readHeader(buffer, static_cast<size_t>(len)))
+    {
+        return stbi_load_from_memory(buffer, len, x, y, comp, req_comp);
+    }
+
+    int channels = req_comp ? req_comp : (decoder.components() >= 3 ? 3 : 1);
+    size_t rowStride = static_cast<size_t>(decoder.width()) * channels;
+    unsigned char *pixels = static_cast<unsigned char *>(ImageArena::local().allocate(rowStride * decoder.height()));
+    if (pixels == nullptr || !decoder.decode(pixels, rowStride, channels))
+    {
+        ImageArena::local().release(pixels);
+        // let stb_image have a go (and set stbi_failure_reason) on anything we choke on
+        return stbi_load_from_memory(buffer, len, x, y, comp, req_comp);
+    }
+    *x = decoder.width();
+    *y = decoder.height();
+    if (comp)
+    {
+        *comp = decoder.components() >= 3 ? 3 : 1;
+    }
+    return pixels;
+}
@@ -0,0 +1,93 @@
+#ifndef JPEG_DECODER_HPP
+#define JPEG_DECODER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Baseline (sequential Huffman, 8-bit) JPEG decoder with AVX2 kernels.
+// It follows stb_image's integer IDCT, fancy chroma upsampling and fixed point
+// YCbCr->RGB maths, so the output matches stb_image built with STBI_NO_SIMD
+// exactly and the SSE2 build of stb_image to within a couple of levels.
+// Upsampling and colour conversion run one output row at a time on line
+// buffers that stay in L1, and pixels can go straight to caller memory such as
+// a mapped pixel unpack buffer. Progressive, arithmetic coded, 12-bit, CMYK and
+// RGB-tagged files are rejected by readHeader(); jpegLoadFromMemory() hands
+// those to stb_image.
+class JpegDecoder
+{
+public:
+    JpegDecoder();
+
+    // Parses the markers up to the first scan. data must stay valid until decode() returns.
+    bool readHeader(const unsigned char *data, size_t size);
+    int width() const;
+    int height() const;
+    int components() const;
+
+    // Writes width() x height() pixels with 1-4 channels (stbi_load's req_comp rules)
+    // starting at dst, rows rowStride bytes apart.
+    bool decode(unsigned char *dst, size_t rowStride, int channels);
+
+    const char *error() const;
+    // the scalar kernels are the reference for the SIMD ones
+    void setSimd(bool enabled);
+
+private:
+    struct Huffman
+    {
+        uint8_t fastLength[1 << 9]; // 0 = code longer than 9 bits
+        uint8_t fastSymbol[1 << 9];
+        // AC tables: value << 8 | run << 4 | code + value bits, when both fit in 9 bits
+        int16_t fastAc[1 << 9];
+        uint32_t maxCode[18];       // left justified in 16 bits, exclusive
+        int valueOffset[17];
+        uint8_t symbols[256];
+        bool defined;
+    };
+
+    struct Component
+    {
+        int id;
+        int h, v;
+        int quantTable;
+        int dcTable, acTable;
+        int width, height;        // samples actually covered by the image
+        int blocksWide, blocksHigh;
+        size_t stride;
+        std::vector<uint8_t> plane;
+        int dcPred;
+    };
+
+    struct BitReader;
+
+    bool fail(const char *message);
+    bool buildHuffman(Huffman &table, const uint8_t *counts, const uint8_t *symbols);
+    bool decodeScan();
+    // dcOnly comes back true when every AC coefficient is zero
+    bool decodeBlock(BitReader &bits, Component &component, int16_t *coefficients, bool &dcOnly);
+    // vars
+    const unsigned char *m_data;
+    size_t m_size;
+    size_t m_scanStart;
+    int m_width;
+    int m_height;
+    int m_hMax;
+    int m_vMax;
+    int m_restartInterval;
+    std::vector<Component> m_components;
+    std::vector<int> m_scanOrder;
+    uint16_t m_quant[4][64];
+    Huffman m_dc[4];
+    Huffman m_ac[4];
+    std::vector<uint8_t> m_lines; // upsampling line buffers
+    const char *m_error;
+    bool m_simd;
+};
+
+// Drop-in for stbi_load_from_memory: baseline JPEGs take the fast path, anything
+// else (including non-JPEG data) goes through stb_image. The result comes from
+// the calling thread's ImageArena, like everything else stb_image returns here.
+unsigned char *jpegLoadFromMemory(const unsigned char *buffer, int len, int *x, int *y, int *comp, int req_comp);
+
+#endif // JPEG_DECODER_HPP
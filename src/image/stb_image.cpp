@@ -0,0 +1,16 @@
+// The one stb_image implementation shared by every example.
+// Only the formats the assets use are compiled in, files are read through
+// MappedFile + stbi_load_from_memory so stdio is not needed at all, and every
+// allocation goes to the decoding thread's ImageArena.
+#include "image_arena.hpp"
+
+#define STBI_ONLY_JPEG
+#define STBI_ONLY_PNG
+#define STBI_ONLY_HDR
+#define STBI_NO_STDIO
+#define STBI_MALLOC(sz) ImageArena::local().allocate(sz)
+#define STBI_REALLOC_SIZED(p, oldsz, newsz) ImageArena::local().reallocate(p, oldsz, newsz)
+#define STBI_FREE(p) ImageArena::local().release(p)
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
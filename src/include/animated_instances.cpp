@@ -0,0 +1,94 @@
+#include "animated_instances.hpp"
+
+#include <cmath>
+
+namespace
+{
+    // unit axis, or +y for a zero one
+    void normalizedAxis(const AnimatedInstance &instance, float *axis)
+    {
+        float length = std::sqrt(instance.axis[0] * instance.axis[0] + instance.axis[1] * instance.axis[1] +
+                                 instance.axis[2] * instance.axis[2]);
+        if (length > 0.0f)
+        {
+            axis[0] = instance.axis[0] / length;
+            axis[1] = instance.axis[1] / length;
+            axis[2] = instance.axis[2] / length;
+        }
+        else
+        {
+            axis[0] = axis[2] = 0.0f;
+            axis[1] = 1.0f;
+        }
+    }
+} // namespace
+
+AnimatedInstances::AnimatedInstances() : m_buffer{0}, m_texture{0}, m_count{0}
+{
+    glGenBuffers(1, &m_buffer);
+    glGenTextures(1, &m_texture);
+}
+
+AnimatedInstances::~AnimatedInstances()
+{
+    glDeleteTextures(1, &m_texture);
+    glDeleteBuffers(1, &m_buffer);
+}
+
+void AnimatedInstances::upload(const std::vector<AnimatedInstance> &instances)
+{
+    std::vector<AnimatedInstance> packed = normalized(instances);
+    glBindBuffer(GL_TEXTURE_BUFFER, m_buffer);
+    glBufferData(GL_TEXTURE_BUFFER, static_cast<GLsizeiptr>(packed.size() * sizeof(AnimatedInstance)),
+                 packed.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    glBindTexture(GL_TEXTURE_BUFFER, m_texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, m_buffer);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    m_count = packed.size();
+}
+
+void AnimatedInstances::bind(GLuint unit) const
+{
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_BUFFER, m_texture);
+}
+
+size_t AnimatedInstances::size() const
+{
+    return m_count;
+}
+
+std::vector<AnimatedInstance> AnimatedInstances::normalized(const std::vector<AnimatedInstance> &instances)
+{
+    std::vector<AnimatedInstance> result(instances);
+    for (AnimatedInstance &instance : result)
+    {
+        normalizedAxis(instance, instance.axis);
+    }
+    return result;
+}
+
+void AnimatedInstances::modelMatrix(const AnimatedInstance &instance, float time, float *matrix)
+{
+    float a[3];
+    normalizedAxis(instance, a);
+    float angle = instance.phase + time * instance.angularSpeed;
+    float c = std::cos(angle), s = std::sin(angle), k = 1.0f - c;
+    // Rodrigues' rotation, one column at a time
+    const float rotation[9] = {c + k * a[0] * a[0],        k * a[0] * a[1] + s * a[2], k * a[0] * a[2] - s * a[1],
+                               k * a[1] * a[0] - s * a[2], c + k * a[1] * a[1],        k * a[1] * a[2] + s * a[0],
+                               k * a[2] * a[0] + s * a[1], k * a[2] * a[1] - s * a[0], c + k * a[2] * a[2]};
+    for (int column = 0; column < 3; column++)
+    {
+        for (int row = 0; row < 3; row++)
+        {
+            matrix[column * 4 + row] = rotation[column * 3 + row];
+        }
+        matrix[column * 4 + 3] = 0.0f;
+    }
+    matrix[12] = instance.position[0];
+    matrix[13] = instance.position[1];
+    matrix[14] = instance.position[2];
+    matrix[15] = 1.0f;
+}
@@ -0,0 +1,52 @@
+#ifndef ANIMATED_INSTANCES_HPP
+#define ANIMATED_INSTANCES_HPP
+
+#include <cstddef>
+#include <vector>
+#include <glad/glad.h>
+
+// Static parameters of an object spinning about an axis through its origin. Its model
+// matrix at time t is translate(position) * rotate(phase + t * angularSpeed, axis), the
+// same as glm::rotate(glm::translate(glm::mat4(1), position), angle, axis).
+struct AnimatedInstance
+{
+    float position[3];
+    float phase;        // radians at time 0
+    float axis[3];      // normalised on upload
+    float angularSpeed; // radians per second
+};
+
+// Procedurally animated instances that live on the GPU. upload() writes them once into a
+// buffer texture of two RGBA32F texels per instance; the vertex shader fetches its own
+// with texelFetch(instances, (firstInstance + gl_InstanceID) * 2 + k) and builds the model
+// matrix from a time uniform, so a frame costs one uniform whatever the instance count.
+// GL 4.1 has no base instance, ranges are picked through the firstInstance uniform.
+class AnimatedInstances
+{
+public:
+    AnimatedInstances();
+    ~AnimatedInstances();
+
+    AnimatedInstances(const AnimatedInstances &) = delete;
+    AnimatedInstances &operator=(const AnimatedInstances &) = delete;
+
+    void upload(const std::vector<AnimatedInstance> &instances);
+    // binds the buffer texture to texture unit `unit`, for the shader's samplerBuffer
+    void bind(GLuint unit) const;
+    size_t size() const;
+
+    // what upload() puts in the buffer, axes normalised: two RGBA32F texels each, for
+    // shaders run on the CPU
+    static std::vector<AnimatedInstance> normalized(const std::vector<AnimatedInstance> &instances);
+    // the matrix the shader builds, column major, for CPU side use (picking, bounds,
+    // drivers without instancing)
+    static void modelMatrix(const AnimatedInstance &instance, float time, float *matrix);
+
+private:
+    // vars
+    GLuint m_buffer;
+    GLuint m_texture;
+    size_t m_count;
+};
+
+#endif // ANIMATED_INSTANCES_HPP
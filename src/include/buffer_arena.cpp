@@ -0,0 +1,562 @@
+#include "buffer_arena.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+
+namespace
+{
+    const uint32_t NONE = TlsfAllocator::INVALID;
+
+    uint32_t highestBit(uint32_t v)
+    {
+        return 31u - static_cast<uint32_t>(__builtin_clz(v));
+    }
+
+    uint32_t lowestBit(uint32_t v)
+    {
+        return static_cast<uint32_t>(__builtin_ctz(v));
+    }
+} // namespace
+
+// ---------------------------------------------------------------------------
+// TlsfAllocator
+
+TlsfAllocator::TlsfAllocator(uint32_t capacity) : m_flBitmap{0}, m_first{NONE}, m_last{NONE}, m_capacity{0}
+{
+    for (uint32_t fl = 0; fl < FL_COUNT; fl++)
+    {
+        m_slBitmap[fl] = 0;
+        std::fill(m_heads[fl], m_heads[fl] + SL_COUNT, NONE);
+    }
+    grow(capacity);
+};
+
+// Sizes below SL_COUNT get a list each; above that, every power of two range is split into
+// SL_COUNT lists of equal width.
+void TlsfAllocator::mapping(uint32_t size, uint32_t &fl, uint32_t &sl)
+{
+    if (size < SL_COUNT)
+    {
+        fl = 0;
+        sl = size;
+        return;
+    }
+    uint32_t msb = highestBit(size);
+    fl = msb - SL_LOG + 1;
+    sl = (size >> (msb - SL_LOG)) ^ SL_COUNT;
+}
+
+uint32_t TlsfAllocator::newBlock()
+{
+    if (!m_unusedBlocks.empty())
+    {
+        uint32_t block = m_unusedBlocks.back();
+        m_unusedBlocks.pop_back();
+        return block;
+    }
+    m_blocks.push_back(Block{});
+    return static_cast<uint32_t>(m_blocks.size() - 1);
+}
+
+void TlsfAllocator::insertFree(uint32_t block)
+{
+    Block &b = m_blocks[block];
+    uint32_t fl, sl;
+    mapping(b.size, fl, sl);
+    b.free = true;
+    b.prevFree = NONE;
+    b.nextFree = m_heads[fl][sl];
+    if (b.nextFree != NONE)
+    {
+        m_blocks[b.nextFree].prevFree = block;
+    }
+    m_heads[fl][sl] = block;
+    m_flBitmap |= 1u << fl;
+    m_slBitmap[fl] |= 1u << sl;
+}
+
+void TlsfAllocator::removeFree(uint32_t block)
+{
+    Block &b = m_blocks[block];
+    uint32_t fl, sl;
+    mapping(b.size, fl, sl);
+    if (b.prevFree != NONE)
+    {
+        m_blocks[b.prevFree].nextFree = b.nextFree;
+    }
+    else
+    {
+        m_heads[fl][sl] = b.nextFree;
+    }
+    if (b.nextFree != NONE)
+    {
+        m_blocks[b.nextFree].prevFree = b.prevFree;
+    }
+    if (m_heads[fl][sl] == NONE)
+    {
+        m_slBitmap[fl] &= ~(1u << sl);
+        if (m_slBitmap[fl] == 0)
+        {
+            m_flBitmap &= ~(1u << fl);
+        }
+    }
+    b.free = false;
+}
+
+// Rounds size up to the next list boundary first, so any block of the list found is
+// large enough and no list has to be searched.
+uint32_t TlsfAllocator::findFree(uint32_t size) const
+{
+    uint64_t rounded = size;
+    if (size >= SL_COUNT)
+    {
+        rounded += (uint64_t{1} << (highestBit(size) - SL_LOG)) - 1;
+    }
+    if (rounded > 0xFFFFFFFFu)
+    {
+        return NONE;
+    }
+    uint32_t fl, sl;
+    mapping(static_cast<uint32_t>(rounded), fl, sl);
+    uint32_t slMap = m_slBitmap[fl] & (~0u << sl);
+    if (slMap == 0)
+    {
+        uint32_t flMap = fl + 1 < 32 ? m_flBitmap & (~0u << (fl + 1)) : 0;
+        if (flMap == 0)
+        {
+            return NONE;
+        }
+        fl = lowestBit(flMap);
+        slMap = m_slBitmap[fl];
+    }
+    return m_heads[fl][lowestBit(slMap)];
+}
+
+uint32_t TlsfAllocator::allocate(uint32_t size)
+{
+    size = std::max(size, 1u);
+    uint32_t block = findFree(size);
+    if (block == NONE)
+    {
+        return NONE;
+    }
+    removeFree(block);
+    if (m_blocks[block].size > size)
+    {
+        // the rest goes back as a free block right after this one
+        uint32_t rest = newBlock();
+        Block &b = m_blocks[block];
+        Block &r = m_blocks[rest];
+        r.offset = b.offset + size;
+        r.size = b.size - size;
+        r.prevPhysical = block;
+        r.nextPhysical = b.nextPhysical;
+        if (r.nextPhysical != NONE)
+        {
+            m_blocks[r.nextPhysical].prevPhysical = rest;
+        }
+        else
+        {
+            m_last = rest;
+        }
+        b.nextPhysical = rest;
+        b.size = size;
+        insertFree(rest);
+    }
+    return block;
+}
+
+void TlsfAllocator::free(uint32_t handle)
+{
+    uint32_t block = handle;
+    // merge with free neighbours, keeping the lower block
+    uint32_t prev = m_blocks[block].prevPhysical;
+    if (prev != NONE && m_blocks[prev].free)
+    {
+        removeFree(prev);
+        m_blocks[prev].size += m_blocks[block].size;
+        m_blocks[prev].nextPhysical = m_blocks[block].nextPhysical;
+        m_unusedBlocks.push_back(block);
+        block = prev;
+    }
+    uint32_t next = m_blocks[block].nextPhysical;
+    if (next != NONE && m_blocks[next].free)
+    {
+        removeFree(next);
+        m_blocks[block].size += m_blocks[next].size;
+        m_blocks[block].nextPhysical = m_blocks[next].nextPhysical;
+        m_unusedBlocks.push_back(next);
+    }
+    if (m_blocks[block].nextPhysical != NONE)
+    {
+        m_blocks[m_blocks[block].nextPhysical].prevPhysical = block;
+    }
+    else
+    {
+        m_last = block;
+    }
+    insertFree(block);
+}
+
+void TlsfAllocator::grow(uint32_t capacity)
+{
+    if (capacity <= m_capacity)
+    {
+        return;
+    }
+    uint32_t extra = capacity - m_capacity;
+    if (m_last != NONE && m_blocks[m_last].free)
+    {
+        removeFree(m_last);
+        m_blocks[m_last].size += extra;
+        insertFree(m_last);
+    }
+    else
+    {
+        uint32_t block = newBlock();
+        Block &b = m_blocks[block];
+        b.offset = m_capacity;
+        b.size = extra;
+        b.prevPhysical = m_last;
+        b.nextPhysical = NONE;
+        if (m_last != NONE)
+        {
+            m_blocks[m_last].nextPhysical = block;
+        }
+        else
+        {
+            m_first = block;
+        }
+        m_last = block;
+        insertFree(block);
+    }
+    m_capacity = capacity;
+}
+
+std::vector<TlsfAllocator::Move> TlsfAllocator::compact()
+{
+    std::vector<Move> moves;
+    uint32_t cursor = 0, previous = NONE;
+    for (uint32_t block = m_first; block != NONE;)
+    {
+        uint32_t next = m_blocks[block].nextPhysical;
+        Block &b = m_blocks[block];
+        if (b.free)
+        {
+            removeFree(block);
+            m_unusedBlocks.push_back(block);
+        }
+        else
+        {
+            moves.push_back(Move{block, b.offset, cursor, b.size});
+            b.offset = cursor;
+            b.prevPhysical = previous;
+            if (previous != NONE)
+            {
+                m_blocks[previous].nextPhysical = block;
+            }
+            else
+            {
+                m_first = block;
+            }
+            cursor += b.size;
+            previous = block;
+        }
+        block = next;
+    }
+
+    if (previous == NONE)
+    {
+        m_first = NONE;
+    }
+    else
+    {
+        m_blocks[previous].nextPhysical = NONE;
+    }
+    m_last = previous;
+    uint32_t capacity = m_capacity;
+    m_capacity = cursor;
+    grow(capacity);
+    return moves;
+}
+
+uint32_t TlsfAllocator::offset(uint32_t handle) const
+{
+    return m_blocks[handle].offset;
+}
+
+uint32_t TlsfAllocator::size(uint32_t handle) const
+{
+    return m_blocks[handle].size;
+}
+
+uint32_t TlsfAllocator::capacity() const
+{
+    return m_capacity;
+}
+
+TlsfAllocator::Stats TlsfAllocator::stats() const
+{
+    Stats stats{m_capacity, 0, 0, 0, 0, 0.0f};
+    uint32_t freeSpace = 0;
+    for (uint32_t block = m_first; block != NONE; block = m_blocks[block].nextPhysical)
+    {
+        const Block &b = m_blocks[block];
+        if (b.free)
+        {
+            freeSpace += b.size;
+            stats.largestFree = std::max(stats.largestFree, b.size);
+            stats.freeBlocks++;
+        }
+        else
+        {
+            stats.used += b.size;
+            stats.allocations++;
+        }
+    }
+    stats.fragmentation = freeSpace > 0 ? 1.0f - static_cast<float>(stats.largestFree) / freeSpace : 0.0f;
+    return stats;
+}
+
+// ---------------------------------------------------------------------------
+// BufferArena
+
+BufferArena::BufferArena(size_t elementSize, uint32_t capacity)
+    : m_buffer{0}, m_elementSize{elementSize}, m_allocator{0}, m_vertexArrays{nullptr}
+{
+    relocate(std::max(capacity, 1u), {});
+};
+
+BufferArena::~BufferArena()
+{
+    if (m_vertexArrays != nullptr)
+    {
+        m_vertexArrays->release(m_buffer);
+    }
+    glDeleteBuffers(1, &m_buffer);
+}
+
+void BufferArena::relocate(uint32_t capacity, const std::vector<TlsfAllocator::Move> &moves)
+{
+    GLuint buffer;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, static_cast<GLsizeiptr>(capacity * m_elementSize), nullptr, GL_STATIC_DRAW);
+    if (m_buffer != 0)
+    {
+        // one copy per run of allocations that stay next to each other
+        glBindBuffer(GL_COPY_READ_BUFFER, m_buffer);
+        for (size_t i = 0; i < moves.size();)
+        {
+            size_t run = i + 1;
+            uint32_t size = moves[i].size;
+            while (run < moves.size() && moves[run].from == moves[i].from + size && moves[run].to == moves[i].to + size)
+            {
+                size += moves[run++].size;
+            }
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                                static_cast<GLintptr>(moves[i].from * m_elementSize),
+                                static_cast<GLintptr>(moves[i].to * m_elementSize),
+                                static_cast<GLsizeiptr>(size * m_elementSize));
+            i = run;
+        }
+        if (m_vertexArrays != nullptr)
+        {
+            m_vertexArrays->release(m_buffer);
+        }
+        glDeleteBuffers(1, &m_buffer);
+    }
+    m_buffer = buffer;
+}
+
+uint32_t BufferArena::allocate(uint32_t count, const void *data, StagingBuffer *staging)
+{
+    uint32_t handle = m_allocator.allocate(count);
+    if (handle == TlsfAllocator::INVALID)
+    {
+        // everything stays where it is, only the buffer gets longer. Sizes are worked out in
+        // 64 bits since doubling can pass both the allocator's 32 bit units and GLsizeiptr.
+        uint32_t capacity = m_allocator.capacity();
+        uint64_t limit = std::min<uint64_t>(UINT32_MAX, std::numeric_limits<GLsizeiptr>::max() / m_elementSize);
+        uint64_t needed = static_cast<uint64_t>(capacity) + count;
+        if (needed > limit)
+        {
+            std::cerr << "BufferArena: cannot allocate " << count << " elements, the buffer would pass " << limit
+                      << std::endl;
+            return TlsfAllocator::INVALID;
+        }
+        uint32_t grown = static_cast<uint32_t>(std::min(std::max(static_cast<uint64_t>(capacity) * 2, needed), limit));
+        relocate(grown, {TlsfAllocator::Move{0, 0, 0, capacity}});
+        m_allocator.grow(grown);
+        handle = m_allocator.allocate(count);
+        if (handle == TlsfAllocator::INVALID)
+        {
+            std::cerr << "BufferArena: cannot allocate " << count << " elements" << std::endl;
+            return handle;
+        }
+    }
+    if (data != nullptr)
+    {
+        update(handle, data, count, 0, staging);
+    }
+    return handle;
+}
+
+void BufferArena::update(uint32_t handle, const void *data, uint32_t count, uint32_t firstElement,
+                         StagingBuffer *staging)
+{
+    size_t offset = (m_allocator.offset(handle) + firstElement) * m_elementSize;
+    size_t size = count * m_elementSize;
+    if (staging != nullptr)
+    {
+        staging->copy(m_buffer, offset, data, size);
+        return;
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(offset), static_cast<GLsizeiptr>(size), data);
+}
+
+void BufferArena::free(uint32_t handle)
+{
+    m_allocator.free(handle);
+}
+
+uint32_t BufferArena::first(uint32_t handle) const
+{
+    return m_allocator.offset(handle);
+}
+
+uint32_t BufferArena::count(uint32_t handle) const
+{
+    return m_allocator.size(handle);
+}
+
+GLuint BufferArena::buffer() const
+{
+    return m_buffer;
+}
+
+size_t BufferArena::elementSize() const
+{
+    return m_elementSize;
+}
+
+TlsfAllocator::Stats BufferArena::stats() const
+{
+    return m_allocator.stats();
+}
+
+bool BufferArena::defragment(float threshold)
+{
+    TlsfAllocator::Stats stats = m_allocator.stats();
+    if (stats.freeBlocks < 2 || stats.fragmentation < threshold)
+    {
+        return false;
+    }
+    std::vector<TlsfAllocator::Move> moves = m_allocator.compact();
+    relocate(m_allocator.capacity(), moves);
+    return true;
+}
+
+void BufferArena::setVertexArrays(mesh::VertexArrayCache *vertexArrays)
+{
+    m_vertexArrays = vertexArrays;
+}
+
+// ---------------------------------------------------------------------------
+// MeshArena
+
+MeshArena::MeshArena(const mesh::VertexLayout &layout, uint32_t vertexCapacity, uint32_t indexCapacity)
+    : m_layout{layout}, m_layoutHash{mesh::layoutHash(layout)},
+      m_vertices{static_cast<size_t>(layout.stride), vertexCapacity}, m_indices{sizeof(uint32_t), indexCapacity}
+{
+};
+
+ArenaMesh MeshArena::add(const void *vertices, uint32_t vertexCount, const uint32_t *indices, uint32_t indexCount,
+                         StagingBuffer *staging)
+{
+    ArenaMesh mesh;
+    mesh.vertices = m_vertices.allocate(vertexCount, vertices, staging);
+    mesh.indices = m_indices.allocate(indexCount, indices, staging);
+    if (mesh.vertices == TlsfAllocator::INVALID || mesh.indices == TlsfAllocator::INVALID)
+    {
+        remove(mesh);
+    }
+    return mesh;
+}
+
+void MeshArena::remove(ArenaMesh &mesh)
+{
+    if (mesh.vertices != TlsfAllocator::INVALID)
+    {
+        m_vertices.free(mesh.vertices);
+    }
+    if (mesh.indices != TlsfAllocator::INVALID)
+    {
+        m_indices.free(mesh.indices);
+    }
+    mesh = ArenaMesh{};
+}
+
+void MeshArena::bind(mesh::VertexArrayCache &vertexArrays)
+{
+    m_vertices.setVertexArrays(&vertexArrays);
+    m_indices.setVertexArrays(&vertexArrays);
+    vertexArrays.bind(m_layout, m_layoutHash, m_vertices.buffer(), m_indices.buffer());
+}
+
+void MeshArena::draw(const ArenaMesh &mesh) const
+{
+    draw(mesh, 0, m_indices.count(mesh.indices));
+}
+
+void MeshArena::draw(const ArenaMesh &mesh, uint32_t firstIndex, uint32_t indexCount) const
+{
+    size_t first = m_indices.first(mesh.indices) + firstIndex;
+    glDrawElementsBaseVertex(GL_TRIANGLES, static_cast<GLsizei>(indexCount), GL_UNSIGNED_INT,
+                             reinterpret_cast<const void *>(first * sizeof(uint32_t)),
+                             static_cast<GLint>(m_vertices.first(mesh.vertices)));
+}
+
+void MeshArena::drawInstanced(const ArenaMesh &mesh, uint32_t firstIndex, uint32_t indexCount,
+                              uint32_t instanceCount) const
+{
+    size_t first = m_indices.first(mesh.indices) + firstIndex;
+    glDrawElementsInstancedBaseVertex(GL_TRIANGLES, static_cast<GLsizei>(indexCount), GL_UNSIGNED_INT,
+                                      reinterpret_cast<const void *>(first * sizeof(uint32_t)),
+                                      static_cast<GLsizei>(instanceCount),
+                                      static_cast<GLint>(m_vertices.first(mesh.vertices)));
+}
+
+void MeshArena::draw(const std::vector<ArenaMesh> &meshes) const
+{
+    std::vector<GLsizei> counts;
+    std::vector<const void *> offsets;
+    std::vector<GLint> baseVertices;
+    for (const ArenaMesh &mesh : meshes)
+    {
+        counts.push_back(static_cast<GLsizei>(m_indices.count(mesh.indices)));
+        offsets.push_back(reinterpret_cast<const void *>(size_t{m_indices.first(mesh.indices)} * sizeof(uint32_t)));
+        baseVertices.push_back(static_cast<GLint>(m_vertices.first(mesh.vertices)));
+    }
+    glMultiDrawElementsBaseVertex(GL_TRIANGLES, counts.data(), GL_UNSIGNED_INT, offsets.data(),
+                                  static_cast<GLsizei>(meshes.size()), baseVertices.data());
+}
+
+bool MeshArena::defragment(float threshold)
+{
+    bool vertices = m_vertices.defragment(threshold);
+    bool indices = m_indices.defragment(threshold);
+    return vertices || indices;
+}
+
+const BufferArena &MeshArena::vertices() const
+{
+    return m_vertices;
+}
+
+const BufferArena &MeshArena::indices() const
+{
+    return m_indices;
+}
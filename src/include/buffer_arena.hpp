@@ -0,0 +1,176 @@
+#ifndef BUFFER_ARENA_HPP
+#define BUFFER_ARENA_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glad/glad.h>
+
+#include "staging_buffer.hpp"
+#include "vertex_format.hpp"
+
+// Two level segregated fit allocator (Masmano et al. 2004) over an abstract range of
+// units: allocate and free are O(1), picking a block from a size class that is known to
+// fit through two bitmap lookups. It never touches the memory it manages, so it works for
+// GPU buffers where units are vertices or indices. Handles stay valid until freed,
+// including across grow() and compact().
+class TlsfAllocator
+{
+public:
+    static const uint32_t INVALID = 0xFFFFFFFFu;
+
+    struct Stats
+    {
+        uint32_t capacity;
+        uint32_t used;
+        uint32_t largestFree;
+        uint32_t allocations;
+        uint32_t freeBlocks;
+        // 1 - largest free block / free space: 0 when all free space is one block
+        float fragmentation;
+    };
+
+    struct Move
+    {
+        uint32_t handle;
+        uint32_t from;
+        uint32_t to;
+        uint32_t size;
+    };
+
+    explicit TlsfAllocator(uint32_t capacity = 0);
+
+    // INVALID when no free block is large enough
+    uint32_t allocate(uint32_t size);
+    void free(uint32_t handle);
+    // adds free space at the end
+    void grow(uint32_t capacity);
+    // Packs every allocation to the front, keeping their order, and returns where each of
+    // them was and is now (unmoved ones included), in offset order.
+    std::vector<Move> compact();
+
+    uint32_t offset(uint32_t handle) const;
+    uint32_t size(uint32_t handle) const;
+    uint32_t capacity() const;
+    Stats stats() const;
+
+private:
+    static const uint32_t SL_LOG = 4;
+    static const uint32_t SL_COUNT = 1u << SL_LOG;
+    static const uint32_t FL_COUNT = 32 - SL_LOG + 1;
+
+    struct Block
+    {
+        uint32_t offset;
+        uint32_t size;
+        uint32_t prevPhysical;
+        uint32_t nextPhysical;
+        uint32_t prevFree;
+        uint32_t nextFree;
+        bool free;
+    };
+
+    static void mapping(uint32_t size, uint32_t &fl, uint32_t &sl);
+    uint32_t newBlock();
+    void insertFree(uint32_t block);
+    void removeFree(uint32_t block);
+    uint32_t findFree(uint32_t size) const;
+    // vars
+    std::vector<Block> m_blocks;
+    std::vector<uint32_t> m_unusedBlocks;
+    uint32_t m_heads[FL_COUNT][SL_COUNT];
+    uint32_t m_flBitmap;
+    uint32_t m_slBitmap[FL_COUNT];
+    uint32_t m_first;
+    uint32_t m_last;
+    uint32_t m_capacity;
+};
+
+// One GL buffer shared by many allocations of fixed size elements (vertices of one layout,
+// or indices), placed by a TlsfAllocator. The buffer doubles when full and defragment()
+// packs it; both copy into a new buffer object, so read buffer() when binding rather than
+// keeping it. Uploads go through an optional StagingBuffer.
+class BufferArena
+{
+public:
+    BufferArena(size_t elementSize, uint32_t capacity);
+    ~BufferArena();
+
+    BufferArena(const BufferArena &) = delete;
+    BufferArena &operator=(const BufferArena &) = delete;
+
+    // count elements, filled from data when it is not null
+    uint32_t allocate(uint32_t count, const void *data = nullptr, StagingBuffer *staging = nullptr);
+    void update(uint32_t handle, const void *data, uint32_t count, uint32_t firstElement = 0,
+                StagingBuffer *staging = nullptr);
+    void free(uint32_t handle);
+
+    // in elements: the base vertex or first index of an allocation
+    uint32_t first(uint32_t handle) const;
+    uint32_t count(uint32_t handle) const;
+
+    GLuint buffer() const;
+    size_t elementSize() const;
+    TlsfAllocator::Stats stats() const;
+
+    // packs all allocations once fragmentation reaches threshold; true when they moved
+    bool defragment(float threshold = 0.0f);
+
+    // the cache is told whenever the buffer is replaced or deleted, so VAOs built on the old
+    // one do not pile up; it must outlive the arena. nullptr detaches it.
+    void setVertexArrays(mesh::VertexArrayCache *vertexArrays);
+
+private:
+    // moves the contents into a new buffer of capacity elements
+    void relocate(uint32_t capacity, const std::vector<TlsfAllocator::Move> &moves);
+    // vars
+    GLuint m_buffer;
+    size_t m_elementSize;
+    TlsfAllocator m_allocator;
+    mesh::VertexArrayCache *m_vertexArrays;
+};
+
+// vertex and index allocation of one mesh in a MeshArena
+struct ArenaMesh
+{
+    uint32_t vertices = TlsfAllocator::INVALID;
+    uint32_t indices = TlsfAllocator::INVALID;
+};
+
+// Vertex and index arenas for all meshes of one vertex layout: one VAO, no per mesh
+// buffers, and draws that pick their mesh through the base vertex and first index. Indices
+// stay relative to their own mesh's vertices.
+class MeshArena
+{
+public:
+    explicit MeshArena(const mesh::VertexLayout &layout, uint32_t vertexCapacity = 1 << 16,
+                       uint32_t indexCapacity = 1 << 18);
+
+    ArenaMesh add(const void *vertices, uint32_t vertexCount, const uint32_t *indices, uint32_t indexCount,
+                  StagingBuffer *staging = nullptr);
+    void remove(ArenaMesh &mesh);
+
+    // binds the arena's buffers through a VAO of the cache, before draw calls. The cache
+    // then hears about every buffer the arena replaces, so it must outlive the arena.
+    void bind(mesh::VertexArrayCache &vertexArrays);
+    void draw(const ArenaMesh &mesh) const;
+    // firstIndex relative to the mesh, for example one level of detail
+    void draw(const ArenaMesh &mesh, uint32_t firstIndex, uint32_t indexCount) const;
+    // instanceCount copies of the range, told apart by gl_InstanceID
+    void drawInstanced(const ArenaMesh &mesh, uint32_t firstIndex, uint32_t indexCount, uint32_t instanceCount) const;
+    // all of them with one glMultiDrawElementsBaseVertex
+    void draw(const std::vector<ArenaMesh> &meshes) const;
+
+    bool defragment(float threshold = 0.25f);
+    const BufferArena &vertices() const;
+    const BufferArena &indices() const;
+
+private:
+    // vars
+    mesh::VertexLayout m_layout;
+    uint64_t m_layoutHash;
+    BufferArena m_vertices;
+    BufferArena m_indices;
+};
+
+#endif // BUFFER_ARENA_HPP
@@ -0,0 +1,60 @@
+#ifndef CPU_FEATURES_HPP
+#define CPU_FEATURES_HPP
+
+// Runtime instruction set checks used to pick between SIMD kernels.
+// Kernels are compiled with per-function target attributes, so the build does not
+// need -mavx2 and the binaries still run on older CPUs.
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+#define LEARNOPENGL_X86 1
+#if defined(__GNUC__) || defined(__clang__)
+#define LEARNOPENGL_TARGET(isa) __attribute__((target(isa)))
+#else
+#define LEARNOPENGL_TARGET(isa)
+#endif
+#endif
+
+namespace cpu
+{
+    inline bool hasSsse3()
+    {
+#if defined(LEARNOPENGL_X86) && (defined(__GNUC__) || defined(__clang__))
+        static const bool supported = __builtin_cpu_supports("ssse3");
+        return supported;
+#else
+        return false;
+#endif
+    }
+
+    inline bool hasSse41()
+    {
+#if defined(LEARNOPENGL_X86) && (defined(__GNUC__) || defined(__clang__))
+        static const bool supported = __builtin_cpu_supports("sse4.1");
+        return supported;
+#else
+        return false;
+#endif
+    }
+
+    inline bool hasAvx2()
+    {
+#if defined(LEARNOPENGL_X86) && (defined(__GNUC__) || defined(__clang__))
+        static const bool supported = __builtin_cpu_supports("avx2");
+        return supported;
+#else
+        return false;
+#endif
+    }
+
+    inline bool hasF16c()
+    {
+#if defined(LEARNOPENGL_X86) && (defined(__GNUC__) || defined(__clang__))
+        static const bool supported = __builtin_cpu_supports("f16c") && __builtin_cpu_supports("avx");
+        return supported;
+#else
+        return false;
+#endif
+    }
+} // namespace cpu
+
+#endif // CPU_FEATURES_HPP
@@ -0,0 +1,209 @@
+#include "frame_readback.hpp"
+#include "gl_extensions.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <utility>
+
+FrameReadback::FrameReadback(Consumer consumer, size_t depth)
+    : m_consumer{std::move(consumer)}, m_persistent{glext::get().persistentMapping},
+      m_slots(std::max<size_t>(depth, 1)), m_next{0}, m_draining{false}
+{
+}
+
+FrameReadback::~FrameReadback()
+{
+    finish();
+    for (Slot &slot : m_slots)
+    {
+        if (slot.buffer != 0)
+        {
+            // deleting a mapped buffer unmaps it
+            glDeleteBuffers(1, &slot.buffer);
+        }
+    }
+}
+
+const FrameReadback::Stats &FrameReadback::stats() const
+{
+    return m_stats;
+}
+
+void FrameReadback::reserve(Slot &slot, size_t size)
+{
+    if (slot.capacity >= size)
+    {
+        return;
+    }
+    if (slot.buffer != 0)
+    {
+        glDeleteBuffers(1, &slot.buffer);
+    }
+    slot.mapped = nullptr;
+    slot.capacity = size;
+    glGenBuffers(1, &slot.buffer);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    slot.persistent = false;
+    if (m_persistent)
+    {
+        GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glext::get().bufferStorage(GL_PIXEL_PACK_BUFFER, static_cast<GLsizeiptr>(size), nullptr, flags);
+        slot.mapped = static_cast<unsigned char *>(
+            glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, static_cast<GLsizeiptr>(size), flags));
+        slot.persistent = slot.mapped != nullptr;
+        if (!slot.persistent)
+        {
+            // immutable storage cannot be respecified, start over with a mutable buffer
+            glDeleteBuffers(1, &slot.buffer);
+            glGenBuffers(1, &slot.buffer);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+            m_persistent = false;
+        }
+    }
+    if (!slot.persistent)
+    {
+        glBufferData(GL_PIXEL_PACK_BUFFER, static_cast<GLsizeiptr>(size), nullptr, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+void FrameReadback::capture(int width, int height)
+{
+    recycle();
+    Slot &slot = m_slots[m_next];
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (slot.state != FREE)
+    {
+        // the ring is full: the GPU or the consumer is behind
+        m_stats.stalls++;
+        if (slot.state == READING)
+        {
+            // slots are used in turn, so the oldest read is this one
+            lock.unlock();
+            consume(*m_reading.front(), true);
+            m_reading.pop_front();
+            lock.lock();
+        }
+        m_returned.wait(lock, [&slot] { return slot.state == CONSUMED; });
+        lock.unlock();
+        recycle();
+    }
+    else
+    {
+        lock.unlock();
+    }
+
+    reserve(slot, static_cast<size_t>(width) * static_cast<size_t>(height) * 4);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    // RGBA8 rows are always 4 byte aligned, the default GL_PACK_ALIGNMENT packs them tightly
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.frame = ReadbackFrame{m_stats.captured++, width, height, nullptr};
+    slot.state = READING;
+    m_reading.push_back(&slot);
+    m_next = (m_next + 1) % m_slots.size();
+}
+
+bool FrameReadback::consume(Slot &slot, bool wait)
+{
+    GLuint64 timeout = wait ? 1000000 : 0;
+    GLenum status;
+    while ((status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout)) == GL_TIMEOUT_EXPIRED)
+    {
+        if (!wait)
+        {
+            return false;
+        }
+    }
+    glDeleteSync(slot.fence);
+    slot.fence = nullptr;
+
+    if (!slot.persistent)
+    {
+        size_t size = static_cast<size_t>(slot.frame.width) * static_cast<size_t>(slot.frame.height) * 4;
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+        slot.mapped = static_cast<unsigned char *>(
+            glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, static_cast<GLsizeiptr>(size), GL_MAP_READ_BIT));
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (status == GL_WAIT_FAILED || slot.mapped == nullptr)
+    {
+        std::cerr << "Frame " << slot.frame.index << " could not be read back" << std::endl;
+        slot.state = CONSUMED;
+        return true;
+    }
+    slot.frame.pixels = slot.mapped;
+    slot.state = CONSUMING;
+    m_queue.push_back(&slot);
+    if (!m_draining)
+    {
+        m_draining = true;
+        ThreadPool::shared().enqueue([this] { drain(); });
+    }
+    return true;
+}
+
+void FrameReadback::drain()
+{
+    // one job at a time keeps the consumer calls serial and in order
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (!m_queue.empty())
+    {
+        Slot *slot = m_queue.front();
+        m_queue.pop_front();
+        lock.unlock();
+        m_consumer(slot->frame);
+        lock.lock();
+        slot->state = CONSUMED;
+        m_returned.notify_all();
+    }
+    m_draining = false;
+    m_returned.notify_all();
+}
+
+void FrameReadback::recycle()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (Slot &slot : m_slots)
+    {
+        if (slot.state != CONSUMED)
+        {
+            continue;
+        }
+        if (!slot.persistent && slot.mapped != nullptr)
+        {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            slot.mapped = nullptr;
+        }
+        slot.state = FREE;
+        m_stats.consumed++;
+    }
+}
+
+void FrameReadback::update()
+{
+    recycle();
+    while (!m_reading.empty() && consume(*m_reading.front(), false))
+    {
+        m_reading.pop_front();
+    }
+}
+
+void FrameReadback::finish()
+{
+    while (!m_reading.empty())
+    {
+        consume(*m_reading.front(), true);
+        m_reading.pop_front();
+    }
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_returned.wait(lock, [this] { return m_queue.empty() && !m_draining; });
+    }
+    recycle();
+}
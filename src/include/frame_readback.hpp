@@ -0,0 +1,101 @@
+#ifndef FRAME_READBACK_HPP
+#define FRAME_READBACK_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <vector>
+#include <glad/glad.h>
+
+// A captured frame: tightly packed RGBA8 rows, bottom row first as GL reads them.
+// pixels is only valid for the duration of the consumer call.
+struct ReadbackFrame
+{
+    uint64_t index;
+    int width;
+    int height;
+    const unsigned char *pixels;
+};
+
+// Reads frames back without stalling the render loop. capture() only queues a
+// glReadPixels into the next of a ring of GL_PIXEL_PACK_BUFFERs and fences it; update(),
+// a few frames later, maps the buffers whose fence has signalled and hands them to the
+// consumer on ThreadPool::shared(). Frames reach the consumer one at a time and in
+// capture order, and a buffer is reused once the consumer has returned. With GL 4.4 /
+// ARB_buffer_storage the buffers stay persistently mapped, otherwise they are mapped
+// and unmapped around each frame. The ring should be a little deeper than the frames
+// the GPU runs behind plus the frames a consumer call takes; stats().stalls counts the
+// captures that had to wait for a buffer.
+class FrameReadback
+{
+public:
+    using Consumer = std::function<void(const ReadbackFrame &)>;
+
+    struct Stats
+    {
+        uint64_t captured = 0;
+        uint64_t consumed = 0;
+        uint64_t stalls = 0;
+    };
+
+    explicit FrameReadback(Consumer consumer, size_t depth = 3);
+    ~FrameReadback();
+
+    FrameReadback(const FrameReadback &) = delete;
+    FrameReadback &operator=(const FrameReadback &) = delete;
+
+    // Calls below are made from the thread owning the GL context.
+
+    // queues a read of the colour of the bound read framebuffer, from (0, 0); waits only
+    // when every buffer of the ring is still in use
+    void capture(int width, int height);
+    // once per frame: passes finished reads on and recycles the buffers consumed since
+    void update();
+    // waits until every captured frame has been consumed
+    void finish();
+
+    const Stats &stats() const;
+
+private:
+    enum State
+    {
+        FREE,
+        READING,
+        CONSUMING,
+        CONSUMED,
+    };
+
+    struct Slot
+    {
+        GLuint buffer = 0;
+        size_t capacity = 0;
+        bool persistent = false;
+        unsigned char *mapped = nullptr; // persistent mapping, or the mapping of a CONSUMING frame
+        GLsync fence = nullptr;
+        State state = FREE;
+        ReadbackFrame frame{};
+    };
+
+    void reserve(Slot &slot, size_t size);
+    // READING -> CONSUMING; wait blocks on the fence, otherwise only a signalled one is taken
+    bool consume(Slot &slot, bool wait);
+    void recycle();
+    void drain();
+    // vars
+    Consumer m_consumer;
+    bool m_persistent;
+    std::vector<Slot> m_slots;
+    size_t m_next;                // slot the next capture goes to
+    std::deque<Slot *> m_reading; // in capture order, so fences are checked oldest first
+    Stats m_stats;
+    // guards the slot states and the queue, shared with the consumer
+    std::mutex m_mutex;
+    std::condition_variable m_returned;
+    std::deque<Slot *> m_queue; // CONSUMING slots the consumer has not seen yet
+    bool m_draining;
+};
+
+#endif // FRAME_READBACK_HPP
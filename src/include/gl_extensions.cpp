@@ -0,0 +1,71 @@
+#include "gl_extensions.hpp"
+
+#include <cstring>
+
+namespace
+{
+    glext::Extensions extensions;
+} // namespace
+
+bool glext::versionAtLeast(int major, int minor)
+{
+    return GLVersion.major > major || (GLVersion.major == major && GLVersion.minor >= minor);
+}
+
+bool glext::hasExtension(const char *name)
+{
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; i++)
+    {
+        const char *extension = reinterpret_cast<const char *>(glGetStringi(GL_EXTENSIONS, static_cast<GLuint>(i)));
+        if (extension != nullptr && std::strcmp(extension, name) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void glext::load(GLADloadproc loader)
+{
+    extensions = Extensions{};
+
+    if (versionAtLeast(4, 2) || hasExtension("GL_ARB_texture_storage"))
+    {
+        extensions.texStorage2D = reinterpret_cast<PFNGLTEXSTORAGE2DPROC>(loader("glTexStorage2D"));
+        extensions.textureStorage = extensions.texStorage2D != nullptr;
+    }
+
+    if (versionAtLeast(4, 6) || hasExtension("GL_ARB_texture_filter_anisotropic") ||
+        hasExtension("GL_EXT_texture_filter_anisotropic"))
+    {
+        extensions.anisotropy = true;
+        glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY, &extensions.maxAnisotropy);
+    }
+
+    if (versionAtLeast(4, 4) || hasExtension("GL_ARB_buffer_storage"))
+    {
+        extensions.bufferStorage = reinterpret_cast<PFNGLBUFFERSTORAGEPROC>(loader("glBufferStorage"));
+        extensions.persistentMapping = extensions.bufferStorage != nullptr;
+    }
+
+    if (versionAtLeast(4, 3) || hasExtension("GL_ARB_vertex_attrib_binding"))
+    {
+        extensions.bindVertexBuffer = reinterpret_cast<PFNGLBINDVERTEXBUFFERPROC>(loader("glBindVertexBuffer"));
+        extensions.vertexAttribFormat = reinterpret_cast<PFNGLVERTEXATTRIBFORMATPROC>(loader("glVertexAttribFormat"));
+        extensions.vertexAttribIFormat =
+            reinterpret_cast<PFNGLVERTEXATTRIBIFORMATPROC>(loader("glVertexAttribIFormat"));
+        extensions.vertexAttribBinding =
+            reinterpret_cast<PFNGLVERTEXATTRIBBINDINGPROC>(loader("glVertexAttribBinding"));
+        extensions.separateVertexFormat = extensions.bindVertexBuffer != nullptr &&
+                                          extensions.vertexAttribFormat != nullptr &&
+                                          extensions.vertexAttribIFormat != nullptr &&
+                                          extensions.vertexAttribBinding != nullptr;
+    }
+}
+
+const glext::Extensions &glext::get()
+{
+    return extensions;
+}
@@ -0,0 +1,64 @@
+#ifndef GL_EXTENSIONS_HPP
+#define GL_EXTENSIONS_HPP
+
+#include <glad/glad.h>
+
+// Entry points and enums newer than the GL 4.1 loader generated into glad/.
+// Everything here is optional: check the flag before using a function pointer.
+
+#ifndef GL_TEXTURE_IMMUTABLE_FORMAT
+#define GL_TEXTURE_IMMUTABLE_FORMAT 0x912F
+#endif
+#ifndef GL_TEXTURE_MAX_ANISOTROPY
+#define GL_TEXTURE_MAX_ANISOTROPY 0x84FE
+#endif
+#ifndef GL_MAX_TEXTURE_MAX_ANISOTROPY
+#define GL_MAX_TEXTURE_MAX_ANISOTROPY 0x84FF
+#endif
+
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+
+typedef void(APIENTRYP PFNGLTEXSTORAGE2DPROC)(GLenum target, GLsizei levels, GLenum internalformat, GLsizei width,
+                                              GLsizei height);
+typedef void(APIENTRYP PFNGLBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+typedef void(APIENTRYP PFNGLBINDVERTEXBUFFERPROC)(GLuint bindingindex, GLuint buffer, GLintptr offset, GLsizei stride);
+typedef void(APIENTRYP PFNGLVERTEXATTRIBFORMATPROC)(GLuint attribindex, GLint size, GLenum type, GLboolean normalized,
+                                                    GLuint relativeoffset);
+typedef void(APIENTRYP PFNGLVERTEXATTRIBIFORMATPROC)(GLuint attribindex, GLint size, GLenum type,
+                                                     GLuint relativeoffset);
+typedef void(APIENTRYP PFNGLVERTEXATTRIBBINDINGPROC)(GLuint attribindex, GLuint bindingindex);
+
+namespace glext
+{
+    struct Extensions
+    {
+        // GL 4.2 or ARB_texture_storage
+        bool textureStorage = false;
+        PFNGLTEXSTORAGE2DPROC texStorage2D = nullptr;
+        // GL 4.6, ARB_texture_filter_anisotropic or EXT_texture_filter_anisotropic
+        bool anisotropy = false;
+        float maxAnisotropy = 1.0f;
+        // GL 4.4 or ARB_buffer_storage, for persistently mapped buffers
+        bool persistentMapping = false;
+        PFNGLBUFFERSTORAGEPROC bufferStorage = nullptr;
+        // GL 4.3 or ARB_vertex_attrib_binding, vertex formats separate from their buffers
+        bool separateVertexFormat = false;
+        PFNGLBINDVERTEXBUFFERPROC bindVertexBuffer = nullptr;
+        PFNGLVERTEXATTRIBFORMATPROC vertexAttribFormat = nullptr;
+        PFNGLVERTEXATTRIBIFORMATPROC vertexAttribIFormat = nullptr;
+        PFNGLVERTEXATTRIBBINDINGPROC vertexAttribBinding = nullptr;
+    };
+
+    // Call once after gladLoadGLLoader, with the same loader, on the thread owning the context.
+    void load(GLADloadproc loader);
+    const Extensions &get();
+    bool hasExtension(const char *name);
+    bool versionAtLeast(int major, int minor);
+} // namespace glext
+
+#endif // GL_EXTENSIONS_HPP
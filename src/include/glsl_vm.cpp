@@ -0,0 +1,2114 @@
+#include "glsl_vm.hpp"
+#include "cpu_features.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <unordered_map>
+
+#ifdef LEARNOPENGL_X86
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    using soft::GlslShader;
+    using soft::Lanes;
+    using soft::ShaderBinding;
+
+    enum Op : uint8_t
+    {
+        MOV,
+        ADD,
+        SUB,
+        MUL,
+        DIV,
+        MAD, // a * b + c
+        MIX, // a + (b - a) * c
+        MIN,
+        MAX,
+        NEG,
+        ABS,
+        FLOOR,
+        TRUNC,
+        SQRT,
+        RSQRT,
+        // evaluated a lane at a time
+        SIN,
+        COS,
+        EXP,
+        LOG,
+        TEXTURE, // dst .. dst + 3 = texture(binding c, vec2(a, b))
+        FETCH,   // dst .. dst + 3 = texelFetch(binding c, int(a))
+    };
+
+    int operandCount(uint8_t op)
+    {
+        switch (op)
+        {
+        case ADD:
+        case SUB:
+        case MUL:
+        case DIV:
+        case MIN:
+        case MAX:
+        case TEXTURE:
+            return 2;
+        case MAD:
+        case MIX:
+            return 3;
+        default:
+            return 1;
+        }
+    }
+
+    int resultCount(uint8_t op)
+    {
+        return op == TEXTURE || op == FETCH ? 4 : 1;
+    }
+
+    // the arithmetic of every op but TEXTURE and FETCH, for folding and the lane loops
+    float evaluate(uint8_t op, float a, float b, float c)
+    {
+        switch (op)
+        {
+        case MOV:
+            return a;
+        case ADD:
+            return a + b;
+        case SUB:
+            return a - b;
+        case MUL:
+            return a * b;
+        case DIV:
+            return a / b;
+        case MAD:
+            return a * b + c;
+        case MIX:
+            return a + (b - a) * c;
+        case MIN:
+            return b < a ? b : a;
+        case MAX:
+            return a < b ? b : a;
+        case NEG:
+            return -a;
+        case ABS:
+            return std::fabs(a);
+        case FLOOR:
+            return std::floor(a);
+        case TRUNC:
+            return std::trunc(a);
+        case SQRT:
+            return std::sqrt(a);
+        case RSQRT:
+            return 1.0f / std::sqrt(a);
+        case SIN:
+            return std::sin(a);
+        case COS:
+            return std::cos(a);
+        case EXP:
+            return std::exp(a);
+        case LOG:
+            return std::log(a);
+        default:
+            return 0.0f;
+        }
+    }
+
+    // ---------------------------------------------------------------------------
+    // compiler
+
+    struct CompileError
+    {
+        int line;
+        std::string message;
+    };
+
+    struct Token
+    {
+        enum Kind
+        {
+            IDENTIFIER,
+            NUMBER,
+            SYMBOL,
+            END,
+        };
+        Kind kind;
+        std::string text;
+        int line;
+    };
+
+    std::vector<Token> tokenize(const std::string &source)
+    {
+        std::vector<Token> tokens;
+        int line = 1;
+        bool lineStart = true;
+        size_t i = 0;
+        while (i < source.size())
+        {
+            char ch = source[i];
+            if (ch == '\n')
+            {
+                line++, i++, lineStart = true;
+                continue;
+            }
+            if (std::isspace(static_cast<unsigned char>(ch)))
+            {
+                i++;
+                continue;
+            }
+            if (source.compare(i, 2, "//") == 0)
+            {
+                i = std::min(source.find('\n', i), source.size());
+                continue;
+            }
+            if (source.compare(i, 2, "/*") == 0)
+            {
+                size_t end = source.find("*/", i + 2);
+                if (end == std::string::npos)
+                {
+                    throw CompileError{line, "unterminated comment"};
+                }
+                line += static_cast<int>(std::count(source.begin() + i, source.begin() + end, '\n'));
+                i = end + 2;
+                continue;
+            }
+            if (ch == '#')
+            {
+                // #version is the only directive the project's shaders use
+                size_t end = std::min(source.find('\n', i), source.size());
+                std::string directive = source.substr(i, end - i);
+                if (!lineStart || directive.compare(0, 8, "#version") != 0)
+                {
+                    throw CompileError{line, "unsupported preprocessor directive " + directive};
+                }
+                i = end;
+                continue;
+            }
+            lineStart = false;
+            size_t start = i;
+            if (std::isalpha(static_cast<unsigned char>(ch)) || ch == '_')
+            {
+                while (i < source.size() && (std::isalnum(static_cast<unsigned char>(source[i])) || source[i] == '_'))
+                {
+                    i++;
+                }
+                tokens.push_back(Token{Token::IDENTIFIER, source.substr(start, i - start), line});
+            }
+            else if (std::isdigit(static_cast<unsigned char>(ch)) ||
+                     (ch == '.' && i + 1 < source.size() && std::isdigit(static_cast<unsigned char>(source[i + 1]))))
+            {
+                while (i < source.size() && (std::isalnum(static_cast<unsigned char>(source[i])) || source[i] == '.' ||
+                                             ((source[i] == '+' || source[i] == '-') &&
+                                              (source[i - 1] == 'e' || source[i - 1] == 'E'))))
+                {
+                    i++;
+                }
+                tokens.push_back(Token{Token::NUMBER, source.substr(start, i - start), line});
+            }
+            else
+            {
+                static const char *pairs[] = {"+=", "-=", "*=", "/=", "==", "!=", "<=", ">=", "&&", "||", "++", "--"};
+                size_t length = 1;
+                for (const char *pair : pairs)
+                {
+                    length = source.compare(i, 2, pair) == 0 ? 2 : length;
+                }
+                tokens.push_back(Token{Token::SYMBOL, source.substr(i, length), line});
+                i += length;
+            }
+        }
+        tokens.push_back(Token{Token::END, "end of file", line});
+        return tokens;
+    }
+
+    struct Type
+    {
+        enum Base
+        {
+            VOID,
+            FLOAT,
+            INT,
+            MATRIX,
+            SAMPLER_2D,
+            SAMPLER_BUFFER,
+        };
+        Base base;
+        int size; // vector components, or matrix columns (= rows)
+
+        int components() const
+        {
+            return base == MATRIX ? size * size : (base == FLOAT || base == INT) ? size : 0;
+        }
+        bool numeric() const
+        {
+            return base == FLOAT || base == INT || base == MATRIX;
+        }
+        bool operator==(const Type &other) const
+        {
+            return base == other.base && size == other.size;
+        }
+        bool operator!=(const Type &other) const
+        {
+            return !(*this == other);
+        }
+        std::string name() const
+        {
+            switch (base)
+            {
+            case VOID:
+                return "void";
+            case FLOAT:
+                return size == 1 ? "float" : "vec" + std::to_string(size);
+            case INT:
+                return size == 1 ? "int" : "ivec" + std::to_string(size);
+            case MATRIX:
+                return "mat" + std::to_string(size);
+            case SAMPLER_2D:
+                return "sampler2D";
+            default:
+                return "samplerBuffer";
+            }
+        }
+    };
+
+    bool parseType(const std::string &name, Type &type)
+    {
+        static const std::map<std::string, Type> types = {
+            {"void", {Type::VOID, 0}},          {"float", {Type::FLOAT, 1}},  {"int", {Type::INT, 1}},
+            {"vec2", {Type::FLOAT, 2}},         {"vec3", {Type::FLOAT, 3}},   {"vec4", {Type::FLOAT, 4}},
+            {"mat2", {Type::MATRIX, 2}},        {"mat3", {Type::MATRIX, 3}},  {"mat4", {Type::MATRIX, 4}},
+            {"sampler2D", {Type::SAMPLER_2D, 0}}, {"samplerBuffer", {Type::SAMPLER_BUFFER, 0}}};
+        auto found = types.find(name);
+        if (found == types.end())
+        {
+            return false;
+        }
+        type = found->second;
+        return true;
+    }
+
+    // an expression's result: one register per component, matrices column by column
+    struct Value
+    {
+        Type type;
+        std::vector<uint16_t> regs; // a sampler's binding slot in regs[0]
+        bool writable;
+    };
+
+    class Compiler
+    {
+    public:
+        Compiler(const std::string &source, GlslShader::Stage stage, std::vector<GlslShader::Instruction> &code,
+                 std::vector<GlslShader::Variable> &inputs, std::vector<GlslShader::Variable> &outputs,
+                 std::vector<GlslShader::Variable> &uniforms, std::vector<std::pair<uint16_t, float>> &constants,
+                 size_t &registerCount)
+            : m_tokens{tokenize(source)}, m_stage{stage}, m_code{code}, m_inputs{inputs}, m_outputs{outputs},
+              m_uniforms{uniforms}, m_constants{constants}, m_registerCount{registerCount}
+        {
+        }
+
+        void run()
+        {
+            m_scopes.emplace_back();
+            if (m_stage == GlslShader::VERTEX)
+            {
+                declareInterface(m_outputs, "gl_Position", Type{Type::FLOAT, 4}, -1, true);
+                declareInterface(m_inputs, "gl_VertexID", Type{Type::INT, 1}, -1, false);
+                declareInterface(m_inputs, "gl_InstanceID", Type{Type::INT, 1}, -1, false);
+            }
+            else
+            {
+                declareInterface(m_inputs, "gl_FragCoord", Type{Type::FLOAT, 4}, -1, false);
+            }
+            while (peek().kind != Token::END)
+            {
+                globalDeclaration();
+            }
+            auto main = m_functions.find("main");
+            if (main == m_functions.end() || main->second[0].params.size() != 0)
+            {
+                throw CompileError{peek().line, "no void main()"};
+            }
+            inlineCall(main->second[0], {});
+            eliminateDeadCode();
+        }
+
+    private:
+        struct Function
+        {
+            Type result;
+            std::vector<std::pair<Type, std::string>> params;
+            size_t body; // token index of the opening brace
+        };
+
+        using Scope = std::map<std::string, Value>;
+
+        struct Frame
+        {
+            Type result;
+            Value value;
+            bool returned;
+        };
+
+        // -----------------------------------------------------------------------
+        // tokens
+
+        const Token &peek(size_t ahead = 0) const
+        {
+            return m_tokens[std::min(m_at + ahead, m_tokens.size() - 1)];
+        }
+
+        const Token &next()
+        {
+            const Token &token = peek();
+            m_at = std::min(m_at + 1, m_tokens.size() - 1);
+            return token;
+        }
+
+        bool accept(const char *text)
+        {
+            if (peek().kind != Token::END && peek().text == text)
+            {
+                next();
+                return true;
+            }
+            return false;
+        }
+
+        void expect(const char *text)
+        {
+            if (!accept(text))
+            {
+                fail(std::string("expected '") + text + "' before '" + peek().text + "'");
+            }
+        }
+
+        std::string identifier()
+        {
+            if (peek().kind != Token::IDENTIFIER)
+            {
+                fail("expected a name before '" + peek().text + "'");
+            }
+            return next().text;
+        }
+
+        [[noreturn]] void fail(const std::string &message) const
+        {
+            throw CompileError{peek().line, message};
+        }
+
+        // -----------------------------------------------------------------------
+        // registers and code
+
+        uint16_t allocate(int count)
+        {
+            if (m_registerCount + count > 65535)
+            {
+                fail("the shader needs too many registers");
+            }
+            uint16_t first = static_cast<uint16_t>(m_registerCount);
+            m_registerCount += count;
+            return first;
+        }
+
+        uint16_t constant(float value)
+        {
+            uint32_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            auto found = m_constantRegs.find(bits);
+            if (found != m_constantRegs.end())
+            {
+                return found->second;
+            }
+            uint16_t reg = allocate(1);
+            m_constantRegs[bits] = reg;
+            m_constantValues[reg] = value;
+            m_constants.emplace_back(reg, value);
+            return reg;
+        }
+
+        bool isConstant(uint16_t reg, float &value) const
+        {
+            auto found = m_constantValues.find(reg);
+            if (found == m_constantValues.end())
+            {
+                return false;
+            }
+            value = found->second;
+            return true;
+        }
+
+        bool isConstant(uint16_t reg, float expected, bool) const
+        {
+            float value;
+            return isConstant(reg, value) && value == expected;
+        }
+
+        // a register holding op(a, b, c), folded when the operands are constant
+        uint16_t emit(uint8_t op, uint16_t a, uint16_t b = 0, uint16_t c = 0)
+        {
+            int count = operandCount(op);
+            float values[3];
+            bool folded = isConstant(a, values[0]) && (count < 2 || isConstant(b, values[1])) &&
+                          (count < 3 || isConstant(c, values[2]));
+            if (folded)
+            {
+                return constant(evaluate(op, values[0], count > 1 ? values[1] : 0.0f, count > 2 ? values[2] : 0.0f));
+            }
+            switch (op)
+            {
+            case ADD:
+                if (isConstant(a, 0.0f, true))
+                {
+                    return b;
+                }
+                if (isConstant(b, 0.0f, true))
+                {
+                    return a;
+                }
+                break;
+            case SUB:
+                if (isConstant(b, 0.0f, true))
+                {
+                    return a;
+                }
+                break;
+            case MUL:
+                if (isConstant(a, 1.0f, true))
+                {
+                    return b;
+                }
+                if (isConstant(b, 1.0f, true))
+                {
+                    return a;
+                }
+                if (isConstant(a, 0.0f, true) || isConstant(b, 0.0f, true))
+                {
+                    return constant(0.0f);
+                }
+                break;
+            case MAD:
+                if (isConstant(a, 0.0f, true) || isConstant(b, 0.0f, true))
+                {
+                    return c;
+                }
+                if (isConstant(a, 1.0f, true))
+                {
+                    return emit(ADD, b, c);
+                }
+                if (isConstant(b, 1.0f, true) || isConstant(c, 0.0f, true))
+                {
+                    return isConstant(c, 0.0f, true) ? emit(MUL, a, b) : emit(ADD, a, c);
+                }
+                break;
+            case MIX:
+                if (isConstant(c, 0.0f, true))
+                {
+                    return a;
+                }
+                if (isConstant(c, 1.0f, true))
+                {
+                    return b;
+                }
+                break;
+            default:
+                break;
+            }
+            uint16_t dst = allocate(1);
+            m_code.push_back(GlslShader::Instruction{op, dst, a, b, c});
+            return dst;
+        }
+
+        void move(uint16_t dst, uint16_t src)
+        {
+            m_code.push_back(GlslShader::Instruction{MOV, dst, src, 0, 0});
+        }
+
+        // -----------------------------------------------------------------------
+        // declarations
+
+        void declare(const std::string &name, const Value &value)
+        {
+            if (m_scopes.back().count(name) != 0)
+            {
+                fail("'" + name + "' is already declared");
+            }
+            m_scopes.back()[name] = value;
+        }
+
+        Value newVariable(const Type &type)
+        {
+            Value value{type, {}, true};
+            uint16_t first = allocate(type.components());
+            for (int i = 0; i < type.components(); i++)
+            {
+                value.regs.push_back(static_cast<uint16_t>(first + i));
+            }
+            return value;
+        }
+
+        void declareInterface(std::vector<GlslShader::Variable> &list, const std::string &name, const Type &type,
+                              int location, bool writable)
+        {
+            Value value = newVariable(type);
+            value.writable = writable;
+            if (type.base == Type::SAMPLER_2D || type.base == Type::SAMPLER_BUFFER)
+            {
+                value.regs = {static_cast<uint16_t>(m_samplers++)};
+            }
+            declare(name, value);
+            list.push_back(GlslShader::Variable{name, type.components(), location,
+                                                value.regs.empty() ? 0 : value.regs[0], type.base == Type::INT});
+        }
+
+        Type typeName()
+        {
+            Type type;
+            if (peek().kind != Token::IDENTIFIER || !parseType(peek().text, type))
+            {
+                fail("unsupported or unknown type '" + peek().text + "'");
+            }
+            next();
+            return type;
+        }
+
+        void globalDeclaration()
+        {
+            if (accept(";"))
+            {
+                return;
+            }
+            if (accept("precision"))
+            {
+                while (!accept(";"))
+                {
+                    next();
+                }
+                return;
+            }
+            int location = -1;
+            if (accept("layout"))
+            {
+                expect("(");
+                if (identifier() != "location")
+                {
+                    fail("only layout(location = N) is supported");
+                }
+                expect("=");
+                location = std::atoi(next().text.c_str());
+                expect(")");
+            }
+            accept("smooth");
+            if (peek().text == "flat" || peek().text == "noperspective" || peek().text == "struct")
+            {
+                fail("'" + peek().text + "' is not supported");
+            }
+            std::string storage;
+            if (peek().text == "in" || peek().text == "out" || peek().text == "uniform" || peek().text == "const")
+            {
+                storage = next().text;
+            }
+            Type type = typeName();
+            std::string name = identifier();
+            if (storage.empty() && peek().text == "(")
+            {
+                functionDefinition(type, name);
+                return;
+            }
+            if (accept("["))
+            {
+                fail("arrays are not supported");
+            }
+            if (storage == "in" || storage == "out")
+            {
+                bool samplerType = type.base == Type::SAMPLER_2D || type.base == Type::SAMPLER_BUFFER;
+                if (samplerType || type.base == Type::VOID)
+                {
+                    fail("a " + type.name() + " cannot be " + storage);
+                }
+                declareInterface(storage == "in" ? m_inputs : m_outputs, name, type, location, storage == "out");
+            }
+            else if (storage == "uniform")
+            {
+                declareInterface(m_uniforms, name, type, -1, false);
+            }
+            else
+            {
+                // a global variable, its initialiser runs before main
+                Value value = newVariable(type);
+                if (accept("="))
+                {
+                    assign(value, expression());
+                }
+                else
+                {
+                    zero(value);
+                }
+                value.writable = storage != "const";
+                declare(name, value);
+            }
+            expect(";");
+        }
+
+        void functionDefinition(const Type &result, const std::string &name)
+        {
+            Function function{result, {}, 0};
+            expect("(");
+            if (!(peek().text == "void" && peek(1).text == ")") && peek().text != ")")
+            {
+                do
+                {
+                    if (peek().text == "out" || peek().text == "inout")
+                    {
+                        fail("out parameters are not supported");
+                    }
+                    accept("in");
+                    accept("const");
+                    Type type = typeName();
+                    function.params.emplace_back(type, identifier());
+                } while (accept(","));
+            }
+            else
+            {
+                accept("void");
+            }
+            expect(")");
+            if (accept(";"))
+            {
+                return; // a prototype, the definition follows
+            }
+            function.body = m_at;
+            // skip the body, it is compiled at every call
+            expect("{");
+            for (int depth = 1; depth > 0;)
+            {
+                if (peek().kind == Token::END)
+                {
+                    fail("unterminated function " + name);
+                }
+                const std::string &text = next().text;
+                depth += text == "{" ? 1 : text == "}" ? -1 : 0;
+            }
+            m_functions[name].push_back(function);
+        }
+
+        // -----------------------------------------------------------------------
+        // statements
+
+        Value inlineCall(const Function &function, const std::vector<Value> &arguments)
+        {
+            if (m_frames.size() >= 32)
+            {
+                fail("recursion is not supported");
+            }
+            size_t resume = m_at;
+            m_scopes.emplace_back();
+            for (size_t i = 0; i < arguments.size(); i++)
+            {
+                Value parameter = newVariable(function.params[i].first);
+                assign(parameter, arguments[i]);
+                declare(function.params[i].second, parameter);
+            }
+            m_frames.push_back(Frame{function.result, Value{function.result, {}, false}, false});
+            m_at = function.body;
+            expect("{");
+            block();
+            Frame frame = m_frames.back();
+            m_frames.pop_back();
+            m_scopes.pop_back();
+            if (!frame.returned && function.result.base != Type::VOID)
+            {
+                fail("missing return");
+            }
+            m_at = resume;
+            return frame.value;
+        }
+
+        // after the opening brace, up to and including the closing one
+        void block()
+        {
+            while (!accept("}"))
+            {
+                if (peek().kind == Token::END)
+                {
+                    fail("missing '}'");
+                }
+                if (m_frames.back().returned)
+                {
+                    fail("statements after return are not supported");
+                }
+                statement();
+            }
+        }
+
+        void statement()
+        {
+            static const char *flow[] = {"if", "else", "for", "while", "do", "switch", "discard", "break", "continue"};
+            for (const char *keyword : flow)
+            {
+                if (peek().text == keyword)
+                {
+                    fail(std::string("'") + keyword + "': control flow is not supported");
+                }
+            }
+            if (accept(";"))
+            {
+                return;
+            }
+            if (accept("{"))
+            {
+                m_scopes.emplace_back();
+                block();
+                m_scopes.pop_back();
+                return;
+            }
+            if (accept("return"))
+            {
+                Frame &frame = m_frames.back();
+                if (frame.result.base != Type::VOID)
+                {
+                    Value result = newVariable(frame.result);
+                    assign(result, expression());
+                    frame.value = result;
+                }
+                frame.returned = true;
+                expect(";");
+                return;
+            }
+            Type type;
+            bool isConst = accept("const");
+            if (peek().kind == Token::IDENTIFIER && parseType(peek().text, type) && peek(1).text != "(")
+            {
+                next();
+                do
+                {
+                    std::string name = identifier();
+                    Value value = newVariable(type);
+                    if (accept("="))
+                    {
+                        assign(value, expression());
+                    }
+                    else
+                    {
+                        zero(value);
+                    }
+                    value.writable = !isConst;
+                    declare(name, value);
+                } while (accept(","));
+                expect(";");
+                return;
+            }
+            Value target = expression();
+            static const char *assignments[] = {"=", "+=", "-=", "*=", "/="};
+            for (const char *op : assignments)
+            {
+                if (accept(op))
+                {
+                    if (!target.writable)
+                    {
+                        fail("the left side cannot be assigned");
+                    }
+                    Value source = expression();
+                    assign(target, op[0] == '=' ? source : binary(op[0], target, source));
+                    break;
+                }
+            }
+            if (peek().text == "++" || peek().text == "--")
+            {
+                fail("'" + peek().text + "' is not supported");
+            }
+            expect(";");
+        }
+
+        Value convert(const Value &value, const Type &type)
+        {
+            if (value.type == type)
+            {
+                return value;
+            }
+            if (value.type.base == Type::INT && type.base == Type::FLOAT && value.type.size == type.size)
+            {
+                return Value{type, value.regs, false};
+            }
+            fail("cannot convert " + value.type.name() + " to " + type.name());
+        }
+
+        void assign(const Value &target, const Value &value)
+        {
+            Value source = convert(value, target.type);
+            // v.xy = v.yx and the like read everything before writing
+            std::vector<uint16_t> regs = source.regs;
+            for (size_t i = 0; i < regs.size(); i++)
+            {
+                for (size_t j = 0; j < target.regs.size(); j++)
+                {
+                    if (regs[i] == target.regs[j] && i != j)
+                    {
+                        for (uint16_t &reg : regs)
+                        {
+                            uint16_t copy = allocate(1);
+                            move(copy, reg);
+                            reg = copy;
+                        }
+                        i = regs.size();
+                        break;
+                    }
+                }
+            }
+            for (size_t i = 0; i < regs.size(); i++)
+            {
+                if (regs[i] != target.regs[i])
+                {
+                    move(target.regs[i], regs[i]);
+                }
+            }
+        }
+
+        void zero(const Value &target)
+        {
+            for (uint16_t reg : target.regs)
+            {
+                move(reg, constant(0.0f));
+            }
+        }
+
+        // -----------------------------------------------------------------------
+        // expressions
+
+        Value expression()
+        {
+            Value value = term();
+            while (peek().text == "+" || peek().text == "-")
+            {
+                char op = next().text[0];
+                value = binary(op, value, term());
+            }
+            if (peek().text == "?" || peek().text == "<" || peek().text == ">" || peek().text == "==" ||
+                peek().text == "!=" || peek().text == "<=" || peek().text == ">=" || peek().text == "&&" ||
+                peek().text == "||")
+            {
+                fail("'" + peek().text + "': comparisons are not supported");
+            }
+            return value;
+        }
+
+        Value term()
+        {
+            Value value = unary();
+            while (peek().text == "*" || peek().text == "/")
+            {
+                char op = next().text[0];
+                value = binary(op, value, unary());
+            }
+            return value;
+        }
+
+        Value unary()
+        {
+            if (accept("+"))
+            {
+                return readOnly(unary());
+            }
+            if (accept("-"))
+            {
+                Value value = unary();
+                return map(value, NEG);
+            }
+            if (peek().text == "!" || peek().text == "~" || peek().text == "++" || peek().text == "--")
+            {
+                fail("'" + peek().text + "' is not supported");
+            }
+            return postfix(primary());
+        }
+
+        Value readOnly(Value value)
+        {
+            value.writable = false;
+            return value;
+        }
+
+        Value map(const Value &value, uint8_t op)
+        {
+            requireNumeric(value);
+            Value result{value.type, {}, false};
+            for (uint16_t reg : value.regs)
+            {
+                result.regs.push_back(emit(op, reg));
+            }
+            return result;
+        }
+
+        void requireNumeric(const Value &value)
+        {
+            if (!value.type.numeric())
+            {
+                fail("a " + value.type.name() + " is not a number");
+            }
+        }
+
+        Value postfix(Value value)
+        {
+            for (;;)
+            {
+                if (accept("."))
+                {
+                    value = swizzle(value, identifier());
+                }
+                else if (accept("["))
+                {
+                    int index = constantIndex();
+                    expect("]");
+                    if (value.type.base == Type::MATRIX && index >= 0 && index < value.type.size)
+                    {
+                        auto begin = value.regs.begin() + index * value.type.size;
+                        value = Value{Type{Type::FLOAT, value.type.size},
+                                      std::vector<uint16_t>(begin, begin + value.type.size), value.writable};
+                    }
+                    else if ((value.type.base == Type::FLOAT || value.type.base == Type::INT) && index >= 0 &&
+                             index < value.type.size)
+                    {
+                        value = Value{Type{value.type.base, 1}, {value.regs[index]}, value.writable};
+                    }
+                    else
+                    {
+                        fail("index out of range");
+                    }
+                }
+                else
+                {
+                    return value;
+                }
+            }
+        }
+
+        int constantIndex()
+        {
+            Value index = expression();
+            float value;
+            if (index.type != Type{Type::INT, 1} || !isConstant(index.regs[0], value))
+            {
+                fail("indices must be constant ints");
+            }
+            return static_cast<int>(value);
+        }
+
+        Value swizzle(const Value &value, const std::string &fields)
+        {
+            static const char *sets[] = {"xyzw", "rgba", "stpq"};
+            if ((value.type.base != Type::FLOAT && value.type.base != Type::INT) || fields.size() > 4)
+            {
+                fail("bad swizzle ." + fields);
+            }
+            Value result{Type{value.type.base, static_cast<int>(fields.size())}, {}, value.writable};
+            for (const char *set : sets)
+            {
+                if (std::strchr(set, fields[0]) == nullptr)
+                {
+                    continue;
+                }
+                for (char field : fields)
+                {
+                    const char *at = std::strchr(set, field);
+                    int index = at == nullptr ? 4 : static_cast<int>(at - set);
+                    if (index >= value.type.size)
+                    {
+                        fail("bad swizzle ." + fields + " of a " + value.type.name());
+                    }
+                    uint16_t reg = value.regs[index];
+                    // a component twice cannot be written
+                    if (std::find(result.regs.begin(), result.regs.end(), reg) != result.regs.end())
+                    {
+                        result.writable = false;
+                    }
+                    result.regs.push_back(reg);
+                }
+                return result;
+            }
+            fail("bad swizzle ." + fields);
+        }
+
+        Value primary()
+        {
+            const Token &token = peek();
+            if (token.kind == Token::NUMBER)
+            {
+                next();
+                std::string text = token.text;
+                bool isFloat = text.find_first_of(".eEfF") != std::string::npos;
+                if (!text.empty() && (text.back() == 'f' || text.back() == 'F'))
+                {
+                    text.pop_back();
+                }
+                char *end = nullptr;
+                float number = isFloat ? std::strtof(text.c_str(), &end)
+                                       : static_cast<float>(std::strtol(text.c_str(), &end, 0));
+                if (end == nullptr || *end != '\0')
+                {
+                    fail("bad number " + token.text);
+                }
+                return Value{Type{isFloat ? Type::FLOAT : Type::INT, 1}, {constant(number)}, false};
+            }
+            if (accept("("))
+            {
+                Value value = readOnly(expression());
+                expect(")");
+                return value;
+            }
+            std::string name = identifier();
+            if (peek().text == "(")
+            {
+                next();
+                std::vector<Value> arguments;
+                if (!accept(")"))
+                {
+                    do
+                    {
+                        arguments.push_back(expression());
+                    } while (accept(","));
+                    expect(")");
+                }
+                return call(name, arguments);
+            }
+            for (auto scope = m_scopes.rbegin(); scope != m_scopes.rend(); scope++)
+            {
+                auto found = scope->find(name);
+                if (found != scope->end())
+                {
+                    return found->second;
+                }
+            }
+            fail("'" + name + "' is not declared");
+        }
+
+        // a + b, a * b and so on with GLSL's rules for scalars, vectors and matrices
+        Value binary(char op, const Value &left, const Value &right)
+        {
+            requireNumeric(left);
+            requireNumeric(right);
+            Value a = left, b = right;
+            bool integer = a.type.base == Type::INT && b.type.base == Type::INT;
+            if (!integer)
+            {
+                // ints promote to floats
+                a.type.base = a.type.base == Type::INT ? Type::FLOAT : a.type.base;
+                b.type.base = b.type.base == Type::INT ? Type::FLOAT : b.type.base;
+            }
+            if (op == '*' && a.type.base == Type::MATRIX && b.type.base == Type::MATRIX)
+            {
+                if (a.type.size != b.type.size)
+                {
+                    fail("cannot multiply " + a.type.name() + " by " + b.type.name());
+                }
+                int n = a.type.size;
+                Value result{a.type, {}, false};
+                for (int column = 0; column < n; column++)
+                {
+                    Value vector{Type{Type::FLOAT, n}, {}, false};
+                    vector.regs.assign(b.regs.begin() + column * n, b.regs.begin() + (column + 1) * n);
+                    Value product = multiply(a, vector);
+                    result.regs.insert(result.regs.end(), product.regs.begin(), product.regs.end());
+                }
+                return result;
+            }
+            if (op == '*' && a.type.base == Type::MATRIX && b.type.base == Type::FLOAT && b.type.size > 1)
+            {
+                if (a.type.size != b.type.size)
+                {
+                    fail("cannot multiply " + a.type.name() + " by " + b.type.name());
+                }
+                return multiply(a, b);
+            }
+            if (op == '*' && a.type.base == Type::FLOAT && a.type.size > 1 && b.type.base == Type::MATRIX)
+            {
+                // row vector times matrix: a dot product per column
+                if (a.type.size != b.type.size)
+                {
+                    fail("cannot multiply " + a.type.name() + " by " + b.type.name());
+                }
+                int n = b.type.size;
+                Value result{a.type, {}, false};
+                for (int column = 0; column < n; column++)
+                {
+                    uint16_t sum = emit(MUL, a.regs[0], b.regs[column * n]);
+                    for (int k = 1; k < n; k++)
+                    {
+                        sum = emit(MAD, a.regs[k], b.regs[column * n + k], sum);
+                    }
+                    result.regs.push_back(sum);
+                }
+                return result;
+            }
+            uint8_t code = op == '+' ? ADD : op == '-' ? SUB : op == '*' ? MUL : DIV;
+            Value result = componentwise(code, a, b);
+            if (integer && code == DIV)
+            {
+                result = map(result, TRUNC);
+            }
+            return result;
+        }
+
+        // matrix times column vector
+        Value multiply(const Value &matrix, const Value &vector)
+        {
+            int n = matrix.type.size;
+            Value result{Type{Type::FLOAT, n}, {}, false};
+            for (int row = 0; row < n; row++)
+            {
+                uint16_t sum = emit(MUL, matrix.regs[row], vector.regs[0]);
+                for (int column = 1; column < n; column++)
+                {
+                    sum = emit(MAD, matrix.regs[column * n + row], vector.regs[column], sum);
+                }
+                result.regs.push_back(sum);
+            }
+            return result;
+        }
+
+        // same shaped operands, or one of them a scalar
+        Value componentwise(uint8_t op, const Value &a, const Value &b, const Value *c = nullptr)
+        {
+            const Value *shape = &a;
+            for (const Value *value : {&a, &b, c})
+            {
+                if (value != nullptr && value->regs.size() > shape->regs.size())
+                {
+                    shape = value;
+                }
+            }
+            for (const Value *value : {&a, &b, c})
+            {
+                if (value != nullptr && value->regs.size() != 1 && value->type != shape->type)
+                {
+                    fail("mismatched operands " + a.type.name() + " and " + b.type.name());
+                }
+            }
+            Value result{shape->type, {}, false};
+            for (size_t i = 0; i < shape->regs.size(); i++)
+            {
+                auto at = [i](const Value &value) { return value.regs[value.regs.size() == 1 ? 0 : i]; };
+                result.regs.push_back(emit(op, at(a), at(b), c != nullptr ? at(*c) : 0));
+            }
+            return result;
+        }
+
+        Value floats(const Value &value)
+        {
+            requireNumeric(value);
+            if (value.type.base == Type::INT)
+            {
+                return Value{Type{Type::FLOAT, value.type.size}, value.regs, false};
+            }
+            return value;
+        }
+
+        uint16_t dot(const Value &a, const Value &b)
+        {
+            uint16_t sum = emit(MUL, a.regs[0], b.regs[0]);
+            for (size_t i = 1; i < a.regs.size(); i++)
+            {
+                sum = emit(MAD, a.regs[i], b.regs[i], sum);
+            }
+            return sum;
+        }
+
+        Value call(const std::string &name, std::vector<Value> arguments)
+        {
+            Type type;
+            if (parseType(name, type))
+            {
+                return construct(type, arguments);
+            }
+            auto user = m_functions.find(name);
+            if (user != m_functions.end())
+            {
+                for (const Function &function : user->second)
+                {
+                    if (function.params.size() != arguments.size())
+                    {
+                        continue;
+                    }
+                    bool matches = true;
+                    for (size_t i = 0; i < arguments.size(); i++)
+                    {
+                        const Type &want = function.params[i].first, &have = arguments[i].type;
+                        matches = matches && (want == have || (want.base == Type::FLOAT && have.base == Type::INT &&
+                                                               want.size == have.size));
+                    }
+                    if (matches)
+                    {
+                        return inlineCall(function, arguments);
+                    }
+                }
+                fail("no overload of " + name + " takes these arguments");
+            }
+            return builtin(name, arguments);
+        }
+
+        void arity(const std::string &name, const std::vector<Value> &arguments, size_t count)
+        {
+            if (arguments.size() != count)
+            {
+                fail(name + " takes " + std::to_string(count) + " arguments");
+            }
+        }
+
+        Value builtin(const std::string &name, std::vector<Value> &arguments)
+        {
+            static const std::map<std::string, uint8_t> unaryOps = {
+                {"sin", SIN},   {"cos", COS},     {"exp", EXP},   {"log", LOG},
+                {"abs", ABS},   {"floor", FLOOR}, {"trunc", TRUNC}, {"sqrt", SQRT}, {"inversesqrt", RSQRT}};
+            auto op = unaryOps.find(name);
+            if (op != unaryOps.end())
+            {
+                arity(name, arguments, 1);
+                return map(floats(arguments[0]), op->second);
+            }
+            if (name == "radians" || name == "degrees")
+            {
+                arity(name, arguments, 1);
+                float scale = name == "radians" ? 3.14159265358979f / 180.0f : 180.0f / 3.14159265358979f;
+                Value factor{Type{Type::FLOAT, 1}, {constant(scale)}, false};
+                return componentwise(MUL, floats(arguments[0]), factor);
+            }
+            if (name == "tan")
+            {
+                arity(name, arguments, 1);
+                Value angle = floats(arguments[0]);
+                return componentwise(DIV, map(angle, SIN), map(angle, COS));
+            }
+            if (name == "fract")
+            {
+                arity(name, arguments, 1);
+                Value x = floats(arguments[0]);
+                return componentwise(SUB, x, map(x, FLOOR));
+            }
+            if (name == "ceil")
+            {
+                arity(name, arguments, 1);
+                return map(map(map(floats(arguments[0]), NEG), FLOOR), NEG);
+            }
+            if (name == "pow")
+            {
+                arity(name, arguments, 2);
+                return map(componentwise(MUL, map(floats(arguments[0]), LOG), floats(arguments[1])), EXP);
+            }
+            if (name == "min" || name == "max")
+            {
+                arity(name, arguments, 2);
+                return componentwise(name == "min" ? MIN : MAX, floats(arguments[0]), floats(arguments[1]));
+            }
+            if (name == "clamp")
+            {
+                arity(name, arguments, 3);
+                Value x = floats(arguments[0]);
+                return componentwise(MIN, componentwise(MAX, x, floats(arguments[1])), floats(arguments[2]));
+            }
+            if (name == "mix")
+            {
+                arity(name, arguments, 3);
+                Value a = floats(arguments[0]), b = floats(arguments[1]), t = floats(arguments[2]);
+                return componentwise(MIX, a, b, &t);
+            }
+            if (name == "dot" || name == "length" || name == "distance" || name == "normalize")
+            {
+                bool two = name == "dot" || name == "distance";
+                arity(name, arguments, two ? 2 : 1);
+                Value a = floats(arguments[0]);
+                Value b = two ? floats(arguments[1]) : a;
+                if (a.type != b.type || a.type.base != Type::FLOAT)
+                {
+                    fail(name + " needs two vectors of one type");
+                }
+                if (name == "dot")
+                {
+                    return Value{Type{Type::FLOAT, 1}, {dot(a, b)}, false};
+                }
+                if (name == "distance")
+                {
+                    Value difference = componentwise(SUB, a, b);
+                    return Value{Type{Type::FLOAT, 1}, {emit(SQRT, dot(difference, difference))}, false};
+                }
+                uint16_t squared = dot(a, a);
+                if (name == "length")
+                {
+                    return Value{Type{Type::FLOAT, 1}, {emit(SQRT, squared)}, false};
+                }
+                Value scale{Type{Type::FLOAT, 1}, {emit(RSQRT, squared)}, false};
+                return componentwise(MUL, a, scale);
+            }
+            if (name == "cross")
+            {
+                arity(name, arguments, 2);
+                Value a = floats(arguments[0]), b = floats(arguments[1]);
+                if (a.type != Type{Type::FLOAT, 3} || b.type != a.type)
+                {
+                    fail("cross needs two vec3");
+                }
+                Value result{a.type, {}, false};
+                for (int i = 0; i < 3; i++)
+                {
+                    int j = (i + 1) % 3, k = (i + 2) % 3;
+                    result.regs.push_back(emit(SUB, emit(MUL, a.regs[j], b.regs[k]), emit(MUL, a.regs[k], b.regs[j])));
+                }
+                return result;
+            }
+            if (name == "texture")
+            {
+                arity(name, arguments, 2);
+                Value coordinates = floats(arguments[1]);
+                if (arguments[0].type.base != Type::SAMPLER_2D || coordinates.type != Type{Type::FLOAT, 2})
+                {
+                    fail("texture takes a sampler2D and a vec2");
+                }
+                return sample(TEXTURE, arguments[0].regs[0], coordinates.regs[0], coordinates.regs[1]);
+            }
+            if (name == "texelFetch")
+            {
+                arity(name, arguments, 2);
+                if (arguments[0].type.base != Type::SAMPLER_BUFFER || arguments[1].type != Type{Type::INT, 1})
+                {
+                    fail("texelFetch takes a samplerBuffer and an int");
+                }
+                return sample(FETCH, arguments[0].regs[0], arguments[1].regs[0], 0);
+            }
+            fail("unknown function " + name);
+        }
+
+        Value sample(uint8_t op, uint16_t binding, uint16_t a, uint16_t b)
+        {
+            uint16_t dst = allocate(4);
+            m_code.push_back(GlslShader::Instruction{op, dst, a, b, binding});
+            return Value{Type{Type::FLOAT, 4}, {dst, uint16_t(dst + 1), uint16_t(dst + 2), uint16_t(dst + 3)}, false};
+        }
+
+        Value construct(const Type &type, const std::vector<Value> &arguments)
+        {
+            if (!type.numeric() || arguments.empty())
+            {
+                fail("cannot construct a " + type.name());
+            }
+            for (const Value &argument : arguments)
+            {
+                requireNumeric(argument);
+            }
+            Value result{type, {}, false};
+            const Value &first = arguments[0];
+            if (type.base == Type::MATRIX && arguments.size() == 1 && first.type.base == Type::MATRIX)
+            {
+                // the other matrix's top left corner, identity beyond it
+                int n = type.size, m = first.type.size;
+                for (int column = 0; column < n; column++)
+                {
+                    for (int row = 0; row < n; row++)
+                    {
+                        result.regs.push_back(column < m && row < m ? first.regs[column * m + row]
+                                                                    : constant(column == row ? 1.0f : 0.0f));
+                    }
+                }
+                return result;
+            }
+            if (arguments.size() == 1 && first.regs.size() == 1)
+            {
+                uint16_t value = type.base == Type::INT && first.type.base != Type::INT ? emit(TRUNC, first.regs[0])
+                                                                                          : first.regs[0];
+                for (int i = 0; i < type.components(); i++)
+                {
+                    bool diagonal = type.base != Type::MATRIX || i % type.size == i / type.size;
+                    result.regs.push_back(diagonal ? value : constant(0.0f));
+                }
+                return result;
+            }
+            std::vector<uint16_t> components;
+            for (const Value &argument : arguments)
+            {
+                if (argument.type.base == Type::MATRIX && type.base != Type::MATRIX)
+                {
+                    fail("cannot build a " + type.name() + " from a matrix");
+                }
+                components.insert(components.end(), argument.regs.begin(), argument.regs.end());
+            }
+            bool truncating = arguments.size() == 1 && type.base != Type::MATRIX;
+            if (components.size() < static_cast<size_t>(type.components()) ||
+                (components.size() > static_cast<size_t>(type.components()) && !truncating))
+            {
+                fail("wrong number of components for a " + type.name());
+            }
+            components.resize(type.components());
+            for (size_t i = 0; i < components.size(); i++)
+            {
+                bool toInt = type.base == Type::INT && first.type.base != Type::INT;
+                result.regs.push_back(toInt ? emit(TRUNC, components[i]) : components[i]);
+            }
+            return result;
+        }
+
+        // -----------------------------------------------------------------------
+        // clean up
+
+        // drops instructions that do not reach an output, then renumbers the registers
+        void eliminateDeadCode()
+        {
+            std::vector<bool> live(m_registerCount, false);
+            for (const GlslShader::Variable &output : m_outputs)
+            {
+                for (int i = 0; i < output.components; i++)
+                {
+                    live[output.reg + i] = true;
+                }
+            }
+            std::vector<GlslShader::Instruction> kept;
+            for (auto at = m_code.rbegin(); at != m_code.rend(); at++)
+            {
+                const GlslShader::Instruction &instruction = *at;
+                int results = resultCount(instruction.op);
+                bool needed = false;
+                for (int i = 0; i < results; i++)
+                {
+                    needed = needed || live[instruction.dst + i];
+                    live[instruction.dst + i] = false;
+                }
+                if (!needed)
+                {
+                    continue;
+                }
+                const uint16_t operands[3] = {instruction.a, instruction.b, instruction.c};
+                for (int i = 0; i < operandCount(instruction.op); i++)
+                {
+                    live[operands[i]] = true;
+                }
+                kept.push_back(instruction);
+            }
+            std::reverse(kept.begin(), kept.end());
+            m_code = kept;
+
+            // every interface register stays so blocks remain consecutive
+            std::vector<bool> used(m_registerCount, false);
+            for (const std::vector<GlslShader::Variable> *list : {&m_inputs, &m_outputs, &m_uniforms})
+            {
+                for (const GlslShader::Variable &variable : *list)
+                {
+                    for (int i = 0; i < variable.components; i++)
+                    {
+                        used[variable.reg + i] = true;
+                    }
+                }
+            }
+            for (const GlslShader::Instruction &instruction : m_code)
+            {
+                const uint16_t operands[3] = {instruction.a, instruction.b, instruction.c};
+                for (int i = 0; i < operandCount(instruction.op); i++)
+                {
+                    used[operands[i]] = true;
+                }
+                for (int i = 0; i < resultCount(instruction.op); i++)
+                {
+                    used[instruction.dst + i] = true;
+                }
+            }
+            std::vector<uint16_t> renumber(m_registerCount, 0);
+            uint16_t count = 0;
+            for (size_t reg = 0; reg < m_registerCount; reg++)
+            {
+                renumber[reg] = count;
+                count = static_cast<uint16_t>(count + (used[reg] ? 1 : 0));
+            }
+            for (GlslShader::Instruction &instruction : m_code)
+            {
+                uint16_t *operands[3] = {&instruction.a, &instruction.b, &instruction.c};
+                for (int i = 0; i < operandCount(instruction.op); i++)
+                {
+                    *operands[i] = renumber[*operands[i]];
+                }
+                instruction.dst = renumber[instruction.dst];
+            }
+            for (std::vector<GlslShader::Variable> *list : {&m_inputs, &m_outputs, &m_uniforms})
+            {
+                for (GlslShader::Variable &variable : *list)
+                {
+                    variable.reg = variable.components > 0 ? renumber[variable.reg] : variable.reg;
+                }
+            }
+            std::vector<std::pair<uint16_t, float>> constants;
+            for (const auto &entry : m_constants)
+            {
+                if (used[entry.first])
+                {
+                    constants.emplace_back(renumber[entry.first], entry.second);
+                }
+            }
+            m_constants = constants;
+            m_registerCount = count;
+        }
+
+        // vars
+        std::vector<Token> m_tokens;
+        size_t m_at = 0;
+        GlslShader::Stage m_stage;
+        std::vector<GlslShader::Instruction> &m_code;
+        std::vector<GlslShader::Variable> &m_inputs;
+        std::vector<GlslShader::Variable> &m_outputs;
+        std::vector<GlslShader::Variable> &m_uniforms;
+        std::vector<std::pair<uint16_t, float>> &m_constants;
+        size_t &m_registerCount;
+        std::unordered_map<uint32_t, uint16_t> m_constantRegs;
+        std::unordered_map<uint16_t, float> m_constantValues;
+        std::map<std::string, std::vector<Function>> m_functions;
+        std::vector<Scope> m_scopes;
+        std::vector<Frame> m_frames;
+        int m_samplers = 0;
+    };
+
+    // ---------------------------------------------------------------------------
+    // interpreter
+
+    // TEXTURE and FETCH a lane at a time. Fragment lanes form two 2x2 quads, (0, 1, 4, 5)
+    // and (2, 3, 6, 7); differences within a quad give texture() its level of detail.
+    void sampleLanes(const GlslShader::Instruction &instruction, Lanes *r, const ShaderBinding *bindings,
+                     bool fragment)
+    {
+        const ShaderBinding &binding = bindings[instruction.c];
+        Lanes *out = r + instruction.dst;
+        float rgba[4];
+        for (int lane = 0; lane < GlslShader::LANES; lane++)
+        {
+            if (instruction.op == TEXTURE)
+            {
+                const Lanes &u = r[instruction.a], &v = r[instruction.b];
+                if (binding.texture == nullptr || binding.texture->empty())
+                {
+                    // an unbound unit reads black, as incomplete textures do
+                    rgba[0] = rgba[1] = rgba[2] = 0.0f;
+                    rgba[3] = 1.0f;
+                }
+                else
+                {
+                    float lod = 0.0f;
+                    if (fragment)
+                    {
+                        int quad = lane & 2;
+                        lod = binding.texture->lod(u.v[quad + 1] - u.v[quad], v.v[quad + 1] - v.v[quad],
+                                                   u.v[quad + 4] - u.v[quad], v.v[quad + 4] - v.v[quad]);
+                    }
+                    binding.texture->sample(u.v[lane], v.v[lane], lod, rgba);
+                }
+            }
+            else
+            {
+                float index = r[instruction.a].v[lane];
+                bool inside = binding.texels != nullptr && index >= 0.0f && index < binding.texelCount;
+                for (int c = 0; c < 4; c++)
+                {
+                    rgba[c] = inside ? binding.texels[static_cast<size_t>(index) * 4 + c] : 0.0f;
+                }
+            }
+            for (int c = 0; c < 4; c++)
+            {
+                out[c].v[lane] = rgba[c];
+            }
+        }
+    }
+
+    void executePortable(const GlslShader::Instruction *code, size_t count, Lanes *r, const ShaderBinding *bindings,
+                         bool fragment)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            const GlslShader::Instruction &in = code[i];
+            float *d = r[in.dst].v;
+            const float *a = r[in.a].v, *b = r[in.b].v, *c = r[in.c].v;
+            switch (in.op)
+            {
+            case TEXTURE:
+            case FETCH:
+                sampleLanes(in, r, bindings, fragment);
+                break;
+            case MOV:
+                std::memcpy(d, a, sizeof(Lanes));
+                break;
+            case ADD:
+                for (int lane = 0; lane < 8; lane++)
+                {
+                    d[lane] = a[lane] + b[lane];
+                }
+                break;
+            case SUB:
+                for (int lane = 0; lane < 8; lane++)
+                {
+                    d[lane] = a[lane] - b[lane];
+                }
+                break;
+            case MUL:
+                for (int lane = 0; lane < 8; lane++)
+                {
+                    d[lane] = a[lane] * b[lane];
+                }
+                break;
+            case MAD:
+                for (int lane = 0; lane < 8; lane++)
+                {
+                    d[lane] = a[lane] * b[lane] + c[lane];
+                }
+                break;
+            default:
+                for (int lane = 0; lane < 8; lane++)
+                {
+                    d[lane] = evaluate(in.op, a[lane], b[lane], c[lane]);
+                }
+                break;
+            }
+        }
+    }
+
+#ifdef LEARNOPENGL_X86
+    LEARNOPENGL_TARGET("avx2")
+    void executeAvx2(const GlslShader::Instruction *code, size_t count, Lanes *r, const ShaderBinding *bindings,
+                     bool fragment)
+    {
+        const __m256 signBit = _mm256_set1_ps(-0.0f);
+        const __m256 one = _mm256_set1_ps(1.0f);
+        for (size_t i = 0; i < count; i++)
+        {
+            const GlslShader::Instruction &in = code[i];
+            float *d = r[in.dst].v;
+            __m256 a = _mm256_load_ps(r[in.a].v);
+            switch (in.op)
+            {
+            case MOV:
+                _mm256_store_ps(d, a);
+                break;
+            case ADD:
+                _mm256_store_ps(d, _mm256_add_ps(a, _mm256_load_ps(r[in.b].v)));
+                break;
+            case SUB:
+                _mm256_store_ps(d, _mm256_sub_ps(a, _mm256_load_ps(r[in.b].v)));
+                break;
+            case MUL:
+                _mm256_store_ps(d, _mm256_mul_ps(a, _mm256_load_ps(r[in.b].v)));
+                break;
+            case DIV:
+                _mm256_store_ps(d, _mm256_div_ps(a, _mm256_load_ps(r[in.b].v)));
+                break;
+            case MAD:
+                // no fma, results match the portable path
+                _mm256_store_ps(d, _mm256_add_ps(_mm256_mul_ps(a, _mm256_load_ps(r[in.b].v)), _mm256_load_ps(r[in.c].v)));
+                break;
+            case MIX:
+            {
+                __m256 b = _mm256_load_ps(r[in.b].v);
+                _mm256_store_ps(d, _mm256_add_ps(a, _mm256_mul_ps(_mm256_sub_ps(b, a), _mm256_load_ps(r[in.c].v))));
+                break;
+            }
+            case MIN:
+                // (b < a) ? b : a, like the scalar version
+                _mm256_store_ps(d, _mm256_min_ps(_mm256_load_ps(r[in.b].v), a));
+                break;
+            case MAX:
+                _mm256_store_ps(d, _mm256_max_ps(_mm256_load_ps(r[in.b].v), a));
+                break;
+            case NEG:
+                _mm256_store_ps(d, _mm256_xor_ps(a, signBit));
+                break;
+            case ABS:
+                _mm256_store_ps(d, _mm256_andnot_ps(signBit, a));
+                break;
+            case FLOOR:
+                _mm256_store_ps(d, _mm256_floor_ps(a));
+                break;
+            case TRUNC:
+                _mm256_store_ps(d, _mm256_round_ps(a, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC));
+                break;
+            case SQRT:
+                _mm256_store_ps(d, _mm256_sqrt_ps(a));
+                break;
+            case RSQRT:
+                _mm256_store_ps(d, _mm256_div_ps(one, _mm256_sqrt_ps(a)));
+                break;
+            case TEXTURE:
+            case FETCH:
+                sampleLanes(in, r, bindings, fragment);
+                break;
+            default:
+                for (int lane = 0; lane < 8; lane++)
+                {
+                    d[lane] = evaluate(in.op, r[in.a].v[lane], r[in.b].v[lane], r[in.c].v[lane]);
+                }
+                break;
+            }
+        }
+    }
+#endif
+} // namespace
+
+namespace soft
+{
+    // -------------------------------------------------------------------------------
+    // GlslShader
+
+    bool GlslShader::compile(const std::string &source, Stage stage, const std::string &name)
+    {
+        m_stage = stage;
+        m_code.clear();
+        m_inputs.clear();
+        m_outputs.clear();
+        m_uniforms.clear();
+        m_constants.clear();
+        m_registerCount = 0;
+        try
+        {
+            Compiler compiler(source, stage, m_code, m_inputs, m_outputs, m_uniforms, m_constants, m_registerCount);
+            compiler.run();
+        }
+        catch (const CompileError &error)
+        {
+            std::cerr << name << ":" << error.line << ": " << error.message << std::endl;
+            m_code.clear();
+            m_registerCount = 0;
+            return false;
+        }
+        return true;
+    }
+
+    GlslShader::Stage GlslShader::stage() const
+    {
+        return m_stage;
+    }
+
+    const std::vector<GlslShader::Variable> &GlslShader::inputs() const
+    {
+        return m_inputs;
+    }
+
+    const std::vector<GlslShader::Variable> &GlslShader::outputs() const
+    {
+        return m_outputs;
+    }
+
+    const std::vector<GlslShader::Variable> &GlslShader::uniforms() const
+    {
+        return m_uniforms;
+    }
+
+    const GlslShader::Variable *GlslShader::find(const std::vector<Variable> &variables, const std::string &name) const
+    {
+        for (const Variable &variable : variables)
+        {
+            if (variable.name == name)
+            {
+                return &variable;
+            }
+        }
+        return nullptr;
+    }
+
+    size_t GlslShader::registerCount() const
+    {
+        return m_registerCount;
+    }
+
+    const std::vector<GlslShader::Instruction> &GlslShader::code() const
+    {
+        return m_code;
+    }
+
+    void GlslShader::initialise(std::vector<Lanes> &registers) const
+    {
+        registers.assign(m_registerCount, Lanes{});
+        for (const auto &entry : m_constants)
+        {
+            std::fill(registers[entry.first].v, registers[entry.first].v + LANES, entry.second);
+        }
+    }
+
+    void GlslShader::run(Lanes *registers, const ShaderBinding *bindings) const
+    {
+#ifdef LEARNOPENGL_X86
+        if (cpu::hasAvx2())
+        {
+            executeAvx2(m_code.data(), m_code.size(), registers, bindings, m_stage == FRAGMENT);
+            return;
+        }
+#endif
+        executePortable(m_code.data(), m_code.size(), registers, bindings, m_stage == FRAGMENT);
+    }
+
+    // -------------------------------------------------------------------------------
+    // GlslProgram
+
+    GlslProgram::GlslProgram(std::filesystem::path shaderDir) : m_shaderDir{std::move(shaderDir)}
+    {
+    }
+
+    bool GlslProgram::loadShaders(const std::string &vs, const std::string &fs)
+    {
+        std::string sources[2];
+        const std::string files[2] = {vs, fs};
+        for (int i = 0; i < 2; i++)
+        {
+            std::ifstream file(m_shaderDir / files[i]);
+            if (!file.is_open())
+            {
+                std::cerr << "Failed to open shader file: " << (m_shaderDir / files[i]).string() << std::endl;
+                return false;
+            }
+            std::stringstream stream;
+            stream << file.rdbuf();
+            sources[i] = stream.str();
+        }
+        return m_vertex.compile(sources[0], GlslShader::VERTEX, vs) &&
+               m_fragment.compile(sources[1], GlslShader::FRAGMENT, fs) && link();
+    }
+
+    bool GlslProgram::build(const std::string &vertexSource, const std::string &fragmentSource)
+    {
+        return m_vertex.compile(vertexSource, GlslShader::VERTEX, "vertex shader") &&
+               m_fragment.compile(fragmentSource, GlslShader::FRAGMENT, "fragment shader") && link();
+    }
+
+    bool GlslProgram::link()
+    {
+        m_varyings.clear();
+        int used = 0;
+        for (const GlslShader::Variable &input : m_fragment.inputs())
+        {
+            if (input.name == "gl_FragCoord")
+            {
+                continue;
+            }
+            const GlslShader::Variable *output = m_vertex.find(m_vertex.outputs(), input.name);
+            if (output == nullptr || output->components != input.components || output->integer != input.integer)
+            {
+                std::cerr << "Error: program link failed: " << input.name
+                          << " is not a matching output of the vertex shader" << std::endl;
+                return false;
+            }
+            for (int i = 0; i < input.components; i++)
+            {
+                m_varyings.push_back(Varying{output->reg + i, input.reg + i});
+            }
+            used += input.components;
+        }
+        if (used > MAX_VARYINGS)
+        {
+            std::cerr << "Error: program link failed: more than " << MAX_VARYINGS << " varying floats" << std::endl;
+            return false;
+        }
+        for (const GlslShader::Variable &input : m_vertex.inputs())
+        {
+            bool builtin = input.name.compare(0, 3, "gl_") == 0;
+            if (!builtin && (input.location < 0 || input.location >= MAX_ATTRIBUTES))
+            {
+                std::cerr << "Error: program link failed: " << input.name << " needs a layout(location) below "
+                          << MAX_ATTRIBUTES << std::endl;
+                return false;
+            }
+        }
+        m_position = m_vertex.find(m_vertex.outputs(), "gl_Position")->reg;
+        m_vertexId = m_vertex.find(m_vertex.inputs(), "gl_VertexID")->reg;
+        m_instanceId = m_vertex.find(m_vertex.inputs(), "gl_InstanceID")->reg;
+        m_fragCoord = m_fragment.find(m_fragment.inputs(), "gl_FragCoord")->reg;
+        // the first declared output is the colour attachment
+        m_color = -1;
+        m_colorComponents = 0;
+        if (!m_fragment.outputs().empty())
+        {
+            m_color = m_fragment.outputs()[0].reg;
+            m_colorComponents = std::min(m_fragment.outputs()[0].components, 4);
+        }
+        const GlslShader *stages[2] = {&m_vertex, &m_fragment};
+        for (int stage = 0; stage < 2; stage++)
+        {
+            stages[stage]->initialise(m_images[stage]);
+            size_t samplers = 0;
+            for (const GlslShader::Variable &uniform : stages[stage]->uniforms())
+            {
+                samplers += uniform.components == 0 ? 1 : 0;
+            }
+            m_bindings[stage].assign(samplers, ShaderBinding{});
+        }
+        touch();
+        return true;
+    }
+
+    void GlslProgram::touch()
+    {
+        // unique across programs, so a register cache never mistakes one for another
+        static std::atomic<uint64_t> counter{0};
+        m_revision = ++counter;
+    }
+
+    bool GlslProgram::setValues(GlslShader::Stage stage, const std::string &name, const float *values, size_t count)
+    {
+        const GlslShader &shader = stage == GlslShader::VERTEX ? m_vertex : m_fragment;
+        const GlslShader::Variable *uniform = shader.find(shader.uniforms(), name);
+        if (uniform == nullptr || uniform->components == 0)
+        {
+            return false;
+        }
+        std::vector<Lanes> &image = m_images[stage];
+        for (int i = 0; i < uniform->components && static_cast<size_t>(i) < count; i++)
+        {
+            std::fill(image[uniform->reg + i].v, image[uniform->reg + i].v + GlslShader::LANES, values[i]);
+        }
+        return true;
+    }
+
+    bool GlslProgram::setUniform(const std::string &name, const float *values, size_t count)
+    {
+        bool vertex = setValues(GlslShader::VERTEX, name, values, count);
+        bool fragment = setValues(GlslShader::FRAGMENT, name, values, count);
+        touch();
+        return vertex || fragment;
+    }
+
+    bool GlslProgram::setUniform(const std::string &name, float value)
+    {
+        return setUniform(name, &value, 1);
+    }
+
+    bool GlslProgram::setTexture(const std::string &name, const Texture *texture)
+    {
+        bool found = false;
+        const GlslShader *stages[2] = {&m_vertex, &m_fragment};
+        for (int stage = 0; stage < 2; stage++)
+        {
+            const GlslShader::Variable *uniform = stages[stage]->find(stages[stage]->uniforms(), name);
+            if (uniform != nullptr && uniform->components == 0)
+            {
+                m_bindings[stage][uniform->reg] = ShaderBinding{texture, nullptr, 0};
+                found = true;
+            }
+        }
+        touch();
+        return found;
+    }
+
+    bool GlslProgram::setBuffer(const std::string &name, const float *rgba, size_t texelCount)
+    {
+        bool found = false;
+        const GlslShader *stages[2] = {&m_vertex, &m_fragment};
+        for (int stage = 0; stage < 2; stage++)
+        {
+            const GlslShader::Variable *uniform = stages[stage]->find(stages[stage]->uniforms(), name);
+            if (uniform != nullptr && uniform->components == 0)
+            {
+                m_bindings[stage][uniform->reg] = ShaderBinding{nullptr, rgba, texelCount};
+                found = true;
+            }
+        }
+        touch();
+        return found;
+    }
+
+    const GlslShader &GlslProgram::vertexShader() const
+    {
+        return m_vertex;
+    }
+
+    const GlslShader &GlslProgram::fragmentShader() const
+    {
+        return m_fragment;
+    }
+
+    int GlslProgram::varyingCount() const
+    {
+        return static_cast<int>(m_varyings.size());
+    }
+
+    uint64_t GlslProgram::revision() const
+    {
+        return m_revision;
+    }
+
+    void GlslProgram::prepare(ShaderRegisters &registers) const
+    {
+        if (registers.program != this || registers.revision != m_revision)
+        {
+            registers.program = this;
+            registers.revision = m_revision;
+            registers.vertex = m_images[GlslShader::VERTEX];
+            registers.fragment = m_images[GlslShader::FRAGMENT];
+        }
+    }
+
+    void GlslProgram::shadeVertices(ShaderRegisters &registers, const AttributeStream *attributes, size_t first,
+                                    size_t count, int instance, float *position, float *varyings,
+                                    size_t stride) const
+    {
+        Lanes *r = registers.vertex.data();
+        for (const GlslShader::Variable &input : m_vertex.inputs())
+        {
+            if (input.location < 0)
+            {
+                continue;
+            }
+            const AttributeStream &stream = attributes[input.location];
+            for (size_t lane = 0; lane < static_cast<size_t>(GlslShader::LANES); lane++)
+            {
+                const float *source = nullptr;
+                if (stream.data != nullptr && lane < count)
+                {
+                    source = reinterpret_cast<const float *>(reinterpret_cast<const unsigned char *>(stream.data) +
+                                                             (first + lane) * stream.stride);
+                }
+                for (int c = 0; c < input.components; c++)
+                {
+                    // missing components read as (0, 0, 0, 1), like glVertexAttribPointer
+                    float fallback = c == 3 ? 1.0f : 0.0f;
+                    r[input.reg + c].v[lane] = source != nullptr && c < stream.components ? source[c] : fallback;
+                }
+            }
+        }
+        for (int lane = 0; lane < GlslShader::LANES; lane++)
+        {
+            r[m_vertexId].v[lane] = static_cast<float>(first + lane);
+            r[m_instanceId].v[lane] = static_cast<float>(instance);
+        }
+        m_vertex.run(r, m_bindings[GlslShader::VERTEX].data());
+        for (size_t lane = 0; lane < count; lane++)
+        {
+            float *p = reinterpret_cast<float *>(reinterpret_cast<unsigned char *>(position) + lane * stride);
+            float *v = reinterpret_cast<float *>(reinterpret_cast<unsigned char *>(varyings) + lane * stride);
+            for (int c = 0; c < 4; c++)
+            {
+                p[c] = r[m_position + c].v[lane];
+            }
+            for (size_t k = 0; k < m_varyings.size(); k++)
+            {
+                v[k] = r[m_varyings[k].vertexReg].v[lane];
+            }
+        }
+    }
+
+    void GlslProgram::shadeFragments(ShaderRegisters &registers, const Lanes *varyings, const Lanes *fragCoord,
+                                     Lanes *color) const
+    {
+        Lanes *r = registers.fragment.data();
+        for (size_t k = 0; k < m_varyings.size(); k++)
+        {
+            r[m_varyings[k].fragmentReg] = varyings[k];
+        }
+        for (int c = 0; c < 4; c++)
+        {
+            r[m_fragCoord + c] = fragCoord[c];
+        }
+        m_fragment.run(r, m_bindings[GlslShader::FRAGMENT].data());
+        for (int c = 0; c < 4; c++)
+        {
+            if (c < m_colorComponents)
+            {
+                color[c] = r[m_color + c];
+            }
+            else
+            {
+                std::fill(color[c].v, color[c].v + GlslShader::LANES, c == 3 ? 1.0f : 0.0f);
+            }
+        }
+    }
+} // namespace soft
@@ -0,0 +1,177 @@
+#ifndef GLSL_VM_HPP
+#define GLSL_VM_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "soft_raster.hpp"
+
+// Runs the project's GLSL shaders on the CPU, for soft::Rasterizer. Shaders compile to
+// bytecode for a register machine whose registers each hold one float component of
+// eight invocations, so every instruction shades eight vertices or a 4x2 block of
+// pixels at once (AVX2 where the CPU has it). Vectors and matrices are split into
+// components at compile time, user functions are inlined, constants folded and dead
+// code dropped.
+//
+// The language is the GLSL 330 subset the examples use: in / out / uniform and
+// layout(location) declarations, float, int, vec2-4, mat2-4, sampler2D and
+// samplerBuffer, arithmetic with GLSL's vector and matrix rules, constructors,
+// swizzles, constant indices, user functions, texture(), texelFetch() on buffers and
+// the common maths built-ins (mix, clamp, dot, normalize, sin, ...). There is no
+// control flow (if, loops, discard) and no comparisons; such shaders fail to compile
+// with a message.
+namespace soft
+{
+    // a component of eight invocations; fragment lanes 0-3 are the lower pixel row
+    struct alignas(32) Lanes
+    {
+        float v[8];
+    };
+
+    // what a sampler uniform reads: a texture for sampler2D, RGBA32F texels for samplerBuffer
+    struct ShaderBinding
+    {
+        const Texture *texture = nullptr;
+        const float *texels = nullptr;
+        size_t texelCount = 0;
+    };
+
+    class GlslShader
+    {
+    public:
+        static const int LANES = 8;
+
+        enum Stage
+        {
+            VERTEX,
+            FRAGMENT,
+        };
+
+        // a variable of the interface, or gl_Position / gl_VertexID / gl_InstanceID / gl_FragCoord
+        struct Variable
+        {
+            std::string name;
+            int components; // 1-4 for scalars and vectors, 4 / 9 / 16 for matrices, 0 for samplers
+            int location;   // layout(location = N), otherwise -1
+            int reg;        // first of components consecutive registers; the binding slot of a sampler
+            bool integer;
+        };
+
+        struct Instruction
+        {
+            uint8_t op;
+            uint16_t dst;
+            uint16_t a;
+            uint16_t b;
+            uint16_t c;
+        };
+
+        // errors go to std::cerr as name:line: message
+        bool compile(const std::string &source, Stage stage, const std::string &name = "shader");
+
+        Stage stage() const;
+        const std::vector<Variable> &inputs() const;
+        const std::vector<Variable> &outputs() const;
+        const std::vector<Variable> &uniforms() const;
+        const Variable *find(const std::vector<Variable> &variables, const std::string &name) const;
+        size_t registerCount() const;
+        const std::vector<Instruction> &code() const;
+
+        // sizes a register file and fills in the constants, everything else zero
+        void initialise(std::vector<Lanes> &registers) const;
+        // runs the program once over all eight lanes; bindings by sampler slot
+        void run(Lanes *registers, const ShaderBinding *bindings) const;
+
+    private:
+        // vars
+        Stage m_stage = VERTEX;
+        std::vector<Instruction> m_code;
+        std::vector<Variable> m_inputs;
+        std::vector<Variable> m_outputs;
+        std::vector<Variable> m_uniforms;
+        std::vector<std::pair<uint16_t, float>> m_constants;
+        size_t m_registerCount = 0;
+    };
+
+    class GlslProgram;
+
+    // One thread's copy of a program's registers, refreshed by GlslProgram::prepare when
+    // the program or its uniforms change.
+    struct ShaderRegisters
+    {
+        const GlslProgram *program = nullptr;
+        uint64_t revision = 0;
+        std::vector<Lanes> vertex;
+        std::vector<Lanes> fragment;
+    };
+
+    // A vertex and a fragment shader linked by varying names, with uniform values and
+    // sampler bindings; the CPU counterpart of ShaderProgram.
+    class GlslProgram
+    {
+    public:
+        explicit GlslProgram(std::filesystem::path shaderDir = {});
+
+        GlslProgram(const GlslProgram &) = delete;
+        GlslProgram &operator=(const GlslProgram &) = delete;
+
+        // files in the shader directory, like ShaderProgram::loadShaders
+        bool loadShaders(const std::string &vs, const std::string &fs);
+        bool build(const std::string &vertexSource, const std::string &fragmentSource);
+
+        // uniforms are shared by name between the stages; false when neither has it.
+        // Matrices are column major, ints and floats alike are passed as floats.
+        bool setUniform(const std::string &name, const float *values, size_t count);
+        bool setUniform(const std::string &name, float value);
+        bool setTexture(const std::string &name, const Texture *texture);
+        bool setBuffer(const std::string &name, const float *rgba, size_t texelCount);
+
+        const GlslShader &vertexShader() const;
+        const GlslShader &fragmentShader() const;
+        // floats interpolated between the stages
+        int varyingCount() const;
+        // changes whenever uniforms or bindings do
+        uint64_t revision() const;
+
+        void prepare(ShaderRegisters &registers) const;
+        // Shades vertices first .. first + count - 1 (count <= 8) of an instance into
+        // position + lane * stride (gl_Position) and varyings + lane * stride
+        // (varyingCount() floats), strides in bytes.
+        void shadeVertices(ShaderRegisters &registers, const AttributeStream *attributes, size_t first, size_t count,
+                           int instance, float *position, float *varyings, size_t stride) const;
+        // Shades a 4x2 block: varyings holds varyingCount() perspective divided values,
+        // fragCoord gl_FragCoord's four components; color receives the first output
+        void shadeFragments(ShaderRegisters &registers, const Lanes *varyings, const Lanes *fragCoord,
+                            Lanes *color) const;
+
+    private:
+        bool link();
+        bool setValues(GlslShader::Stage stage, const std::string &name, const float *values, size_t count);
+        void touch();
+
+        struct Varying
+        {
+            int vertexReg;
+            int fragmentReg;
+        };
+        // vars
+        std::filesystem::path m_shaderDir;
+        GlslShader m_vertex;
+        GlslShader m_fragment;
+        std::vector<Lanes> m_images[2];
+        std::vector<ShaderBinding> m_bindings[2];
+        std::vector<Varying> m_varyings;
+        int m_position = -1;
+        int m_vertexId = -1;
+        int m_instanceId = -1;
+        int m_fragCoord = -1;
+        int m_color = -1;
+        int m_colorComponents = 0;
+        uint64_t m_revision = 0;
+    };
+} // namespace soft
+
+#endif // GLSL_VM_HPP
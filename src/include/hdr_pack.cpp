@@ -0,0 +1,338 @@
+#include "hdr_pack.hpp"
+#include "cpu_features.hpp"
+#include <algorithm>
+#include <cstring>
+
+#ifdef LEARNOPENGL_X86
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    const float RGB9E5_MAX = 65408.0f;   // (511 / 512) * 2^16
+    const float FLOAT11_MAX = 65024.0f;  // (2 - 2^-6) * 2^15
+    const float FLOAT10_MAX = 64512.0f;  // (2 - 2^-5) * 2^15
+
+    uint32_t floatBits(float v)
+    {
+        uint32_t bits;
+        std::memcpy(&bits, &v, sizeof(bits));
+        return bits;
+    }
+
+    float bitsFloat(uint32_t bits)
+    {
+        float v;
+        std::memcpy(&v, &bits, sizeof(v));
+        return v;
+    }
+
+    // half bits -> 11 / 10 bit unsigned float, round to nearest even on the dropped mantissa bits
+    uint32_t halfToFloat11(uint32_t h)
+    {
+        return (h + 7 + ((h >> 4) & 1)) >> 4;
+    }
+
+    uint32_t halfToFloat10(uint32_t h)
+    {
+        return (h + 15 + ((h >> 5) & 1)) >> 5;
+    }
+} // namespace
+
+// ---------------------------------------------------------------------------
+// scalar reference
+
+uint16_t hdr::scalar::floatToHalf(float value)
+{
+    uint32_t x = floatBits(value);
+    uint32_t sign = (x >> 16) & 0x8000;
+    x &= 0x7FFFFFFF;
+    uint32_t h;
+    if (x > 0x7F800000)
+    {
+        h = 0x7E00 | ((x >> 13) & 0x3FF); // quiet NaN, payload kept
+    }
+    else if (x >= 0x47800000)
+    {
+        h = 0x7C00; // 65536 and up, infinity
+    }
+    else if (x < 0x38800000)
+    {
+        // below 2^-14 the result is denormal: let the FPU round by adding a magic number
+        // that lines the half's denormal mantissa up with the float's
+        const uint32_t magic = (127 - 15 + 23 - 10 + 1) << 23;
+        h = floatBits(bitsFloat(x) + bitsFloat(magic)) - magic;
+    }
+    else
+    {
+        // rebias the exponent and round the 13 dropped mantissa bits to nearest even;
+        // a carry out of the mantissa correctly bumps the exponent (up to infinity)
+        uint32_t odd = (x >> 13) & 1;
+        x += ((15u - 127u) << 23) + 0xFFF + odd;
+        h = x >> 13;
+    }
+    return static_cast<uint16_t>(h | sign);
+}
+
+float hdr::scalar::halfToFloat(uint16_t value)
+{
+    uint32_t sign = static_cast<uint32_t>(value & 0x8000) << 16;
+    uint32_t exponent = (value >> 10) & 0x1F;
+    uint32_t mantissa = value & 0x3FF;
+    if (exponent == 0x1F)
+    {
+        return bitsFloat(sign | 0x7F800000 | (mantissa << 13));
+    }
+    if (exponent == 0)
+    {
+        // denormal: mantissa * 2^-24
+        float v = static_cast<float>(mantissa) * (1.0f / 16777216.0f);
+        return sign ? -v : v;
+    }
+    return bitsFloat(sign | ((exponent + 127 - 15) << 23) | (mantissa << 13));
+}
+
+uint32_t hdr::scalar::packRgb9e5(float r, float g, float b)
+{
+    // EXT_texture_shared_exponent, with float maths laid out like the AVX2 version
+    r = r > 0.0f ? std::min(r, RGB9E5_MAX) : 0.0f;
+    g = g > 0.0f ? std::min(g, RGB9E5_MAX) : 0.0f;
+    b = b > 0.0f ? std::min(b, RGB9E5_MAX) : 0.0f;
+    float maxc = std::max(r, std::max(g, b));
+    int floorLog2 = static_cast<int>((floatBits(maxc) >> 23) & 0xFF) - 127;
+    int exponent = std::max(-16, floorLog2) + 16;
+    float scale = bitsFloat(static_cast<uint32_t>(24 - exponent + 127) << 23);
+    if (static_cast<int>(maxc * scale + 0.5f) == 512)
+    {
+        exponent++;
+        scale *= 0.5f;
+    }
+    uint32_t rs = static_cast<uint32_t>(r * scale + 0.5f);
+    uint32_t gs = static_cast<uint32_t>(g * scale + 0.5f);
+    uint32_t bs = static_cast<uint32_t>(b * scale + 0.5f);
+    return rs | gs << 9 | bs << 18 | static_cast<uint32_t>(exponent) << 27;
+}
+
+uint32_t hdr::scalar::packR11G11B10(float r, float g, float b)
+{
+    r = r > 0.0f ? std::min(r, FLOAT11_MAX) : 0.0f;
+    g = g > 0.0f ? std::min(g, FLOAT11_MAX) : 0.0f;
+    b = b > 0.0f ? std::min(b, FLOAT10_MAX) : 0.0f;
+    return halfToFloat11(floatToHalf(r)) | halfToFloat11(floatToHalf(g)) << 11 | halfToFloat10(floatToHalf(b)) << 22;
+}
+
+void hdr::scalar::floatToHalf(const float *src, uint16_t *dst, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        dst[i] = floatToHalf(src[i]);
+    }
+}
+
+void hdr::scalar::packRgb9e5(const float *src, int channels, uint32_t *dst, size_t count)
+{
+    for (size_t i = 0; i < count; i++, src += channels)
+    {
+        dst[i] = packRgb9e5(src[0], src[1], src[2]);
+    }
+}
+
+void hdr::scalar::packR11G11B10(const float *src, int channels, uint32_t *dst, size_t count)
+{
+    for (size_t i = 0; i < count; i++, src += channels)
+    {
+        dst[i] = packR11G11B10(src[0], src[1], src[2]);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// F16C / AVX2 kernels
+
+namespace
+{
+#ifdef LEARNOPENGL_X86
+    LEARNOPENGL_TARGET("avx,f16c")
+    size_t floatToHalfF16c(const float *src, uint16_t *dst, size_t count)
+    {
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), h);
+        }
+        return i;
+    }
+
+    LEARNOPENGL_TARGET("avx,f16c")
+    size_t halfToFloatF16c(const uint16_t *src, float *dst, size_t count)
+    {
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+            _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(h));
+        }
+        return i;
+    }
+
+    // Loads 8 texels and splits them into r, g and b vectors. For 4 channels the
+    // in-lane transpose leaves the texels in the order 0 2 4 6 1 3 5 7, `order`
+    // returns the permutation that puts packed results back in memory order.
+    LEARNOPENGL_TARGET("avx2")
+    void loadRgb8(const float *src, int channels, __m256 &r, __m256 &g, __m256 &b, __m256i &order)
+    {
+        if (channels == 3)
+        {
+            __m256 a = _mm256_loadu_ps(src);
+            __m256 m = _mm256_loadu_ps(src + 8);
+            __m256 c = _mm256_loadu_ps(src + 16);
+            // a = r0 g0 b0 r1 g1 b1 r2 g2, m = b2 r3 g3 b3 r4 g4 b4 r5, c = g5 b5 r6 g6 b6 r7 g7 b7
+            __m256 rr = _mm256_blend_ps(_mm256_blend_ps(a, m, 0x92), c, 0x24);
+            __m256 gg = _mm256_blend_ps(_mm256_blend_ps(a, m, 0x24), c, 0x49);
+            __m256 bb = _mm256_blend_ps(_mm256_blend_ps(a, m, 0x49), c, 0x92);
+            r = _mm256_permutevar8x32_ps(rr, _mm256_setr_epi32(0, 3, 6, 1, 4, 7, 2, 5));
+            g = _mm256_permutevar8x32_ps(gg, _mm256_setr_epi32(1, 4, 7, 2, 5, 0, 3, 6));
+            b = _mm256_permutevar8x32_ps(bb, _mm256_setr_epi32(2, 5, 0, 3, 6, 1, 4, 7));
+            order = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        }
+        else
+        {
+            __m256 p0 = _mm256_loadu_ps(src);
+            __m256 p1 = _mm256_loadu_ps(src + 8);
+            __m256 p2 = _mm256_loadu_ps(src + 16);
+            __m256 p3 = _mm256_loadu_ps(src + 24);
+            __m256 t0 = _mm256_unpacklo_ps(p0, p1);
+            __m256 t1 = _mm256_unpackhi_ps(p0, p1);
+            __m256 t2 = _mm256_unpacklo_ps(p2, p3);
+            __m256 t3 = _mm256_unpackhi_ps(p2, p3);
+            r = _mm256_shuffle_ps(t0, t2, 0x44);
+            g = _mm256_shuffle_ps(t0, t2, 0xEE);
+            b = _mm256_shuffle_ps(t1, t3, 0x44);
+            order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+        }
+    }
+
+    LEARNOPENGL_TARGET("avx2")
+    __m256 clampChannel(__m256 v, float maximum)
+    {
+        // max_ps returns its second operand for NaN, so NaN lands on 0 like in the scalar code
+        return _mm256_min_ps(_mm256_max_ps(v, _mm256_setzero_ps()), _mm256_set1_ps(maximum));
+    }
+
+    LEARNOPENGL_TARGET("avx2")
+    size_t packRgb9e5Avx2(const float *src, int channels, uint32_t *dst, size_t count)
+    {
+        const __m256 half = _mm256_set1_ps(0.5f);
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m256 r, g, b;
+            __m256i order;
+            loadRgb8(src + i * channels, channels, r, g, b, order);
+            r = clampChannel(r, RGB9E5_MAX);
+            g = clampChannel(g, RGB9E5_MAX);
+            b = clampChannel(b, RGB9E5_MAX);
+            __m256 maxc = _mm256_max_ps(r, _mm256_max_ps(g, b));
+
+            __m256i floorLog2 = _mm256_sub_epi32(_mm256_srli_epi32(_mm256_castps_si256(maxc), 23), _mm256_set1_epi32(127));
+            __m256i exponent = _mm256_add_epi32(_mm256_max_epi32(floorLog2, _mm256_set1_epi32(-16)), _mm256_set1_epi32(16));
+            __m256 scale = _mm256_castsi256_ps(
+                _mm256_slli_epi32(_mm256_sub_epi32(_mm256_set1_epi32(24 + 127), exponent), 23));
+            __m256i maxs = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(maxc, scale), half));
+            __m256i bump = _mm256_cmpeq_epi32(maxs, _mm256_set1_epi32(512));
+            exponent = _mm256_sub_epi32(exponent, bump); // bump is -1 where set
+            scale = _mm256_blendv_ps(scale, _mm256_mul_ps(scale, half), _mm256_castsi256_ps(bump));
+
+            __m256i rs = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(r, scale), half));
+            __m256i gs = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(g, scale), half));
+            __m256i bs = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(b, scale), half));
+            __m256i packed = _mm256_or_si256(_mm256_or_si256(rs, _mm256_slli_epi32(gs, 9)),
+                                             _mm256_or_si256(_mm256_slli_epi32(bs, 18), _mm256_slli_epi32(exponent, 27)));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), _mm256_permutevar8x32_epi32(packed, order));
+        }
+        return i;
+    }
+
+    // half bits (as 32 bit lanes) -> unsigned float with `dropped` fewer mantissa bits, round to nearest even
+    LEARNOPENGL_TARGET("avx2")
+    __m256i narrowHalf(__m256i h, int dropped)
+    {
+        __m256i lsb = _mm256_and_si256(_mm256_srli_epi32(h, dropped), _mm256_set1_epi32(1));
+        __m256i rounded = _mm256_add_epi32(_mm256_add_epi32(h, _mm256_set1_epi32((1 << (dropped - 1)) - 1)), lsb);
+        return _mm256_srli_epi32(rounded, dropped);
+    }
+
+    LEARNOPENGL_TARGET("avx2,f16c")
+    size_t packR11G11B10Avx2(const float *src, int channels, uint32_t *dst, size_t count)
+    {
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m256 r, g, b;
+            __m256i order;
+            loadRgb8(src + i * channels, channels, r, g, b, order);
+            __m256i hr = _mm256_cvtepu16_epi32(_mm256_cvtps_ph(clampChannel(r, FLOAT11_MAX), _MM_FROUND_TO_NEAREST_INT));
+            __m256i hg = _mm256_cvtepu16_epi32(_mm256_cvtps_ph(clampChannel(g, FLOAT11_MAX), _MM_FROUND_TO_NEAREST_INT));
+            __m256i hb = _mm256_cvtepu16_epi32(_mm256_cvtps_ph(clampChannel(b, FLOAT10_MAX), _MM_FROUND_TO_NEAREST_INT));
+            __m256i packed = _mm256_or_si256(_mm256_or_si256(narrowHalf(hr, 4), _mm256_slli_epi32(narrowHalf(hg, 4), 11)),
+                                             _mm256_slli_epi32(narrowHalf(hb, 5), 22));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), _mm256_permutevar8x32_epi32(packed, order));
+        }
+        return i;
+    }
+#endif
+} // namespace
+
+// ---------------------------------------------------------------------------
+// dispatching entry points
+
+void hdr::floatToHalf(const float *src, uint16_t *dst, size_t count)
+{
+    size_t done = 0;
+#ifdef LEARNOPENGL_X86
+    if (cpu::hasF16c())
+    {
+        done = floatToHalfF16c(src, dst, count);
+    }
+#endif
+    scalar::floatToHalf(src + done, dst + done, count - done);
+}
+
+void hdr::halfToFloat(const uint16_t *src, float *dst, size_t count)
+{
+    size_t done = 0;
+#ifdef LEARNOPENGL_X86
+    if (cpu::hasF16c())
+    {
+        done = halfToFloatF16c(src, dst, count);
+    }
+#endif
+    for (size_t i = done; i < count; i++)
+    {
+        dst[i] = scalar::halfToFloat(src[i]);
+    }
+}
+
+void hdr::packRgb9e5(const float *src, int channels, uint32_t *dst, size_t count)
+{
+    size_t done = 0;
+#ifdef LEARNOPENGL_X86
+    if (cpu::hasAvx2())
+    {
+        done = packRgb9e5Avx2(src, channels, dst, count);
+    }
+#endif
+    scalar::packRgb9e5(src + done * channels, channels, dst + done, count - done);
+}
+
+void hdr::packR11G11B10(const float *src, int channels, uint32_t *dst, size_t count)
+{
+    size_t done = 0;
+#ifdef LEARNOPENGL_X86
+    if (cpu::hasAvx2() && cpu::hasF16c())
+    {
+        done = packR11G11B10Avx2(src, channels, dst, count);
+    }
+#endif
+    scalar::packR11G11B10(src + done * channels, channels, dst + done, count - done);
+}
@@ -0,0 +1,36 @@
+#ifndef HDR_PACK_HPP
+#define HDR_PACK_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+// Float -> compact GPU formats for lighting data (environment maps, lightmaps).
+//   half:       GL_RGBA16F etc., 2 bytes per channel
+//   rgb9e5:     GL_RGB9_E5, 4 bytes per texel, 9 bit mantissas with a shared exponent
+//   r11g11b10:  GL_R11F_G11F_B10F, 4 bytes per texel, unsigned 6/6/5 bit mantissa floats
+// Kernels use F16C and AVX2 when the CPU has them; hdr::scalar holds the reference
+// versions, which produce bit identical results.
+namespace hdr
+{
+    // round to nearest even, overflow to infinity, NaNs stay NaN (what F16C does)
+    void floatToHalf(const float *src, uint16_t *dst, size_t count);
+    void halfToFloat(const uint16_t *src, float *dst, size_t count);
+    // count texels of `channels` (3 or 4) floats each, alpha is dropped.
+    // Negative values and NaN become 0, values above the largest finite code clamp to it.
+    void packRgb9e5(const float *src, int channels, uint32_t *dst, size_t count);
+    // goes through half precision, so channels are rounded twice (to 10, then to 6/5 bits)
+    void packR11G11B10(const float *src, int channels, uint32_t *dst, size_t count);
+
+    namespace scalar
+    {
+        uint16_t floatToHalf(float value);
+        float halfToFloat(uint16_t value);
+        uint32_t packRgb9e5(float r, float g, float b);
+        uint32_t packR11G11B10(float r, float g, float b);
+        void floatToHalf(const float *src, uint16_t *dst, size_t count);
+        void packRgb9e5(const float *src, int channels, uint32_t *dst, size_t count);
+        void packR11G11B10(const float *src, int channels, uint32_t *dst, size_t count);
+    } // namespace scalar
+} // namespace hdr
+
+#endif // HDR_PACK_HPP
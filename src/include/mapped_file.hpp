@@ -0,0 +1,121 @@
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define LEARNOPENGL_HAS_MMAP 1
+#endif
+
+// Read-only view of a whole file. Uses mmap where available (one open/fstat/mmap
+// instead of a stream of small reads) and falls back to reading into memory.
+class MappedFile
+{
+public:
+    MappedFile() : m_data{nullptr}, m_size{0}, m_mapped{false} {};
+    explicit MappedFile(const std::filesystem::path &path) : MappedFile() { open(path); };
+    ~MappedFile() { close(); };
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    MappedFile(MappedFile &&other) noexcept : MappedFile() { *this = std::move(other); };
+    MappedFile &operator=(MappedFile &&other) noexcept
+    {
+        if (this != &other)
+        {
+            close();
+            m_data = other.m_data;
+            m_size = other.m_size;
+            m_mapped = other.m_mapped;
+            m_fallback.swap(other.m_fallback);
+            other.m_data = nullptr;
+            other.m_size = 0;
+            other.m_mapped = false;
+        }
+        return *this;
+    };
+
+    bool open(const std::filesystem::path &path)
+    {
+        close();
+#ifdef LEARNOPENGL_HAS_MMAP
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            return false;
+        }
+        struct stat info;
+        if (fstat(fd, &info) == 0 && info.st_size > 0)
+        {
+            void *p = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED)
+            {
+                m_data = static_cast<const unsigned char *>(p);
+                m_size = static_cast<size_t>(info.st_size);
+                m_mapped = true;
+                // decoders read front to back, let the kernel read ahead aggressively
+                madvise(p, m_size, MADV_SEQUENTIAL);
+                ::close(fd);
+                return true;
+            }
+        }
+        ::close(fd);
+#endif
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file.is_open())
+        {
+            return false;
+        }
+        m_fallback.resize(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        file.read(reinterpret_cast<char *>(m_fallback.data()), static_cast<std::streamsize>(m_fallback.size()));
+        m_data = m_fallback.data();
+        m_size = m_fallback.size();
+        return static_cast<bool>(file);
+    };
+
+    void close()
+    {
+#ifdef LEARNOPENGL_HAS_MMAP
+        if (m_mapped)
+        {
+            munmap(const_cast<unsigned char *>(m_data), m_size);
+        }
+#endif
+        m_fallback.clear();
+        m_data = nullptr;
+        m_size = 0;
+        m_mapped = false;
+    };
+
+    // for files read in scattered pieces (tiles, pages) rather than front to back
+    void adviseRandom()
+    {
+#ifdef LEARNOPENGL_HAS_MMAP
+        if (m_mapped)
+        {
+            madvise(const_cast<unsigned char *>(m_data), m_size, MADV_RANDOM);
+        }
+#endif
+    };
+
+    bool isOpen() const { return m_data != nullptr; };
+    const unsigned char *data() const { return m_data; };
+    size_t size() const { return m_size; };
+
+private:
+    // vars
+    const unsigned char *m_data;
+    size_t m_size;
+    bool m_mapped;
+    std::vector<unsigned char> m_fallback;
+};
+
+#endif // MAPPED_FILE_HPP
@@ -0,0 +1,521 @@
+#include "mesh_cache.hpp"
+#include "gl_extensions.hpp"
+#include "mesh_optimizer.hpp"
+#include "staging_buffer.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace
+{
+    size_t alignUp(size_t value)
+    {
+        return (value + mesh::CACHE_ALIGNMENT - 1) & ~(mesh::CACHE_ALIGNMENT - 1);
+    }
+
+    uint64_t mix(uint64_t h)
+    {
+        h ^= h >> 33;
+        h *= 0xFF51AFD7ED558CCDull;
+        h ^= h >> 33;
+        h *= 0xC4CEB9FE1A85EC53ull;
+        h ^= h >> 33;
+        return h;
+    }
+
+    // four independent multiply-rotate lanes over 8 byte words, folded at the end
+    uint64_t hashBytes(const unsigned char *data, size_t size, uint64_t seed)
+    {
+        const uint64_t PRIME1 = 0x9E3779B185EBCA87ull, PRIME2 = 0xC2B2AE3D27D4EB4Full;
+        uint64_t lanes[4] = {seed + PRIME1, seed + PRIME2, seed, seed - PRIME1};
+        size_t i = 0;
+        for (; i + 32 <= size; i += 32)
+        {
+            for (int k = 0; k < 4; k++)
+            {
+                uint64_t word;
+                std::memcpy(&word, data + i + k * 8, 8);
+                lanes[k] += word * PRIME2;
+                lanes[k] = (lanes[k] << 31) | (lanes[k] >> 33);
+                lanes[k] *= PRIME1;
+            }
+        }
+        uint64_t h = size;
+        for (uint64_t lane : lanes)
+        {
+            h = mix(h ^ lane);
+        }
+        for (; i < size; i++)
+        {
+            h = (h ^ data[i]) * 0x100000001B3ull;
+        }
+        return mix(h);
+    }
+
+    bool inside(uint64_t offset, uint64_t size, uint64_t fileSize)
+    {
+        return offset <= fileSize && size <= fileSize - offset && offset % mesh::CACHE_ALIGNMENT == 0;
+    }
+
+    void writePadding(std::ofstream &out, size_t to)
+    {
+        static const char zeros[mesh::CACHE_ALIGNMENT] = {};
+        size_t at = static_cast<size_t>(out.tellp());
+        out.write(zeros, static_cast<std::streamsize>(to - at));
+    }
+} // namespace
+
+// ---------------------------------------------------------------------------
+// MeshBlobs
+
+size_t mesh::MeshBlobs::vertexBytes() const
+{
+    return vertexCount * static_cast<size_t>(layout.stride);
+}
+
+size_t mesh::MeshBlobs::indexBytes() const
+{
+    return indexCount * (indexType == GL_UNSIGNED_SHORT ? 2 : 4);
+}
+
+mesh::MeshBlobs mesh::blobsFromMesh(const MeshData &mesh)
+{
+    MeshBlobs blobs;
+    blobs.vertices = reinterpret_cast<const unsigned char *>(mesh.vertices.data());
+    blobs.vertexCount = mesh.vertexCount();
+    blobs.layout = mesh.layout();
+    blobs.indices = mesh.indices.data();
+    blobs.indexCount = mesh.indices.size();
+    blobs.indexType = GL_UNSIGNED_INT;
+    blobs.submeshes = mesh.submeshes;
+    blobs.lods.push_back(MeshLod{0, static_cast<uint32_t>(mesh.indices.size()), 0.0f});
+    blobs.flags = (mesh.hasNormals ? MeshBlobs::HAS_NORMALS : 0) | (mesh.hasUvs ? MeshBlobs::HAS_UVS : 0);
+    std::copy(mesh.boundsMin, mesh.boundsMin + 3, blobs.boundsMin);
+    std::copy(mesh.boundsMax, mesh.boundsMax + 3, blobs.boundsMax);
+    return blobs;
+}
+
+mesh::MeshBlobs mesh::blobsFromQuantized(const QuantizedVertices &vertices, const MeshData &mesh)
+{
+    MeshBlobs blobs = blobsFromMesh(mesh);
+    blobs.vertices = vertices.data.data();
+    blobs.layout = vertices.layout;
+    std::copy(vertices.positionScale, vertices.positionScale + 3, blobs.positionScale);
+    std::copy(vertices.positionOffset, vertices.positionOffset + 3, blobs.positionOffset);
+    std::copy(vertices.uvScale, vertices.uvScale + 2, blobs.uvScale);
+    std::copy(vertices.uvOffset, vertices.uvOffset + 2, blobs.uvOffset);
+    return blobs;
+}
+
+// ---------------------------------------------------------------------------
+// writing
+
+bool mesh::writeMeshCache(const std::filesystem::path &path, const MeshBlobs &mesh, uint64_t sourceHash,
+                          uint64_t sourceSize, int64_t sourceTime)
+{
+    // narrow the indices when every vertex fits
+    std::vector<uint16_t> shortIndices;
+    const void *indices = mesh.indices;
+    GLenum indexType = mesh.indexType;
+    if (indexType == GL_UNSIGNED_INT && mesh.vertexCount <= 0x10000)
+    {
+        const uint32_t *wide = static_cast<const uint32_t *>(mesh.indices);
+        shortIndices.assign(wide, wide + mesh.indexCount);
+        indices = shortIndices.data();
+        indexType = GL_UNSIGNED_SHORT;
+    }
+
+    std::string strings;
+    std::vector<CacheSubmesh> submeshes;
+    for (const Submesh &submesh : mesh.submeshes)
+    {
+        submeshes.push_back(CacheSubmesh{submesh.firstIndex, submesh.indexCount, static_cast<uint32_t>(strings.size()),
+                                         static_cast<uint32_t>(submesh.material.size())});
+        strings += submesh.material;
+    }
+    std::vector<CacheAttribute> attributes;
+    for (const VertexAttribute &attribute : mesh.layout.attributes)
+    {
+        attributes.push_back(CacheAttribute{attribute.location, static_cast<uint32_t>(attribute.components),
+                                            attribute.type, attribute.normalized, attribute.integer, attribute.offset});
+    }
+
+    CacheHeader header{};
+    header.magic = CACHE_MAGIC;
+    header.version = CACHE_VERSION;
+    header.sourceHash = sourceHash;
+    header.sourceSize = sourceSize;
+    header.sourceTime = sourceTime;
+    header.vertexCount = static_cast<uint32_t>(mesh.vertexCount);
+    header.vertexStride = static_cast<uint32_t>(mesh.layout.stride);
+    header.indexCount = static_cast<uint32_t>(mesh.indexCount);
+    header.indexType = indexType;
+    header.attributeCount = static_cast<uint32_t>(attributes.size());
+    header.submeshCount = static_cast<uint32_t>(submeshes.size());
+    header.lodCount = static_cast<uint32_t>(mesh.lods.size());
+    header.flags = mesh.flags;
+    std::copy(mesh.boundsMin, mesh.boundsMin + 3, header.boundsMin);
+    std::copy(mesh.boundsMax, mesh.boundsMax + 3, header.boundsMax);
+    std::copy(mesh.positionScale, mesh.positionScale + 3, header.positionScale);
+    std::copy(mesh.positionOffset, mesh.positionOffset + 3, header.positionOffset);
+    std::copy(mesh.uvScale, mesh.uvScale + 2, header.uvScale);
+    std::copy(mesh.uvOffset, mesh.uvOffset + 2, header.uvOffset);
+
+    size_t indexBytes = mesh.indexCount * (indexType == GL_UNSIGNED_SHORT ? 2 : 4);
+    header.attributeOffset = alignUp(sizeof(CacheHeader));
+    header.vertexOffset = alignUp(header.attributeOffset + attributes.size() * sizeof(CacheAttribute));
+    header.indexOffset = alignUp(header.vertexOffset + mesh.vertexBytes());
+    header.submeshOffset = alignUp(header.indexOffset + indexBytes);
+    header.lodOffset = alignUp(header.submeshOffset + submeshes.size() * sizeof(CacheSubmesh));
+    header.stringOffset = alignUp(header.lodOffset + mesh.lods.size() * sizeof(MeshLod));
+    header.stringSize = strings.size();
+    header.fileSize = header.stringOffset + strings.size();
+
+    std::filesystem::path temporary = path;
+    temporary += ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        if (!out.is_open())
+        {
+            std::cerr << "Failed to write mesh cache: " << path << std::endl;
+            return false;
+        }
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        writePadding(out, header.attributeOffset);
+        out.write(reinterpret_cast<const char *>(attributes.data()),
+                  static_cast<std::streamsize>(attributes.size() * sizeof(CacheAttribute)));
+        writePadding(out, header.vertexOffset);
+        out.write(reinterpret_cast<const char *>(mesh.vertices), static_cast<std::streamsize>(mesh.vertexBytes()));
+        writePadding(out, header.indexOffset);
+        out.write(static_cast<const char *>(indices), static_cast<std::streamsize>(indexBytes));
+        writePadding(out, header.submeshOffset);
+        out.write(reinterpret_cast<const char *>(submeshes.data()),
+                  static_cast<std::streamsize>(submeshes.size() * sizeof(CacheSubmesh)));
+        writePadding(out, header.lodOffset);
+        out.write(reinterpret_cast<const char *>(mesh.lods.data()),
+                  static_cast<std::streamsize>(mesh.lods.size() * sizeof(MeshLod)));
+        writePadding(out, header.stringOffset);
+        out.write(strings.data(), static_cast<std::streamsize>(strings.size()));
+        if (!out.good())
+        {
+            std::cerr << "Failed to write mesh cache: " << path << std::endl;
+            out.close();
+            std::filesystem::remove(temporary);
+            return false;
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(temporary, path, error);
+    if (error)
+    {
+        std::cerr << "Failed to write mesh cache: " << path << " (" << error.message() << ")" << std::endl;
+        std::filesystem::remove(temporary, error);
+        return false;
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// MeshCacheFile
+
+bool mesh::MeshCacheFile::open(const std::filesystem::path &path)
+{
+    close();
+    if (!m_file.open(path))
+    {
+        return false;
+    }
+    const unsigned char *data = m_file.data();
+    size_t size = m_file.size();
+    CacheHeader header;
+    if (size < sizeof(CacheHeader))
+    {
+        close();
+        return false;
+    }
+    std::memcpy(&header, data, sizeof(header));
+    if (header.magic != CACHE_MAGIC || header.version != CACHE_VERSION)
+    {
+        // another version, the caller rebuilds it
+        close();
+        return false;
+    }
+    size_t indexSize = header.indexType == GL_UNSIGNED_SHORT ? 2 : 4;
+    bool valid = header.fileSize == size && (header.indexType == GL_UNSIGNED_SHORT || header.indexType == GL_UNSIGNED_INT) &&
+                 inside(header.attributeOffset, uint64_t{header.attributeCount} * sizeof(CacheAttribute), size) &&
+                 inside(header.vertexOffset, uint64_t{header.vertexCount} * header.vertexStride, size) &&
+                 inside(header.indexOffset, uint64_t{header.indexCount} * indexSize, size) &&
+                 inside(header.submeshOffset, uint64_t{header.submeshCount} * sizeof(CacheSubmesh), size) &&
+                 inside(header.lodOffset, uint64_t{header.lodCount} * sizeof(MeshLod), size) &&
+                 inside(header.stringOffset, header.stringSize, size);
+    if (!valid)
+    {
+        std::cerr << "Corrupt mesh cache: " << path << std::endl;
+        close();
+        return false;
+    }
+
+    m_header = header;
+    m_blobs = MeshBlobs{};
+    m_blobs.vertices = data + header.vertexOffset;
+    m_blobs.vertexCount = header.vertexCount;
+    m_blobs.layout.stride = static_cast<GLsizei>(header.vertexStride);
+    m_blobs.indices = data + header.indexOffset;
+    m_blobs.indexCount = header.indexCount;
+    m_blobs.indexType = header.indexType;
+    m_blobs.flags = header.flags;
+    std::copy(header.boundsMin, header.boundsMin + 3, m_blobs.boundsMin);
+    std::copy(header.boundsMax, header.boundsMax + 3, m_blobs.boundsMax);
+    std::copy(header.positionScale, header.positionScale + 3, m_blobs.positionScale);
+    std::copy(header.positionOffset, header.positionOffset + 3, m_blobs.positionOffset);
+    std::copy(header.uvScale, header.uvScale + 2, m_blobs.uvScale);
+    std::copy(header.uvOffset, header.uvOffset + 2, m_blobs.uvOffset);
+
+    // the small tables are copied out, the blobs stay in the mapping
+    for (uint32_t i = 0; i < header.attributeCount; i++)
+    {
+        CacheAttribute attribute;
+        std::memcpy(&attribute, data + header.attributeOffset + i * sizeof(CacheAttribute), sizeof(attribute));
+        m_blobs.layout.attributes.push_back(VertexAttribute{attribute.location, static_cast<GLint>(attribute.components),
+                                                            attribute.type, static_cast<GLboolean>(attribute.normalized),
+                                                            attribute.integer != 0, attribute.offset});
+    }
+    const char *strings = reinterpret_cast<const char *>(data + header.stringOffset);
+    for (uint32_t i = 0; i < header.submeshCount; i++)
+    {
+        CacheSubmesh submesh;
+        std::memcpy(&submesh, data + header.submeshOffset + i * sizeof(CacheSubmesh), sizeof(submesh));
+        if (uint64_t{submesh.nameOffset} + submesh.nameSize > header.stringSize ||
+            uint64_t{submesh.firstIndex} + submesh.indexCount > header.indexCount)
+        {
+            std::cerr << "Corrupt mesh cache: " << path << std::endl;
+            close();
+            return false;
+        }
+        m_blobs.submeshes.push_back(Submesh{submesh.firstIndex, submesh.indexCount,
+                                            std::string(strings + submesh.nameOffset, submesh.nameSize)});
+    }
+    m_blobs.lods.resize(header.lodCount);
+    if (header.lodCount > 0)
+    {
+        std::memcpy(m_blobs.lods.data(), data + header.lodOffset, header.lodCount * sizeof(MeshLod));
+    }
+    return true;
+}
+
+void mesh::MeshCacheFile::close()
+{
+    m_file.close();
+    m_header = CacheHeader{};
+    m_blobs = MeshBlobs{};
+}
+
+bool mesh::MeshCacheFile::isOpen() const
+{
+    return m_file.isOpen();
+}
+
+const mesh::CacheHeader &mesh::MeshCacheFile::header() const
+{
+    return m_header;
+}
+
+const mesh::MeshBlobs &mesh::MeshCacheFile::blobs() const
+{
+    return m_blobs;
+}
+
+// ---------------------------------------------------------------------------
+// GPU
+
+void mesh::GpuMesh::draw(size_t lod) const
+{
+    GLsizei count = indexCount;
+    size_t first = 0;
+    if (!lods.empty())
+    {
+        const MeshLod &level = lods[std::min(lod, lods.size() - 1)];
+        count = static_cast<GLsizei>(level.indexCount);
+        first = level.firstIndex;
+    }
+    size_t indexSize = indexType == GL_UNSIGNED_SHORT ? 2 : 4;
+    glBindVertexArray(vao);
+    glDrawElements(GL_TRIANGLES, count, indexType, reinterpret_cast<const void *>(first * indexSize));
+}
+
+void mesh::GpuMesh::release()
+{
+    glDeleteVertexArrays(1, &vao);
+    glDeleteBuffers(1, &vertexBuffer);
+    glDeleteBuffers(1, &indexBuffer);
+    *this = GpuMesh{};
+}
+
+bool mesh::uploadMesh(const MeshBlobs &mesh, GpuMesh &gpu, StagingBuffer *staging)
+{
+    if (mesh.vertices == nullptr || mesh.indices == nullptr)
+    {
+        std::cerr << "uploadMesh: empty mesh" << std::endl;
+        return false;
+    }
+    bool streamed = staging != nullptr && staging->persistent();
+    auto fill = [&](GLenum target, GLuint buffer, const void *data, size_t size)
+    {
+        glBindBuffer(target, buffer);
+        if (streamed)
+        {
+            // immutable storage only the GPU writes to, filled by copies from the ring
+            glext::get().bufferStorage(target, static_cast<GLsizeiptr>(size), nullptr, 0);
+            staging->copy(buffer, 0, data, size);
+        }
+        else
+        {
+            glBufferData(target, static_cast<GLsizeiptr>(size), data, GL_STATIC_DRAW);
+        }
+    };
+
+    gpu.release();
+    glGenVertexArrays(1, &gpu.vao);
+    glGenBuffers(1, &gpu.vertexBuffer);
+    glGenBuffers(1, &gpu.indexBuffer);
+    glBindVertexArray(gpu.vao);
+    fill(GL_ARRAY_BUFFER, gpu.vertexBuffer, mesh.vertices, mesh.vertexBytes());
+    mesh.layout.apply();
+    fill(GL_ELEMENT_ARRAY_BUFFER, gpu.indexBuffer, mesh.indices, mesh.indexBytes());
+    glBindVertexArray(0);
+
+    gpu.indexType = mesh.indexType;
+    gpu.indexCount = static_cast<GLsizei>(mesh.indexCount);
+    gpu.submeshes = mesh.submeshes;
+    gpu.lods = mesh.lods;
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// MeshCache
+
+uint64_t mesh::hashFile(const std::filesystem::path &path)
+{
+    MappedFile file(path);
+    return hashBytes(file.data(), file.size(), 0);
+}
+
+mesh::MeshCache::MeshCache(const std::filesystem::path &directory) : MeshCache(directory, Settings{}) {};
+
+mesh::MeshCache::MeshCache(const std::filesystem::path &directory, const Settings &settings)
+    : m_directory{directory}, m_settings{settings}, m_rebuilt{false}
+{
+    // everything that changes the output goes into the file name
+    uint32_t bits = (settings.import.generateNormals ? 1 : 0) | (settings.optimize ? 2 : 0) | (settings.quantize ? 4 : 0);
+    m_settingsKey = mix(bits + (uint64_t{CACHE_VERSION} << 32));
+};
+
+std::filesystem::path mesh::MeshCache::cachePath(const std::filesystem::path &source) const
+{
+    std::string key = std::filesystem::absolute(source).lexically_normal().string();
+    uint64_t hash = hashBytes(reinterpret_cast<const unsigned char *>(key.data()), key.size(), m_settingsKey);
+    char hex[17];
+    for (int i = 0; i < 16; i++)
+    {
+        hex[i] = "0123456789abcdef"[(hash >> (60 - i * 4)) & 15];
+    }
+    hex[16] = '\0';
+    return m_directory / (source.stem().string() + "-" + hex + ".mesh");
+}
+
+bool mesh::MeshCache::rebuilt() const
+{
+    return m_rebuilt;
+}
+
+bool mesh::MeshCache::load(const std::filesystem::path &source, MeshCacheFile &file)
+{
+    m_rebuilt = false;
+    std::error_code error;
+    uint64_t size = std::filesystem::file_size(source, error);
+    if (error)
+    {
+        std::cerr << "Failed to open mesh: " << source << std::endl;
+        return false;
+    }
+    int64_t time = static_cast<int64_t>(std::filesystem::last_write_time(source, error).time_since_epoch().count());
+    std::filesystem::path path = cachePath(source);
+
+    uint64_t hash = 0;
+    if (file.open(path))
+    {
+        const CacheHeader &header = file.header();
+        if (header.sourceSize == size && header.sourceTime == time)
+        {
+            return true;
+        }
+        // touched but maybe not changed: compare contents, and restamp the time when equal
+        hash = hashFile(source);
+        if (header.sourceSize == size && header.sourceHash == hash)
+        {
+            std::fstream stamp(path, std::ios::binary | std::ios::in | std::ios::out);
+            stamp.seekp(offsetof(CacheHeader, sourceTime));
+            stamp.write(reinterpret_cast<const char *>(&time), sizeof(time));
+            return true;
+        }
+        file.close();
+    }
+    else
+    {
+        hash = hashFile(source);
+    }
+
+    m_rebuilt = true;
+    return build(source, path, hash, size, time) && file.open(path);
+}
+
+bool mesh::MeshCache::build(const std::filesystem::path &source, const std::filesystem::path &path, uint64_t hash,
+                            uint64_t size, int64_t time)
+{
+    MeshData data;
+    if (!loadMesh(source, data, m_settings.import))
+    {
+        return false;
+    }
+    if (m_settings.optimize && !data.indices.empty())
+    {
+        std::vector<uint32_t> ordered(data.indices);
+        for (const Submesh &submesh : data.submeshes)
+        {
+            optimizeVertexCache(&ordered[submesh.firstIndex], &data.indices[submesh.firstIndex], submesh.indexCount,
+                                data.vertexCount());
+        }
+        data.indices.swap(ordered);
+        std::vector<float> fetched(data.vertices.size());
+        size_t used = optimizeVertexFetch(fetched.data(), data.indices.data(), data.indices.size(), data.vertices.data(),
+                                          data.vertexCount(), MeshData::FLOATS_PER_VERTEX * sizeof(float));
+        fetched.resize(used * MeshData::FLOATS_PER_VERTEX);
+        data.vertices.swap(fetched);
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(m_directory, error);
+    if (!m_settings.quantize)
+    {
+        return writeMeshCache(path, blobsFromMesh(data), hash, size, time);
+    }
+    const size_t stride = MeshData::FLOATS_PER_VERTEX * sizeof(float);
+    VertexStreams streams;
+    streams.count = data.vertexCount();
+    streams.positions = data.vertices.data();
+    streams.positionStride = stride;
+    if (data.hasNormals)
+    {
+        streams.normals = data.vertices.data() + 3;
+        streams.normalStride = stride;
+    }
+    if (data.hasUvs)
+    {
+        streams.uvs = data.vertices.data() + 6;
+        streams.uvStride = stride;
+    }
+    QuantizedVertices quantized = quantizeVertices(streams, QuantizeSettings{});
+    return writeMeshCache(path, blobsFromQuantized(quantized, data), hash, size, time);
+}
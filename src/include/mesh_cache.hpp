@@ -0,0 +1,201 @@
+#ifndef MESH_CACHE_HPP
+#define MESH_CACHE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "mapped_file.hpp"
+#include "mesh_import.hpp"
+#include "mesh_simplify.hpp"
+#include "vertex_quantize.hpp"
+
+class StagingBuffer;
+
+// Binary mesh files that are ready for the GPU as they are on disk. Little endian,
+// every blob starts on a 64 byte boundary:
+//
+//   CacheHeader      magic, version, source key, counts, bounds, decode scale/offset,
+//                    offset + size of every section below
+//   attributes       CacheAttribute[attributeCount], the VertexLayout
+//   vertices         vertexCount * stride bytes, interleaved
+//   indices          uint16 (when the vertices allow it) or uint32
+//   submeshes        CacheSubmesh[submeshCount], names in the string blob
+//   lods             MeshLod[lodCount], level 0 is the full mesh
+//   strings          submesh names, not terminated
+//
+// MeshCacheFile maps the file and hands out pointers into the mapping, so the blobs
+// go to glBufferData (or a StagingBuffer) without being parsed or copied.
+namespace mesh
+{
+    const uint32_t CACHE_MAGIC = 0x48534D4C; // "LMSH"
+    const uint32_t CACHE_VERSION = 1;
+    const size_t CACHE_ALIGNMENT = 64;
+
+    struct CacheHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t sourceHash;
+        uint64_t sourceSize;
+        int64_t sourceTime; // modification time when the file was written, skips rehashing
+        uint32_t vertexCount;
+        uint32_t vertexStride;
+        uint32_t indexCount;
+        uint32_t indexType; // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+        uint32_t attributeCount;
+        uint32_t submeshCount;
+        uint32_t lodCount;
+        uint32_t flags;
+        float boundsMin[3];
+        float boundsMax[3];
+        // decoded position = stored * scale + offset, see QuantizedVertices
+        float positionScale[3];
+        float positionOffset[3];
+        float uvScale[2];
+        float uvOffset[2];
+        uint64_t attributeOffset;
+        uint64_t vertexOffset;
+        uint64_t indexOffset;
+        uint64_t submeshOffset;
+        uint64_t lodOffset;
+        uint64_t stringOffset;
+        uint64_t stringSize;
+        uint64_t fileSize;
+    };
+
+    struct CacheAttribute
+    {
+        uint32_t location;
+        uint32_t components;
+        uint32_t type;
+        uint32_t normalized;
+        uint32_t integer;
+        uint32_t offset;
+    };
+
+    struct CacheSubmesh
+    {
+        uint32_t firstIndex;
+        uint32_t indexCount;
+        uint32_t nameOffset;
+        uint32_t nameSize;
+    };
+
+    // A mesh in GPU form. Pointers either reference the caller's memory (writing) or
+    // the mapped file (reading).
+    struct MeshBlobs
+    {
+        static const uint32_t HAS_NORMALS = 1;
+        static const uint32_t HAS_UVS = 2;
+
+        const unsigned char *vertices = nullptr;
+        size_t vertexCount = 0;
+        VertexLayout layout;
+        const void *indices = nullptr;
+        size_t indexCount = 0;
+        GLenum indexType = GL_UNSIGNED_INT;
+        std::vector<Submesh> submeshes;
+        std::vector<MeshLod> lods;
+        uint32_t flags = 0;
+        float boundsMin[3] = {0.0f, 0.0f, 0.0f};
+        float boundsMax[3] = {0.0f, 0.0f, 0.0f};
+        float positionScale[3] = {1.0f, 1.0f, 1.0f};
+        float positionOffset[3] = {0.0f, 0.0f, 0.0f};
+        float uvScale[2] = {1.0f, 1.0f};
+        float uvOffset[2] = {0.0f, 0.0f};
+
+        size_t vertexBytes() const;
+        size_t indexBytes() const;
+    };
+
+    // float MeshData as blobs, referencing mesh
+    MeshBlobs blobsFromMesh(const MeshData &mesh);
+    // quantized vertices with the indices and submeshes of mesh, referencing both
+    MeshBlobs blobsFromQuantized(const QuantizedVertices &vertices, const MeshData &mesh);
+
+    // Writes through a temporary file and renames it into place, so readers never see
+    // half a file. 32 bit indices are stored as 16 bit when every vertex fits.
+    bool writeMeshCache(const std::filesystem::path &path, const MeshBlobs &mesh, uint64_t sourceHash = 0,
+                        uint64_t sourceSize = 0, int64_t sourceTime = 0);
+
+    class MeshCacheFile
+    {
+    public:
+        MeshCacheFile() {};
+
+        // maps and validates path; blobs() stays valid until close() or the next open()
+        bool open(const std::filesystem::path &path);
+        void close();
+        bool isOpen() const;
+
+        const CacheHeader &header() const;
+        const MeshBlobs &blobs() const;
+
+    private:
+        // vars
+        MappedFile m_file;
+        CacheHeader m_header{};
+        MeshBlobs m_blobs;
+    };
+
+    // GPU side of a mesh: a VAO with the layout applied and one vertex and index buffer.
+    struct GpuMesh
+    {
+        GLuint vao = 0;
+        GLuint vertexBuffer = 0;
+        GLuint indexBuffer = 0;
+        GLenum indexType = GL_UNSIGNED_INT;
+        GLsizei indexCount = 0;
+        std::vector<Submesh> submeshes;
+        std::vector<MeshLod> lods;
+
+        // whole mesh at the given level of detail (0 when there is no LOD table)
+        void draw(size_t lod = 0) const;
+        void release();
+    };
+
+    // glBufferData straight from the blobs, or buffer storage filled through staging
+    // when it is given and persistent. Needs a current context.
+    bool uploadMesh(const MeshBlobs &mesh, GpuMesh &gpu, StagingBuffer *staging = nullptr);
+
+    // 64 bit content hash of a file, as used for the cache key
+    uint64_t hashFile(const std::filesystem::path &path);
+
+    // Source meshes (anything loadMesh reads) cached as binary mesh files in a directory.
+    // The cache file name comes from the source path and the settings, its header keeps
+    // the content hash, size and time of the source. A file whose source changed, or
+    // that was written by another version, is rebuilt.
+    class MeshCache
+    {
+    public:
+        struct Settings
+        {
+            ImportSettings import;
+            bool optimize = true;  // vertex cache order per submesh, then vertex fetch order
+            bool quantize = false; // QuantizeSettings defaults instead of float vertices
+        };
+
+        explicit MeshCache(const std::filesystem::path &directory);
+        MeshCache(const std::filesystem::path &directory, const Settings &settings);
+
+        // opens the cache file of source, importing and writing it first when needed
+        bool load(const std::filesystem::path &source, MeshCacheFile &file);
+        std::filesystem::path cachePath(const std::filesystem::path &source) const;
+        // true if the last load had to import the source
+        bool rebuilt() const;
+
+    private:
+        bool build(const std::filesystem::path &source, const std::filesystem::path &path, uint64_t hash,
+                   uint64_t size, int64_t time);
+        // vars
+        std::filesystem::path m_directory;
+        Settings m_settings;
+        uint64_t m_settingsKey;
+        bool m_rebuilt;
+    };
+} // namespace mesh
+
+#endif // MESH_CACHE_HPP
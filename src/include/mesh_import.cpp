@@ -0,0 +1,1574 @@
+#include "mesh_import.hpp"
+#include "mapped_file.hpp"
+#include "mesh_tangents.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <limits>
+
+namespace
+{
+    const uint32_t NO_INDEX = 0xFFFFFFFFu;
+
+    // ---------------------------------------------------------------------------
+    // text helpers
+
+    const double POW10[23] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                              1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+    bool isDigit(char c)
+    {
+        return c >= '0' && c <= '9';
+    }
+
+    const char *skipSpace(const char *p, const char *end)
+    {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+        {
+            p++;
+        }
+        return p;
+    }
+
+    const char *parseInt(const char *p, const char *end, long &value)
+    {
+        const char *s = p;
+        bool negative = false;
+        if (s < end && (*s == '-' || *s == '+'))
+        {
+            negative = *s == '-';
+            s++;
+        }
+        if (s >= end || !isDigit(*s))
+        {
+            return p;
+        }
+        long v = 0;
+        while (s < end && isDigit(*s))
+        {
+            v = v * 10 + (*s - '0');
+            s++;
+        }
+        value = negative ? -v : v;
+        return s;
+    }
+
+    // up to count whitespace separated floats, returns how many were read
+    int parseFloats(const char *p, const char *end, float *out, int count)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            p = skipSpace(p, end);
+            const char *next = mesh::parseFloat(p, end, out[i]);
+            if (next == p)
+            {
+                return i;
+            }
+            p = next;
+        }
+        return count;
+    }
+
+    void addToBounds(const float *position, float *lo, float *hi)
+    {
+        for (int k = 0; k < 3; k++)
+        {
+            lo[k] = std::min(lo[k], position[k]);
+            hi[k] = std::max(hi[k], position[k]);
+        }
+    }
+
+    void normalize3(float *v)
+    {
+        float length = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+        if (length > 0.0f)
+        {
+            v[0] /= length;
+            v[1] /= length;
+            v[2] /= length;
+        }
+    }
+
+    // adds the (area weighted) face normal of every triangle to target(vertex), then normalises
+    template <typename Target>
+    void accumulateNormals(const float *vertices, const uint32_t *indices, size_t indexCount, float *normals,
+                           size_t normalCount, Target target)
+    {
+        const int F = mesh::MeshData::FLOATS_PER_VERTEX;
+        for (size_t i = 0; i + 2 < indexCount; i += 3)
+        {
+            const float *a = vertices + static_cast<size_t>(indices[i]) * F;
+            const float *b = vertices + static_cast<size_t>(indices[i + 1]) * F;
+            const float *c = vertices + static_cast<size_t>(indices[i + 2]) * F;
+            float e1[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+            float e2[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+            float n[3] = {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0]};
+            for (int k = 0; k < 3; k++)
+            {
+                float *dst = normals + static_cast<size_t>(target(indices[i + k])) * 3;
+                dst[0] += n[0];
+                dst[1] += n[1];
+                dst[2] += n[2];
+            }
+        }
+        for (size_t i = 0; i < normalCount; i++)
+        {
+            normalize3(normals + i * 3);
+        }
+    }
+
+    // runs fn(i) for i in [0, count), on the shared pool when multithreaded
+    void forEach(size_t count, bool multithreaded, const std::function<void(size_t)> &fn)
+    {
+        auto range = [&fn](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; i++)
+            {
+                fn(i);
+            }
+        };
+        if (multithreaded)
+        {
+            ThreadPool::shared().parallelFor(count, 1, range);
+        }
+        else
+        {
+            range(0, count);
+        }
+    }
+
+    // ---------------------------------------------------------------------------
+    // OBJ
+
+    // Corner components are stored 1-based as in the file until the chunks are merged;
+    // negative (relative) indices are stored against the chunk's own element count.
+    const uint32_t LOCAL = 0x80000000u;
+    const int64_t LOCAL_BIAS = 1 << 30;
+
+    struct ObjChunk
+    {
+        const char *begin;
+        const char *end;
+        std::vector<float> positions;
+        std::vector<float> normals;
+        std::vector<float> uvs;
+        std::vector<uint32_t> corners; // v, vt, vn per triangle corner, 0 = absent
+        std::vector<std::pair<size_t, std::string>> materials; // first triangle (in chunk) -> usemtl
+        size_t errorLine = 0; // first bad line in the chunk, 1-based from the chunk start
+    };
+
+    uint32_t encodeObjIndex(long index, size_t localCount, bool &ok)
+    {
+        if (index > 0 && index < static_cast<long>(LOCAL))
+        {
+            return static_cast<uint32_t>(index);
+        }
+        int64_t local = static_cast<int64_t>(localCount) + index + LOCAL_BIAS;
+        if (index < 0 && local >= 0 && local < LOCAL_BIAS * 2)
+        {
+            return LOCAL | static_cast<uint32_t>(local);
+        }
+        ok = false;
+        return 0;
+    }
+
+    uint32_t resolveObjIndex(uint32_t stored, size_t base, size_t total, bool &ok)
+    {
+        if (stored == 0)
+        {
+            return NO_INDEX;
+        }
+        int64_t index = stored & LOCAL ? static_cast<int64_t>(base) + static_cast<int64_t>(stored & ~LOCAL) - LOCAL_BIAS
+                                       : static_cast<int64_t>(stored) - 1;
+        if (index < 0 || index >= static_cast<int64_t>(total))
+        {
+            ok = false;
+            return NO_INDEX;
+        }
+        return static_cast<uint32_t>(index);
+    }
+
+    void parseObjChunk(ObjChunk &chunk)
+    {
+        std::vector<uint32_t> face;
+        size_t line = 0;
+        const char *p = chunk.begin;
+        while (p < chunk.end)
+        {
+            line++;
+            const char *lineEnd = static_cast<const char *>(std::memchr(p, '\n', chunk.end - p));
+            if (lineEnd == nullptr)
+            {
+                lineEnd = chunk.end;
+            }
+            p = skipSpace(p, lineEnd);
+            bool ok = true;
+            if (p + 1 < lineEnd && p[0] == 'v')
+            {
+                if (p[1] == ' ' || p[1] == '\t')
+                {
+                    float xyz[3] = {0.0f, 0.0f, 0.0f};
+                    ok = parseFloats(p + 2, lineEnd, xyz, 3) == 3;
+                    chunk.positions.insert(chunk.positions.end(), xyz, xyz + 3);
+                }
+                else if (p[1] == 'n')
+                {
+                    float xyz[3] = {0.0f, 0.0f, 0.0f};
+                    ok = parseFloats(p + 2, lineEnd, xyz, 3) == 3;
+                    chunk.normals.insert(chunk.normals.end(), xyz, xyz + 3);
+                }
+                else if (p[1] == 't')
+                {
+                    // the second coordinate is optional
+                    float st[2] = {0.0f, 0.0f};
+                    ok = parseFloats(p + 2, lineEnd, st, 2) >= 1;
+                    chunk.uvs.insert(chunk.uvs.end(), st, st + 2);
+                }
+            }
+            else if (p < lineEnd && p[0] == 'f' && p + 1 < lineEnd && (p[1] == ' ' || p[1] == '\t'))
+            {
+                face.clear();
+                const char *s = skipSpace(p + 1, lineEnd);
+                while (s < lineEnd && ok)
+                {
+                    long v = 0, vt = 0, vn = 0;
+                    const char *next = parseInt(s, lineEnd, v);
+                    if (next == s)
+                    {
+                        ok = false;
+                        break;
+                    }
+                    s = next;
+                    if (s < lineEnd && *s == '/')
+                    {
+                        s = parseInt(s + 1, lineEnd, vt);
+                        if (s < lineEnd && *s == '/')
+                        {
+                            s = parseInt(s + 1, lineEnd, vn);
+                        }
+                    }
+                    face.push_back(encodeObjIndex(v, chunk.positions.size() / 3, ok));
+                    face.push_back(vt ? encodeObjIndex(vt, chunk.uvs.size() / 2, ok) : 0);
+                    face.push_back(vn ? encodeObjIndex(vn, chunk.normals.size() / 3, ok) : 0);
+                    s = skipSpace(s, lineEnd);
+                }
+                // fan out polygons
+                for (size_t i = 2; ok && i < face.size() / 3; i++)
+                {
+                    chunk.corners.insert(chunk.corners.end(), face.begin(), face.begin() + 3);
+                    chunk.corners.insert(chunk.corners.end(), face.begin() + (i - 1) * 3, face.begin() + (i + 1) * 3);
+                }
+            }
+            else if (lineEnd - p > 7 && std::strncmp(p, "usemtl", 6) == 0 && (p[6] == ' ' || p[6] == '\t'))
+            {
+                const char *name = skipSpace(p + 7, lineEnd);
+                const char *nameEnd = lineEnd;
+                while (nameEnd > name && (nameEnd[-1] == ' ' || nameEnd[-1] == '\t' || nameEnd[-1] == '\r'))
+                {
+                    nameEnd--;
+                }
+                chunk.materials.emplace_back(chunk.corners.size() / 9, std::string(name, nameEnd));
+            }
+            if (!ok && chunk.errorLine == 0)
+            {
+                chunk.errorLine = line;
+            }
+            p = lineEnd + 1;
+        }
+    }
+
+    // open addressing set of corner keys (v, vt, vn), values are positions in keys
+    class CornerTable
+    {
+    public:
+        CornerTable(size_t expected)
+        {
+            size_t capacity = 16;
+            while (capacity < expected * 2)
+            {
+                capacity <<= 1;
+            }
+            m_slots.assign(capacity, NO_INDEX);
+        };
+
+        static uint32_t hash(const uint32_t *key)
+        {
+            uint64_t h = (static_cast<uint64_t>(key[0]) * 0x9E3779B97F4A7C15ull) ^
+                         (static_cast<uint64_t>(key[1]) * 0xC2B2AE3D27D4EB4Full) ^
+                         (static_cast<uint64_t>(key[2]) * 0x165667B19E3779F9ull);
+            return static_cast<uint32_t>(h >> 32) ^ static_cast<uint32_t>(h);
+        }
+
+        // returns the id of key, adding it if new
+        uint32_t insert(const uint32_t *key, uint32_t hashValue)
+        {
+            if ((m_keys.size() / 3 + 1) * 2 > m_slots.size())
+            {
+                grow();
+            }
+            size_t mask = m_slots.size() - 1;
+            size_t slot = hashValue & mask;
+            while (m_slots[slot] != NO_INDEX)
+            {
+                const uint32_t *stored = &m_keys[static_cast<size_t>(m_slots[slot]) * 3];
+                if (stored[0] == key[0] && stored[1] == key[1] && stored[2] == key[2])
+                {
+                    return m_slots[slot];
+                }
+                slot = (slot + 1) & mask;
+            }
+            uint32_t id = static_cast<uint32_t>(m_keys.size() / 3);
+            m_slots[slot] = id;
+            m_keys.insert(m_keys.end(), key, key + 3);
+            return id;
+        }
+
+        const std::vector<uint32_t> &keys() const
+        {
+            return m_keys;
+        }
+
+    private:
+        void grow()
+        {
+            std::vector<uint32_t> slots(m_slots.size() * 2, NO_INDEX);
+            size_t mask = slots.size() - 1;
+            for (size_t id = 0; id < m_keys.size() / 3; id++)
+            {
+                size_t slot = hash(&m_keys[id * 3]) & mask;
+                while (slots[slot] != NO_INDEX)
+                {
+                    slot = (slot + 1) & mask;
+                }
+                slots[slot] = static_cast<uint32_t>(id);
+            }
+            m_slots.swap(slots);
+        }
+        // vars
+        std::vector<uint32_t> m_slots;
+        std::vector<uint32_t> m_keys;
+    };
+
+    // ---------------------------------------------------------------------------
+    // JSON, just enough for glTF
+
+    struct Json
+    {
+        enum Type
+        {
+            NUL,
+            BOOLEAN,
+            NUMBER,
+            STRING,
+            ARRAY,
+            OBJECT,
+        };
+
+        Type type = NUL;
+        bool boolean = false;
+        double number = 0.0;
+        std::string string;
+        std::vector<Json> items;
+        std::vector<std::pair<std::string, Json>> members;
+
+        const Json *find(const char *key) const
+        {
+            for (const auto &[name, value] : members)
+            {
+                if (name == key)
+                {
+                    return &value;
+                }
+            }
+            return nullptr;
+        }
+
+        const Json *at(size_t i) const
+        {
+            return type == ARRAY && i < items.size() ? &items[i] : nullptr;
+        }
+
+        double numberOr(const char *key, double fallback) const
+        {
+            const Json *value = find(key);
+            return value && value->type == NUMBER ? value->number : fallback;
+        }
+
+        std::string stringOr(const char *key, const std::string &fallback) const
+        {
+            const Json *value = find(key);
+            return value && value->type == STRING ? value->string : fallback;
+        }
+    };
+
+    class JsonParser
+    {
+    public:
+        JsonParser(const char *begin, const char *end) : m_p{begin}, m_end{end} {};
+
+        bool parse(Json &out)
+        {
+            return value(out, 0) && (skip(), m_p == m_end);
+        }
+
+    private:
+        void skip()
+        {
+            while (m_p < m_end && (*m_p == ' ' || *m_p == '\t' || *m_p == '\n' || *m_p == '\r'))
+            {
+                m_p++;
+            }
+        }
+
+        bool literal(const char *word)
+        {
+            size_t length = std::strlen(word);
+            if (static_cast<size_t>(m_end - m_p) < length || std::strncmp(m_p, word, length) != 0)
+            {
+                return false;
+            }
+            m_p += length;
+            return true;
+        }
+
+        bool value(Json &out, int depth)
+        {
+            skip();
+            if (m_p >= m_end || depth > 64)
+            {
+                return false;
+            }
+            switch (*m_p)
+            {
+            case '{':
+                out.type = Json::OBJECT;
+                m_p++;
+                skip();
+                if (m_p < m_end && *m_p == '}')
+                {
+                    m_p++;
+                    return true;
+                }
+                while (true)
+                {
+                    std::pair<std::string, Json> member;
+                    skip();
+                    if (!string(member.first))
+                    {
+                        return false;
+                    }
+                    skip();
+                    if (m_p >= m_end || *m_p++ != ':' || !value(member.second, depth + 1))
+                    {
+                        return false;
+                    }
+                    out.members.push_back(std::move(member));
+                    skip();
+                    if (m_p < m_end && *m_p == ',')
+                    {
+                        m_p++;
+                        continue;
+                    }
+                    return m_p < m_end && *m_p++ == '}';
+                }
+            case '[':
+                out.type = Json::ARRAY;
+                m_p++;
+                skip();
+                if (m_p < m_end && *m_p == ']')
+                {
+                    m_p++;
+                    return true;
+                }
+                while (true)
+                {
+                    out.items.emplace_back();
+                    if (!value(out.items.back(), depth + 1))
+                    {
+                        return false;
+                    }
+                    skip();
+                    if (m_p < m_end && *m_p == ',')
+                    {
+                        m_p++;
+                        continue;
+                    }
+                    return m_p < m_end && *m_p++ == ']';
+                }
+            case '"':
+                out.type = Json::STRING;
+                return string(out.string);
+            case 't':
+                out.type = Json::BOOLEAN;
+                out.boolean = true;
+                return literal("true");
+            case 'f':
+                out.type = Json::BOOLEAN;
+                return literal("false");
+            case 'n':
+                return literal("null");
+            default:
+            {
+                out.type = Json::NUMBER;
+                char *numberEnd = nullptr;
+                // numbers are short, copy so strtod cannot run past the buffer
+                char buffer[64];
+                size_t length = 0;
+                while (m_p + length < m_end && length < sizeof(buffer) - 1 &&
+                       std::strchr("+-.eE0123456789", m_p[length]) != nullptr)
+                {
+                    buffer[length] = m_p[length];
+                    length++;
+                }
+                buffer[length] = '\0';
+                out.number = std::strtod(buffer, &numberEnd);
+                if (numberEnd == buffer)
+                {
+                    return false;
+                }
+                m_p += numberEnd - buffer;
+                return true;
+            }
+            }
+        }
+
+        bool string(std::string &out)
+        {
+            if (m_p >= m_end || *m_p != '"')
+            {
+                return false;
+            }
+            m_p++;
+            while (m_p < m_end && *m_p != '"')
+            {
+                char c = *m_p++;
+                if (c != '\\')
+                {
+                    out += c;
+                    continue;
+                }
+                if (m_p >= m_end)
+                {
+                    return false;
+                }
+                char e = *m_p++;
+                switch (e)
+                {
+                case 'b':
+                    out += '\b';
+                    break;
+                case 'f':
+                    out += '\f';
+                    break;
+                case 'n':
+                    out += '\n';
+                    break;
+                case 'r':
+                    out += '\r';
+                    break;
+                case 't':
+                    out += '\t';
+                    break;
+                case 'u':
+                {
+                    if (m_end - m_p < 4)
+                    {
+                        return false;
+                    }
+                    unsigned int code = static_cast<unsigned int>(std::strtoul(std::string(m_p, 4).c_str(), nullptr, 16));
+                    m_p += 4;
+                    // UTF-8, surrogate pairs are kept as two code points
+                    if (code < 0x80)
+                    {
+                        out += static_cast<char>(code);
+                    }
+                    else if (code < 0x800)
+                    {
+                        out += static_cast<char>(0xC0 | (code >> 6));
+                        out += static_cast<char>(0x80 | (code & 0x3F));
+                    }
+                    else
+                    {
+                        out += static_cast<char>(0xE0 | (code >> 12));
+                        out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+                        out += static_cast<char>(0x80 | (code & 0x3F));
+                    }
+                    break;
+                }
+                default:
+                    out += e; // \" \\ \/
+                    break;
+                }
+            }
+            if (m_p >= m_end)
+            {
+                return false;
+            }
+            m_p++;
+            return true;
+        }
+        // vars
+        const char *m_p;
+        const char *m_end;
+    };
+
+    // ---------------------------------------------------------------------------
+    // glTF
+
+    const uint32_t GLB_MAGIC = 0x46546C67; // "glTF"
+    const uint32_t GLB_CHUNK_JSON = 0x4E4F534A;
+    const uint32_t GLB_CHUNK_BIN = 0x004E4942;
+    const int GLTF_TRIANGLES = 4;
+
+    struct Buffer
+    {
+        const unsigned char *data = nullptr;
+        size_t size = 0;
+    };
+
+    struct Gltf
+    {
+        MappedFile file;
+        std::vector<MappedFile> external;
+        std::vector<Buffer> buffers;
+        Json json;
+    };
+
+    struct Accessor
+    {
+        const unsigned char *data = nullptr;
+        size_t count = 0;
+        size_t stride = 0;
+        int componentType = 0;
+        int components = 0;
+        bool normalized = false;
+    };
+
+    uint32_t readU32(const unsigned char *p)
+    {
+        uint32_t v;
+        std::memcpy(&v, p, 4);
+        return v;
+    }
+
+    int componentSize(int componentType)
+    {
+        switch (componentType)
+        {
+        case 5120: // BYTE
+        case 5121: // UNSIGNED_BYTE
+            return 1;
+        case 5122: // SHORT
+        case 5123: // UNSIGNED_SHORT
+            return 2;
+        case 5125: // UNSIGNED_INT
+        case 5126: // FLOAT
+            return 4;
+        default:
+            return 0;
+        }
+    }
+
+    int componentCount(const std::string &type)
+    {
+        if (type == "SCALAR")
+        {
+            return 1;
+        }
+        if (type == "VEC2")
+        {
+            return 2;
+        }
+        if (type == "VEC3")
+        {
+            return 3;
+        }
+        if (type == "VEC4")
+        {
+            return 4;
+        }
+        return 0;
+    }
+
+    bool getAccessor(const Gltf &gltf, const Json *indexValue, Accessor &out)
+    {
+        if (indexValue == nullptr || indexValue->type != Json::NUMBER)
+        {
+            return false;
+        }
+        const Json *accessors = gltf.json.find("accessors");
+        const Json *accessor = accessors ? accessors->at(static_cast<size_t>(indexValue->number)) : nullptr;
+        if (accessor == nullptr || accessor->find("sparse") != nullptr)
+        {
+            return false;
+        }
+        const Json *views = gltf.json.find("bufferViews");
+        const Json *view = views ? views->at(static_cast<size_t>(accessor->numberOr("bufferView", -1))) : nullptr;
+        if (view == nullptr)
+        {
+            return false;
+        }
+        size_t bufferIndex = static_cast<size_t>(view->numberOr("buffer", -1));
+        if (bufferIndex >= gltf.buffers.size())
+        {
+            return false;
+        }
+        const Buffer &buffer = gltf.buffers[bufferIndex];
+
+        out.componentType = static_cast<int>(accessor->numberOr("componentType", 0));
+        out.components = componentCount(accessor->stringOr("type", ""));
+        out.count = static_cast<size_t>(accessor->numberOr("count", 0));
+        const Json *normalized = accessor->find("normalized");
+        out.normalized = normalized && normalized->boolean;
+        size_t elementSize = static_cast<size_t>(componentSize(out.componentType)) * out.components;
+        out.stride = static_cast<size_t>(view->numberOr("byteStride", 0));
+        if (out.stride == 0)
+        {
+            out.stride = elementSize;
+        }
+        size_t viewOffset = static_cast<size_t>(view->numberOr("byteOffset", 0));
+        size_t viewLength = static_cast<size_t>(view->numberOr("byteLength", 0));
+        size_t offset = static_cast<size_t>(accessor->numberOr("byteOffset", 0));
+        if (elementSize == 0 || viewOffset + viewLength > buffer.size ||
+            (out.count > 0 && offset + out.stride * (out.count - 1) + elementSize > viewLength))
+        {
+            return false;
+        }
+        out.data = buffer.data + viewOffset + offset;
+        return true;
+    }
+
+    float readComponent(const unsigned char *p, int componentType, bool normalized)
+    {
+        switch (componentType)
+        {
+        case 5126:
+        {
+            float v;
+            std::memcpy(&v, p, 4);
+            return v;
+        }
+        case 5121:
+            return normalized ? *p / 255.0f : *p;
+        case 5120:
+        {
+            int8_t v = static_cast<int8_t>(*p);
+            return normalized ? std::max(v / 127.0f, -1.0f) : v;
+        }
+        case 5123:
+        {
+            uint16_t v;
+            std::memcpy(&v, p, 2);
+            return normalized ? v / 65535.0f : v;
+        }
+        case 5122:
+        {
+            int16_t v;
+            std::memcpy(&v, p, 2);
+            return normalized ? std::max(v / 32767.0f, -1.0f) : v;
+        }
+        default:
+            return 0.0f;
+        }
+    }
+
+    uint32_t readIndex(const unsigned char *p, int componentType)
+    {
+        switch (componentType)
+        {
+        case 5121:
+            return *p;
+        case 5123:
+        {
+            uint16_t v;
+            std::memcpy(&v, p, 2);
+            return v;
+        }
+        default:
+            return readU32(p);
+        }
+    }
+
+    // column major 4x4, as glTF stores them
+    void multiply(const float *a, const float *b, float *out)
+    {
+        float r[16];
+        for (int c = 0; c < 4; c++)
+        {
+            for (int row = 0; row < 4; row++)
+            {
+                r[c * 4 + row] = a[row] * b[c * 4] + a[4 + row] * b[c * 4 + 1] + a[8 + row] * b[c * 4 + 2] +
+                                 a[12 + row] * b[c * 4 + 3];
+            }
+        }
+        std::memcpy(out, r, sizeof(r));
+    }
+
+    void nodeMatrix(const Json &node, float *out)
+    {
+        const Json *matrix = node.find("matrix");
+        if (matrix && matrix->items.size() == 16)
+        {
+            for (int i = 0; i < 16; i++)
+            {
+                out[i] = static_cast<float>(matrix->items[i].number);
+            }
+            return;
+        }
+        float t[3] = {0.0f, 0.0f, 0.0f}, q[4] = {0.0f, 0.0f, 0.0f, 1.0f}, s[3] = {1.0f, 1.0f, 1.0f};
+        auto read = [&node](const char *key, float *dst, size_t count)
+        {
+            const Json *value = node.find(key);
+            if (value && value->items.size() == count)
+            {
+                for (size_t i = 0; i < count; i++)
+                {
+                    dst[i] = static_cast<float>(value->items[i].number);
+                }
+            }
+        };
+        read("translation", t, 3);
+        read("rotation", q, 4);
+        read("scale", s, 3);
+        float x = q[0], y = q[1], z = q[2], w = q[3];
+        float r[9] = {1 - 2 * (y * y + z * z), 2 * (x * y + z * w),     2 * (x * z - y * w),
+                      2 * (x * y - z * w),     1 - 2 * (x * x + z * z), 2 * (y * z + x * w),
+                      2 * (x * z + y * w),     2 * (y * z - x * w),     1 - 2 * (x * x + y * y)};
+        for (int c = 0; c < 3; c++)
+        {
+            for (int row = 0; row < 3; row++)
+            {
+                out[c * 4 + row] = r[c * 3 + row] * s[c];
+            }
+            out[c * 4 + 3] = 0.0f;
+        }
+        out[12] = t[0];
+        out[13] = t[1];
+        out[14] = t[2];
+        out[15] = 1.0f;
+    }
+
+    struct PrimitiveInstance
+    {
+        const Json *primitive;
+        float matrix[16];
+        size_t vertexCount;
+        size_t indexCount;
+    };
+
+    void collectNode(const Json &json, size_t nodeIndex, const float *parent, std::vector<PrimitiveInstance> &out,
+                     int depth)
+    {
+        const Json *nodes = json.find("nodes");
+        const Json *node = nodes ? nodes->at(nodeIndex) : nullptr;
+        if (node == nullptr || depth > 64)
+        {
+            return;
+        }
+        float local[16], world[16];
+        nodeMatrix(*node, local);
+        multiply(parent, local, world);
+        const Json *meshes = json.find("meshes");
+        const Json *meshIndex = node->find("mesh");
+        const Json *meshJson = meshes && meshIndex ? meshes->at(static_cast<size_t>(meshIndex->number)) : nullptr;
+        const Json *primitives = meshJson ? meshJson->find("primitives") : nullptr;
+        if (primitives)
+        {
+            for (const Json &primitive : primitives->items)
+            {
+                PrimitiveInstance instance{&primitive, {}, 0, 0};
+                std::memcpy(instance.matrix, world, sizeof(world));
+                out.push_back(instance);
+            }
+        }
+        const Json *children = node->find("children");
+        if (children)
+        {
+            for (const Json &child : children->items)
+            {
+                collectNode(json, static_cast<size_t>(child.number), world, out, depth + 1);
+            }
+        }
+    }
+
+    bool openGltf(const std::filesystem::path &path, Gltf &gltf)
+    {
+        if (!gltf.file.open(path))
+        {
+            std::cerr << "Failed to open mesh: " << path << std::endl;
+            return false;
+        }
+        const unsigned char *data = gltf.file.data();
+        size_t size = gltf.file.size();
+        const char *jsonBegin = reinterpret_cast<const char *>(data);
+        const char *jsonEnd = jsonBegin + size;
+        Buffer glbBinary;
+        if (size >= 12 && readU32(data) == GLB_MAGIC)
+        {
+            // header, then a JSON chunk and an optional BIN chunk, each 4 byte aligned
+            if (readU32(data + 4) != 2 || readU32(data + 8) > size || size < 20 || readU32(data + 16) != GLB_CHUNK_JSON)
+            {
+                std::cerr << "Unsupported glb container: " << path << std::endl;
+                return false;
+            }
+            size_t jsonLength = readU32(data + 12);
+            if (20 + jsonLength > size)
+            {
+                std::cerr << "Truncated glb: " << path << std::endl;
+                return false;
+            }
+            jsonBegin = reinterpret_cast<const char *>(data + 20);
+            jsonEnd = jsonBegin + jsonLength;
+            size_t binHeader = (20 + jsonLength + 3) & ~static_cast<size_t>(3);
+            if (binHeader + 8 <= size && readU32(data + binHeader + 4) == GLB_CHUNK_BIN)
+            {
+                glbBinary.data = data + binHeader + 8;
+                glbBinary.size = std::min<size_t>(readU32(data + binHeader), size - binHeader - 8);
+            }
+        }
+        if (!JsonParser(jsonBegin, jsonEnd).parse(gltf.json) || gltf.json.type != Json::OBJECT)
+        {
+            std::cerr << "Invalid glTF JSON: " << path << std::endl;
+            return false;
+        }
+
+        const Json *buffers = gltf.json.find("buffers");
+        size_t bufferCount = buffers ? buffers->items.size() : 0;
+        gltf.external.reserve(bufferCount);
+        for (size_t i = 0; i < bufferCount; i++)
+        {
+            const Json &buffer = buffers->items[i];
+            std::string uri = buffer.stringOr("uri", "");
+            if (uri.empty())
+            {
+                // only the first buffer of a glb may live in the BIN chunk
+                gltf.buffers.push_back(i == 0 ? glbBinary : Buffer{});
+                continue;
+            }
+            if (uri.compare(0, 5, "data:") == 0)
+            {
+                std::cerr << "Embedded glTF buffers are not supported: " << path << std::endl;
+                return false;
+            }
+            gltf.external.emplace_back();
+            if (!gltf.external.back().open(path.parent_path() / uri))
+            {
+                std::cerr << "Failed to open glTF buffer: " << path.parent_path() / uri << std::endl;
+                return false;
+            }
+            gltf.buffers.push_back(Buffer{gltf.external.back().data(), gltf.external.back().size()});
+        }
+        return true;
+    }
+
+    void computeBounds(mesh::MeshData &mesh, bool multithreaded)
+    {
+        const int F = mesh::MeshData::FLOATS_PER_VERTEX;
+        size_t count = mesh.vertexCount();
+        const size_t grain = 1 << 16;
+        size_t blocks = (count + grain - 1) / grain;
+        std::vector<float> blockBounds(blocks * 6);
+        forEach(blocks, multithreaded,
+                [&](size_t b)
+                {
+                    float *lo = &blockBounds[b * 6], *hi = lo + 3;
+                    std::fill(lo, lo + 3, std::numeric_limits<float>::max());
+                    std::fill(hi, hi + 3, -std::numeric_limits<float>::max());
+                    for (size_t v = b * grain; v < std::min(count, (b + 1) * grain); v++)
+                    {
+                        addToBounds(&mesh.vertices[v * F], lo, hi);
+                    }
+                });
+        std::fill(mesh.boundsMin, mesh.boundsMin + 3, count ? std::numeric_limits<float>::max() : 0.0f);
+        std::fill(mesh.boundsMax, mesh.boundsMax + 3, count ? -std::numeric_limits<float>::max() : 0.0f);
+        for (size_t b = 0; b < blocks; b++)
+        {
+            addToBounds(&blockBounds[b * 6], mesh.boundsMin, mesh.boundsMax);
+            addToBounds(&blockBounds[b * 6 + 3], mesh.boundsMin, mesh.boundsMax);
+        }
+    }
+} // namespace
+
+// ---------------------------------------------------------------------------
+// MeshData
+
+size_t mesh::MeshData::vertexCount() const
+{
+    return vertices.size() / FLOATS_PER_VERTEX;
+}
+
+void mesh::MeshData::clear()
+{
+    *this = MeshData{};
+}
+
+mesh::VertexLayout mesh::MeshData::layout(GLuint positionLocation, GLuint normalLocation, GLuint uvLocation) const
+{
+    VertexLayout layout;
+    layout.stride = FLOATS_PER_VERTEX * sizeof(float);
+    layout.attributes.push_back(VertexAttribute{positionLocation, 3, GL_FLOAT, GL_FALSE, false, 0});
+    layout.attributes.push_back(VertexAttribute{normalLocation, 3, GL_FLOAT, GL_FALSE, false, 3 * sizeof(float)});
+    layout.attributes.push_back(VertexAttribute{uvLocation, 2, GL_FLOAT, GL_FALSE, false, 6 * sizeof(float)});
+    return layout;
+}
+
+mesh::VertexLayout mesh::MeshData::tangentLayout(GLuint location) const
+{
+    VertexLayout layout;
+    layout.stride = 4 * sizeof(float);
+    layout.attributes.push_back(VertexAttribute{location, 4, GL_FLOAT, GL_FALSE, false, 0});
+    return layout;
+}
+
+// ---------------------------------------------------------------------------
+// parsing
+
+const char *mesh::parseFloat(const char *p, const char *end, float &value)
+{
+    const char *s = p;
+    bool negative = false;
+    if (s < end && (*s == '-' || *s == '+'))
+    {
+        negative = *s == '-';
+        s++;
+    }
+    uint64_t mantissa = 0;
+    int significant = 0, exponent = 0;
+    bool digits = false, exact = true;
+    for (; s < end && isDigit(*s); s++)
+    {
+        digits = true;
+        if (mantissa != 0 || *s != '0')
+        {
+            exact = exact && ++significant <= 19;
+            mantissa = mantissa * 10 + (*s - '0');
+        }
+    }
+    if (s < end && *s == '.')
+    {
+        for (s++; s < end && isDigit(*s); s++)
+        {
+            digits = true;
+            if (mantissa != 0 || *s != '0')
+            {
+                exact = exact && ++significant <= 19;
+                mantissa = mantissa * 10 + (*s - '0');
+            }
+            exponent--;
+        }
+    }
+    if (digits && s < end && (*s == 'e' || *s == 'E'))
+    {
+        long e = 0;
+        const char *next = parseInt(s + 1, end, e);
+        if (next != s + 1)
+        {
+            s = next;
+            exponent = static_cast<int>(std::clamp<long>(exponent + e, -100000, 100000));
+        }
+    }
+    bool hex = s < end && (*s == 'x' || *s == 'X');
+    if (digits && exact && !hex && mantissa < (1ull << 53) && exponent >= -22 && exponent <= 22)
+    {
+        double v = static_cast<double>(mantissa);
+        v = exponent < 0 ? v / POW10[-exponent] : v * POW10[exponent];
+        value = static_cast<float>(negative ? -v : v);
+        return s;
+    }
+
+    // everything else: inf, nan, hex floats, long mantissas, large exponents
+    char buffer[128];
+    size_t length = 0;
+    while (p + length < end && length < sizeof(buffer) - 1 && p[length] != ' ' && p[length] != '\t' &&
+           p[length] != '\r' && p[length] != '\n' && p[length] != '/')
+    {
+        buffer[length] = p[length];
+        length++;
+    }
+    buffer[length] = '\0';
+    char *parsedEnd = nullptr;
+    float parsed = std::strtof(buffer, &parsedEnd);
+    if (parsedEnd == buffer)
+    {
+        return p;
+    }
+    value = parsed;
+    return p + (parsedEnd - buffer);
+}
+
+// ---------------------------------------------------------------------------
+// OBJ
+
+bool mesh::loadObj(const std::filesystem::path &path, MeshData &mesh, const ImportSettings &settings)
+{
+    mesh.clear();
+    MappedFile file(path);
+    if (!file.isOpen())
+    {
+        std::cerr << "Failed to open mesh: " << path << std::endl;
+        return false;
+    }
+    const char *text = reinterpret_cast<const char *>(file.data());
+    size_t size = file.size();
+    bool multithreaded = settings.multithreaded;
+    unsigned int threads = multithreaded ? ThreadPool::shared().threadCount() : 1;
+
+    // chunks of at least 256 KB, a few per thread for load balancing, cut after a newline
+    size_t chunkCount = std::max<size_t>(1, std::min<size_t>(threads * 4, size / (256 << 10)));
+    std::vector<ObjChunk> chunks(chunkCount);
+    const char *previous = text;
+    for (size_t i = 0; i < chunkCount; i++)
+    {
+        const char *cut = text + size;
+        if (i + 1 < chunkCount)
+        {
+            cut = std::max(previous, text + size * (i + 1) / chunkCount);
+            const char *newline = static_cast<const char *>(std::memchr(cut, '\n', text + size - cut));
+            cut = newline ? newline + 1 : text + size;
+        }
+        chunks[i].begin = previous;
+        chunks[i].end = cut;
+        previous = cut;
+    }
+    forEach(chunkCount, multithreaded, [&chunks](size_t i)
+            { parseObjChunk(chunks[i]); });
+
+    // element offsets of every chunk
+    std::vector<size_t> positionBase(chunkCount + 1, 0), normalBase(chunkCount + 1, 0), uvBase(chunkCount + 1, 0),
+        cornerBase(chunkCount + 1, 0), triangleBase(chunkCount + 1, 0);
+    for (size_t i = 0; i < chunkCount; i++)
+    {
+        if (chunks[i].errorLine != 0)
+        {
+            size_t line = chunks[i].errorLine;
+            for (const char *p = text; p < chunks[i].begin; p++)
+            {
+                line += *p == '\n';
+            }
+            std::cerr << "Bad OBJ data at " << path << ":" << line << std::endl;
+            return false;
+        }
+        positionBase[i + 1] = positionBase[i] + chunks[i].positions.size() / 3;
+        normalBase[i + 1] = normalBase[i] + chunks[i].normals.size() / 3;
+        uvBase[i + 1] = uvBase[i] + chunks[i].uvs.size() / 2;
+        cornerBase[i + 1] = cornerBase[i] + chunks[i].corners.size() / 3;
+    }
+    size_t positionCount = positionBase[chunkCount], normalCount = normalBase[chunkCount], uvCount = uvBase[chunkCount];
+    size_t cornerCount = cornerBase[chunkCount];
+    if (cornerCount >= NO_INDEX)
+    {
+        std::cerr << "Mesh too large for 32 bit indices: " << path << std::endl;
+        return false;
+    }
+
+    // merge the element arrays and turn corners into global 0-based (v, vt, vn) keys
+    std::vector<float> positions(positionCount * 3), normals(normalCount * 3), uvs(uvCount * 2);
+    std::vector<uint32_t> keys(cornerCount * 3);
+    std::atomic<bool> valid{true};
+    forEach(chunkCount, multithreaded,
+            [&](size_t i)
+            {
+                ObjChunk &chunk = chunks[i];
+                std::copy(chunk.positions.begin(), chunk.positions.end(), positions.begin() + positionBase[i] * 3);
+                std::copy(chunk.normals.begin(), chunk.normals.end(), normals.begin() + normalBase[i] * 3);
+                std::copy(chunk.uvs.begin(), chunk.uvs.end(), uvs.begin() + uvBase[i] * 2);
+                bool ok = true;
+                uint32_t *dst = &keys[cornerBase[i] * 3];
+                for (size_t c = 0; c < chunk.corners.size(); c += 3)
+                {
+                    dst[c] = resolveObjIndex(chunk.corners[c], positionBase[i], positionCount, ok);
+                    dst[c + 1] = resolveObjIndex(chunk.corners[c + 1], uvBase[i], uvCount, ok);
+                    dst[c + 2] = resolveObjIndex(chunk.corners[c + 2], normalBase[i], normalCount, ok);
+                }
+                if (!ok)
+                {
+                    valid = false;
+                }
+                std::vector<float>().swap(chunk.positions);
+                std::vector<float>().swap(chunk.normals);
+                std::vector<float>().swap(chunk.uvs);
+                std::vector<uint32_t>().swap(chunk.corners);
+            });
+    if (!valid)
+    {
+        std::cerr << "OBJ face index out of range: " << path << std::endl;
+        return false;
+    }
+
+    // Unique corners become vertices. Corners are bucketed by hash so every partition
+    // owns its keys and can be deduplicated on its own thread.
+    size_t partitions = multithreaded ? std::max<size_t>(1, threads) : 1;
+    std::vector<size_t> counts(chunkCount * partitions, 0);
+    auto partitionOf = [&keys, partitions](size_t corner)
+    { return (CornerTable::hash(&keys[corner * 3]) >> 8) % partitions; };
+    forEach(chunkCount, multithreaded,
+            [&](size_t i)
+            {
+                for (size_t c = cornerBase[i]; c < cornerBase[i + 1]; c++)
+                {
+                    counts[i * partitions + partitionOf(c)]++;
+                }
+            });
+    // offsets ordered by partition, then chunk, so each partition sees its corners in file order
+    std::vector<size_t> offsets(chunkCount * partitions), partitionBegin(partitions + 1, 0);
+    size_t running = 0;
+    for (size_t p = 0; p < partitions; p++)
+    {
+        partitionBegin[p] = running;
+        for (size_t i = 0; i < chunkCount; i++)
+        {
+            offsets[i * partitions + p] = running;
+            running += counts[i * partitions + p];
+        }
+    }
+    partitionBegin[partitions] = running;
+    std::vector<uint32_t> order(cornerCount);
+    forEach(chunkCount, multithreaded,
+            [&](size_t i)
+            {
+                size_t *next = &offsets[i * partitions];
+                for (size_t c = cornerBase[i]; c < cornerBase[i + 1]; c++)
+                {
+                    order[next[partitionOf(c)]++] = static_cast<uint32_t>(c);
+                }
+            });
+
+    mesh.indices.resize(cornerCount);
+    std::vector<std::vector<uint32_t>> uniqueKeys(partitions);
+    forEach(partitions, multithreaded,
+            [&](size_t p)
+            {
+                CornerTable table((partitionBegin[p + 1] - partitionBegin[p]) / 4);
+                for (size_t o = partitionBegin[p]; o < partitionBegin[p + 1]; o++)
+                {
+                    uint32_t corner = order[o];
+                    const uint32_t *key = &keys[static_cast<size_t>(corner) * 3];
+                    mesh.indices[corner] = table.insert(key, CornerTable::hash(key));
+                }
+                uniqueKeys[p] = table.keys();
+            });
+    std::vector<uint32_t>().swap(order);
+
+    std::vector<size_t> vertexBase(partitions + 1, 0);
+    for (size_t p = 0; p < partitions; p++)
+    {
+        vertexBase[p + 1] = vertexBase[p] + uniqueKeys[p].size() / 3;
+    }
+    size_t vertexCount = vertexBase[partitions];
+    forEach(chunkCount, multithreaded,
+            [&](size_t i)
+            {
+                for (size_t c = cornerBase[i]; c < cornerBase[i + 1]; c++)
+                {
+                    mesh.indices[c] += static_cast<uint32_t>(vertexBase[partitionOf(c)]);
+                }
+            });
+
+    const int F = MeshData::FLOATS_PER_VERTEX;
+    mesh.vertices.assign(vertexCount * F, 0.0f);
+    std::vector<uint32_t> vertexPosition(vertexCount);
+    forEach(partitions, multithreaded,
+            [&](size_t p)
+            {
+                const std::vector<uint32_t> &unique = uniqueKeys[p];
+                for (size_t u = 0; u < unique.size() / 3; u++)
+                {
+                    size_t v = vertexBase[p] + u;
+                    float *dst = &mesh.vertices[v * F];
+                    const uint32_t *key = &unique[u * 3];
+                    std::copy(&positions[static_cast<size_t>(key[0]) * 3], &positions[static_cast<size_t>(key[0]) * 3] + 3,
+                              dst);
+                    if (key[2] != NO_INDEX)
+                    {
+                        std::copy(&normals[static_cast<size_t>(key[2]) * 3], &normals[static_cast<size_t>(key[2]) * 3] + 3,
+                                  dst + 3);
+                    }
+                    if (key[1] != NO_INDEX)
+                    {
+                        dst[6] = uvs[static_cast<size_t>(key[1]) * 2];
+                        dst[7] = uvs[static_cast<size_t>(key[1]) * 2 + 1];
+                    }
+                    vertexPosition[v] = key[0];
+                }
+            });
+    mesh.hasNormals = normalCount > 0;
+    mesh.hasUvs = uvCount > 0;
+
+    if (!mesh.hasNormals && settings.generateNormals && vertexCount > 0)
+    {
+        // per file position, so vertices split only by uv seams still share a normal
+        std::vector<float> smooth(positionCount * 3, 0.0f);
+        accumulateNormals(mesh.vertices.data(), mesh.indices.data(), mesh.indices.size(), smooth.data(), positionCount,
+                          [&vertexPosition](uint32_t v)
+                          { return vertexPosition[v]; });
+        for (size_t v = 0; v < vertexCount; v++)
+        {
+            std::copy(&smooth[static_cast<size_t>(vertexPosition[v]) * 3],
+                      &smooth[static_cast<size_t>(vertexPosition[v]) * 3] + 3, &mesh.vertices[v * F + 3]);
+        }
+        mesh.hasNormals = true;
+    }
+
+    // submeshes follow usemtl, in file order
+    std::vector<std::pair<size_t, std::string>> materials;
+    for (size_t i = 0; i < chunkCount; i++)
+    {
+        for (auto &[triangle, name] : chunks[i].materials)
+        {
+            materials.emplace_back(cornerBase[i] / 3 + triangle, std::move(name));
+        }
+    }
+    size_t triangleCount = cornerCount / 3;
+    if (materials.empty() || materials.front().first > 0)
+    {
+        materials.insert(materials.begin(), {0, std::string()});
+    }
+    for (size_t m = 0; m < materials.size(); m++)
+    {
+        size_t first = materials[m].first;
+        size_t last = m + 1 < materials.size() ? materials[m + 1].first : triangleCount;
+        if (last > first)
+        {
+            mesh.submeshes.push_back(Submesh{static_cast<uint32_t>(first * 3), static_cast<uint32_t>((last - first) * 3),
+                                             materials[m].second});
+        }
+    }
+    if (settings.generateTangents && mesh.hasNormals && mesh.hasUvs)
+    {
+        generateTangents(mesh, multithreaded);
+    }
+    computeBounds(mesh, multithreaded);
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// glTF
+
+bool mesh::loadGltf(const std::filesystem::path &path, MeshData &mesh, const ImportSettings &settings)
+{
+    mesh.clear();
+    Gltf gltf;
+    if (!openGltf(path, gltf))
+    {
+        return false;
+    }
+    const Json &json = gltf.json;
+    const float identity[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+
+    std::vector<PrimitiveInstance> instances;
+    const Json *scenes = json.find("scenes");
+    const Json *scene = scenes ? scenes->at(static_cast<size_t>(json.numberOr("scene", 0))) : nullptr;
+    const Json *roots = scene ? scene->find("nodes") : nullptr;
+    if (roots)
+    {
+        for (const Json &root : roots->items)
+        {
+            collectNode(json, static_cast<size_t>(root.number), identity, instances, 0);
+        }
+    }
+    else if (const Json *meshes = json.find("meshes"))
+    {
+        // no scene: every mesh once, untransformed
+        for (const Json &meshJson : meshes->items)
+        {
+            const Json *primitives = meshJson.find("primitives");
+            for (size_t i = 0; primitives && i < primitives->items.size(); i++)
+            {
+                PrimitiveInstance instance{&primitives->items[i], {}, 0, 0};
+                std::memcpy(instance.matrix, identity, sizeof(identity));
+                instances.push_back(instance);
+            }
+        }
+    }
+
+    // sizes first, so every primitive can be written in place
+    std::vector<PrimitiveInstance> triangles;
+    for (PrimitiveInstance &instance : instances)
+    {
+        if (instance.primitive->numberOr("mode", GLTF_TRIANGLES) != GLTF_TRIANGLES)
+        {
+            continue;
+        }
+        const Json *attributes = instance.primitive->find("attributes");
+        Accessor position, indices;
+        if (!attributes || !getAccessor(gltf, attributes->find("POSITION"), position) || position.components != 3)
+        {
+            std::cerr << "glTF primitive without usable POSITION in " << path << std::endl;
+            return false;
+        }
+        instance.vertexCount = position.count;
+        instance.indexCount = position.count;
+        if (instance.primitive->find("indices"))
+        {
+            if (!getAccessor(gltf, instance.primitive->find("indices"), indices) || indices.components != 1)
+            {
+                std::cerr << "Invalid glTF indices in " << path << std::endl;
+                return false;
+            }
+            instance.indexCount = indices.count;
+        }
+        triangles.push_back(instance);
+    }
+    size_t vertexTotal = 0, indexTotal = 0;
+    for (const PrimitiveInstance &instance : triangles)
+    {
+        vertexTotal += instance.vertexCount;
+        indexTotal += instance.indexCount - instance.indexCount % 3;
+    }
+    if (vertexTotal >= NO_INDEX)
+    {
+        std::cerr << "Mesh too large for 32 bit indices: " << path << std::endl;
+        return false;
+    }
+
+    const int F = MeshData::FLOATS_PER_VERTEX;
+    mesh.vertices.assign(vertexTotal * F, 0.0f);
+    mesh.indices.resize(indexTotal);
+    const Json *materials = json.find("materials");
+    size_t vertexBase = 0, indexBase = 0;
+    bool allNormals = !triangles.empty();
+    const size_t grain = 1 << 15;
+    for (const PrimitiveInstance &instance : triangles)
+    {
+        const Json *attributes = instance.primitive->find("attributes");
+        Accessor position, normal, uv, indices;
+        getAccessor(gltf, attributes->find("POSITION"), position);
+        bool hasNormal = getAccessor(gltf, attributes->find("NORMAL"), normal) && normal.components == 3 &&
+                         normal.count == position.count;
+        bool hasUv = getAccessor(gltf, attributes->find("TEXCOORD_0"), uv) && uv.components == 2 &&
+                     uv.count == position.count;
+        bool indexed = getAccessor(gltf, instance.primitive->find("indices"), indices);
+
+        const float *m = instance.matrix;
+        // normals use the cofactor matrix, which is the inverse transpose up to scale
+        float n[9] = {m[5] * m[10] - m[6] * m[9], m[6] * m[8] - m[4] * m[10], m[4] * m[9] - m[5] * m[8],
+                      m[2] * m[9] - m[1] * m[10], m[0] * m[10] - m[2] * m[8], m[1] * m[8] - m[0] * m[9],
+                      m[1] * m[6] - m[2] * m[5],  m[2] * m[4] - m[0] * m[6],  m[0] * m[5] - m[1] * m[4]};
+        float determinant = m[0] * n[0] + m[4] * n[3] + m[8] * n[6];
+        float *base = &mesh.vertices[vertexBase * F];
+        size_t count = position.count;
+        auto convert = [&](size_t begin, size_t end)
+        {
+            for (size_t v = begin; v < end; v++)
+            {
+                float *dst = base + v * F;
+                float p[3], q[3];
+                for (int k = 0; k < 3; k++)
+                {
+                    p[k] = readComponent(position.data + v * position.stride + k * componentSize(position.componentType),
+                                         position.componentType, position.normalized);
+                }
+                for (int k = 0; k < 3; k++)
+                {
+                    dst[k] = m[k] * p[0] + m[4 + k] * p[1] + m[8 + k] * p[2] + m[12 + k];
+                }
+                if (hasNormal)
+                {
+                    for (int k = 0; k < 3; k++)
+                    {
+                        q[k] = readComponent(normal.data + v * normal.stride + k * componentSize(normal.componentType),
+                                             normal.componentType, normal.normalized);
+                    }
+                    for (int k = 0; k < 3; k++)
+                    {
+                        dst[3 + k] = n[k * 3] * q[0] + n[k * 3 + 1] * q[1] + n[k * 3 + 2] * q[2];
+                    }
+                    normalize3(dst + 3);
+                }
+                if (hasUv)
+                {
+                    for (int k = 0; k < 2; k++)
+                    {
+                        dst[6 + k] = readComponent(uv.data + v * uv.stride + k * componentSize(uv.componentType),
+                                                   uv.componentType, uv.normalized);
+                    }
+                }
+            }
+        };
+        if (settings.multithreaded)
+        {
+            ThreadPool::shared().parallelFor(count, grain, convert);
+        }
+        else
+        {
+            convert(0, count);
+        }
+
+        size_t indexCount = instance.indexCount - instance.indexCount % 3;
+        uint32_t *dstIndices = &mesh.indices[indexBase];
+        bool ok = true;
+        for (size_t i = 0; i < indexCount; i++)
+        {
+            uint32_t index = indexed ? readIndex(indices.data + i * indices.stride, indices.componentType)
+                                     : static_cast<uint32_t>(i);
+            ok = ok && index < count;
+            dstIndices[i] = static_cast<uint32_t>(vertexBase) + std::min<uint32_t>(index, static_cast<uint32_t>(count - 1));
+        }
+        if (!ok)
+        {
+            std::cerr << "glTF index out of range in " << path << std::endl;
+            return false;
+        }
+        // a mirroring transform turns the winding around
+        if (determinant < 0.0f)
+        {
+            for (size_t i = 0; i + 2 < indexCount; i += 3)
+            {
+                std::swap(dstIndices[i + 1], dstIndices[i + 2]);
+            }
+        }
+        if (!hasNormal && settings.generateNormals)
+        {
+            std::vector<float> smooth(count * 3, 0.0f);
+            uint32_t first = static_cast<uint32_t>(vertexBase);
+            accumulateNormals(mesh.vertices.data(), dstIndices, indexCount, smooth.data(), count,
+                              [first](uint32_t v)
+                              { return v - first; });
+            for (size_t v = 0; v < count; v++)
+            {
+                std::copy(&smooth[v * 3], &smooth[v * 3] + 3, base + v * F + 3);
+            }
+            hasNormal = true;
+        }
+        allNormals = allNormals && hasNormal;
+        mesh.hasUvs = mesh.hasUvs || hasUv;
+
+        size_t materialIndex = static_cast<size_t>(instance.primitive->numberOr("material", -1));
+        const Json *material = materials ? materials->at(materialIndex) : nullptr;
+        std::string name = material ? material->stringOr("name", "material " + std::to_string(materialIndex)) : "";
+        mesh.submeshes.push_back(Submesh{static_cast<uint32_t>(indexBase), static_cast<uint32_t>(indexCount), name});
+        vertexBase += count;
+        indexBase += indexCount;
+    }
+    mesh.hasNormals = allNormals;
+    if (settings.generateTangents && mesh.hasNormals && mesh.hasUvs)
+    {
+        generateTangents(mesh, settings.multithreaded);
+    }
+    computeBounds(mesh, settings.multithreaded);
+    return true;
+}
+
+bool mesh::loadMesh(const std::filesystem::path &path, MeshData &mesh, const ImportSettings &settings)
+{
+    std::string extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](unsigned char c)
+                   { return static_cast<char>(std::tolower(c)); });
+    if (extension == ".obj")
+    {
+        return loadObj(path, mesh, settings);
+    }
+    if (extension == ".gltf" || extension == ".glb")
+    {
+        return loadGltf(path, mesh, settings);
+    }
+    std::cerr << "Unknown mesh format: " << path << std::endl;
+    return false;
+}
@@ -0,0 +1,72 @@
+#ifndef MESH_IMPORT_HPP
+#define MESH_IMPORT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "vertex_quantize.hpp"
+
+// Wavefront OBJ and glTF 2.0 (.gltf + .bin, .glb) import into buffers that go
+// straight to glBufferData. Files are memory mapped. OBJ text is split at line
+// boundaries and parsed on ThreadPool::shared(), glTF accessors are read from the
+// mapped buffers in place and interleaved in parallel.
+namespace mesh
+{
+    struct Submesh
+    {
+        uint32_t firstIndex;
+        uint32_t indexCount;
+        std::string material; // OBJ usemtl name, glTF material name (or "material <n>")
+    };
+
+    // Interleaved float vertices: position xyz, normal xyz, uv st (8 floats, 32 bytes).
+    // OBJ uvs have their origin at the bottom left (load textures flipped), glTF uvs at
+    // the top left (load them as they are).
+    struct MeshData
+    {
+        static const int FLOATS_PER_VERTEX = 8;
+
+        std::vector<float> vertices;
+        std::vector<uint32_t> indices;
+        std::vector<Submesh> submeshes;
+        float boundsMin[3] = {0.0f, 0.0f, 0.0f};
+        float boundsMax[3] = {0.0f, 0.0f, 0.0f};
+        bool hasNormals = false; // from the file or generated
+        bool hasUvs = false;
+        // MikkTSpace tangents as a second stream, 4 floats per vertex (xyz + bitangent sign)
+        std::vector<float> tangents;
+        bool hasTangents = false;
+
+        size_t vertexCount() const;
+        void clear();
+        VertexLayout layout(GLuint positionLocation = 0, GLuint normalLocation = 1, GLuint uvLocation = 2) const;
+        // for a buffer holding tangents
+        VertexLayout tangentLayout(GLuint location = 3) const;
+    };
+
+    struct ImportSettings
+    {
+        bool multithreaded = true;
+        bool generateNormals = true; // smooth, area weighted, when the file has none
+        bool generateTangents = false; // see mesh_tangents.hpp, when there are normals and uvs
+    };
+
+    // OBJ: v/vt/vn/f (polygons are fanned, negative indices allowed), usemtl starts a submesh
+    bool loadObj(const std::filesystem::path &path, MeshData &mesh, const ImportSettings &settings = ImportSettings{});
+    // glTF: triangle primitives of the default scene with node transforms applied, float or
+    // normalised integer attributes. Embedded base64 buffers and sparse accessors are not supported.
+    bool loadGltf(const std::filesystem::path &path, MeshData &mesh, const ImportSettings &settings = ImportSettings{});
+    // picks the loader from the extension
+    bool loadMesh(const std::filesystem::path &path, MeshData &mesh, const ImportSettings &settings = ImportSettings{});
+
+    // Decimal text to float without locale or errno, for the OBJ parser. Plain decimal
+    // and exponent notation up to 19 significant digits are converted directly, within
+    // one ulp of strtof; anything else (inf, nan, hex, longer mantissas) goes through strtof.
+    // Returns the position after the number, or p if there is none.
+    const char *parseFloat(const char *p, const char *end, float &value);
+} // namespace mesh
+
+#endif // MESH_IMPORT_HPP
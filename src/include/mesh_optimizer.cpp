@@ -0,0 +1,650 @@
+#include "mesh_optimizer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace
+{
+    const uint32_t NO_VERTEX = 0xFFFFFFFFu;
+    const size_t NO_TRIANGLE = static_cast<size_t>(-1);
+
+    // triangles using each vertex
+    struct Adjacency
+    {
+        std::vector<uint32_t> counts;
+        std::vector<uint32_t> offsets;
+        std::vector<uint32_t> triangles;
+    };
+
+    void buildAdjacency(Adjacency &adjacency, const uint32_t *indices, size_t indexCount, size_t vertexCount)
+    {
+        adjacency.counts.assign(vertexCount, 0);
+        adjacency.offsets.resize(vertexCount);
+        adjacency.triangles.resize(indexCount);
+        for (size_t i = 0; i < indexCount; i++)
+        {
+            adjacency.counts[indices[i]]++;
+        }
+        uint32_t offset = 0;
+        for (size_t v = 0; v < vertexCount; v++)
+        {
+            adjacency.offsets[v] = offset;
+            offset += adjacency.counts[v];
+        }
+        std::vector<uint32_t> fill(adjacency.offsets);
+        for (size_t i = 0; i < indexCount; i++)
+        {
+            adjacency.triangles[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+        }
+    }
+
+    // FIFO cache with timestamps: a vertex is resident while fewer than size misses
+    // happened since it was loaded
+    class FifoCache
+    {
+    public:
+        FifoCache(size_t vertexCount, unsigned int size) : m_stamps(vertexCount, 0), m_time{size + 1}, m_size{size} {};
+
+        // true on a miss
+        bool access(uint32_t v)
+        {
+            if (m_time - m_stamps[v] > m_size)
+            {
+                m_stamps[v] = m_time++;
+                return true;
+            }
+            return false;
+        }
+
+        void flush()
+        {
+            m_time += m_size + 1;
+        }
+
+    private:
+        // vars
+        std::vector<uint32_t> m_stamps;
+        uint32_t m_time;
+        unsigned int m_size;
+    };
+
+    // Forsyth's scoring, the constants from the original article
+    const int FORSYTH_CACHE_SIZE = 32;
+    const int FORSYTH_MAX_VALENCE = 32;
+
+    struct ForsythTables
+    {
+        float cache[FORSYTH_CACHE_SIZE];
+        float valence[FORSYTH_MAX_VALENCE];
+    };
+
+    const ForsythTables &forsythTables()
+    {
+        static const ForsythTables tables = []
+        {
+            ForsythTables t;
+            for (int i = 0; i < FORSYTH_CACHE_SIZE; i++)
+            {
+                // the last triangle's vertices get a fixed score so it is not simply repeated
+                t.cache[i] = i < 3 ? 0.75f
+                                   : std::pow(1.0f - static_cast<float>(i - 3) / (FORSYTH_CACHE_SIZE - 3), 1.5f);
+            }
+            t.valence[0] = 0.0f;
+            for (int i = 1; i < FORSYTH_MAX_VALENCE; i++)
+            {
+                // vertices with few triangles left are finished first, avoiding isolated leftovers
+                t.valence[i] = 2.0f / std::sqrt(static_cast<float>(i));
+            }
+            return t;
+        }();
+        return tables;
+    }
+
+    float forsythScore(int cachePosition, uint32_t liveTriangles)
+    {
+        if (liveTriangles == 0)
+        {
+            return -1.0f;
+        }
+        const ForsythTables &tables = forsythTables();
+        float score = cachePosition >= 0 ? tables.cache[cachePosition] : 0.0f;
+        return score + tables.valence[std::min<uint32_t>(liveTriangles, FORSYTH_MAX_VALENCE - 1)];
+    }
+
+    void removeTriangle(Adjacency &adjacency, std::vector<uint32_t> &live, uint32_t v, uint32_t triangle)
+    {
+        uint32_t *list = &adjacency.triangles[adjacency.offsets[v]];
+        for (uint32_t i = 0; i < live[v]; i++)
+        {
+            if (list[i] == triangle)
+            {
+                list[i] = list[live[v] - 1];
+                live[v]--;
+                return;
+            }
+        }
+    }
+
+    const float *positionAt(const float *positions, size_t stride, uint32_t v)
+    {
+        return reinterpret_cast<const float *>(reinterpret_cast<const unsigned char *>(positions) + stride * v);
+    }
+} // namespace
+
+// ---------------------------------------------------------------------------
+// indexing
+
+size_t mesh::deduplicateVertices(const void *vertices, size_t vertexCount, size_t vertexSize,
+                                 std::vector<unsigned char> &uniqueVertices, std::vector<uint32_t> &indices)
+{
+    const unsigned char *src = static_cast<const unsigned char *>(vertices);
+    uniqueVertices.clear();
+    uniqueVertices.reserve(vertexCount * vertexSize);
+    indices.resize(vertexCount);
+
+    // open addressing, at most half full
+    size_t tableSize = 1;
+    while (tableSize < vertexCount * 2)
+    {
+        tableSize <<= 1;
+    }
+    std::vector<uint32_t> table(tableSize, NO_VERTEX);
+    size_t unique = 0;
+    for (size_t i = 0; i < vertexCount; i++)
+    {
+        const unsigned char *vertex = src + i * vertexSize;
+        uint64_t hash = 14695981039346656037ull; // FNV-1a over 32 bit words, bytes for the tail
+        size_t b = 0;
+        for (; b + 4 <= vertexSize; b += 4)
+        {
+            uint32_t word;
+            std::memcpy(&word, vertex + b, 4);
+            hash = (hash ^ word) * 1099511628211ull;
+        }
+        for (; b < vertexSize; b++)
+        {
+            hash = (hash ^ vertex[b]) * 1099511628211ull;
+        }
+        hash ^= hash >> 29;
+        size_t slot = static_cast<size_t>(hash) & (tableSize - 1);
+        while (table[slot] != NO_VERTEX &&
+               std::memcmp(&uniqueVertices[table[slot] * vertexSize], vertex, vertexSize) != 0)
+        {
+            slot = (slot + 1) & (tableSize - 1);
+        }
+        if (table[slot] == NO_VERTEX)
+        {
+            table[slot] = static_cast<uint32_t>(unique++);
+            uniqueVertices.insert(uniqueVertices.end(), vertex, vertex + vertexSize);
+        }
+        indices[i] = table[slot];
+    }
+    return unique;
+}
+
+// ---------------------------------------------------------------------------
+// vertex cache
+
+void mesh::optimizeVertexCache(uint32_t *dst, const uint32_t *indices, size_t indexCount, size_t vertexCount)
+{
+    size_t triangleCount = indexCount / 3;
+    std::vector<uint32_t> source(indices, indices + triangleCount * 3);
+    Adjacency adjacency;
+    buildAdjacency(adjacency, source.data(), source.size(), vertexCount);
+    std::vector<uint32_t> live(adjacency.counts);
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> vertexScore(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++)
+    {
+        vertexScore[v] = forsythScore(-1, live[v]);
+    }
+    std::vector<float> triangleScore(triangleCount);
+    std::vector<char> emitted(triangleCount, 0);
+    size_t best = NO_TRIANGLE;
+    float bestScore = -1.0f;
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        const uint32_t *tri = &source[t * 3];
+        triangleScore[t] = vertexScore[tri[0]] + vertexScore[tri[1]] + vertexScore[tri[2]];
+        if (triangleScore[t] > bestScore)
+        {
+            bestScore = triangleScore[t];
+            best = t;
+        }
+    }
+
+    uint32_t cache[FORSYTH_CACHE_SIZE + 3];
+    uint32_t nextCache[FORSYTH_CACHE_SIZE + 3];
+    int cacheCount = 0;
+    size_t cursor = 0;
+    for (size_t out = 0; out < triangleCount; out++)
+    {
+        if (best == NO_TRIANGLE)
+        {
+            // nothing left around the cache, restart at the next triangle in input order
+            while (emitted[cursor])
+            {
+                cursor++;
+            }
+            best = cursor;
+        }
+        const uint32_t *tri = &source[best * 3];
+        std::memcpy(dst + out * 3, tri, 3 * sizeof(uint32_t));
+        emitted[best] = 1;
+        for (int k = 0; k < 3; k++)
+        {
+            removeTriangle(adjacency, live, tri[k], static_cast<uint32_t>(best));
+        }
+
+        // the triangle's vertices move to the front, the rest shift back; three extra
+        // entries are kept so vertices that just fell out get their score lowered
+        int nextCount = 0;
+        for (int k = 0; k < 3; k++)
+        {
+            if (std::find(nextCache, nextCache + nextCount, tri[k]) == nextCache + nextCount)
+            {
+                nextCache[nextCount++] = tri[k];
+            }
+        }
+        for (int i = 0; i < cacheCount && nextCount < FORSYTH_CACHE_SIZE + 3; i++)
+        {
+            uint32_t v = cache[i];
+            if (v != tri[0] && v != tri[1] && v != tri[2])
+            {
+                nextCache[nextCount++] = v;
+            }
+        }
+        std::copy(nextCache, nextCache + nextCount, cache);
+        cacheCount = nextCount;
+
+        for (int i = 0; i < cacheCount; i++)
+        {
+            uint32_t v = cache[i];
+            cachePosition[v] = i < FORSYTH_CACHE_SIZE ? i : -1;
+            vertexScore[v] = forsythScore(cachePosition[v], live[v]);
+        }
+        best = NO_TRIANGLE;
+        bestScore = -1.0f;
+        for (int i = 0; i < cacheCount; i++)
+        {
+            uint32_t v = cache[i];
+            const uint32_t *list = &adjacency.triangles[adjacency.offsets[v]];
+            for (uint32_t j = 0; j < live[v]; j++)
+            {
+                const uint32_t *other = &source[list[j] * 3];
+                float score = vertexScore[other[0]] + vertexScore[other[1]] + vertexScore[other[2]];
+                triangleScore[list[j]] = score;
+                if (score > bestScore)
+                {
+                    bestScore = score;
+                    best = list[j];
+                }
+            }
+        }
+    }
+}
+
+void mesh::optimizeVertexCacheFifo(uint32_t *dst, const uint32_t *indices, size_t indexCount, size_t vertexCount,
+                                   unsigned int cacheSize)
+{
+    size_t triangleCount = indexCount / 3;
+    std::vector<uint32_t> source(indices, indices + triangleCount * 3);
+    Adjacency adjacency;
+    buildAdjacency(adjacency, source.data(), source.size(), vertexCount);
+    std::vector<uint32_t> live(adjacency.counts);
+
+    std::vector<uint32_t> stamps(vertexCount, 0);
+    uint32_t time = cacheSize + 1;
+    std::vector<char> emitted(triangleCount, 0);
+    std::vector<uint32_t> deadEnd;
+    std::vector<uint32_t> candidates;
+    size_t cursor = 0;
+    size_t out = 0;
+
+    auto nextLive = [&]() -> uint32_t
+    {
+        while (cursor < vertexCount && live[cursor] == 0)
+        {
+            cursor++;
+        }
+        return cursor < vertexCount ? static_cast<uint32_t>(cursor) : NO_VERTEX;
+    };
+
+    uint32_t fan = nextLive();
+    while (fan != NO_VERTEX)
+    {
+        // emit every remaining triangle around the fanning vertex
+        candidates.clear();
+        const uint32_t *list = &adjacency.triangles[adjacency.offsets[fan]];
+        for (uint32_t j = 0; j < adjacency.counts[fan]; j++)
+        {
+            uint32_t t = list[j];
+            if (emitted[t])
+            {
+                continue;
+            }
+            emitted[t] = 1;
+            for (int k = 0; k < 3; k++)
+            {
+                uint32_t v = source[t * 3 + k];
+                dst[out++] = v;
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                live[v]--;
+                if (time - stamps[v] > cacheSize)
+                {
+                    stamps[v] = time++;
+                }
+            }
+        }
+
+        // next fan: the candidate that stays in the cache longest while its triangles are emitted
+        fan = NO_VERTEX;
+        int bestPriority = -1;
+        for (uint32_t v : candidates)
+        {
+            if (live[v] == 0)
+            {
+                continue;
+            }
+            int priority = 0;
+            if (time - stamps[v] + 2 * live[v] <= cacheSize)
+            {
+                priority = static_cast<int>(time - stamps[v]);
+            }
+            if (priority > bestPriority)
+            {
+                bestPriority = priority;
+                fan = v;
+            }
+        }
+        // dead end: walk back through recently emitted vertices, then fall back to input order
+        while (fan == NO_VERTEX && !deadEnd.empty())
+        {
+            uint32_t v = deadEnd.back();
+            deadEnd.pop_back();
+            if (live[v] > 0)
+            {
+                fan = v;
+            }
+        }
+        if (fan == NO_VERTEX)
+        {
+            fan = nextLive();
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// overdraw
+
+void mesh::optimizeOverdraw(uint32_t *dst, const uint32_t *indices, size_t indexCount, const float *positions,
+                            size_t vertexCount, size_t positionStride, float threshold)
+{
+    const unsigned int cacheSize = 16;
+    size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0)
+    {
+        return;
+    }
+
+    // hard boundaries: triangles whose three vertices all miss
+    std::vector<size_t> hard;
+    {
+        FifoCache cache(vertexCount, cacheSize);
+        for (size_t t = 0; t < triangleCount; t++)
+        {
+            int misses = cache.access(indices[t * 3]) + cache.access(indices[t * 3 + 1]) + cache.access(indices[t * 3 + 2]);
+            if (t == 0 || misses == 3)
+            {
+                hard.push_back(t);
+            }
+        }
+        hard.push_back(triangleCount);
+    }
+
+    // soft boundaries: inside each hard cluster, cut wherever the run since the last cut
+    // (starting cold) is already within threshold of the cluster's own ACMR
+    std::vector<size_t> clusters;
+    FifoCache cache(vertexCount, cacheSize);
+    for (size_t c = 0; c + 1 < hard.size(); c++)
+    {
+        size_t start = hard[c], end = hard[c + 1];
+        cache.flush();
+        size_t clusterMisses = 0;
+        for (size_t t = start; t < end; t++)
+        {
+            clusterMisses += cache.access(indices[t * 3]) + cache.access(indices[t * 3 + 1]) +
+                             cache.access(indices[t * 3 + 2]);
+        }
+        float limit = threshold * static_cast<float>(clusterMisses) / static_cast<float>(end - start);
+
+        cache.flush();
+        clusters.push_back(start);
+        size_t last = start, misses = 0;
+        for (size_t t = start; t < end; t++)
+        {
+            misses += cache.access(indices[t * 3]) + cache.access(indices[t * 3 + 1]) + cache.access(indices[t * 3 + 2]);
+            float acmr = static_cast<float>(misses) / static_cast<float>(t + 1 - last);
+            if (t + 1 < end && acmr <= limit)
+            {
+                clusters.push_back(t + 1);
+                last = t + 1;
+                misses = 0;
+                cache.flush();
+            }
+        }
+    }
+    clusters.push_back(triangleCount);
+
+    double meshCenter[3] = {0.0, 0.0, 0.0};
+    for (size_t v = 0; v < vertexCount; v++)
+    {
+        const float *p = positionAt(positions, positionStride, static_cast<uint32_t>(v));
+        meshCenter[0] += p[0];
+        meshCenter[1] += p[1];
+        meshCenter[2] += p[2];
+    }
+    for (double &m : meshCenter)
+    {
+        m /= std::max<size_t>(vertexCount, 1);
+    }
+
+    // sort key: how far the area weighted cluster centre lies out along the cluster's normal
+    size_t clusterCount = clusters.size() - 1;
+    std::vector<float> keys(clusterCount);
+    for (size_t c = 0; c < clusterCount; c++)
+    {
+        double center[3] = {0.0, 0.0, 0.0}, normal[3] = {0.0, 0.0, 0.0}, area = 0.0;
+        for (size_t t = clusters[c]; t < clusters[c + 1]; t++)
+        {
+            const float *a = positionAt(positions, positionStride, indices[t * 3]);
+            const float *b = positionAt(positions, positionStride, indices[t * 3 + 1]);
+            const float *d = positionAt(positions, positionStride, indices[t * 3 + 2]);
+            double e1[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+            double e2[3] = {d[0] - a[0], d[1] - a[1], d[2] - a[2]};
+            double n[3] = {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0]};
+            double twiceArea = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            for (int k = 0; k < 3; k++)
+            {
+                center[k] += (a[k] + b[k] + d[k]) / 3.0 * twiceArea;
+                normal[k] += n[k];
+            }
+            area += twiceArea;
+        }
+        double length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+        double key = 0.0;
+        if (area > 0.0 && length > 0.0)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                key += (center[k] / area - meshCenter[k]) * normal[k] / length;
+            }
+        }
+        keys[c] = static_cast<float>(key);
+    }
+
+    std::vector<size_t> order(clusterCount);
+    for (size_t c = 0; c < clusterCount; c++)
+    {
+        order[c] = c;
+    }
+    std::stable_sort(order.begin(), order.end(), [&keys](size_t a, size_t b)
+                     { return keys[a] > keys[b]; });
+
+    size_t out = 0;
+    for (size_t c : order)
+    {
+        size_t count = (clusters[c + 1] - clusters[c]) * 3;
+        std::memcpy(dst + out, indices + clusters[c] * 3, count * sizeof(uint32_t));
+        out += count;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// vertex fetch
+
+size_t mesh::optimizeVertexFetch(void *dstVertices, uint32_t *indices, size_t indexCount, const void *vertices,
+                                 size_t vertexCount, size_t vertexSize)
+{
+    std::vector<uint32_t> remap(vertexCount, NO_VERTEX);
+    unsigned char *dst = static_cast<unsigned char *>(dstVertices);
+    const unsigned char *src = static_cast<const unsigned char *>(vertices);
+    uint32_t next = 0;
+    for (size_t i = 0; i < indexCount; i++)
+    {
+        uint32_t v = indices[i];
+        if (remap[v] == NO_VERTEX)
+        {
+            remap[v] = next;
+            std::memcpy(dst + static_cast<size_t>(next) * vertexSize, src + static_cast<size_t>(v) * vertexSize,
+                        vertexSize);
+            next++;
+        }
+        indices[i] = remap[v];
+    }
+    return next;
+}
+
+// ---------------------------------------------------------------------------
+// analysis
+
+mesh::CacheStats mesh::analyzeVertexCache(const uint32_t *indices, size_t indexCount, size_t vertexCount,
+                                          unsigned int cacheSize)
+{
+    CacheStats stats{0.0f, 0.0f, 0};
+    FifoCache cache(vertexCount, cacheSize);
+    std::vector<char> used(vertexCount, 0);
+    size_t unique = 0;
+    for (size_t i = 0; i < indexCount; i++)
+    {
+        stats.transformed += cache.access(indices[i]);
+        unique += !used[indices[i]];
+        used[indices[i]] = 1;
+    }
+    if (indexCount >= 3)
+    {
+        stats.acmr = static_cast<float>(stats.transformed) / static_cast<float>(indexCount / 3);
+        stats.atvr = static_cast<float>(stats.transformed) / static_cast<float>(unique);
+    }
+    return stats;
+}
+
+mesh::OverdrawStats mesh::analyzeOverdraw(const uint32_t *indices, size_t indexCount, const float *positions,
+                                          size_t vertexCount, size_t positionStride)
+{
+    const int GRID = 256;
+    OverdrawStats stats{0.0f, 0, 0};
+    if (vertexCount == 0)
+    {
+        return stats;
+    }
+    float lo[3], hi[3];
+    for (int k = 0; k < 3; k++)
+    {
+        lo[k] = std::numeric_limits<float>::max();
+        hi[k] = -std::numeric_limits<float>::max();
+    }
+    for (size_t v = 0; v < vertexCount; v++)
+    {
+        const float *p = positionAt(positions, positionStride, static_cast<uint32_t>(v));
+        for (int k = 0; k < 3; k++)
+        {
+            lo[k] = std::min(lo[k], p[k]);
+            hi[k] = std::max(hi[k], p[k]);
+        }
+    }
+    float extent = std::max({hi[0] - lo[0], hi[1] - lo[1], hi[2] - lo[2], 1e-20f});
+    float scale = (GRID - 1) / extent;
+
+    std::vector<float> depth(GRID * GRID);
+    for (int axis = 0; axis < 3; axis++)
+    {
+        for (float sign : {1.0f, -1.0f})
+        {
+            // looking down the axis from the sign side, smaller depth is closer
+            std::fill(depth.begin(), depth.end(), std::numeric_limits<float>::max());
+            int uAxis = (axis + 1) % 3, vAxis = (axis + 2) % 3;
+            for (size_t t = 0; t + 2 < indexCount; t += 3)
+            {
+                float x[3], y[3], z[3];
+                const float *p[3];
+                for (int k = 0; k < 3; k++)
+                {
+                    p[k] = positionAt(positions, positionStride, indices[t + k]);
+                    x[k] = (p[k][uAxis] - lo[uAxis]) * scale;
+                    y[k] = (p[k][vAxis] - lo[vAxis]) * scale;
+                    z[k] = -sign * p[k][axis];
+                }
+                // face normal along the view axis, front faces point at the viewer
+                float e1u = p[1][uAxis] - p[0][uAxis], e1v = p[1][vAxis] - p[0][vAxis];
+                float e2u = p[2][uAxis] - p[0][uAxis], e2v = p[2][vAxis] - p[0][vAxis];
+                float normal = e1u * e2v - e1v * e2u;
+                if (normal * sign <= 0.0f)
+                {
+                    continue;
+                }
+                float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+                if (area == 0.0f)
+                {
+                    continue;
+                }
+                int minX = std::max(0, static_cast<int>(std::floor(std::min({x[0], x[1], x[2]}))));
+                int maxX = std::min(GRID - 1, static_cast<int>(std::ceil(std::max({x[0], x[1], x[2]}))));
+                int minY = std::max(0, static_cast<int>(std::floor(std::min({y[0], y[1], y[2]}))));
+                int maxY = std::min(GRID - 1, static_cast<int>(std::ceil(std::max({y[0], y[1], y[2]}))));
+                float invArea = 1.0f / area;
+                for (int py = minY; py <= maxY; py++)
+                {
+                    for (int px = minX; px <= maxX; px++)
+                    {
+                        float cx = px + 0.5f, cy = py + 0.5f;
+                        float w0 = ((x[2] - x[1]) * (cy - y[1]) - (y[2] - y[1]) * (cx - x[1])) * invArea;
+                        float w1 = ((x[0] - x[2]) * (cy - y[2]) - (y[0] - y[2]) * (cx - x[2])) * invArea;
+                        float w2 = 1.0f - w0 - w1;
+                        if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f)
+                        {
+                            continue;
+                        }
+                        float d = w0 * z[0] + w1 * z[1] + w2 * z[2];
+                        float &stored = depth[py * GRID + px];
+                        if (d < stored)
+                        {
+                            stored = d;
+                            stats.shaded++;
+                        }
+                    }
+                }
+            }
+            for (float d : depth)
+            {
+                stats.covered += d != std::numeric_limits<float>::max();
+            }
+        }
+    }
+    stats.overdraw = stats.covered > 0 ? static_cast<float>(stats.shaded) / static_cast<float>(stats.covered) : 0.0f;
+    return stats;
+}
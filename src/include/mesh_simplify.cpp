@@ -0,0 +1,510 @@
+#include "mesh_simplify.hpp"
+#include "mesh_optimizer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace
+{
+    enum VertexKind
+    {
+        INTERIOR,
+        BORDER, // on an open boundary, only slides along it
+        LOCKED, // attribute seam, non-manifold, or a border that has to stay
+    };
+
+    // open borders are held in place by planes through the border edge, this much
+    // stiffer than the surface itself
+    const double BORDER_WEIGHT = 10.0;
+
+    // sum of weighted squared distances to planes (a, b, c, d), and the total weight
+    struct Quadric
+    {
+        double a2 = 0, b2 = 0, c2 = 0, d2 = 0;
+        double ab = 0, ac = 0, ad = 0, bc = 0, bd = 0, cd = 0;
+        double weight = 0;
+
+        void addPlane(double a, double b, double c, double d, double w)
+        {
+            a2 += w * a * a;
+            b2 += w * b * b;
+            c2 += w * c * c;
+            d2 += w * d * d;
+            ab += w * a * b;
+            ac += w * a * c;
+            ad += w * a * d;
+            bc += w * b * c;
+            bd += w * b * d;
+            cd += w * c * d;
+            weight += w;
+        }
+
+        void add(const Quadric &q)
+        {
+            a2 += q.a2;
+            b2 += q.b2;
+            c2 += q.c2;
+            d2 += q.d2;
+            ab += q.ab;
+            ac += q.ac;
+            ad += q.ad;
+            bc += q.bc;
+            bd += q.bd;
+            cd += q.cd;
+            weight += q.weight;
+        }
+
+        double evaluate(const float *p) const
+        {
+            double x = p[0], y = p[1], z = p[2];
+            double r = a2 * x * x + b2 * y * y + c2 * z * z + d2 + 2.0 * (ab * x * y + ac * x * z + bc * y * z) +
+                       2.0 * (ad * x + bd * y + cd * z);
+            return std::max(r, 0.0);
+        }
+    };
+
+    struct Collapse
+    {
+        uint32_t from;
+        uint32_t to;
+        float error;
+    };
+
+    const float *position(const float *positions, size_t stride, uint32_t v)
+    {
+        return reinterpret_cast<const float *>(reinterpret_cast<const unsigned char *>(positions) + v * stride);
+    }
+
+    // cross product of the edges, length = twice the area
+    void faceNormal(const float *a, const float *b, const float *c, double *n)
+    {
+        double e1[3] = {double(b[0]) - a[0], double(b[1]) - a[1], double(b[2]) - a[2]};
+        double e2[3] = {double(c[0]) - a[0], double(c[1]) - a[1], double(c[2]) - a[2]};
+        n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+        n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+        n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+    }
+
+    // largest side of the bounding box of the referenced vertices
+    float meshExtent(const uint32_t *indices, size_t indexCount, const float *positions, size_t stride)
+    {
+        float lo[3] = {std::numeric_limits<float>::max(), std::numeric_limits<float>::max(),
+                       std::numeric_limits<float>::max()};
+        float hi[3] = {-lo[0], -lo[1], -lo[2]};
+        for (size_t i = 0; i < indexCount; i++)
+        {
+            const float *p = position(positions, stride, indices[i]);
+            for (int k = 0; k < 3; k++)
+            {
+                lo[k] = std::min(lo[k], p[k]);
+                hi[k] = std::max(hi[k], p[k]);
+            }
+        }
+        float extent = indexCount > 0 ? std::max({hi[0] - lo[0], hi[1] - lo[1], hi[2] - lo[2]}) : 0.0f;
+        return extent > 0.0f ? extent : 1.0f;
+    }
+
+    // Classifies vertices by the topology of their position: vertices sharing a position
+    // are one point of the surface, so seams are not mistaken for borders.
+    std::vector<uint8_t> classifyVertices(const uint32_t *indices, size_t indexCount, const float *positions,
+                                          size_t vertexCount, size_t stride, bool lockBorder,
+                                          std::vector<uint32_t> &canonical, std::vector<uint64_t> &edges)
+    {
+        // first vertex at every position
+        canonical.resize(vertexCount);
+        size_t capacity = 16;
+        while (capacity < vertexCount * 2)
+        {
+            capacity <<= 1;
+        }
+        std::vector<uint32_t> table(capacity, std::numeric_limits<uint32_t>::max());
+        std::vector<uint32_t> groupSize(vertexCount, 0);
+        for (uint32_t v = 0; v < vertexCount; v++)
+        {
+            uint32_t bits[3];
+            std::memcpy(bits, position(positions, stride, v), sizeof(bits));
+            uint32_t h = (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+            size_t slot = h & (capacity - 1);
+            while (table[slot] != std::numeric_limits<uint32_t>::max() &&
+                   std::memcmp(position(positions, stride, table[slot]), bits, sizeof(bits)) != 0)
+            {
+                slot = (slot + 1) & (capacity - 1);
+            }
+            if (table[slot] == std::numeric_limits<uint32_t>::max())
+            {
+                table[slot] = v;
+            }
+            canonical[v] = table[slot];
+        }
+
+        // directed position edges: a missing twin is a border, a repeated one non-manifold
+        edges.clear();
+        edges.reserve(indexCount);
+        std::vector<uint8_t> used(vertexCount, 0);
+        for (size_t i = 0; i < indexCount; i++)
+        {
+            uint32_t a = indices[i], b = indices[i % 3 == 2 ? i - 2 : i + 1];
+            used[a] = 1;
+            edges.push_back(uint64_t{canonical[a]} << 32 | canonical[b]);
+        }
+        for (uint32_t v = 0; v < vertexCount; v++)
+        {
+            groupSize[canonical[v]] += used[v];
+        }
+        std::sort(edges.begin(), edges.end());
+        std::vector<uint8_t> onBorder(vertexCount, 0);
+        std::vector<uint8_t> complex(vertexCount, 0);
+        for (size_t i = 0; i < edges.size(); i++)
+        {
+            uint32_t a = static_cast<uint32_t>(edges[i] >> 32), b = static_cast<uint32_t>(edges[i]);
+            if (i + 1 < edges.size() && edges[i + 1] == edges[i])
+            {
+                complex[a] = complex[b] = 1;
+            }
+            if (!std::binary_search(edges.begin(), edges.end(), uint64_t{b} << 32 | a))
+            {
+                onBorder[a] = onBorder[b] = 1;
+            }
+        }
+
+        std::vector<uint8_t> kinds(vertexCount, LOCKED);
+        for (uint32_t v = 0; v < vertexCount; v++)
+        {
+            uint32_t c = canonical[v];
+            if (groupSize[c] > 1 || complex[c])
+            {
+                kinds[v] = LOCKED;
+            }
+            else if (onBorder[c])
+            {
+                kinds[v] = lockBorder ? LOCKED : BORDER;
+            }
+            else
+            {
+                kinds[v] = INTERIOR;
+            }
+        }
+        return kinds;
+    }
+} // namespace
+
+// ---------------------------------------------------------------------------
+// simplification
+
+size_t mesh::simplify(uint32_t *dst, const uint32_t *indices, size_t indexCount, const float *positions,
+                      size_t vertexCount, size_t positionStride, const SimplifySettings &settings, float *resultError)
+{
+    size_t target = settings.targetIndexCount / 3 * 3;
+    std::vector<uint32_t> work;
+    work.reserve(indexCount);
+    for (size_t i = 0; i + 2 < indexCount; i += 3)
+    {
+        uint32_t a = indices[i], b = indices[i + 1], c = indices[i + 2];
+        if (a != b && b != c && a != c)
+        {
+            work.insert(work.end(), {a, b, c});
+        }
+    }
+
+    std::vector<uint32_t> canonical;
+    std::vector<uint64_t> edges;
+    std::vector<uint8_t> kinds =
+        classifyVertices(work.data(), work.size(), positions, vertexCount, positionStride, settings.lockBorder,
+                         canonical, edges);
+
+    // area weighted face planes, plus planes along open borders
+    std::vector<Quadric> quadrics(vertexCount);
+    for (size_t i = 0; i < work.size(); i += 3)
+    {
+        const float *p[3] = {position(positions, positionStride, work[i]),
+                             position(positions, positionStride, work[i + 1]),
+                             position(positions, positionStride, work[i + 2])};
+        double n[3];
+        faceNormal(p[0], p[1], p[2], n);
+        double length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (length == 0.0)
+        {
+            continue;
+        }
+        double u[3] = {n[0] / length, n[1] / length, n[2] / length};
+        double d = -(u[0] * p[0][0] + u[1] * p[0][1] + u[2] * p[0][2]);
+        for (int k = 0; k < 3; k++)
+        {
+            quadrics[work[i + k]].addPlane(u[0], u[1], u[2], d, length * 0.5);
+        }
+        if (settings.lockBorder)
+        {
+            continue;
+        }
+        for (int k = 0; k < 3; k++)
+        {
+            uint32_t a = work[i + k], b = work[i + (k + 1) % 3];
+            if (kinds[a] != BORDER && kinds[b] != BORDER)
+            {
+                continue;
+            }
+            // only edges without a twin triangle
+            if (std::binary_search(edges.begin(), edges.end(), uint64_t{canonical[b]} << 32 | canonical[a]))
+            {
+                continue;
+            }
+            double e[3] = {double(p[(k + 1) % 3][0]) - p[k][0], double(p[(k + 1) % 3][1]) - p[k][1],
+                           double(p[(k + 1) % 3][2]) - p[k][2]};
+            double edge2 = e[0] * e[0] + e[1] * e[1] + e[2] * e[2];
+            double c[3] = {e[1] * u[2] - e[2] * u[1], e[2] * u[0] - e[0] * u[2], e[0] * u[1] - e[1] * u[0]};
+            double cl = std::sqrt(c[0] * c[0] + c[1] * c[1] + c[2] * c[2]);
+            if (cl == 0.0)
+            {
+                continue;
+            }
+            double pd = -(c[0] * p[k][0] + c[1] * p[k][1] + c[2] * p[k][2]) / cl;
+            quadrics[a].addPlane(c[0] / cl, c[1] / cl, c[2] / cl, pd, edge2 * BORDER_WEIGHT);
+            quadrics[b].addPlane(c[0] / cl, c[1] / cl, c[2] / cl, pd, edge2 * BORDER_WEIGHT);
+        }
+    }
+
+    auto attributeError = [&settings](uint32_t from, uint32_t to)
+    {
+        double sum = 0.0;
+        if (settings.attributes == nullptr)
+        {
+            return sum;
+        }
+        const float *a = position(settings.attributes, settings.attributeStride, from);
+        const float *b = position(settings.attributes, settings.attributeStride, to);
+        for (size_t k = 0; k < settings.attributeCount; k++)
+        {
+            double w = settings.attributeWeights ? settings.attributeWeights[k] : 1.0;
+            double d = w * (double(a[k]) - b[k]);
+            sum += d * d;
+        }
+        return sum;
+    };
+
+    float extent = meshExtent(work.data(), work.size(), positions, positionStride);
+    float errorLimit = settings.targetError * extent;
+    float reached = 0.0f;
+    std::vector<uint32_t> offsets(vertexCount + 1), adjacency, remap(vertexCount);
+    std::vector<uint8_t> passLocked(vertexCount);
+    std::vector<Collapse> collapses;
+    while (work.size() > target)
+    {
+        // triangles around every vertex
+        std::fill(offsets.begin(), offsets.end(), 0);
+        for (uint32_t v : work)
+        {
+            offsets[v + 1]++;
+        }
+        for (size_t v = 0; v < vertexCount; v++)
+        {
+            offsets[v + 1] += offsets[v];
+        }
+        adjacency.resize(work.size());
+        std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < work.size(); i++)
+        {
+            adjacency[fill[work[i]]++] = static_cast<uint32_t>(i / 3);
+        }
+        auto sharedTriangles = [&](uint32_t from, uint32_t to)
+        {
+            int shared = 0;
+            for (uint32_t a = offsets[from]; a < offsets[from + 1]; a++)
+            {
+                const uint32_t *tri = &work[adjacency[a] * 3];
+                shared += tri[0] == to || tri[1] == to || tri[2] == to;
+            }
+            return shared;
+        };
+
+        // every usable half edge collapse with the error it adds
+        collapses.clear();
+        for (size_t i = 0; i < work.size(); i++)
+        {
+            uint32_t edge[2] = {work[i], work[i % 3 == 2 ? i - 2 : i + 1]};
+            for (int direction = 0; direction < 2; direction++)
+            {
+                uint32_t from = edge[direction], to = edge[1 - direction];
+                if (kinds[from] == LOCKED || (kinds[from] == BORDER && (kinds[to] == INTERIOR || sharedTriangles(from, to) != 1)))
+                {
+                    continue;
+                }
+                const Quadric &q = quadrics[from];
+                double cost = q.evaluate(position(positions, positionStride, to)) + q.weight * attributeError(from, to);
+                float error = static_cast<float>(std::sqrt(cost / std::max(q.weight, 1e-30)));
+                collapses.push_back(Collapse{from, to, error});
+            }
+        }
+        std::sort(collapses.begin(), collapses.end(),
+                  [](const Collapse &a, const Collapse &b)
+                  { return a.error < b.error || (a.error == b.error && (a.from < b.from || (a.from == b.from && a.to < b.to))); });
+
+        // cheapest first, each neighbourhood once per pass so quadrics and flip tests stay exact
+        for (uint32_t v = 0; v < vertexCount; v++)
+        {
+            remap[v] = v;
+        }
+        std::fill(passLocked.begin(), passLocked.end(), 0);
+        size_t toRemove = (work.size() - target) / 3, removed = 0;
+        for (const Collapse &collapse : collapses)
+        {
+            if (collapse.error > errorLimit || removed >= toRemove)
+            {
+                break;
+            }
+            if (passLocked[collapse.from] || passLocked[collapse.to])
+            {
+                continue;
+            }
+            // moving from onto to must not turn any remaining triangle over
+            const float *target = position(positions, positionStride, collapse.to);
+            bool flips = false;
+            for (uint32_t a = offsets[collapse.from]; a < offsets[collapse.from + 1] && !flips; a++)
+            {
+                const uint32_t *tri = &work[adjacency[a] * 3];
+                if (tri[0] == collapse.to || tri[1] == collapse.to || tri[2] == collapse.to)
+                {
+                    continue;
+                }
+                const float *before[3], *after[3];
+                for (int k = 0; k < 3; k++)
+                {
+                    before[k] = position(positions, positionStride, tri[k]);
+                    after[k] = tri[k] == collapse.from ? target : before[k];
+                }
+                double n0[3], n1[3];
+                faceNormal(before[0], before[1], before[2], n0);
+                faceNormal(after[0], after[1], after[2], n1);
+                double dot = n0[0] * n1[0] + n0[1] * n1[1] + n0[2] * n1[2];
+                double len = std::sqrt((n0[0] * n0[0] + n0[1] * n0[1] + n0[2] * n0[2]) *
+                                       (n1[0] * n1[0] + n1[1] * n1[1] + n1[2] * n1[2]));
+                flips = dot <= 0.25 * len;
+            }
+            if (flips)
+            {
+                continue;
+            }
+
+            removed += sharedTriangles(collapse.from, collapse.to);
+            remap[collapse.from] = collapse.to;
+            quadrics[collapse.to].add(quadrics[collapse.from]);
+            reached = std::max(reached, collapse.error);
+            passLocked[collapse.to] = 1;
+            for (uint32_t a = offsets[collapse.from]; a < offsets[collapse.from + 1]; a++)
+            {
+                const uint32_t *tri = &work[adjacency[a] * 3];
+                passLocked[tri[0]] = passLocked[tri[1]] = passLocked[tri[2]] = 1;
+            }
+        }
+        if (removed == 0)
+        {
+            break;
+        }
+
+        size_t write = 0;
+        for (size_t i = 0; i < work.size(); i += 3)
+        {
+            uint32_t a = remap[work[i]], b = remap[work[i + 1]], c = remap[work[i + 2]];
+            if (a != b && b != c && a != c)
+            {
+                work[write++] = a;
+                work[write++] = b;
+                work[write++] = c;
+            }
+        }
+        work.resize(write);
+    }
+
+    std::copy(work.begin(), work.end(), dst);
+    if (resultError != nullptr)
+    {
+        *resultError = reached / extent;
+    }
+    return work.size();
+}
+
+void mesh::generateLods(std::vector<uint32_t> &lodIndices, std::vector<MeshLod> &lods, const uint32_t *indices,
+                        size_t indexCount, const float *positions, size_t vertexCount, size_t positionStride,
+                        const std::vector<float> &ratios, const SimplifySettings &settings)
+{
+    lodIndices.clear();
+    lods.clear();
+    std::vector<uint32_t> level(indices, indices + indexCount / 3 * 3);
+    optimizeVertexCache(level.data(), level.data(), level.size(), vertexCount);
+    lodIndices = level;
+    lods.push_back(MeshLod{0, static_cast<uint32_t>(level.size()), 0.0f});
+
+    float extent = meshExtent(indices, indexCount, positions, positionStride);
+    float error = 0.0f;
+    std::vector<uint32_t> next(level.size());
+    for (float ratio : ratios)
+    {
+        SimplifySettings levelSettings = settings;
+        levelSettings.targetIndexCount = static_cast<size_t>(indexCount / 3 * ratio) * 3;
+        if (levelSettings.targetIndexCount >= level.size())
+        {
+            continue;
+        }
+        float levelError = 0.0f;
+        size_t count = simplify(next.data(), level.data(), level.size(), positions, vertexCount, positionStride,
+                                levelSettings, &levelError);
+        if (count >= level.size())
+        {
+            break;
+        }
+        optimizeVertexCache(next.data(), next.data(), count, vertexCount);
+        // errors of successive levels add up, each one starts from the last
+        error += levelError * extent;
+        lods.push_back(MeshLod{static_cast<uint32_t>(lodIndices.size()), static_cast<uint32_t>(count), error});
+        lodIndices.insert(lodIndices.end(), next.begin(), next.begin() + count);
+        level.assign(next.begin(), next.begin() + count);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// LodSelector
+
+mesh::LodSelector::LodSelector(const std::vector<MeshLod> &lods, float pixelThreshold, float hysteresis)
+    : m_threshold{pixelThreshold}, m_hysteresis{hysteresis}
+{
+    for (const MeshLod &lod : lods)
+    {
+        m_errors.push_back(lod.error);
+    }
+    if (m_errors.empty())
+    {
+        m_errors.push_back(0.0f);
+    }
+};
+
+float mesh::LodSelector::projectedSize(float length, float distance, float fovY, float viewportHeight)
+{
+    return length * viewportHeight / (2.0f * std::max(distance, 1e-4f) * std::tan(fovY * 0.5f));
+}
+
+size_t mesh::LodSelector::select(size_t current, float distance, float fovY, float viewportHeight) const
+{
+    size_t last = m_errors.size() - 1;
+    current = std::min(current, last);
+    auto pixels = [&](size_t level)
+    { return projectedSize(m_errors[level], distance, fovY, viewportHeight); };
+
+    // too coarse by more than the band: back to the coarsest level within the threshold
+    if (pixels(current) > m_threshold * (1.0f + m_hysteresis))
+    {
+        size_t level = current;
+        while (level > 0 && pixels(level) > m_threshold)
+        {
+            level--;
+        }
+        return level;
+    }
+    // coarser only once the next level is well below the threshold
+    size_t level = current;
+    while (level < last && pixels(level + 1) <= m_threshold * (1.0f - m_hysteresis))
+    {
+        level++;
+    }
+    return level;
+}
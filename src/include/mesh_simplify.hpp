@@ -0,0 +1,77 @@
+#ifndef MESH_SIMPLIFY_HPP
+#define MESH_SIMPLIFY_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Level of detail generation by edge collapse with quadric error metrics (Garland &
+// Heckbert 1997). Vertices collapse onto one of their neighbours rather than to a new
+// position, so the simplified index buffer keeps using the original vertex buffer and
+// every level can share it. Attribute seams (several vertices at one position) and,
+// optionally, open borders stay where they are; other attributes add their own
+// weighted error to every collapse.
+namespace mesh
+{
+    // index range of one level of detail, over all submeshes
+    struct MeshLod
+    {
+        uint32_t firstIndex;
+        uint32_t indexCount;
+        float error; // object space simplification error, 0 for the full mesh
+    };
+
+    struct SimplifySettings
+    {
+        size_t targetIndexCount = 0;
+        // stop before the error reaches this fraction of the mesh extent
+        float targetError = 0.01f;
+        // keep open boundaries (holes, cut off parts) in place
+        bool lockBorder = true;
+        // optional per vertex attributes to preserve: attributeCount floats at the start of
+        // every attributeStride bytes, each difference scaled by attributeWeights[i] (1 if null)
+        const float *attributes = nullptr;
+        size_t attributeStride = 0;
+        size_t attributeCount = 0;
+        const float *attributeWeights = nullptr;
+    };
+
+    // Writes the simplified triangle list to dst (room for indexCount indices, may equal
+    // indices) and returns its index count. resultError receives the error reached,
+    // relative to the mesh extent like targetError. positions: 3 floats at the start of
+    // every positionStride bytes.
+    size_t simplify(uint32_t *dst, const uint32_t *indices, size_t indexCount, const float *positions,
+                    size_t vertexCount, size_t positionStride, const SimplifySettings &settings = SimplifySettings{},
+                    float *resultError = nullptr);
+
+    // Level 0 is the input, level i simplifies level i - 1 down to ratios[i - 1] of the input
+    // triangles, stopping early once a level no longer shrinks. All levels are vertex cache
+    // optimised and appended to lodIndices; lods gets one entry per level with its absolute
+    // (object space) error. settings.targetIndexCount is ignored.
+    void generateLods(std::vector<uint32_t> &lodIndices, std::vector<MeshLod> &lods, const uint32_t *indices,
+                      size_t indexCount, const float *positions, size_t vertexCount, size_t positionStride,
+                      const std::vector<float> &ratios, const SimplifySettings &settings = SimplifySettings{});
+
+    // Picks a level per object from the projected size of its simplification error. A level
+    // is used while its error covers less than pixelThreshold pixels; hysteresis widens that
+    // band (0.25 = switch finer above 1.25x, coarser below 0.75x) so objects hovering around
+    // a switching distance do not flicker between levels every frame.
+    class LodSelector
+    {
+    public:
+        LodSelector(const std::vector<MeshLod> &lods, float pixelThreshold = 1.0f, float hysteresis = 0.25f);
+
+        // distance from the camera in object space units (divide by the object's scale)
+        size_t select(size_t current, float distance, float fovY, float viewportHeight) const;
+        // pixels covered by an object space length at distance
+        static float projectedSize(float length, float distance, float fovY, float viewportHeight);
+
+    private:
+        // vars
+        std::vector<float> m_errors;
+        float m_threshold;
+        float m_hysteresis;
+    };
+} // namespace mesh
+
+#endif // MESH_SIMPLIFY_HPP
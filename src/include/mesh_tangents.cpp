@@ -0,0 +1,577 @@
+#include "mesh_tangents.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <unordered_map>
+
+namespace
+{
+    const uint32_t NONE = 0xFFFFFFFFu;
+    // triangles or vertices per parallel chunk
+    const size_t GRAIN = 8192;
+    // fans up to this size match their edges pair by pair, larger ones sort them
+    const uint32_t FAN_PAIRS = 16;
+
+    void forRanges(size_t count, bool multithreaded, const std::function<void(size_t, size_t)> &fn)
+    {
+        if (multithreaded)
+        {
+            ThreadPool::shared().parallelFor(count, GRAIN, fn);
+        }
+        else if (count > 0)
+        {
+            fn(0, count);
+        }
+    }
+
+    const float *element(const float *base, size_t stride, size_t index)
+    {
+        return reinterpret_cast<const float *>(reinterpret_cast<const unsigned char *>(base) + index * stride);
+    }
+
+    // mikktspace.c tests against FLT_MIN rather than zero
+    bool notZero(float x)
+    {
+        return std::fabs(x) > FLT_MIN;
+    }
+
+    float dot3(const float *a, const float *b)
+    {
+        return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+    }
+
+    // normalises v unless it is zero
+    bool normalize3(float *v)
+    {
+        float length = std::sqrt(dot3(v, v));
+        if (!notZero(length))
+        {
+            return false;
+        }
+        // as the reference: scaled by the reciprocal
+        float scale = 1.0f / length;
+        v[0] *= scale;
+        v[1] *= scale;
+        v[2] *= scale;
+        return true;
+    }
+
+    // v minus its component along the unit vector n, normalised
+    void project(float *v, const float *n)
+    {
+        float d = dot3(n, v);
+        v[0] -= d * n[0];
+        v[1] -= d * n[1];
+        v[2] -= d * n[2];
+        normalize3(v);
+    }
+
+    // any unit vector perpendicular to n, from the axis least aligned with it
+    void perpendicular(const float *n, float *t)
+    {
+        float ax = std::fabs(n[0]), ay = std::fabs(n[1]), az = std::fabs(n[2]);
+        t[0] = ax <= ay && ax <= az ? 1.0f : 0.0f;
+        t[1] = t[0] == 0.0f && ay <= az ? 1.0f : 0.0f;
+        t[2] = t[0] == 0.0f && t[1] == 0.0f ? 1.0f : 0.0f;
+        float d = dot3(n, t);
+        t[0] -= d * n[0];
+        t[1] -= d * n[1];
+        t[2] -= d * n[2];
+        if (!normalize3(t))
+        {
+            t[0] = 1.0f;
+            t[1] = t[2] = 0.0f;
+        }
+    }
+
+    // ---------------------------------------------------------------------------
+    // welding
+
+    // Position, normal and uv as 8 words, with -0 turned into +0 so the words compare
+    // like the floats do in the reference.
+    void vertexKey(const mesh::TangentInput &in, size_t v, uint32_t *key)
+    {
+        float values[8];
+        const float *p = element(in.positions, in.positionStride, v);
+        const float *n = element(in.normals, in.normalStride, v);
+        const float *t = element(in.uvs, in.uvStride, v);
+        for (int k = 0; k < 3; k++)
+        {
+            values[k] = p[k] + 0.0f;
+            values[3 + k] = n[k] + 0.0f;
+        }
+        values[6] = t[0] + 0.0f;
+        values[7] = t[1] + 0.0f;
+        std::memcpy(key, values, sizeof(values));
+    }
+
+    // the lowest numbered vertex with the same position, normal and uv, for every vertex
+    std::vector<uint32_t> weldVertices(const mesh::TangentInput &in, bool multithreaded)
+    {
+        size_t count = in.vertexCount;
+        std::vector<uint64_t> hashes(count);
+        forRanges(count, multithreaded,
+                  [&](size_t begin, size_t end)
+                  {
+                      for (size_t v = begin; v < end; v++)
+                      {
+                          uint32_t key[8];
+                          vertexKey(in, v, key);
+                          uint64_t h = 0;
+                          for (uint32_t word : key)
+                          {
+                              h = (h ^ word) * 0x9E3779B97F4A7C15ull;
+                              h ^= h >> 29;
+                          }
+                          hashes[v] = h;
+                      }
+                  });
+
+        // open addressing at most half full, slot from the top hash bits
+        int bits = 1;
+        while ((size_t{1} << bits) < count * 2)
+        {
+            bits++;
+        }
+        size_t mask = (size_t{1} << bits) - 1;
+        std::vector<uint32_t> table(mask + 1, NONE);
+        std::vector<uint32_t> welded(count);
+        for (size_t v = 0; v < count; v++)
+        {
+            size_t slot = static_cast<size_t>(hashes[v] >> (64 - bits));
+            welded[v] = static_cast<uint32_t>(v);
+            while (table[slot] != NONE)
+            {
+                uint32_t other = table[slot];
+                if (hashes[other] == hashes[v])
+                {
+                    uint32_t a[8], b[8];
+                    vertexKey(in, v, a);
+                    vertexKey(in, other, b);
+                    if (std::memcmp(a, b, sizeof(a)) == 0)
+                    {
+                        welded[v] = other;
+                        break;
+                    }
+                }
+                slot = (slot + 1) & mask;
+            }
+            if (welded[v] == v)
+            {
+                table[slot] = static_cast<uint32_t>(v);
+            }
+        }
+        return welded;
+    }
+
+    // ---------------------------------------------------------------------------
+    // tangent space
+
+    struct Triangle
+    {
+        float tangent[3]; // direction of growing u, flipped for mirrored uvs
+        bool preserving;  // counter-clockwise in uv space
+        bool any;         // no usable uv gradient, takes the orientation of its neighbours
+        bool degenerate;  // two corners weld into one vertex
+    };
+
+    // next and previous corner of the same triangle
+    size_t nextCorner(size_t c)
+    {
+        return c % 3 == 2 ? c - 2 : c + 1;
+    }
+
+    size_t prevCorner(size_t c)
+    {
+        return c % 3 == 0 ? c + 2 : c - 1;
+    }
+
+    // Writes 4 floats per corner and, when groups is not null, an id per corner that is
+    // equal for corners sharing one tangent space.
+    void buildTangentSpace(float *cornerTangents, uint32_t *groups, const mesh::TangentInput &in, bool multithreaded)
+    {
+        size_t cornerCount = in.indexCount - in.indexCount % 3;
+        size_t triangleCount = cornerCount / 3;
+        const uint32_t *indices = in.indices;
+        auto position = [&in](uint32_t v)
+        { return element(in.positions, in.positionStride, v); };
+        auto normal = [&in](uint32_t v)
+        { return element(in.normals, in.normalStride, v); };
+        auto uv = [&in](uint32_t v)
+        { return element(in.uvs, in.uvStride, v); };
+
+        std::vector<uint32_t> welded = weldVertices(in, multithreaded);
+        std::vector<uint32_t> cornerVertex(cornerCount);
+        std::vector<Triangle> triangles(triangleCount);
+        forRanges(triangleCount, multithreaded,
+                  [&](size_t begin, size_t end)
+                  {
+                      for (size_t t = begin; t < end; t++)
+                      {
+                          const uint32_t *tri = indices + t * 3;
+                          uint32_t *w = &cornerVertex[t * 3];
+                          for (int k = 0; k < 3; k++)
+                          {
+                              w[k] = welded[tri[k]];
+                          }
+                          Triangle &info = triangles[t];
+                          info.degenerate = w[0] == w[1] || w[1] == w[2] || w[0] == w[2];
+
+                          const float *p1 = position(tri[0]), *p2 = position(tri[1]), *p3 = position(tri[2]);
+                          const float *t1 = uv(tri[0]), *t2 = uv(tri[1]), *t3 = uv(tri[2]);
+                          float t21x = t2[0] - t1[0], t21y = t2[1] - t1[1];
+                          float t31x = t3[0] - t1[0], t31y = t3[1] - t1[1];
+                          float signedArea = t21x * t31y - t21y * t31x;
+                          float os[3], ot[3];
+                          for (int k = 0; k < 3; k++)
+                          {
+                              float d1 = p2[k] - p1[k], d2 = p3[k] - p1[k];
+                              os[k] = t31y * d1 - t21y * d2;
+                              ot[k] = -t31x * d1 + t21x * d2;
+                          }
+                          info.preserving = signedArea > 0.0f;
+                          info.any = true;
+                          if (notZero(signedArea))
+                          {
+                              float area = std::fabs(signedArea);
+                              float lengthS = std::sqrt(dot3(os, os)), lengthT = std::sqrt(dot3(ot, ot));
+                              float sign = info.preserving ? 1.0f : -1.0f;
+                              if (notZero(lengthS))
+                              {
+                                  for (float &x : os)
+                                  {
+                                      x *= sign / lengthS;
+                                  }
+                              }
+                              info.any = !(notZero(lengthS / area) && notZero(lengthT / area));
+                          }
+                          std::copy(os, os + 3, info.tangent);
+                      }
+                  });
+
+        // corners of the usable triangles around every welded vertex, in corner order
+        std::vector<uint32_t> fanStart(in.vertexCount + 1, 0);
+        for (size_t c = 0; c < cornerCount; c++)
+        {
+            if (!triangles[c / 3].degenerate)
+            {
+                fanStart[cornerVertex[c] + 1]++;
+            }
+        }
+        for (size_t v = 0; v < in.vertexCount; v++)
+        {
+            fanStart[v + 1] += fanStart[v];
+        }
+        std::vector<uint32_t> fanCorners(fanStart.back());
+        {
+            std::vector<uint32_t> cursor(fanStart.begin(), fanStart.end() - 1);
+            for (size_t c = 0; c < cornerCount; c++)
+            {
+                if (!triangles[c / 3].degenerate)
+                {
+                    fanCorners[cursor[cornerVertex[c]]++] = static_cast<uint32_t>(c);
+                }
+            }
+        }
+
+        // Triangles without a uv gradient follow their lowest numbered neighbour across an
+        // edge (same two vertices, opposite direction) that has one.
+        std::vector<unsigned char> preserving(triangleCount);
+        forRanges(triangleCount, multithreaded,
+                  [&](size_t begin, size_t end)
+                  {
+                      for (size_t t = begin; t < end; t++)
+                      {
+                          const Triangle &info = triangles[t];
+                          preserving[t] = info.preserving;
+                          if (!info.any || info.degenerate)
+                          {
+                              continue;
+                          }
+                          size_t best = NONE;
+                          for (size_t c = t * 3; c < t * 3 + 3; c++)
+                          {
+                              uint32_t v = cornerVertex[c], next = cornerVertex[nextCorner(c)];
+                              for (uint32_t i = fanStart[v]; i < fanStart[v + 1]; i++)
+                              {
+                                  size_t other = fanCorners[i], u = other / 3;
+                                  if (u != t && u < best && !triangles[u].any &&
+                                      cornerVertex[prevCorner(other)] == next)
+                                  {
+                                      best = u;
+                                  }
+                              }
+                          }
+                          if (best != NONE)
+                          {
+                              preserving[t] = triangles[best].preserving;
+                          }
+                      }
+                  });
+
+        // Groups: around every vertex, the triangles joined through shared edges that agree
+        // on orientation (union find over the fan). A group id is the fan slot of its root.
+        forRanges(in.vertexCount, multithreaded,
+                  [&](size_t begin, size_t end)
+                  {
+                      struct Edge
+                      {
+                          uint32_t vertex; // the other end
+                          uint32_t slot;   // within the fan
+                          bool outgoing;
+                          bool operator<(const Edge &o) const
+                          {
+                              return vertex < o.vertex;
+                          }
+                      };
+                      std::vector<Edge> edges;
+                      std::vector<uint32_t> parent, nextVertex, prevVertex;
+                      std::vector<unsigned char> orientation;
+                      std::vector<float> sums;
+                      auto find = [&parent](uint32_t i)
+                      {
+                          while (parent[i] != i)
+                          {
+                              parent[i] = parent[parent[i]];
+                              i = parent[i];
+                          }
+                          return i;
+                      };
+                      // corner a leaves towards the vertex corner b comes from
+                      auto join = [&](uint32_t a, uint32_t b)
+                      {
+                          if (a != b && orientation[a] == orientation[b])
+                          {
+                              parent[find(a)] = find(b);
+                          }
+                      };
+                      for (size_t v = begin; v < end; v++)
+                      {
+                          uint32_t first = fanStart[v], size = fanStart[v + 1] - first;
+                          if (size == 0)
+                          {
+                              continue;
+                          }
+                          const uint32_t *fan = &fanCorners[first];
+                          parent.resize(size);
+                          nextVertex.resize(size);
+                          prevVertex.resize(size);
+                          orientation.resize(size);
+                          for (uint32_t i = 0; i < size; i++)
+                          {
+                              parent[i] = i;
+                              nextVertex[i] = cornerVertex[nextCorner(fan[i])];
+                              prevVertex[i] = cornerVertex[prevCorner(fan[i])];
+                              orientation[i] = preserving[fan[i] / 3];
+                          }
+                          if (size <= FAN_PAIRS)
+                          {
+                              for (uint32_t i = 0; i < size; i++)
+                              {
+                                  for (uint32_t j = 0; j < size; j++)
+                                  {
+                                      if (nextVertex[i] == prevVertex[j])
+                                      {
+                                          join(i, j);
+                                      }
+                                  }
+                              }
+                          }
+                          else
+                          {
+                              // high valence: match through the edges sorted by their other end
+                              edges.clear();
+                              for (uint32_t i = 0; i < size; i++)
+                              {
+                                  edges.push_back(Edge{nextVertex[i], i, true});
+                                  edges.push_back(Edge{prevVertex[i], i, false});
+                              }
+                              std::sort(edges.begin(), edges.end());
+                              for (size_t a = 0; a < edges.size();)
+                              {
+                                  size_t b = a;
+                                  while (b < edges.size() && edges[b].vertex == edges[a].vertex)
+                                  {
+                                      b++;
+                                  }
+                                  for (size_t i = a; i < b; i++)
+                                  {
+                                      for (size_t j = a; j < b; j++)
+                                      {
+                                          if (edges[i].outgoing && !edges[j].outgoing)
+                                          {
+                                              join(edges[i].slot, edges[j].slot);
+                                          }
+                                      }
+                                  }
+                                  a = b;
+                              }
+                          }
+                          for (uint32_t i = 0; i < size; i++)
+                          {
+                              parent[i] = find(i);
+                          }
+
+                          // angle weighted sum of the triangle tangents in the vertex's tangent plane
+                          sums.assign(size * 3, 0.0f);
+                          for (uint32_t i = 0; i < size; i++)
+                          {
+                              size_t c = fan[i];
+                              const Triangle &info = triangles[c / 3];
+                              if (info.any)
+                              {
+                                  continue;
+                              }
+                              const float *n = normal(indices[c]);
+                              const float *p0 = position(indices[prevCorner(c)]), *p1 = position(indices[c]),
+                                          *p2 = position(indices[nextCorner(c)]);
+                              float os[3] = {info.tangent[0], info.tangent[1], info.tangent[2]};
+                              float v1[3] = {p0[0] - p1[0], p0[1] - p1[1], p0[2] - p1[2]};
+                              float v2[3] = {p2[0] - p1[0], p2[1] - p1[1], p2[2] - p1[2]};
+                              project(os, n);
+                              project(v1, n);
+                              project(v2, n);
+                              float angle = std::acos(std::max(-1.0f, std::min(1.0f, dot3(v1, v2))));
+                              float *sum = &sums[parent[i] * 3];
+                              for (int k = 0; k < 3; k++)
+                              {
+                                  sum[k] += angle * os[k];
+                              }
+                          }
+                          for (uint32_t i = 0; i < size; i++)
+                          {
+                              if (parent[i] == i && !normalize3(&sums[i * 3]))
+                              {
+                                  perpendicular(normal(indices[fan[i]]), &sums[i * 3]);
+                              }
+                          }
+                          for (uint32_t i = 0; i < size; i++)
+                          {
+                              uint32_t root = parent[i];
+                              float *dst = cornerTangents + static_cast<size_t>(fan[i]) * 4;
+                              std::copy(&sums[root * 3], &sums[root * 3] + 3, dst);
+                              dst[3] = orientation[i] ? 1.0f : -1.0f;
+                              if (groups != nullptr)
+                              {
+                                  groups[fan[i]] = first + root;
+                              }
+                          }
+                      }
+                  });
+
+        // corners of degenerate triangles copy the first usable corner of their vertex
+        forRanges(triangleCount, multithreaded,
+                  [&](size_t begin, size_t end)
+                  {
+                      for (size_t t = begin; t < end; t++)
+                      {
+                          if (!triangles[t].degenerate)
+                          {
+                              continue;
+                          }
+                          for (size_t c = t * 3; c < t * 3 + 3; c++)
+                          {
+                              uint32_t v = cornerVertex[c];
+                              float *dst = cornerTangents + c * 4;
+                              if (fanStart[v] < fanStart[v + 1])
+                              {
+                                  size_t source = fanCorners[fanStart[v]];
+                                  std::copy(cornerTangents + source * 4, cornerTangents + source * 4 + 4, dst);
+                                  if (groups != nullptr)
+                                  {
+                                      groups[c] = groups[source];
+                                  }
+                                  continue;
+                              }
+                              perpendicular(normal(indices[c]), dst);
+                              dst[3] = 1.0f;
+                              if (groups != nullptr)
+                              {
+                                  groups[c] = static_cast<uint32_t>(fanCorners.size() + c);
+                              }
+                          }
+                      }
+                  });
+    }
+} // namespace
+
+void mesh::generateCornerTangents(float *cornerTangents, const TangentInput &input, bool multithreaded)
+{
+    buildTangentSpace(cornerTangents, nullptr, input, multithreaded);
+}
+
+size_t mesh::generateTangents(std::vector<float> &tangents, std::vector<uint32_t> &splitVertices, uint32_t *indices,
+                              const TangentInput &input, bool multithreaded)
+{
+    size_t cornerCount = input.indexCount - input.indexCount % 3;
+    std::vector<float> cornerTangents(cornerCount * 4);
+    std::vector<uint32_t> groups(cornerCount);
+    buildTangentSpace(cornerTangents.data(), groups.data(), input, multithreaded);
+
+    // the first corner of every vertex decides its tangent, corners that disagree share a
+    // copy per group
+    tangents.assign(input.vertexCount * 4, 0.0f);
+    splitVertices.clear();
+    std::vector<bool> assigned(input.vertexCount, false);
+    std::unordered_map<uint64_t, uint32_t> copies;
+    for (size_t c = 0; c < cornerCount; c++)
+    {
+        uint32_t v = input.indices[c];
+        const float *tangent = &cornerTangents[c * 4];
+        if (!assigned[v])
+        {
+            std::copy(tangent, tangent + 4, &tangents[static_cast<size_t>(v) * 4]);
+            assigned[v] = true;
+        }
+        else if (!std::equal(tangent, tangent + 4, &tangents[static_cast<size_t>(v) * 4]))
+        {
+            uint64_t key = uint64_t{v} << 32 | groups[c];
+            auto it = copies.find(key);
+            if (it == copies.end())
+            {
+                uint32_t copy = static_cast<uint32_t>(input.vertexCount + splitVertices.size());
+                it = copies.emplace(key, copy).first;
+                splitVertices.push_back(v);
+                tangents.insert(tangents.end(), tangent, tangent + 4);
+            }
+            v = it->second;
+        }
+        indices[c] = v;
+    }
+    return input.vertexCount + splitVertices.size();
+}
+
+bool mesh::generateTangents(MeshData &mesh, bool multithreaded)
+{
+    if (!mesh.hasNormals || !mesh.hasUvs)
+    {
+        std::cerr << "Tangents need normals and uvs" << std::endl;
+        return false;
+    }
+    const int F = MeshData::FLOATS_PER_VERTEX;
+    TangentInput input;
+    input.positions = mesh.vertices.data();
+    input.normals = mesh.vertices.data() + 3;
+    input.uvs = mesh.vertices.data() + 6;
+    input.positionStride = input.normalStride = input.uvStride = F * sizeof(float);
+    input.vertexCount = mesh.vertexCount();
+    input.indices = mesh.indices.data();
+    input.indexCount = mesh.indices.size();
+
+    std::vector<uint32_t> splitVertices;
+    size_t vertexCount = generateTangents(mesh.tangents, splitVertices, mesh.indices.data(), input, multithreaded);
+    size_t first = mesh.vertexCount();
+    mesh.vertices.resize(vertexCount * F);
+    for (size_t i = 0; i < splitVertices.size(); i++)
+    {
+        std::copy(&mesh.vertices[static_cast<size_t>(splitVertices[i]) * F],
+                  &mesh.vertices[static_cast<size_t>(splitVertices[i]) * F] + F, &mesh.vertices[(first + i) * F]);
+    }
+    mesh.hasTangents = true;
+    return true;
+}
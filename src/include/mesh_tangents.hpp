@@ -0,0 +1,53 @@
+#ifndef MESH_TANGENTS_HPP
+#define MESH_TANGENTS_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "mesh_import.hpp"
+
+// Tangent space generation that reproduces MikkTSpace (Mikkelsen 2008, mikktspace.c with
+// its default 180 degree angular threshold), the convention normal map bakers and glTF
+// assume. Corners with equal position, normal and uv are welded through a hash table;
+// around every welded vertex the triangles that share an edge and agree on uv orientation
+// form one group, whose tangent is the angle weighted sum of their uv gradients projected
+// onto the vertex normal. w holds the bitangent sign: bitangent = w * cross(normal, tangent).
+//
+// Triangles, fans and groups are processed on ThreadPool::shared(). Two simplifications of
+// the reference, both limited to broken input: a triangle without uv area takes the
+// orientation of its lowest numbered edge neighbour instead of the first group that
+// reaches it, and a vertex no group gives a direction gets any unit vector perpendicular
+// to its normal rather than a zero tangent.
+namespace mesh
+{
+    // 3 floats at the start of every ...Stride bytes for positions and normals, 2 for uvs
+    struct TangentInput
+    {
+        const float *positions = nullptr;
+        size_t positionStride = 3 * sizeof(float);
+        const float *normals = nullptr;
+        size_t normalStride = 3 * sizeof(float);
+        const float *uvs = nullptr;
+        size_t uvStride = 2 * sizeof(float);
+        size_t vertexCount = 0;
+        const uint32_t *indices = nullptr; // triangle list
+        size_t indexCount = 0;
+    };
+
+    // 4 floats per index, exactly what MikkTSpace hands to setTSpaceBasic for every corner
+    void generateCornerTangents(float *cornerTangents, const TangentInput &input, bool multithreaded = true);
+
+    // 4 floats per vertex. A vertex whose corners need different tangents (uv mirror seams,
+    // a fan split by orientation) keeps the tangent of its first corner; the other corners
+    // are pointed at new vertices numbered from input.vertexCount on, copies of
+    // splitVertices[i]. indices must hold the same triangles as input.indices (it may be
+    // the same array) and is rewritten in place. Returns the vertex count with the copies.
+    size_t generateTangents(std::vector<float> &tangents, std::vector<uint32_t> &splitVertices, uint32_t *indices,
+                            const TangentInput &input, bool multithreaded = true);
+
+    // fills mesh.tangents, appending the split vertices to mesh.vertices; needs normals and uvs
+    bool generateTangents(MeshData &mesh, bool multithreaded = true);
+} // namespace mesh
+
+#endif // MESH_TANGENTS_HPP
@@ -0,0 +1,468 @@
+#include "meshlet.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+    const uint8_t NOT_LOCAL = 0xFF;
+    // unemitted triangles looked at when a meshlet has no connected candidates left
+    const size_t FALLBACK_WINDOW = 256;
+
+    const float *position(const float *positions, size_t stride, uint32_t v)
+    {
+        return reinterpret_cast<const float *>(reinterpret_cast<const unsigned char *>(positions) + v * stride);
+    }
+
+    float dot3(const float *a, const float *b)
+    {
+        return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+    }
+
+    // unit normal, or zero for degenerate triangles
+    void triangleNormal(const float *a, const float *b, const float *c, float *n)
+    {
+        float e1[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+        float e2[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+        n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+        n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+        n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+        float length = std::sqrt(dot3(n, n));
+        float scale = length > 0.0f ? 1.0f / length : 0.0f;
+        n[0] *= scale;
+        n[1] *= scale;
+        n[2] *= scale;
+    }
+
+    // the meshlet being filled
+    struct Builder
+    {
+        mesh::Meshlets &out;
+        std::vector<uint8_t> local; // per mesh vertex, NOT_LOCAL outside the current meshlet
+        mesh::Meshlet current{0, 0, 0, 0};
+        float normalSum[3] = {0.0f, 0.0f, 0.0f};
+        float centroidSum[3] = {0.0f, 0.0f, 0.0f};
+
+        Builder(mesh::Meshlets &meshlets, size_t vertexCount) : out{meshlets}, local(vertexCount, NOT_LOCAL) {};
+
+        size_t newVertices(const uint32_t *triangle) const
+        {
+            return (local[triangle[0]] == NOT_LOCAL) + (local[triangle[1]] == NOT_LOCAL) +
+                   (local[triangle[2]] == NOT_LOCAL);
+        }
+
+        void add(const uint32_t *triangle, const float *normal, const float *centroid)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                uint32_t v = triangle[k];
+                if (local[v] == NOT_LOCAL)
+                {
+                    local[v] = static_cast<uint8_t>(current.vertexCount++);
+                    out.vertices.push_back(v);
+                }
+                out.triangles.push_back(local[v]);
+            }
+            for (int k = 0; k < 3; k++)
+            {
+                normalSum[k] += normal[k];
+                centroidSum[k] += centroid[k];
+            }
+            current.triangleCount++;
+        }
+
+        void flush(const float *positions, size_t stride)
+        {
+            if (current.triangleCount > 0)
+            {
+                const uint32_t *vertices = &out.vertices[current.vertexOffset];
+                const uint8_t *triangles = &out.triangles[static_cast<size_t>(current.triangleOffset) * 3];
+                for (uint32_t i = 0; i < current.vertexCount; i++)
+                {
+                    local[vertices[i]] = NOT_LOCAL;
+                }
+                for (uint32_t i = 0; i < current.triangleCount * 3; i++)
+                {
+                    out.indices.push_back(vertices[triangles[i]]);
+                }
+                out.bounds.push_back(
+                    mesh::computeMeshletBounds(vertices, triangles, current.triangleCount, positions, stride));
+                out.meshlets.push_back(current);
+            }
+            current = mesh::Meshlet{static_cast<uint32_t>(out.vertices.size()),
+                                    static_cast<uint32_t>(out.triangles.size() / 3), 0, 0};
+            std::fill(normalSum, normalSum + 3, 0.0f);
+            std::fill(centroidSum, centroidSum + 3, 0.0f);
+        }
+    };
+} // namespace
+
+// ---------------------------------------------------------------------------
+// building
+
+uint32_t mesh::Meshlets::firstIndex(size_t meshlet) const
+{
+    return meshlets[meshlet].triangleOffset * 3;
+}
+
+uint32_t mesh::Meshlets::indexCount(size_t meshlet) const
+{
+    return meshlets[meshlet].triangleCount * 3;
+}
+
+mesh::MeshletBounds mesh::computeMeshletBounds(const uint32_t *meshletVertices, const uint8_t *meshletTriangles,
+                                               size_t triangleCount, const float *positions, size_t positionStride)
+{
+    MeshletBounds bounds{};
+    // sphere around the box of the used vertices
+    float lo[3] = {std::numeric_limits<float>::max(), std::numeric_limits<float>::max(),
+                   std::numeric_limits<float>::max()};
+    float hi[3] = {-lo[0], -lo[1], -lo[2]};
+    for (size_t i = 0; i < triangleCount * 3; i++)
+    {
+        const float *p = position(positions, positionStride, meshletVertices[meshletTriangles[i]]);
+        for (int k = 0; k < 3; k++)
+        {
+            lo[k] = std::min(lo[k], p[k]);
+            hi[k] = std::max(hi[k], p[k]);
+        }
+    }
+    for (int k = 0; k < 3; k++)
+    {
+        bounds.center[k] = triangleCount > 0 ? (lo[k] + hi[k]) * 0.5f : 0.0f;
+    }
+    float radius2 = 0.0f;
+    for (size_t i = 0; i < triangleCount * 3; i++)
+    {
+        const float *p = position(positions, positionStride, meshletVertices[meshletTriangles[i]]);
+        float d[3] = {p[0] - bounds.center[0], p[1] - bounds.center[1], p[2] - bounds.center[2]};
+        radius2 = std::max(radius2, dot3(d, d));
+    }
+    bounds.radius = std::sqrt(radius2);
+
+    // cone around the average normal, its half angle reaching the furthest normal
+    std::vector<float> normals(triangleCount * 3);
+    float axis[3] = {0.0f, 0.0f, 0.0f};
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        const uint8_t *tri = meshletTriangles + t * 3;
+        triangleNormal(position(positions, positionStride, meshletVertices[tri[0]]),
+                       position(positions, positionStride, meshletVertices[tri[1]]),
+                       position(positions, positionStride, meshletVertices[tri[2]]), &normals[t * 3]);
+        for (int k = 0; k < 3; k++)
+        {
+            axis[k] += normals[t * 3 + k];
+        }
+    }
+    float length = std::sqrt(dot3(axis, axis));
+    bounds.coneCutoff = 1.0f;
+    if (length > 0.0f)
+    {
+        for (float &a : axis)
+        {
+            a /= length;
+        }
+        float minDot = 1.0f;
+        for (size_t t = 0; t < triangleCount; t++)
+        {
+            const float *n = &normals[t * 3];
+            if (dot3(n, n) > 0.0f)
+            {
+                minDot = std::min(minDot, dot3(n, axis));
+            }
+        }
+        // a cone of 90 degrees or more can always be seen from somewhere in front
+        if (minDot > 0.0f)
+        {
+            bounds.coneCutoff = std::sqrt(std::max(0.0f, 1.0f - minDot * minDot));
+        }
+        std::copy(axis, axis + 3, bounds.coneAxis);
+    }
+    return bounds;
+}
+
+void mesh::buildMeshlets(Meshlets &out, const uint32_t *indices, size_t indexCount, const float *positions,
+                         size_t vertexCount, size_t positionStride, size_t maxVertices, size_t maxTriangles,
+                         float coneWeight)
+{
+    out = Meshlets{};
+    maxVertices = std::clamp<size_t>(maxVertices, 3, NOT_LOCAL);
+    maxTriangles = std::max<size_t>(maxTriangles, 1);
+    size_t triangleCount = indexCount / 3;
+    out.indices.reserve(triangleCount * 3);
+    out.triangles.reserve(triangleCount * 3);
+
+    // triangles around every vertex, and their normals and centroids
+    std::vector<uint32_t> offsets(vertexCount + 1, 0), adjacency(triangleCount * 3), live(vertexCount, 0);
+    for (size_t i = 0; i < triangleCount * 3; i++)
+    {
+        live[indices[i]]++;
+    }
+    for (size_t v = 0; v < vertexCount; v++)
+    {
+        offsets[v + 1] = offsets[v] + live[v];
+    }
+    std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < triangleCount * 3; i++)
+    {
+        adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+    }
+    std::vector<float> normals(triangleCount * 3), centroids(triangleCount * 3);
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        const float *a = position(positions, positionStride, indices[t * 3]);
+        const float *b = position(positions, positionStride, indices[t * 3 + 1]);
+        const float *c = position(positions, positionStride, indices[t * 3 + 2]);
+        triangleNormal(a, b, c, &normals[t * 3]);
+        for (int k = 0; k < 3; k++)
+        {
+            centroids[t * 3 + k] = (a[k] + b[k] + c[k]) / 3.0f;
+        }
+    }
+
+    std::vector<uint8_t> emitted(triangleCount, 0);
+    Builder builder(out, vertexCount);
+    size_t cursor = 0, remaining = triangleCount;
+    while (remaining > 0)
+    {
+        Meshlet &current = builder.current;
+        size_t best = static_cast<size_t>(-1);
+        float bestScore = std::numeric_limits<float>::max();
+        float axis[3];
+        float axisLength = std::sqrt(dot3(builder.normalSum, builder.normalSum));
+        for (int k = 0; k < 3; k++)
+        {
+            axis[k] = axisLength > 0.0f ? builder.normalSum[k] / axisLength : 0.0f;
+        }
+
+        // connected triangles: fewest new vertices, then closest to the cluster normal
+        for (uint32_t i = 0; i < current.vertexCount; i++)
+        {
+            uint32_t v = out.vertices[current.vertexOffset + i];
+            if (live[v] == 0)
+            {
+                continue;
+            }
+            for (uint32_t a = offsets[v]; a < offsets[v + 1]; a++)
+            {
+                uint32_t t = adjacency[a];
+                if (emitted[t])
+                {
+                    continue;
+                }
+                size_t extra = builder.newVertices(&indices[t * 3]);
+                if (current.vertexCount + extra > maxVertices)
+                {
+                    continue;
+                }
+                float score = extra + coneWeight * (1.0f - dot3(&normals[t * 3], axis));
+                if (score < bestScore || (score == bestScore && t < best))
+                {
+                    best = t;
+                    bestScore = score;
+                }
+            }
+        }
+
+        // nothing connected: the nearest of the next unemitted triangles in index order
+        if (best == static_cast<size_t>(-1))
+        {
+            while (emitted[cursor])
+            {
+                cursor++;
+            }
+            if (current.triangleCount == 0)
+            {
+                best = cursor;
+            }
+            else
+            {
+                float center[3];
+                for (int k = 0; k < 3; k++)
+                {
+                    center[k] = builder.centroidSum[k] / current.triangleCount;
+                }
+                float bestDistance = std::numeric_limits<float>::max();
+                for (size_t t = cursor; t < std::min(triangleCount, cursor + FALLBACK_WINDOW); t++)
+                {
+                    if (emitted[t] || current.vertexCount + builder.newVertices(&indices[t * 3]) > maxVertices)
+                    {
+                        continue;
+                    }
+                    const float *c = &centroids[t * 3];
+                    float d[3] = {c[0] - center[0], c[1] - center[1], c[2] - center[2]};
+                    if (dot3(d, d) < bestDistance)
+                    {
+                        bestDistance = dot3(d, d);
+                        best = t;
+                    }
+                }
+            }
+        }
+        if (best == static_cast<size_t>(-1))
+        {
+            builder.flush(positions, positionStride);
+            continue;
+        }
+
+        builder.add(&indices[best * 3], &normals[best * 3], &centroids[best * 3]);
+        emitted[best] = 1;
+        remaining--;
+        for (int k = 0; k < 3; k++)
+        {
+            live[indices[best * 3 + k]]--;
+        }
+        if (builder.current.triangleCount == maxTriangles)
+        {
+            builder.flush(positions, positionStride);
+        }
+    }
+    builder.flush(positions, positionStride);
+}
+
+// ---------------------------------------------------------------------------
+// culling
+
+void mesh::extractFrustum(const float *m, float planes[6][4])
+{
+    // rows of the column major matrix, Gribb & Hartmann
+    for (int i = 0; i < 3; i++)
+    {
+        for (int k = 0; k < 4; k++)
+        {
+            float row = m[k * 4 + i], w = m[k * 4 + 3];
+            planes[i * 2][k] = w + row;
+            planes[i * 2 + 1][k] = w - row;
+        }
+    }
+    for (int p = 0; p < 6; p++)
+    {
+        float length = std::sqrt(dot3(planes[p], planes[p]));
+        for (int k = 0; k < 4; k++)
+        {
+            planes[p][k] /= length > 0.0f ? length : 1.0f;
+        }
+    }
+}
+
+bool mesh::cullFrustum(const MeshletBounds &bounds, const float planes[6][4])
+{
+    for (int p = 0; p < 6; p++)
+    {
+        if (dot3(planes[p], bounds.center) + planes[p][3] < -bounds.radius)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool mesh::cullBackface(const MeshletBounds &bounds, const float *cameraPosition)
+{
+    // Every point p of the sphere must see every normal of the cone from behind:
+    // dot(p - camera, axis) >= sin(half angle) * |p - camera|. Taking the worst point of
+    // the sphere on both sides gives a test on the centre alone.
+    float d[3] = {bounds.center[0] - cameraPosition[0], bounds.center[1] - cameraPosition[1],
+                  bounds.center[2] - cameraPosition[2]};
+    float distance = std::sqrt(dot3(d, d));
+    return dot3(d, bounds.coneAxis) >= bounds.coneCutoff * distance + bounds.radius * (1.0f + bounds.coneCutoff);
+}
+
+size_t mesh::cullMeshlets(const Meshlets &meshlets, const float *viewProjection, const float *cameraPosition,
+                          std::vector<DrawRange> &ranges, CullStats *stats)
+{
+    float planes[6][4];
+    extractFrustum(viewProjection, planes);
+    CullStats counts{0, 0, 0, 0};
+    size_t first = ranges.size();
+    for (size_t i = 0; i < meshlets.meshlets.size(); i++)
+    {
+        const MeshletBounds &bounds = meshlets.bounds[i];
+        if (cullFrustum(bounds, planes))
+        {
+            counts.frustumCulled++;
+            continue;
+        }
+        if (cullBackface(bounds, cameraPosition))
+        {
+            counts.backfaceCulled++;
+            continue;
+        }
+        counts.visible++;
+        counts.triangles += meshlets.meshlets[i].triangleCount;
+        uint32_t start = meshlets.firstIndex(i), count = meshlets.indexCount(i);
+        if (ranges.size() > first && ranges.back().firstIndex + ranges.back().indexCount == start)
+        {
+            ranges.back().indexCount += count;
+        }
+        else
+        {
+            ranges.push_back(DrawRange{start, count});
+        }
+    }
+    if (stats != nullptr)
+    {
+        *stats = counts;
+    }
+    return ranges.size() - first;
+}
+
+void mesh::drawRanges(const std::vector<DrawRange> &ranges, GLenum indexType)
+{
+    if (ranges.empty())
+    {
+        return;
+    }
+    size_t indexSize = indexType == GL_UNSIGNED_SHORT ? 2 : (indexType == GL_UNSIGNED_BYTE ? 1 : 4);
+    std::vector<GLsizei> counts(ranges.size());
+    std::vector<const void *> offsets(ranges.size());
+    for (size_t i = 0; i < ranges.size(); i++)
+    {
+        counts[i] = static_cast<GLsizei>(ranges[i].indexCount);
+        offsets[i] = reinterpret_cast<const void *>(static_cast<size_t>(ranges[i].firstIndex) * indexSize);
+    }
+    glMultiDrawElements(GL_TRIANGLES, counts.data(), indexType, offsets.data(), static_cast<GLsizei>(ranges.size()));
+}
+
+const char *mesh::meshletCullGlsl()
+{
+    return "#version 430\n"
+           "layout(local_size_x = 64) in;\n"
+           "struct MeshletBounds\n"
+           "{\n"
+           "    vec4 sphere; // center, radius\n"
+           "    vec4 cone;   // axis, cutoff\n"
+           "};\n"
+           "struct DrawCommand\n"
+           "{\n"
+           "    uint count;\n"
+           "    uint instanceCount;\n"
+           "    uint firstIndex;\n"
+           "    int baseVertex;\n"
+           "    uint baseInstance;\n"
+           "};\n"
+           "layout(std430, binding = 0) readonly buffer Bounds { MeshletBounds bounds[]; };\n"
+           "layout(std430, binding = 1) readonly buffer Ranges { uvec2 ranges[]; };\n"
+           "layout(std430, binding = 2) writeonly buffer Commands { DrawCommand commands[]; };\n"
+           "layout(std430, binding = 3) buffer Count { uint drawCount; };\n"
+           "uniform vec4 planes[6];\n"
+           "uniform vec3 cameraPosition;\n"
+           "uniform uint meshletCount;\n"
+           "void main()\n"
+           "{\n"
+           "    uint i = gl_GlobalInvocationID.x;\n"
+           "    if (i >= meshletCount)\n"
+           "        return;\n"
+           "    vec4 sphere = bounds[i].sphere;\n"
+           "    vec4 cone = bounds[i].cone;\n"
+           "    for (int p = 0; p < 6; p++)\n"
+           "        if (dot(planes[p].xyz, sphere.xyz) + planes[p].w < -sphere.w)\n"
+           "            return;\n"
+           "    vec3 d = sphere.xyz - cameraPosition;\n"
+           "    if (dot(d, cone.xyz) >= cone.w * length(d) + sphere.w * (1.0 + cone.w))\n"
+           "        return;\n"
+           "    uint slot = atomicAdd(drawCount, 1u);\n"
+           "    commands[slot] = DrawCommand(ranges[i].y, 1u, ranges[i].x, 0, 0u);\n"
+           "}\n";
+}
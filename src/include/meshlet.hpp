@@ -0,0 +1,101 @@
+#ifndef MESHLET_HPP
+#define MESHLET_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glad/glad.h>
+
+// Splits a triangle list into small clusters (meshlets) with a bounding sphere and a
+// normal cone each, so large meshes can be culled per cluster instead of per object.
+// The index buffer is rewritten in meshlet order: every meshlet is one contiguous
+// index range, and the visible ranges of a frame go to glMultiDrawElements.
+//
+// Everything but drawRanges is plain CPU code. meshletCullGlsl() is the same test as
+// cullMeshlets as a compute shader for GL 4.3 contexts.
+namespace mesh
+{
+    const size_t MESHLET_MAX_VERTICES = 64;
+    const size_t MESHLET_MAX_TRIANGLES = 124;
+
+    struct Meshlet
+    {
+        uint32_t vertexOffset;   // into Meshlets::vertices
+        uint32_t triangleOffset; // into Meshlets::triangles (3 bytes each) and indices (3 each)
+        uint32_t vertexCount;
+        uint32_t triangleCount;
+    };
+
+    // 8 floats, laid out like the std430 struct of meshletCullGlsl
+    struct MeshletBounds
+    {
+        float center[3];
+        float radius;
+        float coneAxis[3];
+        float coneCutoff; // sine of the cone half angle, 1 when the cluster can face any way
+    };
+
+    struct Meshlets
+    {
+        std::vector<Meshlet> meshlets;
+        std::vector<MeshletBounds> bounds;
+        std::vector<uint32_t> vertices; // mesh vertex of every meshlet local vertex
+        std::vector<uint8_t> triangles; // local vertex indices, 3 per triangle
+        std::vector<uint32_t> indices;  // the mesh's triangles in meshlet order
+
+        uint32_t firstIndex(size_t meshlet) const;
+        uint32_t indexCount(size_t meshlet) const;
+    };
+
+    // coneWeight trades vertex reuse (0) for tighter normal cones (towards 1), and with
+    // that more back face culling. positions: 3 floats at the start of every positionStride
+    // bytes. Input in vertex cache order gives the best clusters.
+    void buildMeshlets(Meshlets &out, const uint32_t *indices, size_t indexCount, const float *positions,
+                       size_t vertexCount, size_t positionStride, size_t maxVertices = MESHLET_MAX_VERTICES,
+                       size_t maxTriangles = MESHLET_MAX_TRIANGLES, float coneWeight = 0.25f);
+
+    MeshletBounds computeMeshletBounds(const uint32_t *meshletVertices, const uint8_t *meshletTriangles,
+                                       size_t triangleCount, const float *positions, size_t positionStride);
+
+    struct DrawRange
+    {
+        uint32_t firstIndex;
+        uint32_t indexCount;
+    };
+
+    struct CullStats
+    {
+        size_t visible;
+        size_t frustumCulled;
+        size_t backfaceCulled;
+        size_t triangles; // in the visible meshlets
+    };
+
+    // Frustum planes from a column major view projection matrix (glm's layout), normalised,
+    // pointing inwards: left, right, bottom, top, near, far.
+    void extractFrustum(const float *viewProjection, float planes[6][4]);
+
+    // true when the cluster is outside the frustum or faces away from the camera entirely
+    bool cullFrustum(const MeshletBounds &bounds, const float planes[6][4]);
+    bool cullBackface(const MeshletBounds &bounds, const float *cameraPosition);
+
+    // Appends the index ranges of the visible meshlets to ranges, merging neighbours, and
+    // returns how many were appended. cameraPosition is in the space of the positions and
+    // viewProjection maps that space to clip space (projection * view * model).
+    size_t cullMeshlets(const Meshlets &meshlets, const float *viewProjection, const float *cameraPosition,
+                        std::vector<DrawRange> &ranges, CullStats *stats = nullptr);
+
+    // one glMultiDrawElements for all ranges, with the index buffer of meshlets.indices bound
+    void drawRanges(const std::vector<DrawRange> &ranges, GLenum indexType = GL_UNSIGNED_INT);
+
+    // GLSL 4.30 compute shader, local size 64, one invocation per meshlet. Buffers:
+    //   binding 0  MeshletBounds[]          (readonly)
+    //   binding 1  uvec2 ranges[]           firstIndex, indexCount per meshlet (readonly)
+    //   binding 2  DrawElementsIndirectCommand[] (written, compacted)
+    //   binding 3  uint drawCount           incremented atomically, zeroed by the caller
+    // Uniforms: vec4 planes[6], vec3 cameraPosition, uint meshletCount.
+    // Feed the commands and count to glMultiDrawElementsIndirectCount, or read the count back.
+    const char *meshletCullGlsl();
+} // namespace mesh
+
+#endif // MESHLET_HPP
@@ -0,0 +1,513 @@
+#include "mipmap.hpp"
+#include "cpu_features.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef LEARNOPENGL_X86
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    // roughly 64k floats of work per parallelFor chunk
+    const size_t CHUNK_FLOATS = 1 << 16;
+    const double PI = 3.14159265358979323846;
+
+    float srgbToLinear(float v)
+    {
+        return v <= 0.04045f ? v / 12.92f : std::pow((v + 0.055f) / 1.055f, 2.4f);
+    }
+
+    float linearToSrgb(float v)
+    {
+        return v <= 0.0031308f ? v * 12.92f : 1.055f * std::pow(v, 1.0f / 2.4f) - 0.055f;
+    }
+
+    // Lookup tables are built once on first use; static initialisation is thread safe.
+
+    // 8/16 bit code -> linear float
+    const float *decodeTable(bool wide, bool srgb)
+    {
+        struct Tables
+        {
+            std::vector<float> table[2][2]; // [wide][srgb]
+        };
+        static const Tables tables = []
+        {
+            Tables t;
+            for (int w = 0; w < 2; w++)
+            {
+                size_t codes = w ? 65536 : 256;
+                float maxCode = static_cast<float>(codes - 1);
+                t.table[w][0].resize(codes);
+                t.table[w][1].resize(codes);
+                for (size_t i = 0; i < codes; i++)
+                {
+                    t.table[w][0][i] = i / maxCode;
+                    t.table[w][1][i] = srgbToLinear(i / maxCode);
+                }
+            }
+            return t;
+        }();
+        return tables.table[wide ? 1 : 0][srgb ? 1 : 0].data();
+    }
+
+    // linear value quantised to 16 bits -> 8 bit code, fine enough to round sRGB correctly
+    const uint8_t *encodeTable8(bool srgb)
+    {
+        struct Tables
+        {
+            std::vector<uint8_t> table[2]; // [srgb]
+        };
+        static const Tables tables = []
+        {
+            Tables t;
+            t.table[0].resize(65536);
+            t.table[1].resize(65536);
+            for (int i = 0; i < 65536; i++)
+            {
+                t.table[0][i] = static_cast<uint8_t>(i / 65535.0f * 255.0f + 0.5f);
+                t.table[1][i] = static_cast<uint8_t>(linearToSrgb(i / 65535.0f) * 255.0f + 0.5f);
+            }
+            return t;
+        }();
+        return tables.table[srgb ? 1 : 0].data();
+    }
+
+    // linear -> sRGB sampled for linear interpolation, accurate to well under 1/65535
+    const int SRGB16_STEPS = 16384;
+    const std::vector<float> &srgbEncodeTable16()
+    {
+        static const std::vector<float> table = []
+        {
+            std::vector<float> t(SRGB16_STEPS + 2);
+            for (int i = 0; i <= SRGB16_STEPS + 1; i++)
+            {
+                t[i] = linearToSrgb(std::min(1.0f, static_cast<float>(i) / SRGB16_STEPS));
+            }
+            return t;
+        }();
+        return table;
+    }
+
+    float clamp01(float v)
+    {
+        return v < 0.0f ? 0.0f : (v > 1.0f ? 1.0f : v);
+    }
+
+    bool isColorChannel(int c, int channels)
+    {
+        // grey+alpha and rgba keep alpha in the last channel
+        return !((channels == 2 || channels == 4) && c == channels - 1);
+    }
+
+    // Per output sample: a contiguous run of source samples and their weights.
+    struct FilterTaps
+    {
+        std::vector<int> first;
+        std::vector<int> count;
+        std::vector<float> weights; // maxTaps per output sample
+        int maxTaps = 0;
+    };
+
+    double besselI0(double x)
+    {
+        double sum = 1.0, term = 1.0;
+        for (int k = 1; k < 32; k++)
+        {
+            term *= (x / (2.0 * k)) * (x / (2.0 * k));
+            sum += term;
+            if (term < sum * 1e-12)
+            {
+                break;
+            }
+        }
+        return sum;
+    }
+
+    double kaiserSinc(double t)
+    {
+        const double width = 3.0;
+        const double alpha = 4.0;
+        if (std::fabs(t) >= width)
+        {
+            return 0.0;
+        }
+        double sinc = t == 0.0 ? 1.0 : std::sin(PI * t) / (PI * t);
+        double r = t / width;
+        return sinc * besselI0(alpha * std::sqrt(1.0 - r * r)) / besselI0(alpha);
+    }
+
+    FilterTaps buildTaps(int srcSize, int dstSize, MipmapGenerator::Filter filter)
+    {
+        FilterTaps taps;
+        taps.first.resize(dstSize);
+        taps.count.resize(dstSize);
+        double scale = static_cast<double>(srcSize) / dstSize;
+        double support = filter == MipmapGenerator::BOX ? scale * 0.5 : scale * 3.0;
+        taps.maxTaps = static_cast<int>(std::ceil(support * 2.0)) + 2;
+        taps.weights.assign(static_cast<size_t>(dstSize) * taps.maxTaps, 0.0f);
+
+        for (int x = 0; x < dstSize; x++)
+        {
+            double center = (x + 0.5) * scale;
+            int lo = static_cast<int>(std::floor(center - support));
+            int hi = static_cast<int>(std::ceil(center + support));
+            int first = std::max(0, std::min(lo, srcSize - 1));
+            int last = std::max(0, std::min(hi, srcSize - 1));
+            float *w = &taps.weights[static_cast<size_t>(x) * taps.maxTaps];
+
+            double total = 0.0;
+            for (int j = lo; j <= hi; j++)
+            {
+                double weight;
+                if (filter == MipmapGenerator::BOX)
+                {
+                    double a = std::max<double>(j, x * scale);
+                    double b = std::min<double>(j + 1, (x + 1) * scale);
+                    weight = std::max(0.0, b - a);
+                }
+                else
+                {
+                    weight = kaiserSinc((j + 0.5 - center) / scale);
+                }
+                if (weight == 0.0)
+                {
+                    continue;
+                }
+                // clamp to edge: samples outside the image fold onto the border pixel
+                int k = std::max(0, std::min(j, srcSize - 1)) - first;
+                w[k] += static_cast<float>(weight);
+                total += weight;
+            }
+            for (int k = 0; k <= last - first; k++)
+            {
+                w[k] = static_cast<float>(w[k] / total);
+            }
+            // trim zero weights from both ends
+            int begin = 0, end = last - first;
+            while (begin < end && w[begin] == 0.0f)
+            {
+                begin++;
+            }
+            while (end > begin && w[end] == 0.0f)
+            {
+                end--;
+            }
+            if (begin > 0)
+            {
+                std::copy(w + begin, w + end + 1, w);
+                std::fill(w + end - begin + 1, w + taps.maxTaps, 0.0f);
+            }
+            taps.first[x] = first + begin;
+            taps.count[x] = end - begin + 1;
+        }
+        return taps;
+    }
+
+    // dst[i] (+)= weight * src[i] over a whole row, the hot loop of the vertical pass
+
+    void weightRowScalar(float *dst, const float *src, float weight, size_t n, bool accumulate)
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            dst[i] = (accumulate ? dst[i] : 0.0f) + weight * src[i];
+        }
+    }
+
+#ifdef LEARNOPENGL_X86
+    void weightRowSse(float *dst, const float *src, float weight, size_t n, bool accumulate)
+    {
+        __m128 w = _mm_set1_ps(weight);
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4)
+        {
+            __m128 v = _mm_mul_ps(_mm_loadu_ps(src + i), w);
+            if (accumulate)
+            {
+                v = _mm_add_ps(v, _mm_loadu_ps(dst + i));
+            }
+            _mm_storeu_ps(dst + i, v);
+        }
+        weightRowScalar(dst + i, src + i, weight, n - i, accumulate);
+    }
+
+    LEARNOPENGL_TARGET("avx2")
+    void weightRowAvx2(float *dst, const float *src, float weight, size_t n, bool accumulate)
+    {
+        __m256 w = _mm256_set1_ps(weight);
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8)
+        {
+            __m256 v = _mm256_mul_ps(_mm256_loadu_ps(src + i), w);
+            if (accumulate)
+            {
+                v = _mm256_add_ps(v, _mm256_loadu_ps(dst + i));
+            }
+            _mm256_storeu_ps(dst + i, v);
+        }
+        // GCC leaves this out before a tail call, the SSE code after would stall on it
+        _mm256_zeroupper();
+        weightRowSse(dst + i, src + i, weight, n - i, accumulate);
+    }
+#endif
+
+    using WeightRowFn = void (*)(float *, const float *, float, size_t, bool);
+
+    WeightRowFn selectWeightRow([[maybe_unused]] bool simd)
+    {
+#ifdef LEARNOPENGL_X86
+        if (simd)
+        {
+            return cpu::hasAvx2() ? weightRowAvx2 : weightRowSse;
+        }
+#endif
+        return weightRowScalar;
+    }
+
+    template <int N>
+    void horizontalRow(float *dst, const float *src, const FilterTaps &taps, int dstWidth)
+    {
+        for (int x = 0; x < dstWidth; x++)
+        {
+            const float *w = &taps.weights[static_cast<size_t>(x) * taps.maxTaps];
+            const float *s = src + static_cast<size_t>(taps.first[x]) * N;
+            float sum[N] = {};
+            for (int k = 0; k < taps.count[x]; k++)
+            {
+                for (int c = 0; c < N; c++)
+                {
+                    sum[c] += w[k] * s[k * N + c];
+                }
+            }
+            for (int c = 0; c < N; c++)
+            {
+                dst[static_cast<size_t>(x) * N + c] = sum[c];
+            }
+        }
+    }
+
+#ifdef LEARNOPENGL_X86
+    // rgba pixels are exactly one SSE register
+    void horizontalRowSse4(float *dst, const float *src, const FilterTaps &taps, int dstWidth)
+    {
+        for (int x = 0; x < dstWidth; x++)
+        {
+            const float *w = &taps.weights[static_cast<size_t>(x) * taps.maxTaps];
+            const float *s = src + static_cast<size_t>(taps.first[x]) * 4;
+            __m128 sum = _mm_setzero_ps();
+            for (int k = 0; k < taps.count[x]; k++)
+            {
+                sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(w[k]), _mm_loadu_ps(s + k * 4)));
+            }
+            _mm_storeu_ps(dst + static_cast<size_t>(x) * 4, sum);
+        }
+    }
+#endif
+
+    void horizontalPass(float *dst, const float *src, const FilterTaps &taps, int dstWidth, int channels,
+                        [[maybe_unused]] bool simd)
+    {
+        switch (channels)
+        {
+        case 1:
+            horizontalRow<1>(dst, src, taps, dstWidth);
+            break;
+        case 2:
+            horizontalRow<2>(dst, src, taps, dstWidth);
+            break;
+        case 3:
+            horizontalRow<3>(dst, src, taps, dstWidth);
+            break;
+        default:
+#ifdef LEARNOPENGL_X86
+            if (simd)
+            {
+                horizontalRowSse4(dst, src, taps, dstWidth);
+                break;
+            }
+#endif
+            horizontalRow<4>(dst, src, taps, dstWidth);
+            break;
+        }
+    }
+
+    struct RowCodec
+    {
+        bool wide;
+        bool linearFloat; // 32 bit input is copied through as is, no transfer curve and no clamping
+        int channels;
+        const float *decode[4];
+        const uint8_t *encode8[4];
+        bool srgb[4];
+
+        RowCodec(int bits, int channels, bool srgb) : wide(bits == 16), linearFloat(bits == 32), channels(channels)
+        {
+            for (int c = 0; c < 4; c++)
+            {
+                this->srgb[c] = srgb && isColorChannel(c, channels);
+                decode[c] = decodeTable(wide, this->srgb[c]);
+                encode8[c] = encodeTable8(this->srgb[c]);
+            }
+        }
+
+        void decodeRow(const void *src, float *dst, int width) const
+        {
+            if (linearFloat)
+            {
+                std::memcpy(dst, src, static_cast<size_t>(width) * channels * sizeof(float));
+                return;
+            }
+            const uint8_t *src8 = static_cast<const uint8_t *>(src);
+            const uint16_t *src16 = static_cast<const uint16_t *>(src);
+            for (int x = 0; x < width; x++)
+            {
+                for (int c = 0; c < channels; c++)
+                {
+                    size_t i = static_cast<size_t>(x) * channels + c;
+                    dst[i] = decode[c][wide ? src16[i] : src8[i]];
+                }
+            }
+        }
+
+        void encodeRow(const float *src, void *dst, int width) const
+        {
+            if (linearFloat)
+            {
+                std::memcpy(dst, src, static_cast<size_t>(width) * channels * sizeof(float));
+                return;
+            }
+            uint8_t *dst8 = static_cast<uint8_t *>(dst);
+            uint16_t *dst16 = static_cast<uint16_t *>(dst);
+            const std::vector<float> &srgb16 = srgbEncodeTable16();
+            for (int x = 0; x < width; x++)
+            {
+                for (int c = 0; c < channels; c++)
+                {
+                    size_t i = static_cast<size_t>(x) * channels + c;
+                    float v = clamp01(src[i]);
+                    if (!wide)
+                    {
+                        dst8[i] = encode8[c][static_cast<int>(v * 65535.0f + 0.5f)];
+                    }
+                    else if (srgb[c])
+                    {
+                        float f = v * SRGB16_STEPS;
+                        int k = static_cast<int>(f);
+                        float e = srgb16[k] + (srgb16[k + 1] - srgb16[k]) * (f - k);
+                        dst16[i] = static_cast<uint16_t>(e * 65535.0f + 0.5f);
+                    }
+                    else
+                    {
+                        dst16[i] = static_cast<uint16_t>(v * 65535.0f + 0.5f);
+                    }
+                }
+            }
+        }
+    };
+
+    size_t rowGrain(size_t rowFloats)
+    {
+        return std::max<size_t>(1, CHUNK_FLOATS / std::max<size_t>(1, rowFloats));
+    }
+} // namespace
+
+MipmapGenerator::MipmapGenerator(Filter filter, bool srgb) : m_filter(filter), m_srgb(srgb), m_simd(true) {};
+
+void MipmapGenerator::setSimd(bool enabled)
+{
+    m_simd = enabled;
+}
+
+int MipmapGenerator::levelCount(int width, int height)
+{
+    int levels = 1;
+    int size = std::max(width, height);
+    while (size > 1)
+    {
+        size /= 2;
+        levels++;
+    }
+    return levels;
+}
+
+std::vector<MipmapGenerator::Level> MipmapGenerator::generate(const void *pixels, int width, int height, int channels,
+                                                              int bitsPerChannel, int maxLevels) const
+{
+    if (pixels == nullptr || width <= 0 || height <= 0 || channels < 1 || channels > 4 ||
+        (bitsPerChannel != 8 && bitsPerChannel != 16 && bitsPerChannel != 32))
+    {
+        throw std::invalid_argument("MipmapGenerator: unsupported image format");
+    }
+
+    ThreadPool &pool = ThreadPool::shared();
+    WeightRowFn weightRow = selectWeightRow(m_simd);
+    const size_t n = static_cast<size_t>(channels);
+    const size_t bytesPerChannel = static_cast<size_t>(bitsPerChannel / 8);
+    const RowCodec codec(bitsPerChannel, channels, m_srgb);
+
+    // decode level 0 into linear float
+    size_t srcRowFloats = static_cast<size_t>(width) * n;
+    std::vector<float> current(srcRowFloats * height);
+    pool.parallelFor(height, rowGrain(srcRowFloats), [&](size_t begin, size_t end)
+                     {
+        for (size_t y = begin; y < end; y++)
+        {
+            codec.decodeRow(static_cast<const uint8_t *>(pixels) + y * srcRowFloats * bytesPerChannel,
+                            &current[y * srcRowFloats], width);
+        } });
+
+    std::vector<Level> levels;
+    int total = levelCount(width, height) - 1;
+    if (maxLevels > 0)
+    {
+        total = std::min(total, maxLevels);
+    }
+    levels.reserve(total);
+
+    std::vector<float> horizontal, next;
+    int srcW = width, srcH = height;
+    for (int level = 1; level <= total; level++)
+    {
+        int dstW = std::max(1, srcW / 2);
+        int dstH = std::max(1, srcH / 2);
+        FilterTaps hTaps = buildTaps(srcW, dstW, m_filter);
+        FilterTaps vTaps = buildTaps(srcH, dstH, m_filter);
+        size_t srcRow = static_cast<size_t>(srcW) * n;
+        size_t dstRow = static_cast<size_t>(dstW) * n;
+
+        horizontal.resize(dstRow * srcH);
+        pool.parallelFor(srcH, rowGrain(srcRow), [&](size_t begin, size_t end)
+                         {
+            for (size_t y = begin; y < end; y++)
+            {
+                horizontalPass(&horizontal[y * dstRow], &current[y * srcRow], hTaps, dstW, channels, m_simd);
+            } });
+
+        next.resize(dstRow * dstH);
+        Level out{level, dstW, dstH, std::vector<unsigned char>(dstRow * dstH * bytesPerChannel)};
+        pool.parallelFor(dstH, rowGrain(dstRow * vTaps.maxTaps), [&](size_t begin, size_t end)
+                         {
+            for (size_t y = begin; y < end; y++)
+            {
+                float *row = &next[y * dstRow];
+                const float *w = &vTaps.weights[y * vTaps.maxTaps];
+                for (int k = 0; k < vTaps.count[y]; k++)
+                {
+                    weightRow(row, &horizontal[(vTaps.first[y] + k) * dstRow], w[k], dstRow, k > 0);
+                }
+
+                codec.encodeRow(row, &out.data[y * dstRow * bytesPerChannel], dstW);
+            } });
+
+        levels.push_back(std::move(out));
+        current.swap(next);
+        srcW = dstW;
+        srcH = dstH;
+    }
+    return levels;
+}
@@ -0,0 +1,51 @@
+#ifndef MIPMAP_HPP
+#define MIPMAP_HPP
+
+#include <vector>
+
+// Builds a full mip chain on the CPU instead of relying on glGenerateMipmap.
+// Filtering happens in linear light: sRGB colour channels are decoded before
+// downsampling and re-encoded afterwards, alpha is always treated as linear.
+// The generator holds no GL state and no mutable globals, so it can be used
+// from texture loader threads; rows are spread over ThreadPool::shared().
+class MipmapGenerator
+{
+public:
+    enum Filter
+    {
+        BOX,    // exact area average, the classic 2x2 box for power of two sizes
+        KAISER, // Kaiser windowed sinc (width 3, alpha 4), sharper minification
+    };
+
+    struct Level
+    {
+        int level;
+        int width;
+        int height;
+        std::vector<unsigned char> data; // tightly packed, same channels/depth as the input
+    };
+
+    MipmapGenerator(Filter filter = BOX, bool srgb = true);
+
+    // pixels are tightly packed rows of 1-4 channels with 8, 16 or 32 bits per channel
+    // (unsigned char from stbi_load, unsigned short from stbi_load_16, float from
+    // stbi_loadf). Floats are already linear: the sRGB flag does not apply to them and
+    // levels keep values outside [0, 1].
+    // Returns levels 1..N down to 1x1, level 0 stays with the caller.
+    // maxLevels limits the number of returned levels, 0 means the full chain.
+    std::vector<Level> generate(const void *pixels, int width, int height, int channels, int bitsPerChannel,
+                                int maxLevels = 0) const;
+
+    // the scalar passes are the reference for the SIMD ones, output is bit identical
+    void setSimd(bool enabled);
+
+    static int levelCount(int width, int height);
+
+private:
+    // vars
+    Filter m_filter;
+    bool m_srgb;
+    bool m_simd;
+};
+
+#endif // MIPMAP_HPP
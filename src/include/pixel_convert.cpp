@@ -0,0 +1,346 @@
+#include "pixel_convert.hpp"
+#include "cpu_features.hpp"
+#include <algorithm>
+#include <cstring>
+
+#ifdef LEARNOPENGL_X86
+#include <immintrin.h>
+#endif
+
+// ---------------------------------------------------------------------------
+// scalar reference kernels, also used for the tails of the SIMD loops
+
+void pixel::scalar::rgbToRgba(const uint8_t *src, uint8_t *dst, size_t count, uint8_t alpha)
+{
+    for (size_t i = 0; i < count; i++, src += 3, dst += 4)
+    {
+        dst[0] = src[0];
+        dst[1] = src[1];
+        dst[2] = src[2];
+        dst[3] = alpha;
+    }
+}
+
+void pixel::scalar::swapRedBlue(uint8_t *pixels, size_t count, int channels)
+{
+    for (size_t i = 0; i < count; i++, pixels += channels)
+    {
+        std::swap(pixels[0], pixels[2]);
+    }
+}
+
+void pixel::scalar::premultiplyAlpha(uint8_t *rgba, size_t count)
+{
+    for (size_t i = 0; i < count; i++, rgba += 4)
+    {
+        unsigned a = rgba[3];
+        for (int c = 0; c < 3; c++)
+        {
+            // exact round(c * a / 255) without a division
+            unsigned t = rgba[c] * a + 128;
+            rgba[c] = static_cast<uint8_t>((t + (t >> 8)) >> 8);
+        }
+    }
+}
+
+void pixel::scalar::widen8To16(const uint8_t *src, uint16_t *dst, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        dst[i] = static_cast<uint16_t>(src[i] * 257);
+    }
+}
+
+namespace
+{
+#ifdef LEARNOPENGL_X86
+    LEARNOPENGL_TARGET("ssse3")
+    size_t rgbToRgbaSsse3(const uint8_t *src, uint8_t *dst, size_t count, uint8_t alpha)
+    {
+        // 12 bytes of RGB -> 16 bytes of RGB_, alpha is or'ed in afterwards
+        const __m128i mask = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+        const __m128i alphaBits = _mm_set1_epi32(static_cast<int>(static_cast<uint32_t>(alpha) << 24));
+        size_t i = 0;
+        // 16 pixels = three 16 byte loads in, four 16 byte stores out
+        for (; i + 16 <= count; i += 16)
+        {
+            const uint8_t *s = src + i * 3;
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + 16));
+            __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + 32));
+            __m128i p0 = a;
+            __m128i p1 = _mm_alignr_epi8(b, a, 12);
+            __m128i p2 = _mm_alignr_epi8(c, b, 8);
+            __m128i p3 = _mm_srli_si128(c, 4);
+            __m128i *d = reinterpret_cast<__m128i *>(dst + i * 4);
+            _mm_storeu_si128(d, _mm_or_si128(_mm_shuffle_epi8(p0, mask), alphaBits));
+            _mm_storeu_si128(d + 1, _mm_or_si128(_mm_shuffle_epi8(p1, mask), alphaBits));
+            _mm_storeu_si128(d + 2, _mm_or_si128(_mm_shuffle_epi8(p2, mask), alphaBits));
+            _mm_storeu_si128(d + 3, _mm_or_si128(_mm_shuffle_epi8(p3, mask), alphaBits));
+        }
+        return i;
+    }
+
+    LEARNOPENGL_TARGET("avx2")
+    size_t rgbToRgbaAvx2(const uint8_t *src, uint8_t *dst, size_t count, uint8_t alpha)
+    {
+        const __m256i mask = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1, 0, 1, 2, -1, 3, 4,
+                                              5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+        const __m256i alphaBits = _mm256_set1_epi32(static_cast<int>(static_cast<uint32_t>(alpha) << 24));
+        size_t i = 0;
+        // 16 pixels per step: each 128 bit lane expands the 12 bytes of four pixels.
+        // The last load reads 4 bytes past the 48 used, hence the extra pixels of slack.
+        for (; i + 18 <= count; i += 16)
+        {
+            const uint8_t *s = src + i * 3;
+            __m256i lo = _mm256_inserti128_si256(
+                _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(s))),
+                _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + 12)), 1);
+            __m256i hi = _mm256_inserti128_si256(
+                _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(s + 24))),
+                _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + 36)), 1);
+            __m256i *d = reinterpret_cast<__m256i *>(dst + i * 4);
+            _mm256_storeu_si256(d, _mm256_or_si256(_mm256_shuffle_epi8(lo, mask), alphaBits));
+            _mm256_storeu_si256(d + 1, _mm256_or_si256(_mm256_shuffle_epi8(hi, mask), alphaBits));
+        }
+        return i;
+    }
+
+    // Shuffle controls for swapping red and blue across 16 RGB pixels held in three
+    // registers: output register r takes bytes from input registers r-1, r and r+1.
+    struct Swap3Masks
+    {
+        alignas(16) int8_t mask[3][3][16]; // [output][input - output + 1][byte]
+    };
+
+    const Swap3Masks &swap3Masks()
+    {
+        static const Swap3Masks masks = []
+        {
+            Swap3Masks m;
+            std::memset(m.mask, -1, sizeof(m.mask));
+            for (int j = 0; j < 48; j++)
+            {
+                int source = j - j % 3 + 2 - j % 3;
+                int output = j / 16;
+                int input = source / 16;
+                m.mask[output][input - output + 1][j % 16] = static_cast<int8_t>(source % 16);
+            }
+            return m;
+        }();
+        return masks;
+    }
+
+    LEARNOPENGL_TARGET("ssse3")
+    size_t swapRedBlue3Ssse3(uint8_t *pixels, size_t count)
+    {
+        const Swap3Masks &m = swap3Masks();
+        auto mask = [&](int output, int input)
+        { return _mm_load_si128(reinterpret_cast<const __m128i *>(m.mask[output][input - output + 1])); };
+        const __m128i m00 = mask(0, 0), m01 = mask(0, 1);
+        const __m128i m10 = mask(1, 0), m11 = mask(1, 1), m12 = mask(1, 2);
+        const __m128i m21 = mask(2, 1), m22 = mask(2, 2);
+        size_t i = 0;
+        for (; i + 16 <= count; i += 16)
+        {
+            __m128i *p = reinterpret_cast<__m128i *>(pixels + i * 3);
+            __m128i a = _mm_loadu_si128(p);
+            __m128i b = _mm_loadu_si128(p + 1);
+            __m128i c = _mm_loadu_si128(p + 2);
+            _mm_storeu_si128(p, _mm_or_si128(_mm_shuffle_epi8(a, m00), _mm_shuffle_epi8(b, m01)));
+            _mm_storeu_si128(p + 1, _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a, m10), _mm_shuffle_epi8(b, m11)),
+                                                 _mm_shuffle_epi8(c, m12)));
+            _mm_storeu_si128(p + 2, _mm_or_si128(_mm_shuffle_epi8(b, m21), _mm_shuffle_epi8(c, m22)));
+        }
+        return i;
+    }
+
+    LEARNOPENGL_TARGET("ssse3")
+    size_t swapRedBlue4Ssse3(uint8_t *pixels, size_t count)
+    {
+        const __m128i mask = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128i *p = reinterpret_cast<__m128i *>(pixels + i * 4);
+            _mm_storeu_si128(p, _mm_shuffle_epi8(_mm_loadu_si128(p), mask));
+        }
+        return i;
+    }
+
+    LEARNOPENGL_TARGET("avx2")
+    size_t swapRedBlue4Avx2(uint8_t *pixels, size_t count)
+    {
+        const __m256i mask = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15, 2, 1, 0, 3, 6, 5, 4,
+                                              7, 10, 9, 8, 11, 14, 13, 12, 15);
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m256i *p = reinterpret_cast<__m256i *>(pixels + i * 4);
+            _mm256_storeu_si256(p, _mm256_shuffle_epi8(_mm256_loadu_si256(p), mask));
+        }
+        return i;
+    }
+
+    // (c * a + 128 + ((c * a + 128) >> 8)) >> 8 on 16 bit lanes, same rounding as the scalar code
+    LEARNOPENGL_TARGET("ssse3")
+    __m128i premultiplyLanes(__m128i colour, __m128i alpha)
+    {
+        __m128i t = _mm_add_epi16(_mm_mullo_epi16(colour, alpha), _mm_set1_epi16(128));
+        return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+    }
+
+    LEARNOPENGL_TARGET("ssse3")
+    size_t premultiplySsse3(uint8_t *rgba, size_t count)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i alphaLo = _mm_setr_epi8(3, -1, 3, -1, 3, -1, 3, -1, 7, -1, 7, -1, 7, -1, 7, -1);
+        const __m128i alphaHi = _mm_setr_epi8(11, -1, 11, -1, 11, -1, 11, -1, 15, -1, 15, -1, 15, -1, 15, -1);
+        const __m128i alphaBytes = _mm_set1_epi32(static_cast<int>(0xFF000000u));
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128i *p = reinterpret_cast<__m128i *>(rgba + i * 4);
+            __m128i v = _mm_loadu_si128(p);
+            __m128i lo = premultiplyLanes(_mm_unpacklo_epi8(v, zero), _mm_shuffle_epi8(v, alphaLo));
+            __m128i hi = premultiplyLanes(_mm_unpackhi_epi8(v, zero), _mm_shuffle_epi8(v, alphaHi));
+            __m128i result = _mm_packus_epi16(lo, hi);
+            _mm_storeu_si128(p, _mm_or_si128(_mm_andnot_si128(alphaBytes, result), _mm_and_si128(alphaBytes, v)));
+        }
+        return i;
+    }
+
+    LEARNOPENGL_TARGET("avx2")
+    size_t premultiplyAvx2(uint8_t *rgba, size_t count)
+    {
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i alphaLo = _mm256_setr_epi8(3, -1, 3, -1, 3, -1, 3, -1, 7, -1, 7, -1, 7, -1, 7, -1, 3, -1, 3, -1, 3,
+                                                 -1, 3, -1, 7, -1, 7, -1, 7, -1, 7, -1);
+        const __m256i alphaHi = _mm256_setr_epi8(11, -1, 11, -1, 11, -1, 11, -1, 15, -1, 15, -1, 15, -1, 15, -1, 11, -1,
+                                                 11, -1, 11, -1, 11, -1, 15, -1, 15, -1, 15, -1, 15, -1);
+        const __m256i alphaBytes = _mm256_set1_epi32(static_cast<int>(0xFF000000u));
+        const __m256i half = _mm256_set1_epi16(128);
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m256i *p = reinterpret_cast<__m256i *>(rgba + i * 4);
+            __m256i v = _mm256_loadu_si256(p);
+            // unpack and pack both work per 128 bit lane, so the pixel order survives the round trip
+            __m256i lo = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(v, zero), _mm256_shuffle_epi8(v, alphaLo)),
+                                          half);
+            __m256i hi = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(v, zero), _mm256_shuffle_epi8(v, alphaHi)),
+                                          half);
+            lo = _mm256_srli_epi16(_mm256_add_epi16(lo, _mm256_srli_epi16(lo, 8)), 8);
+            hi = _mm256_srli_epi16(_mm256_add_epi16(hi, _mm256_srli_epi16(hi, 8)), 8);
+            __m256i result = _mm256_packus_epi16(lo, hi);
+            _mm256_storeu_si256(p, _mm256_or_si256(_mm256_andnot_si256(alphaBytes, result), _mm256_and_si256(alphaBytes, v)));
+        }
+        return i;
+    }
+
+    size_t widenSse2(const uint8_t *src, uint16_t *dst, size_t count)
+    {
+        size_t i = 0;
+        for (; i + 16 <= count; i += 16)
+        {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+            // interleaving a byte with itself is exactly v * 257
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_unpacklo_epi8(v, v));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i + 8), _mm_unpackhi_epi8(v, v));
+        }
+        return i;
+    }
+
+    LEARNOPENGL_TARGET("avx2")
+    size_t widenAvx2(const uint8_t *src, uint16_t *dst, size_t count)
+    {
+        size_t i = 0;
+        for (; i + 32 <= count; i += 32)
+        {
+            __m256i a = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i)));
+            __m256i b = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i + 16)));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), _mm256_or_si256(a, _mm256_slli_epi16(a, 8)));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i + 16), _mm256_or_si256(b, _mm256_slli_epi16(b, 8)));
+        }
+        return i;
+    }
+#endif
+} // namespace
+
+// ---------------------------------------------------------------------------
+// dispatching entry points
+
+void pixel::rgbToRgba(const uint8_t *src, uint8_t *dst, size_t count, uint8_t alpha)
+{
+    size_t done = 0;
+#ifdef LEARNOPENGL_X86
+    if (cpu::hasAvx2())
+    {
+        done = rgbToRgbaAvx2(src, dst, count, alpha);
+    }
+    else if (cpu::hasSsse3())
+    {
+        done = rgbToRgbaSsse3(src, dst, count, alpha);
+    }
+#endif
+    scalar::rgbToRgba(src + done * 3, dst + done * 4, count - done, alpha);
+}
+
+void pixel::swapRedBlue(uint8_t *pixels, size_t count, int channels)
+{
+    size_t done = 0;
+#ifdef LEARNOPENGL_X86
+    if (channels == 4 && cpu::hasAvx2())
+    {
+        done = swapRedBlue4Avx2(pixels, count);
+    }
+    else if (cpu::hasSsse3())
+    {
+        done = channels == 4 ? swapRedBlue4Ssse3(pixels, count) : swapRedBlue3Ssse3(pixels, count);
+    }
+#endif
+    scalar::swapRedBlue(pixels + done * channels, count - done, channels);
+}
+
+void pixel::premultiplyAlpha(uint8_t *rgba, size_t count)
+{
+    size_t done = 0;
+#ifdef LEARNOPENGL_X86
+    if (cpu::hasAvx2())
+    {
+        done = premultiplyAvx2(rgba, count);
+    }
+    else if (cpu::hasSsse3())
+    {
+        done = premultiplySsse3(rgba, count);
+    }
+#endif
+    scalar::premultiplyAlpha(rgba + done * 4, count - done);
+}
+
+void pixel::widen8To16(const uint8_t *src, uint16_t *dst, size_t count)
+{
+    size_t done = 0;
+#ifdef LEARNOPENGL_X86
+    done = cpu::hasAvx2() ? widenAvx2(src, dst, count) : widenSse2(src, dst, count);
+#endif
+    scalar::widen8To16(src + done, dst + done, count - done);
+}
+
+void pixel::flipVertical(void *pixels, size_t rowBytes, size_t rows)
+{
+    // swap rows through a small stack buffer; memcpy is already vectorised
+    unsigned char buffer[4096];
+    unsigned char *top = static_cast<unsigned char *>(pixels);
+    unsigned char *bottom = top + (rows > 0 ? rows - 1 : 0) * rowBytes;
+    for (; top < bottom; top += rowBytes, bottom -= rowBytes)
+    {
+        for (size_t offset = 0; offset < rowBytes; offset += sizeof(buffer))
+        {
+            size_t n = std::min(sizeof(buffer), rowBytes - offset);
+            std::memcpy(buffer, top + offset, n);
+            std::memcpy(top + offset, bottom + offset, n);
+            std::memcpy(bottom + offset, buffer, n);
+        }
+    }
+}
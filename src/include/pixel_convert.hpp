@@ -0,0 +1,34 @@
+#ifndef PIXEL_CONVERT_HPP
+#define PIXEL_CONVERT_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+// Layout conversions applied to decoded pixels before they are uploaded, so the
+// driver only ever sees formats it can copy straight into texture memory
+// (RGBA8 rather than RGB8, rows without alignment padding).
+// Every function picks an SSSE3 or AVX2 kernel at run time; pixel::scalar holds
+// the plain versions the SIMD ones are checked against.
+namespace pixel
+{
+    // count RGB pixels -> count RGBA pixels with the given alpha. src and dst must not overlap.
+    void rgbToRgba(const uint8_t *src, uint8_t *dst, size_t count, uint8_t alpha = 255);
+    // RGB <-> BGR (channels == 3) or RGBA <-> BGRA (channels == 4), in place
+    void swapRedBlue(uint8_t *pixels, size_t count, int channels);
+    // RGBA8 with straight alpha -> premultiplied, c = round(c * a / 255), in place
+    void premultiplyAlpha(uint8_t *rgba, size_t count);
+    // reverses the row order in place, what stbi_set_flip_vertically_on_load does for GL's bottom-up origin
+    void flipVertical(void *pixels, size_t rowBytes, size_t rows);
+    // count 8 bit values -> 16 bit, v * 257 so 255 maps to 65535
+    void widen8To16(const uint8_t *src, uint16_t *dst, size_t count);
+
+    namespace scalar
+    {
+        void rgbToRgba(const uint8_t *src, uint8_t *dst, size_t count, uint8_t alpha = 255);
+        void swapRedBlue(uint8_t *pixels, size_t count, int channels);
+        void premultiplyAlpha(uint8_t *rgba, size_t count);
+        void widen8To16(const uint8_t *src, uint16_t *dst, size_t count);
+    } // namespace scalar
+} // namespace pixel
+
+#endif // PIXEL_CONVERT_HPP
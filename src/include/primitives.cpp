@@ -0,0 +1,742 @@
+#include "primitives.hpp"
+#include "cpu_features.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#ifdef LEARNOPENGL_X86
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    const float PI = 3.14159265358979f;
+
+    // vertices per parallel chunk, small shapes stay on the calling thread
+    const size_t CHUNK_VERTICES = 16384;
+
+    float *streamAt(float *base, size_t stride, size_t vertex)
+    {
+        return reinterpret_cast<float *>(reinterpret_cast<unsigned char *>(base) + vertex * stride);
+    }
+
+    struct VertexValues
+    {
+        float position[3];
+        float normal[3];
+        float tangent[4];
+        float uv[2];
+    };
+
+    void writeVertex(const mesh::GeometryStreams &out, size_t vertex, const VertexValues &v)
+    {
+        if (out.positions != nullptr)
+        {
+            std::copy(v.position, v.position + 3, streamAt(out.positions, out.positionStride, vertex));
+        }
+        if (out.normals != nullptr)
+        {
+            std::copy(v.normal, v.normal + 3, streamAt(out.normals, out.normalStride, vertex));
+        }
+        if (out.tangents != nullptr)
+        {
+            std::copy(v.tangent, v.tangent + 4, streamAt(out.tangents, out.tangentStride, vertex));
+        }
+        if (out.uvs != nullptr)
+        {
+            std::copy(v.uv, v.uv + 2, streamAt(out.uvs, out.uvStride, vertex));
+        }
+    }
+
+    // ---------------------------------------------------------------------------
+    // surfaces of revolution: every row is a ring of radius r at height y
+
+    struct Ring
+    {
+        float r;
+        float y;
+        float nr; // normal = (nr cos, ny, -nr sin)
+        float ny;
+        float v;
+    };
+
+    // cos / sin / u per column, the last column repeats the first exactly
+    struct Columns
+    {
+        int segments;
+        std::vector<float> cosines;
+        std::vector<float> sines;
+        std::vector<float> us;
+
+        explicit Columns(int count) : segments{count}
+        {
+            for (int j = 0; j <= segments; j++)
+            {
+                float phi = 2.0f * PI * static_cast<float>(j % segments) / static_cast<float>(segments);
+                cosines.push_back(std::cos(phi));
+                sines.push_back(std::sin(phi));
+                us.push_back(static_cast<float>(j) / static_cast<float>(segments));
+            }
+        };
+    };
+
+    // angle phi runs from +x towards -z so u grows to the right seen from outside
+    void revolveVertex(const mesh::GeometryStreams &out, size_t vertex, const Ring &ring, float c, float s, float u)
+    {
+        VertexValues v = {{ring.r * c, ring.y, -ring.r * s}, {ring.nr * c, ring.ny, -ring.nr * s}, {-s, 0.0f, -c, 1.0f},
+                          {u, ring.v}};
+        writeVertex(out, vertex, v);
+    }
+
+#ifdef LEARNOPENGL_X86
+    // four consecutive vertices, one register per component
+    struct VertexLanes
+    {
+        __m128 position[3];
+        __m128 normal[3];
+        __m128 tangent[4];
+        __m128 uv[2];
+    };
+
+    // transposed in registers and stored without touching the bytes between vertices
+    void storeLanes3(float *base, size_t stride, size_t vertex, const __m128 lanes[3])
+    {
+        __m128 x = lanes[0], y = lanes[1], z = lanes[2], w = _mm_setzero_ps();
+        _MM_TRANSPOSE4_PS(x, y, z, w);
+        const __m128 rows[4] = {x, y, z, w};
+        for (size_t k = 0; k < 4; k++)
+        {
+            float *dst = streamAt(base, stride, vertex + k);
+            _mm_storel_pi(reinterpret_cast<__m64 *>(dst), rows[k]);
+            _mm_store_ss(dst + 2, _mm_movehl_ps(rows[k], rows[k]));
+        }
+    }
+
+    void storeLanes4(float *base, size_t stride, size_t vertex, const __m128 lanes[4])
+    {
+        __m128 x = lanes[0], y = lanes[1], z = lanes[2], w = lanes[3];
+        _MM_TRANSPOSE4_PS(x, y, z, w);
+        _mm_storeu_ps(streamAt(base, stride, vertex), x);
+        _mm_storeu_ps(streamAt(base, stride, vertex + 1), y);
+        _mm_storeu_ps(streamAt(base, stride, vertex + 2), z);
+        _mm_storeu_ps(streamAt(base, stride, vertex + 3), w);
+    }
+
+    void storeLanes2(float *base, size_t stride, size_t vertex, const __m128 lanes[2])
+    {
+        __m128 low = _mm_unpacklo_ps(lanes[0], lanes[1]);
+        __m128 high = _mm_unpackhi_ps(lanes[0], lanes[1]);
+        _mm_storel_pi(reinterpret_cast<__m64 *>(streamAt(base, stride, vertex)), low);
+        _mm_storeh_pi(reinterpret_cast<__m64 *>(streamAt(base, stride, vertex + 1)), low);
+        _mm_storel_pi(reinterpret_cast<__m64 *>(streamAt(base, stride, vertex + 2)), high);
+        _mm_storeh_pi(reinterpret_cast<__m64 *>(streamAt(base, stride, vertex + 3)), high);
+    }
+
+    void writeLanes(const mesh::GeometryStreams &out, size_t vertex, const VertexLanes &v)
+    {
+        if (out.positions != nullptr)
+        {
+            storeLanes3(out.positions, out.positionStride, vertex, v.position);
+        }
+        if (out.normals != nullptr)
+        {
+            storeLanes3(out.normals, out.normalStride, vertex, v.normal);
+        }
+        if (out.tangents != nullptr)
+        {
+            storeLanes4(out.tangents, out.tangentStride, vertex, v.tangent);
+        }
+        if (out.uvs != nullptr)
+        {
+            storeLanes2(out.uvs, out.uvStride, vertex, v.uv);
+        }
+    }
+#endif
+
+    void revolveRow(const mesh::GeometryStreams &out, size_t first, const Ring &ring, const Columns &columns)
+    {
+        size_t count = static_cast<size_t>(columns.segments) + 1;
+        size_t j = 0;
+#ifdef LEARNOPENGL_X86
+        // four columns per step
+        const __m128 r = _mm_set1_ps(ring.r);
+        const __m128 nr = _mm_set1_ps(ring.nr);
+        const __m128 negate = _mm_set1_ps(-0.0f);
+        VertexLanes v;
+        v.position[1] = _mm_set1_ps(ring.y);
+        v.normal[1] = _mm_set1_ps(ring.ny);
+        v.tangent[1] = _mm_setzero_ps();
+        v.tangent[3] = _mm_set1_ps(1.0f);
+        v.uv[1] = _mm_set1_ps(ring.v);
+        for (; j + 4 <= count; j += 4)
+        {
+            __m128 c = _mm_loadu_ps(&columns.cosines[j]);
+            __m128 s = _mm_xor_ps(_mm_loadu_ps(&columns.sines[j]), negate);
+            v.position[0] = _mm_mul_ps(r, c);
+            v.position[2] = _mm_mul_ps(r, s);
+            v.normal[0] = _mm_mul_ps(nr, c);
+            v.normal[2] = _mm_mul_ps(nr, s);
+            v.tangent[0] = s;
+            v.tangent[2] = _mm_xor_ps(c, negate);
+            v.uv[0] = _mm_loadu_ps(&columns.us[j]);
+            writeLanes(out, first + j, v);
+        }
+#endif
+        for (; j < count; j++)
+        {
+            revolveVertex(out, first + j, ring, columns.cosines[j], columns.sines[j], columns.us[j]);
+        }
+    }
+
+    template <typename RingFn>
+    void revolve(const mesh::GeometryStreams &out, size_t first, int rows, const Columns &columns, RingFn ringAt)
+    {
+        size_t width = static_cast<size_t>(columns.segments) + 1;
+        size_t grain = std::max<size_t>(1, CHUNK_VERTICES / width);
+        ThreadPool::shared().parallelFor(static_cast<size_t>(rows), grain,
+                                         [&](size_t begin, size_t end)
+                                         {
+                                             for (size_t i = begin; i < end; i++)
+                                             {
+                                                 revolveRow(out, first + i * width, ringAt(static_cast<int>(i)), columns);
+                                             }
+                                         });
+    }
+
+    // ---------------------------------------------------------------------------
+    // grid indices: quad (a, a + 1, b, b + 1) with b one row below a becomes a, b, a + 1
+    // and a + 1, b, b + 1
+
+    enum Band
+    {
+        FULL,
+        TOP_POLE,    // the upper row is one point, only a + 1, b, b + 1 is left
+        BOTTOM_POLE, // the lower row is one point, only a, b, a + 1 is left
+    };
+
+    void bandScalar(uint32_t *dst, uint32_t a, uint32_t width, size_t quads, Band band)
+    {
+        for (size_t q = 0; q < quads; q++, a++)
+        {
+            uint32_t b = a + width;
+            if (band != TOP_POLE)
+            {
+                *dst++ = a;
+                *dst++ = b;
+                *dst++ = a + 1;
+            }
+            if (band != BOTTOM_POLE)
+            {
+                *dst++ = a + 1;
+                *dst++ = b;
+                *dst++ = b + 1;
+            }
+        }
+    }
+
+#ifdef LEARNOPENGL_X86
+    // 4 quads = 24 indices = 6 stores; lane k of store m is index 4m + k of the group
+    void bandSse(uint32_t *dst, uint32_t a, uint32_t width, size_t quads)
+    {
+        const uint32_t corner[6] = {0, width, 1, 1, width, width + 1};
+        __m128i pattern[6];
+        for (int m = 0; m < 6; m++)
+        {
+            alignas(16) uint32_t lanes[4];
+            for (int k = 0; k < 4; k++)
+            {
+                int index = m * 4 + k;
+                lanes[k] = static_cast<uint32_t>(index / 6) + corner[index % 6];
+            }
+            pattern[m] = _mm_load_si128(reinterpret_cast<const __m128i *>(lanes));
+        }
+        size_t q = 0;
+        __m128i base = _mm_set1_epi32(static_cast<int>(a));
+        const __m128i step = _mm_set1_epi32(4);
+        for (; q + 4 <= quads; q += 4)
+        {
+            __m128i *out = reinterpret_cast<__m128i *>(dst + q * 6);
+            for (int m = 0; m < 6; m++)
+            {
+                _mm_storeu_si128(out + m, _mm_add_epi32(base, pattern[m]));
+            }
+            base = _mm_add_epi32(base, step);
+        }
+        bandScalar(dst + q * 6, a + static_cast<uint32_t>(q), width, quads - q, FULL);
+    }
+
+    LEARNOPENGL_TARGET("avx2")
+    void bandAvx2(uint32_t *dst, uint32_t a, uint32_t width, size_t quads)
+    {
+        const uint32_t corner[6] = {0, width, 1, 1, width, width + 1};
+        __m256i pattern[6];
+        for (int m = 0; m < 6; m++)
+        {
+            alignas(32) uint32_t lanes[8];
+            for (int k = 0; k < 8; k++)
+            {
+                int index = m * 8 + k;
+                lanes[k] = static_cast<uint32_t>(index / 6) + corner[index % 6];
+            }
+            pattern[m] = _mm256_load_si256(reinterpret_cast<const __m256i *>(lanes));
+        }
+        size_t q = 0;
+        __m256i base = _mm256_set1_epi32(static_cast<int>(a));
+        const __m256i step = _mm256_set1_epi32(8);
+        for (; q + 8 <= quads; q += 8)
+        {
+            __m256i *out = reinterpret_cast<__m256i *>(dst + q * 6);
+            for (int m = 0; m < 6; m++)
+            {
+                _mm256_storeu_si256(out + m, _mm256_add_epi32(base, pattern[m]));
+            }
+            base = _mm256_add_epi32(base, step);
+        }
+        // GCC leaves this out when the function ends in a tail call, and every SSE store
+        // after it (all of revolveRow's) would pay for the dirty upper halves
+        _mm256_zeroupper();
+        bandSse(dst + q * 6, a + static_cast<uint32_t>(q), width, quads - q);
+    }
+#else
+    void bandFull(uint32_t *dst, uint32_t a, uint32_t width, size_t quads)
+    {
+        bandScalar(dst, a, width, quads, FULL);
+    }
+#endif
+
+    using BandFn = void (*)(uint32_t *, uint32_t, uint32_t, size_t);
+
+    BandFn selectBand()
+    {
+#ifdef LEARNOPENGL_X86
+        return cpu::hasAvx2() ? bandAvx2 : bandSse;
+#else
+        return bandFull;
+#endif
+    }
+
+    // rows x width vertices from first on; poles: the first and last rows are single points
+    void gridIndices(uint32_t *dst, uint32_t first, int rows, int width, bool poles)
+    {
+        static const BandFn full = selectBand();
+        size_t quads = static_cast<size_t>(width) - 1;
+        size_t bands = static_cast<size_t>(rows) - 1;
+        size_t grain = std::max<size_t>(1, CHUNK_VERTICES / static_cast<size_t>(width));
+        ThreadPool::shared().parallelFor(
+            bands, grain,
+            [&](size_t begin, size_t end)
+            {
+                for (size_t band = begin; band < end; band++)
+                {
+                    // a pole band before this one wrote half as much
+                    size_t offset = band * quads * 6 - (poles && band > 0 ? quads * 3 : 0);
+                    uint32_t a = first + static_cast<uint32_t>(band * static_cast<size_t>(width));
+                    if (poles && band == 0)
+                    {
+                        bandScalar(dst + offset, a, static_cast<uint32_t>(width), quads, TOP_POLE);
+                    }
+                    else if (poles && band == bands - 1)
+                    {
+                        bandScalar(dst + offset, a, static_cast<uint32_t>(width), quads, BOTTOM_POLE);
+                    }
+                    else
+                    {
+                        full(dst + offset, a, static_cast<uint32_t>(width), quads);
+                    }
+                }
+            });
+    }
+
+    size_t gridIndexCount(int rows, int width, bool poles)
+    {
+        size_t quads = static_cast<size_t>(width - 1) * static_cast<size_t>(rows - 1);
+        return quads * 6 - (poles ? static_cast<size_t>(width - 1) * 6 : 0);
+    }
+
+    // ---------------------------------------------------------------------------
+    // flat faces
+
+    struct FaceFrame
+    {
+        const float *corner;
+        const float *right;
+        const float *down;
+        float normal[3];
+        float tangent[3];
+    };
+
+    // row t of a face, columns j / uSegments
+    void faceRow(const mesh::GeometryStreams &out, size_t first, const FaceFrame &frame, float t, int uSegments)
+    {
+        const float *corner = frame.corner, *right = frame.right, *down = frame.down;
+        size_t count = static_cast<size_t>(uSegments) + 1;
+        size_t j = 0;
+#ifdef LEARNOPENGL_X86
+        // the same operations in the same order as below, so both paths give identical bits
+        const __m128 segments = _mm_set1_ps(static_cast<float>(uSegments));
+        __m128 column = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+        const __m128 step = _mm_set1_ps(4.0f);
+        VertexLanes v;
+        for (int k = 0; k < 3; k++)
+        {
+            v.normal[k] = _mm_set1_ps(frame.normal[k]);
+            v.tangent[k] = _mm_set1_ps(frame.tangent[k]);
+        }
+        v.tangent[3] = _mm_set1_ps(1.0f);
+        v.uv[1] = _mm_set1_ps(1.0f - t);
+        for (; j + 4 <= count; j += 4)
+        {
+            __m128 s = _mm_div_ps(column, segments);
+            for (int k = 0; k < 3; k++)
+            {
+                v.position[k] = _mm_add_ps(_mm_add_ps(_mm_set1_ps(corner[k]), _mm_mul_ps(_mm_set1_ps(right[k]), s)),
+                                           _mm_set1_ps(down[k] * t));
+            }
+            v.uv[0] = s;
+            writeLanes(out, first + j, v);
+            column = _mm_add_ps(column, step);
+        }
+#endif
+        for (; j < count; j++)
+        {
+            float s = static_cast<float>(j) / static_cast<float>(uSegments);
+            VertexValues v = {{corner[0] + right[0] * s + down[0] * t, corner[1] + right[1] * s + down[1] * t,
+                               corner[2] + right[2] * s + down[2] * t},
+                              {frame.normal[0], frame.normal[1], frame.normal[2]},
+                              {frame.tangent[0], frame.tangent[1], frame.tangent[2], 1.0f},
+                              {s, 1.0f - t}};
+            writeVertex(out, first + j, v);
+        }
+    }
+
+    // Grid from corner along right (u) and down (against v), facing cross(down, right).
+    // Returns the vertices written.
+    size_t face(const mesh::GeometryStreams &out, size_t first, size_t firstIndex, const float corner[3],
+                const float right[3], const float down[3], int uSegments, int vSegments)
+    {
+        float normal[3] = {down[1] * right[2] - down[2] * right[1], down[2] * right[0] - down[0] * right[2],
+                           down[0] * right[1] - down[1] * right[0]};
+        float nl = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+        float rl = std::sqrt(right[0] * right[0] + right[1] * right[1] + right[2] * right[2]);
+        FaceFrame frame = {corner, right, down, {normal[0] / nl, normal[1] / nl, normal[2] / nl},
+                           {right[0] / rl, right[1] / rl, right[2] / rl}};
+        int width = uSegments + 1;
+        size_t grain = std::max<size_t>(1, CHUNK_VERTICES / static_cast<size_t>(width));
+        ThreadPool::shared().parallelFor(static_cast<size_t>(vSegments) + 1, grain,
+                                         [&](size_t begin, size_t end)
+                                         {
+                                             for (size_t i = begin; i < end; i++)
+                                             {
+                                                 float t = static_cast<float>(i) / static_cast<float>(vSegments);
+                                                 faceRow(out, first + i * static_cast<size_t>(width), frame, t,
+                                                         uSegments);
+                                             }
+                                         });
+        if (out.indices != nullptr)
+        {
+            gridIndices(out.indices + firstIndex, out.baseVertex + static_cast<uint32_t>(first), vSegments + 1, width,
+                        false);
+        }
+        return static_cast<size_t>(width) * static_cast<size_t>(vSegments + 1);
+    }
+
+    // flat disc at height y facing up or down, centre first, then the rim
+    void cap(const mesh::GeometryStreams &out, size_t first, size_t firstIndex, float radius, float y, bool up,
+             const Columns &columns)
+    {
+        float ny = up ? 1.0f : -1.0f;
+        // the bitangent of a downward cap points to +z
+        float vSign = up ? -1.0f : 1.0f;
+        writeVertex(out, first, VertexValues{{0.0f, y, 0.0f}, {0.0f, ny, 0.0f}, {1.0f, 0.0f, 0.0f, 1.0f}, {0.5f, 0.5f}});
+        for (int j = 0; j <= columns.segments; j++)
+        {
+            float x = radius * columns.cosines[j], z = -radius * columns.sines[j];
+            VertexValues v = {{x, y, z}, {0.0f, ny, 0.0f}, {1.0f, 0.0f, 0.0f, 1.0f},
+                              {0.5f + 0.5f * columns.cosines[j], 0.5f + vSign * 0.5f * z / radius}};
+            writeVertex(out, first + 1 + static_cast<size_t>(j), v);
+        }
+        if (out.indices == nullptr)
+        {
+            return;
+        }
+        uint32_t centre = out.baseVertex + static_cast<uint32_t>(first);
+        uint32_t *dst = out.indices + firstIndex;
+        for (uint32_t j = 0; j < static_cast<uint32_t>(columns.segments); j++)
+        {
+            // the rim runs counter-clockwise seen from above
+            *dst++ = centre;
+            *dst++ = centre + 1 + (up ? j : j + 1);
+            *dst++ = centre + 1 + (up ? j + 1 : j);
+        }
+    }
+} // namespace
+
+// ---------------------------------------------------------------------------
+// plane, cube
+
+mesh::PrimitiveCounts mesh::planeCounts(int xSegments, int zSegments)
+{
+    return PrimitiveCounts{static_cast<size_t>(xSegments + 1) * static_cast<size_t>(zSegments + 1),
+                           gridIndexCount(zSegments + 1, xSegments + 1, false)};
+}
+
+void mesh::generatePlane(const GeometryStreams &out, float width, float depth, int xSegments, int zSegments)
+{
+    const float corner[3] = {-0.5f * width, 0.0f, -0.5f * depth};
+    const float right[3] = {width, 0.0f, 0.0f};
+    const float down[3] = {0.0f, 0.0f, depth};
+    face(out, 0, 0, corner, right, down, xSegments, zSegments);
+}
+
+mesh::PrimitiveCounts mesh::cubeCounts(int segments)
+{
+    PrimitiveCounts side = planeCounts(segments, segments);
+    return PrimitiveCounts{side.vertexCount * 6, side.indexCount * 6};
+}
+
+void mesh::generateCube(const GeometryStreams &out, float size, int segments)
+{
+    // right and down of every face seen from outside, the normal follows
+    const float axes[6][2][3] = {
+        {{0, 0, -1}, {0, -1, 0}}, // +x
+        {{0, 0, 1}, {0, -1, 0}},  // -x
+        {{1, 0, 0}, {0, 0, 1}},   // +y
+        {{1, 0, 0}, {0, 0, -1}},  // -y
+        {{1, 0, 0}, {0, -1, 0}},  // +z
+        {{-1, 0, 0}, {0, -1, 0}}, // -z
+    };
+    PrimitiveCounts side = planeCounts(segments, segments);
+    float h = 0.5f * size;
+    for (int f = 0; f < 6; f++)
+    {
+        const float *r = axes[f][0], *d = axes[f][1];
+        float n[3] = {d[1] * r[2] - d[2] * r[1], d[2] * r[0] - d[0] * r[2], d[0] * r[1] - d[1] * r[0]};
+        float corner[3], right[3], down[3];
+        for (int k = 0; k < 3; k++)
+        {
+            corner[k] = h * (n[k] - r[k] - d[k]);
+            right[k] = size * r[k];
+            down[k] = size * d[k];
+        }
+        face(out, side.vertexCount * static_cast<size_t>(f), side.indexCount * static_cast<size_t>(f), corner, right,
+             down, segments, segments);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// spheres
+
+mesh::PrimitiveCounts mesh::uvSphereCounts(int segments, int rings)
+{
+    return PrimitiveCounts{static_cast<size_t>(segments + 1) * static_cast<size_t>(rings + 1),
+                           gridIndexCount(rings + 1, segments + 1, true)};
+}
+
+void mesh::generateUvSphere(const GeometryStreams &out, float radius, int segments, int rings)
+{
+    Columns columns(segments);
+    revolve(out, 0, rings + 1, columns,
+            [&](int i)
+            {
+                float theta = PI * static_cast<float>(i) / static_cast<float>(rings);
+                // exact poles
+                float s = i == 0 || i == rings ? 0.0f : std::sin(theta);
+                float c = i == 0 ? 1.0f : i == rings ? -1.0f : std::cos(theta);
+                return Ring{radius * s, radius * c, s, c, 1.0f - static_cast<float>(i) / static_cast<float>(rings)};
+            });
+    if (out.indices != nullptr)
+    {
+        gridIndices(out.indices, out.baseVertex, rings + 1, segments + 1, true);
+    }
+}
+
+mesh::PrimitiveCounts mesh::icoSphereCounts(int subdivisions)
+{
+    size_t faces = size_t{20} << (2 * subdivisions);
+    return PrimitiveCounts{faces / 2 + 2, faces * 3};
+}
+
+void mesh::generateIcoSphere(const GeometryStreams &out, float radius, int subdivisions)
+{
+    const float t = (1.0f + std::sqrt(5.0f)) * 0.5f;
+    std::vector<float> points = {-1, t, 0, 1, t, 0, -1, -t, 0, 1, -t, 0, 0, -1, t, 0, 1, t,
+                                 0, -1, -t, 0, 1, -t, t, 0, -1, t, 0, 1, -t, 0, -1, -t, 0, 1};
+    std::vector<uint32_t> triangles = {0, 11, 5, 0, 5, 1, 0, 1, 7, 0, 7, 10, 0, 10, 11, 1, 5, 9, 5, 11, 4,
+                                       11, 10, 2, 10, 7, 6, 7, 1, 8, 3, 9, 4, 3, 4, 2, 3, 2, 6, 3, 6, 8,
+                                       3, 8, 9, 4, 9, 5, 2, 4, 11, 6, 2, 10, 8, 6, 7, 9, 8, 1};
+    auto normalize = [&points](uint32_t v)
+    {
+        float *p = &points[v * 3];
+        float l = std::sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+        p[0] /= l;
+        p[1] /= l;
+        p[2] /= l;
+    };
+    for (uint32_t v = 0; v < 12; v++)
+    {
+        normalize(v);
+    }
+
+    // every edge gets one midpoint, shared by the two triangles on it
+    for (int level = 0; level < subdivisions; level++)
+    {
+        // open addressing on the edge, at most half full (edges = 1.5 x triangles)
+        size_t slots = 1;
+        while (slots < triangles.size())
+        {
+            slots <<= 1;
+        }
+        std::vector<uint64_t> keys(slots, ~uint64_t{0});
+        std::vector<uint32_t> values(slots);
+        points.reserve(points.size() + triangles.size() / 2 * 3);
+        auto midpoint = [&](uint32_t a, uint32_t b)
+        {
+            uint64_t key = uint64_t{std::min(a, b)} << 32 | std::max(a, b);
+            size_t slot = static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> 32) & (slots - 1);
+            while (keys[slot] != key)
+            {
+                if (keys[slot] == ~uint64_t{0})
+                {
+                    uint32_t v = static_cast<uint32_t>(points.size() / 3);
+                    for (int k = 0; k < 3; k++)
+                    {
+                        points.push_back(0.5f * (points[a * 3 + k] + points[b * 3 + k]));
+                    }
+                    normalize(v);
+                    keys[slot] = key;
+                    values[slot] = v;
+                    return v;
+                }
+                slot = (slot + 1) & (slots - 1);
+            }
+            return values[slot];
+        };
+        std::vector<uint32_t> next;
+        next.reserve(triangles.size() * 4);
+        for (size_t i = 0; i < triangles.size(); i += 3)
+        {
+            uint32_t a = triangles[i], b = triangles[i + 1], c = triangles[i + 2];
+            uint32_t ab = midpoint(a, b), bc = midpoint(b, c), ca = midpoint(c, a);
+            next.insert(next.end(), {a, ab, ca, b, bc, ab, c, ca, bc, ab, bc, ca});
+        }
+        triangles.swap(next);
+    }
+
+    size_t vertexCount = points.size() / 3;
+    ThreadPool::shared().parallelFor(vertexCount, CHUNK_VERTICES,
+                                     [&](size_t begin, size_t end)
+                                     {
+                                         for (size_t v = begin; v < end; v++)
+                                         {
+                                             const float *p = &points[v * 3];
+                                             float phi = std::atan2(-p[2], p[0]);
+                                             float c = std::cos(phi), s = std::sin(phi);
+                                             float u = phi / (2.0f * PI);
+                                             VertexValues values = {{radius * p[0], radius * p[1], radius * p[2]},
+                                                                    {p[0], p[1], p[2]},
+                                                                    {-s, 0.0f, -c, 1.0f},
+                                                                    {u < 0.0f ? u + 1.0f : u,
+                                                                     0.5f + std::asin(std::max(-1.0f, std::min(1.0f, p[1]))) / PI}};
+                                             writeVertex(out, v, values);
+                                         }
+                                     });
+    if (out.indices != nullptr)
+    {
+        for (size_t i = 0; i < triangles.size(); i++)
+        {
+            out.indices[i] = out.baseVertex + triangles[i];
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// cylinder, torus, capsule
+
+mesh::PrimitiveCounts mesh::cylinderCounts(int segments, int stacks)
+{
+    size_t side = static_cast<size_t>(segments + 1) * static_cast<size_t>(stacks + 1);
+    return PrimitiveCounts{side + 2 * static_cast<size_t>(segments + 2),
+                           gridIndexCount(stacks + 1, segments + 1, false) + 6 * static_cast<size_t>(segments)};
+}
+
+void mesh::generateCylinder(const GeometryStreams &out, float radius, float height, int segments, int stacks)
+{
+    Columns columns(segments);
+    revolve(out, 0, stacks + 1, columns,
+            [&](int i)
+            {
+                float t = static_cast<float>(i) / static_cast<float>(stacks);
+                return Ring{radius, height * (0.5f - t), 1.0f, 0.0f, 1.0f - t};
+            });
+    size_t side = static_cast<size_t>(segments + 1) * static_cast<size_t>(stacks + 1);
+    size_t sideIndices = gridIndexCount(stacks + 1, segments + 1, false);
+    if (out.indices != nullptr)
+    {
+        gridIndices(out.indices, out.baseVertex, stacks + 1, segments + 1, false);
+    }
+    size_t capVertices = static_cast<size_t>(segments + 2), capIndices = 3 * static_cast<size_t>(segments);
+    cap(out, side, sideIndices, radius, 0.5f * height, true, columns);
+    cap(out, side + capVertices, sideIndices + capIndices, radius, -0.5f * height, false, columns);
+}
+
+mesh::PrimitiveCounts mesh::torusCounts(int segments, int sides)
+{
+    return PrimitiveCounts{static_cast<size_t>(segments + 1) * static_cast<size_t>(sides + 1),
+                           gridIndexCount(sides + 1, segments + 1, false)};
+}
+
+void mesh::generateTorus(const GeometryStreams &out, float radius, float tubeRadius, int segments, int sides)
+{
+    Columns columns(segments);
+    // around the tube from the outer equator downwards, so rows go down on the outside
+    revolve(out, 0, sides + 1, columns,
+            [&](int i)
+            {
+                float theta = 2.0f * PI * static_cast<float>(i % sides) / static_cast<float>(sides);
+                float c = std::cos(theta), s = std::sin(theta);
+                return Ring{radius + tubeRadius * c, -tubeRadius * s, c, -s,
+                            1.0f - static_cast<float>(i) / static_cast<float>(sides)};
+            });
+    if (out.indices != nullptr)
+    {
+        gridIndices(out.indices, out.baseVertex, sides + 1, segments + 1, false);
+    }
+}
+
+mesh::PrimitiveCounts mesh::capsuleCounts(int segments, int rings)
+{
+    int rows = 2 * (rings + 1);
+    return PrimitiveCounts{static_cast<size_t>(segments + 1) * static_cast<size_t>(rows),
+                           gridIndexCount(rows, segments + 1, true)};
+}
+
+void mesh::generateCapsule(const GeometryStreams &out, float radius, float height, int segments, int rings)
+{
+    Columns columns(segments);
+    // v follows the arc length of the profile
+    float quarter = 0.5f * PI * radius, length = 2.0f * quarter + height;
+    revolve(out, 0, 2 * (rings + 1), columns,
+            [&](int i)
+            {
+                bool top = i <= rings;
+                int k = top ? i : i - (rings + 1);
+                float t = static_cast<float>(k) / static_cast<float>(rings);
+                float theta = 0.5f * PI * (top ? t : 1.0f + t);
+                float s = std::sin(theta), c = std::cos(theta);
+                if ((top && k == 0) || (!top && k == rings))
+                {
+                    // exact poles
+                    s = 0.0f;
+                    c = top ? 1.0f : -1.0f;
+                }
+                float arc = top ? quarter * t : quarter + height + quarter * t;
+                float y = (top ? 0.5f : -0.5f) * height + radius * c;
+                return Ring{radius * s, y, s, c, 1.0f - arc / length};
+            });
+    if (out.indices != nullptr)
+    {
+        gridIndices(out.indices, out.baseVertex, 2 * (rings + 1), segments + 1, true);
+    }
+}
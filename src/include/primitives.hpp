@@ -0,0 +1,75 @@
+#ifndef PRIMITIVES_HPP
+#define PRIMITIVES_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+// Indexed procedural shapes written straight into caller provided memory. Every stream
+// has its own pointer and byte stride, so the same call fills an interleaved vertex
+// array (all pointers into one struct array, stride = sizeof(vertex)), separate arrays
+// (stride = 12, 8, 16), or any mix; leave a pointer null to skip the stream. Ask the
+// matching ...Counts() function how much room to provide.
+//
+// All shapes are centred on the origin, y up, wound counter-clockwise seen from
+// outside. Normals are unit length, tangents point along +u with the bitangent
+// handedness in w, v grows upwards (v = 0 at the bottom, as OpenGL samples).
+// Surfaces of revolution and flat faces (plane, cube) are evaluated four vertices at a
+// time with SSE, grid indices are written with SSE2 / AVX2, and large shapes are split
+// over ThreadPool::shared(). The ico sphere and the caps are scalar; subdividing the ico
+// sphere is bound by its edge midpoint lookups, not by arithmetic.
+namespace mesh
+{
+    struct GeometryStreams
+    {
+        float *positions = nullptr; // xyz
+        size_t positionStride = 3 * sizeof(float);
+        float *normals = nullptr; // xyz
+        size_t normalStride = 3 * sizeof(float);
+        float *tangents = nullptr; // xyz + handedness in w (+1 / -1)
+        size_t tangentStride = 4 * sizeof(float);
+        float *uvs = nullptr;
+        size_t uvStride = 2 * sizeof(float);
+        uint32_t *indices = nullptr; // triangle list
+        uint32_t baseVertex = 0;     // added to every index
+    };
+
+    struct PrimitiveCounts
+    {
+        size_t vertexCount;
+        size_t indexCount;
+    };
+
+    // in the xz plane facing +y, u along +x; segments per side
+    PrimitiveCounts planeCounts(int xSegments, int zSegments);
+    void generatePlane(const GeometryStreams &out, float width, float depth, int xSegments = 1, int zSegments = 1);
+
+    // one grid of segments x segments quads per face, every face with the full uv square
+    PrimitiveCounts cubeCounts(int segments);
+    void generateCube(const GeometryStreams &out, float size = 1.0f, int segments = 1);
+
+    // longitude / latitude sphere, rings >= 2; u wraps once around y, the seam column is duplicated
+    PrimitiveCounts uvSphereCounts(int segments, int rings);
+    void generateUvSphere(const GeometryStreams &out, float radius = 0.5f, int segments = 32, int rings = 16);
+
+    // subdivided icosahedron, evenly spread triangles. The uvs are the plain spherical
+    // mapping without a split seam, fine for procedural shading but not for textures.
+    PrimitiveCounts icoSphereCounts(int subdivisions);
+    void generateIcoSphere(const GeometryStreams &out, float radius = 0.5f, int subdivisions = 3);
+
+    // open side of stacks rows plus flat caps
+    PrimitiveCounts cylinderCounts(int segments, int stacks);
+    void generateCylinder(const GeometryStreams &out, float radius = 0.5f, float height = 1.0f, int segments = 32,
+                          int stacks = 1);
+
+    // ring around y: segments around the ring, sides around the tube
+    PrimitiveCounts torusCounts(int segments, int sides);
+    void generateTorus(const GeometryStreams &out, float radius = 0.5f, float tubeRadius = 0.2f, int segments = 48,
+                       int sides = 24);
+
+    // cylinder of height between two hemispheres of rings (>= 1) rows each
+    PrimitiveCounts capsuleCounts(int segments, int rings);
+    void generateCapsule(const GeometryStreams &out, float radius = 0.25f, float height = 0.5f, int segments = 32,
+                         int rings = 8);
+} // namespace mesh
+
+#endif // PRIMITIVES_HPP
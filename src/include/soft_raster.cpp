@@ -0,0 +1,803 @@
+#include "soft_raster.hpp"
+#include "cpu_features.hpp"
+#include "glsl_vm.hpp"
+#include "mipmap.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#ifdef LEARNOPENGL_X86
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    // sub-pixel precision of the edge functions
+    const int SUBPIXEL_BITS = 4;
+    const int SUBPIXEL = 1 << SUBPIXEL_BITS;
+    // screen positions stay within +-GUARD_BAND pixels, larger triangles are clipped
+    // against it; with 4 sub-pixel bits edge steps across a 64 pixel tile fit 32 bits
+    const float GUARD_BAND = 16384.0f;
+    const int MAX_TILE = 64;
+    // planes of the clip volume: near, far, w > 0 and the guard band on x and y
+    const int CLIP_PLANES = 7;
+    const int MAX_CLIPPED = 3 + CLIP_PLANES;
+
+    int64_t floorDiv(int64_t value, int64_t divisor)
+    {
+        return value >= 0 ? value / divisor : -((-value + divisor - 1) / divisor);
+    }
+
+    // the fraction for GL_REPEAT, without a libm floor call; huge or non-finite
+    // coordinates have no fraction left
+    float wrap01(float value)
+    {
+        if (!(std::fabs(value) < 8388608.0f))
+        {
+            return 0.0f;
+        }
+        float whole = static_cast<float>(static_cast<int32_t>(value));
+        return value - (whole > value ? whole - 1.0f : whole);
+    }
+
+    // log2 to within 0.005 from the exponent bits and a quadratic for the mantissa,
+    // plenty for a level of detail and much cheaper than libm
+    float fastLog2(float value)
+    {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        float exponent = static_cast<float>(static_cast<int>(bits >> 23 & 255) - 127);
+        bits = (bits & 0x007FFFFFu) | 0x3F800000u;
+        float mantissa;
+        std::memcpy(&mantissa, &bits, sizeof(mantissa));
+        return exponent + (-0.34484843f * mantissa + 2.02466578f) * mantissa - 1.67487759f;
+    }
+
+#ifdef LEARNOPENGL_X86
+    __m128 loadTexel(const unsigned char *texel)
+    {
+        int32_t packed;
+        std::memcpy(&packed, texel, sizeof(packed));
+        __m128i bytes = _mm_cvtsi32_si128(packed);
+        __m128i words = _mm_unpacklo_epi8(bytes, _mm_setzero_si128());
+        return _mm_cvtepi32_ps(_mm_unpacklo_epi16(words, _mm_setzero_si128()));
+    }
+#endif
+
+    unsigned char toUnorm(float value)
+    {
+        return static_cast<unsigned char>(std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+    }
+
+    // a screen space linear function, value = origin + dx * (x - x0) + dy * (y - y0)
+    struct Plane
+    {
+        float dx;
+        float dy;
+        float origin;
+
+        float at(float x, float y, float x0, float y0) const
+        {
+            return origin + dx * (x - x0) + dy * (y - y0);
+        }
+    };
+} // namespace
+
+namespace soft
+{
+    // -------------------------------------------------------------------------------
+    // Texture
+
+    void Texture::load(const unsigned char *rgba, int width, int height)
+    {
+        m_levels.clear();
+        size_t size = static_cast<size_t>(width) * static_cast<size_t>(height) * 4;
+        m_levels.push_back(Level{width, height, std::vector<unsigned char>(rgba, rgba + size)});
+        // the chain Texture2D::load builds for colour data, averaged in linear light
+        MipmapGenerator generator(MipmapGenerator::BOX, true);
+        for (MipmapGenerator::Level &level : generator.generate(rgba, width, height, 4, 8))
+        {
+            m_levels.push_back(Level{level.width, level.height, std::move(level.data)});
+        }
+    }
+
+    bool Texture::empty() const
+    {
+        return m_levels.empty();
+    }
+
+    int Texture::width() const
+    {
+        return m_levels.empty() ? 0 : m_levels[0].width;
+    }
+
+    int Texture::height() const
+    {
+        return m_levels.empty() ? 0 : m_levels[0].height;
+    }
+
+    void Texture::bilinear(const Level &level, float u, float v, float rgba[4]) const
+    {
+        // GL_REPEAT: texel centres at half integers, the neighbours of the edge wrap around
+        float x = wrap01(u) * level.width - 0.5f;
+        float y = wrap01(v) * level.height - 0.5f;
+        // x, y >= -0.5, so truncating after the + 1 floors
+        int x0 = static_cast<int>(x + 1.0f) - 1, y0 = static_cast<int>(y + 1.0f) - 1;
+        float fx = x - x0, fy = y - y0;
+        int x1 = x0 + 1 >= level.width ? 0 : x0 + 1;
+        int y1 = y0 + 1 >= level.height ? 0 : y0 + 1;
+        x0 = x0 < 0 ? level.width - 1 : x0;
+        y0 = y0 < 0 ? level.height - 1 : y0;
+
+        const unsigned char *row0 = level.texels.data() + static_cast<size_t>(y0) * level.width * 4;
+        const unsigned char *row1 = level.texels.data() + static_cast<size_t>(y1) * level.width * 4;
+        const unsigned char *t00 = row0 + x0 * 4, *t10 = row0 + x1 * 4, *t01 = row1 + x0 * 4, *t11 = row1 + x1 * 4;
+        float w00 = (1.0f - fx) * (1.0f - fy), w10 = fx * (1.0f - fy), w01 = (1.0f - fx) * fy, w11 = fx * fy;
+#ifdef LEARNOPENGL_X86
+        __m128 sum = _mm_mul_ps(loadTexel(t00), _mm_set1_ps(w00));
+        sum = _mm_add_ps(sum, _mm_mul_ps(loadTexel(t10), _mm_set1_ps(w10)));
+        sum = _mm_add_ps(sum, _mm_mul_ps(loadTexel(t01), _mm_set1_ps(w01)));
+        sum = _mm_add_ps(sum, _mm_mul_ps(loadTexel(t11), _mm_set1_ps(w11)));
+        _mm_storeu_ps(rgba, _mm_mul_ps(sum, _mm_set1_ps(1.0f / 255.0f)));
+#else
+        for (int c = 0; c < 4; c++)
+        {
+            rgba[c] = (t00[c] * w00 + t10[c] * w10 + t01[c] * w01 + t11[c] * w11) * (1.0f / 255.0f);
+        }
+#endif
+    }
+
+    void Texture::sample(float u, float v, float lod, float rgba[4]) const
+    {
+        int last = static_cast<int>(m_levels.size()) - 1;
+        if (!(lod > 0.0f) || last == 0)
+        {
+            bilinear(m_levels[0], u, v, rgba);
+            return;
+        }
+        float d = std::min(lod, static_cast<float>(last));
+        int level = static_cast<int>(d);
+        float blend = d - level;
+        bilinear(m_levels[level], u, v, rgba);
+        if (blend > 0.0f && level < last)
+        {
+            float next[4];
+            bilinear(m_levels[level + 1], u, v, next);
+            for (int c = 0; c < 4; c++)
+            {
+                rgba[c] += (next[c] - rgba[c]) * blend;
+            }
+        }
+    }
+
+    float Texture::lod(float dudx, float dvdx, float dudy, float dvdy) const
+    {
+        float w = static_cast<float>(width()), h = static_cast<float>(height());
+        float rhoX = dudx * dudx * w * w + dvdx * dvdx * h * h;
+        float rhoY = dudy * dudy * w * w + dvdy * dvdy * h * h;
+        // log2 of the longer footprint axis, GL's scale factor rho
+        return 0.5f * fastLog2(std::max(std::max(rhoX, rhoY), 1e-20f));
+    }
+
+    // -------------------------------------------------------------------------------
+    // Framebuffer
+
+    Framebuffer::Framebuffer(int width, int height)
+        : m_width{width}, m_height{height}, m_color(static_cast<size_t>(width) * height * 4),
+          m_depth(static_cast<size_t>(width) * height, 1.0f)
+    {
+    }
+
+    void Framebuffer::clear(const float rgba[4], float depth)
+    {
+        unsigned char value[4];
+        for (int c = 0; c < 4; c++)
+        {
+            value[c] = toUnorm(rgba[c]);
+        }
+        uint32_t packed;
+        std::memcpy(&packed, value, 4);
+        uint32_t *pixels = reinterpret_cast<uint32_t *>(m_color.data());
+        std::fill(pixels, pixels + m_depth.size(), packed);
+        std::fill(m_depth.begin(), m_depth.end(), depth);
+    }
+
+    int Framebuffer::width() const
+    {
+        return m_width;
+    }
+
+    int Framebuffer::height() const
+    {
+        return m_height;
+    }
+
+    const unsigned char *Framebuffer::color() const
+    {
+        return m_color.data();
+    }
+
+    const float *Framebuffer::depth() const
+    {
+        return m_depth.data();
+    }
+
+    unsigned char *Framebuffer::color()
+    {
+        return m_color.data();
+    }
+
+    float *Framebuffer::depth()
+    {
+        return m_depth.data();
+    }
+
+    // -------------------------------------------------------------------------------
+    // Rasterizer
+
+    struct Rasterizer::Triangle
+    {
+        // edge k runs between the vertices other than k: e = a * x + b * y + c in sub-pixels,
+        // >= 0 inside; c carries the fill rule bias
+        int32_t a[3];
+        int32_t b[3];
+        int64_t c[3];
+        // covered pixels lie in [minX, maxX] x [minY, maxY]
+        int minX, minY, maxX, maxY;
+        // the planes' reference point, vertex 0 in pixels
+        float x0, y0;
+        Plane z;                      // window depth
+        Plane q;                      // 1 / w
+        Plane varyings[MAX_VARYINGS]; // varying / w
+    };
+
+    struct Rasterizer::Chunk
+    {
+        std::vector<Triangle> triangles;
+        std::vector<std::vector<uint32_t>> bins; // per tile, indices into triangles
+        int tilesX;
+        int tileSize;
+        int varyingCount;
+    };
+
+    Rasterizer::Rasterizer(ThreadPool &pool, int tileSize)
+        : m_pool{pool}, m_tileSize{std::min(std::max(tileSize, 8), MAX_TILE) & ~3}, m_stats{}
+    {
+    }
+
+    Rasterizer::Rasterizer() : Rasterizer(ThreadPool::shared())
+    {
+    }
+
+    const RasterStats &Rasterizer::stats() const
+    {
+        return m_stats;
+    }
+
+    void Rasterizer::resetStats()
+    {
+        m_stats = RasterStats{};
+    }
+
+    void Rasterizer::setupTriangle(const ClipVertex *vertices, const Framebuffer &target, const DrawCall &call,
+                                   Chunk &chunk) const
+    {
+        const float width = static_cast<float>(target.width()), height = static_cast<float>(target.height());
+        // x <= gx * w keeps the screen position within the guard band, likewise for y
+        const float gx = 2.0f * GUARD_BAND / width - 1.0f, gy = 2.0f * GUARD_BAND / height - 1.0f;
+        auto distance = [gx, gy](const ClipVertex &v, int plane)
+        {
+            const float *p = v.position;
+            switch (plane)
+            {
+            case 0:
+                return p[3] + p[2]; // near, z >= -w
+            case 1:
+                return p[3] - p[2]; // far, z <= w
+            case 2:
+                return p[3] - 1e-6f;
+            case 3:
+                return gx * p[3] - p[0];
+            case 4:
+                return gx * p[3] + p[0];
+            case 5:
+                return gy * p[3] - p[1];
+            default:
+                return gy * p[3] + p[1];
+            }
+        };
+
+        ClipVertex polygon[MAX_CLIPPED];
+        int count = 3;
+        std::copy(vertices, vertices + 3, polygon);
+        unsigned outside[3] = {0, 0, 0};
+        for (int v = 0; v < 3; v++)
+        {
+            for (int plane = 0; plane < CLIP_PLANES; plane++)
+            {
+                outside[v] |= distance(polygon[v], plane) < 0.0f ? 1u << plane : 0u;
+            }
+        }
+        if ((outside[0] & outside[1] & outside[2]) != 0)
+        {
+            return;
+        }
+        if ((outside[0] | outside[1] | outside[2]) != 0)
+        {
+            // Sutherland-Hodgman in clip space, where the attributes are still linear
+            for (int plane = 0; plane < CLIP_PLANES && count > 0; plane++)
+            {
+                ClipVertex clipped[MAX_CLIPPED];
+                int kept = 0;
+                for (int i = 0; i < count; i++)
+                {
+                    const ClipVertex &a = polygon[i], &b = polygon[(i + 1) % count];
+                    float da = distance(a, plane), db = distance(b, plane);
+                    if (da >= 0.0f)
+                    {
+                        clipped[kept++] = a;
+                    }
+                    if ((da >= 0.0f) != (db >= 0.0f))
+                    {
+                        float t = da / (da - db);
+                        ClipVertex &v = clipped[kept++];
+                        for (int k = 0; k < 4; k++)
+                        {
+                            v.position[k] = a.position[k] + (b.position[k] - a.position[k]) * t;
+                        }
+                        for (int k = 0; k < chunk.varyingCount; k++)
+                        {
+                            v.varyings[k] = a.varyings[k] + (b.varyings[k] - a.varyings[k]) * t;
+                        }
+                    }
+                }
+                std::copy(clipped, clipped + kept, polygon);
+                count = kept;
+            }
+        }
+
+        struct ScreenVertex
+        {
+            int32_t x, y; // sub-pixels
+            float z, q;
+            float varyings[MAX_VARYINGS];
+        };
+        ScreenVertex screen[MAX_CLIPPED];
+        for (int i = 0; i < count; i++)
+        {
+            const float *p = polygon[i].position;
+            float q = 1.0f / p[3];
+            screen[i].x = static_cast<int32_t>(std::lround((p[0] * q + 1.0f) * 0.5f * width * SUBPIXEL));
+            screen[i].y = static_cast<int32_t>(std::lround((p[1] * q + 1.0f) * 0.5f * height * SUBPIXEL));
+            screen[i].z = p[2] * q * 0.5f + 0.5f;
+            screen[i].q = q;
+            for (int k = 0; k < chunk.varyingCount; k++)
+            {
+                screen[i].varyings[k] = polygon[i].varyings[k] * q;
+            }
+        }
+
+        for (int i = 1; i + 1 < count; i++)
+        {
+            ScreenVertex v[3] = {screen[0], screen[i], screen[i + 1]};
+            int64_t area = static_cast<int64_t>(v[1].x - v[0].x) * (v[2].y - v[0].y) -
+                           static_cast<int64_t>(v[2].x - v[0].x) * (v[1].y - v[0].y);
+            if (area == 0 || (area < 0 && call.cullBackFaces))
+            {
+                continue;
+            }
+            if (area < 0)
+            {
+                // clockwise: swap into counter clockwise order, the edge functions expect it
+                std::swap(v[1], v[2]);
+                area = -area;
+            }
+
+            Triangle triangle;
+            int32_t minX = std::min({v[0].x, v[1].x, v[2].x}), maxX = std::max({v[0].x, v[1].x, v[2].x});
+            int32_t minY = std::min({v[0].y, v[1].y, v[2].y}), maxY = std::max({v[0].y, v[1].y, v[2].y});
+            // pixels whose centre (x + 0.5) lies in the box
+            triangle.minX = static_cast<int>(std::max<int64_t>(floorDiv(minX - SUBPIXEL / 2 + SUBPIXEL - 1, SUBPIXEL), 0));
+            triangle.minY = static_cast<int>(std::max<int64_t>(floorDiv(minY - SUBPIXEL / 2 + SUBPIXEL - 1, SUBPIXEL), 0));
+            triangle.maxX = static_cast<int>(std::min<int64_t>(floorDiv(maxX - SUBPIXEL / 2, SUBPIXEL), target.width() - 1));
+            triangle.maxY = static_cast<int>(std::min<int64_t>(floorDiv(maxY - SUBPIXEL / 2, SUBPIXEL), target.height() - 1));
+            if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+            {
+                continue;
+            }
+
+            for (int k = 0; k < 3; k++)
+            {
+                const ScreenVertex &from = v[(k + 1) % 3], &to = v[(k + 2) % 3];
+                int32_t a = from.y - to.y, b = to.x - from.x;
+                // top-left rule: pixels exactly on an edge belong to the triangle on its
+                // left or top side (interior to the right, or below a horizontal edge)
+                bool topLeft = a > 0 || (a == 0 && b < 0);
+                triangle.a[k] = a;
+                triangle.b[k] = b;
+                triangle.c[k] = -(static_cast<int64_t>(a) * from.x + static_cast<int64_t>(b) * from.y) + (topLeft ? 0 : -1);
+            }
+
+            // attribute gradients from the snapped positions, so they agree with coverage
+            float x1 = (v[1].x - v[0].x) * (1.0f / SUBPIXEL), y1 = (v[1].y - v[0].y) * (1.0f / SUBPIXEL);
+            float x2 = (v[2].x - v[0].x) * (1.0f / SUBPIXEL), y2 = (v[2].y - v[0].y) * (1.0f / SUBPIXEL);
+            float inverseArea = 1.0f / (x1 * y2 - x2 * y1);
+            auto plane = [&](float s0, float s1, float s2)
+            {
+                float d1 = s1 - s0, d2 = s2 - s0;
+                return Plane{(d1 * y2 - d2 * y1) * inverseArea, (d2 * x1 - d1 * x2) * inverseArea, s0};
+            };
+            triangle.x0 = v[0].x * (1.0f / SUBPIXEL);
+            triangle.y0 = v[0].y * (1.0f / SUBPIXEL);
+            triangle.z = plane(v[0].z, v[1].z, v[2].z);
+            triangle.q = plane(v[0].q, v[1].q, v[2].q);
+            for (int k = 0; k < chunk.varyingCount; k++)
+            {
+                triangle.varyings[k] = plane(v[0].varyings[k], v[1].varyings[k], v[2].varyings[k]);
+            }
+
+            uint32_t index = static_cast<uint32_t>(chunk.triangles.size());
+            chunk.triangles.push_back(triangle);
+            for (int ty = triangle.minY / chunk.tileSize; ty <= triangle.maxY / chunk.tileSize; ty++)
+            {
+                for (int tx = triangle.minX / chunk.tileSize; tx <= triangle.maxX / chunk.tileSize; tx++)
+                {
+                    chunk.bins[static_cast<size_t>(ty) * chunk.tilesX + tx].push_back(index);
+                }
+            }
+        }
+    }
+
+    namespace
+    {
+        // ex5's fragment shader at one pixel centre
+        void shade(const DrawCall &call, const Plane &q, const Plane &uq, const Plane &vq, float x, float y,
+                   float x0, float y0, unsigned char *out)
+        {
+            float inverseQ = 1.0f / q.at(x, y, x0, y0);
+            float u = uq.at(x, y, x0, y0) * inverseQ;
+            float v = vq.at(x, y, x0, y0) * inverseQ;
+            // exact screen space derivatives of the perspective divided coordinates
+            float dudx = (uq.dx - u * q.dx) * inverseQ, dudy = (uq.dy - u * q.dy) * inverseQ;
+            float dvdx = (vq.dx - v * q.dx) * inverseQ, dvdy = (vq.dy - v * q.dy) * inverseQ;
+
+            float colors[2][4];
+            const Texture *textures[2] = {call.texture1, call.texture2};
+            for (int t = 0; t < 2; t++)
+            {
+                const Texture *texture = textures[t];
+                if (texture == nullptr || texture->empty())
+                {
+                    std::fill(colors[t], colors[t] + 4, 1.0f);
+                    continue;
+                }
+                texture->sample(u, v, texture->lod(dudx, dvdx, dudy, dvdy), colors[t]);
+            }
+            for (int c = 0; c < 4; c++)
+            {
+                float value = colors[0][c] + (colors[1][c] - colors[0][c]) * call.mixFactor;
+                out[c] = toUnorm(value);
+            }
+        }
+    } // namespace
+
+    void Rasterizer::rasterizeTile(Framebuffer &target, const DrawCall &call, const Triangle &triangle, int tileX,
+                                   int tileY, uint64_t &fragments) const
+    {
+        int xBegin = std::max(tileX * m_tileSize, triangle.minX);
+        int xEnd = std::min(tileX * m_tileSize + m_tileSize - 1, triangle.maxX);
+        int yBegin = std::max(tileY * m_tileSize, triangle.minY);
+        int yEnd = std::min(tileY * m_tileSize + m_tileSize - 1, triangle.maxY);
+        if (xBegin > xEnd || yBegin > yEnd)
+        {
+            return;
+        }
+        // blocks of 4x2 pixels from an aligned corner, the eight lanes a GLSL program shades
+        int xStart = xBegin & ~3;
+        int xLast = xStart + ((xEnd - xStart) | 3);
+        int yStart = yBegin & ~1;
+        int yLast = yStart + ((yEnd - yStart) | 1);
+
+        int32_t rowStart[3], stepX[3], stepY[3];
+        for (int k = 0; k < 3; k++)
+        {
+            auto edge = [&](int x, int y)
+            {
+                return triangle.a[k] * (static_cast<int64_t>(x) * SUBPIXEL + SUBPIXEL / 2) +
+                       triangle.b[k] * (static_cast<int64_t>(y) * SUBPIXEL + SUBPIXEL / 2) + triangle.c[k];
+            };
+            int64_t corners[4] = {edge(xStart, yStart), edge(xLast, yStart), edge(xStart, yLast), edge(xLast, yLast)};
+            int64_t low = *std::min_element(corners, corners + 4), high = *std::max_element(corners, corners + 4);
+            if (high < 0)
+            {
+                return;
+            }
+            if (low >= 0)
+            {
+                // the whole block is inside this edge, leave it out of the test
+                rowStart[k] = stepX[k] = stepY[k] = 0;
+                continue;
+            }
+            // the values straddle 0 and differ by less than 2^31 across the block
+            rowStart[k] = static_cast<int32_t>(corners[0]);
+            stepX[k] = triangle.a[k] * SUBPIXEL;
+            stepY[k] = triangle.b[k] * SUBPIXEL;
+        }
+
+        const GlslProgram *program = call.program;
+        thread_local ShaderRegisters registers;
+        if (program != nullptr)
+        {
+            program->prepare(registers);
+        }
+        const int varyingCount = program != nullptr ? program->varyingCount() : 0;
+
+        const int width = target.width();
+        unsigned char *color = target.color();
+        float *depth = target.depth();
+        const float rowZ = triangle.z.origin - triangle.z.dx * triangle.x0 - triangle.z.dy * triangle.y0;
+        for (int y = yStart; y <= yLast; y += 2)
+        {
+            int32_t e[3] = {rowStart[0], rowStart[1], rowStart[2]};
+            for (int x = xStart; x <= xLast; x += 4)
+            {
+                // bit row * 4 + lane for pixel (x + lane, y + row)
+                unsigned mask = 0;
+                float z[8];
+                for (int row = 0; row < 2; row++)
+                {
+                    unsigned rowMask = 0;
+                    float zAtRow = rowZ + triangle.z.dy * (y + row + 0.5f);
+#ifdef LEARNOPENGL_X86
+                    const __m128i lanes = _mm_set_epi32(3, 2, 1, 0);
+                    __m128i inside = _mm_setzero_si128();
+                    for (int k = 0; k < 3; k++)
+                    {
+                        // e + lane * stepX, SSE2 has no 32 bit multiply so the steps are added up
+                        __m128i step = _mm_set1_epi32(stepX[k]);
+                        __m128i offsets = _mm_and_si128(_mm_cmpgt_epi32(lanes, _mm_setzero_si128()), step);
+                        offsets = _mm_add_epi32(offsets, _mm_and_si128(_mm_cmpgt_epi32(lanes, _mm_set1_epi32(1)), step));
+                        offsets = _mm_add_epi32(offsets, _mm_and_si128(_mm_cmpgt_epi32(lanes, _mm_set1_epi32(2)), step));
+                        __m128i start = _mm_set1_epi32(row == 0 ? e[k] : e[k] + stepY[k]);
+                        inside = _mm_or_si128(inside, _mm_add_epi32(start, offsets));
+                    }
+                    rowMask = static_cast<unsigned>(~_mm_movemask_ps(_mm_castsi128_ps(inside))) & 0xF;
+                    __m128 px = _mm_add_ps(_mm_set1_ps(x + 0.5f), _mm_cvtepi32_ps(lanes));
+                    _mm_storeu_ps(z + row * 4,
+                                  _mm_add_ps(_mm_set1_ps(zAtRow), _mm_mul_ps(_mm_set1_ps(triangle.z.dx), px)));
+#else
+                    for (int lane = 0; lane < 4; lane++)
+                    {
+                        bool inside = true;
+                        for (int k = 0; k < 3; k++)
+                        {
+                            inside = inside && e[k] + row * stepY[k] + lane * stepX[k] >= 0;
+                        }
+                        rowMask |= inside ? 1u << lane : 0u;
+                        z[row * 4 + lane] = zAtRow + triangle.z.dx * (x + lane + 0.5f);
+                    }
+#endif
+                    // rows outside the box, which the aligned block may overhang
+                    if (y + row >= yBegin && y + row <= yEnd)
+                    {
+                        mask |= rowMask << (row * 4);
+                    }
+                }
+                for (int k = 0; k < 3; k++)
+                {
+                    e[k] += 4 * stepX[k];
+                }
+                // lanes left of the box or right of it (and of the framebuffer)
+                for (int lane = 0; lane < 4; lane++)
+                {
+                    if (x + lane < xBegin || x + lane > xEnd)
+                    {
+                        mask &= ~(0x11u << lane);
+                    }
+                }
+                if (mask == 0)
+                {
+                    continue;
+                }
+                if (call.depthTest)
+                {
+                    for (int i = 0; i < 8; i++)
+                    {
+                        size_t pixel = static_cast<size_t>(y + (i >> 2)) * width + x + (i & 3);
+                        if ((mask >> i & 1) && !(z[i] < depth[pixel]))
+                        {
+                            mask &= ~(1u << i);
+                        }
+                    }
+                    if (mask == 0)
+                    {
+                        continue;
+                    }
+                }
+
+                Lanes shaded[4];
+                if (program != nullptr)
+                {
+                    // uncovered lanes are shaded too, GL's helper invocations for texture()'s derivatives
+                    Lanes varyings[MAX_VARYINGS], fragCoord[4];
+                    for (int i = 0; i < 8; i++)
+                    {
+                        float px = x + (i & 3) + 0.5f, py = y + (i >> 2) + 0.5f;
+                        float q = triangle.q.at(px, py, triangle.x0, triangle.y0);
+                        float inverseQ = 1.0f / q;
+                        for (int k = 0; k < varyingCount; k++)
+                        {
+                            varyings[k].v[i] = triangle.varyings[k].at(px, py, triangle.x0, triangle.y0) * inverseQ;
+                        }
+                        fragCoord[0].v[i] = px;
+                        fragCoord[1].v[i] = py;
+                        fragCoord[2].v[i] = z[i];
+                        fragCoord[3].v[i] = q;
+                    }
+                    program->shadeFragments(registers, varyings, fragCoord, shaded);
+                }
+                for (int i = 0; i < 8; i++)
+                {
+                    if ((mask >> i & 1) == 0)
+                    {
+                        continue;
+                    }
+                    size_t pixel = static_cast<size_t>(y + (i >> 2)) * width + x + (i & 3);
+                    if (call.depthTest)
+                    {
+                        depth[pixel] = z[i];
+                    }
+                    if (program != nullptr)
+                    {
+                        for (int c = 0; c < 4; c++)
+                        {
+                            color[pixel * 4 + c] = toUnorm(shaded[c].v[i]);
+                        }
+                    }
+                    else
+                    {
+                        shade(call, triangle.q, triangle.varyings[0], triangle.varyings[1], x + (i & 3) + 0.5f,
+                              y + (i >> 2) + 0.5f, triangle.x0, triangle.y0, color + pixel * 4);
+                    }
+                    fragments++;
+                }
+            }
+            for (int k = 0; k < 3; k++)
+            {
+                rowStart[k] += 2 * stepY[k];
+            }
+        }
+    }
+
+    void Rasterizer::draw(Framebuffer &target, const DrawCall &call)
+    {
+        const GlslProgram *program = call.program;
+        size_t triangleCount = (call.indices != nullptr ? call.indexCount : call.vertexCount) / 3;
+        size_t instances = call.instanceCount > 0 ? static_cast<size_t>(call.instanceCount) : 0;
+        if (triangleCount == 0 || instances == 0 || (program == nullptr && call.positions == nullptr) ||
+            target.width() <= 0 || target.height() <= 0 || target.width() > MAX_SIZE || target.height() > MAX_SIZE)
+        {
+            return;
+        }
+        const int varyingCount = program != nullptr ? program->varyingCount() : 2;
+
+        // vertex stage for every instance: the program, or gl_Position = mvp * position
+        // with the uv passed through
+        std::vector<ClipVertex> vertices(call.vertexCount * instances);
+        m_pool.parallelFor(vertices.size(), 4096,
+                           [&](size_t begin, size_t end)
+                           {
+                               if (program != nullptr)
+                               {
+                                   thread_local ShaderRegisters registers;
+                                   program->prepare(registers);
+                                   for (size_t i = begin; i < end;)
+                                   {
+                                       size_t first = i % call.vertexCount;
+                                       size_t count = std::min({end - i, call.vertexCount - first,
+                                                                static_cast<size_t>(GlslShader::LANES)});
+                                       program->shadeVertices(registers, call.attributes, first, count,
+                                                              static_cast<int>(i / call.vertexCount),
+                                                              vertices[i].position, vertices[i].varyings,
+                                                              sizeof(ClipVertex));
+                                       i += count;
+                                   }
+                                   return;
+                               }
+                               const float *m = call.mvp;
+                               for (size_t i = begin; i < end; i++)
+                               {
+                                   size_t source = i % call.vertexCount;
+                                   const float *p = reinterpret_cast<const float *>(
+                                       reinterpret_cast<const unsigned char *>(call.positions) +
+                                       source * call.positionStride);
+                                   ClipVertex &v = vertices[i];
+                                   for (int r = 0; r < 4; r++)
+                                   {
+                                       v.position[r] = m[r] * p[0] + m[4 + r] * p[1] + m[8 + r] * p[2] + m[12 + r];
+                                   }
+                                   if (call.uvs != nullptr)
+                                   {
+                                       const float *t = reinterpret_cast<const float *>(
+                                           reinterpret_cast<const unsigned char *>(call.uvs) + source * call.uvStride);
+                                       v.varyings[0] = t[0];
+                                       v.varyings[1] = t[1];
+                                   }
+                                   else
+                                   {
+                                       v.varyings[0] = v.varyings[1] = 0.0f;
+                                   }
+                               }
+                           });
+
+        // setup and binning, chunks of triangles in submission order
+        int tilesX = (target.width() + m_tileSize - 1) / m_tileSize;
+        int tilesY = (target.height() + m_tileSize - 1) / m_tileSize;
+        size_t tileCount = static_cast<size_t>(tilesX) * tilesY;
+        size_t totalTriangles = triangleCount * instances;
+        size_t grain = std::max<size_t>(1024, totalTriangles / (4 * m_pool.threadCount() + 1) + 1);
+        std::vector<Chunk> chunks((totalTriangles + grain - 1) / grain);
+        m_pool.parallelFor(chunks.size(), 1,
+                           [&](size_t begin, size_t end)
+                           {
+                               for (size_t c = begin; c < end; c++)
+                               {
+                                   Chunk &chunk = chunks[c];
+                                   chunk.bins.resize(tileCount);
+                                   chunk.tilesX = tilesX;
+                                   chunk.tileSize = m_tileSize;
+                                   chunk.varyingCount = varyingCount;
+                                   size_t last = std::min(totalTriangles, (c + 1) * grain);
+                                   for (size_t t = c * grain; t < last; t++)
+                                   {
+                                       // instances one after the other, each in index order
+                                       size_t local = t % triangleCount;
+                                       size_t offset = t / triangleCount * call.vertexCount;
+                                       ClipVertex corners[3];
+                                       bool valid = true;
+                                       for (int k = 0; k < 3; k++)
+                                       {
+                                           size_t index =
+                                               call.indices != nullptr ? call.indices[local * 3 + k] : local * 3 + k;
+                                           valid = valid && index < call.vertexCount;
+                                           corners[k] = valid ? vertices[offset + index] : ClipVertex{};
+                                       }
+                                       if (valid)
+                                       {
+                                           setupTriangle(corners, target, call, chunk);
+                                       }
+                                   }
+                               }
+                           });
+
+        // tiles in parallel, each drawing its triangles in order
+        std::vector<uint64_t> fragments(tileCount, 0);
+        m_pool.parallelFor(tileCount, 1,
+                           [&](size_t begin, size_t end)
+                           {
+                               for (size_t tile = begin; tile < end; tile++)
+                               {
+                                   int tileX = static_cast<int>(tile % tilesX), tileY = static_cast<int>(tile / tilesX);
+                                   for (const Chunk &chunk : chunks)
+                                   {
+                                       for (uint32_t index : chunk.bins[tile])
+                                       {
+                                           rasterizeTile(target, call, chunk.triangles[index], tileX, tileY,
+                                                         fragments[tile]);
+                                       }
+                                   }
+                               }
+                           });
+
+        for (const Chunk &chunk : chunks)
+        {
+            m_stats.triangles += chunk.triangles.size();
+        }
+        for (uint64_t count : fragments)
+        {
+            m_stats.fragments += count;
+        }
+    }
+} // namespace soft
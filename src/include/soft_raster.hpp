@@ -0,0 +1,159 @@
+#ifndef SOFT_RASTER_HPP
+#define SOFT_RASTER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+// A CPU implementation of the part of the GL pipeline the examples use, for reference
+// images and for hosts without a GL driver: indexed and non-indexed triangles, one
+// model-view-projection transform, clipping, perspective correct texture coordinates,
+// GL_LESS depth testing and ex5's fragment shader, mix(texture1, texture2, factor),
+// sampled GL_LINEAR_MIPMAP_LINEAR with GL_REPEAT, or any GLSL program GlslProgram
+// (glsl_vm.hpp) runs. Conventions follow GL: counter clockwise front faces, pixel
+// centres at half integers, row 0 at the bottom.
+namespace soft
+{
+    class GlslProgram;
+
+    // floats a vertex shader can hand to the fragment shader
+    const int MAX_VARYINGS = 16;
+    const int MAX_ATTRIBUTES = 8;
+
+    // An RGBA8 texture and the box filtered mip chain Texture2D::load gives colour data.
+    class Texture
+    {
+    public:
+        // rgba: tightly packed width * height RGBA8, first row at t = 0
+        void load(const unsigned char *rgba, int width, int height);
+        bool empty() const;
+        int width() const;
+        int height() const;
+
+        // trilinear filtering at level of detail lod (log2 of texels per pixel);
+        // lod <= 0 is magnification and samples level 0 bilinearly
+        void sample(float u, float v, float lod, float rgba[4]) const;
+        // GL's level of detail for these screen space derivatives of (u, v)
+        float lod(float dudx, float dvdx, float dudy, float dvdy) const;
+
+    private:
+        struct Level
+        {
+            int width;
+            int height;
+            std::vector<unsigned char> texels;
+        };
+
+        void bilinear(const Level &level, float u, float v, float rgba[4]) const;
+        // vars
+        std::vector<Level> m_levels;
+    };
+
+    // Colour (RGBA8) and depth (float, 0 near to 1 far) of the same size, bottom row first
+    // like glReadPixels returns it.
+    class Framebuffer
+    {
+    public:
+        Framebuffer(int width, int height);
+
+        void clear(const float rgba[4], float depth = 1.0f);
+        int width() const;
+        int height() const;
+        const unsigned char *color() const;
+        const float *depth() const;
+        unsigned char *color();
+        float *depth();
+
+    private:
+        // vars
+        int m_width;
+        int m_height;
+        std::vector<unsigned char> m_color;
+        std::vector<float> m_depth;
+    };
+
+    // a vertex attribute array, glVertexAttribPointer's float case
+    struct AttributeStream
+    {
+        const float *data = nullptr; // null reads (0, 0, 0, 1)
+        size_t stride = 0;           // bytes
+        int components = 0;
+    };
+
+    struct DrawCall
+    {
+        // object space vertices, positions as 3 floats and uvs as 2, any stride
+        const float *positions = nullptr;
+        size_t positionStride = 3 * sizeof(float);
+        const float *uvs = nullptr; // may be null, (0, 0) everywhere then
+        size_t uvStride = 2 * sizeof(float);
+        size_t vertexCount = 0;
+        // triangle list; null draws the vertices in order, like glDrawArrays
+        const uint32_t *indices = nullptr;
+        size_t indexCount = 0;
+        // projection * view * model, column major like glm
+        float mvp[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+        // textures missing from the draw sample as white
+        const Texture *texture1 = nullptr;
+        const Texture *texture2 = nullptr;
+        float mixFactor = 0.2f;
+        bool depthTest = true; // GL_LESS with depth writes, off leaves depth untouched
+        bool cullBackFaces = false;
+        // A GLSL program replaces the transform and shading above: its vertex inputs
+        // read attributes[location] (positions and uvs are ignored), vertexCount and
+        // indices still apply, gl_InstanceID runs up to instanceCount.
+        const GlslProgram *program = nullptr;
+        AttributeStream attributes[MAX_ATTRIBUTES];
+        int instanceCount = 1;
+    };
+
+    struct RasterStats
+    {
+        uint64_t triangles = 0; // after culling and clipping
+        uint64_t fragments = 0; // covered samples that passed the depth test
+    };
+
+    // Bins triangles into square tiles, then rasterises the tiles in parallel, each with
+    // its triangles in submission order, so the image does not depend on the thread
+    // count. Coverage uses 4 bit sub-pixel fixed point edge functions (with the top-left
+    // fill rule) evaluated over 4x2 pixel blocks, the lanes GlslProgram shades.
+    class Rasterizer
+    {
+    public:
+        explicit Rasterizer(ThreadPool &pool, int tileSize = 64);
+        Rasterizer();
+
+        Rasterizer(const Rasterizer &) = delete;
+        Rasterizer &operator=(const Rasterizer &) = delete;
+
+        // framebuffers up to MAX_SIZE pixels on a side
+        void draw(Framebuffer &target, const DrawCall &call);
+
+        const RasterStats &stats() const;
+        void resetStats();
+
+        static const int MAX_SIZE = 8192;
+
+    private:
+        struct ClipVertex
+        {
+            float position[4];
+            float varyings[MAX_VARYINGS]; // the uv without a program
+        };
+        struct Triangle;
+        struct Chunk;
+
+        void setupTriangle(const ClipVertex *vertices, const Framebuffer &target, const DrawCall &call,
+                           Chunk &chunk) const;
+        void rasterizeTile(Framebuffer &target, const DrawCall &call, const Triangle &triangle, int tileX,
+                           int tileY, uint64_t &fragments) const;
+        // vars
+        ThreadPool &m_pool;
+        int m_tileSize;
+        RasterStats m_stats;
+    };
+} // namespace soft
+
+#endif // SOFT_RASTER_HPP
@@ -0,0 +1,98 @@
+#include "staging_buffer.hpp"
+#include "gl_extensions.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+StagingBuffer::StagingBuffer(size_t size) : m_buffer{0}, m_mapped{nullptr}, m_size{size}, m_head{0}
+{
+    const glext::Extensions &ext = glext::get();
+    if (!ext.persistentMapping || size == 0)
+    {
+        return;
+    }
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glGenBuffers(1, &m_buffer);
+    glBindBuffer(GL_COPY_READ_BUFFER, m_buffer);
+    ext.bufferStorage(GL_COPY_READ_BUFFER, static_cast<GLsizeiptr>(size), nullptr, flags);
+    m_mapped = static_cast<unsigned char *>(glMapBufferRange(GL_COPY_READ_BUFFER, 0, static_cast<GLsizeiptr>(size), flags));
+    if (m_mapped == nullptr)
+    {
+        glDeleteBuffers(1, &m_buffer);
+        m_buffer = 0;
+    }
+};
+
+StagingBuffer::~StagingBuffer()
+{
+    for (Region &region : m_inFlight)
+    {
+        glDeleteSync(region.fence);
+    }
+    if (m_buffer != 0)
+    {
+        // deleting a mapped buffer unmaps it
+        glDeleteBuffers(1, &m_buffer);
+    }
+}
+
+bool StagingBuffer::persistent() const
+{
+    return m_mapped != nullptr;
+}
+
+size_t StagingBuffer::size() const
+{
+    return m_size;
+}
+
+void StagingBuffer::waitFor(const Region &region)
+{
+    while (glClientWaitSync(region.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED)
+    {
+    }
+    glDeleteSync(region.fence);
+}
+
+void StagingBuffer::copy(GLuint target, size_t targetOffset, const void *data, size_t size)
+{
+    const unsigned char *src = static_cast<const unsigned char *>(data);
+    if (!persistent())
+    {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, target);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(targetOffset), static_cast<GLsizeiptr>(size), src);
+        return;
+    }
+
+    glBindBuffer(GL_COPY_READ_BUFFER, m_buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, target);
+    while (size > 0)
+    {
+        size_t piece = std::min(size, m_size);
+        if (m_head + piece > m_size)
+        {
+            // wrap: the regions left in the tail are the oldest, retire them first
+            while (!m_inFlight.empty() && m_inFlight.front().begin >= m_head)
+            {
+                waitFor(m_inFlight.front());
+                m_inFlight.pop_front();
+            }
+            m_head = 0;
+        }
+        while (!m_inFlight.empty() && m_inFlight.front().begin < m_head + piece && m_inFlight.front().end > m_head)
+        {
+            waitFor(m_inFlight.front());
+            m_inFlight.pop_front();
+        }
+
+        std::memcpy(m_mapped + m_head, src, piece);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(m_head),
+                            static_cast<GLintptr>(targetOffset), static_cast<GLsizeiptr>(piece));
+        m_inFlight.push_back(Region{m_head, m_head + piece, glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0)});
+
+        m_head += piece;
+        src += piece;
+        targetOffset += piece;
+        size -= piece;
+    }
+}
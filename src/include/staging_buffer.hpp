@@ -0,0 +1,46 @@
+#ifndef STAGING_BUFFER_HPP
+#define STAGING_BUFFER_HPP
+
+#include <cstddef>
+#include <deque>
+#include <glad/glad.h>
+
+// Ring of persistently mapped, coherent memory (GL 4.4 / ARB_buffer_storage) that
+// feeds glCopyBufferSubData. Data is copied once from wherever it lives (for example a
+// mapped file) into memory the driver can DMA from, with no glBufferData staging copy
+// and no stall: every piece is fenced and a region is only reused once its fence
+// has signalled. Without buffer storage copy() falls back to glBufferSubData.
+class StagingBuffer
+{
+public:
+    explicit StagingBuffer(size_t size = 16 << 20);
+    ~StagingBuffer();
+
+    StagingBuffer(const StagingBuffer &) = delete;
+    StagingBuffer &operator=(const StagingBuffer &) = delete;
+
+    bool persistent() const;
+    size_t size() const;
+
+    // writes size bytes of data into target (a buffer object with enough storage) at
+    // targetOffset; data larger than the ring goes through in pieces
+    void copy(GLuint target, size_t targetOffset, const void *data, size_t size);
+
+private:
+    struct Region
+    {
+        size_t begin;
+        size_t end;
+        GLsync fence;
+    };
+
+    void waitFor(const Region &region);
+    // vars
+    GLuint m_buffer;
+    unsigned char *m_mapped;
+    size_t m_size;
+    size_t m_head;
+    std::deque<Region> m_inFlight;
+};
+
+#endif // STAGING_BUFFER_HPP
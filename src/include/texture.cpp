@@ -0,0 +1,401 @@
+#include "texture.hpp"
+#include "gl_extensions.hpp"
+#include "hdr_pack.hpp"
+#include "image_decode.hpp"
+#include "mipmap.hpp"
+#include "pixel_convert.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+namespace
+{
+    // any client format/type pair valid for the internal format, only used to allocate
+    // levels with glTexImage2D when immutable storage is missing
+    void allocationFormat(GLenum internalFormat, GLenum &format, GLenum &type)
+    {
+        type = GL_UNSIGNED_BYTE;
+        switch (internalFormat)
+        {
+        case GL_R8:
+        case GL_R16:
+            format = GL_RED;
+            break;
+        case GL_RG8:
+        case GL_RG16:
+            format = GL_RG;
+            break;
+        case GL_RGB8:
+        case GL_SRGB8:
+        case GL_RGB16:
+            format = GL_RGB;
+            break;
+        case GL_R16F:
+            format = GL_RED;
+            type = GL_HALF_FLOAT;
+            break;
+        case GL_RG16F:
+            format = GL_RG;
+            type = GL_HALF_FLOAT;
+            break;
+        case GL_RGB16F:
+            format = GL_RGB;
+            type = GL_HALF_FLOAT;
+            break;
+        case GL_RGBA16F:
+            format = GL_RGBA;
+            type = GL_HALF_FLOAT;
+            break;
+        case GL_RGB32F:
+            format = GL_RGB;
+            type = GL_FLOAT;
+            break;
+        case GL_RGBA32F:
+            format = GL_RGBA;
+            type = GL_FLOAT;
+            break;
+        case GL_R11F_G11F_B10F:
+            format = GL_RGB;
+            type = GL_UNSIGNED_INT_10F_11F_11F_REV;
+            break;
+        case GL_RGB9_E5:
+            format = GL_RGB;
+            type = GL_UNSIGNED_INT_5_9_9_9_REV;
+            break;
+        case GL_DEPTH_COMPONENT24:
+        case GL_DEPTH_COMPONENT32F:
+            format = GL_DEPTH_COMPONENT;
+            type = GL_FLOAT;
+            break;
+        default:
+            format = GL_RGBA;
+            break;
+        }
+    }
+} // namespace
+
+// ---------------------------------------------------------------------------
+// SamplerCache
+
+GLuint SamplerCache::get(const SamplerDesc &desc)
+{
+    SamplerDesc key = desc;
+    const glext::Extensions &extensions = glext::get();
+    key.anisotropy = extensions.anisotropy ? std::clamp(desc.anisotropy, 1.0f, extensions.maxAnisotropy) : 1.0f;
+
+    auto it = m_samplers.find(key);
+    if (it != m_samplers.end())
+    {
+        return it->second;
+    }
+    GLuint sampler;
+    glGenSamplers(1, &sampler);
+    glSamplerParameteri(sampler, GL_TEXTURE_MIN_FILTER, static_cast<GLint>(key.minFilter));
+    glSamplerParameteri(sampler, GL_TEXTURE_MAG_FILTER, static_cast<GLint>(key.magFilter));
+    glSamplerParameteri(sampler, GL_TEXTURE_WRAP_S, static_cast<GLint>(key.wrapS));
+    glSamplerParameteri(sampler, GL_TEXTURE_WRAP_T, static_cast<GLint>(key.wrapT));
+    if (key.anisotropy > 1.0f)
+    {
+        glSamplerParameterf(sampler, GL_TEXTURE_MAX_ANISOTROPY, key.anisotropy);
+    }
+    m_samplers.emplace(key, sampler);
+    return sampler;
+}
+
+size_t SamplerCache::size() const
+{
+    return m_samplers.size();
+}
+
+void SamplerCache::clear()
+{
+    for (const auto &[desc, sampler] : m_samplers)
+    {
+        glDeleteSamplers(1, &sampler);
+    }
+    m_samplers.clear();
+}
+
+SamplerCache &SamplerCache::shared()
+{
+    static SamplerCache cache;
+    return cache;
+}
+
+// ---------------------------------------------------------------------------
+// Texture2D
+
+Texture2D::Texture2D() : m_texture{0}, m_sampler{0}, m_width{0}, m_height{0}, m_levels{0}, m_internalFormat{0} {};
+
+Texture2D::~Texture2D()
+{
+    destroy();
+}
+
+Texture2D::Texture2D(Texture2D &&other) noexcept : Texture2D()
+{
+    *this = std::move(other);
+}
+
+Texture2D &Texture2D::operator=(Texture2D &&other) noexcept
+{
+    if (this != &other)
+    {
+        destroy();
+        m_texture = other.m_texture;
+        m_sampler = other.m_sampler;
+        m_width = other.m_width;
+        m_height = other.m_height;
+        m_levels = other.m_levels;
+        m_internalFormat = other.m_internalFormat;
+        other.m_texture = 0;
+        other.m_levels = 0;
+    }
+    return *this;
+}
+
+int Texture2D::fullMipCount(int width, int height)
+{
+    int levels = 1;
+    for (int size = std::max(width, height); size > 1; size >>= 1)
+    {
+        levels++;
+    }
+    return levels;
+}
+
+bool Texture2D::create(int width, int height, GLenum internalFormat, int levels)
+{
+    destroy();
+    if (width <= 0 || height <= 0)
+    {
+        std::cerr << "Invalid texture size " << width << "x" << height << std::endl;
+        return false;
+    }
+    m_width = width;
+    m_height = height;
+    m_levels = levels > 0 ? std::min(levels, fullMipCount(width, height)) : fullMipCount(width, height);
+    m_internalFormat = internalFormat;
+
+    glGenTextures(1, &m_texture);
+    glBindTexture(GL_TEXTURE_2D, m_texture);
+    if (glext::get().textureStorage)
+    {
+        glext::get().texStorage2D(GL_TEXTURE_2D, m_levels, internalFormat, width, height);
+    }
+    else
+    {
+        GLenum format, type;
+        allocationFormat(internalFormat, format, type);
+        for (int level = 0; level < m_levels; level++)
+        {
+            glTexImage2D(GL_TEXTURE_2D, level, static_cast<GLint>(internalFormat), std::max(1, width >> level),
+                         std::max(1, height >> level), 0, format, type, NULL);
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, m_levels - 1);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    if (m_sampler == 0)
+    {
+        m_sampler = SamplerCache::shared().get(SamplerDesc{});
+    }
+    return true;
+}
+
+void Texture2D::upload(int level, GLenum format, GLenum type, const void *pixels)
+{
+    uploadRows(level, 0, std::max(1, m_height >> level), format, type, pixels);
+}
+
+void Texture2D::uploadRows(int level, int y, int rows, GLenum format, GLenum type, const void *pixels)
+{
+    glBindTexture(GL_TEXTURE_2D, m_texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage2D(GL_TEXTURE_2D, level, 0, y, std::max(1, m_width >> level), rows, format, type, pixels);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void Texture2D::setBaseLevel(int level)
+{
+    glBindTexture(GL_TEXTURE_2D, m_texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, std::clamp(level, 0, std::max(0, m_levels - 1)));
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void Texture2D::generateMipmaps()
+{
+    if (m_levels > 1)
+    {
+        glBindTexture(GL_TEXTURE_2D, m_texture);
+        glGenerateMipmap(GL_TEXTURE_2D);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+}
+
+void Texture2D::setSampler(const SamplerDesc &desc)
+{
+    m_sampler = SamplerCache::shared().get(desc);
+}
+
+bool Texture2D::load(const std::filesystem::path &path, const SamplerDesc &sampler, const TextureLoadOptions &options)
+{
+    int width, height, channels;
+    unsigned char *pixels = loadImage(path, width, height, channels);
+    if (pixels == nullptr)
+    {
+        return false;
+    }
+    size_t count = static_cast<size_t>(width) * height;
+    if (channels == 3)
+    {
+        unsigned char *rgba = static_cast<unsigned char *>(ImageArena::local().allocate(count * 4));
+        pixel::rgbToRgba(pixels, rgba, count);
+        pixels = rgba;
+        channels = 4;
+    }
+    if (options.flipVertically)
+    {
+        pixel::flipVertical(pixels, static_cast<size_t>(width) * channels, static_cast<size_t>(height));
+    }
+    if (options.premultiplyAlpha && channels == 4)
+    {
+        pixel::premultiplyAlpha(pixels, count);
+    }
+
+    const GLenum formats[] = {GL_RED, GL_RG, GL_RGB, GL_RGBA};
+    const GLenum linear[] = {GL_R8, GL_RG8, GL_RGB8, GL_RGBA8};
+    const GLenum gamma[] = {GL_R8, GL_RG8, GL_SRGB8, GL_SRGB8_ALPHA8};
+    bool ok = create(width, height, options.srgb ? gamma[channels - 1] : linear[channels - 1]);
+    if (ok)
+    {
+        upload(0, formats[channels - 1], GL_UNSIGNED_BYTE, pixels);
+        // colour filtered in linear light, like the streamed textures; grey data stays linear as its format does
+        MipmapGenerator generator(MipmapGenerator::BOX, channels >= 3 && (options.srgb || !options.linearColor));
+        for (const MipmapGenerator::Level &mip : generator.generate(pixels, width, height, channels, 8, m_levels - 1))
+        {
+            upload(mip.level, formats[channels - 1], GL_UNSIGNED_BYTE, mip.data.data());
+        }
+        setSampler(sampler);
+    }
+    ImageArena::local().reset();
+    return ok;
+}
+
+bool Texture2D::loadHdr(const std::filesystem::path &path, HdrFormat format, const SamplerDesc &sampler)
+{
+    int width, height, channels;
+    float *pixels = loadImageHdr(path, width, height, channels, format == HALF_FLOAT ? 0 : 3);
+    if (pixels == nullptr)
+    {
+        return false;
+    }
+    ImageArena &arena = ImageArena::local();
+    size_t count = static_cast<size_t>(width) * height;
+    if (format != HALF_FLOAT)
+    {
+        channels = 3;
+    }
+    else if (channels == 3)
+    {
+        // RGBA16F rather than RGB16F: same reasons as the 8 bit path, and RGB16F is not renderable
+        float *rgba = static_cast<float *>(arena.allocate(count * 4 * sizeof(float)));
+        for (size_t i = 0; i < count; i++)
+        {
+            rgba[i * 4 + 0] = pixels[i * 3 + 0];
+            rgba[i * 4 + 1] = pixels[i * 3 + 1];
+            rgba[i * 4 + 2] = pixels[i * 3 + 2];
+            rgba[i * 4 + 3] = 1.0f;
+        }
+        pixels = rgba;
+        channels = 4;
+    }
+
+    const GLenum formats[] = {GL_RED, GL_RG, GL_RGB, GL_RGBA};
+    const GLenum halfFormats[] = {GL_R16F, GL_RG16F, GL_RGB16F, GL_RGBA16F};
+    GLenum internalFormat = format == HALF_FLOAT        ? halfFormats[channels - 1]
+                            : format == SHARED_EXPONENT ? GL_RGB9_E5
+                                                        : GL_R11F_G11F_B10F;
+    if (!create(width, height, internalFormat))
+    {
+        arena.reset();
+        return false;
+    }
+
+    // level 0 is the largest, so its scratch buffer fits every level
+    void *packed = arena.allocate(count * (format == HALF_FLOAT ? channels * sizeof(uint16_t) : sizeof(uint32_t)));
+    std::vector<MipmapGenerator::Level> mips =
+        MipmapGenerator(MipmapGenerator::BOX, false).generate(pixels, width, height, channels, 32, m_levels - 1);
+    for (int i = 0; i < m_levels; i++)
+    {
+        const float *level = i == 0 ? pixels : reinterpret_cast<const float *>(mips[i - 1].data.data());
+        size_t texels = static_cast<size_t>(std::max(1, width >> i)) * std::max(1, height >> i);
+        switch (format)
+        {
+        case HALF_FLOAT:
+            hdr::floatToHalf(level, static_cast<uint16_t *>(packed), texels * channels);
+            upload(i, formats[channels - 1], GL_HALF_FLOAT, packed);
+            break;
+        case SHARED_EXPONENT:
+            hdr::packRgb9e5(level, channels, static_cast<uint32_t *>(packed), texels);
+            upload(i, GL_RGB, GL_UNSIGNED_INT_5_9_9_9_REV, packed);
+            break;
+        case PACKED_FLOAT:
+            hdr::packR11G11B10(level, channels, static_cast<uint32_t *>(packed), texels);
+            upload(i, GL_RGB, GL_UNSIGNED_INT_10F_11F_11F_REV, packed);
+            break;
+        }
+    }
+    setSampler(sampler);
+    arena.reset();
+    return true;
+}
+
+void Texture2D::bind(GLuint unit) const
+{
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D, m_texture);
+    glBindSampler(unit, m_sampler);
+}
+
+GLuint Texture2D::id() const
+{
+    return m_texture;
+}
+
+GLuint Texture2D::sampler() const
+{
+    return m_sampler;
+}
+
+int Texture2D::width() const
+{
+    return m_width;
+}
+
+int Texture2D::height() const
+{
+    return m_height;
+}
+
+int Texture2D::levels() const
+{
+    return m_levels;
+}
+
+GLenum Texture2D::internalFormat() const
+{
+    return m_internalFormat;
+}
+
+void Texture2D::destroy()
+{
+    if (m_texture != 0)
+    {
+        glDeleteTextures(1, &m_texture);
+        m_texture = 0;
+    }
+    m_levels = 0;
+}
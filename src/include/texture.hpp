@@ -0,0 +1,132 @@
+#ifndef TEXTURE_HPP
+#define TEXTURE_HPP
+
+#include <cstddef>
+#include <filesystem>
+#include <map>
+#include <tuple>
+#include <glad/glad.h>
+
+// Filtering and addressing state, kept apart from the texture itself.
+struct SamplerDesc
+{
+    GLenum minFilter = GL_LINEAR_MIPMAP_LINEAR;
+    GLenum magFilter = GL_LINEAR;
+    GLenum wrapS = GL_REPEAT;
+    GLenum wrapT = GL_REPEAT;
+    float anisotropy = 1.0f; // clamped to what the driver supports, ignored without the extension
+
+    bool operator<(const SamplerDesc &other) const
+    {
+        return std::tie(minFilter, magFilter, wrapS, wrapT, anisotropy) <
+               std::tie(other.minFilter, other.magFilter, other.wrapS, other.wrapT, other.anisotropy);
+    }
+};
+
+// One sampler object per distinct SamplerDesc, shared by every texture using it.
+class SamplerCache
+{
+public:
+    SamplerCache() {};
+
+    SamplerCache(const SamplerCache &) = delete;
+    SamplerCache &operator=(const SamplerCache &) = delete;
+
+    GLuint get(const SamplerDesc &desc);
+    size_t size() const;
+    // deletes every sampler, needs the context that created them to be current
+    void clear();
+
+    // cache for the current context, created on first use. Its samplers are left to the
+    // driver at exit since the context is usually gone by then; call clear() to free them early.
+    static SamplerCache &shared();
+
+private:
+    // vars
+    std::map<SamplerDesc, GLuint> m_samplers;
+};
+
+// How Texture2D::load prepares decoded pixels.
+struct TextureLoadOptions
+{
+    bool srgb = false;           // sRGB internal format for colour, alpha and grey data stay linear
+    bool flipVertically = false; // first image row at t = 0, like stbi_set_flip_vertically_on_load(true)
+    bool premultiplyAlpha = false;
+    // Colour is taken to be sRGB encoded, as photos and painted textures are, so its mips are
+    // averaged in linear light even in a linear format. Set for data that is not a colour
+    // (normal maps, masks) to average the stored values instead.
+    bool linearColor = false;
+};
+
+// A 2D texture with immutable storage (glTexStorage2D) where the driver has it.
+// Without it every level is allocated up front with glTexImage2D and the level range
+// is fixed, so the texture is just as complete from the start.
+// Sampling state comes from a SamplerCache sampler bound next to the texture, the
+// texture object itself never gets glTexParameter filter/wrap calls.
+class Texture2D
+{
+public:
+    // GPU layout for Texture2D::loadHdr
+    enum HdrFormat
+    {
+        HALF_FLOAT,      // R16F / RG16F / RGBA16F, 8 bytes per RGBA texel, keeps alpha and negative values
+        SHARED_EXPONENT, // RGB9_E5, 4 bytes, best precision per bit for colour but not renderable
+        PACKED_FLOAT,    // R11F_G11F_B10F, 4 bytes, renderable, 6/6/5 bit mantissas
+    };
+
+    Texture2D();
+    ~Texture2D();
+
+    Texture2D(const Texture2D &) = delete;
+    Texture2D &operator=(const Texture2D &) = delete;
+    Texture2D(Texture2D &&other) noexcept;
+    Texture2D &operator=(Texture2D &&other) noexcept;
+
+    // levels == 0 allocates the full mip chain
+    bool create(int width, int height, GLenum internalFormat, int levels = 0);
+    // rows are tightly packed
+    void upload(int level, GLenum format, GLenum type, const void *pixels);
+    // rows [y, y + rows) of a level, for uploads split over several frames
+    void uploadRows(int level, int y, int rows, GLenum format, GLenum type, const void *pixels);
+    // Limits sampling to levels >= level, so a texture whose fine levels are still
+    // streaming in stays complete. Leaves filtering alone.
+    void setBaseLevel(int level);
+    void generateMipmaps();
+    void setSampler(const SamplerDesc &desc);
+
+    // Decodes an 8 bit image and uploads it with a full mip chain built on the CPU by
+    // MipmapGenerator. RGB images are expanded to RGBA on the CPU (see pixel_convert.hpp)
+    // so the driver never has to repack 3 byte texels or deal with unaligned rows.
+    // Scratch memory comes from the calling thread's ImageArena, which is reset afterwards.
+    bool load(const std::filesystem::path &path, const SamplerDesc &sampler = SamplerDesc{},
+              const TextureLoadOptions &options = TextureLoadOptions{});
+    // Decodes a Radiance .hdr or 16 bit PNG to floats (see loadImageHdr) and packs it into
+    // `format` with hdr_pack.hpp. The mip chain is box filtered in float on the CPU by
+    // MipmapGenerator since RGB9_E5 cannot be rendered to by glGenerateMipmap. Packed
+    // formats drop alpha.
+    bool loadHdr(const std::filesystem::path &path, HdrFormat format, const SamplerDesc &sampler = SamplerDesc{});
+
+    // binds the texture and its sampler to texture unit `unit`
+    void bind(GLuint unit) const;
+
+    GLuint id() const;
+    GLuint sampler() const;
+    int width() const;
+    int height() const;
+    int levels() const;
+    GLenum internalFormat() const;
+
+    static int fullMipCount(int width, int height);
+
+private:
+    void destroy();
+    // vars
+    GLuint m_texture;
+    GLuint m_sampler;
+    int m_width;
+    int m_height;
+    int m_levels;
+    GLenum m_internalFormat;
+};
+
+#endif // TEXTURE_HPP
@@ -0,0 +1,167 @@
+#include "texture_streamer.hpp"
+#include "image_decode.hpp"
+#include "mipmap.hpp"
+#include "pixel_convert.hpp"
+#include "thread_pool.hpp"
+
+#include <cstring>
+
+TextureStreamer::TextureStreamer() : TextureStreamer(UploadScheduler::Settings{}) {};
+
+TextureStreamer::TextureStreamer(const UploadScheduler::Settings &settings) : m_scheduler(settings), m_decoding{0} {};
+
+TextureStreamer::~TextureStreamer()
+{
+    // decode jobs still reference this object
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_idle.wait(lock, [this]
+                { return m_decoding == 0; });
+}
+
+uint32_t TextureStreamer::load(Texture2D &texture, const std::filesystem::path &path, float priority,
+                               const TextureLoadOptions &options)
+{
+    uint32_t handle = m_scheduler.createHandle();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_entries[handle] = Entry{&texture, DECODING, 0, 0, 0, 0, 0};
+        m_decoding++;
+    }
+
+    ThreadPool::shared().enqueue(
+        [this, handle, path, priority, options]
+        {
+            int width, height, channels;
+            unsigned char *pixels = loadImage(path, width, height, channels);
+            std::vector<UploadScheduler::Level> levels;
+            if (pixels != nullptr)
+            {
+                size_t count = static_cast<size_t>(width) * height;
+                // same preparation as Texture2D::load
+                UploadScheduler::Level base{width, height, {}};
+                base.pixels.resize(count * (channels == 3 ? 4 : channels));
+                if (channels == 3)
+                {
+                    pixel::rgbToRgba(pixels, base.pixels.data(), count);
+                    channels = 4;
+                }
+                else
+                {
+                    std::memcpy(base.pixels.data(), pixels, base.pixels.size());
+                }
+                if (options.flipVertically)
+                {
+                    pixel::flipVertical(base.pixels.data(), static_cast<size_t>(width) * channels,
+                                        static_cast<size_t>(height));
+                }
+                if (options.premultiplyAlpha && channels == 4)
+                {
+                    pixel::premultiplyAlpha(base.pixels.data(), count);
+                }
+
+                // the CPU chain replaces glGenerateMipmap, which would need the whole level 0 first
+                // same colour space rule as Texture2D::load
+                MipmapGenerator generator(MipmapGenerator::BOX,
+                                          channels >= 3 && (options.srgb || !options.linearColor));
+                std::vector<MipmapGenerator::Level> mips =
+                    generator.generate(base.pixels.data(), width, height, channels, 8);
+                levels.push_back(std::move(base));
+                for (MipmapGenerator::Level &mip : mips)
+                {
+                    levels.push_back(UploadScheduler::Level{mip.width, mip.height, std::move(mip.data)});
+                }
+            }
+            // also after a failed decode, which can stop halfway through its allocations
+            ImageArena::local().reset();
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto it = m_entries.find(handle);
+            if (it != m_entries.end())
+            {
+                Entry &entry = it->second;
+                if (levels.empty())
+                {
+                    // nothing will be submitted, so the scheduler would keep the handle forever
+                    entry.state = FAILED;
+                    m_scheduler.cancel(handle);
+                }
+                else
+                {
+                    const GLenum formats[] = {GL_RED, GL_RG, GL_RGB, GL_RGBA};
+                    const GLenum linear[] = {GL_R8, GL_RG8, GL_RGB8, GL_RGBA8};
+                    const GLenum gamma[] = {GL_R8, GL_RG8, GL_SRGB8, GL_SRGB8_ALPHA8};
+                    entry.state = UPLOADING;
+                    entry.width = width;
+                    entry.height = height;
+                    entry.levels = static_cast<int>(levels.size());
+                    entry.format = formats[channels - 1];
+                    entry.internalFormat = options.srgb ? gamma[channels - 1] : linear[channels - 1];
+                    m_scheduler.submit(handle, channels, std::move(levels), priority);
+                }
+            }
+            m_decoding--;
+            m_idle.notify_all();
+        });
+    return handle;
+}
+
+void TextureStreamer::setPriority(uint32_t handle, float priority)
+{
+    m_scheduler.setPriority(handle, priority);
+}
+
+void TextureStreamer::cancel(uint32_t handle)
+{
+    m_scheduler.cancel(handle);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_entries.erase(handle);
+}
+
+TextureStreamer::State TextureStreamer::state(uint32_t handle) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_entries.find(handle);
+    return it == m_entries.end() ? FAILED : it->second.state;
+}
+
+void TextureStreamer::update()
+{
+    m_scheduler.process([this](const UploadScheduler::Chunk &chunk)
+                        { upload(chunk); });
+}
+
+void TextureStreamer::upload(const UploadScheduler::Chunk &chunk)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_entries.find(chunk.handle);
+    if (it == m_entries.end())
+    {
+        return;
+    }
+    Entry &entry = it->second;
+    Texture2D &texture = *entry.texture;
+    if (chunk.firstOfTexture)
+    {
+        texture.create(entry.width, entry.height, entry.internalFormat, entry.levels);
+        texture.setBaseLevel(entry.levels - 1);
+    }
+    texture.uploadRows(chunk.level, chunk.y, chunk.rows, entry.format, GL_UNSIGNED_BYTE, chunk.pixels);
+    if (chunk.levelComplete)
+    {
+        texture.setBaseLevel(chunk.level);
+    }
+    if (chunk.textureComplete)
+    {
+        entry.state = COMPLETE;
+    }
+}
+
+const UploadScheduler::Stats &TextureStreamer::stats() const
+{
+    return m_scheduler.stats();
+}
+
+UploadScheduler &TextureStreamer::scheduler()
+{
+    return m_scheduler;
+}
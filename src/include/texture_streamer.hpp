@@ -0,0 +1,71 @@
+#ifndef TEXTURE_STREAMER_HPP
+#define TEXTURE_STREAMER_HPP
+
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <unordered_map>
+
+#include "texture.hpp"
+#include "upload_scheduler.hpp"
+
+// Loads textures without stalling the render loop: decoding and mip generation
+// run on ThreadPool::shared(), the GL upload is spread over frames by an
+// UploadScheduler. Until its finest level arrives a texture samples the levels
+// that are already there (GL_TEXTURE_BASE_LEVEL follows the upload).
+class TextureStreamer
+{
+public:
+    enum State
+    {
+        DECODING,
+        UPLOADING,
+        COMPLETE,
+        FAILED,
+    };
+
+    TextureStreamer();
+    explicit TextureStreamer(const UploadScheduler::Settings &settings);
+    ~TextureStreamer();
+
+    TextureStreamer(const TextureStreamer &) = delete;
+    TextureStreamer &operator=(const TextureStreamer &) = delete;
+
+    // texture is (re)created on the GL thread when its first chunk goes out and must
+    // outlive the stream (or be cancelled first). Its sampler is left as is.
+    uint32_t load(Texture2D &texture, const std::filesystem::path &path, float priority,
+                  const TextureLoadOptions &options = TextureLoadOptions{});
+    // see UploadScheduler::screenPriority
+    void setPriority(uint32_t handle, float priority);
+    void cancel(uint32_t handle);
+    State state(uint32_t handle) const;
+
+    // once per frame, on the thread owning the GL context
+    void update();
+
+    const UploadScheduler::Stats &stats() const;
+    UploadScheduler &scheduler();
+
+private:
+    struct Entry
+    {
+        Texture2D *texture;
+        State state;
+        int width;
+        int height;
+        int levels;
+        GLenum internalFormat;
+        GLenum format;
+    };
+
+    void upload(const UploadScheduler::Chunk &chunk);
+    // vars
+    UploadScheduler m_scheduler;
+    mutable std::mutex m_mutex;
+    std::condition_variable m_idle;
+    std::unordered_map<uint32_t, Entry> m_entries;
+    int m_decoding;
+};
+
+#endif // TEXTURE_STREAMER_HPP
@@ -0,0 +1,118 @@
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+ThreadPool::ThreadPool(unsigned int threadCount) : m_stopping{false}
+{
+    threadCount = std::max(1u, threadCount);
+    m_workers.reserve(threadCount);
+    for (unsigned int i = 0; i < threadCount; i++)
+    {
+        m_workers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+    for (std::thread &worker : m_workers)
+    {
+        worker.join();
+    }
+}
+
+void ThreadPool::enqueue(std::function<void()> job)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_jobs.push_back(std::move(job));
+    }
+    m_wake.notify_one();
+}
+
+void ThreadPool::parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)> &fn)
+{
+    if (count == 0)
+    {
+        return;
+    }
+    grain = std::max<size_t>(1, grain);
+    size_t chunks = (count + grain - 1) / grain;
+    if (chunks == 1)
+    {
+        fn(0, count);
+        return;
+    }
+
+    struct Batch
+    {
+        std::atomic<size_t> next{0};
+        std::atomic<size_t> done{0};
+        std::mutex mutex;
+        std::condition_variable finished;
+    };
+    auto batch = std::make_shared<Batch>();
+
+    // fn stays alive until every chunk is done because the caller blocks below
+    auto drain = [batch, chunks, count, grain, &fn]()
+    {
+        size_t chunk;
+        while ((chunk = batch->next.fetch_add(1)) < chunks)
+        {
+            size_t begin = chunk * grain;
+            fn(begin, std::min(count, begin + grain));
+            if (batch->done.fetch_add(1) + 1 == chunks)
+            {
+                std::lock_guard<std::mutex> lock(batch->mutex);
+                batch->finished.notify_all();
+            }
+        }
+    };
+
+    size_t helpers = std::min<size_t>(m_workers.size(), chunks - 1);
+    for (size_t i = 0; i < helpers; i++)
+    {
+        enqueue(drain);
+    }
+    drain();
+
+    std::unique_lock<std::mutex> lock(batch->mutex);
+    batch->finished.wait(lock, [&]
+                         { return batch->done.load() == chunks; });
+}
+
+unsigned int ThreadPool::threadCount() const
+{
+    return static_cast<unsigned int>(m_workers.size());
+}
+
+ThreadPool &ThreadPool::shared()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+void ThreadPool::workerLoop()
+{
+    while (true)
+    {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [this]
+                        { return m_stopping || !m_jobs.empty(); });
+            if (m_jobs.empty())
+            {
+                return;
+            }
+            job = std::move(m_jobs.front());
+            m_jobs.pop_front();
+        }
+        job();
+    }
+}
@@ -0,0 +1,42 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of worker threads fed from a single job queue.
+// parallelFor lets the calling thread work on chunks as well, so it is safe to
+// call from inside a job (or from a loader thread that is itself a pool worker).
+class ThreadPool
+{
+public:
+    explicit ThreadPool(unsigned int threadCount = std::thread::hardware_concurrency());
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    void enqueue(std::function<void()> job);
+    // calls fn(begin, end) for consecutive ranges of at most grain items covering [0, count)
+    void parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)> &fn);
+    unsigned int threadCount() const;
+
+    // process wide pool, created on first use
+    static ThreadPool &shared();
+
+private:
+    void workerLoop();
+    // vars
+    std::vector<std::thread> m_workers;
+    std::deque<std::function<void()>> m_jobs;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    bool m_stopping;
+};
+
+#endif // THREAD_POOL_HPP
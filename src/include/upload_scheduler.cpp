@@ -0,0 +1,220 @@
+#include "upload_scheduler.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+UploadScheduler::UploadScheduler() : UploadScheduler(Settings{}) {};
+
+UploadScheduler::UploadScheduler(const Settings &settings) : m_settings(settings), m_nextHandle{1} {};
+
+uint32_t UploadScheduler::createHandle()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    uint32_t handle = m_nextHandle++;
+    m_handles.emplace(handle, false);
+    return handle;
+}
+
+void UploadScheduler::submit(uint32_t handle, int bytesPerTexel, std::vector<Level> levels, float priority)
+{
+    if (levels.empty())
+    {
+        return;
+    }
+    auto job = std::make_unique<Job>();
+    job->handle = handle;
+    job->bytesPerTexel = bytesPerTexel;
+    job->priority = priority;
+    job->levels = std::move(levels);
+    job->level = static_cast<int>(job->levels.size()) - 1;
+    job->row = 0;
+    job->started = false;
+    job->remainingBytes = 0;
+    for (const Level &level : job->levels)
+    {
+        job->remainingBytes += static_cast<size_t>(level.width) * level.height * bytesPerTexel;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_handles.find(handle);
+    if (it == m_handles.end() || it->second)
+    {
+        return;
+    }
+    it->second = true;
+    // a setPriority that raced ahead of the submit wins
+    m_priorities.emplace(handle, priority);
+    m_incoming.push_back(std::move(job));
+}
+
+void UploadScheduler::setPriority(uint32_t handle, float priority)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_handles.count(handle) != 0)
+    {
+        m_priorities[handle] = priority;
+    }
+}
+
+void UploadScheduler::cancel(uint32_t handle)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_handles.find(handle);
+    if (it == m_handles.end())
+    {
+        return;
+    }
+    // not submitted yet: forgetting the handle is enough, its submit will be ignored
+    if (it->second)
+    {
+        m_cancelled.insert(handle);
+    }
+    m_handles.erase(it);
+    m_priorities.erase(handle);
+}
+
+void UploadScheduler::collectSubmissions()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (std::unique_ptr<Job> &job : m_incoming)
+    {
+        m_jobs.push_back(std::move(job));
+    }
+    m_incoming.clear();
+
+    auto cancelled = [this](const std::unique_ptr<Job> &job)
+    {
+        return m_cancelled.erase(job->handle) != 0;
+    };
+    m_jobs.erase(std::remove_if(m_jobs.begin(), m_jobs.end(), cancelled), m_jobs.end());
+
+    for (std::unique_ptr<Job> &job : m_jobs)
+    {
+        job->priority = m_priorities[job->handle];
+    }
+}
+
+void UploadScheduler::process(const std::function<void(const Chunk &)> &upload)
+{
+    using Clock = std::chrono::steady_clock;
+    auto start = Clock::now();
+    collectSubmissions();
+    // stable, so equal priorities keep submission order
+    std::stable_sort(m_jobs.begin(), m_jobs.end(),
+                     [](const std::unique_ptr<Job> &a, const std::unique_ptr<Job> &b)
+                     { return a->priority > b->priority; });
+
+    m_stats.frameBytes = 0;
+    m_stats.frameChunks = 0;
+    size_t finished = 0;
+    double elapsed = 0.0;
+    for (std::unique_ptr<Job> &job : m_jobs)
+    {
+        bool budgetLeft = true;
+        while (job->level >= 0)
+        {
+            const Level &level = job->levels[job->level];
+            size_t rowBytes = static_cast<size_t>(level.width) * job->bytesPerTexel;
+            size_t rowsPerChunk = std::max<size_t>(1, m_settings.chunkBytes / std::max<size_t>(1, rowBytes));
+            int rows = static_cast<int>(std::min<size_t>(rowsPerChunk, level.height - job->row));
+            size_t bytes = rowBytes * rows;
+            if (m_stats.frameChunks > 0 &&
+                (m_stats.frameBytes + bytes > m_settings.bytesPerFrame || elapsed >= m_settings.millisecondsPerFrame))
+            {
+                budgetLeft = false;
+                break;
+            }
+
+            Chunk chunk;
+            chunk.handle = job->handle;
+            chunk.level = job->level;
+            chunk.y = job->row;
+            chunk.rows = rows;
+            chunk.width = level.width;
+            chunk.pixels = level.pixels.data() + rowBytes * job->row;
+            chunk.bytes = bytes;
+            chunk.firstOfTexture = !job->started;
+            chunk.levelComplete = job->row + rows == level.height;
+            chunk.textureComplete = chunk.levelComplete && job->level == 0;
+            upload(chunk);
+
+            job->started = true;
+            job->row += rows;
+            job->remainingBytes -= bytes;
+            if (chunk.levelComplete)
+            {
+                // nothing reads the finished level again
+                std::vector<unsigned char>().swap(job->levels[job->level].pixels);
+                job->level--;
+                job->row = 0;
+            }
+            m_stats.frameBytes += bytes;
+            m_stats.frameChunks++;
+            elapsed = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        }
+        if (job->level < 0)
+        {
+            finished++;
+        }
+        if (!budgetLeft)
+        {
+            break;
+        }
+    }
+
+    if (finished > 0)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto done = [this](const std::unique_ptr<Job> &job)
+        {
+            if (job->level >= 0)
+            {
+                return false;
+            }
+            m_handles.erase(job->handle);
+            m_priorities.erase(job->handle);
+            m_cancelled.erase(job->handle);
+            return true;
+        };
+        m_jobs.erase(std::remove_if(m_jobs.begin(), m_jobs.end(), done), m_jobs.end());
+    }
+
+    m_stats.queuedTextures = m_jobs.size();
+    m_stats.queuedBytes = 0;
+    for (const std::unique_ptr<Job> &job : m_jobs)
+    {
+        m_stats.queuedBytes += job->remainingBytes;
+    }
+    m_stats.frameMilliseconds = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    m_stats.maxFrameMilliseconds = std::max(m_stats.maxFrameMilliseconds, m_stats.frameMilliseconds);
+    m_stats.totalBytes += m_stats.frameBytes;
+    m_stats.totalChunks += m_stats.frameChunks;
+    m_stats.completedTextures += finished;
+}
+
+const UploadScheduler::Stats &UploadScheduler::stats() const
+{
+    return m_stats;
+}
+
+const UploadScheduler::Settings &UploadScheduler::settings() const
+{
+    return m_settings;
+}
+
+void UploadScheduler::setSettings(const Settings &settings)
+{
+    m_settings = settings;
+}
+
+float UploadScheduler::screenPriority(float radius, float distance, float fovY, int viewportHeight)
+{
+    // inside the sphere it covers the whole screen
+    if (distance <= radius)
+    {
+        return static_cast<float>(viewportHeight);
+    }
+    float projected = radius / (distance * std::tan(fovY * 0.5f)) * viewportHeight;
+    return std::min(projected, static_cast<float>(viewportHeight));
+}
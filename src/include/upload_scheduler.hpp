@@ -0,0 +1,127 @@
+#ifndef UPLOAD_SCHEDULER_HPP
+#define UPLOAD_SCHEDULER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Spreads texture uploads over frames. Each submitted texture is cut into chunks,
+// one band of rows of one mip level, and every call to process() hands out chunks
+// in priority order until the frame's byte or time budget is used up, so a big
+// texture arriving mid-frame costs a few milliseconds per frame instead of one
+// long stall. Levels go out coarsest first, which lets the texture be sampled
+// (blurry) after the first few kilobytes.
+//
+// Nothing in here touches GL: process() calls back into the code doing the actual
+// glTexSubImage2D (see TextureStreamer), which keeps the scheduling measurable
+// from a plain executable.
+class UploadScheduler
+{
+public:
+    struct Settings
+    {
+        size_t bytesPerFrame = 8u << 20;
+        double millisecondsPerFrame = 2.0;
+        size_t chunkBytes = 256u << 10; // target size of one sub-rectangle
+    };
+
+    struct Level
+    {
+        int width;
+        int height;
+        std::vector<unsigned char> pixels; // tightly packed rows
+    };
+
+    struct Chunk
+    {
+        uint32_t handle;
+        int level;
+        int y;
+        int rows;
+        int width;
+        const unsigned char *pixels; // first texel of row y, valid during the callback
+        size_t bytes;
+        bool firstOfTexture; // the first chunk handed out for this handle
+        bool levelComplete;  // the last rows of `level`
+        bool textureComplete;
+    };
+
+    struct Stats
+    {
+        size_t queuedTextures = 0; // submitted and not fully uploaded
+        size_t queuedBytes = 0;
+        size_t frameBytes = 0; // during the last process()
+        int frameChunks = 0;
+        double frameMilliseconds = 0.0;
+        double maxFrameMilliseconds = 0.0;
+        uint64_t totalBytes = 0;
+        uint64_t totalChunks = 0;
+        uint64_t completedTextures = 0;
+    };
+
+    UploadScheduler();
+    explicit UploadScheduler(const Settings &settings);
+
+    UploadScheduler(const UploadScheduler &) = delete;
+    UploadScheduler &operator=(const UploadScheduler &) = delete;
+
+    // handles are never reused; allocating one up front lets a loader thread submit later.
+    // The scheduler remembers a handle until its upload completes or it is cancelled.
+    uint32_t createHandle();
+    // levels[0] is the full size image. Can be called from any thread. Ignored for handles
+    // that were cancelled or not made by createHandle.
+    void submit(uint32_t handle, int bytesPerTexel, std::vector<Level> levels, float priority);
+    // higher uploads first. Works before the submit for the handle arrives, does nothing
+    // once the texture is complete.
+    void setPriority(uint32_t handle, float priority);
+    // drops whatever has not been uploaded yet, also works before the submit arrives;
+    // does nothing once the texture is complete
+    void cancel(uint32_t handle);
+
+    // Calls upload for chunks until the budget is spent; at least one chunk goes out
+    // whenever anything is queued, so a tiny budget still makes progress.
+    // Call from the thread owning the GL context.
+    void process(const std::function<void(const Chunk &)> &upload);
+
+    const Stats &stats() const;
+    const Settings &settings() const;
+    void setSettings(const Settings &settings);
+
+    // On-screen height in pixels of a bounding sphere, the usual priority: what covers
+    // more of the screen gets its detail first, far away objects wait.
+    static float screenPriority(float radius, float distance, float fovY, int viewportHeight);
+
+private:
+    struct Job
+    {
+        uint32_t handle;
+        int bytesPerTexel;
+        float priority;
+        std::vector<Level> levels;
+        int level; // level being uploaded, counts down to 0
+        int row;
+        bool started;
+        size_t remainingBytes;
+    };
+
+    void collectSubmissions();
+    // vars
+    Settings m_settings;
+    std::mutex m_mutex; // guards everything up to m_jobs
+    uint32_t m_nextHandle;
+    // handles neither complete nor cancelled, true once submitted
+    std::unordered_map<uint32_t, bool> m_handles;
+    std::vector<std::unique_ptr<Job>> m_incoming;
+    std::unordered_map<uint32_t, float> m_priorities;
+    // submitted jobs to drop on the next process(), only ever holds live handles
+    std::unordered_set<uint32_t> m_cancelled;
+    std::vector<std::unique_ptr<Job>> m_jobs; // only touched by process()
+    Stats m_stats;
+};
+
+#endif // UPLOAD_SCHEDULER_HPP
@@ -6,6 +6,44 @@
 #include <string>
 #include <stdexcept>
 #include <filesystem>
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+#include <vector>
+
+#include "gl_extensions.hpp"
+#include "image_encode.hpp"
+
+// The examples render into a GLFW window, or headless when LEARNOPENGL_CONTEXT is "egl"
+// or "osmesa", for machines without a display or GPU (Mesa's llvmpipe is enough).
+// Headless, GLFW runs on its null platform (GLFW 3.4) and creates the context through EGL
+// or OSMesa. The scene is drawn into an offscreen framebuffer bound in place of the
+// default one, which a surfaceless context does not have. endFrame() then skips swapping
+// and polling, and closes the window after LEARNOPENGL_FRAMES frames (default 1).
+// For reproducible frames LEARNOPENGL_FPS fixes the timestep frameTime() advances by,
+// and LEARNOPENGL_CAPTURE names a directory each finished frame is written to as
+// frame_NNNNN.png, which is what the golden image checks compare.
+enum class ContextBackend
+{
+    WINDOW,
+    EGL,
+    OSMESA
+};
+
+struct HeadlessTarget
+{
+    ContextBackend backend = ContextBackend::WINDOW;
+    GLuint framebuffer = 0;
+    GLuint color = 0;
+    GLuint depth = 0;
+    int width = 0;
+    int height = 0;
+    long frames = 0;
+    long frameLimit = 1;
+    double fps = 0.0; // fixed timestep when positive
+    std::filesystem::path capture;
+};
+HeadlessTarget gHeadless;
 
 std::string getEnvVar(const std::string &key)
 {
@@ -26,8 +64,79 @@ void glfw_onKey(GLFWwindow *window, int key, int scancode, int action, int mode)
     if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
         glfwSetWindowShouldClose(window, GL_TRUE);
 }
-bool initOpengl(GLFWwindow *&gWindow, int width, int height)
+ContextBackend requestedBackend()
 {
+    const char *name = std::getenv("LEARNOPENGL_CONTEXT");
+    if (name == nullptr || std::string(name) == "window")
+    {
+        return ContextBackend::WINDOW;
+    }
+    if (std::string(name) == "egl")
+    {
+        return ContextBackend::EGL;
+    }
+    if (std::string(name) == "osmesa")
+    {
+        return ContextBackend::OSMESA;
+    }
+    std::cerr << "Unknown LEARNOPENGL_CONTEXT " << name << ", opening a window" << std::endl;
+    return ContextBackend::WINDOW;
+}
+
+// colour and depth/stencil renderbuffers of the window's size, bound for drawing and reading
+bool createHeadlessTarget(int width, int height)
+{
+    glGenRenderbuffers(1, &gHeadless.color);
+    glBindRenderbuffer(GL_RENDERBUFFER, gHeadless.color);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    gHeadless.width = width;
+    gHeadless.height = height;
+    glGenRenderbuffers(1, &gHeadless.depth);
+    glBindRenderbuffer(GL_RENDERBUFFER, gHeadless.depth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &gHeadless.framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, gHeadless.framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, gHeadless.color);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, gHeadless.depth);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        std::cerr << "Headless framebuffer is incomplete" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// backend overrides LEARNOPENGL_CONTEXT, for tools that choose it themselves
+bool initOpengl(GLFWwindow *&gWindow, int width, int height, ContextBackend backend)
+{
+    gHeadless.backend = backend;
+    bool headless = gHeadless.backend != ContextBackend::WINDOW;
+    if (headless)
+    {
+        if (const char *frames = std::getenv("LEARNOPENGL_FRAMES"))
+        {
+            gHeadless.frameLimit = std::max(1L, std::strtol(frames, nullptr, 10));
+        }
+        if (const char *fps = std::getenv("LEARNOPENGL_FPS"))
+        {
+            gHeadless.fps = std::strtod(fps, nullptr);
+        }
+        if (const char *capture = std::getenv("LEARNOPENGL_CAPTURE"))
+        {
+            gHeadless.capture = capture;
+            std::filesystem::create_directories(gHeadless.capture);
+        }
+#ifdef GLFW_PLATFORM_NULL
+        // no display server: windows are plain bookkeeping
+        glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+#else
+        // older GLFW would open a real window, or fail somewhere less obvious without a display
+        std::cerr << "headless needs GLFW >= 3.4" << std::endl;
+        return false;
+#endif
+    }
     if (!glfwInit())
     {
         // An error occured
@@ -40,6 +149,13 @@ bool initOpengl(GLFWwindow *&gWindow, int width, int height)
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE); // forward compatible with newer versions of OpenGL as they become available but not backward compatible (it will not run on devices that do not support OpenGL 3.3
 
+    if (headless)
+    {
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        glfwWindowHint(GLFW_CONTEXT_CREATION_API,
+                       gHeadless.backend == ContextBackend::EGL ? GLFW_EGL_CONTEXT_API : GLFW_OSMESA_CONTEXT_API);
+    }
+
     gWindow = glfwCreateWindow(width, height, "OpenGL", NULL, NULL);
     if (gWindow == NULL)
     {
@@ -55,6 +171,11 @@ bool initOpengl(GLFWwindow *&gWindow, int width, int height)
         std::cout << "Failed to initialise GLAD" << std::endl;
         return false;
     }
+    glext::load((GLADloadproc)glfwGetProcAddress);
+    if (headless && !createHeadlessTarget(width, height))
+    {
+        return false;
+    }
     // Set the required callback functions
     glfwSetKeyCallback(gWindow, glfw_onKey);
     glfwSetFramebufferSizeCallback(gWindow, framebuffer_size_callback);
@@ -70,3 +191,55 @@ bool initOpengl(GLFWwindow *&gWindow, int width, int height)
 
     return true;
 }
+
+bool initOpengl(GLFWwindow *&gWindow, int width, int height)
+{
+    return initOpengl(gWindow, width, height, requestedBackend());
+}
+
+// Seconds since start for animation: the wall clock, or frames / LEARNOPENGL_FPS headless
+// so the same frame always shows the same moment.
+double frameTime()
+{
+    if (gHeadless.backend != ContextBackend::WINDOW && gHeadless.fps > 0.0)
+    {
+        return gHeadless.frames / gHeadless.fps;
+    }
+    return glfwGetTime();
+}
+
+// the finished headless frame as a bottom-up PNG in the capture directory
+void captureFrame()
+{
+    std::vector<unsigned char> rgba(static_cast<size_t>(gHeadless.width) * gHeadless.height * 4);
+    GLint previous = 0;
+    glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previous);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, gHeadless.framebuffer);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, gHeadless.width, gHeadless.height, GL_RGBA, GL_UNSIGNED_BYTE, rgba.data());
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, static_cast<GLuint>(previous));
+    std::ostringstream name;
+    name << "frame_" << std::setw(5) << std::setfill('0') << gHeadless.frames << ".png";
+    writePng(gHeadless.capture / name.str(), rgba.data(), gHeadless.width, gHeadless.height, true);
+}
+
+// Shows the frame and handles input. Headless there is nothing to show: the frame is
+// finished (so timing it means something), captured if asked, and counted instead.
+void endFrame(GLFWwindow *window)
+{
+    if (gHeadless.backend == ContextBackend::WINDOW)
+    {
+        glfwSwapBuffers(window);
+        glfwPollEvents();
+        return;
+    }
+    glFinish();
+    if (!gHeadless.capture.empty())
+    {
+        captureFrame();
+    }
+    if (++gHeadless.frames >= gHeadless.frameLimit)
+    {
+        glfwSetWindowShouldClose(window, GL_TRUE);
+    }
+}
@@ -0,0 +1,136 @@
+#include "vertex_format.hpp"
+#include "gl_extensions.hpp"
+
+namespace
+{
+    // the only buffer binding point the cache uses
+    const GLuint BINDING = 0;
+} // namespace
+
+mesh::VertexArrayCache::~VertexArrayCache()
+{
+    clear();
+}
+
+void mesh::VertexArrayCache::bind(const VertexLayout &layout, GLuint vertexBuffer, GLuint indexBuffer,
+                                  size_t baseOffset)
+{
+    bind(layout, layoutHash(layout), vertexBuffer, indexBuffer, baseOffset);
+}
+
+void mesh::VertexArrayCache::bind(const VertexLayout &layout, uint64_t hash, GLuint vertexBuffer, GLuint indexBuffer,
+                                  size_t baseOffset)
+{
+    bind(layout.attributes.data(), layout.attributes.size(), layout.stride, hash, vertexBuffer, indexBuffer,
+         baseOffset);
+}
+
+void mesh::VertexArrayCache::bind(const VertexAttribute *attributes, size_t count, GLsizei stride, uint64_t hash,
+                                  GLuint vertexBuffer, GLuint indexBuffer, size_t baseOffset)
+{
+    const glext::Extensions &ext = glext::get();
+    ArrayKey key{hash};
+    if (!ext.separateVertexFormat)
+    {
+        key.vertexBuffer = vertexBuffer;
+        key.baseOffset = baseOffset;
+    }
+
+    Binding &binding = m_arrays[key];
+    if (binding.vao == 0)
+    {
+        glGenVertexArrays(1, &binding.vao);
+        glBindVertexArray(binding.vao);
+        if (ext.separateVertexFormat)
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                const VertexAttribute &a = attributes[i];
+                if (a.integer)
+                {
+                    ext.vertexAttribIFormat(a.location, a.components, a.type, a.offset);
+                }
+                else
+                {
+                    ext.vertexAttribFormat(a.location, a.components, a.type, a.normalized, a.offset);
+                }
+                ext.vertexAttribBinding(a.location, BINDING);
+                glEnableVertexAttribArray(a.location);
+            }
+        }
+        else
+        {
+            glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+            VertexLayout{stride, std::vector<VertexAttribute>(attributes, attributes + count)}.apply(baseOffset);
+            binding.vertexBuffer = vertexBuffer;
+            binding.baseOffset = baseOffset;
+        }
+        m_bound = binding.vao;
+    }
+    else if (m_bound != binding.vao)
+    {
+        glBindVertexArray(binding.vao);
+        m_bound = binding.vao;
+    }
+
+    if (ext.separateVertexFormat && (binding.vertexBuffer != vertexBuffer || binding.baseOffset != baseOffset))
+    {
+        ext.bindVertexBuffer(BINDING, vertexBuffer, static_cast<GLintptr>(baseOffset), stride);
+        binding.vertexBuffer = vertexBuffer;
+        binding.baseOffset = baseOffset;
+    }
+    // the element array is VAO state, a shared VAO keeps whichever was bound last
+    if (binding.indexBuffer != indexBuffer)
+    {
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+        binding.indexBuffer = indexBuffer;
+    }
+}
+
+void mesh::VertexArrayCache::release(GLuint buffer)
+{
+    bool perBuffer = !glext::get().separateVertexFormat;
+    for (auto it = m_arrays.begin(); it != m_arrays.end();)
+    {
+        Binding &binding = it->second;
+        if (perBuffer && binding.vertexBuffer == buffer)
+        {
+            if (m_bound == binding.vao)
+            {
+                m_bound = 0;
+            }
+            glDeleteVertexArrays(1, &binding.vao);
+            it = m_arrays.erase(it);
+            continue;
+        }
+        if (binding.vertexBuffer == buffer)
+        {
+            binding.vertexBuffer = 0;
+        }
+        if (binding.indexBuffer == buffer)
+        {
+            binding.indexBuffer = 0;
+        }
+        ++it;
+    }
+}
+
+void mesh::VertexArrayCache::invalidate()
+{
+    m_bound = 0;
+}
+
+void mesh::VertexArrayCache::clear()
+{
+    for (auto &entry : m_arrays)
+    {
+        glDeleteVertexArrays(1, &entry.second.vao);
+    }
+    m_arrays.clear();
+    m_bound = 0;
+}
+
+size_t mesh::VertexArrayCache::size() const
+{
+    return m_arrays.size();
+}
@@ -0,0 +1,269 @@
+#ifndef VERTEX_FORMAT_HPP
+#define VERTEX_FORMAT_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <tuple>
+#include <type_traits>
+#include <glad/glad.h>
+
+#include "vertex_quantize.hpp"
+
+// Vertex layouts declared by the vertex struct itself instead of hand written strides and
+// offsets. A vertex lists its attributes in a constexpr function, where the struct is
+// complete and offsetof works:
+//
+//   struct TexturedVertex
+//   {
+//       float position[3];
+//       float uv[2];
+//
+//       static constexpr std::array<mesh::VertexAttribute, 2> attributes()
+//       {
+//           return {mesh::attribute<decltype(position)>(0, offsetof(TexturedVertex, position)),
+//                   mesh::attribute<decltype(uv)>(2, offsetof(TexturedVertex, uv))};
+//       }
+//   };
+//
+// VertexFormat<TexturedVertex> then holds the stride, the attributes and a layout hash as
+// compile time constants, and rejects overlapping attributes, attributes past the end of
+// the struct and repeated locations with a static_assert. Members can be float, integer
+// or glm style vectors (anything with value_type and a static length()), or arrays of those
+// scalars; integer members are read as normalised floats unless integer is set.
+namespace mesh
+{
+    template <typename T, typename = void>
+    struct AttributeTraits
+    {
+    };
+
+    template <typename T>
+    struct ScalarTraits
+    {
+    };
+    template <>
+    struct ScalarTraits<float>
+    {
+        static constexpr GLenum type = GL_FLOAT;
+    };
+    template <>
+    struct ScalarTraits<int8_t>
+    {
+        static constexpr GLenum type = GL_BYTE;
+    };
+    template <>
+    struct ScalarTraits<uint8_t>
+    {
+        static constexpr GLenum type = GL_UNSIGNED_BYTE;
+    };
+    template <>
+    struct ScalarTraits<int16_t>
+    {
+        static constexpr GLenum type = GL_SHORT;
+    };
+    template <>
+    struct ScalarTraits<uint16_t>
+    {
+        static constexpr GLenum type = GL_UNSIGNED_SHORT;
+    };
+    template <>
+    struct ScalarTraits<int32_t>
+    {
+        static constexpr GLenum type = GL_INT;
+    };
+    template <>
+    struct ScalarTraits<uint32_t>
+    {
+        static constexpr GLenum type = GL_UNSIGNED_INT;
+    };
+
+    template <typename T>
+    struct AttributeTraits<T, std::void_t<decltype(ScalarTraits<T>::type)>>
+    {
+        static constexpr GLint components = 1;
+        static constexpr GLenum type = ScalarTraits<T>::type;
+    };
+    template <typename T, size_t N>
+    struct AttributeTraits<T[N], std::void_t<decltype(ScalarTraits<T>::type)>>
+    {
+        static_assert(N >= 1 && N <= 4, "vertex attributes have 1 to 4 components");
+        static constexpr GLint components = static_cast<GLint>(N);
+        static constexpr GLenum type = ScalarTraits<T>::type;
+    };
+    template <typename T>
+    struct AttributeTraits<T, std::void_t<typename T::value_type, decltype(T::length())>>
+    {
+        static_assert(T::length() >= 1 && T::length() <= 4, "vertex attributes have 1 to 4 components");
+        static constexpr GLint components = static_cast<GLint>(T::length());
+        static constexpr GLenum type = ScalarTraits<typename T::value_type>::type;
+    };
+
+    // one attribute of member type T at offset bytes into the vertex
+    template <typename T>
+    constexpr VertexAttribute attribute(GLuint location, size_t offset, bool integer = false)
+    {
+        using Traits = AttributeTraits<std::remove_cv_t<T>>;
+        return VertexAttribute{location,
+                               Traits::components,
+                               Traits::type,
+                               static_cast<GLboolean>(Traits::type != GL_FLOAT && !integer ? GL_TRUE : GL_FALSE),
+                               integer,
+                               static_cast<GLuint>(offset)};
+    }
+
+    constexpr size_t attributeTypeSize(GLenum type)
+    {
+        return type == GL_BYTE || type == GL_UNSIGNED_BYTE ? 1
+               : type == GL_SHORT || type == GL_UNSIGNED_SHORT || type == GL_HALF_FLOAT ? 2
+                                                                                        : 4;
+    }
+
+    constexpr size_t attributeSize(const VertexAttribute &a)
+    {
+        // packed formats hold all components in 4 bytes
+        return a.type == GL_INT_2_10_10_10_REV || a.type == GL_UNSIGNED_INT_2_10_10_10_REV
+                   ? 4
+                   : attributeTypeSize(a.type) * static_cast<size_t>(a.components);
+    }
+
+    // FNV-1a over everything that ends up in the VAO; the same for the compile time and
+    // the runtime description of a layout
+    constexpr uint64_t layoutHash(const VertexAttribute *attributes, size_t count, GLsizei stride)
+    {
+        uint64_t h = 14695981039346656037ull;
+        auto mix = [&h](uint64_t value)
+        {
+            for (int i = 0; i < 8; i++)
+            {
+                h = (h ^ ((value >> (i * 8)) & 0xff)) * 1099511628211ull;
+            }
+        };
+        mix(static_cast<uint64_t>(stride));
+        for (size_t i = 0; i < count; i++)
+        {
+            const VertexAttribute &a = attributes[i];
+            mix(a.location);
+            mix(static_cast<uint64_t>(a.components));
+            mix(a.type);
+            mix(a.normalized);
+            mix(a.integer);
+            mix(a.offset);
+        }
+        return h;
+    }
+
+    inline uint64_t layoutHash(const VertexLayout &layout)
+    {
+        return layoutHash(layout.attributes.data(), layout.attributes.size(), layout.stride);
+    }
+
+    // no attribute reaches past stride, overlaps another or shares its location
+    constexpr bool validLayout(const VertexAttribute *attributes, size_t count, size_t stride)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            const VertexAttribute &a = attributes[i];
+            if (a.offset + attributeSize(a) > stride)
+            {
+                return false;
+            }
+            for (size_t j = i + 1; j < count; j++)
+            {
+                const VertexAttribute &b = attributes[j];
+                if (a.location == b.location ||
+                    (a.offset < b.offset + attributeSize(b) && b.offset < a.offset + attributeSize(a)))
+                {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    template <typename Vertex>
+    struct VertexFormat
+    {
+        static constexpr auto attributes = Vertex::attributes();
+        static constexpr GLsizei stride = static_cast<GLsizei>(sizeof(Vertex));
+        static constexpr uint64_t hash = layoutHash(attributes.data(), attributes.size(), stride);
+        static_assert(validLayout(attributes.data(), attributes.size(), sizeof(Vertex)),
+                      "vertex attributes overlap, share a location or lie outside the vertex");
+
+        static VertexLayout layout()
+        {
+            return VertexLayout{stride, std::vector<VertexAttribute>(attributes.begin(), attributes.end())};
+        }
+    };
+
+    // Shares one VAO between all buffers with the same layout. With GL 4.3 (or
+    // ARB_vertex_attrib_binding) a VAO only holds the format, set up once with
+    // glVertexAttribFormat, and bind() swaps the buffers in; older contexts get one VAO per
+    // layout and vertex buffer, set up with glVertexAttribPointer. Redundant binds are
+    // skipped either way, so draw loops can call bind() for every mesh.
+    class VertexArrayCache
+    {
+    public:
+        VertexArrayCache() {};
+        ~VertexArrayCache();
+        VertexArrayCache(const VertexArrayCache &) = delete;
+        VertexArrayCache &operator=(const VertexArrayCache &) = delete;
+
+        // binds a VAO reading layout from vertexBuffer, starting at baseOffset bytes, with
+        // indexBuffer (0 for none) as its element array
+        void bind(const VertexLayout &layout, GLuint vertexBuffer, GLuint indexBuffer, size_t baseOffset = 0);
+        void bind(const VertexLayout &layout, uint64_t hash, GLuint vertexBuffer, GLuint indexBuffer,
+                  size_t baseOffset = 0);
+
+        template <typename Vertex>
+        void bind(GLuint vertexBuffer, GLuint indexBuffer, size_t baseOffset = 0)
+        {
+            using Format = VertexFormat<Vertex>;
+            bind(Format::attributes.data(), Format::attributes.size(), Format::stride, Format::hash, vertexBuffer,
+                 indexBuffer, baseOffset);
+        }
+
+        // Drops what the cache knows about buffer: the VAOs built on it without separate
+        // vertex formats are deleted, shared ones rebind it next time. Call it before the
+        // buffer is deleted, or a new buffer reusing the name would hit the stale VAO.
+        void release(GLuint buffer);
+        // forget the bound VAO, for when other code has bound its own
+        void invalidate();
+        void clear();
+        size_t size() const;
+
+    private:
+        // the layout alone with separate vertex formats; without, the buffer and offset
+        // are baked into the VAO and belong to the key as well
+        struct ArrayKey
+        {
+            uint64_t layoutHash = 0;
+            GLuint vertexBuffer = 0;
+            size_t baseOffset = 0;
+
+            bool operator<(const ArrayKey &other) const
+            {
+                return std::tie(layoutHash, vertexBuffer, baseOffset) <
+                       std::tie(other.layoutHash, other.vertexBuffer, other.baseOffset);
+            }
+        };
+
+        struct Binding
+        {
+            GLuint vao = 0;
+            GLuint vertexBuffer = 0;
+            GLuint indexBuffer = 0;
+            size_t baseOffset = 0;
+        };
+
+        void bind(const VertexAttribute *attributes, size_t count, GLsizei stride, uint64_t hash,
+                  GLuint vertexBuffer, GLuint indexBuffer, size_t baseOffset);
+
+        // vars
+        std::map<ArrayKey, Binding> m_arrays;
+        GLuint m_bound = 0;
+    };
+} // namespace mesh
+
+#endif // VERTEX_FORMAT_HPP
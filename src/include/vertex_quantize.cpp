@@ -0,0 +1,368 @@
+#include "vertex_quantize.hpp"
+#include "hdr_pack.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    const float *streamAt(const float *base, size_t stride, size_t i)
+    {
+        return reinterpret_cast<const float *>(reinterpret_cast<const unsigned char *>(base) + stride * i);
+    }
+
+    uint16_t toUnorm16(float v)
+    {
+        return static_cast<uint16_t>(std::lround(std::clamp(v, 0.0f, 1.0f) * 65535.0f));
+    }
+
+    int16_t toSnorm16(float v)
+    {
+        return static_cast<int16_t>(std::lround(std::clamp(v, -1.0f, 1.0f) * 32767.0f));
+    }
+
+    // x, y, z as 10 bit snorm, w as 2 bit snorm (only -1, 0 and 1 exist)
+    uint32_t pack1010102(float x, float y, float z, float w)
+    {
+        auto field = [](float v, int bits)
+        {
+            int maximum = (1 << (bits - 1)) - 1;
+            int q = static_cast<int>(std::lround(std::clamp(v, -1.0f, 1.0f) * maximum));
+            return static_cast<uint32_t>(q) & ((1u << bits) - 1);
+        };
+        return field(x, 10) | field(y, 10) << 10 | field(z, 10) << 20 | field(w, 2) << 30;
+    }
+
+    float fromSnorm(int32_t value, int bits)
+    {
+        // GL 4.2+ conversion, older drivers use (2c + 1) / (2^b - 1) which is within half a step
+        return std::max(static_cast<float>(value) / static_cast<float>((1 << (bits - 1)) - 1), -1.0f);
+    }
+
+    int32_t signExtend(uint32_t value, int bits)
+    {
+        uint32_t sign = 1u << (bits - 1);
+        return static_cast<int32_t>((value ^ sign) - sign);
+    }
+
+    // appends the attribute at the end of the vertex, every attribute is 4 byte aligned
+    GLuint addAttribute(mesh::VertexLayout &layout, GLuint location, GLint components, GLenum type,
+                        GLboolean normalized, GLuint bytes)
+    {
+        GLuint offset = static_cast<GLuint>(layout.stride);
+        layout.attributes.push_back(mesh::VertexAttribute{location, components, type, normalized, false, offset});
+        layout.stride += static_cast<GLsizei>((bytes + 3) & ~3u);
+        return offset;
+    }
+
+    GLuint addDirection(mesh::VertexLayout &layout, mesh::QuantizeSettings::DirectionFormat format, GLuint location,
+                        bool tangent)
+    {
+        switch (format)
+        {
+        case mesh::QuantizeSettings::DIRECTION_OCT16:
+            // tangents carry their handedness in a third component
+            return tangent ? addAttribute(layout, location, 4, GL_SHORT, GL_TRUE, 8)
+                           : addAttribute(layout, location, 2, GL_SHORT, GL_TRUE, 4);
+        case mesh::QuantizeSettings::DIRECTION_10_10_10_2:
+            return addAttribute(layout, location, 4, GL_INT_2_10_10_10_REV, GL_TRUE, 4);
+        default:
+            return addAttribute(layout, location, tangent ? 4 : 3, GL_FLOAT, GL_FALSE, tangent ? 16 : 12);
+        }
+    }
+
+    void writeDirection(unsigned char *dst, mesh::QuantizeSettings::DirectionFormat format, const float *v, bool tangent)
+    {
+        float w = tangent ? (v[3] < 0.0f ? -1.0f : 1.0f) : 0.0f;
+        switch (format)
+        {
+        case mesh::QuantizeSettings::DIRECTION_OCT16:
+        {
+            float oct[2];
+            mesh::octEncode(v, oct);
+            int16_t packed[4] = {toSnorm16(oct[0]), toSnorm16(oct[1]), toSnorm16(w), 0};
+            std::memcpy(dst, packed, tangent ? 8 : 4);
+            break;
+        }
+        case mesh::QuantizeSettings::DIRECTION_10_10_10_2:
+        {
+            uint32_t packed = pack1010102(v[0], v[1], v[2], w);
+            std::memcpy(dst, &packed, 4);
+            break;
+        }
+        default:
+        {
+            float packed[4] = {v[0], v[1], v[2], w};
+            std::memcpy(dst, packed, tangent ? 16 : 12);
+            break;
+        }
+        }
+    }
+} // namespace
+
+void mesh::VertexLayout::apply(size_t baseOffset) const
+{
+    for (const VertexAttribute &attribute : attributes)
+    {
+        const void *pointer = reinterpret_cast<const void *>(baseOffset + attribute.offset);
+        if (attribute.integer)
+        {
+            glVertexAttribIPointer(attribute.location, attribute.components, attribute.type, stride, pointer);
+        }
+        else
+        {
+            glVertexAttribPointer(attribute.location, attribute.components, attribute.type, attribute.normalized,
+                                  stride, pointer);
+        }
+        glEnableVertexAttribArray(attribute.location);
+    }
+}
+
+mesh::QuantizedVertices mesh::quantizeVertices(const VertexStreams &streams, const QuantizeSettings &settings)
+{
+    QuantizedVertices result;
+    for (int k = 0; k < 3; k++)
+    {
+        result.positionScale[k] = 1.0f;
+        result.positionOffset[k] = 0.0f;
+    }
+    result.uvScale[0] = result.uvScale[1] = 1.0f;
+    result.uvOffset[0] = result.uvOffset[1] = 0.0f;
+    VertexLayout &layout = result.layout;
+
+    GLuint positionOffset = 0, normalOffset = 0, tangentOffset = 0, uvOffset = 0;
+    if (streams.positions)
+    {
+        switch (settings.position)
+        {
+        case QuantizeSettings::POSITION_UNORM16:
+            positionOffset = addAttribute(layout, settings.positionLocation, 4, GL_UNSIGNED_SHORT, GL_TRUE, 8);
+            break;
+        case QuantizeSettings::POSITION_HALF:
+            positionOffset = addAttribute(layout, settings.positionLocation, 4, GL_HALF_FLOAT, GL_FALSE, 8);
+            break;
+        default:
+            positionOffset = addAttribute(layout, settings.positionLocation, 3, GL_FLOAT, GL_FALSE, 12);
+            break;
+        }
+    }
+    if (streams.normals)
+    {
+        normalOffset = addDirection(layout, settings.normal, settings.normalLocation, false);
+    }
+    if (streams.uvs)
+    {
+        switch (settings.uv)
+        {
+        case QuantizeSettings::UV_UNORM16:
+            uvOffset = addAttribute(layout, settings.uvLocation, 2, GL_UNSIGNED_SHORT, GL_TRUE, 4);
+            break;
+        case QuantizeSettings::UV_HALF:
+            uvOffset = addAttribute(layout, settings.uvLocation, 2, GL_HALF_FLOAT, GL_FALSE, 4);
+            break;
+        default:
+            uvOffset = addAttribute(layout, settings.uvLocation, 2, GL_FLOAT, GL_FALSE, 8);
+            break;
+        }
+    }
+    if (streams.tangents)
+    {
+        tangentOffset = addDirection(layout, settings.tangent, settings.tangentLocation, true);
+    }
+
+    // bounds for the normalised formats
+    if (streams.positions && settings.position == QuantizeSettings::POSITION_UNORM16 && streams.count > 0)
+    {
+        float lo[3], hi[3];
+        const float *first = streams.positions;
+        std::copy(first, first + 3, lo);
+        std::copy(first, first + 3, hi);
+        for (size_t i = 1; i < streams.count; i++)
+        {
+            const float *p = streamAt(streams.positions, streams.positionStride, i);
+            for (int k = 0; k < 3; k++)
+            {
+                lo[k] = std::min(lo[k], p[k]);
+                hi[k] = std::max(hi[k], p[k]);
+            }
+        }
+        for (int k = 0; k < 3; k++)
+        {
+            result.positionOffset[k] = lo[k];
+            result.positionScale[k] = hi[k] > lo[k] ? hi[k] - lo[k] : 1.0f;
+        }
+    }
+    if (streams.uvs && settings.uv == QuantizeSettings::UV_UNORM16 && streams.count > 0)
+    {
+        float lo[2] = {0.0f, 0.0f}, hi[2] = {1.0f, 1.0f};
+        for (size_t i = 0; i < streams.count; i++)
+        {
+            const float *uv = streamAt(streams.uvs, streams.uvStride, i);
+            for (int k = 0; k < 2; k++)
+            {
+                lo[k] = std::min(lo[k], uv[k]);
+                hi[k] = std::max(hi[k], uv[k]);
+            }
+        }
+        // [0, 1] maps straight through, wider ranges (tiling) are remapped
+        for (int k = 0; k < 2; k++)
+        {
+            result.uvOffset[k] = lo[k];
+            result.uvScale[k] = hi[k] - lo[k];
+        }
+    }
+
+    result.data.assign(streams.count * layout.stride, 0);
+    for (size_t i = 0; i < streams.count; i++)
+    {
+        unsigned char *vertex = result.data.data() + i * layout.stride;
+        if (streams.positions)
+        {
+            const float *p = streamAt(streams.positions, streams.positionStride, i);
+            unsigned char *dst = vertex + positionOffset;
+            if (settings.position == QuantizeSettings::POSITION_UNORM16)
+            {
+                uint16_t packed[4] = {0, 0, 0, 65535};
+                for (int k = 0; k < 3; k++)
+                {
+                    packed[k] = toUnorm16((p[k] - result.positionOffset[k]) / result.positionScale[k]);
+                }
+                std::memcpy(dst, packed, 8);
+            }
+            else if (settings.position == QuantizeSettings::POSITION_HALF)
+            {
+                float padded[4] = {p[0], p[1], p[2], 1.0f};
+                uint16_t packed[4];
+                hdr::floatToHalf(padded, packed, 4);
+                std::memcpy(dst, packed, 8);
+            }
+            else
+            {
+                std::memcpy(dst, p, 12);
+            }
+        }
+        if (streams.normals)
+        {
+            writeDirection(vertex + normalOffset, settings.normal, streamAt(streams.normals, streams.normalStride, i),
+                           false);
+        }
+        if (streams.tangents)
+        {
+            writeDirection(vertex + tangentOffset, settings.tangent,
+                           streamAt(streams.tangents, streams.tangentStride, i), true);
+        }
+        if (streams.uvs)
+        {
+            const float *uv = streamAt(streams.uvs, streams.uvStride, i);
+            unsigned char *dst = vertex + uvOffset;
+            if (settings.uv == QuantizeSettings::UV_UNORM16)
+            {
+                uint16_t packed[2] = {toUnorm16((uv[0] - result.uvOffset[0]) / result.uvScale[0]),
+                                      toUnorm16((uv[1] - result.uvOffset[1]) / result.uvScale[1])};
+                std::memcpy(dst, packed, 4);
+            }
+            else if (settings.uv == QuantizeSettings::UV_HALF)
+            {
+                uint16_t packed[2];
+                hdr::floatToHalf(uv, packed, 2);
+                std::memcpy(dst, packed, 4);
+            }
+            else
+            {
+                std::memcpy(dst, uv, 8);
+            }
+        }
+    }
+    return result;
+}
+
+void mesh::decodeAttribute(const unsigned char *vertex, const VertexAttribute &attribute, float out[4])
+{
+    out[0] = out[1] = out[2] = 0.0f;
+    out[3] = 1.0f;
+    const unsigned char *src = vertex + attribute.offset;
+    if (attribute.type == GL_INT_2_10_10_10_REV)
+    {
+        uint32_t packed;
+        std::memcpy(&packed, src, 4);
+        out[0] = fromSnorm(signExtend(packed & 0x3FF, 10), 10);
+        out[1] = fromSnorm(signExtend((packed >> 10) & 0x3FF, 10), 10);
+        out[2] = fromSnorm(signExtend((packed >> 20) & 0x3FF, 10), 10);
+        out[3] = fromSnorm(signExtend(packed >> 30, 2), 2);
+        return;
+    }
+    for (int k = 0; k < attribute.components; k++)
+    {
+        switch (attribute.type)
+        {
+        case GL_FLOAT:
+            std::memcpy(&out[k], src + k * 4, 4);
+            break;
+        case GL_HALF_FLOAT:
+        {
+            uint16_t h;
+            std::memcpy(&h, src + k * 2, 2);
+            out[k] = hdr::scalar::halfToFloat(h);
+            break;
+        }
+        case GL_UNSIGNED_SHORT:
+        {
+            uint16_t v;
+            std::memcpy(&v, src + k * 2, 2);
+            out[k] = attribute.normalized ? v / 65535.0f : v;
+            break;
+        }
+        case GL_SHORT:
+        {
+            int16_t v;
+            std::memcpy(&v, src + k * 2, 2);
+            out[k] = attribute.normalized ? fromSnorm(v, 16) : v;
+            break;
+        }
+        default:
+            break;
+        }
+    }
+}
+
+void mesh::octEncode(const float n[3], float oct[2])
+{
+    float l1 = std::fabs(n[0]) + std::fabs(n[1]) + std::fabs(n[2]);
+    float x = l1 > 0.0f ? n[0] / l1 : 0.0f;
+    float y = l1 > 0.0f ? n[1] / l1 : 0.0f;
+    if (n[2] < 0.0f)
+    {
+        // fold the lower hemisphere over the diagonals
+        float fx = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        float fy = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = fx;
+        y = fy;
+    }
+    oct[0] = x;
+    oct[1] = y;
+}
+
+void mesh::octDecode(const float oct[2], float n[3])
+{
+    float x = oct[0], y = oct[1];
+    float z = 1.0f - std::fabs(x) - std::fabs(y);
+    float t = std::max(-z, 0.0f);
+    x += x >= 0.0f ? -t : t;
+    y += y >= 0.0f ? -t : t;
+    float length = std::sqrt(x * x + y * y + z * z);
+    n[0] = x / length;
+    n[1] = y / length;
+    n[2] = z / length;
+}
+
+const char *mesh::octahedralGlsl()
+{
+    return "vec3 octDecode(vec2 e)\n"
+           "{\n"
+           "    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));\n"
+           "    float t = max(-n.z, 0.0);\n"
+           "    n.xy += mix(vec2(t), vec2(-t), greaterThanEqual(n.xy, vec2(0.0)));\n"
+           "    return normalize(n);\n"
+           "}\n";
+}
@@ -0,0 +1,111 @@
+#ifndef VERTEX_QUANTIZE_HPP
+#define VERTEX_QUANTIZE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glad/glad.h>
+
+// Packs float vertex streams into compact interleaved vertices and describes the
+// result as glVertexAttribPointer/glVertexAttribIPointer calls, so the GL side needs
+// no hand written offsets. With the defaults a position + normal + uv + tangent vertex
+// shrinks from 48 to 20 bytes:
+//   position  unorm16 x4 relative to the mesh bounds, 8 bytes (or half x4, 8 bytes)
+//   normal    int 2_10_10_10_rev, 4 bytes (or octahedral snorm16 x2, 4 bytes)
+//   tangent   like the normal, the handedness goes into w
+//   uv        unorm16 x2, 4 bytes (or half x2)
+// Normalised formats reach the shader as floats, so only the octahedral format needs
+// shader code (octahedralGlsl), and unorm16 positions need positionScale/positionOffset
+// folded into the model matrix.
+namespace mesh
+{
+    struct VertexAttribute
+    {
+        GLuint location;
+        GLint components;
+        GLenum type;
+        GLboolean normalized;
+        bool integer; // glVertexAttribIPointer
+        GLuint offset;
+    };
+
+    struct VertexLayout
+    {
+        GLsizei stride = 0;
+        std::vector<VertexAttribute> attributes;
+
+        // sets up the attributes of the bound VAO to read the bound GL_ARRAY_BUFFER
+        // starting at baseOffset bytes
+        void apply(size_t baseOffset = 0) const;
+    };
+
+    // float input, nullptr for missing streams; strides in bytes
+    struct VertexStreams
+    {
+        size_t count = 0;
+        const float *positions = nullptr; // xyz
+        size_t positionStride = 0;
+        const float *normals = nullptr; // xyz, unit length
+        size_t normalStride = 0;
+        const float *tangents = nullptr; // xyz + handedness in w (+1 / -1)
+        size_t tangentStride = 0;
+        const float *uvs = nullptr;
+        size_t uvStride = 0;
+    };
+
+    struct QuantizeSettings
+    {
+        enum PositionFormat
+        {
+            POSITION_FLOAT,
+            POSITION_HALF,
+            POSITION_UNORM16,
+        };
+        enum DirectionFormat
+        {
+            DIRECTION_FLOAT,
+            DIRECTION_OCT16,      // octahedral map, decode with octahedralGlsl; tangents keep their sign in z
+            DIRECTION_10_10_10_2, // signed normalised, the shader reads a plain vec3 / vec4
+        };
+        enum UvFormat
+        {
+            UV_FLOAT,
+            UV_HALF,
+            UV_UNORM16, // remapped to the uv bounds when they leave [0, 1], see uvScale / uvOffset
+        };
+
+        PositionFormat position = POSITION_UNORM16;
+        DirectionFormat normal = DIRECTION_10_10_10_2;
+        DirectionFormat tangent = DIRECTION_10_10_10_2;
+        UvFormat uv = UV_UNORM16;
+        GLuint positionLocation = 0;
+        GLuint normalLocation = 1;
+        GLuint uvLocation = 2;
+        GLuint tangentLocation = 3;
+    };
+
+    struct QuantizedVertices
+    {
+        std::vector<unsigned char> data;
+        VertexLayout layout;
+        // decoded = stored * scale + offset; identity unless the format is relative to the bounds
+        float positionScale[3];
+        float positionOffset[3];
+        float uvScale[2];
+        float uvOffset[2];
+    };
+
+    QuantizedVertices quantizeVertices(const VertexStreams &streams, const QuantizeSettings &settings);
+
+    // Reads one attribute back to floats the way GL converts it for the shader (before
+    // any scale/offset or octahedral decoding). Unused components come back as 0, 0, 0, 1.
+    void decodeAttribute(const unsigned char *vertex, const VertexAttribute &attribute, float out[4]);
+
+    // unit vector <-> octahedral coordinates in [-1, 1]^2
+    void octEncode(const float n[3], float oct[2]);
+    void octDecode(const float oct[2], float n[3]);
+    // GLSL for `vec3 octDecode(vec2 e)`, paste before main()
+    const char *octahedralGlsl();
+} // namespace mesh
+
+#endif // VERTEX_QUANTIZE_HPP
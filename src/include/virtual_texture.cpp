@@ -0,0 +1,753 @@
+#include "virtual_texture.hpp"
+#include "mipmap.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace
+{
+    const char VTEX_MAGIC[4] = {'V', 'T', 'E', 'X'};
+    const uint32_t VTEX_VERSION = 1;
+    // magic, version, width, height, tile size, border, levels, reserved
+    const size_t VTEX_HEADER_SIZE = 32;
+    const int MAX_PAGES = 4096; // 12 bits per axis in a page key
+    const int MAX_TILE_SIZE = 8192; // keeps a padded tile well inside int and GL texture limits
+
+    bool isPowerOfTwo(int v)
+    {
+        return v > 0 && (v & (v - 1)) == 0;
+    }
+
+    int log2Int(int v)
+    {
+        int bits = 0;
+        while ((1 << (bits + 1)) <= v)
+        {
+            bits++;
+        }
+        return bits;
+    }
+
+    // what bake() accepts and open() trusts: paddedTileSize() and tileBytes() cannot overflow
+    bool validLayout(int width, int height, int tileSize, int border)
+    {
+        // border < ceil(tileSize / 2) is border * 2 < tileSize without the overflow
+        return tileSize > 0 && tileSize <= MAX_TILE_SIZE && border >= 0 && border < (tileSize + 1) / 2 &&
+               width % tileSize == 0 && height % tileSize == 0 && isPowerOfTwo(width / tileSize) &&
+               isPowerOfTwo(height / tileSize) && width / tileSize <= MAX_PAGES && height / tileSize <= MAX_PAGES;
+    }
+
+    uint32_t readU32(const unsigned char *p)
+    {
+        return static_cast<uint32_t>(p[0]) | static_cast<uint32_t>(p[1]) << 8 | static_cast<uint32_t>(p[2]) << 16 |
+               static_cast<uint32_t>(p[3]) << 24;
+    }
+
+    void writeU32(unsigned char *p, uint32_t v)
+    {
+        p[0] = static_cast<unsigned char>(v);
+        p[1] = static_cast<unsigned char>(v >> 8);
+        p[2] = static_cast<unsigned char>(v >> 16);
+        p[3] = static_cast<unsigned char>(v >> 24);
+    }
+
+    // source texel for texel i of the tiles along one axis; pages * tileSize texels
+    // cover the whole level, so levels smaller than a tile are stretched
+    int sourceTexel(int i, int levelSize, int pages, int tileSize)
+    {
+        int64_t s = ((2 * static_cast<int64_t>(i) + 1) * levelSize) / (2 * static_cast<int64_t>(pages) * tileSize);
+        return static_cast<int>(std::clamp<int64_t>(s, 0, levelSize - 1));
+    }
+} // namespace
+
+// ---------------------------------------------------------------------------
+// VirtualTextureFile
+
+VirtualTextureFile::VirtualTextureFile() : m_width{0}, m_height{0}, m_tileSize{0}, m_border{0}, m_levels{0} {};
+
+bool VirtualTextureFile::open(const std::filesystem::path &path)
+{
+    m_levels = 0;
+    if (!m_file.open(path) || m_file.size() < VTEX_HEADER_SIZE)
+    {
+        std::cerr << "Failed to open virtual texture: " << path << std::endl;
+        return false;
+    }
+    const unsigned char *header = m_file.data();
+    if (std::memcmp(header, VTEX_MAGIC, 4) != 0 || readU32(header + 4) != VTEX_VERSION)
+    {
+        std::cerr << "Not a virtual texture file: " << path << std::endl;
+        m_file.close();
+        return false;
+    }
+    m_width = static_cast<int>(readU32(header + 8));
+    m_height = static_cast<int>(readU32(header + 12));
+    m_tileSize = static_cast<int>(readU32(header + 16));
+    m_border = static_cast<int>(readU32(header + 20));
+    int levels = static_cast<int>(readU32(header + 24));
+    if (!validLayout(m_width, m_height, m_tileSize, m_border) ||
+        levels != 1 + log2Int(std::max(m_width, m_height) / m_tileSize))
+    {
+        std::cerr << "Corrupt virtual texture header: " << path << std::endl;
+        m_file.close();
+        return false;
+    }
+    m_levels = levels;
+
+    // at most 2^24 pages of under 2^30 bytes per level, so 64 bits cannot wrap; a total that
+    // fits in the mapped file also fits every offset in size_t
+    m_levelOffsets.resize(m_levels + 1);
+    uint64_t offset = VTEX_HEADER_SIZE;
+    for (int level = 0; level < m_levels; level++)
+    {
+        m_levelOffsets[level] = static_cast<size_t>(offset);
+        offset += static_cast<uint64_t>(pagesX(level)) * pagesY(level) * tileBytes();
+    }
+    m_levelOffsets[m_levels] = static_cast<size_t>(offset);
+    if (m_file.size() < offset)
+    {
+        std::cerr << "Truncated virtual texture: " << path << std::endl;
+        m_file.close();
+        m_levels = 0;
+        return false;
+    }
+    m_file.adviseRandom();
+    return true;
+}
+
+bool VirtualTextureFile::isOpen() const
+{
+    return m_levels > 0;
+}
+
+int VirtualTextureFile::width() const
+{
+    return m_width;
+}
+
+int VirtualTextureFile::height() const
+{
+    return m_height;
+}
+
+int VirtualTextureFile::tileSize() const
+{
+    return m_tileSize;
+}
+
+int VirtualTextureFile::border() const
+{
+    return m_border;
+}
+
+int VirtualTextureFile::levels() const
+{
+    return m_levels;
+}
+
+int VirtualTextureFile::pagesX(int level) const
+{
+    return std::max(1, (m_width / m_tileSize) >> level);
+}
+
+int VirtualTextureFile::pagesY(int level) const
+{
+    return std::max(1, (m_height / m_tileSize) >> level);
+}
+
+int VirtualTextureFile::paddedTileSize() const
+{
+    return m_tileSize + 2 * m_border;
+}
+
+size_t VirtualTextureFile::tileBytes() const
+{
+    return static_cast<size_t>(paddedTileSize()) * paddedTileSize() * 4;
+}
+
+size_t VirtualTextureFile::tileOffset(uint32_t page) const
+{
+    int level = vt::pageMip(page);
+    return m_levelOffsets[level] + (static_cast<size_t>(vt::pageY(page)) * pagesX(level) + vt::pageX(page)) * tileBytes();
+}
+
+bool VirtualTextureFile::readTile(uint32_t page, unsigned char *dst) const
+{
+    int level = vt::pageMip(page);
+    if (level >= m_levels || vt::pageX(page) >= pagesX(level) || vt::pageY(page) >= pagesY(level))
+    {
+        return false;
+    }
+    std::memcpy(dst, m_file.data() + tileOffset(page), tileBytes());
+    return true;
+}
+
+bool VirtualTextureFile::bake(const unsigned char *rgba, int width, int height, int tileSize, int border,
+                              const std::filesystem::path &path, bool srgb)
+{
+    if (!validLayout(width, height, tileSize, border))
+    {
+        std::cerr << "Virtual textures must be tileSize * 2^n texels along each axis, got " << width << "x" << height
+                  << " with " << tileSize << " texel tiles and a " << border << " texel border" << std::endl;
+        return false;
+    }
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out.is_open())
+    {
+        std::cerr << "Failed to create virtual texture: " << path << std::endl;
+        return false;
+    }
+
+    int pages0X = width / tileSize;
+    int pages0Y = height / tileSize;
+    int levels = 1 + log2Int(std::max(pages0X, pages0Y));
+    std::vector<MipmapGenerator::Level> mips;
+    if (levels > 1)
+    {
+        mips = MipmapGenerator(MipmapGenerator::BOX, srgb).generate(rgba, width, height, 4, 8, levels - 1);
+    }
+
+    unsigned char header[VTEX_HEADER_SIZE] = {};
+    std::memcpy(header, VTEX_MAGIC, 4);
+    writeU32(header + 4, VTEX_VERSION);
+    writeU32(header + 8, static_cast<uint32_t>(width));
+    writeU32(header + 12, static_cast<uint32_t>(height));
+    writeU32(header + 16, static_cast<uint32_t>(tileSize));
+    writeU32(header + 20, static_cast<uint32_t>(border));
+    writeU32(header + 24, static_cast<uint32_t>(levels));
+    out.write(reinterpret_cast<const char *>(header), VTEX_HEADER_SIZE);
+
+    int padded = tileSize + 2 * border;
+    std::vector<unsigned char> tile(static_cast<size_t>(padded) * padded * 4);
+    std::vector<int> columns(padded);
+    for (int level = 0; level < levels; level++)
+    {
+        const unsigned char *pixels = level == 0 ? rgba : mips[level - 1].data.data();
+        int levelWidth = level == 0 ? width : mips[level - 1].width;
+        int levelHeight = level == 0 ? height : mips[level - 1].height;
+        int pagesX = std::max(1, pages0X >> level);
+        int pagesY = std::max(1, pages0Y >> level);
+        for (int ty = 0; ty < pagesY; ty++)
+        {
+            for (int tx = 0; tx < pagesX; tx++)
+            {
+                for (int i = 0; i < padded; i++)
+                {
+                    columns[i] = sourceTexel(tx * tileSize + i - border, levelWidth, pagesX, tileSize);
+                }
+                unsigned char *dst = tile.data();
+                for (int j = 0; j < padded; j++)
+                {
+                    int row = sourceTexel(ty * tileSize + j - border, levelHeight, pagesY, tileSize);
+                    const unsigned char *src = pixels + static_cast<size_t>(row) * levelWidth * 4;
+                    for (int i = 0; i < padded; i++, dst += 4)
+                    {
+                        std::memcpy(dst, src + static_cast<size_t>(columns[i]) * 4, 4);
+                    }
+                }
+                out.write(reinterpret_cast<const char *>(tile.data()), static_cast<std::streamsize>(tile.size()));
+            }
+        }
+    }
+    if (!out)
+    {
+        std::cerr << "Failed to write virtual texture: " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// FeedbackAnalyzer
+
+uint32_t FeedbackAnalyzer::encode(uint32_t page)
+{
+    uint32_t x = static_cast<uint32_t>(vt::pageX(page));
+    uint32_t y = static_cast<uint32_t>(vt::pageY(page));
+    uint32_t high = (x >> 8) | ((y >> 8) << 4);
+    return (x & 0xFF) | (y & 0xFF) << 8 | high << 16 | static_cast<uint32_t>(vt::pageMip(page)) << 24;
+}
+
+uint32_t FeedbackAnalyzer::decode(uint32_t texel)
+{
+    uint32_t mip = texel >> 24;
+    if (mip == 0xFF)
+    {
+        return vt::INVALID_PAGE;
+    }
+    uint32_t high = (texel >> 16) & 0xFF;
+    int x = static_cast<int>((texel & 0xFF) | (high & 0xF) << 8);
+    int y = static_cast<int>(((texel >> 8) & 0xFF) | (high >> 4) << 8);
+    return vt::pageKey(static_cast<int>(mip), x, y);
+}
+
+const std::vector<FeedbackAnalyzer::Request> &FeedbackAnalyzer::analyze(const uint32_t *feedback, size_t count,
+                                                                        const VirtualTextureFile &file)
+{
+    m_requests.clear();
+    m_index.clear();
+
+    // neighbouring texels nearly always hit the same page, drop repeats before sorting
+    uint32_t previous = 0xFFFFFFFFu;
+    uint32_t run = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (feedback[i] == previous)
+        {
+            run++;
+            continue;
+        }
+        if (run > 0)
+        {
+            m_requests.push_back({previous, run});
+        }
+        previous = feedback[i];
+        run = 1;
+    }
+    if (run > 0)
+    {
+        m_requests.push_back({previous, run});
+    }
+
+    // merge the runs per page
+    std::sort(m_requests.begin(), m_requests.end(),
+              [](const Request &a, const Request &b)
+              { return a.page < b.page; });
+    size_t unique = 0;
+    for (size_t i = 0; i < m_requests.size(); i++)
+    {
+        uint32_t page = decode(m_requests[i].page);
+        int mip = vt::pageMip(page);
+        if (page == vt::INVALID_PAGE || mip >= file.levels() || vt::pageX(page) >= file.pagesX(mip) ||
+            vt::pageY(page) >= file.pagesY(mip))
+        {
+            continue;
+        }
+        if (unique > 0 && m_requests[unique - 1].page == page)
+        {
+            m_requests[unique - 1].texels += m_requests[i].texels;
+            continue;
+        }
+        m_requests[unique++] = {page, m_requests[i].texels};
+    }
+    m_requests.resize(unique);
+
+    // a page is only useful once the pages it falls back to are resident too
+    for (size_t i = 0; i < unique; i++)
+    {
+        m_index.emplace(m_requests[i].page, i);
+    }
+    for (size_t i = 0; i < unique; i++)
+    {
+        uint32_t page = m_requests[i].page;
+        for (int mip = vt::pageMip(page) + 1; mip < file.levels(); mip++)
+        {
+            page = vt::pageKey(mip, vt::pageX(page) >> 1, vt::pageY(page) >> 1);
+            if (!m_index.emplace(page, m_requests.size()).second)
+            {
+                break;
+            }
+            m_requests.push_back({page, 0});
+        }
+    }
+
+    std::sort(m_requests.begin(), m_requests.end(),
+              [](const Request &a, const Request &b)
+              {
+                  if (vt::pageMip(a.page) != vt::pageMip(b.page))
+                  {
+                      return vt::pageMip(a.page) > vt::pageMip(b.page);
+                  }
+                  if (a.texels != b.texels)
+                  {
+                      return a.texels > b.texels;
+                  }
+                  return a.page < b.page;
+              });
+    return m_requests;
+}
+
+// ---------------------------------------------------------------------------
+// PageCache
+
+PageCache::PageCache(int slotCount) : m_head{-1}, m_tail{-1}
+{
+    m_slots.resize(std::max(0, slotCount));
+    for (int i = 0; i < slotCount; i++)
+    {
+        m_slots[i] = {vt::INVALID_PAGE, 0, -1, -1, false};
+        pushBack(i);
+    }
+}
+
+int PageCache::slotCount() const
+{
+    return static_cast<int>(m_slots.size());
+}
+
+int PageCache::find(uint32_t page) const
+{
+    auto it = m_lookup.find(page);
+    return it == m_lookup.end() ? -1 : it->second;
+}
+
+void PageCache::touch(int slot, uint64_t frame)
+{
+    m_slots[slot].lastUsed = frame;
+    if (!m_slots[slot].pinned)
+    {
+        unlink(slot);
+        pushBack(slot);
+    }
+}
+
+int PageCache::acquire(uint32_t page, uint64_t frame, uint32_t &evicted)
+{
+    evicted = vt::INVALID_PAGE;
+    int slot = m_head;
+    if (slot < 0 || (m_slots[slot].page != vt::INVALID_PAGE && m_slots[slot].lastUsed == frame))
+    {
+        return -1;
+    }
+    if (m_slots[slot].page != vt::INVALID_PAGE)
+    {
+        evicted = m_slots[slot].page;
+        m_lookup.erase(evicted);
+    }
+    m_slots[slot].page = page;
+    m_slots[slot].lastUsed = frame;
+    m_lookup[page] = slot;
+    unlink(slot);
+    pushBack(slot);
+    return slot;
+}
+
+void PageCache::pin(int slot)
+{
+    if (!m_slots[slot].pinned)
+    {
+        unlink(slot);
+        m_slots[slot].pinned = true;
+    }
+}
+
+size_t PageCache::residentCount() const
+{
+    return m_lookup.size();
+}
+
+void PageCache::unlink(int slot)
+{
+    Slot &s = m_slots[slot];
+    (s.prev >= 0 ? m_slots[s.prev].next : m_head) = s.next;
+    (s.next >= 0 ? m_slots[s.next].prev : m_tail) = s.prev;
+    s.prev = s.next = -1;
+}
+
+void PageCache::pushBack(int slot)
+{
+    m_slots[slot].prev = m_tail;
+    m_slots[slot].next = -1;
+    (m_tail >= 0 ? m_slots[m_tail].next : m_head) = slot;
+    m_tail = slot;
+}
+
+// ---------------------------------------------------------------------------
+// TileStreamer
+
+TileStreamer::TileStreamer(const VirtualTextureFile &file, int maxInFlight)
+    : m_file(file), m_maxInFlight{std::max(1, maxInFlight)} {};
+
+TileStreamer::~TileStreamer()
+{
+    // jobs still reference this object
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_idle.wait(lock, [this]
+                { return m_pending.empty(); });
+}
+
+bool TileStreamer::request(uint32_t page)
+{
+    Tile *tile;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (static_cast<int>(m_pending.size()) >= m_maxInFlight ||
+            std::find(m_pending.begin(), m_pending.end(), page) != m_pending.end())
+        {
+            return false;
+        }
+        m_pending.push_back(page);
+        if (m_free.empty())
+        {
+            tile = new Tile;
+        }
+        else
+        {
+            tile = m_free.back().release();
+            m_free.pop_back();
+        }
+    }
+    tile->page = page;
+    tile->pixels.resize(m_file.tileBytes());
+
+    ThreadPool::shared().enqueue(
+        [this, tile]
+        {
+            tile->ok = m_file.readTile(tile->page, tile->pixels.data());
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_pending.erase(std::find(m_pending.begin(), m_pending.end(), tile->page));
+            m_finished.emplace_back(tile);
+            if (m_pending.empty())
+            {
+                m_idle.notify_all();
+            }
+        });
+    return true;
+}
+
+bool TileStreamer::isPending(uint32_t page) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return std::find(m_pending.begin(), m_pending.end(), page) != m_pending.end();
+}
+
+void TileStreamer::collect(std::vector<std::unique_ptr<Tile>> &done)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (std::unique_ptr<Tile> &tile : m_finished)
+    {
+        done.push_back(std::move(tile));
+    }
+    m_finished.clear();
+}
+
+void TileStreamer::recycle(std::unique_ptr<Tile> tile)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_free.push_back(std::move(tile));
+}
+
+int TileStreamer::inFlight() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return static_cast<int>(m_pending.size());
+}
+
+// ---------------------------------------------------------------------------
+// VirtualTexture
+
+VirtualTexture::VirtualTexture(const std::filesystem::path &path) : VirtualTexture(path, Settings{}) {};
+
+VirtualTexture::VirtualTexture(const std::filesystem::path &path, const Settings &settings)
+    : m_settings(settings), m_dirtyLevels{0}, m_frame{0}
+{
+    m_settings.atlasSlotsX = std::clamp(m_settings.atlasSlotsX, 1, 256);
+    m_settings.atlasSlotsY = std::clamp(m_settings.atlasSlotsY, 1, 256);
+    if (!m_file.open(path))
+    {
+        return;
+    }
+    m_cache = std::make_unique<PageCache>(m_settings.atlasSlotsX * m_settings.atlasSlotsY);
+    m_streamer = std::make_unique<TileStreamer>(m_file, m_settings.maxReadsInFlight);
+    for (int level = 0; level < m_file.levels(); level++)
+    {
+        size_t pages = static_cast<size_t>(m_file.pagesX(level)) * m_file.pagesY(level);
+        m_mapped.emplace_back(pages, -1);
+        m_table.emplace_back(pages, 0u);
+    }
+
+    // the single page of the coarsest level is always resident, so every lookup has a fallback
+    int top = m_file.levels() - 1;
+    auto tile = std::make_unique<TileStreamer::Tile>();
+    tile->page = vt::pageKey(top, 0, 0);
+    tile->pixels.resize(m_file.tileBytes());
+    tile->ok = m_file.readTile(tile->page, tile->pixels.data());
+    uint32_t evicted;
+    int slot = m_cache->acquire(tile->page, m_frame, evicted);
+    m_cache->pin(slot);
+    map(tile->page, slot);
+    m_uploads.push_back({slot % m_settings.atlasSlotsX, slot / m_settings.atlasSlotsX, tile->pixels.data()});
+    m_uploading.push_back(std::move(tile));
+    rebuildPageTable();
+}
+
+VirtualTexture::~VirtualTexture() = default;
+
+bool VirtualTexture::isOpen() const
+{
+    return m_file.isOpen();
+}
+
+const VirtualTextureFile &VirtualTexture::file() const
+{
+    return m_file;
+}
+
+const VirtualTexture::Settings &VirtualTexture::settings() const
+{
+    return m_settings;
+}
+
+void VirtualTexture::update(const uint32_t *feedback, size_t count)
+{
+    if (!isOpen())
+    {
+        return;
+    }
+    m_frame++;
+    m_stats.frames++;
+    for (std::unique_ptr<TileStreamer::Tile> &tile : m_uploading)
+    {
+        m_streamer->recycle(std::move(tile));
+    }
+    m_uploading.clear();
+    m_uploads.clear();
+    m_dirtyLevels = 0;
+
+    const std::vector<FeedbackAnalyzer::Request> &requests = m_analyzer.analyze(feedback, count, m_file);
+    m_stats.requested += requests.size();
+
+    // refresh everything visible first so none of it is picked for eviction below
+    int visible = 0;
+    for (const FeedbackAnalyzer::Request &request : requests)
+    {
+        int slot = m_cache->find(request.page);
+        if (slot >= 0)
+        {
+            m_cache->touch(slot, m_frame);
+            m_stats.hits++;
+            visible++;
+        }
+    }
+    // only read what can still be given a slot; when the visible set outgrows the atlas
+    // the remaining pages keep falling back to coarser levels instead of thrashing the disk
+    int freeSlots = m_cache->slotCount() - 1 - visible - static_cast<int>(m_ready.size()) - m_streamer->inFlight();
+    for (const FeedbackAnalyzer::Request &request : requests)
+    {
+        if (m_cache->find(request.page) >= 0)
+        {
+            continue;
+        }
+        m_stats.misses++;
+        bool ready = std::any_of(m_ready.begin(), m_ready.end(),
+                                 [&](const std::unique_ptr<TileStreamer::Tile> &tile)
+                                 { return tile->page == request.page; });
+        if (!ready && freeSlots > 0 && m_streamer->request(request.page))
+        {
+            m_stats.reads++;
+            freeSlots--;
+        }
+    }
+
+    // upload finished reads, coarse levels first so fallbacks improve before detail arrives
+    m_streamer->collect(m_ready);
+    std::stable_sort(m_ready.begin(), m_ready.end(),
+                     [](const std::unique_ptr<TileStreamer::Tile> &a, const std::unique_ptr<TileStreamer::Tile> &b)
+                     { return vt::pageMip(a->page) > vt::pageMip(b->page); });
+    size_t used = 0;
+    bool atlasFull = false;
+    for (; used < m_ready.size() && static_cast<int>(m_uploads.size()) < m_settings.maxUploadsPerFrame; used++)
+    {
+        std::unique_ptr<TileStreamer::Tile> &tile = m_ready[used];
+        if (!tile->ok || m_cache->find(tile->page) >= 0)
+        {
+            m_streamer->recycle(std::move(tile));
+            continue;
+        }
+        uint32_t evicted;
+        int slot = m_cache->acquire(tile->page, m_frame, evicted);
+        if (slot < 0)
+        {
+            // everything resident is on screen; newer requests will be retried from feedback
+            atlasFull = true;
+            break;
+        }
+        if (evicted != vt::INVALID_PAGE)
+        {
+            unmap(evicted);
+            m_stats.evictions++;
+        }
+        map(tile->page, slot);
+        m_uploads.push_back({slot % m_settings.atlasSlotsX, slot / m_settings.atlasSlotsX, tile->pixels.data()});
+        m_uploading.push_back(std::move(tile));
+    }
+    // keep what the upload budget did not allow for the next frame, but not without bound
+    size_t keep = atlasFull ? used : static_cast<size_t>(used + m_settings.maxReadsInFlight);
+    for (size_t i = keep; i < m_ready.size(); i++)
+    {
+        m_stats.dropped++;
+        m_streamer->recycle(std::move(m_ready[i]));
+    }
+    m_ready.resize(std::min(m_ready.size(), keep));
+    m_ready.erase(m_ready.begin(), m_ready.begin() + used);
+    m_stats.uploads += m_uploads.size();
+
+    rebuildPageTable();
+}
+
+const std::vector<VirtualTexture::TileUpload> &VirtualTexture::uploads() const
+{
+    return m_uploads;
+}
+
+const std::vector<uint32_t> &VirtualTexture::pageTable(int level) const
+{
+    return m_table[level];
+}
+
+int VirtualTexture::dirtyLevels() const
+{
+    return m_dirtyLevels;
+}
+
+const VirtualTexture::Stats &VirtualTexture::stats() const
+{
+    return m_stats;
+}
+
+void VirtualTexture::map(uint32_t page, int slot)
+{
+    int level = vt::pageMip(page);
+    m_mapped[level][static_cast<size_t>(vt::pageY(page)) * m_file.pagesX(level) + vt::pageX(page)] = slot;
+    m_dirtyLevels = std::max(m_dirtyLevels, level + 1);
+}
+
+void VirtualTexture::unmap(uint32_t page)
+{
+    int level = vt::pageMip(page);
+    m_mapped[level][static_cast<size_t>(vt::pageY(page)) * m_file.pagesX(level) + vt::pageX(page)] = -1;
+    m_dirtyLevels = std::max(m_dirtyLevels, level + 1);
+}
+
+void VirtualTexture::rebuildPageTable()
+{
+    // a change at one level can alter the fallback of every finer level below it
+    for (int level = m_dirtyLevels - 1; level >= 0; level--)
+    {
+        int pagesX = m_file.pagesX(level);
+        int pagesY = m_file.pagesY(level);
+        bool top = level + 1 >= m_file.levels();
+        int parentPagesX = top ? 0 : m_file.pagesX(level + 1);
+        for (int y = 0; y < pagesY; y++)
+        {
+            for (int x = 0; x < pagesX; x++)
+            {
+                size_t index = static_cast<size_t>(y) * pagesX + x;
+                int slot = m_mapped[level][index];
+                if (slot >= 0)
+                {
+                    m_table[level][index] = static_cast<uint32_t>(slot % m_settings.atlasSlotsX) |
+                                            static_cast<uint32_t>(slot / m_settings.atlasSlotsX) << 8 |
+                                            static_cast<uint32_t>(level) << 16 | 0xFF000000u;
+                }
+                else
+                {
+                    m_table[level][index] = top ? 0u : m_table[level + 1][static_cast<size_t>(y >> 1) * parentPagesX + (x >> 1)];
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,248 @@
+#ifndef VIRTUAL_TEXTURE_HPP
+#define VIRTUAL_TEXTURE_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "mapped_file.hpp"
+
+// CPU side of the virtual texturing system. Nothing in here touches GL, so the
+// page management can be driven (and measured) from a plain executable; the
+// GPU half lives in virtual_texture_gl.hpp.
+//
+// A page is one tile of one mip level. Pages are identified by a 32 bit key:
+// mip in the top 8 bits, then 12 bits of tile y and 12 bits of tile x.
+namespace vt
+{
+    const uint32_t INVALID_PAGE = 0xFFFFFFFFu;
+
+    inline uint32_t pageKey(int mip, int x, int y)
+    {
+        return (static_cast<uint32_t>(mip) << 24) | (static_cast<uint32_t>(y) << 12) | static_cast<uint32_t>(x);
+    }
+    inline int pageMip(uint32_t key) { return static_cast<int>(key >> 24); }
+    inline int pageY(uint32_t key) { return static_cast<int>((key >> 12) & 0xFFF); }
+    inline int pageX(uint32_t key) { return static_cast<int>(key & 0xFFF); }
+} // namespace vt
+
+// Tiled mip chain on disk (".vtex"). Every tile is stored as RGBA8 with a border
+// of duplicated neighbour texels so the atlas can be sampled bilinearly.
+// Level 0 must be tileSize * 2^n texels along each axis, with tiles of at most 8192
+// texels and a border under half a tile; open() rejects files that break this.
+// Levels whose size drops below one tile are stretched to fill it, which keeps every
+// level at exactly half the page count of the one before.
+class VirtualTextureFile
+{
+public:
+    VirtualTextureFile();
+
+    bool open(const std::filesystem::path &path);
+    bool isOpen() const;
+
+    int width() const;
+    int height() const;
+    int tileSize() const;
+    int border() const;
+    int levels() const;
+    int pagesX(int level) const;
+    int pagesY(int level) const;
+    // side length of a stored tile, tileSize + 2 * border
+    int paddedTileSize() const;
+    size_t tileBytes() const;
+
+    // copies the tile into dst (tileBytes() bytes). Safe to call from several threads.
+    bool readTile(uint32_t page, unsigned char *dst) const;
+
+    // Splits a tightly packed RGBA8 image into tiles for every mip level and writes them to path.
+    static bool bake(const unsigned char *rgba, int width, int height, int tileSize, int border,
+                     const std::filesystem::path &path, bool srgb = true);
+
+private:
+    size_t tileOffset(uint32_t page) const;
+    // vars
+    MappedFile m_file;
+    int m_width;
+    int m_height;
+    int m_tileSize;
+    int m_border;
+    int m_levels;
+    std::vector<size_t> m_levelOffsets;
+};
+
+// Reduces a read back feedback buffer to a list of pages worth loading.
+// Feedback texels are RGBA8: r/g hold the low 8 bits of the page x/y, b holds the
+// high 4 bits of each, a holds the mip level; a == 255 marks texels that did not
+// sample the virtual texture (clear with alpha 1).
+class FeedbackAnalyzer
+{
+public:
+    struct Request
+    {
+        uint32_t page;
+        uint32_t texels; // 0 for pages only requested as a parent of a visible page
+    };
+
+    static uint32_t encode(uint32_t page);
+    static uint32_t decode(uint32_t texel);
+
+    // feedback is count texels as uint32 in memory order (r in the lowest byte).
+    // Requested pages come back with all their ancestors, coarsest first, then by texel count.
+    const std::vector<Request> &analyze(const uint32_t *feedback, size_t count, const VirtualTextureFile &file);
+
+private:
+    // vars
+    std::vector<Request> m_requests;
+    std::unordered_map<uint32_t, size_t> m_index;
+};
+
+// Maps pages to slots of the physical atlas and evicts the least recently used page
+// when the atlas is full. Pages used in the current frame are never evicted.
+class PageCache
+{
+public:
+    explicit PageCache(int slotCount);
+
+    int slotCount() const;
+    int find(uint32_t page) const;
+    void touch(int slot, uint64_t frame);
+    // Returns a slot for page, evicting the least recently used one into evicted
+    // (INVALID_PAGE if the slot was free). Returns -1 if every slot is in use this frame.
+    int acquire(uint32_t page, uint64_t frame, uint32_t &evicted);
+    // pinned slots are never evicted, used for the coarsest level
+    void pin(int slot);
+    size_t residentCount() const;
+
+private:
+    struct Slot
+    {
+        uint32_t page;
+        uint64_t lastUsed;
+        int prev;
+        int next;
+        bool pinned;
+    };
+
+    void unlink(int slot);
+    void pushBack(int slot);
+    // vars
+    std::vector<Slot> m_slots;
+    std::unordered_map<uint32_t, int> m_lookup;
+    int m_head; // least recently used
+    int m_tail; // most recently used
+};
+
+// Reads tiles on ThreadPool::shared() with a cap on outstanding reads.
+// Tile buffers are recycled, so steady state streaming does not allocate.
+class TileStreamer
+{
+public:
+    struct Tile
+    {
+        uint32_t page;
+        std::vector<unsigned char> pixels;
+        bool ok;
+    };
+
+    TileStreamer(const VirtualTextureFile &file, int maxInFlight);
+    ~TileStreamer();
+
+    TileStreamer(const TileStreamer &) = delete;
+    TileStreamer &operator=(const TileStreamer &) = delete;
+
+    // false if the page is already being read or too many reads are outstanding
+    bool request(uint32_t page);
+    bool isPending(uint32_t page) const;
+    // moves finished reads into done
+    void collect(std::vector<std::unique_ptr<Tile>> &done);
+    void recycle(std::unique_ptr<Tile> tile);
+    int inFlight() const;
+
+private:
+    // vars
+    const VirtualTextureFile &m_file;
+    int m_maxInFlight;
+    mutable std::mutex m_mutex;
+    std::condition_variable m_idle;
+    std::vector<uint32_t> m_pending;
+    std::vector<std::unique_ptr<Tile>> m_finished;
+    std::vector<std::unique_ptr<Tile>> m_free;
+};
+
+// Ties feedback analysis, the page cache and tile streaming together.
+// Call update() once per frame with the latest feedback, then upload uploads()
+// into the atlas and the dirty levels of the page table (see VirtualTextureGl).
+class VirtualTexture
+{
+public:
+    struct Settings
+    {
+        int atlasSlotsX = 16;
+        int atlasSlotsY = 16;
+        int maxUploadsPerFrame = 16;
+        int maxReadsInFlight = 32;
+    };
+
+    struct TileUpload
+    {
+        int slotX;
+        int slotY;
+        const unsigned char *pixels; // valid until the next update()
+    };
+
+    struct Stats
+    {
+        uint64_t frames = 0;
+        uint64_t requested = 0; // pages asked for by feedback, summed over frames
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t reads = 0;
+        uint64_t uploads = 0;
+        uint64_t evictions = 0;
+        uint64_t dropped = 0; // loaded tiles thrown away because the atlas was full of visible pages
+    };
+
+    VirtualTexture(const std::filesystem::path &path, const Settings &settings);
+    VirtualTexture(const std::filesystem::path &path);
+    ~VirtualTexture();
+
+    bool isOpen() const;
+    const VirtualTextureFile &file() const;
+    const Settings &settings() const;
+
+    void update(const uint32_t *feedback, size_t count);
+
+    const std::vector<TileUpload> &uploads() const;
+    // Page table texels (RGBA8: atlas slot x, slot y, mip of the page actually used, 255)
+    // for every level, pagesX(level) * pagesY(level) each. Levels below dirtyLevels()
+    // changed during the last update().
+    const std::vector<uint32_t> &pageTable(int level) const;
+    int dirtyLevels() const;
+    const Stats &stats() const;
+
+private:
+    void map(uint32_t page, int slot);
+    void unmap(uint32_t page);
+    void rebuildPageTable();
+    // vars
+    VirtualTextureFile m_file;
+    Settings m_settings;
+    std::unique_ptr<PageCache> m_cache;
+    std::unique_ptr<TileStreamer> m_streamer;
+    FeedbackAnalyzer m_analyzer;
+    std::vector<std::vector<int>> m_mapped;     // slot per page, -1 if not resident
+    std::vector<std::vector<uint32_t>> m_table; // resolved page table texels
+    std::vector<std::unique_ptr<TileStreamer::Tile>> m_ready;
+    std::vector<std::unique_ptr<TileStreamer::Tile>> m_uploading;
+    std::vector<TileUpload> m_uploads;
+    int m_dirtyLevels;
+    uint64_t m_frame;
+    Stats m_stats;
+};
+
+#endif // VIRTUAL_TEXTURE_HPP
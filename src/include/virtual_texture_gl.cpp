@@ -0,0 +1,214 @@
+#include "virtual_texture_gl.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+VirtualTextureGl::VirtualTextureGl(VirtualTexture &texture, int screenWidth, int screenHeight, int feedbackDivisor)
+    : m_texture(texture), m_atlas{0}, m_pageTable{0}, m_feedbackFbo{0}, m_feedbackColor{0}, m_feedbackDepth{0},
+      m_feedbackDivisor{std::max(1, feedbackDivisor)}, m_savedViewport{}, m_savedClear{},
+      m_savedFramebuffer{0}
+{
+    m_feedbackWidth = std::max(1, screenWidth / m_feedbackDivisor);
+    m_feedbackHeight = std::max(1, screenHeight / m_feedbackDivisor);
+    m_feedback.resize(static_cast<size_t>(m_feedbackWidth) * m_feedbackHeight);
+    if (!m_texture.isOpen())
+    {
+        return;
+    }
+    const VirtualTextureFile &file = m_texture.file();
+    const VirtualTexture::Settings &settings = m_texture.settings();
+
+    // bilinear filtering stays inside a tile thanks to the baked borders
+    glGenTextures(1, &m_atlas);
+    glBindTexture(GL_TEXTURE_2D, m_atlas);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_SRGB8_ALPHA8, settings.atlasSlotsX * file.paddedTileSize(),
+                 settings.atlasSlotsY * file.paddedTileSize(), 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+    // one texel per page, one mip level per virtual texture level; only read with texelFetch
+    glGenTextures(1, &m_pageTable);
+    glBindTexture(GL_TEXTURE_2D, m_pageTable);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, file.levels() - 1);
+    for (int level = 0; level < file.levels(); level++)
+    {
+        glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, file.pagesX(level), file.pagesY(level), 0, GL_RGBA,
+                     GL_UNSIGNED_BYTE, NULL);
+    }
+
+    glGenRenderbuffers(1, &m_feedbackColor);
+    glBindRenderbuffer(GL_RENDERBUFFER, m_feedbackColor);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, m_feedbackWidth, m_feedbackHeight);
+    glGenRenderbuffers(1, &m_feedbackDepth);
+    glBindRenderbuffer(GL_RENDERBUFFER, m_feedbackDepth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, m_feedbackWidth, m_feedbackHeight);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &m_savedFramebuffer);
+    glGenFramebuffers(1, &m_feedbackFbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_feedbackFbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_feedbackColor);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_feedbackDepth);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        std::cerr << "Virtual texture feedback framebuffer is incomplete" << std::endl;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, static_cast<GLuint>(m_savedFramebuffer));
+
+    upload();
+}
+
+VirtualTextureGl::~VirtualTextureGl()
+{
+    glDeleteFramebuffers(1, &m_feedbackFbo);
+    glDeleteRenderbuffers(1, &m_feedbackColor);
+    glDeleteRenderbuffers(1, &m_feedbackDepth);
+    glDeleteTextures(1, &m_pageTable);
+    glDeleteTextures(1, &m_atlas);
+};
+
+void VirtualTextureGl::bind(GLuint program, int atlasUnit, int pageTableUnit, bool feedbackPass)
+{
+    const VirtualTextureFile &file = m_texture.file();
+    const VirtualTexture::Settings &settings = m_texture.settings();
+
+    glActiveTexture(GL_TEXTURE0 + atlasUnit);
+    glBindTexture(GL_TEXTURE_2D, m_atlas);
+    glActiveTexture(GL_TEXTURE0 + pageTableUnit);
+    glBindTexture(GL_TEXTURE_2D, m_pageTable);
+    glActiveTexture(GL_TEXTURE0);
+
+    glUseProgram(program);
+    glUniform1i(glGetUniformLocation(program, "vtAtlas"), atlasUnit);
+    glUniform1i(glGetUniformLocation(program, "vtPageTable"), pageTableUnit);
+    glUniform2f(glGetUniformLocation(program, "vtPages"), static_cast<float>(file.pagesX(0)),
+                static_cast<float>(file.pagesY(0)));
+    glUniform1f(glGetUniformLocation(program, "vtTileSize"), static_cast<float>(file.tileSize()));
+    glUniform1f(glGetUniformLocation(program, "vtBorder"), static_cast<float>(file.border()));
+    glUniform2f(glGetUniformLocation(program, "vtAtlasSize"),
+                static_cast<float>(settings.atlasSlotsX * file.paddedTileSize()),
+                static_cast<float>(settings.atlasSlotsY * file.paddedTileSize()));
+    glUniform1f(glGetUniformLocation(program, "vtMaxLevel"), static_cast<float>(file.levels() - 1));
+    // derivatives in the small feedback buffer are feedbackDivisor times too large
+    float bias = feedbackPass ? -std::log2(static_cast<float>(m_feedbackDivisor)) : 0.0f;
+    glUniform1f(glGetUniformLocation(program, "vtMipBias"), bias);
+}
+
+void VirtualTextureGl::beginFeedback()
+{
+    glGetIntegerv(GL_VIEWPORT, m_savedViewport);
+    glGetFloatv(GL_COLOR_CLEAR_VALUE, m_savedClear);
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &m_savedFramebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_feedbackFbo);
+    glViewport(0, 0, m_feedbackWidth, m_feedbackHeight);
+    // alpha 255 marks texels that did not sample the virtual texture
+    glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+void VirtualTextureGl::endFeedback()
+{
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, m_feedbackWidth, m_feedbackHeight, GL_RGBA, GL_UNSIGNED_BYTE, m_feedback.data());
+    glBindFramebuffer(GL_FRAMEBUFFER, static_cast<GLuint>(m_savedFramebuffer));
+    glViewport(m_savedViewport[0], m_savedViewport[1], m_savedViewport[2], m_savedViewport[3]);
+    glClearColor(m_savedClear[0], m_savedClear[1], m_savedClear[2], m_savedClear[3]);
+
+    m_texture.update(m_feedback.data(), m_feedback.size());
+    upload();
+}
+
+void VirtualTextureGl::upload()
+{
+    if (!m_texture.isOpen())
+    {
+        return;
+    }
+    const VirtualTextureFile &file = m_texture.file();
+    int padded = file.paddedTileSize();
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    if (!m_texture.uploads().empty())
+    {
+        glBindTexture(GL_TEXTURE_2D, m_atlas);
+        for (const VirtualTexture::TileUpload &tile : m_texture.uploads())
+        {
+            glTexSubImage2D(GL_TEXTURE_2D, 0, tile.slotX * padded, tile.slotY * padded, padded, padded, GL_RGBA,
+                            GL_UNSIGNED_BYTE, tile.pixels);
+        }
+    }
+    if (m_texture.dirtyLevels() > 0)
+    {
+        glBindTexture(GL_TEXTURE_2D, m_pageTable);
+        for (int level = 0; level < m_texture.dirtyLevels(); level++)
+        {
+            glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, file.pagesX(level), file.pagesY(level), GL_RGBA,
+                            GL_UNSIGNED_BYTE, m_texture.pageTable(level).data());
+        }
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+GLuint VirtualTextureGl::atlas() const
+{
+    return m_atlas;
+}
+
+GLuint VirtualTextureGl::pageTable() const
+{
+    return m_pageTable;
+}
+
+const char *VirtualTextureGl::glslSource()
+{
+    return R"glsl(
+uniform sampler2D vtAtlas;
+uniform sampler2D vtPageTable;
+uniform vec2 vtPages;     // pages along x/y at level 0
+uniform float vtTileSize;
+uniform float vtBorder;
+uniform vec2 vtAtlasSize; // in texels
+uniform float vtMaxLevel;
+uniform float vtMipBias;
+
+float vtMipLevel(vec2 uv)
+{
+    vec2 texel = uv * vtPages * vtTileSize;
+    vec2 dx = dFdx(texel);
+    vec2 dy = dFdy(texel);
+    float d = max(dot(dx, dx), dot(dy, dy));
+    return clamp(0.5 * log2(max(d, 1e-8)) + vtMipBias, 0.0, vtMaxLevel);
+}
+
+vec2 vtLevelPages(float level)
+{
+    return max(vtPages / exp2(level), vec2(1.0));
+}
+
+vec4 vtSample(vec2 uv)
+{
+    float level = floor(vtMipLevel(uv));
+    uv = clamp(uv, 0.0, 0.99999);
+    ivec2 page = ivec2(uv * vtLevelPages(level));
+    // r/g: atlas slot, b: level of the page that is actually resident
+    vec4 entry = texelFetch(vtPageTable, page, int(level)) * 255.0;
+    vec2 inPage = fract(uv * vtLevelPages(entry.b));
+    vec2 texel = entry.rg * (vtTileSize + 2.0 * vtBorder) + vtBorder + inPage * vtTileSize;
+    return textureLod(vtAtlas, texel / vtAtlasSize, 0.0);
+}
+
+vec4 vtFeedback(vec2 uv)
+{
+    float level = floor(vtMipLevel(uv));
+    ivec2 page = ivec2(clamp(uv, 0.0, 0.99999) * vtLevelPages(level));
+    float high = float((page.x >> 8) | ((page.y >> 8) << 4));
+    return vec4(float(page.x & 255), float(page.y & 255), high, level) / 255.0;
+}
+)glsl";
+}
@@ -0,0 +1,57 @@
+#ifndef VIRTUAL_TEXTURE_GL_HPP
+#define VIRTUAL_TEXTURE_GL_HPP
+
+#include <vector>
+#include <glad/glad.h>
+
+#include "virtual_texture.hpp"
+
+// GPU half of virtual texturing: the physical atlas, the mipmapped page table and
+// a low resolution feedback target.
+//
+// Per frame:
+//   beginFeedback(); draw the scene with a shader returning vtFeedback(uv); endFeedback();
+//   draw the scene normally with a shader sampling vtSample(uv).
+// Both shaders get the functions from glslSource() spliced in after their #version
+// line and need bind() on their program. endFeedback() reads the feedback back,
+// runs VirtualTexture::update() and uploads the tiles and page table changes.
+class VirtualTextureGl
+{
+public:
+    // the feedback buffer is the screen size divided by feedbackDivisor
+    VirtualTextureGl(VirtualTexture &texture, int screenWidth, int screenHeight, int feedbackDivisor = 8);
+    ~VirtualTextureGl();
+
+    VirtualTextureGl(const VirtualTextureGl &) = delete;
+    VirtualTextureGl &operator=(const VirtualTextureGl &) = delete;
+
+    // feedbackPass selects the mip bias that compensates for the smaller feedback buffer
+    void bind(GLuint program, int atlasUnit, int pageTableUnit, bool feedbackPass = false);
+    void beginFeedback();
+    void endFeedback();
+    // pushes VirtualTexture::uploads() and the dirty page table levels to the GPU
+    void upload();
+
+    GLuint atlas() const;
+    GLuint pageTable() const;
+    static const char *glslSource();
+
+private:
+    // vars
+    VirtualTexture &m_texture;
+    GLuint m_atlas;
+    GLuint m_pageTable;
+    GLuint m_feedbackFbo;
+    GLuint m_feedbackColor;
+    GLuint m_feedbackDepth;
+    int m_feedbackWidth;
+    int m_feedbackHeight;
+    int m_feedbackDivisor;
+    GLint m_savedViewport[4];
+    GLfloat m_savedClear[4];
+    // whatever the scene renders to: 0, or an offscreen target of a headless context
+    GLint m_savedFramebuffer;
+    std::vector<uint32_t> m_feedback;
+};
+
+#endif // VIRTUAL_TEXTURE_GL_HPP
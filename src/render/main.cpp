@@ -0,0 +1,520 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "glm/glm.hpp"
+#include <glm/ext/matrix_clip_space.hpp> // glm::perspective
+#include <glm/gtc/matrix_transform.hpp>  // For glm::translate
+#include "glm/gtc/type_ptr.hpp"
+
+#include "utility.h"
+#include "animated_instances.hpp"
+#include "buffer_arena.hpp"
+#include "frame_readback.hpp"
+#include "glsl_vm.hpp"
+#include "image_decode.hpp"
+#include "image_encode.hpp"
+#include "primitives.hpp"
+#include "shader_program.hpp"
+#include "soft_raster.hpp"
+#include "texture.hpp"
+#include "thread_pool.hpp"
+#include "vertex_format.hpp"
+
+// usage: render [--frames N] [--fps F] [--width W] [--height H] [--format png|ppm]
+//               [--output DIR] [--context egl|osmesa|window|software]
+// Renders ex5's spinning cubes offline: N frames at a fixed timestep of 1/F seconds,
+// at any resolution, headless unless told otherwise. Frames come back through
+// FrameReadback and are encoded on ThreadPool::shared(), so the GL thread only waits
+// when the readback ring is full. Shaders and textures are ex5's, found through
+// SHADERS_DIR and ASSETS_DIR like the examples. The software context draws the same
+// frames with soft::Rasterizer instead, running the same shaders through GlslProgram,
+// on hosts without any GL driver.
+
+// position and texture coordinates at the vertex shader's locations 0 and 2
+struct Vertex
+{
+    float position[3];
+    float uv[2];
+
+    static constexpr std::array<mesh::VertexAttribute, 2> attributes()
+    {
+        return {mesh::attribute<decltype(position)>(0, offsetof(Vertex, position)),
+                mesh::attribute<decltype(uv)>(2, offsetof(Vertex, uv))};
+    }
+};
+
+struct Options
+{
+    int frames = 120;
+    double fps = 60.0;
+    int width = 1280;
+    int height = 720;
+    bool png = true;
+    std::filesystem::path output = "frames";
+    ContextBackend backend = ContextBackend::EGL;
+    bool software = false;
+};
+
+bool parseArguments(int argc, char **argv, Options &options)
+{
+    if (std::getenv("LEARNOPENGL_CONTEXT") != nullptr)
+    {
+        options.backend = requestedBackend();
+    }
+    for (int i = 1; i < argc; i++)
+    {
+        std::string flag = argv[i];
+        if (i + 1 >= argc)
+        {
+            std::cerr << flag << " needs a value" << std::endl;
+            return false;
+        }
+        std::string value = argv[++i];
+        if (flag == "--frames")
+        {
+            options.frames = std::atoi(value.c_str());
+        }
+        else if (flag == "--fps")
+        {
+            options.fps = std::atof(value.c_str());
+        }
+        else if (flag == "--width")
+        {
+            options.width = std::atoi(value.c_str());
+        }
+        else if (flag == "--height")
+        {
+            options.height = std::atoi(value.c_str());
+        }
+        else if (flag == "--format" && (value == "png" || value == "ppm"))
+        {
+            options.png = value == "png";
+        }
+        else if (flag == "--output")
+        {
+            options.output = value;
+        }
+        else if (flag == "--context" && value == "software")
+        {
+            options.software = true;
+        }
+        else if (flag == "--context" && (value == "egl" || value == "osmesa" || value == "window"))
+        {
+            options.software = false;
+            options.backend = value == "egl"      ? ContextBackend::EGL
+                              : value == "osmesa" ? ContextBackend::OSMESA
+                                                  : ContextBackend::WINDOW;
+        }
+        else
+        {
+            std::cerr << "unknown option " << flag << " " << value << std::endl;
+            return false;
+        }
+    }
+    if (options.frames <= 0 || options.fps <= 0.0 || options.width <= 0 || options.height <= 0)
+    {
+        std::cerr << "frames, fps, width and height must be positive" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Encodes frames on the shared pool. A copy leaves the readback buffer free at once;
+// past maxInFlight frames the caller encodes itself, which bounds the memory and keeps
+// a one thread pool from waiting on its own queue.
+class FrameEncoder
+{
+public:
+    FrameEncoder(const Options &options, size_t maxInFlight)
+        : m_options{options}, m_maxInFlight{maxInFlight}, m_inFlight{0}, m_encodeMicroseconds{0}, m_failures{0}
+    {
+    }
+
+    // from the readback consumer
+    void submit(const ReadbackFrame &frame)
+    {
+        bool queue;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            queue = m_inFlight < m_maxInFlight;
+            m_inFlight += queue ? 1 : 0;
+        }
+        if (!queue)
+        {
+            encode(frame);
+            return;
+        }
+        auto pixels = std::make_shared<std::vector<unsigned char>>(
+            frame.pixels, frame.pixels + static_cast<size_t>(frame.width) * static_cast<size_t>(frame.height) * 4);
+        ReadbackFrame copy = frame;
+        copy.pixels = pixels->data();
+        ThreadPool::shared().enqueue([this, copy, pixels] {
+            encode(copy);
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_inFlight--;
+            m_idle.notify_all();
+        });
+    }
+
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_idle.wait(lock, [this] { return m_inFlight == 0; });
+    }
+
+    double encodeMilliseconds() const
+    {
+        return static_cast<double>(m_encodeMicroseconds.load()) / 1000.0;
+    }
+
+    int failures() const
+    {
+        return m_failures.load();
+    }
+
+private:
+    void encode(const ReadbackFrame &frame)
+    {
+        auto start = std::chrono::steady_clock::now();
+        std::ostringstream name;
+        name << "frame_" << std::setw(5) << std::setfill('0') << frame.index << (m_options.png ? ".png" : ".ppm");
+        std::filesystem::path path = m_options.output / name.str();
+        bool written = m_options.png ? writePng(path, frame.pixels, frame.width, frame.height, true)
+                                     : writePpm(path, frame.pixels, frame.width, frame.height, true);
+        if (!written)
+        {
+            m_failures++;
+        }
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        m_encodeMicroseconds += std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+    }
+    // vars
+    const Options &m_options;
+    size_t m_maxInFlight;
+    size_t m_inFlight;
+    std::mutex m_mutex;
+    std::condition_variable m_idle;
+    std::atomic<long long> m_encodeMicroseconds;
+    std::atomic<int> m_failures;
+};
+
+// ex5's cube and its ten spinning instances, drawn with one instanced call
+struct Scene
+{
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+    std::vector<AnimatedInstance> instances;
+};
+
+Scene buildScene()
+{
+    Scene scene;
+    mesh::PrimitiveCounts cubeCounts = mesh::cubeCounts(1);
+    scene.vertices.resize(cubeCounts.vertexCount);
+    scene.indices.resize(cubeCounts.indexCount);
+    mesh::GeometryStreams streams;
+    streams.positions = scene.vertices[0].position;
+    streams.positionStride = sizeof(Vertex);
+    streams.uvs = scene.vertices[0].uv;
+    streams.uvStride = sizeof(Vertex);
+    streams.indices = scene.indices.data();
+    mesh::generateCube(streams, 1.0f, 1);
+    // ex5's texture layout: v against z on the sides and caps, front and back seen from +z
+    for (size_t i = 0; i < scene.vertices.size(); i++)
+    {
+        Vertex &vertex = scene.vertices[i];
+        size_t face = i / 4; // +x, -x, +y, -y, +z, -z
+        vertex.uv[0] = (face < 2 ? vertex.position[1] : vertex.position[0]) + 0.5f;
+        vertex.uv[1] = face < 4 ? 0.5f - vertex.position[2] : vertex.position[1] + 0.5f;
+    }
+
+    const glm::vec3 cubePositions[] = {
+        glm::vec3(0.1f, 0.1f, 0.1f),    glm::vec3(2.0f, 5.0f, -15.0f), glm::vec3(-1.5f, -2.2f, -2.5f),
+        glm::vec3(-3.8f, -2.0f, -12.3f), glm::vec3(2.4f, -0.4f, -3.5f), glm::vec3(-1.7f, 3.0f, -7.5f),
+        glm::vec3(1.3f, -2.0f, -2.5f),  glm::vec3(1.5f, 2.0f, -2.5f),  glm::vec3(1.5f, 0.2f, -1.5f),
+        glm::vec3(-1.3f, 1.0f, -1.5f)};
+    for (unsigned int i = 0; i < 10; i++)
+    {
+        float angle = (5.0f + i + 1) * (i + 1);
+        scene.instances.push_back(AnimatedInstance{{cubePositions[i].x, cubePositions[i].y, cubePositions[i].z},
+                                                   0.0f,
+                                                   {0.5f, 1.0f, 0.0f},
+                                                   glm::radians(angle)});
+    }
+    return scene;
+}
+
+bool loadSoftTexture(const std::filesystem::path &path, soft::Texture &texture)
+{
+    int width, height, channels;
+    unsigned char *pixels = loadImage(path, width, height, channels, 4);
+    if (pixels == nullptr)
+    {
+        return false;
+    }
+    texture.load(pixels, width, height);
+    ImageArena::local().reset();
+    return true;
+}
+
+// --context software: the GL path's frames drawn by soft::Rasterizer, with its shaders
+// and instanced draws
+int renderSoftware(const Options &options)
+{
+    if (options.width > soft::Rasterizer::MAX_SIZE || options.height > soft::Rasterizer::MAX_SIZE)
+    {
+        std::cerr << "the software context draws at most " << soft::Rasterizer::MAX_SIZE << " pixels a side"
+                  << std::endl;
+        return 2;
+    }
+    std::filesystem::create_directories(options.output);
+    std::filesystem::path shaderDir = getEnvVar("SHADERS_DIR");
+    std::filesystem::path assetsDir = getEnvVar("ASSETS_DIR");
+    soft::GlslProgram instanced(shaderDir);
+    if (!instanced.loadShaders("02_instanced.vs", "01_shader.fs"))
+    {
+        return 1;
+    }
+    soft::Texture texture1, texture2;
+    if (!loadSoftTexture(assetsDir / "container.jpg", texture1) ||
+        !loadSoftTexture(assetsDir / "awesomeface.png", texture2))
+    {
+        std::cerr << "Failed to load textures" << std::endl;
+        return 1;
+    }
+
+    int width = options.width, height = options.height;
+    Scene scene = buildScene();
+    std::vector<AnimatedInstance> instances = AnimatedInstances::normalized(scene.instances);
+    glm::mat4 view = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -3.0));
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), static_cast<float>(width) / height, 0.1f, 100.0f);
+    instanced.setTexture("texture1", &texture1);
+    instanced.setTexture("texture2", &texture2);
+    instanced.setBuffer("instances", &instances[0].position[0], instances.size() * 2);
+    instanced.setUniform("view", glm::value_ptr(view), 16);
+    instanced.setUniform("projection", glm::value_ptr(projection), 16);
+    const mesh::VertexLayout layout = mesh::VertexFormat<Vertex>::layout();
+
+    soft::Rasterizer rasterizer;
+    soft::Framebuffer target(width, height);
+    FrameEncoder encoder(options, 2 * ThreadPool::shared().threadCount());
+    const float clearColor[4] = {0.2f, 0.3f, 0.3f, 1.0f};
+
+    using Clock = std::chrono::steady_clock;
+    auto since = [](Clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    };
+    double renderMilliseconds = 0.0;
+    Clock::time_point start = Clock::now();
+    for (int frame = 0; frame < options.frames; frame++)
+    {
+        Clock::time_point frameStart = Clock::now();
+        target.clear(clearColor);
+        instanced.setUniform("time", static_cast<float>(frame / options.fps));
+        soft::DrawCall call;
+        call.program = &instanced;
+        for (const mesh::VertexAttribute &attribute : layout.attributes)
+        {
+            call.attributes[attribute.location] = soft::AttributeStream{
+                reinterpret_cast<const float *>(reinterpret_cast<const unsigned char *>(scene.vertices.data()) +
+                                                attribute.offset),
+                sizeof(Vertex), attribute.components};
+        }
+        call.vertexCount = scene.vertices.size();
+        call.indices = scene.indices.data();
+        call.indexCount = scene.indices.size();
+        call.instanceCount = static_cast<int>(scene.instances.size());
+        rasterizer.draw(target, call);
+        renderMilliseconds += since(frameStart);
+        // the encoder copies the pixels or encodes them before returning
+        encoder.submit(ReadbackFrame{static_cast<uint64_t>(frame), width, height, target.color()});
+    }
+    Clock::time_point drainStart = Clock::now();
+    encoder.wait();
+    double drainMilliseconds = since(drainStart);
+    double total = since(start);
+
+    int frames = options.frames;
+    unsigned int threads = ThreadPool::shared().threadCount();
+    const soft::RasterStats &stats = rasterizer.stats();
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << frames << " frames of " << width << "x" << height << " in " << total / 1000.0 << " s, "
+              << frames * 1000.0 / total << " frames/s (" << drainMilliseconds << " ms finishing after the last)"
+              << std::endl;
+    std::cout << "  render:   " << renderMilliseconds / frames << " ms/frame in software on " << threads
+              << " threads, " << stats.fragments / renderMilliseconds / 1e3 << " Mpixels/s, "
+              << stats.triangles / renderMilliseconds / 1e3 << " M triangles/s" << std::endl;
+    std::cout << "  encode:   " << encoder.encodeMilliseconds() / frames << " ms/frame on " << threads
+              << " threads, " << frames * 1000.0 * threads / std::max(encoder.encodeMilliseconds(), 1e-3)
+              << " frames/s at most" << std::endl;
+    if (encoder.failures() > 0)
+    {
+        std::cerr << encoder.failures() << " frames could not be written" << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+GLFWwindow *gWindow = NULL;
+
+int main(int argc, char **argv)
+{
+    Options options;
+    if (!parseArguments(argc, argv, options))
+    {
+        return 2;
+    }
+    if (options.software)
+    {
+        return renderSoftware(options);
+    }
+    if (!initOpengl(gWindow, options.width, options.height, options.backend))
+    {
+        std::cerr << "glfw initialisation failed" << std::endl;
+        return -1;
+    }
+    int width = options.width, height = options.height;
+    if (options.backend == ContextBackend::WINDOW)
+    {
+        // the window may have come out another size, or with more pixels per point
+        glfwGetFramebufferSize(gWindow, &width, &height);
+        glViewport(0, 0, width, height);
+    }
+    std::filesystem::create_directories(options.output);
+
+    std::filesystem::path shaderDir = getEnvVar("SHADERS_DIR");
+    std::filesystem::path assetsDir = getEnvVar("ASSETS_DIR");
+    ShaderProgram instanced(shaderDir);
+    if (!instanced.loadShaders("02_instanced.vs", "01_shader.fs"))
+    {
+        return 1;
+    }
+
+    Scene scene = buildScene();
+
+    mesh::VertexArrayCache vertexArrays;
+    MeshArena arena(mesh::VertexFormat<Vertex>::layout());
+    ArenaMesh cube = arena.add(scene.vertices.data(), static_cast<uint32_t>(scene.vertices.size()),
+                               scene.indices.data(), static_cast<uint32_t>(scene.indices.size()));
+
+    // trilinear on purpose: the cubes recede and minify, and the mips are filtered in linear light
+    SamplerDesc sampler;
+    sampler.minFilter = GL_LINEAR_MIPMAP_LINEAR;
+
+    Texture2D texture1, texture2;
+    if (!texture1.load(assetsDir / "container.jpg", sampler) || !texture2.load(assetsDir / "awesomeface.png", sampler))
+    {
+        std::cerr << "Failed to load textures" << std::endl;
+        return 1;
+    }
+    texture1.bind(0);
+    texture2.bind(1);
+
+    AnimatedInstances gpuInstances;
+    gpuInstances.upload(scene.instances);
+    gpuInstances.bind(2);
+
+    instanced.use();
+    GLuint program = instanced.getProgram();
+    glUniform1i(glGetUniformLocation(program, "texture1"), 0);
+    glUniform1i(glGetUniformLocation(program, "texture2"), 1);
+    glUniform1i(glGetUniformLocation(program, "instances"), 2);
+    glm::mat4 view = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -3.0));
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), static_cast<float>(width) / height, 0.1f, 100.0f);
+    glUniformMatrix4fv(glGetUniformLocation(program, "view"), 1, GL_FALSE, glm::value_ptr(view));
+    glUniformMatrix4fv(glGetUniformLocation(program, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+    int timeLoc = glGetUniformLocation(program, "time");
+    glEnable(GL_DEPTH_TEST);
+
+    // a readback ring a few frames deep, and up to two frames per thread waiting to be encoded
+    const size_t readbackDepth = 4;
+    FrameEncoder encoder(options, 2 * ThreadPool::shared().threadCount());
+    FrameReadback readback([&encoder](const ReadbackFrame &frame) { encoder.submit(frame); }, readbackDepth);
+
+    // GPU time of the draws, read back as late as the frames themselves
+    std::vector<GLuint> timers(readbackDepth + 1);
+    glGenQueries(static_cast<GLsizei>(timers.size()), timers.data());
+    double gpuMilliseconds = 0.0;
+    auto collectTimer = [&](int frame) {
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(timers[frame % timers.size()], GL_QUERY_RESULT, &nanoseconds);
+        gpuMilliseconds += static_cast<double>(nanoseconds) / 1e6;
+    };
+
+    using Clock = std::chrono::steady_clock;
+    auto since = [](Clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    };
+    double renderMilliseconds = 0.0, readbackMilliseconds = 0.0;
+    int frame = 0;
+    Clock::time_point start = Clock::now();
+    for (; frame < options.frames && !glfwWindowShouldClose(gWindow); frame++)
+    {
+        if (frame >= static_cast<int>(timers.size()))
+        {
+            collectTimer(frame - static_cast<int>(timers.size()));
+        }
+        Clock::time_point frameStart = Clock::now();
+        glBeginQuery(GL_TIME_ELAPSED, timers[frame % timers.size()]);
+        glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glUniform1f(timeLoc, static_cast<float>(frame / options.fps));
+        arena.bind(vertexArrays);
+        arena.drawInstanced(cube, 0, static_cast<uint32_t>(scene.indices.size()),
+                            static_cast<uint32_t>(scene.instances.size()));
+        glEndQuery(GL_TIME_ELAPSED);
+        renderMilliseconds += since(frameStart);
+
+        Clock::time_point readbackStart = Clock::now();
+        readback.capture(width, height);
+        readback.update();
+        readbackMilliseconds += since(readbackStart);
+
+        if (options.backend == ContextBackend::WINDOW)
+        {
+            glfwSwapBuffers(gWindow);
+            glfwPollEvents();
+        }
+    }
+    for (int i = std::max(0, frame - static_cast<int>(timers.size())); i < frame; i++)
+    {
+        collectTimer(i);
+    }
+    Clock::time_point drainStart = Clock::now();
+    readback.finish();
+    encoder.wait();
+    double drainMilliseconds = since(drainStart);
+    double total = since(start);
+    glDeleteQueries(static_cast<GLsizei>(timers.size()), timers.data());
+
+    unsigned int threads = ThreadPool::shared().threadCount();
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << frame << " frames of " << width << "x" << height << " in " << total / 1000.0 << " s, "
+              << frame * 1000.0 / total << " frames/s (" << drainMilliseconds << " ms finishing after the last)"
+              << std::endl;
+    std::cout << "  render:   " << renderMilliseconds / frame << " ms/frame submitting, " << gpuMilliseconds / frame
+              << " ms/frame on the GPU" << std::endl;
+    std::cout << "  readback: " << readbackMilliseconds / frame << " ms/frame on the GL thread, "
+              << readback.stats().stalls << " frames waited for a free buffer" << std::endl;
+    std::cout << "  encode:   " << encoder.encodeMilliseconds() / frame << " ms/frame on " << threads
+              << " threads, " << frame * 1000.0 * threads / std::max(encoder.encodeMilliseconds(), 1e-3)
+              << " frames/s at most" << std::endl;
+    if (encoder.failures() > 0)
+    {
+        std::cerr << encoder.failures() << " frames could not be written" << std::endl;
+        return 1;
+    }
+    return 0;
+}